@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include <osmocom/core/bits.h>
+
+/* A5/3 and A5/4 with the KASUMI key schedule expanded once per key */
+
+struct kasumi_key_sched {
+	uint16_t KLi1[8], KLi2[8];
+	uint16_t KOi1[8], KOi2[8], KOi3[8];
+	uint16_t KIi1[8], KIi2[8], KIi3[8];
+};
+
+struct a5_kasumi_key {
+	struct kasumi_key_sched ck;	/* CK */
+	struct kasumi_key_sched ck_km;	/* CK ^ KM, for the first KGCORE round */
+};
+
+int a5_kasumi_key_expand(struct a5_kasumi_key *k, int algo, const uint8_t *key);
+void a5_kasumi(const struct a5_kasumi_key *k, uint32_t fn, ubit_t *dl, ubit_t *ul);
@@ -19,6 +19,8 @@ int abis_open(struct gsm_bts *bts, char *model_name);
 
 int abis_oml_sendmsg(struct msgb *msg);
 int abis_bts_rsl_sendmsg(struct msgb *msg);
+void abis_rsl_coalesce_flush(struct gsm_bts_trx *trx);
+void abis_rsl_coalesce_tdma_tick(struct gsm_bts *bts);
 
 uint32_t get_signlink_remote_ip(struct e1inp_sign_link *link);
 
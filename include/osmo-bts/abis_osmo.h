@@ -5,6 +5,9 @@
 
 struct gsm_bts;
 
+/* Headroom to leave in msgbs sent via abis_osmo_pcu_tx_container() */
+#define ABIS_OSMO_HEADROOM_SIZE	128
+
 int down_osmo(struct gsm_bts *bts, struct msgb *msg);
 
-int abis_osmo_pcu_tx_container(struct gsm_bts *bts, const struct gsm_pcu_if_container *container);
+int abis_osmo_pcu_tx_container(struct gsm_bts *bts, struct msgb *msg);
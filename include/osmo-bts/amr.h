@@ -9,6 +9,7 @@
 void amr_log_mr_conf(int ss, int logl, const char *pfx,
 		     struct amr_multirate_conf *amr_mrc);
 
+void amr_mr_conf_update(struct amr_multirate_conf *amr_mrc);
 int amr_parse_mr_conf(struct amr_multirate_conf *amr_mrc,
 		      const uint8_t *mr_conf, unsigned int len);
 void amr_set_mode_pref(uint8_t *data, const struct amr_multirate_conf *amr_mrc,
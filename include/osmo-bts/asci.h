@@ -5,11 +5,14 @@
 
 enum {
 	VGCS_TALKER_NONE = 0,
+	VGCS_TALKER_SELECT,
 	VGCS_TALKER_WAIT_FRAME,
 	VGCS_TALKER_ACTIVE,
 };
 
-void vgcs_rach(struct gsm_lchan *lchan, uint8_t ra, uint8_t acc_delay, uint32_t fn);
+struct ph_rach_ind_param;
+
+void vgcs_rach(struct gsm_lchan *lchan, const struct ph_rach_ind_param *rach_ind);
 
 void vgcs_lchan_react(struct gsm_lchan *lchan);
 
@@ -1,14 +1,18 @@
 #ifndef _BTS_H
 #define _BTS_H
 
+#include <osmocom/core/bits.h>
 #include <osmocom/core/rate_ctr.h>
 #include <osmocom/core/socket.h>
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/bts_trx.h>
+#include <osmo-bts/bts_sm.h>
 #include <osmo-bts/osmux.h>
+#include <osmo-bts/slack_task.h>
 
 
 struct gsm_bts_trx;
+struct media_io;
 
 enum bts_global_status {
 	BTS_STATUS_RF_ACTIVE,
@@ -26,11 +30,45 @@ enum {
 	BTS_CTR_RACH_DROP,
 	BTS_CTR_RACH_HO,
 	BTS_CTR_RACH_VGCS,
+	BTS_CTR_VGCS_TALKER_GRANT,
+	BTS_CTR_VGCS_TALKER_COLLISION,
 	BTS_CTR_RACH_CS,
 	BTS_CTR_RACH_PS,
+	BTS_CTR_RACH_SHED,
+	BTS_CTR_RACH_SHED_REJ,
+	BTS_CTR_RACH_DEDUP,
 	BTS_CTR_AGCH_RCVD,
 	BTS_CTR_AGCH_SENT,
 	BTS_CTR_AGCH_DELETED,
+	BTS_CTR_AGCH_REJ_SENT,
+	BTS_CTR_AGCH_REJ_REFS,
+	BTS_CTR_GSMTAP_DROP,
+	BTS_CTR_LOG_ASYNC_DROP,
+	BTS_CTR_LOOPBACK_UL_GOOD,
+	BTS_CTR_LOOPBACK_UL_BAD,
+	BTS_CTR_LOOPBACK_DL_EMPTY,
+	BTS_CTR_RTP_POOL_HIT,
+	BTS_CTR_RTP_POOL_MISS,
+	BTS_CTR_RTP_MEDIA_DROP,
+	BTS_CTR_PCU_SHED_RTS,
+	BTS_CTR_PCU_SHED_DATA,
+	BTS_CTR_PCU_SHED_TIME,
+	BTS_CTR_PCU_SHED_INTERF,
+	BTS_CTR_PCU_SHED_INFO,
+	/* ordered in groups of three by enum pwr_ctrl_log_loop */
+	BTS_CTR_LOOP_MS_PWR_RAISE,
+	BTS_CTR_LOOP_MS_PWR_LOWER,
+	BTS_CTR_LOOP_MS_PWR_REVERSAL,
+	BTS_CTR_LOOP_BS_PWR_RAISE,
+	BTS_CTR_LOOP_BS_PWR_LOWER,
+	BTS_CTR_LOOP_BS_PWR_REVERSAL,
+	BTS_CTR_LOOP_TA_RAISE,
+	BTS_CTR_LOOP_TA_LOWER,
+	BTS_CTR_LOOP_TA_REVERSAL,
+	BTS_CTR_LOOP_TA_CLAMPED,
+	BTS_CTR_ACCH_REP_DL_FACCH,
+	BTS_CTR_ACCH_REP_UL_SACCH,
+	BTS_CTR_ACCH_OVERPOWER,
 };
 
 /* Used by OML layer for BTS Attribute reporting */
@@ -88,12 +126,27 @@ struct gprs_rlc_cfg {
 	uint8_t initial_mcs;
 };
 
+/* 4 bursts of 116 bits, as encoded by bts_model_cbch_encode() */
+#define SMSCB_BLOCK_BURSTS_LEN	(4 * 116)
+
 struct bts_smscb_state {
 	struct llist_head queue; /* list of struct smscb_msg */
 	int queue_len;
 	struct rate_ctr_group *ctrs;
 	struct smscb_msg *cur_msg; /* current SMS-CB */
 	struct smscb_msg *default_msg; /* default broadcast message; NULL if none */
+	/* CBCH LOAD INDICATION for the current queue length, see cbch_update_load() */
+	struct {
+		bool pending;	/* queue length is outside of the hysteresis */
+		bool overflow;
+		uint8_t amount;	/* SMSCB Message Count */
+	} load_ind;
+	/* the block last returned by bts_cbch_get(), see bts_cbch_get_bursts() */
+	struct {
+		uint8_t l2[GSM_MACBLOCK_LEN];
+		ubit_t bursts[SMSCB_BLOCK_BURSTS_LEN];
+		bool bursts_valid;	/* pre-encoded by bts_model_cbch_encode() */
+	} last;
 };
 
 /* Tx power filtering algorithm */
@@ -140,6 +193,50 @@ struct bsc_oml_host {
 
 #define BTS_PCU_SOCK_WQUEUE_LEN_DEFAULT 100
 
+#define BTS_RACH_SHED_BURST_DEFAULT 10
+
+/* number of recent RACH requests remembered by bts_rach_dedup() */
+#define BTS_RACH_DEDUP_NUM 16
+
+/* a RACH request remembered by bts_rach_dedup() */
+struct bts_rach_dedup_entry {
+	uint32_t fn;
+	uint8_t ra;
+	uint8_t tn;
+	bool valid;
+};
+
+/* upper bound of bts_agch_max_queue_length() (83 for any SI3) */
+#define BTS_AGCH_QUEUE_MAX 128
+
+/* Stages of the RSL procedures whose latency is measured */
+enum bts_proc_lat {
+	BTS_PROC_LAT_CHAN_ACT_PHY_REQ,	/* CHAN ACTIV received -> activation requested from the PHY */
+	BTS_PROC_LAT_CHAN_ACT_PHY_CNF,	/* activation requested -> confirmed by the PHY */
+	BTS_PROC_LAT_CHAN_ACT,		/* CHAN ACTIV received -> CHAN ACTIV ACK sent */
+	BTS_PROC_LAT_MODE_MODIF,	/* MODE MODIFY received -> MODE MODIFY ACK sent */
+	BTS_PROC_LAT_IPAC_CRCX,		/* IPA CRCX received -> IPA CRCX ACK sent */
+	BTS_PROC_LAT_IPAC_MDCX,		/* IPA MDCX received -> IPA MDCX ACK sent */
+	BTS_PROC_LAT_VGCS_UL_GRANT,	/* first talker RACH received -> VGCS UPLINK GRANT sent */
+	BTS_PROC_LAT_TS_SWITCH,		/* dynamic TS switch started -> TS reconnected by the PHY */
+	BTS_PROC_LAT_IPAC_PDCH,		/* IPA PDCH ACT/DEACT received -> PDCH ACT/DEACT ACK sent */
+	BTS_PROC_LAT_HO_FIRST_FRAME,	/* HANDOver DETect sent -> first valid frame from the MS */
+	_NUM_BTS_PROC_LAT
+};
+
+extern const struct value_string bts_proc_lat_names[];
+
+/* bucket i: less than 250 us << i, last: later */
+#define BTS_PROC_LAT_HIST_LEN	14
+
+/* latency statistics of one stage (see 'show bts <0-255> latency') */
+struct bts_proc_lat_stats {
+	unsigned long long hist[BTS_PROC_LAT_HIST_LEN];
+	unsigned long long count;
+	unsigned long long sum_us;
+	unsigned long long max_us;
+};
+
 /* One BTS */
 struct gsm_bts {
 	/* list header in g_bts_sm->bts_list */
@@ -180,6 +277,22 @@ struct gsm_bts {
 	/* OSMO extenion link associated to same line as oml_link: */
 	struct e1inp_sign_link *osmo_link;
 
+	/* Time to service after startup or the loss of the OML link, see abis.c */
+	struct {
+		struct timespec since;		/* start of the outage (zero: in service) */
+		unsigned int attempts;		/* connection attempts during the outage */
+		/* last outage: time until the OML and the C0 RSL link were up */
+		unsigned int last_attempts;
+		unsigned long long last_oml_ms;
+		unsigned long long last_rsl_ms;
+	} abis_tts;
+
+	/* RF kept up across the loss of the OML link, see X17 in abis.c */
+	struct {
+		struct osmo_timer_list timer;	/* grace period, pending while A-bis is down */
+		bool reattached;		/* OML link back in time, until C0's RSL link is up */
+	} abis_grace;
+
 	/* Abis network management O&M handle */
 	struct gsm_abis_mo mo;
 
@@ -241,6 +354,7 @@ struct gsm_bts {
 	unsigned int t200_ms[7];
 	unsigned int t3105_ms;
 	unsigned int t3115_ms;	/* VGCS UPLINK GRANT repeat timer */
+	unsigned int vgcs_talker_window_ms;	/* collect competing talker RACHs (0: first come) */
 	struct {
 		uint8_t overload_period;
 		struct {
@@ -249,6 +363,7 @@ struct gsm_bts {
 			uint8_t load_ind_period;	/* seconds */
 			/* Internal data */
 			struct osmo_timer_list timer;
+			struct slack_task task;		/* computes and sends the report */
 			unsigned int pch_total;
 			unsigned int pch_used;
 		} ccch;
@@ -268,9 +383,14 @@ struct gsm_bts {
 
 	/* AGCH queuing */
 	struct {
-		struct llist_head queue;
+		/* min-heap of the queued messages by deadline, see bts_agch_enqueue() */
+		struct msgb *heap[BTS_AGCH_QUEUE_MAX];
+		/* queued IMM ASS REJ with room for more request references, oldest first */
+		struct llist_head open_rejs;
+		uint32_t seq;		/* sequence number of the next enqueued message */
 		int length;
 		int max_length;
+		unsigned int validity_fn; /* T3126 in TDMA frames */
 
 		int thresh_level;	/* Cleanup threshold in percent of max len */
 		int low_level;		/* Low water mark in percent of max len */
@@ -291,6 +411,7 @@ struct gsm_bts {
 		uint8_t num_pages;	/* total number of pages */
 		uint8_t next_page;	/* next page number to be sent */
 		bool pni;		/* Primary Notification Identifier */
+		unsigned int generation; /* changed with each new prim_notif, see paging.c */
 	} etws;
 
 	/* Advanced Speech Call Items (VBS/VGCS) + NCH related bits */
@@ -306,6 +427,9 @@ struct gsm_bts {
 	struct llist_head bsc_oml_hosts;
 	unsigned int rtp_jitter_buf_ms;
 	bool rtp_jitter_adaptive;
+	/* DL TCH jitter buffer in front of the scheduler (0 = disabled) */
+	unsigned int rtp_tch_jitter_buf_ms;
+	bool rtp_tch_jitter_adaptive;
 
 	uint16_t rtp_port_range_start;
 	uint16_t rtp_port_range_end;
@@ -313,6 +437,21 @@ struct gsm_bts {
 	int rtp_ip_dscp;
 	int rtp_priority;
 
+	/* pre-bound RTP/RTCP sockets for IPA CRCX, see lchan_rtp_pool_resize() */
+	struct {
+		unsigned int size;	/* number of sockets kept ready (0 = off) */
+		unsigned int num;	/* number of sockets in socks[] */
+		struct osmo_rtp_socket **socks;
+		struct osmo_timer_list refill_timer;
+		struct slack_task refill_task;
+	} rtp_pool;
+
+	/* receive RTP in a background thread, see 'rtp media-thread' */
+	struct {
+		bool enabled;
+		struct media_io *inst;	/* started on first use */
+	} media_io;
+
 	bool rtp_nogaps_mode;		/* emit RTP stream without any gaps */
 	bool use_ul_ecu;		/* "rtp internal-uplink-ecu" option */
 	bool emit_hr_rfc5993;
@@ -322,6 +461,15 @@ struct gsm_bts {
 	} support;
 	struct {
 		uint8_t tc4_ctr;
+		/* BCCH Norm schedule, see bts_sysinfo_sched_update() */
+		struct {
+			bool valid;
+			uint32_t si_valid;	/* si_valid it was built for */
+			bool pcu_connected;	/* pcu_connected() it was built for */
+			enum osmo_sysinfo_type tc[8];	/* SI sent on each TC (on TC = 4 if tc4_cnt == 0) */
+			enum osmo_sysinfo_type tc4[4];	/* SI sent in turn on TC = 4 */
+			uint8_t tc4_cnt;
+		} sched;
 	} si;
 	struct gsm_time gsm_time;
 	/* frame number statistics (FN in PH-RTS.ind vs. PH-DATA.ind */
@@ -361,22 +509,85 @@ struct gsm_bts {
 	int16_t min_qual_norm;	/* minimum link quality (in centiBels) for Normal Bursts */
 	uint16_t max_ber10k_rach;	/* Maximum permitted RACH BER in 0.01% */
 
+	/* RACH overload control, see bts_rach_shed() */
+	struct {
+		unsigned int rate;	/* CHAN RQD per second towards the BSC (0 = off) */
+		unsigned int burst;	/* size of the token bucket, in CHAN RQD */
+		int wait_ind;		/* T3122 of the local IMM ASS REJ (-1 = none) */
+		uint32_t level;		/* tokens in the bucket, in 1/1000 CHAN RQD */
+		uint32_t last_fn;	/* frame number of the last refill */
+	} rach_shed;
+
+	/* RACH deduplication, see bts_rach_dedup() */
+	struct {
+		unsigned int window_fn;	/* in TDMA frames (0 = off) */
+		struct bts_rach_dedup_entry recent[BTS_RACH_DEDUP_NUM];
+		unsigned int next;	/* ring index of the next entry */
+	} rach_dedup;
+
 	struct {
 		char *sock_path;
+		/* paths of the 'pcu-socket-shard's, NULL if not configured ([0] is unused) */
+		char *shard_sock_path[PCU_SOCK_NUM_MAX];
 		unsigned int sock_wqueue_len_max;
+		unsigned int time_ind_interval;	/* send TIME.ind every N-th block only */
+		unsigned int time_ind_skip;	/* blocks to skip until the next TIME.ind */
 	} pcu;
 
 	/* GSMTAP Um logging (disabled by default) */
 	struct {
 		struct gsmtap_inst *inst;
+		struct gsmtap_writer *writer;
 		char *remote_host;
 		char *local_host;
 		uint32_t sapi_mask;
 		uint8_t sapi_acch;
+		uint16_t sampling;	/* send only every N-th matching message */
+		uint16_t sampling_cnt;
+		bool shed;		/* suspended by the BTS model under load */
 	} gsmtap;
 
+	/* pcapng capture of GSMTAP Um and RTP, see 'bts N pcap-capture start' */
+	struct {
+		struct pcap_capture *cap;
+		uint32_t sapi_mask;
+		uint8_t sapi_acch;
+		bool rtp;		/* also capture the RTP of the lchans */
+	} pcap;
+
+	/* Abis RSL Tx coalescing, see abis_bts_rsl_sendmsg(): max. bytes per batch (0 = off) */
+	unsigned int rsl_coalesce_bytes;
+
+	/* Locking of the process memory into RAM, see bts_mem_lock() */
+	struct {
+		bool enabled;
+		unsigned int heap_reserve_mb;	/* heap to pre-fault per TRX */
+		bool locked;
+	} mem_lock;
+
+	/* Size of the hugepage pool in huge pages (0 = off), see bts_hugepages_init() */
+	unsigned int mem_hugepages;
+
+	/* CPU time accounting of the scheduler handlers, see sched_cpu_account() */
+	bool sched_cpu_acct;
+	/* report the accounted load in the CCCH LOAD INDICATION (Osmocom extension) */
+	bool sched_cpu_load_ind;
+
+	/* Export of the counters to shared memory (disabled by default) */
+	struct {
+		char *name;
+		unsigned int interval_ms;
+		struct stats_shm *inst;
+	} stats_shm;
+
+	/* Latency of the RSL procedures, per stage */
+	struct bts_proc_lat_stats proc_lat[_NUM_BTS_PROC_LAT];
+
 	struct osmux_state osmux;
 
+	/* Recent level changes of the MS/BS power and TA control loops */
+	struct pwr_ctrl_log pwr_ctrl_log;
+
 	struct osmo_fsm_inst *shutdown_fi; /* FSM instance to manage shutdown procedure during process exit */
 	bool shutdown_fi_exit_proc; /* exit process when shutdown_fsm is finished? */
 	bool shutdown_fi_skip_power_ramp; /* Skip power ramping and change power in one step? */
@@ -388,6 +599,22 @@ struct gsm_bts {
 
 extern const struct value_string bts_impl_flag_desc[];
 extern void *tall_bts_ctx;
+extern void *tall_bts_hp_ctx;
+
+/*! talloc context for the allocations on the scheduler and msgb hot paths:
+ *  the hugepage pool if configured (main thread only), 'ctx' otherwise */
+static inline void *bts_hp_ctx(const void *ctx)
+{
+	return tall_bts_hp_ctx ? tall_bts_hp_ctx : (void *) ctx;
+}
+
+/*! msgb_alloc_headroom() from the hugepage pool, if configured */
+static inline struct msgb *bts_hp_msgb_alloc_headroom(uint16_t size, uint16_t headroom, const char *name)
+{
+	if (tall_bts_hp_ctx)
+		return msgb_alloc_headroom_c(tall_bts_hp_ctx, size, headroom, name);
+	return msgb_alloc_headroom(size, headroom, name);
+}
 
 #define GSM_BTS_SI2Q(bts, i)   (struct gsm48_system_information_type_2quater *)((bts)->si_buf[SYSINFO_TYPE_2quater][i])
 #define GSM_BTS_HAS_SI(bts, i) ((bts)->si_valid & (1 << i))
@@ -408,6 +635,8 @@ void bts_shutdown_ext(struct gsm_bts *bts, const char *reason, bool exit_proc, b
 int bts_link_estab(struct gsm_bts *bts);
 
 int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg);
+bool bts_rach_shed(struct gsm_bts *bts, uint8_t ra, uint32_t fn);
+bool bts_rach_dedup(struct gsm_bts *bts, uint8_t ra, uint8_t tn, uint32_t fn);
 int bts_agch_max_queue_length(int T, int bcch_conf);
 
 enum ccch_msgt {
@@ -419,11 +648,17 @@ enum ccch_msgt {
 int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt, enum ccch_msgt ccch);
 int bts_supports_cipher(struct gsm_bts *bts, int rsl_cipher);
 uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time);
+void bts_sysinfo_sched_update(struct gsm_bts *bts);
 void regenerate_si3_restoctets(struct gsm_bts *bts);
 void regenerate_si4_restoctets(struct gsm_bts *bts);
 int get_si4_ro_offset(const uint8_t *si4_buf);
 
 void load_timer_start(struct gsm_bts *bts);
+void bts_proc_lat_add(struct gsm_bts *bts, enum bts_proc_lat stage, const struct timespec *start);
+
+int bts_mem_lock(struct gsm_bts *bts);
+void bts_mem_prefault_heap(struct gsm_bts *bts);
+int bts_hugepages_init(struct gsm_bts *bts);
 void load_timer_stop(struct gsm_bts *bts);
 bool load_timer_is_running(const struct gsm_bts *bts);
 void bts_update_status(enum bts_global_status which, int on);
@@ -447,6 +682,10 @@ int bts_set_c0_pwr_red(struct gsm_bts *bts, const uint8_t red);
 struct bts_agch_msg_cb {
 	uint32_t msg_id;
 	bool confirm;
+	/* set by bts_agch_enqueue() */
+	uint32_t deadline_fn;
+	uint32_t seq;
+	uint8_t heap_idx;
 } __attribute__ ((packed));
 
 #endif /* _BTS_H */
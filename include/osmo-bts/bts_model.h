@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 
+#include <osmocom/core/bits.h>
 #include <osmocom/gsm/tlv.h>
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/protocol/gsm_12_21.h>
@@ -64,7 +65,15 @@ void bts_model_phy_link_set_defaults(struct phy_link *plink);
 void bts_model_phy_instance_set_defaults(struct phy_instance *pinst);
 
 int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts);
+/* Deactivate the lchans of a timeslot given in lchan_mask (bit N = ts->lchan[N])
+ * at once, confirming each one like PRIM_INFO_DEACTIVATE.  Return -ENOTSUP to
+ * have them deactivated one by one instead. */
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask);
 void bts_model_ts_connect(struct gsm_bts_trx_ts *ts, enum gsm_phys_chan_config as_pchan);
+/* Encode a CBCH block (struct gsm412_block, 23 bytes) into its 4 bursts of
+ * 116 bits, when the message is accepted rather than for each transmission.
+ * Return -ENOTSUP if the PHY encodes the blocks itself. */
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2);
 
 /* BTS model specific implementations are expected to call these functions as a
  * response to some of the APIs above:
@@ -8,6 +8,9 @@
 
 struct pcu_sock_state;
 
+/* Max. number of PCU sockets: 'pcu-socket' plus the 'pcu-socket-shard's */
+#define PCU_SOCK_NUM_MAX 4
+
 /* GPRS NSVC; ip.access specific NM Object */
 struct gsm_gprs_nse;
 struct gsm_gprs_nsvc {
@@ -38,7 +41,9 @@ struct gsm_bts_sm {
 	unsigned int num_bts;
 	struct osmo_plmn_id plmn;
 	struct {
-		struct pcu_sock_state *pcu_state;
+		/* [0] is the 'pcu-socket', also serving CCCH/PACCH related
+		 * primitives, the others only serve the PDCH of their TRX */
+		struct pcu_sock_state *pcu_state[PCU_SOCK_NUM_MAX];
 		struct gsm_gprs_nse nse;
 	} gprs;
 };
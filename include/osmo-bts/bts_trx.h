@@ -2,6 +2,9 @@
 
 #include <osmo-bts/gsm_data.h>
 
+/* Last bucket of the RSL coalescing batch fill histogram */
+#define RSL_COALESCE_FILL_MAX 16
+
 struct gsm_bts_bb_trx {
 	struct gsm_abis_mo mo;
 };
@@ -40,7 +43,32 @@ struct gsm_bts_trx {
 	/* The associated PHY instance */
 	struct phy_instance *pinst;
 
+	/* PCU socket serving the PDCH of this TRX (0: the 'pcu-socket') */
+	uint8_t pcu_sock_nr;
+
+	/* Bitmap of timeslots having at least one active logical channel
+	 * on the primary or the shadow timeslot (maintained by the L1 scheduler) */
+	uint8_t l1sched_ts_active;
+
 	struct gsm_bts_trx_ts ts[TRX_NR_TS];
+
+	/* Direct mapped chan_nr -> lchan lookup table for get_lchan_by_chan_nr(),
+	 * (re)built by gsm_bts_trx_update_lchan_map() whenever the (shadow)
+	 * timeslots are set up or torn down. */
+	struct gsm_lchan *lchan_by_chan_nr[256];
+
+	/* Abis RSL Tx coalescing state and statistics, see abis_bts_rsl_sendmsg() */
+	struct {
+		bool corked;		/* TCP_CORK is set on the RSL socket */
+		unsigned int msgs;	/* messages in the current batch */
+		unsigned int bytes;	/* bytes in the current batch (incl. IPA header) */
+		struct timespec start;	/* time TCP_CORK was set for the current batch */
+		/* Number of flushed batches by number of messages handed to libosmo-abis */
+		unsigned long long batch_fill[RSL_COALESCE_FILL_MAX + 1];
+		/* Time TCP_CORK was set per batch (not the latency of the messages) */
+		unsigned long long corked_sum_us;
+		unsigned int corked_max_us;
+	} rsl_coalesce;
 };
 
 static inline struct gsm_bts_trx *gsm_bts_bb_trx_get_trx(struct gsm_bts_bb_trx *bb_transc) {
@@ -51,6 +79,7 @@ struct gsm_bts_trx *gsm_bts_trx_alloc(struct gsm_bts *bts);
 struct gsm_bts_trx *gsm_bts_trx_num(const struct gsm_bts *bts, int num);
 void gsm_bts_trx_init_shadow_ts(struct gsm_bts_trx *trx);
 void gsm_bts_trx_free_shadow_ts(struct gsm_bts_trx *trx);
+void gsm_bts_trx_update_lchan_map(struct gsm_bts_trx *trx);
 char *gsm_trx_name(const struct gsm_bts_trx *trx);
 const char *gsm_trx_unit_id(struct gsm_bts_trx *trx);
 
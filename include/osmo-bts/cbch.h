@@ -22,4 +22,10 @@ int bts_process_smscb_cmd(struct gsm_bts *bts, struct rsl_ie_cb_cmd_type cmd_typ
  * block for a given gsm_time.  outbuf must have 23 bytes of space. */
 int bts_cbch_get(struct gsm_bts *bts, uint8_t *outbuf, struct gsm_time *g_time);
 
+/* pre-encoded bursts of the block returned by bts_cbch_get() for fn, if any */
+const ubit_t *bts_cbch_get_bursts(struct gsm_bts *bts, uint32_t fn, const uint8_t *l2);
+
 void bts_cbch_reset(struct gsm_bts *bts);
+
+/* re-evaluate the CBCH load after a change of the queue target length / hysteresis */
+void bts_cbch_update_load(struct gsm_bts *bts);
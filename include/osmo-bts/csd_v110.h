@@ -2,6 +2,8 @@
 
 /* RFC4040 "clearmode" RTP payload length */
 #define RFC4040_RTP_PLEN 160
+/* Max. length of the radio bits decoded by csd_v110_rtp_decode() (4 * 60) */
+#define CSD_V110_RADIO_BITS_MAX 240
 
 struct gsm_lchan;
 
@@ -27,6 +27,7 @@ enum dtx_dl_amr_fsm_states {
 	ST_ONSET_V_REC,
 	ST_ONSET_F_REC,
 	ST_FACCH,
+	_NUM_DTX_DL_AMR_STATES
 };
 
 enum dtx_dl_amr_fsm_events {
@@ -38,7 +39,11 @@ enum dtx_dl_amr_fsm_events {
 	E_INHIB,
 	E_SID_F,
 	E_SID_U,
+	_NUM_DTX_DL_AMR_EVENTS
 };
 
 extern const struct value_string dtx_dl_amr_fsm_event_names[];
 extern struct osmo_fsm dtx_dl_amr_fsm;
+
+struct gsm_lchan;
+int dtx_dl_amr_trans(struct gsm_lchan *lchan, enum dtx_dl_amr_fsm_events e);
@@ -78,6 +78,8 @@ struct gsm_bts_trx_ts {
 	struct {
 		enum gsm_phys_chan_config pchan_is;
 		enum gsm_phys_chan_config pchan_want;
+		struct timespec switch_start;	/* see BTS_PROC_LAT_TS_SWITCH */
+		struct timespec pdch_start;	/* see BTS_PROC_LAT_IPAC_PDCH */
 	} dyn;
 
 	unsigned int flags;
@@ -110,6 +112,10 @@ struct gsm_bts_trx_ts {
 	/* Implementation specific structure(s) */
 	void *priv;
 
+	/* Scheduler CPU time spent on this timeslot (incl. its VAMOS shadow)
+	 * in the current load indication period, see sched_cpu_account() */
+	uint64_t cpu_load_ns;
+
 	/* VAMOS specific fields */
 	struct {
 		/* NULL if BTS_FEAT_VAMOS is not set */
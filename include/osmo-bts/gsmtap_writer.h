@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+
+struct gsmtap_writer;
+
+struct gsmtap_writer *gsmtap_writer_start(void *ctx, const char *local_host,
+					  const char *remote_host, uint16_t remote_port);
+int gsmtap_writer_enqueue(struct gsmtap_writer *gw, uint16_t arfcn, uint8_t ts,
+			  uint8_t chan_type, uint8_t ss, uint32_t fn,
+			  int8_t signal_dbm, int8_t snr, const uint8_t *data,
+			  unsigned int len);
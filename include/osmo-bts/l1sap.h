@@ -85,9 +85,27 @@ struct gsm_lchan *get_lchan_by_chan_nr(struct gsm_bts_trx *trx,
 /* allocate a msgb containing a osmo_phsap_prim + optional l2 data */
 struct msgb *l1sap_msgb_alloc(unsigned int l2_len);
 
+/* pool of msgbs backing l1sap_msgb_alloc(), one per size class */
+struct l1sap_msgb_pool {
+	unsigned int l2_len;		/* max. l2 length of this class */
+	struct llist_head free;		/* pooled (unused) msgbs */
+	unsigned int free_len;		/* number of pooled msgbs */
+	unsigned int in_use;		/* currently allocated from this class */
+	unsigned int in_use_max;	/* high-water mark of in_use */
+	unsigned long long hits;	/* allocations served from the pool */
+	unsigned long long misses;	/* allocations falling back to talloc */
+};
+
+const struct l1sap_msgb_pool *l1sap_msgb_pool_get(unsigned int idx);
+
 /* any L1 prim received from bts model */
 int l1sap_up(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap);
 
+/* Uplink PDTCH blocks decoded right into the PCU DATA.ind, bypassing PH-DATA.ind */
+struct msgb *l1sap_pdtch_ind_alloc(struct gsm_bts_trx *trx, uint8_t chan_nr, uint8_t **data);
+int l1sap_pdtch_ind_send(struct gsm_bts_trx *trx, struct msgb *msg,
+			 const struct ph_data_param *data_ind, uint8_t len);
+
 /* pcu (socket interface) sends us a data request primitive */
 int l1sap_pdch_req(struct gsm_bts_trx_ts *ts, int is_ptcch, uint32_t fn,
 	uint16_t arfcn, uint8_t block_nr, const uint8_t *data, uint8_t len);
@@ -100,6 +118,7 @@ void l1sap_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
 /* channel control */
 int l1sap_chan_act(struct gsm_bts_trx *trx, uint8_t chan_nr);
 int l1sap_chan_rel(struct gsm_bts_trx *trx, uint8_t chan_nr);
+int l1sap_ts_rel(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask);
 int l1sap_chan_deact_sacch(struct gsm_bts_trx *trx, uint8_t chan_nr);
 int l1sap_chan_modify(struct gsm_bts_trx *trx, uint8_t chan_nr);
 
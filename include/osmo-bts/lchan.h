@@ -20,6 +20,10 @@
 
 #include <osmo-bts/power_control.h>
 
+struct rtp_input_preen;
+struct media_io_chan;
+struct gsm_bts;
+
 #define LOGPLCHAN(lchan, ss, lvl, fmt, args...) LOGP(ss, lvl, "%s " fmt, gsm_lchan_name(lchan), ## args)
 
 enum lchan_ciph_state {
@@ -62,6 +66,27 @@ struct bts_ul_meas {
 	uint8_t inv_rssi;
 };
 
+/* Running sums of the Uplink measurements of one measurement period, see
+ * lchan_new_ul_meas().  All values are exact integer sums, so that the
+ * averages and the variance can be computed at the end of the period
+ * without having to keep the individual samples. */
+struct bts_ul_meas_acc {
+	/* number of (SUB) measurements accumulated */
+	uint8_t num;
+	uint8_t num_sub;
+	uint32_t ber10k_sum;
+	uint32_t ber10k_sub_sum;
+	uint32_t inv_rssi_sum;
+	uint32_t inv_rssi_sub_sum;
+	int32_t ci_cb_sum;
+	int32_t ci_cb_sub_sum;
+	int32_t toa256_sum;
+	/* sum of the squared toa256 values, for the standard deviation */
+	uint64_t toa256_sq_sum;
+	int16_t toa256_min;
+	int16_t toa256_max;
+};
+
 struct amr_mode {
 	uint8_t mode;
 	uint8_t threshold;
@@ -72,6 +97,10 @@ struct amr_multirate_conf {
 	uint8_t gsm48_ie[2];
 	struct amr_mode mode[4];
 	uint8_t num_modes;
+	/* derived from the above by amr_mr_conf_update(), for the per-frame code */
+	int8_t mode_idx[8];		/* codec mode (0..7) -> mode index, -1 if not in the set */
+	int16_t thresh_dn_cb[4];	/* per mode index: degrade below THR_MX_Dn(i - 1) (cB) */
+	int16_t thresh_up_cb[4];	/* per mode index: upgrade above THR_MX_Up(i) (cB) */
 };
 
 enum lchan_csd_mode {
@@ -127,6 +156,8 @@ struct lchan_power_ctrl_state {
 	 * (attenuation, in dB). */
 	uint8_t current;
 	uint8_t max;
+	/* Direction of the last change (+1 raise, -1 lower, 0 none yet) */
+	int8_t last_dir;
 };
 
 struct lchan_ta_ctrl_state {
@@ -134,9 +165,15 @@ struct lchan_ta_ctrl_state {
 	int skip_block_num;
 	/* Currently requested TA */
 	uint8_t current;
+	/* Direction of the last change (+1 raise, -1 lower, 0 none yet) */
+	int8_t last_dir;
 };
 
 struct gsm_lchan {
+	/* The fields below are accessed for every frame on an active channel;
+	 * keep them together at the start, ahead of the configuration and the
+	 * large SACCH/LAPDm buffers, so that they share few cache lines. */
+
 	/* The TS that we're part of */
 	struct gsm_bts_trx_ts *ts;
 	/* The logical subslot number in the TS */
@@ -153,12 +190,22 @@ struct gsm_lchan {
 	/* State */
 	enum gsm_lchan_state state;
 	const char *broken_reason;
-	/* Encryption information */
-	struct {
-		uint8_t alg_id;
-		uint8_t key_len;
-		uint8_t key[MAX_A5_KEY_LEN];
-	} encr;
+
+	/* BTS-side ciphering state (rx only, bi-directional, ...) */
+	uint8_t ciph_state;
+	uint8_t ciph_ns;
+	uint8_t loopback;
+
+	/* 3GPP TS 48.058 § 9.3.37: [0; 255] ok, -1 means invalid*/
+	int16_t ms_t_offs;
+	/* 3GPP TS 45.010 § 1.2 round trip propagation delay (in symbols) or -1 */
+	int16_t p_offs;
+
+	/* S counter for link loss */
+	int s;
+
+	/* RTP header Marker bit to indicate beginning of speech after pause  */
+	bool rtp_tx_marker;
 
 	struct {
 		uint32_t bound_ip;
@@ -182,51 +229,23 @@ struct gsm_lchan {
 			struct osmo_rtp_handle *rtpst;
 		} osmux;
 		struct osmo_rtp_socket *rtp_socket;
+		/* RTP receive queue of the media thread (NULL: polled here) */
+		struct media_io_chan *media;
+		/* RTP input validation for the channel mode, see rtp_input_preen_setup() */
+		const struct rtp_input_preen *preen;
 	} abis_ip;
 
-	char *name;
-
-	/* For handover, activation is described in 3GPP TS 48.058 4.1.3 and 4.1.4:
-	 *
-	 *          |          | Access ||  transmit         |  activate
-	 *          | MS Power | Delay  ||  on main channel  |  dl SACCH
-	 * ----------------------------------------------------------------------
-	 * async ho   no         *     -->  yes                 no
-	 * async ho   yes        *     -->  yes                 may be started
-	 * sync ho    no         no    -->  yes                 no
-	 * sync ho    yes        no    -->  yes                 may be started
-	 * sync ho    yes        yes   -->  yes                 shall be started
-	 *
-	 * Always start the main channel immediately.
-	 * want_dl_sacch_active indicates whether dl SACCH should be activated on CHAN ACT.
-	 */
-	bool want_dl_sacch_active;
-
-	/* Number of different GsmL1_Sapi_t used in osmo_bts_sysmo is 23.
-	 * Currently we don't share these headers so this is a magic number. */
-	struct llist_head sapi_cmds;
-	uint8_t sapis_dl[23];
-	uint8_t sapis_ul[23];
-	struct lapdm_channel lapdm_ch;
-	struct llist_head dl_tch_queue;
-	unsigned int dl_tch_queue_len;
-	struct {
-		/* bitmask of all SI that are present/valid in si_buf */
-		uint32_t valid;
-		/* bitmask of all SI that do not mirror the BTS-global SI values */
-		uint32_t overridden;
-		uint32_t last;
-		/* buffers where we put the pre-computed SI:
-		   SI2Q_MAX_NUM is the max number of SI2quater messages (see 3GPP TS 44.018) */
-		sysinfo_buf_t buf[_MAX_SYSINFO_TYPE][SI2Q_MAX_NUM];
-	} si;
 	struct {
 		uint8_t flags;
 		/* RSL measurement result number, 0 at lchan_act */
 		uint8_t res_nr;
-		/* number of measurements stored in array below */
+		/* number of measurements received in this period */
 		uint8_t num_ul_meas;
-		struct bts_ul_meas uplink[MAX_NUM_UL_MEAS];
+		/* accumulated measurements of this period */
+		struct bts_ul_meas_acc ul_acc;
+		/* accumulated measurements of the previous (overrun) period,
+		 * in case the computation was not executed at its end */
+		struct bts_ul_meas_acc ul_acc_prev;
 		/* last L1 header from the MS */
 		struct rsl_l1_info l1_info;
 		struct gsm_meas_rep_unidir ul_res;
@@ -246,13 +265,18 @@ struct gsm_lchan {
 		} ext;
 		/* Interference levels reported by PHY (in dBm) */
 		int16_t interf_meas_avg_dbm; /* Average value */
-		int16_t interf_meas_dbm[31]; /* Intave max is 31 */
-		uint8_t interf_meas_num;
+		int32_t interf_meas_sum; /* Sum of the collected samples */
+		uint8_t interf_meas_num; /* Number of the collected samples */
 		uint8_t interf_band;
 	} meas;
+
 	struct {
 		struct amr_multirate_conf amr_mr;
 		struct {
+			/* DTX DL AMR state (enum dtx_dl_amr_fsm_states), see dtx_dl_amr_trans() */
+			uint8_t dl_amr_state;
+			bool dl_amr_active;
+			/* optional mirror of dl_amr_state for logging, may be NULL */
 			struct osmo_fsm_inst *dl_amr_fsm;
 			/* TCH cache */
 			uint8_t cache[20];
@@ -288,44 +312,27 @@ struct gsm_lchan {
 
 	} tch;
 
-	/* 3GPP TS 48.058 § 9.3.37: [0; 255] ok, -1 means invalid*/
-	int16_t ms_t_offs;
-	/* 3GPP TS 45.010 § 1.2 round trip propagation delay (in symbols) or -1 */
-	int16_t p_offs;
-
-	/* BTS-side ciphering state (rx only, bi-directional, ...) */
-	uint8_t ciph_state;
-	uint8_t ciph_ns;
-	uint8_t loopback;
-	struct {
-		uint8_t active;
-		uint8_t ref;
-		/* T3105: PHYS INF retransmission */
-		struct osmo_timer_list t3105;
-		/* counts up to Ny1 */
-		unsigned int phys_info_count;
-	} ho;
-	struct {
-		bool listener_detected;
-		uint8_t talker_active;
-		uint8_t ref;
-		uint32_t fn;
-		/* T3115: VGCS UPLINK GRANT retransmission */
-		struct osmo_timer_list t3115;
-		/* counts up to Ny2 */
-		unsigned int vgcs_ul_grant_count;
-		/* uplink free message */
-		bool uplink_free;
-		uint8_t uplink_free_msg[GSM_MACBLOCK_LEN];
-	} asci;
-	/* S counter for link loss */
-	int s;
-	/* Kind of the release/activation. E.g. RSL or PCU */
-	enum lchan_rel_act_kind rel_act_kind;
-	/* Pending RSL CHANnel ACTIVation message */
-	struct msgb *pending_chan_activ;
-	/* RTP header Marker bit to indicate beginning of speech after pause  */
-	bool rtp_tx_marker;
+	struct llist_head dl_tch_queue;
+	unsigned int dl_tch_queue_len;
+	/* DL TCH jitter buffer: if enabled, dl_tch_queue is kept ordered by
+	 * RTP timestamp, see lchan_dl_tch_jb_enqueue() */
+	struct gsm_lchan_dl_tch_jb {
+		unsigned int max_depth;	/* max. number of frames, 0 = disabled */
+		bool adaptive;
+		bool started;		/* prebuffering done, frames are played out */
+		uint32_t play_ts;	/* RTP timestamp of the next frame to play out */
+		bool transit_valid;
+		uint32_t transit;	/* (arrival time - RTP timestamp) of the last frame */
+		uint32_t jitter16;	/* interarrival jitter (RFC 3550), in 1/16 samples */
+		unsigned int gap;	/* number of consecutive underruns */
+		struct {
+			unsigned int late;	/* arrived after their playout time */
+			unsigned int early;	/* arrived too early, no room in the buffer */
+			unsigned int reorder;	/* arrived out of order (but in time) */
+			unsigned int dup;	/* duplicate RTP timestamp */
+			unsigned int underrun;	/* nothing to play out */
+		} stats;
+	} dl_tch_jb;
 
 	/* TA Control Loop */
 	struct lchan_ta_ctrl_state ta_ctrl;
@@ -334,19 +341,10 @@ struct gsm_lchan {
 	struct lchan_power_ctrl_state ms_power_ctrl;
 	struct lchan_power_ctrl_state bs_power_ctrl;
 
-	/* MS/BS Dynamic Power Control parameters */
-	struct gsm_power_ctrl_params ms_dpc_params;
-	struct gsm_power_ctrl_params bs_dpc_params;
-
 	/* Temporary ACCH overpower capabilities and state */
 	struct abis_rsl_osmo_temp_ovp_acch_cap top_acch_cap;
 	bool top_acch_active;
 
-	struct msgb *pending_rel_ind_msg;
-
-	/* ECU (Error Concealment Unit) state */
-	struct osmo_ecu_state *ecu_state;
-
 	/* Repeated ACCH capabilities and current state */
 	struct abis_rsl_osmo_rep_acch_cap rep_acch_cap;
 	struct {
@@ -359,11 +357,116 @@ struct gsm_lchan {
 		struct msgb *dl_sacch_msg;
 	} rep_acch;
 
+	/* ECU (Error Concealment Unit) state */
+	struct osmo_ecu_state *ecu_state;
+
+	/* The fields below are mostly used during activation, release and
+	 * handover, or only every SACCH period. */
+
+	/* Encryption information */
+	struct {
+		uint8_t alg_id;
+		uint8_t key_len;
+		uint8_t key[MAX_A5_KEY_LEN];
+	} encr;
+
+	char *name;
+
+	/* For handover, activation is described in 3GPP TS 48.058 4.1.3 and 4.1.4:
+	 *
+	 *          |          | Access ||  transmit         |  activate
+	 *          | MS Power | Delay  ||  on main channel  |  dl SACCH
+	 * ----------------------------------------------------------------------
+	 * async ho   no         *     -->  yes                 no
+	 * async ho   yes        *     -->  yes                 may be started
+	 * sync ho    no         no    -->  yes                 no
+	 * sync ho    yes        no    -->  yes                 may be started
+	 * sync ho    yes        yes   -->  yes                 shall be started
+	 *
+	 * Always start the main channel immediately.
+	 * want_dl_sacch_active indicates whether dl SACCH should be activated on CHAN ACT.
+	 */
+	bool want_dl_sacch_active;
+
+	/* Kind of the release/activation. E.g. RSL or PCU */
+	enum lchan_rel_act_kind rel_act_kind;
+
+	/* Pending RSL CHANnel ACTIVation message */
+	struct msgb *pending_chan_activ;
+	/* Time of the CHANnel ACTIVation stages (zero if not pending), see enum bts_proc_lat */
+	struct {
+		struct timespec rx;		/* CHAN ACTIV received */
+		struct timespec phy_req;	/* activation requested from the PHY */
+	} chan_act_time;
+
+	struct msgb *pending_rel_ind_msg;
+
 	/* Cached early Immediate Assignment message: if the Immediate Assignment arrives before the channel is
 	 * confirmed active, then cache it here and send it once the channel is confirmed to be active. This is related
 	 * to the Early IA feature, see OsmoBSC config option 'immediate-assignment pre-chan-ack'. */
 	struct msgb *early_rr_ia;
 	struct osmo_timer_list early_rr_ia_delay;
+
+	struct {
+		uint8_t active;
+		uint8_t ref;
+		/* T3105: PHYS INF retransmission */
+		struct osmo_timer_list t3105;
+		/* counts up to Ny1 */
+		unsigned int phys_info_count;
+		/* HANDOver DETect sent, see BTS_PROC_LAT_HO_FIRST_FRAME */
+		struct timespec det_time;
+	} ho;
+
+	struct {
+		bool listener_detected;
+		uint8_t talker_active;
+		uint8_t ref;
+		uint32_t fn;
+		/* T3115: VGCS UPLINK GRANT retransmission */
+		struct osmo_timer_list t3115;
+		/* counts up to Ny2 */
+		unsigned int vgcs_ul_grant_count;
+		/* best talker candidate so far, see vgcs_rach() */
+		struct {
+			uint8_t ra;
+			uint8_t acc_delay;
+			int16_t toa256;
+			int8_t rssi;
+			uint32_t fn;
+			unsigned int num;		/* number of competing talker RACHs */
+			struct timespec first;		/* first talker RACH received */
+		} cand;
+		/* end of the talker selection window (vgcs-talker-window) */
+		struct osmo_timer_list talker_window;
+		/* uplink free message */
+		bool uplink_free;
+		uint8_t uplink_free_msg[GSM_MACBLOCK_LEN];
+	} asci;
+
+	/* MS/BS Dynamic Power Control parameters */
+	struct gsm_power_ctrl_params ms_dpc_params;
+	struct gsm_power_ctrl_params bs_dpc_params;
+
+	/* Number of different GsmL1_Sapi_t used in osmo_bts_sysmo is 23.
+	 * Currently we don't share these headers so this is a magic number. */
+	struct llist_head sapi_cmds;
+	uint8_t sapis_dl[23];
+	uint8_t sapis_ul[23];
+	struct lapdm_channel lapdm_ch;
+
+	/* SACCH filling: the SI which are not overridden are read from the
+	 * BTS-global buffers, see lchan_sacch_get() */
+	struct {
+		/* bitmask of the overridden SI that are present/valid in si_buf */
+		uint32_t valid;
+		/* bitmask of all SI that do not mirror the BTS-global SI values */
+		uint32_t overridden;
+		uint32_t last;
+		/* buffers where we put the pre-computed SI:
+		   SI2Q_MAX_NUM is the max number of SI2quater messages (see 3GPP TS 44.018) */
+		sysinfo_buf_t buf[_MAX_SYSINFO_TYPE][SI2Q_MAX_NUM];
+	} si;
 };
 
 extern const struct value_string lchan_ciph_state_names[];
@@ -374,10 +477,18 @@ static inline const char *lchan_ciph_state_name(uint8_t state)
 
 #define GSM_LCHAN_SI(lchan, i) (void *)((lchan)->si.buf[i][0])
 
+/* bitmask of the SI types which are sent on the SACCH */
+#define LCHAN_SACCH_SI_MASK \
+	((1 << SYSINFO_TYPE_5) | (1 << SYSINFO_TYPE_5bis) | (1 << SYSINFO_TYPE_5ter) | \
+	 (1 << SYSINFO_TYPE_6) | (1 << SYSINFO_TYPE_10) | (1 << SYSINFO_TYPE_EMO) | \
+	 (1 << SYSINFO_TYPE_MEAS_INFO))
+
 void gsm_lchan_init(struct gsm_lchan *lchan, struct gsm_bts_trx_ts *ts, unsigned int lchan_nr);
 void gsm_lchan_name_update(struct gsm_lchan *lchan);
 int lchan_init_lapdm(struct gsm_lchan *lchan);
 void gsm_lchan_release(struct gsm_lchan *lchan, enum lchan_rel_act_kind rel_kind);
+void gsm_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask,
+			   enum lchan_rel_act_kind rel_kind);
 int lchan_deactivate(struct gsm_lchan *lchan);
 const char *gsm_lchans_name(enum gsm_lchan_state s);
 
@@ -386,6 +497,7 @@ static inline char *gsm_lchan_name(const struct gsm_lchan *lchan)
 	return lchan->name;
 }
 
+uint32_t lchan_sacch_si_valid(const struct gsm_lchan *lchan);
 uint8_t *lchan_sacch_get(struct gsm_lchan *lchan);
 
 uint8_t gsm_lchan2chan_nr(const struct gsm_lchan *lchan);
@@ -403,8 +515,15 @@ void lchan_set_state(struct gsm_lchan *lchan, enum gsm_lchan_state state);
 int lchan_rtp_socket_create(struct gsm_lchan *lchan, const char *bind_ip);
 int lchan_rtp_socket_connect(struct gsm_lchan *lchan, const struct in_addr *ia, uint16_t connect_port);
 void lchan_rtp_socket_free(struct gsm_lchan *lchan);
+void lchan_rtp_media_poll(struct gsm_lchan *lchan);
+int lchan_rtp_pool_resize(struct gsm_bts *bts, unsigned int size);
+void lchan_rtp_pool_flush(struct gsm_bts *bts);
 
 void lchan_dl_tch_queue_enqueue(struct gsm_lchan *lchan, struct msgb *msg, unsigned int limit);
+void lchan_dl_tch_jb_reset(struct gsm_lchan *lchan, unsigned int max_ms, bool adaptive);
+unsigned int lchan_dl_tch_jb_target(const struct gsm_lchan *lchan);
+void lchan_dl_tch_jb_enqueue(struct gsm_lchan *lchan, struct msgb *msg);
+struct msgb *lchan_dl_tch_jb_dequeue(struct gsm_lchan *lchan);
 
 static inline bool lchan_is_dcch(const struct gsm_lchan *lchan)
 {
@@ -0,0 +1,5 @@
+#pragma once
+
+struct rate_ctr;
+
+int log_async_start(struct rate_ctr *drop_ctr);
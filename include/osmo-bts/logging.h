@@ -4,6 +4,8 @@
 #define DEBUG
 #include <osmocom/core/logging.h>
 
+#include "btsconfig.h"
+
 enum {
 	DRSL,
 	DOML,
@@ -42,6 +44,22 @@ extern const struct log_info bts_log_info;
 #define LOGPLCFN(lchan, fn, ss, lvl, fmt, args...) \
 	LOGP(ss, lvl, "%s %s " fmt, gsm_lchan_name(lchan), gsm_fn_as_gsmtime_str(fn), ## args)
 
+/* Whether a message of the given level is compiled in on hot paths (per burst,
+ * per TDMA frame).  With --disable-hotpath-debug, LOGL_DEBUG messages on these
+ * paths are removed at compile time, including the level check itself. */
+#ifdef DISABLE_HOTPATH_DEBUG
+#define LOG_HOTPATH_ENABLED(lvl) ((lvl) > LOGL_DEBUG)
+#else
+#define LOG_HOTPATH_ENABLED(lvl) 1
+#endif
+
+/* LOGP for hot paths, see LOG_HOTPATH_ENABLED() */
+#define LOGP_HOTPATH(ss, lvl, fmt, args...) \
+	do { \
+		if (LOG_HOTPATH_ENABLED(lvl)) \
+			LOGP(ss, lvl, fmt, ## args); \
+	} while (0)
+
 /* LOGP with lchan + gsm_time prefix */
 #define LOGPLCGT(lchan, gt, ss, lvl, fmt, args...) \
 	LOGP(ss, lvl, "%s %s " fmt, gsm_lchan_name(lchan), osmo_dump_gsmtime(gt), ## args)
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct media_io;
+struct media_io_chan;
+
+struct media_io_chan_stats {
+	uint32_t packets;	/* RTP packets received */
+	uint32_t octets;	/* RTP payload octets received */
+	uint32_t lost;		/* RTP packets missing in the sequence */
+	uint32_t drops;		/* RTP packets dropped (receive queue full) */
+	unsigned int depth;	/* packets in the receive queue */
+	unsigned int depth_max;	/* highest depth seen on a poll */
+};
+
+typedef void (*media_io_rx_cb)(void *priv, const uint8_t *rtp_pl, unsigned int rtp_pl_len,
+			       uint16_t seq_number, uint32_t timestamp, bool marker);
+
+struct media_io *media_io_start(void *ctx);
+struct media_io_chan *media_io_chan_add(struct media_io *mio, int fd);
+void media_io_chan_del(struct media_io *mio, struct media_io_chan *mc);
+unsigned int media_io_chan_poll(struct media_io_chan *mc, media_io_rx_cb cb, void *priv,
+				uint32_t *new_drops);
+void media_io_chan_stats(const struct media_io_chan *mc, struct media_io_chan_stats *st);
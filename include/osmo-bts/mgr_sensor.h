@@ -0,0 +1,70 @@
+/* Sensor supervision core shared by the BTS management daemons */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: AGPL-3.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include <osmocom/core/timer.h>
+
+/* Readings closer than this to their warning threshold (in the unit of the
+ * threshold, i.e. degree Celsius for temperatures) are sampled faster */
+#define MGR_SENSOR_NEAR_MARGIN	5
+
+enum mgr_sensor_state {
+	STATE_NORMAL,		/* Everything is fine */
+	STATE_WARNING_HYST,	/* Go back to normal next? */
+	STATE_WARNING,		/* We are above the warning threshold */
+	STATE_CRITICAL,		/* We have an issue. Wait for below warning */
+};
+
+const char *mgr_sensor_state_name(enum mgr_sensor_state state);
+int mgr_sensor_next_state(enum mgr_sensor_state current_state, int critical, int warning);
+
+/* Outcome of one round of sensor readings */
+struct mgr_sensor_result {
+	int warning;		/* some warning threshold was passed */
+	int critical;		/* some critical threshold was passed */
+	bool near;		/* some reading is close to its warning threshold */
+};
+
+void mgr_sensor_eval(struct mgr_sensor_result *res, int value, int thresh_warn, int thresh_crit);
+
+/* Periodic sensor check, sampling faster close to the thresholds */
+struct mgr_sensor_sched {
+	struct osmo_timer_list timer;
+	unsigned int period;		/* nominal period (seconds) */
+	unsigned int fast_period;	/* period near the thresholds (seconds) */
+	bool fast;			/* last check asked for the fast period */
+	int log_ss;			/* logging subsystem of the daemon */
+
+	/*! check all sensors; return true to use the fast period until the next check */
+	bool (*check_cb)(void *data);
+	void *data;
+};
+
+void mgr_sensor_sched_init(struct mgr_sensor_sched *s, unsigned int period, unsigned int fast_period,
+			   int log_ss, bool (*check_cb)(void *data), void *data);
+void mgr_sensor_sched_start(struct mgr_sensor_sched *s);
+void mgr_sensor_sched_trigger(struct mgr_sensor_sched *s);
+void mgr_sensor_sched_rearm(struct mgr_sensor_sched *s);
+int mgr_sensor_watch(struct mgr_sensor_sched *s, void *ctx, const char *path);
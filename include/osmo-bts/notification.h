@@ -24,6 +24,10 @@
 
 #pragma once
 
+/* Max. length of an encoded "Group Call information" (TS 44.018 9.1.21a):
+ * 36 bits of Group Call Reference, the Group Channel Description and 2 flags */
+#define ASCI_GCI_MAX_LEN	((36 + 1 + 255 * 8 + 1 + 7) / 8)
+
 /* one [concurrent] ASCI (VBS/VGCS) notification */
 struct asci_notification {
 	struct llist_head list;	/* linked to bts->asci.notifications */
@@ -43,6 +47,12 @@ struct asci_notification {
 		bool present;
 		struct rsl_ie_nch_drx_info value;
 	} nch_drx_info;
+
+	/* "Group Call information" CSN.1 structure, encoded once on creation */
+	struct {
+		uint8_t data[ASCI_GCI_MAX_LEN];
+		unsigned int bits;
+	} gci;
 };
 
 int bts_asci_notification_add(struct gsm_bts *bts, const uint8_t *group_call_ref, const uint8_t *chan_desc,
@@ -55,6 +65,7 @@ int bts_asci_notification_reset(struct gsm_bts *bts);
 const struct asci_notification *bts_asci_notification_get_next(struct gsm_bts *bts);
 
 void append_group_call_information(struct bitvec *bv, const uint8_t *gcr, const uint8_t *ch_desc, uint8_t ch_desc_len);
+void append_asci_notification(struct bitvec *bv, const struct asci_notification *n);
 
 int bts_asci_notify_nch_gen_msg(struct gsm_bts *bts, uint8_t *out_buf);
 int bts_asci_notify_facch_gen_msg(struct gsm_bts *bts, uint8_t *out_buf, const uint8_t *group_call_ref,
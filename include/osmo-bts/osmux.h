@@ -14,6 +14,14 @@ enum osmux_usage {
 	OSMUX_USAGE_ONLY = 2,
 };
 
+enum osmux_batch_flush {
+	OSMUX_BATCH_FLUSH_TIMER = 0,	/* by the batch timer of libosmo-netif */
+	OSMUX_BATCH_FLUSH_TDMA = 1,	/* at every speech block period (20 ms) */
+};
+
+/* Last bucket of the batch fill histogram, counts OSMUX_BATCH_FILL_MAX or more frames */
+#define OSMUX_BATCH_FILL_MAX 16
+
 struct osmux_state {
 	enum osmux_usage use;
 	char *local_addr;
@@ -22,7 +30,12 @@ struct osmux_state {
 	uint8_t batch_factor;
 	unsigned int batch_size;
 	bool dummy_padding;
+	enum osmux_batch_flush batch_flush;
 	struct llist_head osmux_handle_list;
+	/* Number of delivered batches by number of contained frames */
+	unsigned long long batch_fill[OSMUX_BATCH_FILL_MAX + 1];
+	/* Connected lchans by local CID (those are unique), see osmux_lchan_find() */
+	struct gsm_lchan *lchan_by_cid[OSMUX_CID_MAX + 1];
 };
 
 /* Contains a "struct osmux_in_handle" towards a specific peer (remote IPaddr+port) */
@@ -32,11 +45,17 @@ struct osmux_handle {
 	struct osmux_in_handle *in;
 	struct osmo_sockaddr rem_addr;
 	int refcnt;
+	/* Number of frames fed into the current batch */
+	unsigned int pending;
 };
 
 int bts_osmux_init(struct gsm_bts *bts);
 void bts_osmux_release(struct gsm_bts *bts);
 int bts_osmux_open(struct gsm_bts *bts);
+void bts_osmux_tdma_tick(struct gsm_bts *bts, uint32_t fn);
+
+struct gsm_lchan *osmux_lchan_find(const struct gsm_bts *bts, const struct osmo_sockaddr *rem_addr,
+				   uint8_t osmux_cid);
 
 int lchan_osmux_init(struct gsm_lchan *lchan, uint8_t rtp_payload);
 void lchan_osmux_release(struct gsm_lchan *lchan);
@@ -57,6 +57,22 @@ struct p3_rest_octets {
 	} nln_pch;
 };
 
+/* paging blocks per 51-multiframe * max. BS_PA_MFRMS */
+#define PAGING_GROUPS_MAX	(9 * 9)
+/* bucket i: first sent less than 51 << i frames after queueing, last: later */
+#define PAGING_WAIT_HIST_LEN	9
+/* bucket i: sent i + 1 times before expiry, last: more often */
+#define PAGING_REPEAT_HIST_LEN	16
+
+/* statistics of the normal paging records (see 'show bts <0-255> paging') */
+struct paging_stats {
+	unsigned long long wait_hist[PAGING_WAIT_HIST_LEN];
+	unsigned long long repeat_hist[PAGING_REPEAT_HIST_LEN];
+	/* current and max. number of records per paging group */
+	unsigned int group_len[PAGING_GROUPS_MAX];
+	unsigned int group_len_max[PAGING_GROUPS_MAX];
+};
+
 /* initialize paging code */
 struct paging_state *paging_init(struct gsm_bts *bts,
 				 unsigned int num_paging_max,
@@ -103,5 +119,6 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 int paging_group_queue_empty(struct paging_state *ps, uint8_t group);
 int paging_queue_length(struct paging_state *ps);
 int paging_buffer_space(struct paging_state *ps);
+const struct paging_stats *paging_get_stats(const struct paging_state *ps);
 
 #endif
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct gsm_lchan;
+struct pcap_capture;
+
+/* pcapng capture of the GSMTAP Um frames and RTP, see 'bts N pcap-capture start' */
+
+struct pcap_capture_stats {
+	uint64_t num_pkts;	/* packets written since the start */
+	uint64_t num_files;	/* files started (including the current one) */
+	size_t used;		/* bytes written to the current file */
+	size_t file_size;	/* max. size of each file */
+	const char *path;	/* name of the current file */
+};
+
+struct pcap_capture *pcap_capture_start(void *ctx, const char *path, size_t file_size,
+					unsigned int max_files);
+void pcap_capture_stop(struct pcap_capture *cap);
+void pcap_capture_get_stats(const struct pcap_capture *cap, struct pcap_capture_stats *st);
+
+void pcap_capture_gsmtap(struct pcap_capture *cap, uint16_t arfcn, uint8_t ts,
+			 uint8_t chan_type, uint8_t ss, uint32_t fn,
+			 int8_t signal_dbm, int8_t snr, const uint8_t *data,
+			 unsigned int len);
+void pcap_capture_rtp(struct pcap_capture *cap, const struct gsm_lchan *lchan, bool uplink,
+		      uint16_t seq, uint32_t timestamp, bool marker,
+		      const uint8_t *pl, unsigned int pl_len);
@@ -1,6 +1,7 @@
 #ifndef _PCU_IF_H
 #define _PCU_IF_H
 
+#include <osmocom/core/linuxlist.h>
 #include <osmo-bts/pcuif_proto.h>
 
 struct gsm_bts_sm;
@@ -17,10 +18,16 @@ int pcu_tx_rts_req(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 	uint16_t arfcn, uint8_t block_nr, uint8_t *data, uint8_t len,
 		    int8_t rssi, uint16_t ber10k, int16_t bto, int16_t lqual);
+/* DATA.ind filled in place: the payload (up to 162 bytes) is written to *data
+ * between pcu_data_ind_alloc() and pcu_data_ind_send() */
+struct msgb *pcu_data_ind_alloc(const struct gsm_bts *bts, uint8_t **data);
+int pcu_data_ind_send(struct gsm_bts_trx_ts *ts, struct msgb *msg, uint8_t sapi, uint32_t fn,
+	uint16_t arfcn, uint8_t block_nr, uint8_t len,
+		      int8_t rssi, uint16_t ber10k, int16_t bto, int16_t lqual);
 int pcu_tx_rach_ind(uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr,
 		    int16_t qta, uint16_t ra, uint32_t fn, uint8_t is_11bit,
 		    enum ph_burst_type burst_type, uint8_t sapi);
-int pcu_tx_time_ind(uint32_t fn);
+int pcu_tx_time_ind(struct gsm_bts *bts, uint32_t fn, bool discont);
 int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn);
 int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed);
 int pcu_tx_data_cnf(uint32_t msg_id, uint8_t sapi);
@@ -28,8 +35,22 @@ int pcu_tx_susp_req(struct gsm_lchan *lchan, uint32_t tlli, const uint8_t *ra_id
 int pcu_sock_send(struct msgb *msg);
 
 int pcu_sock_init(const char *path, int qlength_max);
+int pcu_sock_init_shard(uint8_t nr, const char *path, int qlength_max);
 void pcu_sock_exit(void);
 
 bool pcu_connected(void);
+bool pcu_connected_trx(const struct gsm_bts_trx *trx);
+bool pcu_sock_queue_len(unsigned int *len, unsigned int *len_hwm, unsigned int *len_max);
+
+struct pcu_msgb_pool {
+	struct llist_head free;		/* pooled (unused) msgbs */
+	unsigned int free_len;		/* number of pooled msgbs */
+	unsigned int in_use;		/* currently allocated from the pool */
+	unsigned int in_use_max;	/* high-water mark of in_use */
+	unsigned long long hits;	/* allocations served from the pool */
+	unsigned long long misses;	/* allocations falling back to talloc */
+};
+
+const struct pcu_msgb_pool *pcu_msgb_pool_get(void);
 
 #endif /* _PCU_IF_H */
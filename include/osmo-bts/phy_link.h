@@ -47,8 +47,46 @@ struct phy_link {
 			struct osmo_fd trx_ofd_clk;
 			uint32_t clock_advance;
 			uint32_t rts_advance;
+			/* closed-loop control of rts_advance, see 'osmotrx rts-advance auto' */
+			struct osmotrx_rts_advance_auto {
+				bool enabled;
+				uint32_t min;
+				uint32_t max;
+				bool dl_late_valid; /* has dl_late_last been sampled yet? */
+				uint64_t dl_late_last; /* sum of DL_LATE counters at the last check */
+				unsigned int quiet_periods; /* checks without late prims and high load */
+			} rts_advance_auto;
 			bool use_legacy_setbsic;
+			bool clock_filter; /* smooth the CLOCK indications, see 'osmotrx clock-filter' */
 			uint8_t trxd_pdu_ver_max; /* Maximum TRXD PDU version to negotiate */
+			uint8_t trxd_rx_batch; /* Max TRXD datagrams per recvmmsg() call (1: plain recv()) */
+			uint8_t trxc_window; /* Max TRXC commands in flight (1: strictly serialized) */
+			bool trxd_shared; /* all instances use the TRXD socket of instance 0 */
+			bool trxd_seqnum; /* TRXD datagrams end with a sequence number (TRXDv2+) */
+			uint8_t ul_decoder_threads; /* Uplink decoder threads (0: decode inline) */
+			/* declare Uplink blocks bad without decoding, see 'osmotrx ul-decode-gate' */
+			struct {
+				bool erasures; /* all soft-bits zero (NOPE.ind, missing bursts) */
+				bool ci; /* average C/I below ci_cb */
+				int16_t ci_cb;
+			} ul_decode_gate;
+			/* FACCH prediction from the stealing flags (0: off), see
+			 * 'osmotrx ul-facch-steal-threshold' */
+			uint16_t ul_facch_steal_thresh;
+			/* longest a DL FACCH may wait to spare a speech frame (0: never
+			 * waits), see 'osmotrx dl-facch-max-delay' */
+			uint16_t dl_facch_max_delay_ms;
+			/* encode xCCH blocks in the slack of the preceding frames,
+			 * see 'osmotrx dl-encode-ahead' */
+			bool dl_encode_ahead;
+			/* keep the work close to the transceiver, see 'osmotrx cpu-placement' */
+			struct {
+				char *cpus; /* CPU list for the main and worker threads (NULL: not set) */
+				int mem_node; /* preferred NUMA node for memory (-1: not set) */
+				int trxd_incoming_cpu; /* SO_INCOMING_CPU of the TRXD sockets (-1: not set) */
+				unsigned int trxd_busy_poll; /* SO_BUSY_POLL of the TRXD sockets in us (0: not set) */
+			} placement;
+			struct trx_capture *capture; /* TRXD capture ring, see 'phy N capture start' */
 			bool powered; /* last POWERON (true) or POWEROFF (false) confirmed */
 			bool poweron_sent; /* is there a POWERON in transit? */
 			bool poweroff_sent; /* is there a POWEROFF in transit? */
@@ -60,7 +98,9 @@ struct phy_link {
 			uint16_t bts_mcast_port;
 			char *ms_mcast_group;		/* MS are listening to this group */
 			uint16_t ms_mcast_port;
-			struct virt_um_inst *virt_um;
+			struct virt_um_inst *virt_um;	/* shared by all instances (TRX) */
+			unsigned int num_trx_open;	/* instances whose TRX is not closed yet */
+			struct phy_instance **arfcn_map; /* ARFCN -> instance cache */
 		} virt;
 		struct {
 			/* MAC address of the PHY */
@@ -78,6 +118,7 @@ struct phy_link {
 			bool tx_atten_flag;
 			uint32_t tx_atten_db;
 			bool over_sample_16x;
+			bool packet_mmap;
 #if OCTPHY_MULTI_TRX == 1
 			/* arfcn used by TRX with id 0 */
 			uint16_t center_arfcn;
@@ -108,12 +149,15 @@ struct phy_instance {
 			int clk_cal;
 			uint8_t clk_src;
 			char *calib_path;
+			char *calib_cache;
 
 			struct femtol1_hdl *hdl;
 		} sysmobts;
 		struct {
 			struct trx_l1h *hdl;
 			struct trx_dl_burst_req br[TRX_NR_TS];
+			uint32_t rts_fn_next; /* next FN to issue RTS for, see bts_sched_fn() */
+			bool rts_fn_valid; /* has rts_fn_next been set yet? */
 		} osmotrx;
 		struct {
 			/* logical transceiver number within one PHY */
@@ -179,3 +223,5 @@ int bts_model_phy_link_close(struct phy_link *plink);
 
 #define LOGPPHL(plink, section, lvl, fmt, args...) LOGP(section, lvl, "%s: " fmt, phy_link_name(plink), ##args)
 #define LOGPPHI(pinst, section, lvl, fmt, args...) LOGP(section, lvl, "%s: " fmt, phy_instance_name(pinst), ##args)
+#define LOGPPHI_HOTPATH(pinst, section, lvl, fmt, args...) \
+	LOGP_HOTPATH(section, lvl, "%s: " fmt, phy_instance_name(pinst), ##args)
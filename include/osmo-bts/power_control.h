@@ -76,11 +76,47 @@ struct gsm_power_ctrl_meas_proc_state {
 	};
 };
 
+/* Control loops recorded in the decision log (see struct pwr_ctrl_log) */
+enum pwr_ctrl_log_loop {
+	PWR_CTRL_LOG_MS_PWR,		/* MS Power Control Loop */
+	PWR_CTRL_LOG_BS_PWR,		/* BS Power Control Loop */
+	PWR_CTRL_LOG_TA,		/* TA Control Loop */
+	_PWR_CTRL_LOG_NUM
+};
+
+/* One level change of a control loop */
+struct pwr_ctrl_log_entry {
+	uint32_t fn;
+	uint8_t trx_nr;
+	uint8_t ts_nr;
+	uint8_t lchan_nr;
+	uint8_t loop;		/* enum pwr_ctrl_log_loop */
+	/* MS power control level, BS attenuation (in dB) or TA */
+	uint8_t old;
+	uint8_t new;
+	/* averaged input values the decision was based on:
+	 * MS: RxLev and C/I (in cB), BS: RxLev and RxQual, TA: ToA256 and 0 */
+	int16_t avg[2];
+};
+
+#define PWR_CTRL_LOG_LEN	256	/* must be a power of 2 */
+
+/* Ring buffer of the most recent level changes of a BTS */
+struct pwr_ctrl_log {
+	struct pwr_ctrl_log_entry entries[PWR_CTRL_LOG_LEN];
+	/* total number of entries ever written */
+	unsigned int num;
+};
+
+struct gsm_lchan;
+void pwr_ctrl_log_add(struct gsm_lchan *lchan, enum pwr_ctrl_log_loop loop,
+		      int8_t *last_dir, bool raise, uint8_t old, uint8_t new,
+		      int16_t avg0, int16_t avg1);
+
 /* Default MS/BS Power Control parameters */
 extern const struct gsm_power_ctrl_params power_ctrl_params_def;
 void power_ctrl_params_def_reset(struct gsm_power_ctrl_params *params, bool is_bs_pwr);
 
-struct gsm_lchan;
 int lchan_ms_pwr_ctrl(struct gsm_lchan *lchan,
 		      const uint8_t ms_power_lvl,
 		      const int8_t ul_rssi_dbm,
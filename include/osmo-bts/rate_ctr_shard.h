@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct rate_ctr_group;
+
+/* Max. number of threads adding to sharded counters (slot 0: main thread) */
+#define RATE_CTR_SHARD_THREADS	8
+
+/* Per-thread shadow of a rate_ctr_group, see rate_ctr_shard_flush() */
+struct rate_ctr_shard_group {
+	struct rate_ctr_group *ctrg;
+	unsigned int num_ctr;
+	size_t stride;		/* counters per thread slot, padded to a cache line */
+	uint64_t *slots;	/* [RATE_CTR_SHARD_THREADS][stride], cache line aligned */
+	uint64_t *flushed;	/* main thread only: slot values at the last flush */
+};
+
+/* slot of the calling thread, see rate_ctr_shard_thread_register() */
+extern __thread unsigned int rate_ctr_shard_slot;
+
+struct rate_ctr_shard_group *rate_ctr_shard_group_alloc(void *ctx, struct rate_ctr_group *ctrg);
+int rate_ctr_shard_thread_register(void);
+void rate_ctr_shard_flush(struct rate_ctr_shard_group *sg);
+
+/*! Add to a counter of the calling thread's slot.  It is not visible in the
+ *  rate_ctr_group before the next rate_ctr_shard_flush(). */
+static inline void rate_ctr_shard_add(struct rate_ctr_shard_group *sg, unsigned int idx, uint64_t inc)
+{
+	uint64_t *v = &sg->slots[rate_ctr_shard_slot * sg->stride + idx];
+
+	/* only this thread writes it, the main thread reads it when flushing */
+	__atomic_store_n(v, *v + inc, __ATOMIC_RELAXED);
+}
+
+static inline void rate_ctr_shard_inc(struct rate_ctr_shard_group *sg, unsigned int idx)
+{
+	rate_ctr_shard_add(sg, idx, 1);
+}
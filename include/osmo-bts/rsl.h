@@ -1,9 +1,15 @@
 #ifndef _RSL_H
 #define _RSL_H
 
+#include <osmocom/core/linuxlist.h>
+
 #define LCHAN_FN_DUMMY 0xFFFFFFFF
 #define LCHAN_FN_WAIT 0xFFFFFFFE
 
+/* Osmocom specific IE in the CCCH LOAD INDICATION (PCH/AGCH), reporting the
+ * scheduler CPU load per TRX and timeslot, see 'scheduler cpu-load-indication' */
+#define OSMO_BTS_RSL_IE_CPU_LOAD 0x64
+
 bool rsl_chan_rt_is_asci(enum rsl_cmod_crt chan_rt);
 bool rsl_chan_rt_is_vgcs(enum rsl_cmod_crt chan_rt);
 
@@ -24,7 +30,8 @@ int rsl_tx_talker_det(struct gsm_lchan *lchan, uint8_t *acc_delay);
 int lapdm_rll_tx_cb(struct msgb *msg, struct lapdm_entity *le, void *ctx);
 
 int rsl_tx_ipac_dlcx_ind(struct gsm_lchan *lchan, uint8_t cause);
-int rsl_tx_ccch_load_ind_pch(struct gsm_bts *bts, uint16_t paging_avail);
+int rsl_tx_ccch_load_ind_pch(struct gsm_bts *bts, uint16_t paging_avail,
+			     const uint8_t *cpu_load, uint8_t cpu_load_len);
 int rsl_tx_ccch_load_ind_rach(struct gsm_bts *bts, uint16_t total,
 			      uint16_t busy, uint16_t access);
 int rsl_tx_delete_ind(struct gsm_bts *bts, const uint8_t *ia, uint8_t ia_len);
@@ -37,4 +44,45 @@ int rsl_tx_cbch_load_indication(struct gsm_bts *bts, bool ext_cbch, bool overflo
 
 int rsl_tx_meas_res(struct gsm_lchan *lchan, const uint8_t *l3, unsigned int l3_len, int timing_offset);
 
+struct tlv_parsed;
+
+/* IEs a message can contain, see rsl_tlv_parse_ies() */
+struct rsl_ie_set {
+	const uint8_t *ies;
+	unsigned int num;
+	/* bitmap of ies[], built on first use */
+	uint8_t mask[256 / 8];
+	bool mask_built;
+};
+
+extern struct rsl_ie_set rsl_ie_set_chan_activ;
+extern struct rsl_ie_set rsl_ie_set_paging_cmd;
+extern struct rsl_ie_set rsl_ie_set_imm_ass;
+extern struct rsl_ie_set rsl_ie_set_ipac_XXcx;
+
+int rsl_tlv_parse_ies(struct tlv_parsed *tp, struct rsl_ie_set *set,
+		      const uint8_t *buf, int buf_len);
+
+/* Statistics of the RSL messages received by down_rsl(), per discriminator and type */
+struct rsl_rx_stats {
+	uint8_t msg_discr;
+	uint8_t msg_type;
+	unsigned long long count;
+	unsigned long long time_ns;	/* cumulative handling time */
+};
+
+const struct rsl_rx_stats *rsl_rx_stats_get(unsigned int idx);
+
+/* pool of msgbs for outgoing RSL messages */
+struct rsl_msgb_pool {
+	struct llist_head free;		/* pooled (unused) msgbs */
+	unsigned int free_len;		/* number of pooled msgbs */
+	unsigned int in_use;		/* currently allocated from the pool */
+	unsigned int in_use_max;	/* high-water mark of in_use */
+	unsigned long long hits;	/* allocations served from the pool */
+	unsigned long long misses;	/* allocations falling back to talloc */
+};
+
+const struct rsl_msgb_pool *rsl_msgb_pool_get(void);
+
 #endif // _RSL_H */
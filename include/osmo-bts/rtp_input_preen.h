@@ -15,6 +15,17 @@ enum pl_input_decision {
 	PL_DECISION_STRIP_HDR_OCTET,
 };
 
+/* Validation of the RTP payloads of one codec */
+struct rtp_input_preen {
+	enum pl_input_decision (*fn)(const struct gsm_lchan *lchan,
+				     const uint8_t *rtp_pl, unsigned rtp_pl_len,
+				     bool *rfc5993_sid_flag);
+	unsigned int len;	/* expected payload length (fixed-length codecs) */
+	uint8_t sig;		/* expected upper nibble of the first octet */
+};
+
+void rtp_input_preen_setup(struct gsm_lchan *lchan);
+
 enum pl_input_decision
 rtp_payload_input_preen(struct gsm_lchan *lchan, const uint8_t *rtp_pl,
 			unsigned rtp_pl_len, bool *rfc5993_sid_flag);
@@ -4,6 +4,7 @@
 #include <osmocom/core/rate_ctr.h>
 
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/a5_kasumi.h>
 
 #define TRX_GMSK_NB_TSC(br) \
 	_sched_train_seq_gmsk_nb[(br)->tsc_set][(br)->tsc]
@@ -79,6 +80,46 @@ struct l1sched_meas_set {
 	float			rssi;		/* RSSI (dBm) */
 };
 
+/* Running sums of Uplink burst measurements (modulo 2^32) */
+struct l1sched_meas_sums {
+	uint32_t		toa256;		/* Timing of Arrival (1/256 of a symbol) */
+	uint32_t		ci_cb;		/* Carrier-to-Interference (cB) */
+	uint32_t		rssi;		/* RSSI (dBm) */
+};
+
+/* An entry of the Uplink measurement history */
+struct l1sched_meas_hist {
+	uint32_t		fn;		/* TDMA frame number */
+	struct l1sched_meas_sums sum;		/* sums of all preceding measurements */
+};
+
+/* Uplink measurement history of a logical channel (ring buffer of running sums),
+ * handed out from the arena of the timeslot on activation, see sched_meas.c */
+struct l1sched_meas_ring {
+	struct l1sched_meas_hist buf[24]; /* up to 24 (BUFMAX) entries */
+	struct l1sched_meas_sums sum; /* sums of all measurements */
+	unsigned int current; /* current position */
+};
+
+/* Number of TDMA frames kept in the A5 keystream cache of a logical channel */
+#define L1SCHED_A5_KS_CACHE_LEN 8
+
+/* A5 keystream (2 x 57 bits) for a single TDMA frame */
+struct l1sched_a5_ks {
+	uint32_t		fn;		/* TDMA frame number */
+	bool			valid;		/* keystream has been computed */
+	ubit_t			ks[114];	/* unpacked keystream bits */
+};
+
+/* A5 keystream cache, indexed by (FN % L1SCHED_A5_KS_CACHE_LEN) */
+struct l1sched_a5_ks_cache {
+	struct l1sched_a5_ks	dl[L1SCHED_A5_KS_CACHE_LEN];
+	struct l1sched_a5_ks	ul[L1SCHED_A5_KS_CACHE_LEN];
+	/* A5/3 and A5/4: KASUMI key schedules, expanded by trx_sched_set_cipher() */
+	struct a5_kasumi_key	dl_key;
+	struct a5_kasumi_key	ul_key;
+};
+
 /* States each channel on a multiframe */
 struct l1sched_chan_state {
 	/* Pointer to the associated logical channel state from gsm_data_shared.
@@ -88,13 +129,16 @@ struct l1sched_chan_state {
 
 	/* scheduler */
 	bool			active;		/* Channel is active */
+	uint32_t		gen;		/* unique per (de)activation, see _trx_sched_set_lchan() */
 	ubit_t			*dl_bursts;	/* burst buffer for TX */
 	enum trx_mod_type	dl_mod_type;	/* Downlink modulation type */
 	uint8_t			dl_mask;	/* mask of transmitted bursts */
 	sbit_t			*ul_bursts;	/* burst buffer for RX */
 	sbit_t			*ul_bursts_prev;/* previous burst buffer for RX (repeated SACCH) */
+	bool			ul_bursts_prev_valid; /* ul_bursts_prev holds the previous SACCH block */
 	uint32_t		ul_first_fn;	/* fn of first burst */
 	uint32_t		ul_mask;	/* mask of received bursts */
+	uint8_t			ul_bursts_base;	/* ring base of ul_bursts (TCH/F, TCH/H) */
 
 	/* loss detection */
 	uint32_t		last_tdma_fn;	/* last processed TDMA frame number */
@@ -120,6 +164,7 @@ struct l1sched_chan_state {
 	uint8_t			ul_ongoing_facch; /* FACCH/H on uplink */
 
 	uint8_t			dl_facch_bursts;  /* number of remaining DL FACCH bursts */
+	struct msgb		*dl_facch_deferred; /* FACCH kept back to spare speech */
 
 	/* encryption */
 	int			ul_encr_algo;	/* A5/x encry algo downlink */
@@ -128,32 +173,125 @@ struct l1sched_chan_state {
 	int			dl_encr_key_len;
 	uint8_t			ul_encr_key[MAX_A5_KEY_LEN];
 	uint8_t			dl_encr_key[MAX_A5_KEY_LEN];
+	struct l1sched_a5_ks_cache *a5_ks;	/* pre-computed keystream (if ciphering) */
 
 	/* Uplink measurements */
 	struct {
-		/* Active channel measurements (simple ring buffer) */
-		struct l1sched_meas_set buf[24]; /* up to 24 (BUFMAX) entries */
-		unsigned int current; /* current position */
+		/* Active channel measurements (NULL if inactive or no Uplink) */
+		struct l1sched_meas_ring *hist;
 
 		/* Interference measurements */
-		int interf_avg; /* sliding average */
+		int interf_avg; /* average of the last SACCH period */
 	} meas;
 
 	/* handover */
 	bool			ho_rach_detect;	/* if rach detection is on */
 };
 
+/* Number of TDMA frames covered by the ring of queued Downlink primitives.  It
+ * must exceed the maximum advance (100 frames) a primitive may be queued with,
+ * and divide GSM_TDMA_HYPERFRAME so that the ring index wraps together with FN. */
+#define L1SCHED_DL_PRIMS_RING_LEN 128
+
+/* Downlink xCCH blocks encoded ahead of their first burst, in the slack of
+ * the preceding frames (see 'osmotrx dl-encode-ahead'), indexed by
+ * (FN % L1SCHED_DL_AHEAD_LEN).  On a timeslot, at most one block starts per
+ * frame, and an xCCH block is 4 frames long. */
+#define L1SCHED_DL_AHEAD_LEN 4
+
+struct l1sched_dl_ahead {
+	bool			valid;
+	uint8_t			chan;		/* enum trx_chan_type */
+	uint32_t		fn;		/* TDMA frame number of the first burst */
+	uint8_t			l2[GSM_MACBLOCK_LEN]; /* the encoded MAC block */
+	ubit_t			bursts[4 * 116];
+};
+
+/* Dispatch tables kept for the multiframes a dynamic timeslot switched away
+ * from (TCH/F, TCH/H, SDCCH/8, PDCH), see trx_sched_set_pchan() */
+#define L1SCHED_MF_STAGED_NUM 4
+
+/* The hopping sequence for HSN != 0 depends on (T1 mod 64, T2, T3) only,
+ * so it repeats every 64 * 26 * 51 TDMA frames (3GPP TS 45.002, 6.2.3) */
+#define L1SCHED_FH_PERIOD (64 * 26 * 51)
+
+/* l1sched_ts->ctrs */
+enum {
+	L1SCHED_TS_CTR_DL_LATE,
+	L1SCHED_TS_CTR_DL_NOT_FOUND,
+	L1SCHED_TS_CTR_CPU_RTS_US,
+	L1SCHED_TS_CTR_CPU_DL_US,
+	L1SCHED_TS_CTR_CPU_UL_US,
+	L1SCHED_TS_CTR_UL_LOST_FN,
+};
+
+/* Handlers covered by the CPU accounting, see 'scheduler cpu-accounting' */
+enum l1sched_cpu_dir {
+	L1SCHED_CPU_RTS,
+	L1SCHED_CPU_DL,
+	L1SCHED_CPU_UL,
+	_L1SCHED_CPU_DIR_NUM
+};
+
+struct l1sched_cpu_stats {
+	uint64_t		ns;		/* total time spent in the handler */
+	uint32_t		calls;		/* number of calls */
+	uint32_t		max_ns;		/* longest call */
+};
+
 struct l1sched_ts {
 	struct gsm_bts_trx_ts	*ts;		/* timeslot we belong to */
 
 	uint8_t 		mf_index;	/* selected multiframe index */
 	uint8_t			mf_period;	/* period of multiframe */
 	const struct trx_sched_frame *mf_frames; /* pointer to frame layout */
+	struct l1sched_dl_frame	*mf_dl;		/* DL dispatch table, mf_period entries */
+	struct l1sched_ul_frame	*mf_ul;		/* UL dispatch table, mf_period entries */
+	struct {
+		uint8_t			mf_index;
+		struct l1sched_dl_frame	*dl;
+		struct l1sched_ul_frame	*ul;
+	}			mf_staged[L1SCHED_MF_STAGED_NUM];
+	unsigned int		mf_staged_num;	/* number of entries in mf_staged[] */
+
+	/* L1SCHED_DL_AHEAD_LEN entries, allocated on first use */
+	struct l1sched_dl_ahead	*dl_ahead;
+
+	/* Queued primitives for TX, indexed by (FN % L1SCHED_DL_PRIMS_RING_LEN) */
+	struct llist_head	dl_prims[L1SCHED_DL_PRIMS_RING_LEN];
+	unsigned int		dl_prims_num;	/* total number of queued primitives */
+	uint32_t		dl_prims_sweep_fn; /* last FN checked for late primitives */
+	bool			dl_prims_sweep_valid;
 
-	struct llist_head	dl_prims;	/* Queue primitives for TX */
+	unsigned int		num_active_chans; /* number of active logical channels */
+
+	/* Frequency hopping: MAI for each (FN % L1SCHED_FH_PERIOD), NULL if not
+	 * used; see trx_sched_fh_setup() */
+	uint8_t			*fh_mai;
 
 	struct rate_ctr_group	*ctrs;		/* rate counters */
 
+	/* Burst buffers of the logical channels, handed out on activation */
+	uint8_t			*burst_bufs;	/* burst_bufs_num contiguous slots */
+	unsigned int		burst_bufs_num;
+	uint64_t		burst_bufs_used; /* bitmask of the slots in use */
+
+	/* Uplink measurement histories of the logical channels, likewise */
+	struct l1sched_meas_ring *meas_rings;	/* meas_rings_num entries */
+	unsigned int		meas_rings_num;
+	uint32_t		meas_rings_used; /* bitmask of the entries in use */
+
+	/* Noise measurements on the inactive logical channels, summed up
+	 * during a SACCH period, see trx_sched_noise_meas_reduce() */
+	struct {
+		int32_t			sum[_TRX_CHAN_MAX];
+		uint32_t		num[_TRX_CHAN_MAX];
+	} noise;
+
+	/* CPU time of the handlers per logical channel type (if enabled) */
+	struct l1sched_cpu_stats cpu[_L1SCHED_CPU_DIR_NUM][_TRX_CHAN_MAX];
+	uint32_t		cpu_ctr_rem_ns[_L1SCHED_CPU_DIR_NUM]; /* not yet counted in ctrs */
+
 	/* Channel states for all logical channels */
 	struct l1sched_chan_state chan_state[_TRX_CHAN_MAX];
 };
@@ -165,6 +303,9 @@ void trx_sched_init(struct gsm_bts_trx *trx);
 /*! \brief De-initialize the scheduler data structures */
 void trx_sched_clean(struct gsm_bts_trx *trx);
 
+/*! \brief Average the noise measurements of a timeslot since the last call */
+void trx_sched_noise_meas_reduce(struct l1sched_ts *l1ts);
+
 /*! \brief Handle a PH-DATA.req from L2 down to L1 */
 int trx_sched_ph_data_req(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap);
 
@@ -186,6 +327,9 @@ int trx_sched_set_pchan(struct gsm_bts_trx_ts *ts, enum gsm_phys_chan_config pch
 /*! \brief set all matching logical channels active/inactive */
 int trx_sched_set_lchan(struct gsm_lchan *lchan, uint8_t chan_nr, uint8_t link_id, bool active);
 
+/*! \brief deactivate all logical channels of the given lchans of a timeslot at once */
+int trx_sched_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask);
+
 /*! \brief set all logical channels of BCCH/CCCH active/inactive */
 int trx_sched_set_bcch_ccch(struct gsm_lchan *lchan, bool active);
 
@@ -198,6 +342,9 @@ int trx_sched_set_mode(struct gsm_bts_trx_ts *ts, uint8_t chan_nr, uint8_t rsl_c
 /*! \brief set ciphering on given logical channels */
 int trx_sched_set_cipher(struct gsm_lchan *lchan, uint8_t chan_nr, bool downlink);
 
+/*! \brief pre-compute A5 keystream for the given Downlink and Uplink TDMA frames */
+void trx_sched_a5_prefill(struct l1sched_ts *l1ts, uint32_t dl_fn, uint32_t ul_fn);
+
 /* frame structures */
 struct trx_sched_frame {
 	/*! \brief downlink TRX channel type */
@@ -226,6 +373,25 @@ struct trx_sched_multiframe {
 
 int find_sched_mframe_idx(enum gsm_phys_chan_config pchan, uint8_t tn);
 
+/* Frame positions of a multiframe, one bit per (FN % period) */
+struct trx_sched_mf_bits {
+	uint8_t		period;
+	uint64_t	ul_sacch[2];
+	uint64_t	dl_sacch[2];
+	uint64_t	ul_facch[2];	/* TCH bursts, which a FACCH may steal */
+	uint64_t	dl_facch[2];
+	uint64_t	ul_idle[2];
+	uint64_t	dl_idle[2];
+};
+
+const struct trx_sched_mf_bits *trx_sched_mf_bits_get(enum gsm_phys_chan_config pchan, uint8_t tn);
+
+static inline bool trx_sched_mf_bit_test(const uint64_t *bits, uint8_t period, uint32_t fn)
+{
+	fn %= period;
+	return (bits[fn / 64] >> (fn % 64)) & 1;
+}
+
 /*! Determine if given frame number contains SACCH (true) or other (false) burst */
 bool trx_sched_is_sacch_fn(const struct gsm_bts_trx_ts *ts, uint32_t fn, bool uplink);
 extern const struct trx_sched_multiframe trx_sched_multiframes[];
@@ -264,8 +430,11 @@ struct trx_ul_burst_ind {
 	enum trx_chan_type chan;
 	uint8_t bid;
 
-	/*! Burst soft-bits buffer */
-	sbit_t burst[EGPRS_BURST_LEN];
+	/*! Burst soft-bits (burst_len entries), not owned by the indication.
+	 * Points into the PHY's receive buffer and is only valid until the
+	 * indication handler returns, so it must be copied if needed later.
+	 * The scheduler may modify the soft-bits in place (decryption). */
+	sbit_t *burst;
 	size_t burst_len;
 };
 
@@ -290,13 +459,18 @@ struct trx_dl_burst_req {
 	enum trx_chan_type chan;
 	uint8_t bid;
 
-	/*! Burst hard-bits buffer */
-	ubit_t burst[EGPRS_BURST_LEN];
+	/*! Burst hard-bits, normally pointing to burst_buf[].  For the shadow
+	 *  timeslot of a VAMOS pair it points into the buffer of the primary. */
+	ubit_t *burst;
 	size_t burst_len;
+
+	/*! Burst hard-bits buffer (room for two GMSK bursts in case of AQPSK) */
+	ubit_t burst_buf[EGPRS_BURST_LEN];
 };
 
 /*! Handle an UL burst received by PHY */
 int trx_sched_route_burst_ind(const struct gsm_bts_trx *trx, struct trx_ul_burst_ind *bi);
+void trx_sched_fh_setup(struct gsm_bts_trx_ts *ts);
 int trx_sched_ul_burst(struct l1sched_ts *l1ts, struct trx_ul_burst_ind *bi);
 
 /* Averaging mode for trx_sched_meas_avg() */
@@ -1,7 +1,8 @@
 #pragma once
 
+/* Logging helper for the scheduler (a hot path, see LOGP_HOTPATH()) */
 #define LOGL1S(subsys, level, l1ts, chan, fn, fmt, args ...)	\
-		LOGP(subsys, level, "%s %s %s: " fmt,		\
+		LOGP_HOTPATH(subsys, level, "%s %s %s: " fmt,	\
 			gsm_fn_as_gsmtime_str(fn),		\
 			gsm_ts_name((l1ts)->ts),		\
 			chan >=0 ? trx_chan_desc[chan].name : "", ## args)
@@ -14,6 +15,32 @@ typedef int trx_sched_rts_func(const struct l1sched_ts *l1ts, const struct trx_d
 typedef int trx_sched_dl_func(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
 typedef int trx_sched_ul_func(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi);
 
+/*! Downlink dispatch entry for one frame of a multiframe, see trx_sched_set_pchan() */
+struct l1sched_dl_frame {
+	/*! \brief RTS function of the logical channel (may be NULL) */
+	trx_sched_rts_func		*rts_fn;
+	/*! \brief burst generation function of the logical channel */
+	trx_sched_dl_func		*dl_fn;
+	/*! \brief state of the logical channel on this timeslot */
+	struct l1sched_chan_state	*chan_state;
+	/*! \brief logical channel type (enum trx_chan_type) */
+	uint8_t				chan;
+	/*! \brief block ID */
+	uint8_t				bid;
+};
+
+/*! Uplink dispatch entry for one frame of a multiframe, see trx_sched_set_pchan() */
+struct l1sched_ul_frame {
+	/*! \brief burst handling function of the logical channel (may be NULL) */
+	trx_sched_ul_func		*ul_fn;
+	/*! \brief state of the logical channel on this timeslot */
+	struct l1sched_chan_state	*chan_state;
+	/*! \brief logical channel type (enum trx_chan_type) */
+	uint8_t				chan;
+	/*! \brief block ID */
+	uint8_t				bid;
+};
+
 struct trx_chan_desc {
 	/*! \brief Human-readable name */
 	const char		*name;
@@ -40,6 +67,7 @@ extern const ubit_t _sched_train_seq_8psk_nb[8][78];
 extern const ubit_t _sched_train_seq_gmsk_sb[64];
 
 struct msgb *_sched_dequeue_prim(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br);
+struct msgb *_sched_peek_prim(struct l1sched_ts *l1ts, uint32_t fn, enum trx_chan_type chan);
 
 int _sched_compose_ph_data_ind(struct l1sched_ts *l1ts, uint32_t fn,
 			       enum trx_chan_type chan,
@@ -48,6 +76,15 @@ int _sched_compose_ph_data_ind(struct l1sched_ts *l1ts, uint32_t fn,
 			       int16_t ta_offs_256bits, int16_t link_qual_cb,
 			       enum osmo_ph_pres_info_type presence_info);
 
+/* Uplink PDTCH: decode into the PCU DATA.ind, see l1sap_pdtch_ind_alloc() */
+struct msgb *_sched_pdtch_ind_alloc(struct l1sched_ts *l1ts, enum trx_chan_type chan,
+				    uint8_t **data);
+int _sched_compose_pdtch_ind(struct l1sched_ts *l1ts, struct msgb *msg, uint32_t fn,
+			     enum trx_chan_type chan, size_t data_len,
+			     uint16_t ber10k, float rssi,
+			     int16_t ta_offs_256bits, int16_t link_qual_cb,
+			     enum osmo_ph_pres_info_type presence_info);
+
 int _sched_compose_tch_ind(struct l1sched_ts *l1ts, uint32_t fn,
 			   enum trx_chan_type chan,
 			   const uint8_t *data, size_t data_len,
@@ -58,6 +95,7 @@ int _sched_compose_tch_ind(struct l1sched_ts *l1ts, uint32_t fn,
 int tx_fcch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
 int tx_sch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
 int tx_data_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
+bool tx_data_encode_ahead(struct l1sched_ts *l1ts, enum trx_chan_type chan, uint32_t fn);
 int tx_pdtch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
 int tx_tchf_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
 int tx_tchh_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
@@ -69,5 +107,5 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi);
 int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi);
 
 void _sched_dl_burst(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br);
-int _sched_rts(const struct l1sched_ts *l1ts, uint32_t fn);
+int _sched_rts(struct l1sched_ts *l1ts, uint32_t fn);
 void _sched_act_rach_det(struct gsm_bts_trx *trx, uint8_t tn, uint8_t ss, int activate);
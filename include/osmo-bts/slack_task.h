@@ -0,0 +1,54 @@
+/* Low priority work run in the slack of the TDMA frame processing */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: AGPL-3.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <osmocom/core/linuxlist.h>
+
+/*! A task may wait this long for slack before it is run regardless */
+#define SLACK_TASK_MAX_WAIT_MS	100
+
+struct slack_task {
+	struct llist_head list;
+	const char *name;
+	void (*cb)(void *data);
+	void *data;
+	bool queued;
+	struct timespec queued_at;
+};
+
+void slack_task_init(struct slack_task *t, const char *name, void (*cb)(void *data), void *data);
+void slack_task_queue(struct slack_task *t);
+void slack_task_cancel(struct slack_task *t);
+
+static inline bool slack_task_queued(const struct slack_task *t)
+{
+	return t->queued;
+}
+
+/* for the BTS models with a TDMA frame clock on the main loop */
+void slack_task_set_driven(bool driven);
+unsigned int slack_task_run(int64_t budget_us, unsigned int *late);
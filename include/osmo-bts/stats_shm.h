@@ -0,0 +1,75 @@
+/* Read-only shared memory export of the rate counters and stat items */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: AGPL-3.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Layout of the region (all fields in host byte order).  An exporter maps
+ * it read-only and takes a consistent snapshot like this:
+ *
+ *	do {
+ *		s1 = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+ *		n = hdr->num_entries;
+ *		memcpy(copy, hdr->entries, n * hdr->entry_size);
+ *		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+ *		s2 = __atomic_load_n(&hdr->seq, __ATOMIC_RELAXED);
+ *	} while ((s1 & 1) || s1 != s2);
+ *
+ * The version is incremented on any incompatible change of the layout.
+ */
+
+#define STATS_SHM_MAGIC		0x5354424f	/* "OBTS" */
+#define STATS_SHM_VERSION	1
+#define STATS_SHM_NAME_LEN	64
+#define STATS_SHM_MAX_ENTRIES	4096
+#define STATS_SHM_INTERVAL_DEFAULT 100	/* ms */
+
+enum stats_shm_type {
+	STATS_SHM_T_COUNTER,	/* rate counter (monotonic) */
+	STATS_SHM_T_GAUGE,	/* last value of a stat item */
+};
+
+struct stats_shm_entry {
+	char name[STATS_SHM_NAME_LEN];	/* "<group prefix>.<group index>.<name>" */
+	uint32_t type;			/* enum stats_shm_type */
+	uint32_t reserved;
+	int64_t value;
+};
+
+struct stats_shm_hdr {
+	uint32_t magic;			/* STATS_SHM_MAGIC */
+	uint16_t version;		/* STATS_SHM_VERSION */
+	uint16_t entry_size;		/* sizeof(struct stats_shm_entry) */
+	uint32_t seq;			/* odd while a snapshot is being written */
+	uint32_t num_entries;		/* valid entries in this snapshot */
+	uint32_t max_entries;		/* size of the region in entries */
+	uint32_t interval_ms;		/* snapshot interval */
+	uint64_t timestamp_us;		/* CLOCK_REALTIME of the snapshot */
+	struct stats_shm_entry entries[0];
+};
+
+struct stats_shm;
+
+struct stats_shm *stats_shm_start(void *ctx, const char *name, unsigned int interval_ms);
+void stats_shm_stop(struct stats_shm *ss);
@@ -55,10 +55,19 @@ struct trx_power_params {
 		/* temporary attenuation due to power ramping */
 		int attenuation_mdB;
 		unsigned int step_size_mdB;
-		unsigned int step_interval_sec;
+		unsigned int step_interval_ms;
 		struct osmo_timer_list step_timer;
 		/* call-back called when target is reached */
 		ramp_compl_cb_t compl_cb;
+		/* duration of the ramps, see 'show trx' */
+		struct {
+			struct timespec start;	/* start of the current ramp */
+			unsigned int steps;	/* steps of the current ramp */
+			unsigned int count;	/* number of completed ramps */
+			unsigned int last_steps;
+			unsigned long long last_ms;
+			unsigned long long max_ms;
+		} stats;
 	} ramp;
 };
 
@@ -84,6 +93,7 @@ int _power_ramp_start(struct gsm_bts_trx *trx, int p_total_tgt_mdBm, int bypass_
 	_power_ramp_start(trx, p_total_tgt_mdBm, bypass_max_power, ramp_compl_cb, true)
 
 void power_ramp_abort(struct gsm_bts_trx *trx);
+bool power_ramp_target_is(const struct gsm_bts_trx *trx, int p_total_tgt_mdBm);
 
 void power_trx_change_compl(struct gsm_bts_trx *trx, int p_trxout_cur_mdBm);
 
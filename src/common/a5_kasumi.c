@@ -0,0 +1,118 @@
+/* A5/3 and A5/4 keystream generation with a pre-expanded KASUMI key */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * osmo_a5() expands the KASUMI key twice (CK ^ KM and CK) on every call,
+ * and runs KGCORE once for each requested direction.  The key only changes
+ * with the ciphering mode, so the two key schedules are expanded when the
+ * cipher is set (see trx_sched_set_cipher()), and a single KGCORE run per
+ * TDMA frame yields the keystream of both directions.
+ *
+ * KGCORE as per 3GPP TS 55.216, section 3, with CA = 0x0f, CB = 0, CD = 0
+ * and the COUNT-C of the TDMA frame number, as used for A5/3 and A5/4 by
+ * 3GPP TS 55.216 section 4.
+ */
+
+#include <string.h>
+#include <errno.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/a5.h>
+#include <osmocom/gsm/kasumi.h>
+
+#include <osmo-bts/a5_kasumi.h>
+
+#define KGCORE_KM	0x55	/* key modifier */
+#define A5_KS_BITS	228	/* DL (114) followed by UL (114) */
+
+static void key_sched_expand(struct kasumi_key_sched *s, const uint8_t *key)
+{
+	_kasumi_key_expand(key, s->KLi1, s->KLi2, s->KOi1, s->KOi2, s->KOi3,
+			   s->KIi1, s->KIi2, s->KIi3);
+}
+
+static inline uint64_t key_sched_kasumi(const struct kasumi_key_sched *s, uint64_t p)
+{
+	return _kasumi(p, s->KLi1, s->KLi2, s->KOi1, s->KOi2, s->KOi3,
+		       s->KIi1, s->KIi2, s->KIi3);
+}
+
+/*! expand the key schedules for A5/3 or A5/4
+ *  \param[out] k expanded key
+ *  \param[in] algo 3 or 4
+ *  \param[in] key Kc (8 bytes) for A5/3, Kc128 (16 bytes) for A5/4
+ *  \returns 0 on success; -ENOTSUP for other algorithms */
+int a5_kasumi_key_expand(struct a5_kasumi_key *k, int algo, const uint8_t *key)
+{
+	uint8_t ck[16];
+	unsigned int i;
+
+	switch (algo) {
+	case 3:
+		/* the 64 bit Kc is repeated to a 128 bit CK */
+		memcpy(&ck[0], key, 8);
+		memcpy(&ck[8], key, 8);
+		break;
+	case 4:
+		memcpy(&ck[0], key, 16);
+		break;
+	default:
+		return -ENOTSUP;
+	}
+
+	key_sched_expand(&k->ck, ck);
+	for (i = 0; i < sizeof(ck); i++)
+		ck[i] ^= KGCORE_KM;
+	key_sched_expand(&k->ck_km, ck);
+
+	return 0;
+}
+
+/*! generate the A5/3 or A5/4 keystream of a TDMA frame, like osmo_a5()
+ *  \param[in] k key expanded by a5_kasumi_key_expand()
+ *  \param[in] fn TDMA frame number
+ *  \param[out] dl 114 bits of Downlink keystream (may be NULL)
+ *  \param[out] ul 114 bits of Uplink keystream (may be NULL) */
+void a5_kasumi(const struct a5_kasumi_key *k, uint32_t fn, ubit_t *dl, ubit_t *ul)
+{
+	uint8_t gamma[32], uplink[15];
+	uint64_t a, blk = 0;
+	unsigned int i;
+
+	/* COUNT-C | CB | CD | 00 | CA | 0..0 */
+	a = ((uint64_t) osmo_a5_fn_count(fn) << 32) | ((uint64_t) 0x0f << 16);
+	a = key_sched_kasumi(&k->ck_km, a);
+
+	for (i = 0; i < (A5_KS_BITS + 63) / 64; i++) {
+		blk = key_sched_kasumi(&k->ck, a ^ i ^ blk);
+		osmo_store64be(blk, &gamma[i * 8]);
+	}
+
+	if (dl)
+		osmo_pbit2ubit(dl, gamma, 114);
+	if (ul) {
+		/* the Uplink keystream starts at bit 114 */
+		for (i = 0; i < sizeof(uplink); i++)
+			uplink[i] = (gamma[i + 14] << 2) | (gamma[i + 15] >> 6);
+		osmo_pbit2ubit(ul, uplink, 114);
+	}
+}
@@ -27,6 +27,7 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
@@ -62,7 +63,6 @@ static struct e1inp_line_ops line_ops;
 static struct ipaccess_unit bts_dev_info;
 
 #define S(x) (1 << (x))
-#define	OML_RETRY_TIMER	5
 
 enum abis_link_fsm_state {
 	ABIS_LINK_ST_WAIT_RECONNECT, /* OML link has not yet been established */
@@ -112,6 +112,93 @@ static void reset_oml_link(struct gsm_bts *bts)
 
 }
 
+/* wait X16 before the next connection attempt (at least one ms, as 0 would disable the FSM timer) */
+static void abis_link_wait_reconnect(struct osmo_fsm_inst *fi)
+{
+	unsigned long delay_ms = osmo_tdef_get(abis_T_defs, -16, OSMO_TDEF_MS, -1);
+
+	osmo_fsm_inst_state_chg_ms(fi, ABIS_LINK_ST_WAIT_RECONNECT, OSMO_MAX(delay_ms, 1), -16);
+}
+
+static unsigned long long abis_tts_elapsed_ms(const struct gsm_bts *bts)
+{
+	struct timespec now;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - bts->abis_tts.since.tv_sec) * 1000ULL
+	       + (now.tv_nsec - bts->abis_tts.since.tv_nsec) / 1000000;
+}
+
+/* the A-bis link is out of service from now on, unless it already is */
+static void abis_tts_outage_start(struct gsm_bts *bts)
+{
+	if (bts->abis_tts.since.tv_sec != 0 || bts->abis_tts.since.tv_nsec != 0)
+		return;
+	osmo_clock_gettime(CLOCK_MONOTONIC, &bts->abis_tts.since);
+	bts->abis_tts.attempts = 0;
+}
+
+static void abis_grace_timer_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+
+	LOGP(DABIS, LOGL_NOTICE, "OML link not back within the grace period (X17), shutting down\n");
+	bts->abis_grace.reattached = false;
+	bts_model_abis_close(bts);
+}
+
+/* Release the lchans which are of no use without RSL, but keep BCCH/CCCH
+ * (with the last SI received) and PDCH on the air in the meantime */
+static void abis_grace_release_lchans(struct gsm_bts_trx_ts *ts)
+{
+	uint32_t lchan_mask = 0;
+	unsigned int ln;
+
+	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
+		switch (ts->lchan[ln].type) {
+		case GSM_LCHAN_SDCCH:
+		case GSM_LCHAN_TCH_F:
+		case GSM_LCHAN_TCH_H:
+			lchan_mask |= (1 << ln);
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (lchan_mask)
+		gsm_ts_release_lchans(ts, lchan_mask, LCHAN_REL_ACT_OML);
+}
+
+/* Keep the RF up for X17 after the loss of the OML link, returns false if the
+ * BTS shall be shut down right away instead */
+static bool abis_grace_start(struct gsm_bts *bts)
+{
+	unsigned long grace_s = osmo_tdef_get(abis_T_defs, -17, OSMO_TDEF_S, -1);
+	struct gsm_bts_trx *trx;
+	unsigned int tn;
+
+	if (grace_s == 0 || bts_shutdown_in_progress(bts))
+		return false;
+	if (bts->c0->mo.nm_state.operational != NM_OPSTATE_ENABLED)
+		return false;
+
+	LOGP(DABIS, LOGL_NOTICE, "OML link lost, keeping the RF up for %lu s (X17)\n", grace_s);
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			abis_grace_release_lchans(&trx->ts[tn]);
+			if (trx->ts[tn].vamos.peer)
+				abis_grace_release_lchans(trx->ts[tn].vamos.peer);
+		}
+	}
+
+	bts->abis_grace.reattached = false;
+	osmo_timer_setup(&bts->abis_grace.timer, abis_grace_timer_cb, bts);
+	osmo_timer_schedule(&bts->abis_grace.timer, grace_s, 0);
+	return true;
+}
+
 static int pick_next_bsc(struct osmo_fsm_inst *fi)
 {
 	struct abis_link_fsm_priv *priv = fi->priv;
@@ -148,7 +235,7 @@ static void abis_link_connecting_onenter(struct osmo_fsm_inst *fi, uint32_t prev
 
 	if (bts_shutdown_in_progress(bts)) {
 		LOGPFSML(fi, LOGL_NOTICE, "BTS is shutting down, delaying A-bis connection establishment to BSC\n");
-		osmo_fsm_inst_state_chg(fi, ABIS_LINK_ST_WAIT_RECONNECT, OML_RETRY_TIMER, 0);
+		abis_link_wait_reconnect(fi);
 		return;
 	}
 
@@ -159,6 +246,7 @@ static void abis_link_connecting_onenter(struct osmo_fsm_inst *fi, uint32_t prev
 	}
 
 	LOGP(DABIS, LOGL_NOTICE, "A-bis connection establishment to BSC (%s) in progress...\n", priv->current_bsc->addr);
+	bts->abis_tts.attempts++;
 
 	/* patch in various data from VTY and other sources */
 	line_ops.cfg.ipa.addr = priv->current_bsc->addr;
@@ -201,7 +289,7 @@ static void abis_link_connecting(struct osmo_fsm_inst *fi, uint32_t event, void
 		break;
 	case ABIS_LINK_EV_SIGN_LINK_DOWN:
 		reset_oml_link(bts);
-		osmo_fsm_inst_state_chg(fi, ABIS_LINK_ST_WAIT_RECONNECT, OML_RETRY_TIMER, 0);
+		abis_link_wait_reconnect(fi);
 		break;
 	default:
 		OSMO_ASSERT(0);
@@ -210,6 +298,17 @@ static void abis_link_connecting(struct osmo_fsm_inst *fi, uint32_t event, void
 
 static void abis_link_connected_onenter(struct osmo_fsm_inst *fi, uint32_t prev_state)
 {
+	/* Back within X17: the NM objects kept running announce their state as
+	 * it is, the BSC re-sending their attributes is accepted */
+	if (osmo_timer_pending(&g_bts->abis_grace.timer)) {
+		osmo_timer_del(&g_bts->abis_grace.timer);
+		g_bts->abis_grace.reattached = true;
+		LOGP(DABIS, LOGL_NOTICE, "OML link back within the grace period (X17), RF was kept up\n");
+	}
+
+	g_bts->abis_tts.last_oml_ms = abis_tts_elapsed_ms(g_bts);
+	g_bts->abis_tts.last_rsl_ms = 0;
+	g_bts->abis_tts.last_attempts = g_bts->abis_tts.attempts;
 	bts_link_estab(g_bts);
 }
 
@@ -220,12 +319,15 @@ static void abis_link_connected(struct osmo_fsm_inst *fi, uint32_t event, void *
 	struct gsm_bts_trx *trx;
 	OSMO_ASSERT(event == ABIS_LINK_EV_SIGN_LINK_DOWN);
 
+	abis_tts_outage_start(bts);
+
 	/* First remove the OML signalling link */
 	reset_oml_link(bts);
 
 	/* Then iterate over the RSL signalling links */
 	llist_for_each_entry(trx, &bts->trx_list, list) {
 		if (trx->rsl_link) {
+			abis_rsl_coalesce_flush(trx);
 			e1inp_sign_link_destroy(trx->rsl_link);
 			trx->rsl_link = NULL;
 			if (trx == trx->bts->c0)
@@ -248,11 +350,14 @@ static void abis_link_connected(struct osmo_fsm_inst *fi, uint32_t event, void *
 		 * that TRX only. But libosmo-abis expects us to drop the entire
 		 * line when something goes wrong... */
 	}
-	bts_model_abis_close(bts);
+
+	/* Unless the RF is kept up waiting for the OML link to come back */
+	if (!abis_grace_start(bts))
+		bts_model_abis_close(bts);
 
 	/* We want to try reconnecting to the current BSC at least once before switching to a new one: */
 	priv->reconnect_to_current_bsc = true;
-	osmo_fsm_inst_state_chg(fi, ABIS_LINK_ST_WAIT_RECONNECT, OML_RETRY_TIMER, 0);
+	abis_link_wait_reconnect(fi);
 }
 
 static void abis_link_failed_onenter(struct osmo_fsm_inst *fi, uint32_t prev_state)
@@ -262,6 +367,8 @@ static void abis_link_failed_onenter(struct osmo_fsm_inst *fi, uint32_t prev_sta
 
 	/* None of the configured BSCs was reachable or there was an existing
 	 * OML/RSL connection that broke. Initiate BTS process shut down now. */
+	osmo_timer_del(&bts->abis_grace.timer);
+	bts->abis_grace.reattached = false;
 	bts_model_abis_close(bts);
 }
 
@@ -353,19 +460,91 @@ int abis_oml_sendmsg(struct msgb *msg)
 	return abis_sendmsg(msg);
 }
 
+/* Set or clear TCP_CORK on the RSL socket of a TRX, so that the kernel
+ * holds back partial TCP segments while it is set */
+static void rsl_coalesce_cork(struct gsm_bts_trx *trx, int on)
+{
+	int fd = trx->rsl_link->ts->driver.ipaccess.fd.fd;
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on)) < 0)
+		LOGPTRX(trx, DABIS, LOGL_ERROR, "Failed to %s the RSL socket: %s\n",
+			on ? "cork" : "uncork", strerror(errno));
+}
+
+/*! Flush the current batch of coalesced RSL messages of a TRX, if any */
+void abis_rsl_coalesce_flush(struct gsm_bts_trx *trx)
+{
+	struct timespec now;
+	unsigned int corked_us;
+
+	if (!trx->rsl_coalesce.corked)
+		return;
+
+	if (trx->rsl_link)
+		rsl_coalesce_cork(trx, 0);
+	trx->rsl_coalesce.corked = false;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	corked_us = (now.tv_sec - trx->rsl_coalesce.start.tv_sec) * 1000000
+		    + (now.tv_nsec - trx->rsl_coalesce.start.tv_nsec) / 1000;
+	trx->rsl_coalesce.corked_sum_us += corked_us;
+	if (corked_us > trx->rsl_coalesce.corked_max_us)
+		trx->rsl_coalesce.corked_max_us = corked_us;
+	trx->rsl_coalesce.batch_fill[OSMO_MIN(trx->rsl_coalesce.msgs, RSL_COALESCE_FILL_MAX)]++;
+}
+
+/*! to be called for every TDMA frame: flush the RSL messages of all TRX which
+ *  were coalesced during the previous frame */
+void abis_rsl_coalesce_tdma_tick(struct gsm_bts *bts)
+{
+	struct gsm_bts_trx *trx;
+
+	llist_for_each_entry(trx, &bts->trx_list, list)
+		abis_rsl_coalesce_flush(trx);
+}
+
+/* With 'rsl-coalesce', TCP_CORK is set on the RSL socket while the RSL messages
+ * of one TDMA frame (e.g. the MEASurement RESults of all lchans at the end of
+ * a SACCH period) are handed to libosmo-abis, and cleared on the next TDMA
+ * frame or once the configured number of bytes is reached.  This is best
+ * effort: libosmo-abis writes its queue from the select loop, so only what
+ * it has written to the socket in between shares TCP segments, a message
+ * still queued when the cork is cleared goes out on its own as usual. */
 int abis_bts_rsl_sendmsg(struct msgb *msg)
 {
-	OSMO_ASSERT(msg->trx);
+	struct gsm_bts_trx *trx = msg->trx;
+	bool flush = false;
+	int rc;
 
-	if (msg->trx->bts->variant == BTS_OSMO_OMLDUMMY) {
+	OSMO_ASSERT(trx);
+
+	if (trx->bts->variant == BTS_OSMO_OMLDUMMY) {
 		msgb_free(msg);
 		return 0;
 	}
 
+	if (OSMO_UNLIKELY(trx->bts->rsl_coalesce_bytes > 0) && trx->rsl_link) {
+		if (!trx->rsl_coalesce.corked) {
+			rsl_coalesce_cork(trx, 1);
+			trx->rsl_coalesce.corked = true;
+			trx->rsl_coalesce.msgs = 0;
+			trx->rsl_coalesce.bytes = 0;
+			osmo_clock_gettime(CLOCK_MONOTONIC, &trx->rsl_coalesce.start);
+		}
+		trx->rsl_coalesce.msgs++;
+		trx->rsl_coalesce.bytes += sizeof(struct ipaccess_head) + msgb_length(msg);
+		flush = trx->rsl_coalesce.bytes >= trx->bts->rsl_coalesce_bytes;
+	}
+
 	/* osmo-bts uses msg->trx internally, but libosmo-abis uses
 	 * the signalling link at msg->dst */
-	msg->dst = msg->trx->rsl_link;
-	return abis_sendmsg(msg);
+	msg->dst = trx->rsl_link;
+	rc = abis_sendmsg(msg);
+
+	if (flush)
+		abis_rsl_coalesce_flush(trx);
+
+	return rc;
 }
 
 static struct e1inp_sign_link *sign_link_up(void *unit, struct e1inp_line *line,
@@ -406,7 +585,18 @@ static struct e1inp_sign_link *sign_link_up(void *unit, struct e1inp_line *line,
 		e1inp_ts_config_sign(sign_ts, line);
 		trx->rsl_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_RSL,
 						       trx, trx->rsl_tei, 0);
+		if (trx == g_bts->c0 && g_bts->abis_tts.last_rsl_ms == 0 &&
+		    (g_bts->abis_tts.since.tv_sec != 0 || g_bts->abis_tts.since.tv_nsec != 0)) {
+			g_bts->abis_tts.last_rsl_ms = abis_tts_elapsed_ms(g_bts);
+			g_bts->abis_tts.since = (struct timespec) { 0 };
+			LOGP(DABIS, LOGL_NOTICE, "A-bis in service after %llu ms (OML link up after %llu ms, "
+			     "%u connection attempts)\n", g_bts->abis_tts.last_rsl_ms,
+			     g_bts->abis_tts.last_oml_ms, g_bts->abis_tts.last_attempts);
+		}
 		trx_link_estab(trx);
+		/* the BSC is done re-attaching to the objects kept running */
+		if (trx == g_bts->c0)
+			g_bts->abis_grace.reattached = false;
 		return trx->rsl_link;
 	}
 	return NULL;
@@ -532,6 +722,7 @@ int abis_open(struct gsm_bts *bts, char *model_name)
 	abis_link_fsm_priv->model_name = model_name;
 	bts->abis_link_fi->priv = abis_link_fsm_priv;
 
+	abis_tts_outage_start(bts);
 	osmo_fsm_inst_state_chg(bts->abis_link_fi, ABIS_LINK_ST_CONNECTING, 0, 0);
 
 	return 0;
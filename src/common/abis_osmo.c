@@ -31,28 +31,12 @@
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/pcuif_proto.h>
 #include <osmo-bts/bts_sm.h>
-
-#define OM_HEADROOM_SIZE	128
+#include <osmo-bts/abis_osmo.h>
 
 ////////////////////////////////////////
 // OSMO ABIS extensions (PCU)
 ///////////////////////////////////////
 
-static struct msgb *abis_osmo_pcu_msgb_alloc(uint8_t msg_type, uint8_t bts_nr, size_t extra_size)
-{
-	struct msgb *msg;
-	struct gsm_pcu_if *pcu_prim;
-	msg = msgb_alloc_headroom(OM_HEADROOM_SIZE + sizeof(struct gsm_pcu_if) + extra_size,
-				  OM_HEADROOM_SIZE, "IPA/ABIS/OSMO");
-	/* Only header is filled, caller is responible for reserving + filling
-	 * message type specific contents: */
-	msgb_put(msg, PCUIF_HDR_SIZE);
-	pcu_prim = (struct gsm_pcu_if *) msgb_data(msg);
-	pcu_prim->msg_type = msg_type;
-	pcu_prim->bts_nr = bts_nr;
-	return msg;
-}
-
 /* Send a OML NM Message from BSC to BTS */
 int abis_osmo_sendmsg(struct gsm_bts *bts, struct msgb *msg)
 {
@@ -69,18 +53,16 @@ static int abis_osmo_pcu_sendmsg(struct gsm_bts *bts, struct msgb *msg)
 	return abis_osmo_sendmsg(bts, msg);
 }
 
-int abis_osmo_pcu_tx_container(struct gsm_bts *bts, const struct gsm_pcu_if_container *container)
+/* Send a container primitive from PCU to BSC.  The msgb holds the complete
+ * PCU primitive as received, its length already checked by the caller, and
+ * is forwarded in place: only the IPA headers are pushed into its headroom
+ * (at least ABIS_OSMO_HEADROOM_SIZE). */
+int abis_osmo_pcu_tx_container(struct gsm_bts *bts, struct msgb *msg)
 {
-	uint16_t data_length = osmo_load16be(&container->length);
-	struct msgb *msg = abis_osmo_pcu_msgb_alloc(PCU_IF_MSG_CONTAINER, bts->nr, data_length);
 	struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) msgb_data(msg);
-	struct gsm_pcu_if_container *tx_cont = &pcu_prim->u.container;
 
-	msgb_put(msg, sizeof(*tx_cont) + data_length);
-	tx_cont->msg_type = container->msg_type;
-	tx_cont->length = container->length;
-	if (data_length)
-		memcpy(tx_cont->data, container->data, data_length);
+	OSMO_ASSERT(msgb_headroom(msg) >= ABIS_OSMO_HEADROOM_SIZE);
+	pcu_prim->bts_nr = bts->nr;
 
 	return abis_osmo_pcu_sendmsg(bts, msg);
 }
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
 
 #include <osmocom/core/logging.h>
@@ -103,13 +104,43 @@ void amr_log_mr_conf(int ss, int logl, const char *pfx,
 
 static inline int get_amr_mode_idx(const struct amr_multirate_conf *amr_mrc,
 				   uint8_t cmi)
+{
+	if (cmi >= ARRAY_SIZE(amr_mrc->mode_idx) || amr_mrc->mode_idx[cmi] < 0)
+		return -EINVAL;
+	return amr_mrc->mode_idx[cmi];
+}
+
+/*! Derive the lookup tables of \a amr_mrc from its modes, so that the
+ *  per-frame code does not need to search the modes or to convert the
+ *  thresholds.  Must be called whenever the modes are changed. */
+void amr_mr_conf_update(struct amr_multirate_conf *amr_mrc)
 {
 	unsigned int i;
-	for (i = 0; i < amr_mrc->num_modes; i++) {
-		if (amr_mrc->mode[i].mode == cmi)
-			return i;
+
+	memset(amr_mrc->mode_idx, -1, sizeof(amr_mrc->mode_idx));
+	for (i = 0; i < ARRAY_SIZE(amr_mrc->mode); i++) {
+		const struct amr_mode *mode = &amr_mrc->mode[i];
+
+		if (i >= amr_mrc->num_modes) {
+			amr_mrc->thresh_dn_cb[i] = INT16_MIN;
+			amr_mrc->thresh_up_cb[i] = INT16_MAX;
+			continue;
+		}
+
+		if (mode->mode < ARRAY_SIZE(amr_mrc->mode_idx))
+			amr_mrc->mode_idx[mode->mode] = i;
+
+		/* The threshold/hysteresis is in 0.5 dB steps, convert to cB:
+		 * 1dB is 10cB, so 0.5dB is 5cB - this is why we multiply by 5. */
+		if (i > 0)
+			amr_mrc->thresh_dn_cb[i] = amr_mrc->mode[i - 1].threshold * 5;
+		else /* the most robust mode cannot be degraded */
+			amr_mrc->thresh_dn_cb[i] = INT16_MIN;
+		if (i < amr_mrc->num_modes - 1)
+			amr_mrc->thresh_up_cb[i] = mode->threshold * 5 + mode->hysteresis * 5;
+		else /* the least robust mode cannot be upgraded */
+			amr_mrc->thresh_up_cb[i] = INT16_MAX;
 	}
-	return -EINVAL;
 }
 
 static inline uint8_t set_cmr_mode_idx(const struct amr_multirate_conf *amr_mrc,
@@ -218,6 +249,8 @@ int amr_parse_mr_conf(struct amr_multirate_conf *amr_mrc,
 		amr_mrc->mode[2].hysteresis = mr_conf[3] & 0xF;
 	}
 
+	amr_mr_conf_update(amr_mrc);
+
 	return num_codecs;
 
 ret_einval:
@@ -275,4 +308,5 @@ void amr_init_mr_conf_def(struct gsm_lchan *lchan)
 	memcpy(&lchan->tch.amr_mr.mode[0], &bts_mode[0],
 	       sizeof(lchan->tch.amr_mr.mode));
 	lchan->tch.amr_mr.num_modes = num_modes;
+	amr_mr_conf_update(&lchan->tch.amr_mr);
 }
@@ -94,13 +94,91 @@ static void vgcs_t3115_cb(void *data)
 	osmo_timer_schedule(&lchan->asci.t3115, 0, bts->t3115_ms * 1000);
 }
 
+/* Grant the uplink to the talker candidate in lchan->asci.cand */
+static void vgcs_talker_grant(struct gsm_lchan *lchan)
+{
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+	uint8_t acc_delay = lchan->asci.cand.acc_delay;
+
+	LOGPLCHAN(lchan, DASCI, LOGL_INFO, "Granting uplink to talker with TA=%u, ref=%u, RSSI=%d dBm "
+		  "(%u candidates)\n", acc_delay, lchan->asci.cand.ra, lchan->asci.cand.rssi,
+		  lchan->asci.cand.num);
+
+	/* Set timing advance, power level and activate SACCH */
+	lchan->ta_ctrl.current = acc_delay;
+	lchan->ms_power_ctrl.current = lchan->ms_power_ctrl.max;
+	lchan->want_dl_sacch_active = true;
+
+	/* Stop RACH detection, wait for valid frame */
+	lchan->asci.talker_active = VGCS_TALKER_WAIT_FRAME;
+	if (l1sap_chan_modify(lchan->ts->trx, gsm_lchan2chan_nr(lchan)) != 0) {
+		LOGPLCHAN(lchan, DASCI, LOGL_ERROR, "failed to modify channel after TALKER DET\n");
+		rsl_tx_conn_fail(lchan, RSL_ERR_TALKER_ACC_FAIL);
+		lchan->asci.talker_active = VGCS_TALKER_NONE;
+		return;
+	}
+
+	lchan->asci.ref = lchan->asci.cand.ra;
+	lchan->asci.fn = lchan->asci.cand.fn;
+
+	/* Send TALKER DETECT via RSL to BSC */
+	rsl_tx_talker_det(lchan, &acc_delay);
+
+	/* Send VGCS UPLINK GRANT */
+	lchan->asci.vgcs_ul_grant_count = 1;
+	tx_vgcs_ul_grant(lchan);
+	rate_ctr_inc2(bts->ctrs, BTS_CTR_VGCS_TALKER_GRANT);
+	bts_proc_lat_add(bts, BTS_PROC_LAT_VGCS_UL_GRANT, &lchan->asci.cand.first);
+
+	/* Start T3115 */
+	LOGPLCHAN(lchan, DASCI, LOGL_DEBUG, "Starting T3115 with %u ms\n", bts->t3115_ms);
+	lchan->asci.t3115.cb = vgcs_t3115_cb;
+	lchan->asci.t3115.data = lchan;
+	osmo_timer_schedule(&lchan->asci.t3115, 0, bts->t3115_ms * 1000);
+}
+
+/* timer call-back for the end of the talker selection window */
+static void vgcs_talker_window_cb(void *data)
+{
+	struct gsm_lchan *lchan = data;
+
+	if (lchan->state != LCHAN_S_ACTIVE) {
+		LOGPLCHAN(lchan, DASCI, LOGL_NOTICE, "is not active. It is in state %s. Ignoring\n",
+			  gsm_lchans_name(lchan->state));
+		lchan->asci.talker_active = VGCS_TALKER_NONE;
+		return;
+	}
+
+	vgcs_talker_grant(lchan);
+}
+
+/* Is the access burst 'rach_ind' a better talker candidate than lchan->asci.cand?
+ * The stronger one wins, the closer one if both are received equally strong. */
+static bool vgcs_talker_cand_better(const struct gsm_lchan *lchan, const struct ph_rach_ind_param *rach_ind)
+{
+	if (rach_ind->rssi != lchan->asci.cand.rssi)
+		return rach_ind->rssi > lchan->asci.cand.rssi;
+	return abs(rach_ind->acc_delay_256bits) < abs(lchan->asci.cand.toa256);
+}
+
+static void vgcs_talker_cand_set(struct gsm_lchan *lchan, const struct ph_rach_ind_param *rach_ind)
+{
+	lchan->asci.cand.ra = rach_ind->ra;
+	lchan->asci.cand.acc_delay = rach_ind->acc_delay;
+	lchan->asci.cand.toa256 = rach_ind->acc_delay_256bits;
+	lchan->asci.cand.rssi = rach_ind->rssi;
+	lchan->asci.cand.fn = rach_ind->fn;
+}
+
 /* Received random access on dedicated channel. */
-void vgcs_rach(struct gsm_lchan *lchan, uint8_t ra, uint8_t acc_delay, uint32_t fn)
+void vgcs_rach(struct gsm_lchan *lchan, const struct ph_rach_ind_param *rach_ind)
 {
+	uint8_t acc_delay = rach_ind->acc_delay;
+
 	LOGPLCHAN(lchan, DASCI, LOGL_NOTICE, "VGCS RACH on dedicated channel type %s received with "
-		  "TA=%u, ref=%u\n", gsm_lchant_name(lchan->type), acc_delay, ra);
+		  "TA=%u, ref=%u\n", gsm_lchant_name(lchan->type), acc_delay, rach_ind->ra);
 
-	if (ra == 0x25) { /* See TS 44.018 Table 9.1.45.1 */
+	if (rach_ind->ra == 0x25) { /* See TS 44.018 Table 9.1.45.1 */
 		/* Listener Detection (TS 48.058 Section 4.14) */
 		if (!lchan->asci.listener_detected) {
 			rsl_tx_listener_det(lchan, &acc_delay);
@@ -114,40 +192,41 @@ void vgcs_rach(struct gsm_lchan *lchan, uint8_t ra, uint8_t acc_delay, uint32_t
 		if (!rsl_chan_rt_is_vgcs(lchan->rsl_chan_rt))
 			return;
 
-		if (lchan->asci.talker_active != VGCS_TALKER_NONE) {
+		switch (lchan->asci.talker_active) {
+		case VGCS_TALKER_NONE:
+			break;
+		case VGCS_TALKER_SELECT:
+			/* Another MS is competing for the uplink within the window */
+			rate_ctr_inc2(bts->ctrs, BTS_CTR_VGCS_TALKER_COLLISION);
+			lchan->asci.cand.num++;
+			if (vgcs_talker_cand_better(lchan, rach_ind)) {
+				LOGPLCHAN(lchan, DASCI, LOGL_DEBUG, "RACH with ref=%u (RSSI=%d dBm) is the "
+					  "better talker candidate\n", rach_ind->ra, rach_ind->rssi);
+				vgcs_talker_cand_set(lchan, rach_ind);
+			}
+			return;
+		default:
+			rate_ctr_inc2(bts->ctrs, BTS_CTR_VGCS_TALKER_COLLISION);
 			LOGPLCHAN(lchan, DASCI, LOGL_DEBUG, "Ignoring RACH, there is an active talker already.\n");
 			return;
 		}
 
-		/* Set timing advance, power level and activate SACCH */
-		lchan->ta_ctrl.current = acc_delay;
-		lchan->ms_power_ctrl.current = lchan->ms_power_ctrl.max;
-		lchan->want_dl_sacch_active = true;
-
-		/* Stop RACH detection, wait for valid frame */
-		lchan->asci.talker_active = VGCS_TALKER_WAIT_FRAME;
-		if (l1sap_chan_modify(lchan->ts->trx, gsm_lchan2chan_nr(lchan)) != 0) {
-			LOGPLCHAN(lchan, DASCI, LOGL_ERROR, "failed to modify channel after TALKER DET\n");
-			rsl_tx_conn_fail(lchan, RSL_ERR_TALKER_ACC_FAIL);
-			lchan->asci.talker_active = VGCS_TALKER_NONE;
+		vgcs_talker_cand_set(lchan, rach_ind);
+		lchan->asci.cand.num = 1;
+		osmo_clock_gettime(CLOCK_MONOTONIC, &lchan->asci.cand.first);
+
+		if (bts->vgcs_talker_window_ms == 0) {
+			/* First come, first served */
+			vgcs_talker_grant(lchan);
 			return;
 		}
 
-		lchan->asci.ref = ra;
-		lchan->asci.fn = fn;
-
-		/* Send TALKER DETECT via RSL to BSC */
-		rsl_tx_talker_det(lchan, &acc_delay);
-
-		/* Send VGCS UPLINK GRANT */
-		lchan->asci.vgcs_ul_grant_count = 1;
-		tx_vgcs_ul_grant(lchan);
-
-		/* Start T3115 */
-		LOGPLCHAN(lchan, DASCI, LOGL_DEBUG, "Starting T3115 with %u ms\n", bts->t3115_ms);
-		lchan->asci.t3115.cb = vgcs_t3115_cb;
-		lchan->asci.t3115.data = lchan;
-		osmo_timer_schedule(&lchan->asci.t3115, 0, bts->t3115_ms * 1000);
+		/* Collect the access bursts of competing talkers, then grant the best one */
+		LOGPLCHAN(lchan, DASCI, LOGL_DEBUG, "Selecting the talker within %u ms\n",
+			  bts->vgcs_talker_window_ms);
+		lchan->asci.talker_active = VGCS_TALKER_SELECT;
+		osmo_timer_setup(&lchan->asci.talker_window, vgcs_talker_window_cb, lchan);
+		osmo_timer_schedule(&lchan->asci.talker_window, 0, bts->vgcs_talker_window_ms * 1000);
 	}
 }
 
@@ -176,8 +255,9 @@ void vgcs_talker_reset(struct gsm_lchan *lchan)
 
 	LOGPLCHAN(lchan, DASCI, LOGL_INFO, "Uplink released, no talker.\n");
 
-	/* Stop T3115 */
+	/* Stop T3115 and the talker selection */
 	osmo_timer_del(&lchan->asci.t3115);
+	osmo_timer_del(&lchan->asci.talker_window);
 
 	/* Talker detection done */
 	lchan->asci.talker_active = VGCS_TALKER_NONE;
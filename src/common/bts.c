@@ -21,10 +21,14 @@
  */
 
 #include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdio.h>
 
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
@@ -37,6 +41,7 @@
 #include <osmocom/core/rate_ctr.h>
 #include <osmocom/gsm/protocol/gsm_12_21.h>
 #include <osmocom/gsm/gsm48.h>
+#include <osmocom/gsm/gsm0502.h>
 #include <osmocom/gsm/lapdm.h>
 #include <osmocom/trau/osmo_ortp.h>
 
@@ -62,9 +67,13 @@
 #define MIN_QUAL_RACH	 50 /* minimum link quality (in centiBels) for Access Bursts */
 #define MIN_QUAL_NORM	 -5 /* minimum link quality (in centiBels) for Normal Bursts */
 
+/* T3126 is at most 5 s, see 3GPP TS 44.018 section 11.1.1 */
+#define AGCH_VALIDITY_FN_MAX	(5000 * 26 / 120)
+
 static void bts_update_agch_max_queue_length(struct gsm_bts *bts);
 
 void *tall_bts_ctx;
+void *tall_bts_hp_ctx;
 
 /* Table 3.1 TS 04.08: Values of parameter S */
 static const uint8_t tx_integer[] = {
@@ -97,12 +106,55 @@ static const struct rate_ctr_desc bts_ctr_desc[] = {
 	[BTS_CTR_RACH_DROP] =		{"rach:drop", "Dropped RACH requests (Um)"},
 	[BTS_CTR_RACH_HO] =		{"rach:handover", "Received RACH requests (Handover)"},
 	[BTS_CTR_RACH_VGCS] =		{"rach:vgcs", "Received RACH requests (VGCS)"},
+	[BTS_CTR_VGCS_TALKER_GRANT] =	{"vgcs:talker:grant", "Uplink granted to a new talker (VGCS)"},
+	[BTS_CTR_VGCS_TALKER_COLLISION] = {"vgcs:talker:collision",
+					  "Talker RACHs competing with another talker for the uplink (VGCS)"},
 	[BTS_CTR_RACH_CS] =		{"rach:cs", "Received RACH requests (CS/Abis)"},
 	[BTS_CTR_RACH_PS] =		{"rach:ps", "Received RACH requests (PS/PCU)"},
+	[BTS_CTR_RACH_SHED] =		{"rach:shed", "RACH requests not sent to the BSC (overload control)"},
+	[BTS_CTR_RACH_SHED_REJ] =	{"rach:shed:rej", "Shed RACH requests rejected locally (IMM ASS REJ)"},
+	[BTS_CTR_RACH_DEDUP] =		{"rach:dedup", "RACH requests not sent to the BSC (repetition of a recent one)"},
 
 	[BTS_CTR_AGCH_RCVD] =		{"agch:rcvd", "Received AGCH requests (Abis)"},
 	[BTS_CTR_AGCH_SENT] =		{"agch:sent", "Sent AGCH requests (Abis)"},
 	[BTS_CTR_AGCH_DELETED] =	{"agch:delete", "Sent AGCH DELETE IND (Abis)"},
+	[BTS_CTR_AGCH_REJ_SENT] =	{"agch:rej:sent", "Sent IMM ASS REJ messages (Um)"},
+	[BTS_CTR_AGCH_REJ_REFS] =	{"agch:rej:refs", "Request references in sent IMM ASS REJ messages (Um)"},
+
+	[BTS_CTR_GSMTAP_DROP] =		{"gsmtap:drop", "Dropped GSMTAP Um messages (writer queue full)"},
+	[BTS_CTR_LOG_ASYNC_DROP] =	{"log:async:drop", "Dropped log messages (log writer ring full)"},
+
+	[BTS_CTR_LOOPBACK_UL_GOOD] =	{"loopback:ul:good", "Uplink TCH/PDTCH blocks looped back to the Downlink"},
+	[BTS_CTR_LOOPBACK_UL_BAD] =	{"loopback:ul:bad", "Uplink TCH/PDTCH blocks not looped back (bad or missing)"},
+	[BTS_CTR_LOOPBACK_DL_EMPTY] =	{"loopback:dl:empty", "Downlink TCH/PDTCH blocks without a looped Uplink block"},
+
+	[BTS_CTR_RTP_POOL_HIT] =	{"rtp:pool:hit", "IPA CRCX served with a pre-bound RTP socket"},
+	[BTS_CTR_RTP_POOL_MISS] =	{"rtp:pool:miss", "IPA CRCX with the RTP socket pool empty"},
+	[BTS_CTR_RTP_MEDIA_DROP] =	{"rtp:media:drop", "Dropped RTP packets (media thread receive queue full)"},
+
+	[BTS_CTR_PCU_SHED_RTS] =	{"pcu:shed:rts", "Dropped RTS.req primitives (PCU socket queue full)"},
+	[BTS_CTR_PCU_SHED_DATA] =	{"pcu:shed:data", "Dropped DATA.ind primitives (PCU socket queue full)"},
+	[BTS_CTR_PCU_SHED_TIME] =	{"pcu:shed:time", "Dropped TIME.ind primitives (superseded while queued)"},
+	[BTS_CTR_PCU_SHED_INTERF] =	{"pcu:shed:interf", "Dropped INTERF.ind primitives (superseded while queued)"},
+	[BTS_CTR_PCU_SHED_INFO] =	{"pcu:shed:info", "Dropped INFO.ind primitives (superseded while queued)"},
+
+	[BTS_CTR_LOOP_MS_PWR_RAISE] =	{"loop:ms-pwr:raise", "MS power raised (MS Power Control Loop)"},
+	[BTS_CTR_LOOP_MS_PWR_LOWER] =	{"loop:ms-pwr:lower", "MS power lowered (MS Power Control Loop)"},
+	[BTS_CTR_LOOP_MS_PWR_REVERSAL] = {"loop:ms-pwr:reversal",
+					  "MS power changed in the opposite direction than the last time"},
+	[BTS_CTR_LOOP_BS_PWR_RAISE] =	{"loop:bs-pwr:raise", "BS power raised (BS Power Control Loop)"},
+	[BTS_CTR_LOOP_BS_PWR_LOWER] =	{"loop:bs-pwr:lower", "BS power lowered (BS Power Control Loop)"},
+	[BTS_CTR_LOOP_BS_PWR_REVERSAL] = {"loop:bs-pwr:reversal",
+					  "BS power changed in the opposite direction than the last time"},
+	[BTS_CTR_LOOP_TA_RAISE] =	{"loop:ta:raise", "Timing Advance raised (TA Control Loop)"},
+	[BTS_CTR_LOOP_TA_LOWER] =	{"loop:ta:lower", "Timing Advance lowered (TA Control Loop)"},
+	[BTS_CTR_LOOP_TA_REVERSAL] =	{"loop:ta:reversal",
+					 "Timing Advance changed in the opposite direction than the last time"},
+	[BTS_CTR_LOOP_TA_CLAMPED] =	{"loop:ta:clamped",
+					 "Timing Advance change limited to the maximum step (TA Control Loop)"},
+	[BTS_CTR_ACCH_REP_DL_FACCH] =	{"acch:rep:dl-facch", "SACCH periods with DL-FACCH repetition active"},
+	[BTS_CTR_ACCH_REP_UL_SACCH] =	{"acch:rep:ul-sacch", "SACCH periods with UL-SACCH repetition active"},
+	[BTS_CTR_ACCH_OVERPOWER] =	{"acch:overpower", "SACCH periods with temporary ACCH overpower active"},
 };
 static const struct rate_ctr_group_desc bts_ctrg_desc = {
 	"bts",
@@ -145,6 +197,8 @@ struct osmo_tdef bts_T_defs[] = {
 
 struct osmo_tdef abis_T_defs[] = {
 	{ .T=-15, .default_val=0, .unit=OSMO_TDEF_MS, .desc="Time to wait between Channel Activation and dispatching a cached early Immediate Assignment" },
+	{ .T=-16, .default_val=5000, .unit=OSMO_TDEF_MS, .desc="Time to wait before (re)connecting to a BSC, after the OML link was lost or failed to come up" },
+	{ .T=-17, .default_val=0, .unit=OSMO_TDEF_S, .desc="Time to keep BCCH/CCCH on the air after the OML link was lost, waiting for it to come back (0: shut down right away)" },
 	{}
 };
 
@@ -310,8 +364,9 @@ int bts_init(struct gsm_bts *bts)
 
 	bts->band = GSM_BAND_1800;
 
-	INIT_LLIST_HEAD(&bts->agch_queue.queue);
 	bts->agch_queue.length = 0;
+	bts->agch_queue.validity_fn = AGCH_VALIDITY_FN_MAX;
+	INIT_LLIST_HEAD(&bts->agch_queue.open_rejs);
 
 	bts->ctrs = rate_ctr_group_alloc(bts, &bts_ctrg_desc, bts->nr);
 	if (!bts->ctrs)
@@ -334,6 +389,10 @@ int bts_init(struct gsm_bts *bts)
 	bts->rtp_ip_dscp = -1;
 	bts->rtp_priority = -1;
 	bts->emit_hr_rfc5993 = true;
+	bts->gsmtap.sampling = 1;
+	bts->pcap.sapi_mask = UINT32_MAX;
+	bts->pcap.sapi_acch = 1;
+	bts->mem_lock.heap_reserve_mb = 4;
 
 	/* Default (fall-back) MS/BS Power control parameters */
 	power_ctrl_params_def_reset(&bts->bs_dpc_params, true);
@@ -352,8 +411,11 @@ int bts_init(struct gsm_bts *bts)
 	bts->min_qual_rach = MIN_QUAL_RACH;
 	bts->min_qual_norm = MIN_QUAL_NORM;
 	bts->max_ber10k_rach = 1707; /* 7 of 41 bits is Eb/N0 of 0 dB = 0.1707 */
+	bts->rach_shed.burst = BTS_RACH_SHED_BURST_DEFAULT;
+	bts->rach_shed.wait_ind = -1;
 	bts->pcu.sock_path = talloc_strdup(bts, PCU_SOCK_DEFAULT);
 	bts->pcu.sock_wqueue_len_max = BTS_PCU_SOCK_WQUEUE_LEN_DEFAULT;
+	bts->pcu.time_ind_interval = 1;
 	for (i = 0; i < ARRAY_SIZE(bts->t200_ms); i++)
 		bts->t200_ms[i] = oml_default_t200_ms[i];
 
@@ -405,6 +467,7 @@ int bts_init(struct gsm_bts *bts)
 	bts->smscb_queue_max_len = 15;
 	bts->smscb_queue_tgt_len = 2;
 	bts->smscb_queue_hyst = 2;
+	bts_cbch_update_load(bts);
 
 	bts->asci.pos_nch = -ENOTSUP;
 	INIT_LLIST_HEAD(&bts->asci.notifications);
@@ -479,6 +542,21 @@ int bts_agch_max_queue_length(int T, int bcch_conf)
 	return (T + 2 * S) * ccch_rach_ratio256 / 256;
 }
 
+/* T3126 = T + 2*S RACH slots, converted to TDMA frames (3GPP TS 44.018 3.3.1.1.2).
+ * 'tx_integer_code' is the Tx-integer field of the RACH Control Parameters. */
+static unsigned int bts_agch_validity_fn(int tx_integer_code, int bcch_conf)
+{
+	int is_ccch_comb = (bcch_conf == RSL_BCCH_CCCH_CONF_1_C);
+	unsigned int idx = tx_integer_code % ARRAY_SIZE(tx_integer);
+	unsigned int slots = tx_integer[idx] + 2 * s_values[idx % 5][is_ccch_comb];
+
+	/* 27 out of 51 frames carry a RACH slot if the CCCH is combined */
+	if (is_ccch_comb)
+		slots = slots * 51 / 27;
+
+	return OSMO_MIN(slots, AGCH_VALIDITY_FN_MAX);
+}
+
 static void bts_update_agch_max_queue_length(struct gsm_bts *bts)
 {
 	struct gsm48_system_information_type_3 *si3;
@@ -492,6 +570,9 @@ static void bts_update_agch_max_queue_length(struct gsm_bts *bts)
 	bts->agch_queue.max_length =
 		bts_agch_max_queue_length(si3->rach_control.tx_integer,
 					  si3->control_channel_desc.ccch_conf);
+	bts->agch_queue.validity_fn =
+		bts_agch_validity_fn(si3->rach_control.tx_integer,
+				     si3->control_channel_desc.ccch_conf);
 
 	if (bts->agch_queue.max_length != old_max_length)
 		LOGP(DRSL, LOGL_INFO, "Updated AGCH max queue length to %d\n",
@@ -625,12 +706,178 @@ static int try_merge_imm_ass_rej(struct gsm48_imm_ass_rej *old_rej,
 	return 0;
 }
 
+#define AGCH_MSG_CB(msg) ((struct bts_agch_msg_cb *) (msg)->cb)
+
+/* Whether fn a is before fn b (both within half a hyperframe of each other) */
+static inline bool agch_fn_before(uint32_t a, uint32_t b)
+{
+	uint32_t d = GSM_TDMA_FN_SUB(b, a);
+
+	return d != 0 && d < GSM_TDMA_HYPERFRAME / 2;
+}
+
+/* Age of a request reference at 'now', in TDMA frames (modulo 42432) */
+static uint32_t agch_req_ref_age(const struct gsm48_req_ref *ref, uint32_t now)
+{
+	struct gsm_time gt = {
+		.t1 = ref->t1,
+		.t2 = ref->t2,
+		.t3 = (ref->t3_high << 3) | ref->t3_low,
+	};
+
+	return ((now % 42432) + 42432 - gsm_gsmtime2fn(&gt)) % 42432;
+}
+
+/* The MS stops listening for an answer T3126 after its last CHANNEL REQUEST.
+ * If the message refers to several requests, the latest of them counts. */
+static uint32_t agch_msg_deadline(const struct gsm_bts *bts, const struct msgb *msg, uint32_t now)
+{
+	const struct gsm48_imm_ass *ia = msgb_l3(msg);
+	const struct gsm48_imm_ass_ext *ia_ext = msgb_l3(msg);
+	const struct gsm48_imm_ass_rej *rej = msgb_l3(msg);
+	uint32_t age = 0;
+
+	switch (ia->msg_type) {
+	case GSM48_MT_RR_IMM_ASS:
+		if (msgb_l3len(msg) < sizeof(*ia))
+			break;
+		age = agch_req_ref_age(&ia->req_ref, now);
+		break;
+	case GSM48_MT_RR_IMM_ASS_EXT:
+		if (msgb_l3len(msg) < sizeof(*ia_ext))
+			break;
+		age = OSMO_MIN(agch_req_ref_age(&ia_ext->req_ref1, now),
+			       agch_req_ref_age(&ia_ext->req_ref2, now));
+		break;
+	case GSM48_MT_RR_IMM_ASS_REJ:
+		if (msgb_l3len(msg) < sizeof(*rej))
+			break;
+		age = OSMO_MIN(OSMO_MIN(agch_req_ref_age(&rej->req_ref1, now),
+					agch_req_ref_age(&rej->req_ref2, now)),
+			       OSMO_MIN(agch_req_ref_age(&rej->req_ref3, now),
+					agch_req_ref_age(&rej->req_ref4, now)));
+		break;
+	}
+
+	return GSM_TDMA_FN_SUM(GSM_TDMA_FN_SUB(now, age), bts->agch_queue.validity_fn);
+}
+
+/* Whether message a is to be sent before message b: earliest deadline
+ * first, in order of arrival for the same deadline. */
+static bool agch_msg_before(const struct msgb *a, const struct msgb *b)
+{
+	const struct bts_agch_msg_cb *cb_a = AGCH_MSG_CB(a);
+	const struct bts_agch_msg_cb *cb_b = AGCH_MSG_CB(b);
+
+	if (cb_a->deadline_fn != cb_b->deadline_fn)
+		return agch_fn_before(cb_a->deadline_fn, cb_b->deadline_fn);
+	return (int32_t)(cb_b->seq - cb_a->seq) > 0;
+}
+
+static void agch_heap_set(struct gsm_bts *bts, unsigned int idx, struct msgb *msg)
+{
+	bts->agch_queue.heap[idx] = msg;
+	AGCH_MSG_CB(msg)->heap_idx = idx;
+}
+
+static void agch_heap_sift_up(struct gsm_bts *bts, unsigned int idx)
+{
+	struct msgb *msg = bts->agch_queue.heap[idx];
+
+	while (idx > 0 && agch_msg_before(msg, bts->agch_queue.heap[(idx - 1) / 2])) {
+		agch_heap_set(bts, idx, bts->agch_queue.heap[(idx - 1) / 2]);
+		idx = (idx - 1) / 2;
+	}
+	agch_heap_set(bts, idx, msg);
+}
+
+static void agch_heap_sift_down(struct gsm_bts *bts, unsigned int idx)
+{
+	struct msgb *msg = bts->agch_queue.heap[idx];
+	unsigned int len = bts->agch_queue.length;
+	unsigned int child;
+
+	while ((child = 2 * idx + 1) < len) {
+		if (child + 1 < len &&
+		    agch_msg_before(bts->agch_queue.heap[child + 1], bts->agch_queue.heap[child]))
+			child++;
+		if (!agch_msg_before(bts->agch_queue.heap[child], msg))
+			break;
+		agch_heap_set(bts, idx, bts->agch_queue.heap[child]);
+		idx = child;
+	}
+	agch_heap_set(bts, idx, msg);
+}
+
+/* Remove the message at heap position idx from the AGCH queue */
+static struct msgb *agch_heap_remove(struct gsm_bts *bts, unsigned int idx)
+{
+	struct msgb *msg = bts->agch_queue.heap[idx];
+
+	bts->agch_queue.length--;
+	if (idx != bts->agch_queue.length) {
+		agch_heap_set(bts, idx, bts->agch_queue.heap[bts->agch_queue.length]);
+		agch_heap_sift_down(bts, idx);
+		agch_heap_sift_up(bts, idx);
+	}
+
+	/* no-op unless it is an open IMM ASS REJ */
+	llist_del_init(&msg->list);
+	return msg;
+}
+
+static bool imm_ass_rej_is_full(struct gsm48_imm_ass_rej *rej)
+{
+	struct gsm48_req_ref req_refs[REQ_REFS_PER_IMM_ASS_REJ];
+	uint8_t wait_inds[REQ_REFS_PER_IMM_ASS_REJ];
+
+	return extract_imm_ass_rej_refs(rej, req_refs, wait_inds) == REQ_REFS_PER_IMM_ASS_REJ;
+}
+
+/* Merge an IMM ASS REJ into the queued ones which still have room, oldest
+ * first.  Returns true if all of its request references were taken over,
+ * otherwise the remaining ones are left in new_rej. */
+static bool agch_merge_imm_ass_rej(struct gsm_bts *bts, struct gsm48_imm_ass_rej *new_rej, uint32_t now)
+{
+	struct msgb *old_msg, *tmp;
+	bool merged = false;
+
+	llist_for_each_entry_safe(old_msg, tmp, &bts->agch_queue.open_rejs, list) {
+		struct gsm48_imm_ass_rej *old_rej = msgb_l3(old_msg);
+
+		merged = try_merge_imm_ass_rej(old_rej, new_rej);
+
+		/* the old message may have taken over newer request references */
+		AGCH_MSG_CB(old_msg)->deadline_fn = agch_msg_deadline(bts, old_msg, now);
+		agch_heap_sift_down(bts, AGCH_MSG_CB(old_msg)->heap_idx);
+
+		if (imm_ass_rej_is_full(old_rej))
+			llist_del_init(&old_msg->list);
+		if (merged)
+			break;
+	}
+
+	return merged;
+}
+
+/* The AGCH queue is ordered by the deadline of the messages (see
+ * agch_msg_deadline()), and limited to the number of CCCH blocks within
+ * T3126 (see bts_agch_max_queue_length()). */
 int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
 {
-	int hard_limit = 100;
+	int hard_limit = OSMO_MIN(OSMO_MAX(bts->agch_queue.max_length, 1), BTS_AGCH_QUEUE_MAX);
 	struct gsm48_imm_ass_rej *imm_ass_cmd = msgb_l3(msg);
+	uint32_t now = bts->gsm_time.fn;
+
+	/* Merging needs no room in the queue, so try it first */
+	if (imm_ass_cmd->msg_type == GSM48_MT_RR_IMM_ASS_REJ &&
+	    agch_merge_imm_ass_rej(bts, imm_ass_cmd, now)) {
+		bts->agch_queue.merged_msgs++;
+		msgb_free(msg);
+		return 0;
+	}
 
-	if (bts->agch_queue.length > hard_limit) {
+	if (bts->agch_queue.length >= hard_limit) {
 		LOGP(DRR, LOGL_ERROR,
 		     "AGCH: too many messages in queue, "
 		     "refusing message type %s, length = %d/%d\n",
@@ -641,46 +888,147 @@ int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
 		return -ENOMEM;
 	}
 
-	if (bts->agch_queue.length > 0) {
-		struct msgb *last_msg =
-			llist_entry(bts->agch_queue.queue.prev, struct msgb, list);
-		struct gsm48_imm_ass_rej *last_imm_ass_rej = msgb_l3(last_msg);
+	AGCH_MSG_CB(msg)->deadline_fn = agch_msg_deadline(bts, msg, now);
+	AGCH_MSG_CB(msg)->seq = bts->agch_queue.seq++;
+	agch_heap_set(bts, bts->agch_queue.length++, msg);
+	agch_heap_sift_up(bts, AGCH_MSG_CB(msg)->heap_idx);
 
-		if (try_merge_imm_ass_rej(last_imm_ass_rej, imm_ass_cmd)) {
-			bts->agch_queue.merged_msgs++;
-			msgb_free(msg);
-			return 0;
-		}
+	INIT_LLIST_HEAD(&msg->list);
+	if (imm_ass_cmd->msg_type == GSM48_MT_RR_IMM_ASS_REJ && !imm_ass_rej_is_full(imm_ass_cmd))
+		llist_add_tail(&msg->list, &bts->agch_queue.open_rejs);
+
+	return 0;
+}
+
+/* Reject a shed RACH request right away, instead of letting the MS retry */
+static void rach_shed_tx_rej(struct gsm_bts *bts, uint8_t ra, uint32_t fn)
+{
+	struct gsm48_imm_ass_rej *rej;
+	struct gsm_time gt;
+	struct msgb *msg;
+
+	msg = msgb_alloc(GSM_MACBLOCK_LEN, "IMM ASS REJ");
+	if (!msg)
+		return;
+	msg->l3h = msgb_put(msg, GSM_MACBLOCK_LEN);
+	memset(msg->l3h, GSM_MACBLOCK_PADDING, GSM_MACBLOCK_LEN);
+
+	rej = (struct gsm48_imm_ass_rej *) msg->l3h;
+	memset(rej, 0, sizeof(*rej));
+	rej->l2_plen = GSM48_LEN2PLEN(sizeof(*rej) - 1);
+	rej->proto_discr = GSM48_PDISC_RR;
+	rej->msg_type = GSM48_MT_RR_IMM_ASS_REJ;
+	rej->page_mode = GSM48_PM_SAME;
+
+	gsm_fn2gsmtime(&gt, fn);
+	rej->req_ref1.ra = ra;
+	rej->req_ref1.t1 = gt.t1;
+	rej->req_ref1.t2 = gt.t2;
+	rej->req_ref1.t3_high = gt.t3 >> 3;
+	rej->req_ref1.t3_low = gt.t3 & 0x07;
+	rej->wait_ind1 = bts->rach_shed.wait_ind;
+
+	/* 3GPP TS 44.018 9.1.20.2: the unused references repeat the first one */
+	rej->req_ref2 = rej->req_ref3 = rej->req_ref4 = rej->req_ref1;
+	rej->wait_ind2 = rej->wait_ind3 = rej->wait_ind4 = rej->wait_ind1;
+
+	/* merged with the other queued IMM ASS REJ, if there is room in one */
+	if (bts_agch_enqueue(bts, msg) < 0) {
+		msgb_free(msg);
+		return;
+	}
+
+	rate_ctr_inc2(bts->ctrs, BTS_CTR_RACH_SHED_REJ);
+}
+
+/* Whether to shed a CS RACH request instead of sending a CHAN RQD to the
+ * BSC.  The CHAN RQD are limited by a token bucket of 'rach-shed rate' per
+ * second; besides, none are sent while the AGCH queue is full, as the
+ * answer of the BSC would be refused anyway.  Emergency calls are never
+ * shed. */
+bool bts_rach_shed(struct gsm_bts *bts, uint8_t ra, uint32_t fn)
+{
+	int agch_max = OSMO_MAX(bts->agch_queue.max_length, 1);
+	uint32_t elapsed;
+	uint64_t level;
+
+	if (bts->rach_shed.rate == 0)
+		return false;
+
+	/* 3GPP TS 44.018 Table 9.1.8.1: 101xxxxx is an emergency call */
+	if ((ra & 0xe0) == 0xa0)
+		return false;
+
+	/* refill: rate per second is rate * 60/13 thousandths per TDMA frame;
+	 * a frame number from the past (or the first one) only resyncs */
+	elapsed = GSM_TDMA_FN_SUB(fn, bts->rach_shed.last_fn);
+	if (elapsed < GSM_TDMA_HYPERFRAME / 2) {
+		level = bts->rach_shed.level + (uint64_t)elapsed * bts->rach_shed.rate * 60 / 13;
+		bts->rach_shed.level = OSMO_MIN(level, bts->rach_shed.burst * 1000ULL);
 	}
+	bts->rach_shed.last_fn = fn;
 
-	msgb_enqueue(&bts->agch_queue.queue, msg);
-	bts->agch_queue.length++;
+	if (bts->rach_shed.level >= 1000 && bts->agch_queue.length < agch_max) {
+		bts->rach_shed.level -= 1000;
+		return false;
+	}
 
-	return 0;
+	LOGPFN(DRSL, LOGL_INFO, fn, "RACH overload: not sending CHAN RQD for ra=0x%02x%s\n",
+	       ra, bts->rach_shed.wait_ind >= 0 ? ", rejecting it" : "");
+	rate_ctr_inc2(bts->ctrs, BTS_CTR_RACH_SHED);
+	if (bts->rach_shed.wait_ind >= 0)
+		rach_shed_tx_rej(bts, ra, fn);
+	return true;
+}
+
+/* Whether a CS RACH request repeats one received on the same CCCH timeslot
+ * with the same RA within the last 'rach-dedup' TDMA frames.  The BSC could
+ * not tell the two apart either (same request reference but for the frame
+ * number), so only the first one is sent as CHAN RQD. */
+bool bts_rach_dedup(struct gsm_bts *bts, uint8_t ra, uint8_t tn, uint32_t fn)
+{
+	struct bts_rach_dedup_entry *e;
+	unsigned int i;
+
+	if (bts->rach_dedup.window_fn == 0)
+		return false;
+
+	for (i = 0; i < ARRAY_SIZE(bts->rach_dedup.recent); i++) {
+		const struct bts_rach_dedup_entry *r = &bts->rach_dedup.recent[i];
+
+		if (!r->valid || r->ra != ra || r->tn != tn)
+			continue;
+		if (GSM_TDMA_FN_SUB(fn, r->fn) > bts->rach_dedup.window_fn)
+			continue;
+
+		LOGPFN(DRSL, LOGL_INFO, fn, "RACH ra=0x%02x on TS%u repeats the one of fn=%u, "
+		       "not sending CHAN RQD\n", ra, tn, r->fn);
+		rate_ctr_inc2(bts->ctrs, BTS_CTR_RACH_DEDUP);
+		return true;
+	}
+
+	e = &bts->rach_dedup.recent[bts->rach_dedup.next];
+	*e = (struct bts_rach_dedup_entry) { .fn = fn, .ra = ra, .tn = tn, .valid = true };
+	bts->rach_dedup.next = (bts->rach_dedup.next + 1) % ARRAY_SIZE(bts->rach_dedup.recent);
+	return false;
 }
 
 static struct msgb *bts_agch_dequeue(struct gsm_bts *bts)
 {
-	struct msgb *msg = msgb_dequeue(&bts->agch_queue.queue);
-	if (!msg)
+	if (bts->agch_queue.length == 0)
 		return NULL;
 
-	bts->agch_queue.length--;
-	return msg;
+	return agch_heap_remove(bts, 0);
 }
 
 /*
- * Remove lower prio messages if the queue has grown too long.
- *
- * \return 0 if the number of messages in the queue would fit into the AGCH
- *         reserved part of the CCCH.
+ * Remove the messages which passed their deadline.  If the queue has grown
+ * too long, also remove those closest to their deadline.
  */
-static void compact_agch_queue(struct gsm_bts *bts)
+static void compact_agch_queue(struct gsm_bts *bts, uint32_t fn)
 {
-	struct msgb *msg, *msg2;
-	int max_len, slope, offs;
+	int max_len, target_len;
 	int level_low = bts->agch_queue.low_level;
-	int level_high = bts->agch_queue.high_level;
 	int level_thres = bts->agch_queue.thresh_level;
 
 	max_len = bts->agch_queue.max_length;
@@ -688,41 +1036,27 @@ static void compact_agch_queue(struct gsm_bts *bts)
 	if (max_len == 0)
 		max_len = 1;
 
-	if (bts->agch_queue.length < max_len * level_thres / 100)
-		return;
-
-	/* p^
-	 * 1+      /'''''
-	 *  |     /
-	 *  |    /
-	 * 0+---/--+----+--> Q length
-	 *    low high max_len
-	 */
-
-	offs = max_len * level_low / 100;
-	if (level_high > level_low)
-		slope = 0x10000 * 100 / (level_high - level_low);
+	/* Once the threshold is reached, only keep up to the low water mark
+	 * (the high water mark is no longer used) */
+	if (bts->agch_queue.length >= max_len * level_thres / 100)
+		target_len = max_len * level_low / 100;
 	else
-		slope = 0x10000 * max_len; /* p_drop >= 1 if len > offs */
-
-	llist_for_each_entry_safe(msg, msg2, &bts->agch_queue.queue, list) {
-		struct gsm48_imm_ass *imm_ass_cmd = msgb_l3(msg);
-		int p_drop;
+		target_len = bts->agch_queue.length;
 
-		p_drop = (bts->agch_queue.length - offs) * slope / max_len;
+	while (bts->agch_queue.length > 0) {
+		struct msgb *msg = bts->agch_queue.heap[0];
 
-		if ((random() & 0xffff) >= p_drop)
-			return;
+		if (bts->agch_queue.length <= target_len &&
+		    agch_fn_before(fn, AGCH_MSG_CB(msg)->deadline_fn))
+			break;
 
-		llist_del(&msg->list);
-		bts->agch_queue.length--;
-		rsl_tx_delete_ind(bts, (uint8_t *)imm_ass_cmd, msgb_l3len(msg));
+		agch_heap_remove(bts, 0);
+		rsl_tx_delete_ind(bts, msgb_l3(msg), msgb_l3len(msg));
 		rate_ctr_inc2(bts->ctrs, BTS_CTR_AGCH_DELETED);
 		msgb_free(msg);
 
 		bts->agch_queue.dropped_msgs++;
 	}
-	return;
 }
 
 int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt, enum ccch_msgt ccch)
@@ -737,7 +1071,7 @@ int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt
 	 * the queue max length is calculated based on the CCCH block rate and
 	 * PCH messages also reduce the drain of the AGCH queue.
 	 */
-	compact_agch_queue(bts);
+	compact_agch_queue(bts, gt->fn);
 
 	switch (ccch) {
 	case CCCH_MSGT_NCH:
@@ -760,6 +1094,15 @@ int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt
 	}
 
 	rate_ctr_inc2(bts->ctrs, BTS_CTR_AGCH_SENT);
+	if (((struct gsm48_imm_ass_rej *)msgb_l3(msg))->msg_type == GSM48_MT_RR_IMM_ASS_REJ) {
+		struct gsm48_req_ref req_refs[REQ_REFS_PER_IMM_ASS_REJ];
+		uint8_t wait_inds[REQ_REFS_PER_IMM_ASS_REJ];
+
+		/* agch:rej:refs / agch:rej:sent is the merge efficiency */
+		rate_ctr_inc2(bts->ctrs, BTS_CTR_AGCH_REJ_SENT);
+		rate_ctr_add2(bts->ctrs, BTS_CTR_AGCH_REJ_REFS,
+			      extract_imm_ass_rej_refs(msgb_l3(msg), req_refs, wait_inds));
+	}
 
 	/* Confirm sending of the AGCH message towards the PCU */
 	msg_cb = (struct bts_agch_msg_cb *) msg->cb;
@@ -997,3 +1340,148 @@ int bts_set_c0_pwr_red(struct gsm_bts *bts, const uint8_t red)
 
 	return 0;
 }
+
+const struct value_string bts_proc_lat_names[] = {
+	{ BTS_PROC_LAT_CHAN_ACT_PHY_REQ,	"CHAN ACTIV -> PHY activation request" },
+	{ BTS_PROC_LAT_CHAN_ACT_PHY_CNF,	"PHY activation request -> confirm" },
+	{ BTS_PROC_LAT_CHAN_ACT,		"CHAN ACTIV -> CHAN ACTIV ACK" },
+	{ BTS_PROC_LAT_MODE_MODIF,		"MODE MODIFY -> MODE MODIFY ACK" },
+	{ BTS_PROC_LAT_IPAC_CRCX,		"IPA CRCX -> IPA CRCX ACK" },
+	{ BTS_PROC_LAT_IPAC_MDCX,		"IPA MDCX -> IPA MDCX ACK" },
+	{ BTS_PROC_LAT_VGCS_UL_GRANT,		"Talker RACH -> VGCS UPLINK GRANT" },
+	{ BTS_PROC_LAT_TS_SWITCH,		"Dyn TS switch -> TS reconnected" },
+	{ BTS_PROC_LAT_IPAC_PDCH,		"PDCH (DE)ACT -> PDCH (DE)ACT ACK" },
+	{ BTS_PROC_LAT_HO_FIRST_FRAME,		"HANDOver DETect -> first valid frame" },
+	{ 0, NULL }
+};
+
+/*! Account the latency of a procedure stage, which started at 'start'.
+ *  Nothing is accounted if 'start' is zero (the stage was not started). */
+void bts_proc_lat_add(struct gsm_bts *bts, enum bts_proc_lat stage, const struct timespec *start)
+{
+	struct bts_proc_lat_stats *st = &bts->proc_lat[stage];
+	unsigned long long lat_us;
+	struct timespec now;
+	unsigned int i;
+
+	if (start->tv_sec == 0 && start->tv_nsec == 0)
+		return;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	lat_us = (now.tv_sec - start->tv_sec) * 1000000LL + (now.tv_nsec - start->tv_nsec) / 1000;
+
+	for (i = 0; i < BTS_PROC_LAT_HIST_LEN - 1; i++) {
+		if (lat_us < (250ULL << i))
+			break;
+	}
+	st->hist[i]++;
+	st->count++;
+	st->sum_us += lat_us;
+	if (lat_us > st->max_us)
+		st->max_us = lat_us;
+}
+
+/* Stack which the main loop may use, pre-faulted by bts_mem_lock() */
+#define BTS_MEM_STACK_PREFAULT	(256 * 1024)
+
+static void __attribute__((noinline)) mem_prefault_stack(void)
+{
+	volatile uint8_t buf[BTS_MEM_STACK_PREFAULT];
+	unsigned int i;
+
+	for (i = 0; i < sizeof(buf); i += 4096)
+		buf[i] = 0;
+}
+
+/*! Lock all current and future memory of the process into RAM, if enabled
+ *  by 'memory-lock'.  With SCHED_RR alone the frame handling still stalls
+ *  on page faults when buffers are touched after a long idle period or
+ *  under memory pressure.  The heap is never returned to the kernel, so
+ *  memory freed by talloc and msgb is reused without faulting again.
+ *  \returns 0 on success (or if disabled); negative on error. */
+int bts_mem_lock(struct gsm_bts *bts)
+{
+	if (!bts->mem_lock.enabled || bts->mem_lock.locked)
+		return 0;
+
+	/* serve all allocations from the (locked) heap and keep it */
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Failed to lock the process memory: %s\n",
+		     strerror(errno));
+		return -errno;
+	}
+
+	mem_prefault_stack();
+	bts->mem_lock.locked = true;
+
+	LOGP(DLGLOBAL, LOGL_NOTICE, "Locked the process memory into RAM\n");
+	return 0;
+}
+
+/*! Make sure the locked heap has 'memory-lock heap-reserve' of free space
+ *  per TRX, so that the buffers allocated at run time (msgb, talloc
+ *  chunks) are served from memory which is already faulted in.  Called from trx_sched_init(); the freed block stays in the
+ *  heap, so calling this again only faults in what is missing. */
+void bts_mem_prefault_heap(struct gsm_bts *bts)
+{
+	size_t len = (size_t) bts->mem_lock.heap_reserve_mb * 1024 * 1024 * bts->num_trx;
+	void *buf;
+
+	if (!bts->mem_lock.locked || len == 0)
+		return;
+
+	buf = malloc(len);
+	if (!buf) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Failed to pre-fault %zu MiB of heap\n",
+		     len / (1024 * 1024));
+		return;
+	}
+	memset(buf, 0, len);
+	free(buf);
+}
+
+/* Size of a transparent huge page (PMD size on x86_64 and arm64) */
+#define BTS_HUGEPAGE_SIZE	(2 * 1024 * 1024)
+
+/*! Set up the talloc pool of 'memory-hugepages' huge pages, from which the
+ *  scheduler structures and the L1SAP/RSL msgb pools are allocated: with
+ *  many TRX, their TLB misses show up on the burst handling path.  The
+ *  pool is backed by transparent huge pages (MADV_HUGEPAGE), faulted in
+ *  right away.  Once it is used up, talloc falls back to the heap, and
+ *  like any talloc pool, the memory of freed chunks is only reused once
+ *  all of them are freed; what lives in it is allocated once and kept.
+ *  Its usage is shown by 'show bts' and 'show talloc-context'.
+ *  \returns 0 on success (or if disabled); negative on error. */
+int bts_hugepages_init(struct gsm_bts *bts)
+{
+	size_t len = (size_t) bts->mem_hugepages * BTS_HUGEPAGE_SIZE;
+	uint8_t *pool, *start;
+
+	if (len == 0 || tall_bts_hp_ctx)
+		return 0;
+
+	/* one more page for aligning to a huge page boundary */
+	pool = talloc_pool(tall_bts_ctx, len + BTS_HUGEPAGE_SIZE);
+	if (!pool) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Failed to allocate a pool of %u huge pages\n",
+		     bts->mem_hugepages);
+		return -ENOMEM;
+	}
+	talloc_set_name_const(pool, "hugepage_pool");
+
+	start = (uint8_t *) (((uintptr_t) pool + BTS_HUGEPAGE_SIZE - 1)
+			     & ~((uintptr_t) BTS_HUGEPAGE_SIZE - 1));
+	if (madvise(start, len, MADV_HUGEPAGE) != 0) {
+		/* still a pool of contiguous memory, just not in huge pages */
+		LOGP(DLGLOBAL, LOGL_NOTICE, "Hugepage pool is not backed by huge pages: %s\n",
+		     strerror(errno));
+	}
+	memset(start, 0, len);
+
+	tall_bts_hp_ctx = pool;
+	LOGP(DLGLOBAL, LOGL_NOTICE, "Allocated a pool of %u huge pages\n", bts->mem_hugepages);
+	return 0;
+}
@@ -20,12 +20,19 @@
  */
 
 #include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
 
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/talloc.h>
 #include <osmocom/gsm/protocol/gsm_12_21.h>
 #include <osmocom/ctrl/control_cmd.h>
+#include <osmocom/ctrl/control_if.h>
 
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
@@ -84,12 +91,230 @@ static int set_oml_alert(struct ctrl_cmd *cmd, void *data)
 	return CTRL_CMD_REPLY;
 }
 
+/*
+ * stats-dump and stats-dump-delta return all counters and stat items in a
+ * single reply, one "<group prefix>.<group index>.<name> <value>" line each
+ * (the naming of the shared memory export), after a first line with the
+ * number of entries.  The delta variant remembers the values returned to a
+ * CTRL connection and only returns what changed since its previous read:
+ * the increment of counters and the current value of stat items.  This
+ * state is allocated as a child of the connection, so it is released when
+ * the client disconnects.
+ */
+
+/* values of one counter or stat item group at the last delta read */
+struct stats_dump_group {
+	struct llist_head list;
+	const char *key;	/* "c:<prefix>.<idx>" or "s:<prefix>.<idx>" */
+	bool seen;		/* still exists at the current read */
+	unsigned int num;
+	int64_t val[0];
+};
+
+struct stats_dump_client {
+	struct llist_head list;
+	struct ctrl_connection *ccon;
+	struct llist_head groups;
+};
+
+static LLIST_HEAD(g_stats_dump_clients);
+
+struct stats_dump_state {
+	struct ctrl_cmd *cmd;
+	struct stats_dump_client *client;	/* NULL: dump everything */
+	unsigned int num;
+};
+
+static int stats_dump_client_destructor(struct stats_dump_client *client)
+{
+	llist_del(&client->list);
+	return 0;
+}
+
+static struct stats_dump_client *stats_dump_client_get(struct ctrl_connection *ccon)
+{
+	struct stats_dump_client *client;
+
+	llist_for_each_entry(client, &g_stats_dump_clients, list) {
+		if (client->ccon == ccon)
+			return client;
+	}
+
+	client = talloc_zero(ccon, struct stats_dump_client);
+	if (!client)
+		return NULL;
+	client->ccon = ccon;
+	INIT_LLIST_HEAD(&client->groups);
+	llist_add(&client->list, &g_stats_dump_clients);
+	talloc_set_destructor(client, stats_dump_client_destructor);
+	return client;
+}
+
+/* find the values of a group at the previous read, zero on the first one */
+static struct stats_dump_group *stats_dump_group_get(struct stats_dump_client *client, char type,
+						     const char *prefix, unsigned int idx, unsigned int num)
+{
+	struct stats_dump_group *grp;
+	char key[128];
+
+	snprintf(key, sizeof(key), "%c:%s.%u", type, prefix, idx);
+	llist_for_each_entry(grp, &client->groups, list) {
+		if (strcmp(grp->key, key) != 0)
+			continue;
+		if (grp->num == num) {
+			grp->seen = true;
+			return grp;
+		}
+		llist_del(&grp->list);
+		talloc_free(grp);
+		break;
+	}
+
+	grp = talloc_zero_size(client, sizeof(*grp) + num * sizeof(grp->val[0]));
+	if (!grp)
+		return NULL;
+	grp->key = talloc_strdup(grp, key);
+	grp->seen = true;
+	grp->num = num;
+	llist_add_tail(&grp->list, &client->groups);
+	return grp;
+}
+
+static void stats_dump_line(struct stats_dump_state *st, const char *prefix, unsigned int idx,
+			    const char *name, int64_t val)
+{
+	/* out of memory, checked once the walk is done */
+	if (!st->cmd->reply)
+		return;
+	st->cmd->reply = talloc_asprintf_append_buffer(st->cmd->reply, "%s.%u.%s %" PRId64 "\n",
+						       prefix, idx, name, val);
+	st->num++;
+}
+
+static int stats_dump_ctr_group(struct rate_ctr_group *ctrg, void *data)
+{
+	struct stats_dump_state *st = data;
+	const struct rate_ctr_group_desc *desc = ctrg->desc;
+	struct stats_dump_group *grp = NULL;
+	unsigned int i;
+	int64_t val;
+
+	if (st->client) {
+		grp = stats_dump_group_get(st->client, 'c', desc->group_name_prefix, ctrg->idx, desc->num_ctr);
+		if (!grp)
+			return -ENOMEM;
+	}
+
+	for (i = 0; i < desc->num_ctr; i++) {
+		val = rate_ctr_group_get_ctr(ctrg, i)->current;
+		if (grp) {
+			int64_t delta = val - grp->val[i];
+			grp->val[i] = val;
+			if (delta == 0)
+				continue;
+			val = delta;
+		}
+		stats_dump_line(st, desc->group_name_prefix, ctrg->idx, desc->ctr_desc[i].name, val);
+	}
+	return 0;
+}
+
+static int stats_dump_statg(struct osmo_stat_item_group *statg, void *data)
+{
+	struct stats_dump_state *st = data;
+	const struct osmo_stat_item_group_desc *desc = statg->desc;
+	struct stats_dump_group *grp = NULL;
+	unsigned int i;
+	int64_t val;
+
+	if (st->client) {
+		grp = stats_dump_group_get(st->client, 's', desc->group_name_prefix, statg->idx, desc->num_items);
+		if (!grp)
+			return -ENOMEM;
+	}
+
+	for (i = 0; i < desc->num_items; i++) {
+		val = osmo_stat_item_get_last(osmo_stat_item_group_get_item(statg, i));
+		if (grp) {
+			if (val == grp->val[i])
+				continue;
+			grp->val[i] = val;
+		}
+		stats_dump_line(st, desc->group_name_prefix, statg->idx, desc->item_desc[i].name, val);
+	}
+	return 0;
+}
+
+static int stats_dump(struct ctrl_cmd *cmd, bool delta)
+{
+	struct stats_dump_state st = { .cmd = cmd };
+	struct stats_dump_group *grp, *tmp;
+	char *lines;
+
+	if (delta) {
+		if (!cmd->ccon) {
+			cmd->reply = "Deltas need a CTRL connection";
+			return CTRL_CMD_ERROR;
+		}
+		st.client = stats_dump_client_get(cmd->ccon);
+		if (!st.client)
+			goto oom;
+		llist_for_each_entry(grp, &st.client->groups, list)
+			grp->seen = false;
+	}
+
+	cmd->reply = talloc_strdup(cmd, "");
+	if (!cmd->reply)
+		goto oom;
+	if (rate_ctr_for_each_group(stats_dump_ctr_group, &st) < 0)
+		goto oom;
+	if (osmo_stat_item_for_each_group(stats_dump_statg, &st) < 0)
+		goto oom;
+	if (!cmd->reply)
+		goto oom;
+
+	/* forget about the groups freed since the previous read */
+	if (st.client) {
+		llist_for_each_entry_safe(grp, tmp, &st.client->groups, list) {
+			if (grp->seen)
+				continue;
+			llist_del(&grp->list);
+			talloc_free(grp);
+		}
+	}
+
+	lines = cmd->reply;
+	cmd->reply = talloc_asprintf(cmd, "%u\n%s", st.num, lines);
+	talloc_free(lines);
+	if (!cmd->reply)
+		goto oom;
+	return CTRL_CMD_REPLY;
+
+oom:
+	cmd->reply = "OOM";
+	return CTRL_CMD_ERROR;
+}
+
+CTRL_CMD_DEFINE_RO(stats_dump, "stats-dump");
+static int get_stats_dump(struct ctrl_cmd *cmd, void *data)
+{
+	return stats_dump(cmd, false);
+}
+
+CTRL_CMD_DEFINE_RO(stats_dump_delta, "stats-dump-delta");
+static int get_stats_dump_delta(struct ctrl_cmd *cmd, void *data)
+{
+	return stats_dump(cmd, true);
+}
+
 int bts_ctrl_cmds_install(struct gsm_bts *bts)
 {
 	int rc = 0;
 
 	rc |= ctrl_cmd_install(CTRL_NODE_TRX, &cmd_therm_att);
 	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_oml_alert);
+	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_stats_dump);
+	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_stats_dump_delta);
 	g_bts = bts;
 
 	return rc;
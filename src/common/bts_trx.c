@@ -26,6 +26,7 @@
 #include <osmo-bts/bts_trx.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/bts_model.h>
+#include <osmo-bts/l1sap.h>
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/phy_link.h>
 #include <osmo-bts/nm_common_fsm.h>
@@ -119,6 +120,8 @@ void gsm_bts_trx_init_shadow_ts(struct gsm_bts_trx *trx)
 
 		gsm_bts_trx_ts_init_lchan(ts);
 	}
+
+	gsm_bts_trx_update_lchan_map(trx);
 }
 
 void gsm_bts_trx_free_shadow_ts(struct gsm_bts_trx *trx)
@@ -140,6 +143,43 @@ void gsm_bts_trx_free_shadow_ts(struct gsm_bts_trx *trx)
 		talloc_free(shadow_ts);
 		trx->ts[tn].vamos.peer = NULL;
 	}
+
+	gsm_bts_trx_update_lchan_map(trx);
+}
+
+/* Resolve a chan_nr to the lchan on a primary or (VAMOS) shadow timeslot */
+static struct gsm_lchan *trx_lchan_by_chan_nr(struct gsm_bts_trx *trx, uint8_t chan_nr)
+{
+	struct gsm_bts_trx_ts *ts;
+	unsigned int tn, ss;
+
+	tn = L1SAP_CHAN2TS(chan_nr);
+	ts = &trx->ts[tn];
+
+	if (L1SAP_IS_CHAN_VAMOS(chan_nr)) {
+		if (ts->vamos.peer == NULL)
+			return NULL;
+		ts = ts->vamos.peer;
+	}
+
+	if (L1SAP_IS_CHAN_CBCH(chan_nr))
+		ss = 2; /* CBCH is always on sub-slot 2 */
+	else
+		ss = l1sap_chan2ss(chan_nr);
+	OSMO_ASSERT(ss < ARRAY_SIZE(ts->lchan));
+
+	return &ts->lchan[ss];
+}
+
+/*! (Re)build the chan_nr -> lchan lookup table of the given transceiver.
+ *  The mapping only depends on the chan_nr and on the presence of the
+ *  shadow timeslots, not on the (dynamic) pchan of a timeslot. */
+void gsm_bts_trx_update_lchan_map(struct gsm_bts_trx *trx)
+{
+	unsigned int chan_nr;
+
+	for (chan_nr = 0; chan_nr < ARRAY_SIZE(trx->lchan_by_chan_nr); chan_nr++)
+		trx->lchan_by_chan_nr[chan_nr] = trx_lchan_by_chan_nr(trx, chan_nr);
 }
 
 struct gsm_bts_trx *gsm_bts_trx_alloc(struct gsm_bts *bts)
@@ -167,6 +207,7 @@ struct gsm_bts_trx *gsm_bts_trx_alloc(struct gsm_bts *bts)
 	oml_mo_state_init(&trx->bb_transc.mo, NM_OPSTATE_DISABLED, NM_AVSTATE_NOT_INSTALLED);
 
 	gsm_bts_trx_init_ts(trx);
+	gsm_bts_trx_update_lchan_map(trx);
 
 	if (trx->nr != 0)
 		trx->nominal_power = bts->c0->nominal_power;
@@ -174,7 +215,7 @@ struct gsm_bts_trx *gsm_bts_trx_alloc(struct gsm_bts *bts)
 	/* Default values for the power adjustments */
 	trx->power_params.ramp.max_initial_pout_mdBm = to_mdB(0);
 	trx->power_params.ramp.step_size_mdB = to_mdB(2);
-	trx->power_params.ramp.step_interval_sec = 1;
+	trx->power_params.ramp.step_interval_ms = 1000;
 
 	/* Default (fall-back) Dynamic Power Control parameters */
 	trx->bs_dpc_params = &bts->bs_dpc_params;
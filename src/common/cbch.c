@@ -19,12 +19,14 @@
  */
 
 #include <errno.h>
+#include <string.h>
 
 #include <osmocom/core/utils.h>
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/gsm/protocol/gsm_04_12.h>
 
 #include <osmo-bts/bts.h>
+#include <osmo-bts/bts_model.h>
 #include <osmo-bts/cbch.h>
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/logging.h>
@@ -33,31 +35,47 @@
 struct smscb_msg {
 	struct llist_head list;		/* list in smscb_state.queue */
 
-	bool is_schedule;		/* is this a schedule message? */
-	uint8_t msg[GSM412_MSG_LEN];	/* message buffer */
+	/* Um blocks (Block Type + payload), built when the message is received */
+	uint8_t blocks[4][GSM_MACBLOCK_LEN];
 	uint8_t num_segs;		/* total number of segments */
+	/* the blocks encoded by bts_model_cbch_encode(), num_segs * SMSCB_BLOCK_BURSTS_LEN
+	 * bits when the message is accepted; NULL if the PHY encodes them */
+	ubit_t *bursts;
 };
 
+/* the NULL block, encoded on first use */
+static struct {
+	ubit_t bursts[SMSCB_BLOCK_BURSTS_LEN];
+	bool done;
+	bool valid;
+} null_block_enc;
+
 /* determine if current queue length differs more than permitted hysteresis from target
- * queue length. If it does, send CBCH LOAD IND */
-static void check_and_send_cbch_load(struct gsm_bts *bts, struct bts_smscb_state *bts_ss)
+ * queue length, and which CBCH LOAD IND is to be sent then.  This is done whenever the
+ * queue length changes, so that check_and_send_cbch_load() does not need to. */
+static void cbch_update_load(struct gsm_bts *bts, struct bts_smscb_state *bts_ss)
 {
 	int delta = bts_ss->queue_len - bts->smscb_queue_tgt_len;
+
+	bts_ss->load_ind.pending = abs(delta) >= bts->smscb_queue_hyst;
+	bts_ss->load_ind.overflow = delta >= 0;
+	bts_ss->load_ind.amount = OSMO_MIN(15, abs(delta));
+}
+
+/* send CBCH LOAD IND, if the queue length is outside of the hysteresis */
+static void check_and_send_cbch_load(struct gsm_bts *bts, struct bts_smscb_state *bts_ss)
+{
 	bool extended_cbch = false;
 
+	if (!bts_ss->load_ind.pending)
+		return;
+
 	if (bts_ss == &bts->smscb_extended)
 		extended_cbch = true;
 
-	if (abs(delta) < bts->smscb_queue_hyst)
-		return;
-
-	if (delta < 0) {
-		/* Underrun */
-		rsl_tx_cbch_load_indication(bts, extended_cbch, false, OSMO_MIN(15, -delta));
-	} else {
-		/* Overrun */
-		rsl_tx_cbch_load_indication(bts, extended_cbch, true, OSMO_MIN(15, delta));
-	}
+	/* Overrun or Underrun */
+	rsl_tx_cbch_load_indication(bts, extended_cbch, bts_ss->load_ind.overflow,
+				    bts_ss->load_ind.amount);
 }
 
 /* determine SMSCB state by tb number */
@@ -93,20 +111,50 @@ static int get_smscb_null_block(uint8_t *out)
 	return 0;
 }
 
+/* the encoded NULL block; NULL if the PHY encodes the blocks itself */
+static const ubit_t *smscb_null_block_bursts(struct gsm_bts *bts)
+{
+	if (!null_block_enc.done) {
+		uint8_t null_block[GSM_MACBLOCK_LEN];
+
+		get_smscb_null_block(null_block);
+		null_block_enc.valid = bts_model_cbch_encode(bts, null_block_enc.bursts, null_block) == 0;
+		null_block_enc.done = true;
+	}
+
+	return null_block_enc.valid ? null_block_enc.bursts : NULL;
+}
+
+/* remember the block handed out, for bts_cbch_get_bursts() */
+static void smscb_set_last(struct bts_smscb_state *bts_ss, const uint8_t *out, const ubit_t *bursts)
+{
+	memcpy(bts_ss->last.l2, out, GSM_MACBLOCK_LEN);
+	bts_ss->last.bursts_valid = bursts != NULL;
+	if (bursts)
+		memcpy(bts_ss->last.bursts, bursts, SMSCB_BLOCK_BURSTS_LEN);
+}
+
+static int put_smscb_null_block(struct gsm_bts *bts, struct bts_smscb_state *bts_ss, uint8_t *out)
+{
+	int rc = get_smscb_null_block(out);
+
+	smscb_set_last(bts_ss, out, smscb_null_block_bursts(bts));
+	return rc;
+}
+
 /* get the next block of the current CB message */
-static int get_smscb_block(struct bts_smscb_state *bts_ss, uint8_t *out, uint8_t tb,
-			   const struct gsm_time *g_time)
+static int get_smscb_block(struct gsm_bts *bts, struct bts_smscb_state *bts_ss, uint8_t *out,
+			   uint8_t tb, const struct gsm_time *g_time)
 {
-	int to_copy;
-	struct gsm412_block_type *block_type;
 	struct smscb_msg *msg = bts_ss->cur_msg;
 	uint8_t block_nr = tb % 4;
 	const char *chan_name = tb_to_chan_str(tb);
+	bool lb;
 
 	if (!msg) {
 		/* No message: Send NULL block */
 		DEBUGPGT(DLSMS, g_time, "%s: No cur_msg; requesting NULL block\n", chan_name);
-		return get_smscb_null_block(out);
+		return put_smscb_null_block(bts, bts_ss, out);
 	}
 	OSMO_ASSERT(block_nr < 4);
 
@@ -114,33 +162,15 @@ static int get_smscb_block(struct bts_smscb_state *bts_ss, uint8_t *out, uint8_t
 		/* Higher block number than this message has blocks: Send NULL block */
 		DEBUGPGT(DLSMS, g_time, "%s: cur_msg has only %u blocks; requesting NULL block\n",
 			 chan_name, msg->num_segs);
-		return get_smscb_null_block(out);
+		return put_smscb_null_block(bts, bts_ss, out);
 	}
 
-	block_type = (struct gsm412_block_type *) out++;
-
-	/* LPD is always 01 */
-	block_type->spare = 0;
-	block_type->lpd = 1;
-
-	/* determine how much data to copy */
-	to_copy = GSM412_MSG_LEN - (block_nr * GSM412_BLOCK_LEN);
-	if (to_copy > GSM412_BLOCK_LEN)
-	to_copy = GSM412_BLOCK_LEN;
-	OSMO_ASSERT(to_copy >= 0);
-
-	/* copy data and increment index */
-	memcpy(out, &msg->msg[block_nr * GSM412_BLOCK_LEN], to_copy);
-
-	/* set + increment sequence number */
-	if (block_nr == 0 && msg->is_schedule)
-		block_type->seq_nr = 8;	/* first schedule block */
-	else
-		block_type->seq_nr = block_nr;
+	memcpy(out, msg->blocks[block_nr], GSM_MACBLOCK_LEN);
+	smscb_set_last(bts_ss, out, msg->bursts ? &msg->bursts[block_nr * SMSCB_BLOCK_BURSTS_LEN] : NULL);
 
 	/* determine if this is the last block */
-	block_type->lb = (block_nr + 1 == msg->num_segs);
-	if (block_type->lb) {
+	lb = (block_nr + 1 == msg->num_segs);
+	if (lb) {
 		if (msg != bts_ss->default_msg) {
 			DEBUGPGT(DLSMS, g_time, "%s: deleting fully-transmitted message %p\n",
 				 chan_name, msg);
@@ -153,7 +183,58 @@ static int get_smscb_block(struct bts_smscb_state *bts_ss, uint8_t *out, uint8_t
 		}
 	}
 
-	return block_type->lb;
+	return lb;
+}
+
+/* build the Um blocks of a CB message of up to GSM412_MSG_LEN bytes */
+static void smscb_msg_build_blocks(struct smscb_msg *scm, const uint8_t *msg, uint8_t msg_len,
+				   bool is_schedule)
+{
+	uint8_t buf[GSM412_MSG_LEN];
+	uint8_t block_nr;
+
+	/* initialize entire message with default padding */
+	memset(buf, GSM_MACBLOCK_PADDING, sizeof(buf));
+	memcpy(buf, msg, msg_len);
+
+	for (block_nr = 0; block_nr < scm->num_segs; block_nr++) {
+		struct gsm412_block_type *block_type = (struct gsm412_block_type *) scm->blocks[block_nr];
+
+		/* LPD is always 01 */
+		block_type->spare = 0;
+		block_type->lpd = 1;
+
+		/* set sequence number */
+		if (block_nr == 0 && is_schedule)
+			block_type->seq_nr = 8;	/* first schedule block */
+		else
+			block_type->seq_nr = block_nr;
+
+		block_type->lb = (block_nr + 1 == scm->num_segs);
+
+		memcpy(&scm->blocks[block_nr][1], &buf[block_nr * GSM412_BLOCK_LEN], GSM412_BLOCK_LEN);
+	}
+}
+
+/* encode the Um blocks of a CB message once, instead of for each of its transmissions */
+static void smscb_msg_encode_blocks(struct gsm_bts *bts, struct smscb_msg *scm)
+{
+	uint8_t block_nr;
+
+	if (!smscb_null_block_bursts(bts))
+		return;
+
+	scm->bursts = talloc_array(scm, ubit_t, scm->num_segs * SMSCB_BLOCK_BURSTS_LEN);
+	if (!scm->bursts)
+		return;
+
+	for (block_nr = 0; block_nr < scm->num_segs; block_nr++) {
+		if (bts_model_cbch_encode(bts, &scm->bursts[block_nr * SMSCB_BLOCK_BURSTS_LEN],
+					  scm->blocks[block_nr]) < 0) {
+			TALLOC_FREE(scm->bursts);
+			return;
+		}
+	}
 }
 
 static const uint8_t last_block_rsl2um[4] = {
@@ -188,9 +269,9 @@ int bts_process_smscb_cmd(struct gsm_bts *bts, struct rsl_ie_cb_cmd_type cmd_typ
 		bts_ss = &bts->smscb_basic;
 	}
 
-	if (msg_len > sizeof(scm->msg)) {
-		LOGP(DLSMS, LOGL_ERROR, "%s: Cannot process SMSCB of %u bytes (max %zu)\n",
-		     chan_name, msg_len, sizeof(scm->msg));
+	if (msg_len > GSM412_MSG_LEN) {
+		LOGP(DLSMS, LOGL_ERROR, "%s: Cannot process SMSCB of %u bytes (max %d)\n",
+		     chan_name, msg_len, GSM412_MSG_LEN);
 		return -EINVAL;
 	}
 
@@ -198,14 +279,8 @@ int bts_process_smscb_cmd(struct gsm_bts *bts, struct rsl_ie_cb_cmd_type cmd_typ
 	if (!scm)
 		return -1;
 
-	/* initialize entire message with default padding */
-	memset(scm->msg, GSM_MACBLOCK_PADDING, sizeof(scm->msg));
-
-	if (cmd_type.command == RSL_CB_CMD_TYPE_SCHEDULE)
-		scm->is_schedule = true;
-
 	scm->num_segs = last_block_rsl2um[cmd_type.last_block&3];
-	memcpy(scm->msg, msg, msg_len);
+	smscb_msg_build_blocks(scm, msg, msg_len, cmd_type.command == RSL_CB_CMD_TYPE_SCHEDULE);
 
 	LOGP(DLSMS, LOGL_INFO, "RSL SMSCB COMMAND (chan=%s, type=%s, num_blocks=%u)\n",
 		chan_name, get_value_string(rsl_cb_cmd_names, cmd_type.command), scm->num_segs);
@@ -223,8 +298,10 @@ int bts_process_smscb_cmd(struct gsm_bts *bts, struct rsl_ie_cb_cmd_type cmd_typ
 			talloc_free(scm);
 			break;
 		}
+		smscb_msg_encode_blocks(bts, scm);
 		llist_add_tail(&scm->list, &bts_ss->queue);
 		bts_ss->queue_len++;
+		cbch_update_load(bts, bts_ss);
 		check_and_send_cbch_load(bts, bts_ss);
 		rate_ctr_inc2(bts_ss->ctrs, CBCH_CTR_RCVD_QUEUED);
 		break;
@@ -233,10 +310,11 @@ int bts_process_smscb_cmd(struct gsm_bts *bts, struct rsl_ie_cb_cmd_type cmd_typ
 		if (bts_ss->cur_msg && bts_ss->cur_msg == bts_ss->default_msg)
 			bts_ss->cur_msg = NULL;
 		talloc_free(bts_ss->default_msg);
-		if (cmd_type.def_bcast == RSL_CB_CMD_DEFBCAST_NORMAL)
+		if (cmd_type.def_bcast == RSL_CB_CMD_DEFBCAST_NORMAL) {
 			/* def_bcast == 0: normal message */
+			smscb_msg_encode_blocks(bts, scm);
 			bts_ss->default_msg = scm;
-		else {
+		} else {
 			/* def_bcast == 1: NULL message */
 			bts_ss->default_msg = NULL;
 			talloc_free(scm);
@@ -260,6 +338,7 @@ static struct smscb_msg *select_next_smscb(struct gsm_bts *bts, uint8_t tb)
 	if (msg) {
 		llist_del(&msg->list);
 		bts_ss->queue_len--;
+		cbch_update_load(bts, bts_ss);
 		check_and_send_cbch_load(bts, bts_ss);
 		DEBUGP(DLSMS, "%s: %s: Dequeued msg\n", __func__, chan_name);
 		rate_ctr_inc2(bts_ss->ctrs, CBCH_CTR_SENT_SINGLE);
@@ -308,18 +387,31 @@ int bts_cbch_get(struct gsm_bts *bts, uint8_t *outbuf, struct gsm_time *g_time)
 	case 4:
 		/* select a new SMSCB message */
 		bts_ss->cur_msg = select_next_smscb(bts, tb);
-		rc = get_smscb_block(bts_ss, outbuf, tb, g_time);
+		rc = get_smscb_block(bts, bts_ss, outbuf, tb, g_time);
 		break;
 	case 1: case 2: case 3:
 	case 5: case 6: case 7:
-		rc = get_smscb_block(bts_ss, outbuf, tb, g_time);
+		rc = get_smscb_block(bts, bts_ss, outbuf, tb, g_time);
 		break;
 	}
 
 	return rc;
 }
 
-static void bts_smscb_state_reset(struct bts_smscb_state *bts_ss)
+/* the bursts pre-encoded for the block bts_cbch_get() returned for the
+ * multiframe of fn, if l2 still is that block; NULL if the caller has to
+ * encode l2 itself */
+const ubit_t *bts_cbch_get_bursts(struct gsm_bts *bts, uint32_t fn, const uint8_t *l2)
+{
+	struct bts_smscb_state *bts_ss = bts_smscb_state(bts, (fn / 51) % 8);
+
+	if (!bts_ss->last.bursts_valid || memcmp(bts_ss->last.l2, l2, GSM_MACBLOCK_LEN))
+		return NULL;
+
+	return bts_ss->last.bursts;
+}
+
+static void bts_smscb_state_reset(struct gsm_bts *bts, struct bts_smscb_state *bts_ss)
 {
 	struct smscb_msg *scm, *tmp;
 	llist_for_each_entry_safe(scm, tmp, &bts_ss->queue, list) {
@@ -327,16 +419,24 @@ static void bts_smscb_state_reset(struct bts_smscb_state *bts_ss)
 		talloc_free(scm);
 	}
 	bts_ss->queue_len = 0;
+	cbch_update_load(bts, bts_ss);
 	rate_ctr_group_reset(bts_ss->ctrs);
 	/* avoid double-free of default_msg in case cur_msg == default_msg */
 	if (bts_ss->cur_msg && bts_ss->cur_msg != bts_ss->default_msg)
 		talloc_free(bts_ss->cur_msg);
 	bts_ss->cur_msg = NULL;
 	TALLOC_FREE(bts_ss->default_msg);
+	bts_ss->last.bursts_valid = false;
 }
 
 void bts_cbch_reset(struct gsm_bts *bts)
 {
-	bts_smscb_state_reset(&bts->smscb_basic);
-	bts_smscb_state_reset(&bts->smscb_extended);
+	bts_smscb_state_reset(bts, &bts->smscb_basic);
+	bts_smscb_state_reset(bts, &bts->smscb_extended);
+}
+
+void bts_cbch_update_load(struct gsm_bts *bts)
+{
+	cbch_update_load(bts, &bts->smscb_basic);
+	cbch_update_load(bts, &bts->smscb_extended);
 }
@@ -20,6 +20,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
 
 #include <osmocom/core/bits.h>
@@ -73,11 +74,123 @@ static const uint8_t e1e2e3_map[_LCHAN_CSD_M_NUM][3] = {
 #endif
 };
 
+/* The RTP payload is built from (and parsed into) packed V.110 80-bit frames,
+ * 10 octets each: octet 0 is the all-zero alignment pattern, octets 1..9 start
+ * with a '1' bit.  RA2 maps each of their bits onto the MSB(s) of the 64 kbit/s
+ * octets, via the lookup tables below (filled on startup). */
+
+/* RA2 for 16 kbit/s: 2 bits per octet, a V.110 octet makes 4 RTP octets */
+static uint8_t ra2_16k[256][4];
+/* RA2 for 8 kbit/s: 1 bit per octet, a V.110 octet makes 8 RTP octets */
+static uint8_t ra2_8k[256][8];
+/* The 7 bits following the '1' bit of a V.110 octet, unpacked */
+static ubit_t v110_oct_bits[128][7];
+/* V.110 octet 5 ('1', E1..E3) for the 4 blocks of each CSD mode */
+static uint8_t e_oct[_LCHAN_CSD_M_NUM][4];
+
+static __attribute__((constructor)) void csd_v110_tables_init(void)
+{
+	unsigned int v, n;
+
+	for (v = 0; v < 256; v++) {
+		for (n = 0; n < 4; n++)
+			ra2_16k[v][n] = (0xff >> 2) | (((v >> (6 - 2 * n)) & 0x03) << 6);
+		for (n = 0; n < 8; n++)
+			ra2_8k[v][n] = (0xff >> 1) | (((v >> (7 - n)) & 0x01) << 7);
+	}
+
+	for (v = 0; v < 128; v++) {
+		for (n = 0; n < 7; n++)
+			v110_oct_bits[v][n] = (v >> (6 - n)) & 0x01;
+	}
+
+	for (v = 0; v < _LCHAN_CSD_M_NUM; v++) {
+		for (n = 0; n < 4; n++) {
+			uint8_t e1, e2, e3;
+
+			if (v == LCHAN_CSD_M_NT) {
+				/* non-transparent: as per 3GPP TS 48.020, Table 7 */
+				e1 = 0; /* E1: as per 15.1.2, shall be set to 0 (for BSS-MSC) */
+				e2 = (n >> 1) & 0x01; /* E2: 0 for Q1/Q2, 1 for Q3/Q4 */
+				e3 = (n >> 0) & 0x01; /* E3: 0 for Q1/Q3, 1 for Q2/Q4 */
+			} else {
+				/* transparent: as per 3GPP TS 44.021, Figure 4 */
+				e1 = e1e2e3_map[v][0];
+				e2 = e1e2e3_map[v][1];
+				e3 = e1e2e3_map[v][2];
+			}
+			e_oct[v][n] = 0x80 | (e1 << 6) | (e2 << 5) | (e3 << 4);
+		}
+	}
+}
+
+/* RA1' for TCH/F9.6, TCH/F4.8 and TCH/H4.8: the 60-bit radio block is the
+ * V.110 80-bit frame without the alignment pattern, the '1' bits and E1..E3
+ * (3GPP TS 44.021, section 8.1.2), so it maps onto the octets directly. */
+static void v110_pack_60(uint8_t *oct, const ubit_t *in, uint8_t e_oct5)
+{
+	oct[0] = 0x00;
+	for (unsigned int k = 1; k < 10; k++) {
+		if (k == 5) {
+			/* E4..E7 */
+			oct[k] = e_oct5 | (in[0] << 3) | (in[1] << 2) | (in[2] << 1) | in[3];
+			in += 4;
+			continue;
+		}
+		oct[k] = 0x80 | (in[0] << 6) | (in[1] << 5) | (in[2] << 4)
+			      | (in[3] << 3) | (in[4] << 2) | (in[5] << 1) | in[6];
+		in += 7;
+	}
+}
+
+static void v110_unpack_60(ubit_t *out, const uint8_t *oct)
+{
+	for (unsigned int k = 1; k < 10; k++) {
+		if (k == 5) {
+			/* E4..E7 */
+			memcpy(out, &v110_oct_bits[oct[k] & 0x7f][3], 4);
+			out += 4;
+			continue;
+		}
+		memcpy(out, &v110_oct_bits[oct[k] & 0x7f][0], 7);
+		out += 7;
+	}
+}
+
+/* RA1' for TCH/F2.4 and TCH/H2.4 (36-bit radio blocks), via libosmocore */
+static void v110_pack_36(uint8_t *oct, const ubit_t *in, const struct gsm_lchan *lchan,
+			 unsigned int i)
+{
+	struct osmo_v110_decoded_frame df;
+	ubit_t ra_bits[80];
+
+	osmo_csd_3k6_decode_frame(&df, in, 36);
+
+	/* E1 .. E3 must set by out-of-band knowledge */
+	df.e_bits[0] = (e_oct[lchan->csd_mode][i] >> 6) & 0x01; /* E1 */
+	df.e_bits[1] = (e_oct[lchan->csd_mode][i] >> 5) & 0x01; /* E2 */
+	df.e_bits[2] = (e_oct[lchan->csd_mode][i] >> 4) & 0x01; /* E3 */
+
+	osmo_v110_encode_frame(&ra_bits[0], 80, &df);
+	osmo_ubit2pbit(oct, &ra_bits[0], 80);
+}
+
+static void v110_unpack_36(ubit_t *out, const uint8_t *oct)
+{
+	struct osmo_v110_decoded_frame df;
+	ubit_t ra_bits[80];
+
+	osmo_pbit2ubit(&ra_bits[0], oct, 80);
+	osmo_v110_decode_frame(&df, &ra_bits[0], 80);
+	osmo_csd_3k6_encode_frame(out, 36, &df);
+}
+
 int csd_v110_rtp_encode(const struct gsm_lchan *lchan, uint8_t *rtp,
 			const uint8_t *data, size_t data_len)
 {
 	const struct csd_v110_frame_desc *desc;
-	ubit_t ra_bits[80 * 4];
+	uint8_t oct[4][10];
+	const uint8_t *o = &oct[0][0];
 
 	OSMO_ASSERT(lchan->tch_mode < ARRAY_SIZE(csd_v110_lchan_desc));
 	if (lchan->type == GSM_LCHAN_TCH_F)
@@ -90,53 +203,31 @@ int csd_v110_rtp_encode(const struct gsm_lchan *lchan, uint8_t *rtp,
 	/* handle empty/incomplete Uplink frames gracefully */
 	if (OSMO_UNLIKELY(data_len < (desc->num_blocks * desc->num_bits))) {
 		/* encode N idle frames as per 3GPP TS 44.021, section 8.1.6 */
-		memset(&ra_bits[0], 0x01, sizeof(ra_bits));
+		memset(&oct[0][0], 0xff, sizeof(oct));
 		for (unsigned int i = 0; i < desc->num_blocks; i++)
-			memset(&ra_bits[i * 80], 0x00, 8); /* alignment pattern */
-		goto ra1_ra2;
+			oct[i][0] = 0x00; /* alignment pattern */
+		goto ra2;
 	}
 
 	/* RA1'/RA1: convert from radio rate to an intermediate data rate */
+	OSMO_ASSERT(lchan->csd_mode < _LCHAN_CSD_M_NUM);
 	for (unsigned int i = 0; i < desc->num_blocks; i++) {
-		struct osmo_v110_decoded_frame df;
-
-		/* convert a V.110 36-/60-bit frame to a V.110 80-bit frame */
 		if (desc->num_bits == 60)
-			osmo_csd_12k_6k_decode_frame(&df, &data[i * 60], 60);
+			v110_pack_60(&oct[i][0], &data[i * 60], e_oct[lchan->csd_mode][i]);
 		else /* desc->num_bits == 36 */
-			osmo_csd_3k6_decode_frame(&df, &data[i * 36], 36);
-
-		/* E1 .. E3 must set by out-of-band knowledge */
-		if (lchan->csd_mode == LCHAN_CSD_M_NT) {
-			/* non-transparent: as per 3GPP TS 48.020, Table 7 */
-			df.e_bits[0] = 0; /* E1: as per 15.1.2, shall be set to 0 (for BSS-MSC) */
-			df.e_bits[1] = (i >> 1) & 0x01; /* E2: 0 for Q1/Q2, 1 for Q3/Q4 */
-			df.e_bits[2] = (i >> 0) & 0x01; /* E3: 0 for Q1/Q3, 1 for Q2/Q4 */
-		} else {
-			/* transparent: as per 3GPP TS 44.021, Figure 4 */
-			df.e_bits[0] = e1e2e3_map[lchan->csd_mode][0]; /* E1 */
-			df.e_bits[1] = e1e2e3_map[lchan->csd_mode][1]; /* E2 */
-			df.e_bits[2] = e1e2e3_map[lchan->csd_mode][2]; /* E3 */
-		}
-
-		osmo_v110_encode_frame(&ra_bits[i * 80], 80, &df);
+			v110_pack_36(&oct[i][0], &data[i * 36], lchan, i);
 	}
 
-ra1_ra2:
-	/* RA1/RA2: convert from an intermediate rate to 64 kbit/s */
+ra2:
+	/* RA2: convert from an intermediate rate to 64 kbit/s */
 	if (desc->num_blocks == 4) {
 		/* 4 * 80 bits (16 kbit/s) => 2 bits per octet */
-		for (unsigned int i = 0, j = 0; i < RFC4040_RTP_PLEN; i++) {
-			rtp[i]  = (0xff >> 2);
-			rtp[i] |= (ra_bits[j++] << 7);
-			rtp[i] |= (ra_bits[j++] << 6);
-		}
+		for (unsigned int i = 0; i < 4 * 10; i++)
+			memcpy(&rtp[i * 4], &ra2_16k[o[i]][0], 4);
 	} else {
 		/* 2 * 80 bits (8 kbit/s) => 1 bit per octet */
-		for (unsigned int i = 0; i < RFC4040_RTP_PLEN; i++) {
-			rtp[i]  = (0xff >> 1);
-			rtp[i] |= (ra_bits[i] << 7);
-		}
+		for (unsigned int i = 0; i < 2 * 10; i++)
+			memcpy(&rtp[i * 8], &ra2_8k[o[i]][0], 8);
 	}
 
 	return RFC4040_RTP_PLEN;
@@ -146,7 +237,8 @@ int csd_v110_rtp_decode(const struct gsm_lchan *lchan, uint8_t *data,
 			const uint8_t *rtp, size_t rtp_len)
 {
 	const struct csd_v110_frame_desc *desc;
-	ubit_t ra_bits[80 * 4];
+	uint8_t oct[4][10];
+	uint8_t *o = &oct[0][0];
 
 	OSMO_ASSERT(lchan->tch_mode < ARRAY_SIZE(csd_v110_lchan_desc));
 	if (lchan->type == GSM_LCHAN_TCH_F)
@@ -159,29 +251,29 @@ int csd_v110_rtp_decode(const struct gsm_lchan *lchan, uint8_t *data,
 	if (OSMO_UNLIKELY(rtp_len != RFC4040_RTP_PLEN))
 		return -EINVAL;
 
-	/* RA1/RA2: convert from 64 kbit/s to an intermediate rate */
+	/* RA2: convert from 64 kbit/s to an intermediate rate */
 	if (desc->num_blocks == 4) {
 		/* 4 * 80 bits (16 kbit/s) => 2 bits per octet */
-		for (unsigned int i = 0, j = 0; i < RFC4040_RTP_PLEN; i++) {
-			ra_bits[j++] = (rtp[i] >> 7);
-			ra_bits[j++] = (rtp[i] >> 6) & 0x01;
+		for (unsigned int i = 0; i < 4 * 10; i++, rtp += 4) {
+			o[i] = (rtp[0] & 0xc0) | ((rtp[1] & 0xc0) >> 2)
+			     | ((rtp[2] & 0xc0) >> 4) | ((rtp[3] & 0xc0) >> 6);
 		}
 	} else {
 		/* 2 * 80 bits (8 kbit/s) => 1 bit per octet */
-		for (unsigned int i = 0; i < RFC4040_RTP_PLEN; i++)
-			ra_bits[i] = (rtp[i] >> 7);
+		for (unsigned int i = 0; i < 2 * 10; i++, rtp += 8) {
+			o[i] = (rtp[0] & 0x80) | ((rtp[1] & 0x80) >> 1)
+			     | ((rtp[2] & 0x80) >> 2) | ((rtp[3] & 0x80) >> 3)
+			     | ((rtp[4] & 0x80) >> 4) | ((rtp[5] & 0x80) >> 5)
+			     | ((rtp[6] & 0x80) >> 6) | ((rtp[7] & 0x80) >> 7);
+		}
 	}
 
 	/* RA1'/RA1: convert from an intermediate rate to radio rate */
 	for (unsigned int i = 0; i < desc->num_blocks; i++) {
-		struct osmo_v110_decoded_frame df;
-
-		/* convert a V.110 80-bit frame to a V.110 36-/60-bit frame */
-		osmo_v110_decode_frame(&df, &ra_bits[i * 80], 80);
 		if (desc->num_bits == 60)
-			osmo_csd_12k_6k_encode_frame(&data[i * 60], 60, &df);
+			v110_unpack_60(&data[i * 60], &oct[i][0]);
 		else /* desc->num_bits == 36 */
-			osmo_csd_3k6_encode_frame(&data[i * 36], 36, &df);
+			v110_unpack_36(&data[i * 36], &oct[i][0]);
 	}
 
 	return desc->num_blocks * desc->num_bits;
@@ -20,312 +20,15 @@
  */
 
 #include <osmo-bts/dtx_dl_amr_fsm.h>
+#include <osmo-bts/lchan.h>
 #include <osmo-bts/logging.h>
 
-void dtx_fsm_voice(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_VOICE:
-	case E_FACCH:
-		break;
-	case E_SID_F:
-		osmo_fsm_inst_state_chg(fi, ST_SID_F1, 0, 0);
-		break;
-	case E_SID_U:
-		osmo_fsm_inst_state_chg(fi, ST_U_NOINH, 0, 0);
-		break;
-	case E_INHIB:
-		osmo_fsm_inst_state_chg(fi, ST_F1_INH_V, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Inexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_sid_f1(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_SID_F:
-/* FIXME: what shall we do if we get SID-FIRST _again_ (twice in a row)?
-   Was observed during testing, let's just ignore it for now */
-		break;
-	case E_SID_U:
-		osmo_fsm_inst_state_chg(fi, ST_U_NOINH, 0, 0);
-		break;
-	case E_FACCH:
-		osmo_fsm_inst_state_chg(fi, ST_F1_INH_F, 0, 0);
-		break;
-	case E_FIRST:
-		osmo_fsm_inst_state_chg(fi, ST_SID_F2, 0, 0);
-		break;
-	case E_ONSET:
-		osmo_fsm_inst_state_chg(fi, ST_ONSET_V, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_sid_f2(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_U_NOINH, 0, 0);
-		break;
-	case E_FACCH:
-		osmo_fsm_inst_state_chg(fi, ST_ONSET_F, 0, 0);
-		break;
-	case E_ONSET:
-		osmo_fsm_inst_state_chg(fi, ST_ONSET_V, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_f1_inh_v(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_F1_INH_V_REC, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_f1_inh_f(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_F1_INH_F_REC, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_u_inh_v(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_U_INH_V_REC, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_u_inh_f(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_U_INH_F_REC, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_f1_inh_v_rec(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_VOICE:
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_VOICE, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_f1_inh_f_rec(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_FACCH:
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_FACCH, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_u_inh_v_rec(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_VOICE:
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_VOICE, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_u_inh_f_rec(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_FACCH:
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_FACCH, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_u_noinh(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_FACCH:
-		osmo_fsm_inst_state_chg(fi, ST_ONSET_F, 0, 0);
-		break;
-	case E_VOICE:
-		osmo_fsm_inst_state_chg(fi, ST_VOICE, 0, 0);
-		break;
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_SID_U, 0, 0);
-		break;
-	case E_SID_U:
-	case E_SID_F:
-/* FIXME: what shall we do if we get SID-FIRST _after_ sending SID-UPDATE?
-   Was observed during testing, let's just ignore it for now */
-		break;
-	case E_ONSET:
-		osmo_fsm_inst_state_chg(fi, ST_ONSET_V, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_sid_upd(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_FACCH:
-		osmo_fsm_inst_state_chg(fi, ST_U_INH_F, 0, 0);
-		break;
-	case E_VOICE:
-		osmo_fsm_inst_state_chg(fi, ST_VOICE, 0, 0);
-		break;
-	case E_INHIB:
-		osmo_fsm_inst_state_chg(fi, ST_U_INH_V, 0, 0);
-		break;
-	case E_SID_U:
-	case E_SID_F:
-		osmo_fsm_inst_state_chg(fi, ST_U_NOINH, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_onset_v(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_ONSET_V_REC, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_onset_f(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_ONSET_F_REC, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_onset_v_rec(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_VOICE, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_onset_f_rec(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_FACCH, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
-void dtx_fsm_facch(struct osmo_fsm_inst *fi, uint32_t event, void *data)
-{
-	switch (event) {
-	case E_SID_U:
-	case E_SID_F:
-	case E_FACCH:
-		break;
-	case E_VOICE:
-		osmo_fsm_inst_state_chg(fi, ST_VOICE, 0, 0);
-		break;
-	case E_COMPL:
-		osmo_fsm_inst_state_chg(fi, ST_SID_F1, 0, 0);
-		break;
-	default:
-		LOGP(DL1P, LOGL_ERROR, "Unexpected event %d\n", event);
-		OSMO_ASSERT(0);
-		break;
-	}
-}
-
 static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 	/* default state for non-DTX and DTX when SPEECH is in progress */
 	[ST_VOICE] = {
 		.in_event_mask = X(E_SID_F) | X(E_SID_U) | X(E_VOICE) | X(E_FACCH) | X(E_INHIB),
 		.out_state_mask = X(ST_SID_F1) | X(ST_U_NOINH) | X(ST_F1_INH_V),
 		.name = "Voice",
-		.action = dtx_fsm_voice,
 	},
 	/* SID-FIRST or SID-FIRST-P1 in case of AMR HR:
 	   start of silence period (might be interrupted in case of AMR HR) */
@@ -333,7 +36,6 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_SID_F) | X(E_SID_U) | X(E_FACCH) | X(E_FIRST) | X(E_ONSET),
 		.out_state_mask = X(ST_U_NOINH) | X(ST_ONSET_F) | X(ST_SID_F2) | X(ST_ONSET_V),
 		.name = "SID-FIRST (P1)",
-		.action = dtx_fsm_sid_f1,
 	},
 	/* SID-FIRST P2 (only for AMR HR):
 	   actual start of silence period in case of AMR HR */
@@ -341,42 +43,36 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_COMPL) | X(E_FACCH) | X(E_ONSET),
 		.out_state_mask = X(ST_U_NOINH) | X(ST_ONSET_F) | X(ST_ONSET_V),
 		.name = "SID-FIRST (P2)",
-		.action = dtx_fsm_sid_f2,
 	},
 	/* SID-FIRST Inhibited: incoming SPEECH (only for AMR HR) */
 	[ST_F1_INH_V]= {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_F1_INH_V_REC),
 		.name = "SID-FIRST (Inh, SPEECH)",
-		.action = dtx_fsm_f1_inh_v,
 	},
 	/* SID-FIRST Inhibited: incoming FACCH frame (only for AMR HR) */
 	[ST_F1_INH_F]= {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_F1_INH_F_REC),
 		.name = "SID-FIRST (Inh, FACCH)",
-		.action = dtx_fsm_f1_inh_f,
 	},
 	/* SID-UPDATE Inhibited: incoming SPEECH (only for AMR HR) */
 	[ST_U_INH_V]= {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_U_INH_V_REC),
 		.name = "SID-UPDATE (Inh, SPEECH)",
-		.action = dtx_fsm_u_inh_v,
 	},
 	/* SID-UPDATE Inhibited: incoming FACCH frame (only for AMR HR) */
 	[ST_U_INH_F]= {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_U_INH_F_REC),
 		.name = "SID-UPDATE (Inh, FACCH)",
-		.action = dtx_fsm_u_inh_f,
 	},
 	/* SID-UPDATE: Inhibited not allowed (only for AMR HR) */
 	[ST_U_NOINH]= {
 		.in_event_mask = X(E_FACCH) | X(E_VOICE) | X(E_COMPL) | X(E_SID_U) | X(E_SID_F) | X(E_ONSET),
 		.out_state_mask = X(ST_ONSET_F) | X(ST_VOICE) | X(ST_SID_U) | X(ST_ONSET_V),
 		.name = "SID-UPDATE (NoInh)",
-		.action = dtx_fsm_u_noinh,
 	},
 	/* SID-FIRST Inhibition recursion in progress:
 	   Inhibit itself was already sent, now have to send the voice that caused it */
@@ -384,7 +80,6 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_COMPL) | X(E_VOICE),
 		.out_state_mask = X(ST_VOICE),
 		.name = "SID-FIRST (Inh, SPEECH, Rec)",
-		.action = dtx_fsm_f1_inh_v_rec,
 	},
 	/* SID-FIRST Inhibition recursion in progress:
 	   Inhibit itself was already sent, now have to send the data that caused it */
@@ -392,7 +87,6 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_COMPL) | X(E_FACCH),
 		.out_state_mask = X(ST_FACCH),
 		.name = "SID-FIRST (Inh, FACCH, Rec)",
-		.action = dtx_fsm_f1_inh_f_rec,
 	},
 	/* SID-UPDATE Inhibition recursion in progress:
 	   Inhibit itself was already sent, now have to send the voice that caused it */
@@ -400,7 +94,6 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_COMPL) | X(E_VOICE),
 		.out_state_mask = X(ST_VOICE),
 		.name = "SID-UPDATE (Inh, SPEECH, Rec)",
-		.action = dtx_fsm_u_inh_v_rec,
 	},
 	/* SID-UPDATE Inhibition recursion in progress:
 	   Inhibit itself was already sent, now have to send the data that caused it */
@@ -408,28 +101,24 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_COMPL) | X(E_FACCH),
 		.out_state_mask = X(ST_FACCH),
 		.name = "SID-UPDATE (Inh, FACCH, Rec)",
-		.action = dtx_fsm_u_inh_f_rec,
 	},
 	/* Silence period with periodic comfort noise data updates */
 	[ST_SID_U]= {
 		.in_event_mask = X(E_FACCH) | X(E_VOICE) | X(E_INHIB) | X(E_SID_U) | X(E_SID_F),
 		.out_state_mask = X(ST_ONSET_F) | X(ST_VOICE) | X(ST_U_INH_V) | X(ST_U_INH_F) | X(ST_U_NOINH),
 		.name = "SID-UPDATE (AMR/HR)",
-		.action = dtx_fsm_sid_upd,
 	},
 	/* ONSET - end of silent period due to incoming SPEECH frame */
 	[ST_ONSET_V]= {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_ONSET_V_REC),
 		.name = "ONSET (SPEECH)",
-		.action = dtx_fsm_onset_v,
 	},
 	/* ONSET - end of silent period due to incoming FACCH frame */
 	[ST_ONSET_F]= {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_ONSET_F_REC),
 		.name = "ONSET (FACCH)",
-		.action = dtx_fsm_onset_f,
 	},
 	/* ONSET recursion in progress:
 	   ONSET itself was already sent, now have to send the voice that caused it */
@@ -437,7 +126,6 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_VOICE),
 		.name = "ONSET (SPEECH, Rec)",
-		.action = dtx_fsm_onset_v_rec,
 	},
 	/* ONSET recursion in progress:
 	   ONSET itself was already sent, now have to send the data that caused it */
@@ -445,14 +133,12 @@ static struct osmo_fsm_state dtx_dl_amr_fsm_states[] = {
 		.in_event_mask = X(E_COMPL),
 		.out_state_mask = X(ST_FACCH),
 		.name = "ONSET (FACCH, Rec)",
-		.action = dtx_fsm_onset_f_rec,
 	},
 	/* FACCH sending state */
 	[ST_FACCH]= {
 		.in_event_mask = X(E_FACCH) | X(E_VOICE) | X(E_COMPL) | X(E_SID_U) | X(E_SID_F),
 		.out_state_mask = X(ST_VOICE) | X(ST_SID_F1),
 		.name = "FACCH",
-		.action = dtx_fsm_facch,
 	},
 };
 
@@ -468,6 +154,129 @@ const struct value_string dtx_dl_amr_fsm_event_names[] = {
 	{ 0, 		NULL }
 };
 
+/* Entries of the transition table: the next state plus one, so that the
+ * events not expected in a state (zero-initialized entries) stand out */
+#define T(st) ((st) + 1)
+
+static const uint8_t dtx_dl_amr_trans_tbl[_NUM_DTX_DL_AMR_STATES][_NUM_DTX_DL_AMR_EVENTS] = {
+	[ST_VOICE] = {
+		[E_VOICE]	= T(ST_VOICE),
+		[E_FACCH]	= T(ST_VOICE),
+		[E_SID_F]	= T(ST_SID_F1),
+		[E_SID_U]	= T(ST_U_NOINH),
+		[E_INHIB]	= T(ST_F1_INH_V),
+	},
+	[ST_SID_F1] = {
+		/* FIXME: what shall we do if we get SID-FIRST _again_ (twice in a row)?
+		   Was observed during testing, let's just ignore it for now */
+		[E_SID_F]	= T(ST_SID_F1),
+		[E_SID_U]	= T(ST_U_NOINH),
+		/* FIXME: ST_F1_INH_F was intended here, but has never been
+		   a permitted transition of the FSM, so the state is kept */
+		[E_FACCH]	= T(ST_SID_F1),
+		[E_FIRST]	= T(ST_SID_F2),
+		[E_ONSET]	= T(ST_ONSET_V),
+	},
+	[ST_SID_F2] = {
+		[E_COMPL]	= T(ST_U_NOINH),
+		[E_FACCH]	= T(ST_ONSET_F),
+		[E_ONSET]	= T(ST_ONSET_V),
+	},
+	[ST_F1_INH_V] = {
+		[E_COMPL]	= T(ST_F1_INH_V_REC),
+	},
+	[ST_F1_INH_F] = {
+		[E_COMPL]	= T(ST_F1_INH_F_REC),
+	},
+	[ST_U_INH_V] = {
+		[E_COMPL]	= T(ST_U_INH_V_REC),
+	},
+	[ST_U_INH_F] = {
+		[E_COMPL]	= T(ST_U_INH_F_REC),
+	},
+	[ST_U_NOINH] = {
+		[E_FACCH]	= T(ST_ONSET_F),
+		[E_VOICE]	= T(ST_VOICE),
+		[E_COMPL]	= T(ST_SID_U),
+		/* FIXME: what shall we do if we get SID-FIRST _after_ sending SID-UPDATE?
+		   Was observed during testing, let's just ignore it for now */
+		[E_SID_U]	= T(ST_U_NOINH),
+		[E_SID_F]	= T(ST_U_NOINH),
+		[E_ONSET]	= T(ST_ONSET_V),
+	},
+	[ST_F1_INH_V_REC] = {
+		[E_VOICE]	= T(ST_VOICE),
+		[E_COMPL]	= T(ST_VOICE),
+	},
+	[ST_F1_INH_F_REC] = {
+		[E_FACCH]	= T(ST_FACCH),
+		[E_COMPL]	= T(ST_FACCH),
+	},
+	[ST_U_INH_V_REC] = {
+		[E_VOICE]	= T(ST_VOICE),
+		[E_COMPL]	= T(ST_VOICE),
+	},
+	[ST_U_INH_F_REC] = {
+		[E_FACCH]	= T(ST_FACCH),
+		[E_COMPL]	= T(ST_FACCH),
+	},
+	[ST_SID_U] = {
+		[E_FACCH]	= T(ST_U_INH_F),
+		[E_VOICE]	= T(ST_VOICE),
+		[E_INHIB]	= T(ST_U_INH_V),
+		[E_SID_U]	= T(ST_U_NOINH),
+		[E_SID_F]	= T(ST_U_NOINH),
+	},
+	[ST_ONSET_V] = {
+		[E_COMPL]	= T(ST_ONSET_V_REC),
+	},
+	[ST_ONSET_F] = {
+		[E_COMPL]	= T(ST_ONSET_F_REC),
+	},
+	[ST_ONSET_V_REC] = {
+		[E_COMPL]	= T(ST_VOICE),
+	},
+	[ST_ONSET_F_REC] = {
+		[E_COMPL]	= T(ST_FACCH),
+	},
+	[ST_FACCH] = {
+		[E_SID_U]	= T(ST_FACCH),
+		[E_SID_F]	= T(ST_FACCH),
+		[E_FACCH]	= T(ST_FACCH),
+		[E_VOICE]	= T(ST_VOICE),
+		[E_COMPL]	= T(ST_SID_F1),
+	},
+};
+
+/*! Feed an event into the DTX DL AMR state machine of \a lchan.  This is a
+ *  plain table lookup; the osmo_fsm instance (if allocated) only mirrors the
+ *  state transitions for logging.
+ *  \returns 0 on success; -1 if the event is not expected in the current state. */
+int dtx_dl_amr_trans(struct gsm_lchan *lchan, enum dtx_dl_amr_fsm_events e)
+{
+	uint8_t state = lchan->tch.dtx.dl_amr_state;
+	uint8_t next = dtx_dl_amr_trans_tbl[state][e];
+	struct osmo_fsm_inst *fi = lchan->tch.dtx.dl_amr_fsm;
+
+	if (OSMO_UNLIKELY(next == 0)) {
+		LOGPLCHAN(lchan, DL1C, LOGL_ERROR, "DTX DL AMR: event %s not permitted in state %s\n",
+			  get_value_string(dtx_dl_amr_fsm_event_names, e),
+			  dtx_dl_amr_fsm_states[state].name);
+		return -1;
+	}
+	next--;
+
+	if (fi) {
+		LOGPFSML(fi, LOGL_DEBUG, "Received Event %s\n",
+			 get_value_string(dtx_dl_amr_fsm_event_names, e));
+		if (next != state)
+			osmo_fsm_inst_state_chg(fi, next, 0, 0);
+	}
+
+	lchan->tch.dtx.dl_amr_state = next;
+	return 0;
+}
+
 struct osmo_fsm dtx_dl_amr_fsm = {
 	.name = "DTX_DL_AMR_FSM",
 	.states = dtx_dl_amr_fsm_states,
@@ -331,12 +331,7 @@ void gsm_ts_apply_configured_tsc(struct gsm_bts_trx_ts *ts)
 
 void gsm_ts_release(struct gsm_bts_trx_ts *ts)
 {
-	unsigned int ln;
-
-	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
-		struct gsm_lchan *lchan = &ts->lchan[ln];
-		gsm_lchan_release(lchan, LCHAN_REL_ACT_OML);
-	}
+	gsm_ts_release_lchans(ts, UINT32_MAX, LCHAN_REL_ACT_OML);
 	ts->pchan = GSM_PCHAN_NONE;
 	/* Make sure pchan_is is reset, since PCU act_req to release it will be
 	 * ignored as the lchan will already be released. */
@@ -0,0 +1,203 @@
+/* Asynchronous GSMTAP Um output from a background thread */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * to_gsmtap() runs on the main thread, right in the L1SAP path.  Instead
+ * of sending each message there, it only copies the GSMTAP header and the
+ * payload into a single-producer / single-consumer ring.  The writer
+ * thread drains the ring periodically and sends up to GW_BATCH messages
+ * per sendmmsg() call, so that no syscall is made on the main thread.
+ * If the ring is full, messages are dropped (see BTS_CTR_GSMTAP_DROP).
+ */
+
+#define _GNU_SOURCE /* sendmmsg(), pthread_setname_np() */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsmtap_writer.h>
+
+#define GW_RING_LEN	1024		/* must be a power of 2 */
+#define GW_DATA_MAX	256		/* max. payload length (EGPRS MCS-9 is 155) */
+#define GW_BATCH	32		/* max. messages per sendmmsg() */
+#define GW_PERIOD_NS	(10 * 1000 * 1000) /* drain the ring every 10 ms */
+
+struct gw_slot {
+	uint16_t len;
+	uint8_t buf[sizeof(struct gsmtap_hdr) + GW_DATA_MAX];
+};
+
+struct gsmtap_writer {
+	int fd;
+	pthread_t thread;
+
+	/* head and tail on separate cache lines, to avoid false sharing */
+	uint8_t pad0[64];
+	unsigned int head;	/* written by the main thread only */
+	uint8_t pad1[64];
+	unsigned int tail;	/* written by the writer thread only */
+	uint8_t pad2[64];
+
+	struct gw_slot ring[GW_RING_LEN];
+};
+
+static void gw_drain(struct gsmtap_writer *gw)
+{
+	struct mmsghdr msgs[GW_BATCH];
+	struct iovec iov[GW_BATCH];
+	unsigned int head, tail, n, i;
+	int rc;
+
+	tail = gw->tail;
+	head = __atomic_load_n(&gw->head, __ATOMIC_ACQUIRE);
+
+	while (head != tail) {
+		n = OSMO_MIN(head - tail, GW_BATCH);
+		for (i = 0; i < n; i++) {
+			struct gw_slot *slot = &gw->ring[(tail + i) & (GW_RING_LEN - 1)];
+
+			iov[i] = (struct iovec) {
+				.iov_base = slot->buf,
+				.iov_len = slot->len,
+			};
+			msgs[i] = (struct mmsghdr) {
+				.msg_hdr = {
+					.msg_iov = &iov[i],
+					.msg_iovlen = 1,
+				},
+			};
+		}
+
+		/* On error (e.g. ICMP port unreachable) the batch is dropped */
+		rc = sendmmsg(gw->fd, msgs, n, 0);
+		if (rc > 0)
+			n = rc;
+
+		tail += n;
+		__atomic_store_n(&gw->tail, tail, __ATOMIC_RELEASE);
+	}
+}
+
+static void *gw_thread(void *arg)
+{
+	struct gsmtap_writer *gw = arg;
+	const struct timespec period = {
+		.tv_sec = 0,
+		.tv_nsec = GW_PERIOD_NS,
+	};
+
+	while (true) {
+		gw_drain(gw);
+		nanosleep(&period, NULL);
+	}
+
+	return NULL;
+}
+
+/*! Start the GSMTAP writer thread.
+ *  \param[in] ctx talloc context to allocate from.
+ *  \param[in] local_host local address to bind to (may be NULL).
+ *  \param[in] remote_host address of the GSMTAP receiver.
+ *  \param[in] remote_port UDP port of the GSMTAP receiver.
+ *  \returns writer state on success; NULL on error. */
+struct gsmtap_writer *gsmtap_writer_start(void *ctx, const char *local_host,
+					  const char *remote_host, uint16_t remote_port)
+{
+	struct gsmtap_writer *gw;
+	int rc;
+
+	gw = talloc_zero(ctx, struct gsmtap_writer);
+	if (gw == NULL)
+		return NULL;
+
+	gw->fd = osmo_sock_init2(AF_UNSPEC, SOCK_DGRAM, IPPROTO_UDP,
+				 local_host, 0, remote_host, remote_port,
+				 OSMO_SOCK_F_BIND | OSMO_SOCK_F_CONNECT);
+	if (gw->fd < 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Failed to create the GSMTAP writer socket\n");
+		talloc_free(gw);
+		return NULL;
+	}
+
+	rc = pthread_create(&gw->thread, NULL, gw_thread, gw);
+	if (rc != 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Failed to start the GSMTAP writer thread: %s\n",
+		     strerror(rc));
+		close(gw->fd);
+		talloc_free(gw);
+		return NULL;
+	}
+	pthread_setname_np(gw->thread, "gsmtap-writer");
+
+	return gw;
+}
+
+/*! Queue a GSMTAP Um message for sending by the writer thread.
+ *  The parameters are the same as for gsmtap_send().
+ *  \returns 0 on success; negative on error (ring full, too long). */
+int gsmtap_writer_enqueue(struct gsmtap_writer *gw, uint16_t arfcn, uint8_t ts,
+			  uint8_t chan_type, uint8_t ss, uint32_t fn,
+			  int8_t signal_dbm, int8_t snr, const uint8_t *data,
+			  unsigned int len)
+{
+	unsigned int head = gw->head;
+	struct gsmtap_hdr *gh;
+	struct gw_slot *slot;
+
+	if (OSMO_UNLIKELY(len > GW_DATA_MAX))
+		return -EMSGSIZE;
+	if (OSMO_UNLIKELY(head - __atomic_load_n(&gw->tail, __ATOMIC_ACQUIRE) >= GW_RING_LEN))
+		return -ENOBUFS;
+
+	slot = &gw->ring[head & (GW_RING_LEN - 1)];
+	gh = (struct gsmtap_hdr *) slot->buf;
+	*gh = (struct gsmtap_hdr) {
+		.version = GSMTAP_VERSION,
+		.hdr_len = sizeof(*gh) / 4,
+		.type = GSMTAP_TYPE_UM,
+		.timeslot = ts,
+		.sub_slot = ss,
+		.arfcn = htons(arfcn),
+		.snr_db = snr,
+		.signal_dbm = signal_dbm,
+		.frame_number = htonl(fn),
+		.sub_type = chan_type,
+		.antenna_nr = 0,
+	};
+	memcpy(slot->buf + sizeof(*gh), data, len);
+	slot->len = sizeof(*gh) + len;
+
+	__atomic_store_n(&gw->head, head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
@@ -124,6 +124,7 @@ void handover_rach(struct gsm_lchan *lchan, uint8_t ra, uint8_t acc_delay)
 
 	/* Send HANDover DETect to BSC */
 	rsl_tx_hando_det(lchan, &lchan->ta_ctrl.current);
+	osmo_clock_gettime(CLOCK_MONOTONIC, &lchan->ho.det_time);
 
 	/* Send PHYS INFO */
 	lchan->ho.phys_info_count = 1;
@@ -140,6 +141,7 @@ void handover_rach(struct gsm_lchan *lchan, uint8_t ra, uint8_t acc_delay)
 void handover_frame(struct gsm_lchan *lchan)
 {
 	LOGPLCHAN(lchan, DHO, LOGL_INFO, "First valid frame detected\n");
+	bts_proc_lat_add(lchan->ts->trx->bts, BTS_PROC_LAT_HO_FIRST_FRAME, &lchan->ho.det_time);
 	handover_reset(lchan);
 }
 
@@ -151,4 +153,5 @@ void handover_reset(struct gsm_lchan *lchan)
 
 	/* Handover process is done */
 	lchan->ho.active = HANDOVER_NONE;
+	lchan->ho.det_time = (struct timespec){ 0 };
 }
@@ -59,6 +59,9 @@
 #include <osmo-bts/cbch.h>
 #include <osmo-bts/asci.h>
 #include <osmo-bts/csd_v110.h>
+#include <osmo-bts/gsmtap_writer.h>
+#include <osmo-bts/pcap_capture.h>
+#include <osmo-bts/trace.h>
 
 /* determine the CCCH block number based on the frame number */
 unsigned int l1sap_fn2ccch_block(uint32_t fn)
@@ -69,28 +72,11 @@ unsigned int l1sap_fn2ccch_block(uint32_t fn)
 	return rc;
 }
 
+/* see gsm_bts_trx_update_lchan_map() */
 struct gsm_lchan *get_lchan_by_chan_nr(struct gsm_bts_trx *trx,
 				       unsigned int chan_nr)
 {
-	struct gsm_bts_trx_ts *ts;
-	unsigned int tn, ss;
-
-	tn = L1SAP_CHAN2TS(chan_nr);
-	ts = &trx->ts[tn];
-
-	if (L1SAP_IS_CHAN_VAMOS(chan_nr)) {
-		if (ts->vamos.peer == NULL)
-			return NULL;
-		ts = ts->vamos.peer;
-	}
-
-	if (L1SAP_IS_CHAN_CBCH(chan_nr))
-		ss = 2; /* CBCH is always on sub-slot 2 */
-	else
-		ss = l1sap_chan2ss(chan_nr);
-	OSMO_ASSERT(ss < ARRAY_SIZE(ts->lchan));
-
-	return &ts->lchan[ss];
+	return trx->lchan_by_chan_nr[chan_nr & 0xff];
 }
 
 static struct gsm_lchan *
@@ -131,14 +117,120 @@ static uint32_t fn_ms_adj(uint32_t fn, const struct gsm_lchan *lchan)
 	return GSM_RTP_DURATION;
 }
 
+/* Nearly every L1SAP primitive in both directions is allocated, and freed
+ * shortly after, via l1sap_msgb_alloc().  Instead of going through malloc()
+ * each time, msgbs of the common sizes are recycled: a talloc destructor
+ * intercepts msgb_free() and puts the msgb on the free list of its size
+ * class.  Like talloc itself, this is not thread-safe: primitives shall be
+ * allocated and freed on the main thread only. */
+#define L1SAP_MSGB_POOL_MAX 256 /* max. number of pooled msgbs per class */
+
+static struct l1sap_msgb_pool g_l1sap_msgb_pool[] = {
+	/* MAC blocks, speech frames (also from RTP), GPRS CS-1..4 */
+	{ .l2_len = 64, .free = LLIST_HEAD_INIT(g_l1sap_msgb_pool[0].free) },
+	/* EGPRS MCS-1..9, CSD (also from RTP, see l1sap_rtp_rx_cb()) */
+	{ .l2_len = 512, .free = LLIST_HEAD_INIT(g_l1sap_msgb_pool[1].free) },
+};
+
+#define L1SAP_MSGB_SIZE(l2_len) \
+	(L1SAP_MSGB_HEADROOM + sizeof(struct osmo_phsap_prim) + (l2_len))
+
+const struct l1sap_msgb_pool *l1sap_msgb_pool_get(unsigned int idx)
+{
+	if (idx >= ARRAY_SIZE(g_l1sap_msgb_pool))
+		return NULL;
+	return &g_l1sap_msgb_pool[idx];
+}
+
+static struct l1sap_msgb_pool *l1sap_msgb_pool_by_size(uint16_t data_len)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(g_l1sap_msgb_pool); i++) {
+		if (data_len == L1SAP_MSGB_SIZE(g_l1sap_msgb_pool[i].l2_len))
+			return &g_l1sap_msgb_pool[i];
+	}
+
+	return NULL;
+}
+
+/* called by talloc_free(), i.e. by msgb_free() */
+static int l1sap_msgb_pool_destructor(struct msgb *msg)
+{
+	struct l1sap_msgb_pool *pool = l1sap_msgb_pool_by_size(msg->data_len);
+
+	OSMO_ASSERT(pool != NULL);
+	pool->in_use--;
+
+	if (pool->free_len >= L1SAP_MSGB_POOL_MAX)
+		return 0; /* actually free it */
+
+	/* A pooled msgb can still be freed for real, e.g. along with its
+	 * talloc parent on shutdown, as it has no destructor anymore. */
+	talloc_set_destructor(msg, NULL);
+	llist_add(&msg->list, &pool->free);
+	pool->free_len++;
+
+	return -1; /* keep the memory */
+}
+
+/* reset a recycled msgb to the state msgb_alloc() leaves it in */
+static void l1sap_msgb_pool_reset(struct msgb *msg)
+{
+	uint16_t data_len = msg->data_len;
+
+	memset(msg, 0, sizeof(*msg) + data_len);
+	msg->data_len = data_len;
+	msg->data = msg->_data;
+	msg->head = msg->_data;
+	msg->tail = msg->_data;
+}
+
+static struct msgb *l1sap_msgb_pool_alloc(unsigned int l2_len)
+{
+	struct l1sap_msgb_pool *pool = NULL;
+	struct msgb *msg;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(g_l1sap_msgb_pool); i++) {
+		if (l2_len <= g_l1sap_msgb_pool[i].l2_len) {
+			pool = &g_l1sap_msgb_pool[i];
+			break;
+		}
+	}
+
+	/* too large for any class, not pooled */
+	if (pool == NULL)
+		return msgb_alloc_headroom(L1SAP_MSGB_SIZE(l2_len), L1SAP_MSGB_HEADROOM, "l1sap_prim");
+
+	if (OSMO_LIKELY(!llist_empty(&pool->free))) {
+		msg = llist_first_entry(&pool->free, struct msgb, list);
+		llist_del(&msg->list);
+		pool->free_len--;
+		l1sap_msgb_pool_reset(msg);
+		msgb_reserve(msg, L1SAP_MSGB_HEADROOM);
+		pool->hits++;
+	} else {
+		msg = bts_hp_msgb_alloc_headroom(L1SAP_MSGB_SIZE(pool->l2_len), L1SAP_MSGB_HEADROOM,
+						 "l1sap_prim");
+		if (!msg)
+			return NULL;
+		pool->misses++;
+	}
+
+	talloc_set_destructor(msg, l1sap_msgb_pool_destructor);
+	if (++pool->in_use > pool->in_use_max)
+		pool->in_use_max = pool->in_use;
+
+	return msg;
+}
+
 /* allocate a msgb containing a osmo_phsap_prim + optional l2 data
  * in order to wrap femtobts header around l2 data, there must be enough space
  * in front and behind data pointer */
 struct msgb *l1sap_msgb_alloc(unsigned int l2_len)
 {
-	const int headroom = L1SAP_MSGB_HEADROOM;
-	const int size = headroom + sizeof(struct osmo_phsap_prim) + l2_len;
-	struct msgb *msg = msgb_alloc_headroom(size, headroom, "l1sap_prim");
+	struct msgb *msg = l1sap_msgb_pool_alloc(l2_len);
 
 	if (!msg)
 		return NULL;
@@ -453,6 +545,13 @@ static bool is_fill_frame(uint8_t chan_type, const uint8_t *data, unsigned int l
 	return false;
 }
 
+static inline bool gsmtap_sapi_enabled(uint8_t chan_type, uint32_t sapi_mask, uint8_t sapi_acch)
+{
+	if ((chan_type & GSMTAP_CHANNEL_ACCH))
+		return sapi_acch != 0;
+	return ((1 << (chan_type & 31)) & sapi_mask) != 0;
+}
+
 static int to_gsmtap(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 {
 	uint8_t *data;
@@ -463,8 +562,9 @@ static int to_gsmtap(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 	int8_t signal_dbm;
 	int rc;
 
-	struct gsmtap_inst *inst = trx->bts->gsmtap.inst;
-	if (!inst)
+	struct gsmtap_inst *inst = trx->bts->gsmtap.shed ? NULL : trx->bts->gsmtap.inst;
+	struct pcap_capture *cap = trx->bts->pcap.cap;
+	if (!inst && !cap)
 		return 0;
 
 	switch (OSMO_PRIM_HDR(&l1sap->oph)) {
@@ -496,19 +596,39 @@ static int to_gsmtap(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 
 	if (len == 0)
 		return 0;
-	if ((chan_type & GSMTAP_CHANNEL_ACCH)) {
-		if (!trx->bts->gsmtap.sapi_acch)
-			return 0;
-	} else {
-		if (!((1 << (chan_type & 31)) & trx->bts->gsmtap.sapi_mask))
-			return 0;
-	}
 
 	/* don't log fill frames via GSMTAP; they serve no purpose other than
 	 * to clog up your logs */
 	if (is_fill_frame(chan_type, data, len))
 		return 0;
 
+	/* the pcap capture has its own SAPI filter and is not sampled */
+	if (cap != NULL && gsmtap_sapi_enabled(chan_type, trx->bts->pcap.sapi_mask,
+					       trx->bts->pcap.sapi_acch))
+		pcap_capture_gsmtap(cap, trx->arfcn | uplink, tn, chan_type, ss, fn,
+				    signal_dbm, 0 /* TODO: SNR */, data, len);
+
+	if (!inst)
+		return 0;
+	if (!gsmtap_sapi_enabled(chan_type, trx->bts->gsmtap.sapi_mask, trx->bts->gsmtap.sapi_acch))
+		return 0;
+
+	/* 1-in-N sampling of the matching messages */
+	if (trx->bts->gsmtap.sampling > 1) {
+		if (++trx->bts->gsmtap.sampling_cnt < trx->bts->gsmtap.sampling)
+			return 0;
+		trx->bts->gsmtap.sampling_cnt = 0;
+	}
+
+	if (trx->bts->gsmtap.writer != NULL) {
+		rc = gsmtap_writer_enqueue(trx->bts->gsmtap.writer, trx->arfcn | uplink,
+					   tn, chan_type, ss, fn, signal_dbm,
+					   0 /* TODO: SNR */, data, len);
+		if (rc < 0)
+			rate_ctr_inc2(trx->bts->ctrs, BTS_CTR_GSMTAP_DROP);
+		return 0;
+	}
+
 	gsmtap_send(inst, trx->arfcn | uplink, tn, chan_type, ss, fn,
 		    signal_dbm, 0 /* TODO: SNR */, data, len);
 
@@ -629,19 +749,23 @@ static int l1sap_info_time_ind(struct gsm_bts *bts,
 	gsm_fn2gsmtime(&bts->gsm_time, info_time_ind->fn);
 
 	/* Update time on PCU interface */
-	pcu_tx_time_ind(info_time_ind->fn);
+	pcu_tx_time_ind(bts, info_time_ind->fn, frames_expired != 1);
 
 	/* increment number of RACH slots that have passed by since the
 	 * last time indication */
 	for (i = 0; i < frames_expired; i++) {
 		uint32_t fn = GSM_TDMA_FN_SUB(info_time_ind->fn, i);
 		bts->load.rach.total += calc_exprd_rach_frames(bts, fn);
+		bts_osmux_tdma_tick(bts, fn);
 	}
 
 	/* Report interference levels to the BSC */
 	if (bts_internal_flag_get(bts, BTS_INTERNAL_FLAG_INTERF_MEAS))
 		l1sap_interf_meas_report(bts);
 
+	/* Flush the RSL messages coalesced during the previous frame */
+	abis_rsl_coalesce_tdma_tick(bts);
+
 	return 0;
 }
 
@@ -808,6 +932,9 @@ static int l1sap_info_act_cnf(struct gsm_bts_trx *trx,
 	LOGPLCHAN(lchan, DL1C, LOGL_INFO, "activate confirm chan_nr=%s trx=%d\n",
 		  rsl_chan_nr_str(info_act_cnf->chan_nr), trx->nr);
 
+	bts_proc_lat_add(trx->bts, BTS_PROC_LAT_CHAN_ACT_PHY_CNF, &lchan->chan_act_time.phy_req);
+	lchan->chan_act_time.phy_req = (struct timespec) { 0 };
+
 	rsl_tx_chan_act_acknack(lchan, info_act_cnf->cause);
 
 	/* During PDCH ACT, this is where we know that the PCU is done
@@ -888,6 +1015,7 @@ static int lchan_pdtch_ph_rts_ind_loop(struct gsm_lchan *lchan,
 	/* de-queue response message (loopback) */
 	loop_msg = msgb_dequeue_count(&lchan->dl_tch_queue, &lchan->dl_tch_queue_len);
 	if (!loop_msg) {
+		rate_ctr_inc2(lchan->ts->trx->bts->ctrs, BTS_CTR_LOOPBACK_DL_EMPTY);
 		LOGPLCGT(lchan, tm, DL1P, LOGL_NOTICE, "no looped PDTCH message, sending empty\n");
 		/* empty downlink message */
 		p = msgb_put(msg, GSM_MACBLOCK_LEN);
@@ -965,8 +1093,11 @@ static inline struct msgb *lapdm_phsap_dequeue_msg(struct lapdm_entity *le)
 	return pp.oph.msg;
 }
 
-/* Special dequeueing function with FACCH repetition (3GPP TS 44.006, section 10) */
-static inline struct msgb *lapdm_phsap_dequeue_msg_facch(struct gsm_lchan *lchan, struct lapdm_entity *le, uint32_t fn)
+/* Special dequeueing function with FACCH repetition (3GPP TS 44.006, section 10).
+ * A message kept for repetition is returned with *keep set: the caller must
+ * not free it, it is sent again (and then freed) 8 or 9 bursts later. */
+static inline struct msgb *lapdm_phsap_dequeue_msg_facch(struct gsm_lchan *lchan, struct lapdm_entity *le,
+							 uint32_t fn, bool *keep)
 {
 	struct osmo_phsap_prim pp;
 	struct msgb *msg;
@@ -995,13 +1126,15 @@ static inline struct msgb *lapdm_phsap_dequeue_msg_facch(struct gsm_lchan *lchan
 		if (!(lchan->rep_acch_cap.dl_facch_all || msg->data[0] & 0x02))
 			return msg;
 
-		/* ... and store the message buffer for repetition. */
+		/* ... and keep the message buffer for repetition. */
 		if (lchan->rep_acch.dl_facch[0].msg == NULL) {
-			lchan->rep_acch.dl_facch[0].msg = msgb_copy(msg, "rep_facch_0");
+			lchan->rep_acch.dl_facch[0].msg = msg;
 			lchan->rep_acch.dl_facch[0].fn = fn;
+			*keep = true;
 		} else if (lchan->rep_acch.dl_facch[1].msg == NULL) {
-			lchan->rep_acch.dl_facch[1].msg = msgb_copy(msg, "rep_facch_1");
+			lchan->rep_acch.dl_facch[1].msg = msg;
 			lchan->rep_acch.dl_facch[1].fn = fn;
+			*keep = true;
 		} else {
 			/* By definition 3GPP TS 05.02 does not allow more than two (for TCH/H only one) FACCH blocks
 			 * to be transmitted simultaniously. */
@@ -1012,8 +1145,10 @@ static inline struct msgb *lapdm_phsap_dequeue_msg_facch(struct gsm_lchan *lchan
 	return msg;
 }
 
-/* Special dequeueing function with SACCH repetition (3GPP TS 44.006, section 11) */
-static inline struct msgb *lapdm_phsap_dequeue_msg_sacch(struct gsm_lchan *lchan, struct lapdm_entity *le)
+/* Special dequeueing function with SACCH repetition (3GPP TS 44.006, section 11).
+ * Like for the FACCH, a repetition candidate is returned with *keep set. */
+static inline struct msgb *lapdm_phsap_dequeue_msg_sacch(struct gsm_lchan *lchan, struct lapdm_entity *le,
+							 bool *keep)
 {
 	struct osmo_phsap_prim pp;
 	struct msgb *msg;
@@ -1044,8 +1179,10 @@ static inline struct msgb *lapdm_phsap_dequeue_msg_sacch(struct gsm_lchan *lchan
 
 	/* Only LAPDm frames for SAPI 0 may become a repetition
 	 * candidate. */
-	if (sapi == 0)
-		lchan->rep_acch.dl_sacch_msg = msgb_copy(msg, "rep_sacch");
+	if (sapi == 0) {
+		lchan->rep_acch.dl_sacch_msg = msg;
+		*keep = true;
+	}
 
 	return msg;
 }
@@ -1064,6 +1201,7 @@ static int l1sap_ph_rts_ind(struct gsm_bts_trx *trx,
 	uint8_t *si;
 	struct lapdm_entity *le;
 	struct msgb *pp_msg;
+	bool pp_msg_keep = false;
 	bool dtxd_facch = false;
 	int rc;
 
@@ -1148,7 +1286,7 @@ static int l1sap_ph_rts_ind(struct gsm_bts_trx *trx,
 						LOGPLCHAN(lchan, DL1P, LOGL_DEBUG, "DL-SACCH repetition: active => inactive\n");
 					lchan->rep_acch.dl_sacch_active = false;
 				}
-				pp_msg = lapdm_phsap_dequeue_msg_sacch(lchan, le);
+				pp_msg = lapdm_phsap_dequeue_msg_sacch(lchan, le, &pp_msg_keep);
 			} else {
 				pp_msg = lapdm_phsap_dequeue_msg(le);
 			}
@@ -1157,7 +1295,7 @@ static int l1sap_ph_rts_ind(struct gsm_bts_trx *trx,
 				dtxd_facch = true;
 			le = &lchan->lapdm_ch.lapdm_dcch;
 			if (lchan->rep_acch.dl_facch_active && lchan->rsl_cmode != RSL_CMOD_SPD_SIGN)
-				pp_msg = lapdm_phsap_dequeue_msg_facch(lchan, le, fn);
+				pp_msg = lapdm_phsap_dequeue_msg_facch(lchan, le, fn, &pp_msg_keep);
 			else
 				pp_msg = lapdm_phsap_dequeue_msg(le);
 			lchan->tch.dtx_fr_hr_efr.dl_facch_stealing = (pp_msg != NULL);
@@ -1208,7 +1346,9 @@ static int l1sap_ph_rts_ind(struct gsm_bts_trx *trx,
 						vgcs_uplink_free_reset(lchan);
 				}
 			}
-			msgb_free(pp_msg);
+			/* a repetition candidate is freed once it was repeated (or tossed) */
+			if (!pp_msg_keep)
+				msgb_free(pp_msg);
 		}
 	} else if (L1SAP_IS_CHAN_AGCH_PCH(chan_nr)) {
 		p = msgb_put(msg, GSM_MACBLOCK_LEN);
@@ -1513,7 +1653,10 @@ static int l1sap_tch_rts_ind(struct gsm_bts_trx *trx,
 		LOGPLCGT(lchan, &g_time, DL1P, LOGL_DEBUG, "Rx TCH-RTS.ind\n");
 	}
 
-	if (!lchan->loopback && lchan->abis_ip.rtp_socket) {
+	if (lchan->abis_ip.media) {
+		/* l1sap_rtp_rx_cb() drops the frames in loopback mode */
+		lchan_rtp_media_poll(lchan);
+	} else if (!lchan->loopback && lchan->abis_ip.rtp_socket) {
 		osmo_rtp_socket_poll(lchan->abis_ip.rtp_socket);
 		/* FIXME: we _assume_ that we never miss TDMA
 		 * frames and that we always get to this point
@@ -1523,10 +1666,15 @@ static int l1sap_tch_rts_ind(struct gsm_bts_trx *trx,
 		 * elapsed since the last call */
 		lchan->abis_ip.rtp_socket->rx_user_ts += GSM_RTP_DURATION;
 	}
-	/* get a msgb from the dl_tx_queue */
-	resp_msg = msgb_dequeue_count(&lchan->dl_tch_queue, &lchan->dl_tch_queue_len);
+	/* get a msgb from the dl_tx_queue (or the jitter buffer) */
+	if (lchan->dl_tch_jb.max_depth > 0 && !lchan->loopback)
+		resp_msg = lchan_dl_tch_jb_dequeue(lchan);
+	else
+		resp_msg = msgb_dequeue_count(&lchan->dl_tch_queue, &lchan->dl_tch_queue_len);
 	if (!resp_msg) {
 		LOGPLCGT(lchan, &g_time, DL1P, LOGL_DEBUG, "DL TCH Tx queue underrun\n");
+		if (lchan->loopback)
+			rate_ctr_inc2(trx->bts->ctrs, BTS_CTR_LOOPBACK_DL_EMPTY);
 		resp_l1sap = &empty_l1sap;
 	} else {
 		/* Obtain RTP header Marker bit from control buffer */
@@ -1708,6 +1856,8 @@ static void repeated_ul_sacch_active_decision(struct gsm_lchan *lchan,
 		lchan->rep_acch.ul_sacch_active = false;
 
 out:
+	if (lchan->rep_acch.ul_sacch_active)
+		rate_ctr_inc2(lchan->ts->trx->bts->ctrs, BTS_CTR_ACCH_REP_UL_SACCH);
 	if (lchan->rep_acch.ul_sacch_active == prev_repeated_ul_sacch_active)
 		return;
 	if (lchan->rep_acch.ul_sacch_active)
@@ -1749,6 +1899,7 @@ static int l1sap_ph_data_ind(struct gsm_bts_trx *trx,
 			/* we are in loopback mode (for BER testing)
 			 * mode and need to enqeue the frame to be
 			 * returned in downlink */
+			rate_ctr_inc2(trx->bts->ctrs, len ? BTS_CTR_LOOPBACK_UL_GOOD : BTS_CTR_LOOPBACK_UL_BAD);
 			lchan_dl_tch_queue_enqueue(lchan, msg, 1);
 
 			/* Return 1 to signal that we're still using msg
@@ -1840,6 +1991,10 @@ static void send_ul_rtp_packet_data(struct gsm_lchan *lchan, uint32_t fn,
 	if (rc < 0)
 		return;
 
+	if (lchan->ts->trx->bts->pcap.rtp && lchan->ts->trx->bts->pcap.cap != NULL)
+		pcap_capture_rtp(lchan->ts->trx->bts->pcap.cap, lchan, true, 0, fn,
+				 lchan->rtp_tx_marker, &rtp_pl[0], sizeof(rtp_pl));
+
 	osmo_rtp_send_frame_ext(lchan->abis_ip.rtp_socket,
 				&rtp_pl[0], sizeof(rtp_pl),
 				fn_ms_adj(fn, lchan),
@@ -1852,6 +2007,10 @@ static void send_ul_rtp_packet_data(struct gsm_lchan *lchan, uint32_t fn,
 static void send_ul_rtp_packet_speech(struct gsm_lchan *lchan, uint32_t fn,
 				      const uint8_t *rtp_pl, uint16_t rtp_pl_len)
 {
+	if (lchan->ts->trx->bts->pcap.rtp && lchan->ts->trx->bts->pcap.cap != NULL)
+		pcap_capture_rtp(lchan->ts->trx->bts->pcap.cap, lchan, true, 0, fn,
+				 lchan->rtp_tx_marker, rtp_pl, rtp_pl_len);
+
 	if (lchan->abis_ip.osmux.use) {
 		lchan_osmux_send_frame(lchan, rtp_pl, rtp_pl_len,
 				       fn_ms_adj(fn, lchan), lchan->rtp_tx_marker);
@@ -1958,6 +2117,21 @@ static int l1sap_tch_ind(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap,
 
 	msgb_pull_to_l2(msg);
 
+	/* Loopback (for BER and capacity testing): hand the received frame
+	 * over to the next TCH-RTS.ind as it is, bypassing the ECU and RTP */
+	if (OSMO_UNLIKELY(lchan->loopback)) {
+		lchan->tch.last_fn = fn;
+		if (msg->len && tch_ind->lqual_cb >= bts->min_qual_norm) {
+			rate_ctr_inc2(bts->ctrs, BTS_CTR_LOOPBACK_UL_GOOD);
+			/* make sure the queue doesn't get too long */
+			lchan_dl_tch_queue_enqueue(lchan, msg, 1);
+			/* Return 1 to signal that we're still using msg and it should not be freed */
+			return 1;
+		}
+		rate_ctr_inc2(bts->ctrs, BTS_CTR_LOOPBACK_UL_BAD);
+		return 0;
+	}
+
 	/* Low level layers always call us when TCH content is expected, even if
 	 * the content is not available due to decoding issues. Content not
 	 * available is expected as empty payload. We also check if quality is
@@ -1982,13 +2156,6 @@ static int l1sap_tch_ind(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap,
 		default: /* shall not happen */
 			OSMO_ASSERT(0);
 		}
-		/* if loopback is enabled, also queue received RTP data */
-		if (lchan->loopback) {
-			/* add new frame to queue, make sure the queue doesn't get too long */
-			lchan_dl_tch_queue_enqueue(lchan, msg, 1);
-			/* Return 1 to signal that we're still using msg and it should not be freed */
-			return 1;
-		}
 	} else {
 		tch_ul_bfi_handler(lchan, &g_time, msg);
 	}
@@ -2050,7 +2217,7 @@ static int l1sap_dcch_rach(struct gsm_bts_trx *trx, struct ph_rach_ind_param *ra
 	/* Differentiate + dispatch hand-over and VGCS RACH */
 	if (rsl_chan_rt_is_asci(lchan->rsl_chan_rt)) {
 		rate_ctr_inc2(trx->bts->ctrs, BTS_CTR_RACH_VGCS);
-		vgcs_rach(lchan, rach_ind->ra, rach_ind->acc_delay, rach_ind->fn);
+		vgcs_rach(lchan, rach_ind);
 	} else {
 		rate_ctr_inc2(trx->bts->ctrs, BTS_CTR_RACH_HO);
 		handover_rach(lchan, rach_ind->ra, rach_ind->acc_delay);
@@ -2148,6 +2315,12 @@ static int l1sap_ph_rach_ind(struct gsm_bts_trx *trx,
 	LOGPFN(DL1P, LOGL_INFO, rach_ind->fn, "RACH for RR access (toa=%d, ra=%d)\n",
 		rach_ind->acc_delay, rach_ind->ra);
 	rate_ctr_inc2(trx->bts->ctrs, BTS_CTR_RACH_CS);
+
+	/* Collapse repetitions, then don't flood the BSC with CHAN RQD */
+	if (bts_rach_dedup(bts, rach_ind->ra, L1SAP_CHAN2TS(rach_ind->chan_nr), rach_ind->fn))
+		return 0;
+	if (bts_rach_shed(bts, rach_ind->ra, rach_ind->fn))
+		return 0;
 	lapdm_phsap_up(&l1sap->oph, &lc->lapdm_dcch);
 
 	return 0;
@@ -2163,6 +2336,8 @@ int l1sap_up(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 	struct msgb *msg = l1sap->oph.msg;
 	int rc = 0;
 
+	TRACE(OSMO_BTS_L1SAP_UP_START(trx->nr, OSMO_PRIM_HDR(&l1sap->oph)));
+
 	switch (OSMO_PRIM_HDR(&l1sap->oph)) {
 	case OSMO_PRIM(PRIM_MPH_INFO, PRIM_OP_INDICATION):
 		rc = l1sap_mph_info_ind(trx, l1sap, &l1sap->u.info);
@@ -2197,6 +2372,8 @@ int l1sap_up(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 		break;
 	}
 
+	TRACE(OSMO_BTS_L1SAP_UP_DONE(trx->nr, rc));
+
 	/* Special return value '1' means: do not free */
 	if (rc != 1)
 		msgb_free(msg);
@@ -2204,6 +2381,61 @@ int l1sap_up(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 	return rc;
 }
 
+/*! Allocate a PCU DATA.ind for an Uplink PDTCH block.  The BTS model decodes
+ *  the block right into its payload and submits it with l1sap_pdtch_ind_send(),
+ *  which saves the PH-DATA.ind msgb and a copy of the block.
+ *  \param[in] trx transceiver the block was received on
+ *  \param[in] chan_nr RSL channel number of the PDCH
+ *  \param[out] data room for the decoded block (up to 162 bytes)
+ *  \returns msgb, or NULL if the block needs to go the PH-DATA.ind way
+ *  (GSMTAP or pcap capture active, loopback mode) */
+struct msgb *l1sap_pdtch_ind_alloc(struct gsm_bts_trx *trx, uint8_t chan_nr, uint8_t **data)
+{
+	struct gsm_bts *bts = trx->bts;
+	struct gsm_lchan *lchan;
+
+	if ((bts->gsmtap.inst != NULL && !bts->gsmtap.shed) || bts->pcap.cap != NULL)
+		return NULL;
+
+	lchan = get_lchan_by_chan_nr(trx, chan_nr);
+	if (lchan == NULL || lchan->loopback)
+		return NULL;
+
+	return pcu_data_ind_alloc(bts, data);
+}
+
+/*! Submit a DATA.ind obtained from l1sap_pdtch_ind_alloc() to the PCU, like
+ *  l1sap_ph_data_ind() does for PH-DATA.ind on a PDCH.
+ *  \param[in] trx transceiver the block was received on
+ *  \param[in] msg DATA.ind, ownership is transferred
+ *  \param[in] data_ind measurements and metadata of the block
+ *  \param[in] len length of the decoded block */
+int l1sap_pdtch_ind_send(struct gsm_bts_trx *trx, struct msgb *msg,
+			 const struct ph_data_param *data_ind, uint8_t len)
+{
+	uint8_t tn = L1SAP_CHAN2TS(data_ind->chan_nr);
+	uint32_t fn = data_ind->fn;
+
+	DEBUGP(DL1P, "Rx PDTCH DATA.ind chan_nr=%s fn=%u len=%u\n",
+	       rsl_chan_nr_str(data_ind->chan_nr), fn, len);
+
+	/* see l1sap_ph_data_ind() */
+	if (L1SAP_IS_PTCCH(fn)) {
+		LOGP(DL1P, LOGL_NOTICE, "There can be no DATA.ind on PTCCH/U. "
+		     "This is probably a bug of the BTS model you're using, please fix!\n");
+		msgb_free(msg);
+		return -EINVAL;
+	}
+
+	/* Drop all data from incomplete UL block */
+	if (data_ind->pdch_presence_info != PRES_INFO_BOTH)
+		len = 0;
+
+	return pcu_data_ind_send(&trx->ts[tn], msg, PCU_IF_SAPI_PDTCH, fn, trx->arfcn,
+				 L1SAP_FN2MACBLOCK(fn), len, data_ind->rssi, data_ind->ber10k,
+				 data_ind->ta_offs_256bits/64, data_ind->lqual_cb);
+}
+
 /* any L1 prim sent to bts model */
 static int l1sap_down(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 {
@@ -2262,6 +2494,10 @@ void l1sap_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
 	if (lchan->loopback)
 		return;
 
+	if (lchan->ts->trx->bts->pcap.rtp && lchan->ts->trx->bts->pcap.cap != NULL)
+		pcap_capture_rtp(lchan->ts->trx->bts->pcap.cap, lchan, false, seq_number, timestamp,
+				 marker, rtp_pl, rtp_pl_len);
+
 	/* initial preen */
 	switch (rtp_payload_input_preen(lchan, rtp_pl, rtp_pl_len, &rfc5993_sid)) {
 	case PL_DECISION_DROP:
@@ -2276,7 +2512,13 @@ void l1sap_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
 		OSMO_ASSERT(0);
 	}
 
-	msg = l1sap_msgb_alloc(512);
+	/* The RTP payload is owned by the RTP socket, so it has to be copied
+	 * (or decoded) once.  Size the msgb by what will actually be put into
+	 * it, so that speech frames come from the small msgb pool class. */
+	if (lchan->rsl_cmode == RSL_CMOD_SPD_DATA)
+		msg = l1sap_msgb_alloc(CSD_V110_RADIO_BITS_MAX);
+	else
+		msg = l1sap_msgb_alloc(rtp_pl_len);
 	if (!msg)
 		return;
 
@@ -2304,6 +2546,11 @@ void l1sap_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
 	/* Store RFC 5993 SID flag likewise */
 	rtpmsg_is_rfc5993_sid(msg) = rfc5993_sid;
 
+	if (lchan->dl_tch_jb.max_depth > 0) {
+		lchan_dl_tch_jb_enqueue(lchan, msg);
+		return;
+	}
+
 	/* make sure the queue doesn't get too long */
 	lchan_dl_tch_queue_enqueue(lchan, msg, 1);
 }
@@ -2338,6 +2585,9 @@ int l1sap_chan_act(struct gsm_bts_trx *trx, uint8_t chan_nr)
 
 	radio_link_timeout_reset(lchan);
 
+	bts_proc_lat_add(trx->bts, BTS_PROC_LAT_CHAN_ACT_PHY_REQ, &lchan->chan_act_time.rx);
+	osmo_clock_gettime(CLOCK_MONOTONIC, &lchan->chan_act_time.phy_req);
+
 	rc = l1sap_chan_act_dact_modify(trx, chan_nr, PRIM_INFO_ACTIVATE, 0);
 	if (rc)
 		return -RSL_ERR_EQUIPMENT_FAIL;
@@ -2349,41 +2599,38 @@ int l1sap_chan_act(struct gsm_bts_trx *trx, uint8_t chan_nr)
 	else
 		lchan->ecu_state = NULL;
 
-	/* Init DTX DL FSM if necessary */
+	/* Init DTX DL state if necessary */
 	if (trx->bts->dtxd && lchan_is_tch(lchan)) {
-		lchan->tch.dtx.dl_amr_fsm = osmo_fsm_inst_alloc(&dtx_dl_amr_fsm,
-								tall_bts_ctx,
-								lchan,
-								LOGL_DEBUG,
-								NULL);
-		if (!lchan->tch.dtx.dl_amr_fsm) {
-			l1sap_chan_act_dact_modify(trx, chan_nr, PRIM_INFO_DEACTIVATE, 0);
-			return -RSL_ERR_EQUIPMENT_FAIL;
+		lchan->tch.dtx.dl_amr_state = ST_VOICE;
+		lchan->tch.dtx.dl_amr_active = true;
+
+		/* The FSM instance only mirrors the state transitions into the
+		 * log, so it is not worth allocating unless they are logged */
+		if (log_check_level(DL1C, LOGL_DEBUG))
+			lchan->tch.dtx.dl_amr_fsm = osmo_fsm_inst_alloc(&dtx_dl_amr_fsm,
+									tall_bts_ctx,
+									lchan,
+									LOGL_DEBUG,
+									NULL);
+		if (lchan->tch.dtx.dl_amr_fsm) {
+			rc = osmo_fsm_inst_update_id_f(lchan->tch.dtx.dl_amr_fsm,
+						       "bts%u-trx%u-ts%u-ss%u%s",
+						       trx->bts->nr, trx->nr,
+						       lchan->ts->nr, lchan->nr,
+						       lchan->ts->vamos.is_shadow ? "-shadow" : "");
+			OSMO_ASSERT(rc == 0);
 		}
-
-		rc = osmo_fsm_inst_update_id_f(lchan->tch.dtx.dl_amr_fsm,
-					       "bts%u-trx%u-ts%u-ss%u%s",
-					       trx->bts->nr, trx->nr,
-					       lchan->ts->nr, lchan->nr,
-					       lchan->ts->vamos.is_shadow ? "-shadow" : "");
-		OSMO_ASSERT(rc == 0);
 	}
 	return 0;
 }
 
-int l1sap_chan_rel(struct gsm_bts_trx *trx, uint8_t chan_nr)
+/* clean up the L1SAP state of an lchan about to be deactivated */
+static void l1sap_chan_rel_prepare(struct gsm_lchan *lchan, uint8_t chan_nr)
 {
-	struct gsm_lchan *lchan = get_lchan_by_chan_nr(trx, chan_nr);
-
-	if (lchan->state == LCHAN_S_NONE) {
-		LOGPLCHAN(lchan, DL1C, LOGL_ERROR, "Trying to deactivate already deactivated channel %s\n",
-			  rsl_chan_nr_str(chan_nr));
-		return -1;
-	}
-
 	LOGPLCHAN(lchan, DL1C, LOGL_INFO, "Deactivating channel %s\n",
 		  rsl_chan_nr_str(chan_nr));
 
+	lchan->tch.dtx.dl_amr_active = false;
 	if (lchan->tch.dtx.dl_amr_fsm) {
 		osmo_fsm_inst_free(lchan->tch.dtx.dl_amr_fsm);
 		lchan->tch.dtx.dl_amr_fsm = NULL;
@@ -2394,11 +2641,56 @@ int l1sap_chan_rel(struct gsm_bts_trx *trx, uint8_t chan_nr)
 		osmo_ecu_destroy(lchan->ecu_state);
 		lchan->ecu_state = NULL;
 	}
+}
+
+int l1sap_chan_rel(struct gsm_bts_trx *trx, uint8_t chan_nr)
+{
+	struct gsm_lchan *lchan = get_lchan_by_chan_nr(trx, chan_nr);
+
+	if (lchan->state == LCHAN_S_NONE) {
+		LOGPLCHAN(lchan, DL1C, LOGL_ERROR, "Trying to deactivate already deactivated channel %s\n",
+			  rsl_chan_nr_str(chan_nr));
+		return -1;
+	}
+
+	l1sap_chan_rel_prepare(lchan, chan_nr);
 
 	return l1sap_chan_act_dact_modify(trx, chan_nr, PRIM_INFO_DEACTIVATE,
 		0);
 }
 
+/* Deactivate the lchans of a timeslot given in lchan_mask (bit N = ts->lchan[N])
+ * at once.  BTS models which can not do that get an MPH-INFO.req per lchan. */
+int l1sap_ts_rel(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	unsigned int ln;
+	int rc;
+
+	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
+		struct gsm_lchan *lchan = &ts->lchan[ln];
+
+		if (~lchan_mask & (1 << ln))
+			continue;
+		if (lchan->state == LCHAN_S_NONE) {
+			lchan_mask &= ~(1 << ln);
+			continue;
+		}
+		l1sap_chan_rel_prepare(lchan, gsm_lchan2chan_nr(lchan));
+	}
+
+	rc = bts_model_ts_release_lchans(ts, lchan_mask);
+	if (rc != -ENOTSUP)
+		return rc;
+
+	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
+		if (lchan_mask & (1 << ln))
+			l1sap_chan_act_dact_modify(ts->trx, gsm_lchan2chan_nr(&ts->lchan[ln]),
+						   PRIM_INFO_DEACTIVATE, 0);
+	}
+
+	return 0;
+}
+
 int l1sap_chan_deact_sacch(struct gsm_bts_trx *trx, uint8_t chan_nr)
 {
 	struct gsm_lchan *lchan = get_lchan_by_chan_nr(trx, chan_nr);
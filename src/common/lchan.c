@@ -23,6 +23,8 @@
 
 #include <osmocom/core/logging.h>
 
+#include <osmocom/core/timer.h>
+#include <osmocom/codec/codec.h>
 #include <osmocom/trau/osmo_ortp.h>
 
 #include <osmo-bts/logging.h>
@@ -34,7 +36,10 @@
 #include <osmo-bts/l1sap.h>
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/asci.h>
+#include <osmo-bts/msg_utils.h>
+#include <osmo-bts/media_io.h>
 #include <errno.h>
+#include <string.h>
 
 static const struct value_string lchan_s_names[] = {
 	{ LCHAN_S_NONE,		"NONE" },
@@ -186,7 +191,7 @@ static int dyn_ts_pdch_release(struct gsm_lchan *lchan)
 	 */
 	ts->dyn.pchan_want = GSM_PCHAN_NONE;
 
-	if (!pcu_connected()) {
+	if (!pcu_connected_trx(ts->trx)) {
 		/* PCU not connected yet. Just record the new type and done,
 		 * the PCU will pick it up once connected. */
 		ts->dyn.pchan_is = GSM_PCHAN_NONE;
@@ -196,7 +201,9 @@ static int dyn_ts_pdch_release(struct gsm_lchan *lchan)
 	return pcu_tx_info_ind();
 }
 
-void gsm_lchan_release(struct gsm_lchan *lchan, enum lchan_rel_act_kind rel_kind)
+/* Release everything but the L1 part of an lchan, returns true if the lchan
+ * still needs to be deactivated in L1 */
+static bool lchan_release_abis(struct gsm_lchan *lchan, enum lchan_rel_act_kind rel_kind)
 {
 	int rc;
 
@@ -215,7 +222,7 @@ void gsm_lchan_release(struct gsm_lchan *lchan, enum lchan_rel_act_kind rel_kind
 	 * activated... Once we check for that, we can move this check at the
 	 * start of the function */
 	if (lchan->state == LCHAN_S_NONE)
-		return;
+		return false;
 
 	/* release handover, listener and talker states */
 	handover_reset(lchan);
@@ -233,13 +240,39 @@ void gsm_lchan_release(struct gsm_lchan *lchan, enum lchan_rel_act_kind rel_kind
 			/* If the PCU is not connected, continue to rel ack right away. */
 			lchan->rel_act_kind = LCHAN_REL_ACT_PCU;
 			rsl_tx_rf_rel_ack(lchan);
-			return;
+			return false;
 		}
 		/* Waiting for PDCH release */
-		return;
+		return false;
 	}
 
-	l1sap_chan_rel(lchan->ts->trx, gsm_lchan2chan_nr(lchan));
+	return true;
+}
+
+void gsm_lchan_release(struct gsm_lchan *lchan, enum lchan_rel_act_kind rel_kind)
+{
+	if (lchan_release_abis(lchan, rel_kind))
+		l1sap_chan_rel(lchan->ts->trx, gsm_lchan2chan_nr(lchan));
+}
+
+/* Release the lchans of a timeslot given in lchan_mask (bit N = ts->lchan[N]),
+ * like gsm_lchan_release() for each of them, but have L1 deactivate them at
+ * once where the BTS model can */
+void gsm_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask,
+			   enum lchan_rel_act_kind rel_kind)
+{
+	uint32_t l1_mask = 0;
+	unsigned int ln;
+
+	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
+		if (~lchan_mask & (1 << ln))
+			continue;
+		if (lchan_release_abis(&ts->lchan[ln], rel_kind))
+			l1_mask |= (1 << ln);
+	}
+
+	if (l1_mask)
+		l1sap_ts_rel(ts, l1_mask);
 }
 
 int lchan_deactivate(struct gsm_lchan *lchan)
@@ -255,17 +288,31 @@ const char *gsm_lchans_name(enum gsm_lchan_state s)
 	return get_value_string(lchan_s_names, s);
 }
 
-/* obtain the next to-be transmitted dowlink SACCH frame (L2 hdr + L3); returns pointer to lchan->si buffer */
+/* bitmask of the SI to be sent on the SACCH of the lchan: its own ones for
+ * the overridden SI types, the BTS-global ones otherwise */
+uint32_t lchan_sacch_si_valid(const struct gsm_lchan *lchan)
+{
+	const struct gsm_bts *bts = lchan->ts->trx->bts;
+
+	return (lchan->si.valid & lchan->si.overridden)
+	       | (bts->si_valid & LCHAN_SACCH_SI_MASK & ~lchan->si.overridden);
+}
+
+/* obtain the next to-be transmitted dowlink SACCH frame (L2 hdr + L3); returns pointer to
+ * the lchan->si buffer (overridden SI) or to the BTS-global one */
 uint8_t *lchan_sacch_get(struct gsm_lchan *lchan)
 {
+	uint32_t valid = lchan_sacch_si_valid(lchan);
 	uint32_t tmp, i;
 
 	for (i = 0; i < _MAX_SYSINFO_TYPE; i++) {
 		tmp = (lchan->si.last + 1 + i) % _MAX_SYSINFO_TYPE;
-		if (!(lchan->si.valid & (1 << tmp)))
+		if (!(valid & (1 << tmp)))
 			continue;
 		lchan->si.last = tmp;
-		return GSM_LCHAN_SI(lchan, tmp);
+		if (lchan->si.overridden & (1 << tmp))
+			return GSM_LCHAN_SI(lchan, tmp);
+		return GSM_BTS_SI(lchan->ts->trx->bts, tmp);
 	}
 	LOGPLCHAN(lchan, DL1P, LOGL_NOTICE, "SACCH no SI available\n");
 	return NULL;
@@ -440,17 +487,19 @@ uint8_t gsm_lchan_as_pchan2chan_nr(const struct gsm_lchan *lchan,
 }
 
 /* Called by the model specific code every 104 TDMA frames (SACCH period) */
+/* Max. number of collected samples (Intave max is 31) */
+#define LCHAN_INTERF_MEAS_NUM_MAX 31
+
 void gsm_lchan_interf_meas_push(struct gsm_lchan *lchan, int dbm)
 {
-	const uint8_t meas_num = lchan->meas.interf_meas_num;
-
-	if (meas_num >= ARRAY_SIZE(lchan->meas.interf_meas_dbm)) {
+	if (lchan->meas.interf_meas_num >= LCHAN_INTERF_MEAS_NUM_MAX) {
 		LOGPLCHAN(lchan, DL1C, LOGL_ERROR, "Not enough room "
 			  "to store interference report (%ddBm)\n", dbm);
 		return;
 	}
 
-	lchan->meas.interf_meas_dbm[meas_num] = dbm;
+	/* Only the running sum is needed for the average */
+	lchan->meas.interf_meas_sum += dbm;
 	lchan->meas.interf_meas_num++;
 }
 
@@ -459,19 +508,15 @@ void gsm_lchan_interf_meas_calc_avg(struct gsm_lchan *lchan)
 {
 	const uint8_t meas_num = lchan->meas.interf_meas_num;
 	const struct gsm_bts *bts = lchan->ts->trx->bts;
-	int b, meas_avg, meas_sum = 0;
+	int b, meas_avg;
 
 	/* There must be at least one sample */
 	OSMO_ASSERT(meas_num > 0);
 
-	/* Calculate the sum of all collected samples (in -x dBm) */
-	while (lchan->meas.interf_meas_num) {
-		uint8_t i = --lchan->meas.interf_meas_num;
-		meas_sum += lchan->meas.interf_meas_dbm[i];
-	}
-
-	/* Calculate the average of all collected samples */
-	meas_avg = meas_sum / (int) meas_num;
+	/* Calculate the average of all collected samples (in -x dBm) */
+	meas_avg = lchan->meas.interf_meas_sum / (int) meas_num;
+	lchan->meas.interf_meas_sum = 0;
+	lchan->meas.interf_meas_num = 0;
 
 	/* 3GPP TS 48.008 defines 5 interference bands, and 6 interference level
 	 * boundaries (0, X1, ... X5).  It's not clear how to handle values
@@ -555,8 +600,146 @@ static int bind_rtp(struct gsm_bts *bts, struct osmo_rtp_socket *rs, const char
 	return -1;
 }
 
+/* Sockets created per refill timer tick, so that refilling after a burst
+ * of CRCX does not stall the main loop */
+#define RTP_POOL_REFILL_BATCH	4
+#define RTP_POOL_REFILL_US	10000
+
+/* The pool keeps sockets bound to 0.0.0.0 (the CRCX with a remote address)
+ * and configured with the DSCP/priority of the BTS.  A socket is never
+ * returned to the pool on release: its RTP session state (SSRC, sequence,
+ * jitter buffer, remote peer) belongs to the call, so the pool is topped up
+ * with fresh sockets by a timer instead, outside of the CRCX path.  The
+ * sockets are created in a slack task, not in the timer callback. */
+static void rtp_pool_refill_task_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+	unsigned int i;
+
+	for (i = 0; i < RTP_POOL_REFILL_BATCH && bts->rtp_pool.num < bts->rtp_pool.size; i++) {
+		struct osmo_rtp_socket *rs;
+
+		rs = osmo_rtp_socket_create(bts, OSMO_RTP_F_POLL);
+		if (!rs)
+			return;
+		if (bind_rtp(bts, rs, "0.0.0.0") < 0) {
+			LOGP(DRTP, LOGL_ERROR, "Failed to bind a pooled RTP/RTCP socket\n");
+			osmo_rtp_socket_free(rs);
+			return;
+		}
+		bts->rtp_pool.socks[bts->rtp_pool.num++] = rs;
+	}
+
+	if (bts->rtp_pool.num < bts->rtp_pool.size)
+		osmo_timer_schedule(&bts->rtp_pool.refill_timer, 0, RTP_POOL_REFILL_US);
+}
+
+static void rtp_pool_refill_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+
+	slack_task_queue(&bts->rtp_pool.refill_task);
+}
+
+static void rtp_pool_schedule_refill(struct gsm_bts *bts)
+{
+	if (bts->rtp_pool.num >= bts->rtp_pool.size)
+		return;
+	if (osmo_timer_pending(&bts->rtp_pool.refill_timer) || slack_task_queued(&bts->rtp_pool.refill_task))
+		return;
+	osmo_timer_setup(&bts->rtp_pool.refill_timer, rtp_pool_refill_cb, bts);
+	slack_task_init(&bts->rtp_pool.refill_task, "rtp-pool-refill", rtp_pool_refill_task_cb, bts);
+	osmo_timer_schedule(&bts->rtp_pool.refill_timer, 0, RTP_POOL_REFILL_US);
+}
+
+static struct osmo_rtp_socket *rtp_pool_take(struct gsm_bts *bts)
+{
+	if (bts->rtp_pool.size == 0)
+		return NULL;
+
+	rtp_pool_schedule_refill(bts);
+	if (bts->rtp_pool.num == 0) {
+		rate_ctr_inc2(bts->ctrs, BTS_CTR_RTP_POOL_MISS);
+		return NULL;
+	}
+
+	rate_ctr_inc2(bts->ctrs, BTS_CTR_RTP_POOL_HIT);
+	return bts->rtp_pool.socks[--bts->rtp_pool.num];
+}
+
+/*! Keep 'size' pre-bound RTP/RTCP sockets ready for IPA CRCX (0 disables the pool) */
+int lchan_rtp_pool_resize(struct gsm_bts *bts, unsigned int size)
+{
+	struct osmo_rtp_socket **socks;
+
+	while (bts->rtp_pool.num > size)
+		osmo_rtp_socket_free(bts->rtp_pool.socks[--bts->rtp_pool.num]);
+
+	if (size == 0) {
+		osmo_timer_del(&bts->rtp_pool.refill_timer);
+		slack_task_cancel(&bts->rtp_pool.refill_task);
+		TALLOC_FREE(bts->rtp_pool.socks);
+		bts->rtp_pool.size = 0;
+		return 0;
+	}
+
+	socks = talloc_realloc(bts, bts->rtp_pool.socks, struct osmo_rtp_socket *, size);
+	if (!socks)
+		return -ENOMEM;
+	bts->rtp_pool.socks = socks;
+	bts->rtp_pool.size = size;
+
+	rtp_pool_schedule_refill(bts);
+	return 0;
+}
+
+/*! Replace the pooled sockets, e.g. after the RTP port range, DSCP or priority changed */
+void lchan_rtp_pool_flush(struct gsm_bts *bts)
+{
+	while (bts->rtp_pool.num > 0)
+		osmo_rtp_socket_free(bts->rtp_pool.socks[--bts->rtp_pool.num]);
+	rtp_pool_schedule_refill(bts);
+}
+
+/* Let the media thread receive on the RTP socket.  ortp is bypassed on
+ * receive then: its jitter buffer ('rtp jitter-buffer') and the RTCP
+ * processing do not apply, the counts in the CONN STAT IE come from the
+ * media thread instead.  On error, the socket is polled as usual. */
+static void lchan_rtp_media_add(struct gsm_lchan *lchan)
+{
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+
+	if (!bts->media_io.inst) {
+		bts->media_io.inst = media_io_start(bts);
+		if (!bts->media_io.inst)
+			return;
+	}
+
+	lchan->abis_ip.media = media_io_chan_add(bts->media_io.inst,
+						 lchan->abis_ip.rtp_socket->rtp_bfd.fd);
+}
+
+static void lchan_rtp_media_rx_cb(void *priv, const uint8_t *rtp_pl, unsigned int rtp_pl_len,
+				  uint16_t seq_number, uint32_t timestamp, bool marker)
+{
+	struct gsm_lchan *lchan = priv;
+
+	l1sap_rtp_rx_cb(lchan->abis_ip.rtp_socket, rtp_pl, rtp_pl_len, seq_number, timestamp, marker);
+}
+
+/*! Process the RTP packets queued by the media thread, called once per TCH RTS */
+void lchan_rtp_media_poll(struct gsm_lchan *lchan)
+{
+	uint32_t drops;
+
+	media_io_chan_poll(lchan->abis_ip.media, lchan_rtp_media_rx_cb, lchan, &drops);
+	if (OSMO_UNLIKELY(drops > 0))
+		rate_ctr_add2(lchan->ts->trx->bts->ctrs, BTS_CTR_RTP_MEDIA_DROP, drops);
+}
+
 int lchan_rtp_socket_create(struct gsm_lchan *lchan, const char *bind_ip)
 {
+	struct osmo_rtp_socket *pooled = NULL;
 	struct gsm_bts *bts = lchan->ts->trx->bts;
 	char cname[256+4];
 	int rc;
@@ -570,8 +753,13 @@ int lchan_rtp_socket_create(struct gsm_lchan *lchan, const char *bind_ip)
 	/* FIXME: select default value depending on speech_mode */
 	//if (!payload_type)
 	lchan->tch.last_fn = LCHAN_FN_DUMMY;
-	lchan->abis_ip.rtp_socket = osmo_rtp_socket_create(lchan->ts->trx,
-							OSMO_RTP_F_POLL);
+	if (strcmp(bind_ip, "0.0.0.0") == 0)
+		pooled = rtp_pool_take(bts);
+	if (pooled)
+		lchan->abis_ip.rtp_socket = pooled;
+	else
+		lchan->abis_ip.rtp_socket = osmo_rtp_socket_create(lchan->ts->trx,
+								OSMO_RTP_F_POLL);
 
 	if (!lchan->abis_ip.rtp_socket) {
 		LOGPLCHAN(lchan, DRTP, LOGL_ERROR, "IPAC Failed to create RTP/RTCP sockets\n");
@@ -595,8 +783,9 @@ int lchan_rtp_socket_create(struct gsm_lchan *lchan, const char *bind_ip)
 
 	lchan->abis_ip.rtp_socket->priv = lchan;
 	lchan->abis_ip.rtp_socket->rx_cb = &l1sap_rtp_rx_cb;
+	lchan_dl_tch_jb_reset(lchan, bts->rtp_tch_jitter_buf_ms, bts->rtp_tch_jitter_adaptive);
 
-	rc = bind_rtp(bts, lchan->abis_ip.rtp_socket, bind_ip);
+	rc = pooled ? 0 : bind_rtp(bts, lchan->abis_ip.rtp_socket, bind_ip);
 	if (rc < 0) {
 		LOGPLCHAN(lchan, DRTP, LOGL_ERROR, "IPAC Failed to bind RTP/RTCP sockets\n");
 		oml_tx_failure_event_rep(&lchan->ts->trx->mo,
@@ -607,6 +796,9 @@ int lchan_rtp_socket_create(struct gsm_lchan *lchan, const char *bind_ip)
 		return -EBADFD;
 	}
 
+	if (bts->media_io.enabled)
+		lchan_rtp_media_add(lchan);
+
 	/* Ensure RTCP SDES contains some useful information */
 	snprintf(cname, sizeof(cname), "bts@%s", bind_ip);
 	osmo_rtp_set_source_desc(lchan->abis_ip.rtp_socket, cname,
@@ -644,10 +836,13 @@ int lchan_rtp_socket_connect(struct gsm_lchan *lchan, const struct in_addr *ia,
 
 void lchan_rtp_socket_free(struct gsm_lchan *lchan)
 {
+	if (lchan->abis_ip.media) {
+		media_io_chan_del(lchan->ts->trx->bts->media_io.inst, lchan->abis_ip.media);
+		lchan->abis_ip.media = NULL;
+	}
 	osmo_rtp_socket_free(lchan->abis_ip.rtp_socket);
 	lchan->abis_ip.rtp_socket = NULL;
-	msgb_queue_free(&lchan->dl_tch_queue);
-	lchan->dl_tch_queue_len = 0;
+	lchan_dl_tch_jb_reset(lchan, 0, false);
 }
 
 /*! limit number of queue entries to %u; drops any surplus messages */
@@ -662,3 +857,157 @@ void lchan_dl_tch_queue_enqueue(struct gsm_lchan *lchan, struct msgb *msg, unsig
 	}
 	msgb_enqueue_count(&lchan->dl_tch_queue, msg, &lchan->dl_tch_queue_len);
 }
+
+/* Number of consecutive underruns with an empty buffer after which the
+ * jitter buffer prebuffers again, e.g. after a pause of the RTP stream */
+#define DL_TCH_JB_RESTART_GAP	50 /* 1 s */
+
+/*! (re)set the DL TCH jitter buffer, dropping any queued frames
+ *  \param[in] lchan logical channel
+ *  \param[in] max_ms max. buffering delay in ms (0 disables the jitter buffer)
+ *  \param[in] adaptive whether to adapt the depth to the measured jitter */
+void lchan_dl_tch_jb_reset(struct gsm_lchan *lchan, unsigned int max_ms, bool adaptive)
+{
+	msgb_queue_free(&lchan->dl_tch_queue);
+	lchan->dl_tch_queue_len = 0;
+
+	memset(&lchan->dl_tch_jb, 0, sizeof(lchan->dl_tch_jb));
+	lchan->dl_tch_jb.max_depth = (max_ms + 19) / 20;
+	lchan->dl_tch_jb.adaptive = adaptive;
+}
+
+/*! number of frames to buffer before starting the playout */
+unsigned int lchan_dl_tch_jb_target(const struct gsm_lchan *lchan)
+{
+	unsigned int target;
+
+	if (!lchan->dl_tch_jb.adaptive)
+		return lchan->dl_tch_jb.max_depth;
+
+	/* The frame being played out, plus twice the mean deviation */
+	target = 1 + (2 * (lchan->dl_tch_jb.jitter16 >> 4) + GSM_RTP_DURATION - 1) / GSM_RTP_DURATION;
+	return OSMO_MIN(target, lchan->dl_tch_jb.max_depth);
+}
+
+/* arrival time in RTP timestamp units (8 kHz) */
+static uint32_t dl_tch_jb_now(void)
+{
+	struct timespec ts;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 8000 + ts.tv_nsec / 125000;
+}
+
+static void dl_tch_jb_drop_oldest(struct gsm_lchan *lchan)
+{
+	struct msgb *msg = msgb_dequeue_count(&lchan->dl_tch_queue, &lchan->dl_tch_queue_len);
+
+	msgb_free(msg);
+	/* continue the playout with the next frame */
+	msg = llist_first_entry_or_null(&lchan->dl_tch_queue, struct msgb, list);
+	if (lchan->dl_tch_jb.started && msg != NULL)
+		lchan->dl_tch_jb.play_ts = rtpmsg_ts(msg);
+}
+
+/*! insert a DL TCH frame into the jitter buffer, ordered by its RTP timestamp
+ *  \param[in] lchan logical channel
+ *  \param[in] msg frame, with rtpmsg_ts() set (ownership is transferred) */
+void lchan_dl_tch_jb_enqueue(struct gsm_lchan *lchan, struct msgb *msg)
+{
+	struct gsm_lchan_dl_tch_jb *jb = &lchan->dl_tch_jb;
+	uint32_t ts = rtpmsg_ts(msg);
+	uint32_t transit = dl_tch_jb_now() - ts;
+	struct msgb *pos;
+	int32_t d;
+
+	/* Interarrival jitter, see RFC 3550, section 6.4.1 and A.8 */
+	if (jb->transit_valid) {
+		d = (int32_t) (transit - jb->transit);
+		if (d < 0)
+			d = -d;
+		/* e.g. the sender restarted its timestamps */
+		if (d > 8000)
+			d = 8000;
+		jb->jitter16 += d - ((jb->jitter16 + 8) >> 4);
+	}
+	jb->transit = transit;
+	jb->transit_valid = true;
+
+	if (jb->started) {
+		d = (int32_t) (ts - jb->play_ts);
+		if (d < 0) {
+			jb->stats.late++;
+			msgb_free(msg);
+			return;
+		}
+		/* Way ahead of the playout: re-synchronize */
+		if (d >= (int32_t) (2 * jb->max_depth * GSM_RTP_DURATION)) {
+			LOGPLCHAN(lchan, DRTP, LOGL_INFO, "DL TCH jitter buffer: RTP timestamp "
+				  "jump (%d samples), re-synchronizing\n", d);
+			jb->stats.early++;
+			msgb_queue_free(&lchan->dl_tch_queue);
+			lchan->dl_tch_queue_len = 0;
+			jb->started = false;
+		}
+	}
+
+	/* Frames mostly arrive in order, so search from the tail */
+	llist_for_each_entry_reverse(pos, &lchan->dl_tch_queue, list) {
+		d = (int32_t) (ts - (uint32_t) rtpmsg_ts(pos));
+		if (d > 0)
+			break;
+		if (d == 0) {
+			jb->stats.dup++;
+			msgb_free(msg);
+			return;
+		}
+	}
+	if (&pos->list != lchan->dl_tch_queue.prev)
+		jb->stats.reorder++;
+	llist_add(&msg->list, &pos->list);
+	lchan->dl_tch_queue_len++;
+
+	if (lchan->dl_tch_queue_len > 2 * jb->max_depth) {
+		jb->stats.early++;
+		dl_tch_jb_drop_oldest(lchan);
+	}
+}
+
+/*! get the DL TCH frame to be played out, to be called every 20 ms
+ *  \returns the frame; NULL if there is none (prebuffering, lost or late) */
+struct msgb *lchan_dl_tch_jb_dequeue(struct gsm_lchan *lchan)
+{
+	struct gsm_lchan_dl_tch_jb *jb = &lchan->dl_tch_jb;
+	unsigned int target = lchan_dl_tch_jb_target(lchan);
+	struct msgb *msg;
+
+	msg = llist_first_entry_or_null(&lchan->dl_tch_queue, struct msgb, list);
+
+	if (!jb->started) {
+		if (msg == NULL || lchan->dl_tch_queue_len < target)
+			return NULL;
+		jb->play_ts = rtpmsg_ts(msg);
+		jb->started = true;
+		jb->gap = 0;
+	}
+
+	/* Reduce the delay if the jitter went down */
+	if (jb->adaptive && lchan->dl_tch_queue_len > 2 * target) {
+		dl_tch_jb_drop_oldest(lchan);
+		msg = llist_first_entry(&lchan->dl_tch_queue, struct msgb, list);
+	}
+
+	if (msg != NULL && (int32_t) ((uint32_t) rtpmsg_ts(msg) - jb->play_ts) <= 0) {
+		msgb_dequeue_count(&lchan->dl_tch_queue, &lchan->dl_tch_queue_len);
+		jb->gap = 0;
+	} else {
+		jb->stats.underrun++;
+		if (msg == NULL && ++jb->gap >= DL_TCH_JB_RESTART_GAP)
+			jb->started = false;
+		msg = NULL;
+	}
+
+	jb->play_ts += GSM_RTP_DURATION;
+
+	return msg;
+}
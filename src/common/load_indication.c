@@ -23,23 +23,80 @@
 
 #include <osmocom/core/timer.h>
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/bit16gen.h>
 
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/rsl.h>
 #include <osmo-bts/paging.h>
 #include <osmo-bts/bts.h>
 
+/* size of the per-TRX part of OSMO_BTS_RSL_IE_CPU_LOAD */
+#define CPU_LOAD_TRX_LEN	(1 + 2 + TRX_NR_TS * 2)
+
 static void reset_load_counters(struct gsm_bts *bts)
 {
+	struct gsm_bts_trx *trx;
+	unsigned int tn;
+
 	/* re-set the counters */
 	bts->load.ccch.pch_used = bts->load.ccch.pch_total = 0;
 	bts->load.rach.busy = bts->load.rach.access = bts->load.rach.total = 0;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++)
+			trx->ts[tn].cpu_load_ns = 0;
+	}
 }
 
-static void load_timer_cb(void *data)
+/* Encode the scheduler CPU load of the last period in per mille of the period:
+ * the remaining headroom (16 bit), followed by the TRX number (8 bit), the TRX
+ * load (16 bit) and the load of each of its timeslots (8 x 16 bit) for each
+ * operational TRX.  Returns the length of the IE value. */
+static unsigned int load_put_cpu_load(struct gsm_bts *bts, uint8_t *buf, unsigned int buf_len)
+{
+	uint64_t period_ns = (uint64_t) bts->load.ccch.load_ind_period * 1000000000;
+	uint64_t total_ns = 0;
+	struct gsm_bts_trx *trx;
+	unsigned int tn, len = 2;
+	uint32_t permille;
+
+	if (period_ns == 0)
+		return 0;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		uint64_t trx_ns = 0;
+		uint8_t *cur = buf + len;
+
+		/* does not fit into the IE (more than 13 TRX), should not happen */
+		if (len + CPU_LOAD_TRX_LEN > buf_len)
+			break;
+		if (trx->mo.nm_state.operational != NM_OPSTATE_ENABLED)
+			continue;
+
+		*cur = trx->nr;
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			uint64_t ns = trx->ts[tn].cpu_load_ns;
+
+			osmo_store16be(OSMO_MIN(ns * 1000 / period_ns, 1000), cur + 3 + tn * 2);
+			trx_ns += ns;
+		}
+		osmo_store16be(OSMO_MIN(trx_ns * 1000 / period_ns, 1000), cur + 1);
+		total_ns += trx_ns;
+		len += CPU_LOAD_TRX_LEN;
+	}
+
+	permille = OSMO_MIN(total_ns * 1000 / period_ns, 1000);
+	osmo_store16be(1000 - permille, buf);
+
+	return len;
+}
+
+static void load_report_cb(void *data)
 {
 	struct gsm_bts *bts = data;
 	unsigned int pch_percent, rach_percent;
+	uint8_t cpu_load[255];
+	unsigned int cpu_load_len = 0;
 
 	/* It makes no sense to send Load Indication if CCCH is still disabled...*/
 	if (bts->c0->ts[0].mo.nm_state.operational != NM_OPSTATE_ENABLED)
@@ -52,16 +109,20 @@ static void load_timer_cb(void *data)
 		pch_percent = (bts->load.ccch.pch_used * 100) /
 					bts->load.ccch.pch_total;
 
+	/* Osmocom extension: let the BSC prefer the less loaded TRX */
+	if (bts->sched_cpu_acct && bts->sched_cpu_load_ind)
+		cpu_load_len = load_put_cpu_load(bts, cpu_load, sizeof(cpu_load));
+
 	if (pch_percent >= bts->load.ccch.load_ind_thresh) {
 		/* send RSL load indication message to BSC */
 		uint16_t buffer_space = paging_buffer_space(bts->paging_state);
-		rsl_tx_ccch_load_ind_pch(bts, buffer_space);
+		rsl_tx_ccch_load_ind_pch(bts, buffer_space, cpu_load, cpu_load_len);
 	} else {
 		/* This is an extension of TS 08.58.  We don't only
 		 * send load indications if the load is above threshold,
 		 * but we also explicitly indicate that we are below
 		 * threshold by using the magic value 0xffff */
-		rsl_tx_ccch_load_ind_pch(bts, 0xffff);
+		rsl_tx_ccch_load_ind_pch(bts, 0xffff, cpu_load, cpu_load_len);
 	}
 
 	if (bts->load.rach.total == 0)
@@ -79,6 +140,14 @@ static void load_timer_cb(void *data)
 
 retry_later:
 	reset_load_counters(bts);
+}
+
+static void load_timer_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+
+	/* the report itself is low priority work, keep the period steady */
+	slack_task_queue(&bts->load.ccch.task);
 
 	/* re-schedule the timer */
 	osmo_timer_schedule(&bts->load.ccch.timer,
@@ -90,6 +159,7 @@ void load_timer_start(struct gsm_bts *bts)
 	if (!bts->load.ccch.timer.data) {
 		bts->load.ccch.timer.data = bts;
 		bts->load.ccch.timer.cb = load_timer_cb;
+		slack_task_init(&bts->load.ccch.task, "ccch-load-ind", load_report_cb, bts);
 		reset_load_counters(bts);
 	}
 	osmo_timer_schedule(&bts->load.ccch.timer, bts->load.ccch.load_ind_period, 0);
@@ -98,6 +168,7 @@ void load_timer_start(struct gsm_bts *bts)
 void load_timer_stop(struct gsm_bts *bts)
 {
 	osmo_timer_del(&bts->load.ccch.timer);
+	slack_task_cancel(&bts->load.ccch.task);
 }
 
 bool load_timer_is_running(const struct gsm_bts *bts)
@@ -0,0 +1,294 @@
+/* Asynchronous log output from a background thread */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * log_async_start() takes over the output of the stderr and file log
+ * targets.  libosmocore still filters and formats each message in the
+ * calling thread, but instead of writing it there, la_output() only copies
+ * the line into a single-producer / single-consumer ring of that thread.
+ * The writer thread drains all rings periodically with writev(), so that
+ * no syscall is made on the main thread.  If a ring is full, the message
+ * is dropped (see BTS_CTR_LOG_ASYNC_DROP) and the writer notes the number
+ * of dropped messages in the log.
+ *
+ * The arguments are not kept for formatting in the writer thread: many of
+ * them point to static buffers or to objects which are freed right after
+ * the log call (osmo_hexdump(), gsm_lchan_name(), msgb contents, ...).
+ */
+
+#define _GNU_SOURCE /* pthread_setname_np() */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/write_queue.h>
+
+#include <osmo-bts/log_async.h>
+
+#define LA_RING_LEN	1024		/* must be a power of 2 */
+#define LA_LINE_MAX	512		/* longer lines are truncated */
+#define LA_MAX_RINGS	16		/* max. number of logging threads */
+#define LA_BATCH	64		/* max. lines per writev() */
+#define LA_PERIOD_NS	(10 * 1000 * 1000) /* drain the rings every 10 ms */
+
+struct la_slot {
+	int fd;
+	uint16_t len;
+	char buf[LA_LINE_MAX];
+};
+
+struct la_ring {
+	/* head and tail on separate cache lines, to avoid false sharing */
+	uint8_t pad0[64];
+	unsigned int head;	/* written by the logging thread only */
+	uint8_t pad1[64];
+	unsigned int tail;	/* written by the writer thread only */
+	uint8_t pad2[64];
+	unsigned int drops;	/* dropped since the writer last looked */
+	int drop_fd;		/* where to note the dropped messages */
+
+	struct la_slot ring[LA_RING_LEN];
+};
+
+static struct {
+	bool running;
+	pthread_t thread;
+	pthread_t main_thread;
+	struct rate_ctr *drop_ctr;
+
+	struct la_ring *rings[LA_MAX_RINGS];
+	unsigned int num_rings;
+	unsigned int ring_drops;	/* from threads which got no ring */
+
+	/* held while draining: the writer thread and the atexit() handler */
+	pthread_mutex_t drain_lock;
+} la = {
+	.drain_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static __thread struct la_ring *la_tls_ring;
+static __thread bool la_tls_no_ring;
+
+static struct la_ring *la_ring_get(void)
+{
+	struct la_ring *r;
+	unsigned int n;
+
+	if (OSMO_LIKELY(la_tls_ring))
+		return la_tls_ring;
+	if (la_tls_no_ring)
+		return NULL;
+
+	/* first message of this thread: set up its ring (not talloc, which
+	 * must not be used from several threads) */
+	n = __atomic_fetch_add(&la.num_rings, 1, __ATOMIC_RELAXED);
+	if (n >= LA_MAX_RINGS || !(r = calloc(1, sizeof(*r)))) {
+		la_tls_no_ring = true;
+		return NULL;
+	}
+	r->drop_fd = -1;
+	__atomic_store_n(&la.rings[n], r, __ATOMIC_RELEASE);
+	la_tls_ring = r;
+	return r;
+}
+
+static int la_target_fd(const struct log_target *target)
+{
+	if (target->tgt_file.out)
+		return fileno(target->tgt_file.out);
+	if (target->tgt_file.wqueue)
+		return target->tgt_file.wqueue->bfd.fd;
+	return -1;
+}
+
+static void la_output(struct log_target *target, unsigned int level, const char *string)
+{
+	struct la_ring *r = la_ring_get();
+	struct la_slot *slot;
+	unsigned int head;
+	size_t len;
+	int fd;
+
+	fd = la_target_fd(target);
+	if (fd < 0)
+		return;
+
+	if (OSMO_UNLIKELY(!r)) {
+		__atomic_fetch_add(&la.ring_drops, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	head = r->head;
+	if (OSMO_UNLIKELY(head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= LA_RING_LEN)) {
+		r->drop_fd = fd;
+		__atomic_fetch_add(&r->drops, 1, __ATOMIC_RELAXED);
+		/* rate counters are only ever touched by the main thread */
+		if (la.drop_ctr && pthread_equal(pthread_self(), la.main_thread))
+			rate_ctr_inc(la.drop_ctr);
+		return;
+	}
+
+	slot = &r->ring[head & (LA_RING_LEN - 1)];
+	len = strlen(string);
+	if (len > LA_LINE_MAX) {
+		len = LA_LINE_MAX;
+		memcpy(slot->buf, string, LA_LINE_MAX - 1);
+		slot->buf[LA_LINE_MAX - 1] = '\n';
+	} else {
+		memcpy(slot->buf, string, len);
+	}
+	slot->len = len;
+	slot->fd = fd;
+
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void la_note_drops(int fd, unsigned int drops)
+{
+	char buf[64];
+	int len;
+
+	if (fd < 0 || !drops)
+		return;
+	len = snprintf(buf, sizeof(buf), "*** %u log messages dropped ***\n", drops);
+	if (write(fd, buf, len) < 0) {
+		/* nowhere to report this */
+	}
+}
+
+static void la_drain_ring(struct la_ring *r)
+{
+	struct iovec iov[LA_BATCH];
+	unsigned int head, tail, n;
+	int fd;
+
+	la_note_drops(r->drop_fd, __atomic_exchange_n(&r->drops, 0, __ATOMIC_RELAXED));
+
+	tail = r->tail;
+	head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+	while (tail != head) {
+		/* batch up consecutive lines to the same file */
+		fd = r->ring[tail & (LA_RING_LEN - 1)].fd;
+		for (n = 0; n < LA_BATCH && tail + n != head; n++) {
+			struct la_slot *slot = &r->ring[(tail + n) & (LA_RING_LEN - 1)];
+			if (slot->fd != fd)
+				break;
+			iov[n] = (struct iovec) {
+				.iov_base = slot->buf,
+				.iov_len = slot->len,
+			};
+		}
+
+		/* a short write loses (part of) the batch, like a full ring would */
+		if (writev(fd, iov, n) < 0) {
+			/* nowhere to report this */
+		}
+
+		tail += n;
+		__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+	}
+}
+
+static void la_drain(void)
+{
+	unsigned int i, num = OSMO_MIN(__atomic_load_n(&la.num_rings, __ATOMIC_RELAXED), LA_MAX_RINGS);
+	struct la_ring *r;
+
+	pthread_mutex_lock(&la.drain_lock);
+	for (i = 0; i < num; i++) {
+		/* the slot is reserved before the ring is published */
+		r = __atomic_load_n(&la.rings[i], __ATOMIC_ACQUIRE);
+		if (r)
+			la_drain_ring(r);
+	}
+
+	la_note_drops(STDERR_FILENO, __atomic_exchange_n(&la.ring_drops, 0, __ATOMIC_RELAXED));
+	pthread_mutex_unlock(&la.drain_lock);
+}
+
+static void *la_thread(void *arg)
+{
+	const struct timespec period = {
+		.tv_sec = 0,
+		.tv_nsec = LA_PERIOD_NS,
+	};
+
+	while (true) {
+		la_drain();
+		nanosleep(&period, NULL);
+	}
+
+	return NULL;
+}
+
+/* write out whatever is left when the process exits */
+static void la_atexit(void)
+{
+	la_drain();
+}
+
+/*! Move the output of all stderr and file log targets configured so far
+ *  to the log writer thread; targets added later write synchronously.
+ *  \param[in] drop_ctr counter of the messages dropped on the calling
+ *  (main) thread due to a full ring (may be NULL).
+ *  \returns 0 on success; negative on error. */
+int log_async_start(struct rate_ctr *drop_ctr)
+{
+	struct log_target *target;
+	int rc;
+
+	if (la.running)
+		return 0;
+
+	la.main_thread = pthread_self();
+	la.drop_ctr = drop_ctr;
+
+	rc = pthread_create(&la.thread, NULL, la_thread, NULL);
+	if (rc != 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Failed to start the log writer thread: %s\n",
+		     strerror(rc));
+		return -rc;
+	}
+	pthread_setname_np(la.thread, "log-writer");
+	atexit(la_atexit);
+	la.running = true;
+
+	log_tgt_mutex_lock();
+	llist_for_each_entry(target, &osmo_log_target_list, entry) {
+		if (target->type != LOG_TGT_TYPE_STDERR && target->type != LOG_TGT_TYPE_FILE)
+			continue;
+		target->output = la_output;
+	}
+	log_tgt_mutex_unlock();
+
+	LOGP(DLGLOBAL, LOGL_NOTICE, "Writing the stderr/file logs from a background thread\n");
+	return 0;
+}
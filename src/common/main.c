@@ -52,6 +52,8 @@
 #include <osmo-bts/bts_sm.h>
 #include <osmo-bts/vty.h>
 #include <osmo-bts/l1sap.h>
+#include <osmo-bts/gsmtap_writer.h>
+#include <osmo-bts/log_async.h>
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/control_if.h>
@@ -67,6 +69,8 @@ static int rt_prio = -1;
 static char *gsmtap_ip = 0;
 extern int g_vty_port_num;
 static bool vty_test_mode = false;
+static bool mem_lock = false;
+static bool log_async = false;
 
 static void print_help()
 {
@@ -79,6 +83,8 @@ static void print_help()
 		"  -T	--timestamp		Prefix every log line with a timestamp\n"
 		"  -V	--version		Print version information and exit\n"
 		"  -e 	--log-level		Set a global log-level\n"
+		"	--mlockall		Lock the process memory into RAM (like 'memory-lock')\n"
+		"	--log-async		Write the stderr/file logs from a background thread\n"
 		"\nVTY reference generation:\n"
 		"	--vty-ref-mode MODE	VTY reference generation mode (e.g. 'expert').\n"
 		"	--vty-ref-xml		Generate the VTY reference XML output and exit.\n"
@@ -110,6 +116,12 @@ static void handle_long_options(const char *prog_name, const int long_option)
 	case 3:
 		vty_test_mode = true;
 		break;
+	case 4:
+		mem_lock = true;
+		break;
+	case 5:
+		log_async = true;
+		break;
 	default:
 		fprintf(stderr, "%s: error parsing cmdline options\n", prog_name);
 		exit(2);
@@ -148,6 +160,8 @@ static void handle_options(int argc, char **argv)
 			{ "vty-ref-mode", 1, &long_option, 1 },
 			{ "vty-ref-xml", 0, &long_option, 2 },
 			{ "vty-test", 0, &long_option, 3 },
+			{ "mlockall", 0, &long_option, 4 },
+			{ "log-async", 0, &long_option, 5 },
 			{ 0, 0, 0, 0 }
 		};
 
@@ -261,6 +275,7 @@ static void signal_handler(int signum)
 int bts_main(int argc, char **argv)
 {
 	struct gsm_bts_trx *trx;
+	unsigned int i;
 	int rc;
 
 	/* Track the use of talloc NULL memory contexts */
@@ -333,11 +348,30 @@ int bts_main(int argc, char **argv)
 		exit(1);
 	}
 
+	/* Once the config file has set up the log targets */
+	if (log_async && log_async_start(rate_ctr_group_get_ctr(g_bts->ctrs, BTS_CTR_LOG_ASYNC_DROP)) < 0) {
+		fprintf(stderr, "Failed to start the log writer thread\n");
+		exit(1);
+	}
+
 	if (!phy_link_by_num(0)) {
 		fprintf(stderr, "You need to configure at least phy0\n");
 		exit(1);
 	}
 
+	if (bts_hugepages_init(g_bts) < 0) {
+		fprintf(stderr, "Failed to set up the hugepage pool\n");
+		exit(1);
+	}
+
+	/* Lock the memory before the PHY links are opened, see trx_sched_init() */
+	if (mem_lock)
+		g_bts->mem_lock.enabled = true;
+	if (bts_mem_lock(g_bts) < 0) {
+		fprintf(stderr, "Failed to lock the process memory\n");
+		exit(1);
+	}
+
 	llist_for_each_entry(trx, &g_bts->trx_list, list) {
 		if (!trx->pinst) {
 			fprintf(stderr, "TRX %u has no associated PHY instance\n",
@@ -370,6 +404,10 @@ int bts_main(int argc, char **argv)
 			exit(1);
 		}
 		gsmtap_source_add_sink(g_bts->gsmtap.inst);
+
+		/* Send from a background thread, fall back to gsmtap_send() */
+		g_bts->gsmtap.writer = gsmtap_writer_start(g_bts, g_bts->gsmtap.local_host,
+							   g_bts->gsmtap.remote_host, GSMTAP_UDP_PORT);
 	}
 
 	bts_controlif_setup(g_bts, OSMO_CTRL_PORT_BTS);
@@ -384,6 +422,14 @@ int bts_main(int argc, char **argv)
 		fprintf(stderr, "PCU L1 socket failed\n");
 		exit(1);
 	}
+	for (i = 1; i < ARRAY_SIZE(g_bts->pcu.shard_sock_path); i++) {
+		if (g_bts->pcu.shard_sock_path[i] == NULL)
+			continue;
+		if (pcu_sock_init_shard(i, g_bts->pcu.shard_sock_path[i], g_bts->pcu.sock_wqueue_len_max)) {
+			fprintf(stderr, "PCU L1 socket shard %u failed\n", i);
+			exit(1);
+		}
+	}
 
 	signal(SIGINT, &signal_handler);
 	signal(SIGTERM, &signal_handler);
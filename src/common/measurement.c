@@ -4,11 +4,13 @@
 
 #include <osmocom/core/utils.h>
 #include <osmocom/core/endian.h>
+#include <osmocom/core/rate_ctr.h>
 
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/protocol/gsm_44_004.h>
 
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/measurement.h>
 #include <osmo-bts/scheduler.h>
@@ -132,40 +134,39 @@ bool ts45008_83_is_sub(struct gsm_lchan *lchan, uint32_t fn)
  * 6           6 and 7                      78 to 77     90,  12,  38,  64
  * 7                         6 and 7        91 to 90     103, 25,  51,  77
  *
- * Note: The array index of the following three lookup tables refes to a
- *       timeslot number. */
-
-static const uint8_t tchf_meas_rep_fn104_by_ts[] = {
-	[0] =	90,
-	[1] =	103,
-	[2] =	12,
-	[3] =	25,
-	[4] =	38,
-	[5] =	51,
-	[6] =	64,
-	[7] =	77,
-};
-static const uint8_t tchh0_meas_rep_fn104_by_ts[] = {
-	[0] =	90,
-	[1] =	90,
-	[2] =	12,
-	[3] =	12,
-	[4] =	38,
-	[5] =	38,
-	[6] =	64,
-	[7] =	64,
+ * The following lookup table is indexed by the FN modulo 104 of the
+ * measurement indication which completes a reporting period (see the note
+ * below) and tells for which timeslots (TCH/F), or for which timeslots of
+ * each TCH/H subchannel, the reporting period has just ended. */
+
+struct meas_rep_end_mask {
+	uint8_t tchf;		/* bitmask of TCH/F timeslots */
+	uint8_t tchh[2];	/* bitmask of TCH/H timeslots, by subchannel */
 };
-static const uint8_t tchh1_meas_rep_fn104_by_ts[] = {
-	[0] =	103,
-	[1] =	103,
-	[2] =	25,
-	[3] =	25,
-	[4] =	51,
-	[5] =	51,
-	[6] =	77,
-	[7] =	77,
+
+#define TS_MASK(ts) (1 << (ts))
+
+static const struct meas_rep_end_mask tch_meas_rep_end_by_fn104[104] = {
+	/* reporting period 0 to 103 */
+	[12] =	{ .tchf = TS_MASK(0), .tchh = { TS_MASK(0) | TS_MASK(1), 0 } },
+	/* reporting period 13 to 12 */
+	[25] =	{ .tchf = TS_MASK(1), .tchh = { 0, TS_MASK(0) | TS_MASK(1) } },
+	/* reporting period 26 to 25 */
+	[38] =	{ .tchf = TS_MASK(2), .tchh = { TS_MASK(2) | TS_MASK(3), 0 } },
+	/* reporting period 39 to 38 */
+	[51] =	{ .tchf = TS_MASK(3), .tchh = { 0, TS_MASK(2) | TS_MASK(3) } },
+	/* reporting period 52 to 51 */
+	[64] =	{ .tchf = TS_MASK(4), .tchh = { TS_MASK(4) | TS_MASK(5), 0 } },
+	/* reporting period 65 to 64 */
+	[77] =	{ .tchf = TS_MASK(5), .tchh = { 0, TS_MASK(4) | TS_MASK(5) } },
+	/* reporting period 78 to 77 */
+	[90] =	{ .tchf = TS_MASK(6), .tchh = { TS_MASK(6) | TS_MASK(7), 0 } },
+	/* reporting period 91 to 90 */
+	[103] =	{ .tchf = TS_MASK(7), .tchh = { 0, TS_MASK(6) | TS_MASK(7) } },
 };
 
+#undef TS_MASK
+
 /* Measurement reporting period for SDCCH8 and SDCCH4 chan
  * As per in 3GPP TS 45.008, section 8.4.2.
  *
@@ -210,35 +211,8 @@ static const uint8_t sdcch4_meas_rep_fn102_by_ss[] = {
  * will have to look at 3GPP TS 45.008, section 8.4.1 (or 3GPP TS 05.02 Clause 7
  * Table 1 of 9) what value we need to feed into the lookup tables in order to
  * detect the measurement period ending. In this example the "real" ending
- * was on FN%104=12. This is the value we have to look for in
- * tchf_meas_rep_fn104_by_ts to know that a measurement period has just ended. */
-
-/* See also 3GPP TS 05.02 Clause 7 Table 1 of 9:
- * Mapping of logical channels onto physical channels (see subclauses 6.3, 6.4, 6.5) */
-static uint8_t translate_tch_meas_rep_fn104(uint8_t fn_mod)
-{
-	switch (fn_mod) {
-	case 25:
-		return 103;
-	case 38:
-		return 12;
-	case 51:
-		return 25;
-	case 64:
-		return 38;
-	case 77:
-		return 51;
-	case 90:
-		return 64;
-	case 103:
-		return 77;
-	case 12:
-		return 90;
-	}
-
-	/* Invalid / not of interest */
-	return 0;
-}
+ * was on FN%104=12 (SACCH message block 12 in the table above), which is why
+ * tch_meas_rep_end_by_fn104[38] has the bit of TS=2 set. */
 
 /* determine if a measurement period ends at the given frame number
  * (this function is only used internally, it is public to call it from
@@ -246,23 +220,21 @@ static uint8_t translate_tch_meas_rep_fn104(uint8_t fn_mod)
 int is_meas_complete(struct gsm_lchan *lchan, uint32_t fn)
 {
 	unsigned int fn_mod = -1;
-	const uint8_t *tbl;
+	const struct meas_rep_end_mask *mask;
 	int rc = 0;
 	enum gsm_phys_chan_config pchan = ts_pchan(lchan->ts);
 
 	switch (pchan) {
 	case GSM_PCHAN_TCH_F:
-		fn_mod = translate_tch_meas_rep_fn104(fn % 104);
-		if (tchf_meas_rep_fn104_by_ts[lchan->ts->nr] == fn_mod)
+		fn_mod = fn % 104;
+		mask = &tch_meas_rep_end_by_fn104[fn_mod];
+		if (mask->tchf & (1 << lchan->ts->nr))
 			rc = 1;
 		break;
 	case GSM_PCHAN_TCH_H:
-		fn_mod = translate_tch_meas_rep_fn104(fn % 104);
-		if (lchan->nr == 0)
-			tbl = tchh0_meas_rep_fn104_by_ts;
-		else
-			tbl = tchh1_meas_rep_fn104_by_ts;
-		if (tbl[lchan->ts->nr] == fn_mod)
+		fn_mod = fn % 104;
+		mask = &tch_meas_rep_end_by_fn104[fn_mod];
+		if (mask->tchh[lchan->nr & 1] & (1 << lchan->ts->nr))
 			rc = 1;
 		break;
 	case GSM_PCHAN_SDCCH8_SACCH8C:
@@ -310,6 +282,66 @@ static uint8_t modulus_by_lchan(struct gsm_lchan *lchan)
 	}
 }
 
+static unsigned int lchan_meas_num_expected(const struct gsm_lchan *lchan);
+
+/* add a single measurement sample to the running sums */
+static void ul_meas_acc_add(struct bts_ul_meas_acc *acc, const struct bts_ul_meas *m)
+{
+	if (acc->num == 0) {
+		acc->toa256_min = m->ta_offs_256bits;
+		acc->toa256_max = m->ta_offs_256bits;
+	} else {
+		acc->toa256_min = OSMO_MIN(acc->toa256_min, m->ta_offs_256bits);
+		acc->toa256_max = OSMO_MAX(acc->toa256_max, m->ta_offs_256bits);
+	}
+
+	if (m->is_sub) {
+		acc->ber10k_sub_sum += m->ber10k;
+		acc->inv_rssi_sub_sum += m->inv_rssi;
+		acc->ci_cb_sub_sum += m->ci_cb;
+		acc->num_sub++;
+	}
+	acc->ber10k_sum += m->ber10k;
+	acc->inv_rssi_sum += m->inv_rssi;
+	acc->ci_cb_sum += m->ci_cb;
+	acc->toa256_sum += m->ta_offs_256bits;
+	acc->toa256_sq_sum += (int32_t)m->ta_offs_256bits * m->ta_offs_256bits;
+	acc->num++;
+}
+
+/* add 'num' samples of the previous period to the running sums.  The
+ * individual samples are gone, so the newest 'num' of them are approximated
+ * by the average of the previous period (exact if they were all equal). */
+static void ul_meas_acc_add_prev(struct bts_ul_meas_acc *acc,
+				 const struct bts_ul_meas_acc *prev,
+				 unsigned int num)
+{
+	num = OSMO_MIN(num, prev->num);
+	if (num == 0)
+		return;
+
+#define SCALE(x) ((x) * (int64_t)num / prev->num)
+	if (acc->num == 0) {
+		acc->toa256_min = prev->toa256_min;
+		acc->toa256_max = prev->toa256_max;
+	} else {
+		acc->toa256_min = OSMO_MIN(acc->toa256_min, prev->toa256_min);
+		acc->toa256_max = OSMO_MAX(acc->toa256_max, prev->toa256_max);
+	}
+
+	acc->num_sub += SCALE(prev->num_sub);
+	acc->ber10k_sub_sum += SCALE(prev->ber10k_sub_sum);
+	acc->inv_rssi_sub_sum += SCALE(prev->inv_rssi_sub_sum);
+	acc->ci_cb_sub_sum += SCALE(prev->ci_cb_sub_sum);
+	acc->ber10k_sum += SCALE(prev->ber10k_sum);
+	acc->inv_rssi_sum += SCALE(prev->inv_rssi_sum);
+	acc->ci_cb_sum += SCALE(prev->ci_cb_sum);
+	acc->toa256_sum += SCALE(prev->toa256_sum);
+	acc->toa256_sq_sum += prev->toa256_sq_sum * num / prev->num;
+	acc->num += num;
+#undef SCALE
+}
+
 /* receive a L1 uplink measurement from L1 (this function is only used
  * internally, it is public to call it from unit-tests)  */
 int lchan_new_ul_meas(struct gsm_lchan *lchan,
@@ -317,7 +349,7 @@ int lchan_new_ul_meas(struct gsm_lchan *lchan,
 		      uint32_t fn)
 {
 	uint32_t fn_mod = fn % modulus_by_lchan(lchan);
-	struct bts_ul_meas *dest;
+	struct bts_ul_meas m = *ulm;
 
 	if (lchan->state != LCHAN_S_ACTIVE) {
 		LOGPLCFN(lchan, fn, DMEAS, LOGL_NOTICE,
@@ -325,24 +357,33 @@ int lchan_new_ul_meas(struct gsm_lchan *lchan,
 			 gsm_lchans_name(lchan->state), lchan->meas.num_ul_meas, fn_mod);
 	}
 
-	if (lchan->meas.num_ul_meas >= ARRAY_SIZE(lchan->meas.uplink)) {
+	if (lchan->meas.num_ul_meas >= MAX_NUM_UL_MEAS) {
 		LOGPLCFN(lchan, fn, DMEAS, LOGL_NOTICE,
 			 "no space for uplink measurement, num_ul_meas=%d, fn_mod=%u\n", lchan->meas.num_ul_meas,
 			 fn_mod);
 		return -ENOSPC;
 	}
 
-	dest = &lchan->meas.uplink[lchan->meas.num_ul_meas++];
-	memcpy(dest, ulm, sizeof(*ulm));
+	lchan->meas.num_ul_meas++;
 
 	/* We expect the lower layers to mark AMR SID_UPDATE frames already as such.
 	 * In this function, we only deal with the common logic as per the TS 45.008 tables */
 	if (!ulm->is_sub)
-		dest->is_sub = ts45008_83_is_sub(lchan, fn);
+		m.is_sub = ts45008_83_is_sub(lchan, fn);
+
+	/* If the computation at the end of the previous period was not
+	 * executed, only the last period shall be taken into account.
+	 * Keep the sums of the previous period, in case this one is not
+	 * complete when the computation finally happens. */
+	if (lchan->meas.ul_acc.num >= lchan_meas_num_expected(lchan)) {
+		lchan->meas.ul_acc_prev = lchan->meas.ul_acc;
+		memset(&lchan->meas.ul_acc, 0, sizeof(lchan->meas.ul_acc));
+	}
+	ul_meas_acc_add(&lchan->meas.ul_acc, &m);
 
 	LOGPLCFN(lchan, fn, DMEAS, LOGL_DEBUG,
 		 "adding a %s measurement (ber10k=%u, ta_offs=%d, ci_cB=%d, rssi=-%u), num_ul_meas=%d, fn_mod=%u\n",
-		 dest->is_sub ? "SUB" : "FULL", ulm->ber10k, ulm->ta_offs_256bits, ulm->ci_cb, ulm->inv_rssi,
+		 m.is_sub ? "SUB" : "FULL", ulm->ber10k, ulm->ta_offs_256bits, ulm->ci_cb, ulm->inv_rssi,
 		 lchan->meas.num_ul_meas, fn_mod);
 
 	lchan->meas.last_fn = fn;
@@ -471,19 +512,13 @@ static unsigned int lchan_meas_sub_num_expected(const struct gsm_lchan *lchan)
  */
 
 /* compute Osmocom extended measurements for the given lchan */
-static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
+static void lchan_meas_compute_extended(struct gsm_lchan *lchan,
+					const struct bts_ul_meas_acc *acc)
 {
-	unsigned int num_ul_meas;
-	unsigned int num_ul_meas_excess = 0;
-        unsigned int num_ul_meas_expect;
-
 	/* we assume that lchan_meas_check_compute() has already computed the mean value
-	 * and we can compute the min/max/variance/stddev from this */
-	int i;
-
-	/* each measurement is an int32_t, so the squared difference value must fit in 32bits */
-	/* the sum of the squared values (each up to 32bit) can very easily exceed 32 bits */
-	uint64_t sq_diff_sum = 0;
+	 * and we can compute the variance/stddev from this */
+	int64_t mean = lchan->meas.ms_toa256;
+	int64_t sq_diff_sum;
 
 	/* In case we do not have any measurement values collected there is no
 	 * computation possible. We just skip the whole computation here, the
@@ -492,55 +527,34 @@ static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
 	 * this is ok, since we have nothing to report anyway and apart of that
 	 * we also just lost the signal (otherwise we would have at least some
 	 * measurements). */
-	if (!lchan->meas.num_ul_meas)
+	if (!acc->num)
 		return;
 
-	/* initialize min/max values with their counterpart */
-	lchan->meas.ext.toa256_min = INT16_MAX;
-	lchan->meas.ext.toa256_max = INT16_MIN;
-
-	/* Determine the number of measurement values we need to take into the
-	 * computation. In this case we only compute over the measurements we
-	 * have indeed received. Since this computation is about timing
-	 * information it does not make sense to approach missing measurement
-	 * samples the TOA with 0. This would bend the average towards 0. What
-	 * counts is the average TOA of the properly received blocks so that
-	 * the TA logic can make a proper decision. */
-        num_ul_meas_expect = lchan_meas_num_expected(lchan);
-	if (lchan->meas.num_ul_meas > num_ul_meas_expect) {
-		num_ul_meas = num_ul_meas_expect;
-		num_ul_meas_excess = lchan->meas.num_ul_meas - num_ul_meas_expect;
-	}
-	else
-		num_ul_meas = lchan->meas.num_ul_meas;
+	/* The computation is done only over the measurements we have indeed
+	 * received (the last measurement period, see lchan_new_ul_meas()).
+	 * Since this computation is about timing information it does not make
+	 * sense to approach missing measurement samples the TOA with 0. This
+	 * would bend the average towards 0. What counts is the average TOA of
+	 * the properly received blocks so that the TA logic can make a proper
+	 * decision. */
+	lchan->meas.ext.toa256_min = acc->toa256_min;
+	lchan->meas.ext.toa256_max = acc->toa256_max;
 
 	/* all computations are done on the relative arrival time of the burst, relative to the
 	 * beginning of its slot. This is of course excluding the TA value that the MS has already
 	 * compensated/pre-empted its transmission */
 
-	/* step 1: compute the sum of the squared difference of each value to mean */
-	for (i = 0; i < num_ul_meas; i++) {
-		const struct bts_ul_meas *m;
-
-		OSMO_ASSERT(i < lchan->meas.num_ul_meas);
-		m = &lchan->meas.uplink[i+num_ul_meas_excess];
-
-		int32_t diff = (int32_t)m->ta_offs_256bits - (int32_t)lchan->meas.ms_toa256;
-		/* diff can now be any value of +65535 to -65535, so we can safely square it,
-		 * but only in unsigned math.  As squaring looses the sign, we can simply drop
-		 * it before squaring, too. */
-		uint32_t diff_abs = labs(diff);
-		uint32_t diff_squared = diff_abs * diff_abs;
-		sq_diff_sum += diff_squared;
-
-		/* also use this loop iteration to compute min/max values */
-		if (m->ta_offs_256bits > lchan->meas.ext.toa256_max)
-			lchan->meas.ext.toa256_max = m->ta_offs_256bits;
-		if (m->ta_offs_256bits < lchan->meas.ext.toa256_min)
-			lchan->meas.ext.toa256_min = m->ta_offs_256bits;
-	}
+	/* step 1: compute the sum of the squared difference of each value to mean,
+	 * sum((x - mean)^2) = sum(x^2) - 2 * mean * sum(x) + num * mean^2.  Each
+	 * toa256 is an int16_t, so all terms fit into 64 bits and this is exact. */
+	sq_diff_sum = (int64_t)acc->toa256_sq_sum - 2 * mean * acc->toa256_sum
+		      + acc->num * mean * mean;
+	/* (can only be negative due to rounding of the previous period, see
+	 * ul_meas_acc_add_prev()) */
+	if (sq_diff_sum < 0)
+		sq_diff_sum = 0;
 	/* step 2: compute the variance (mean of sum of squared differences) */
-	sq_diff_sum = sq_diff_sum / num_ul_meas;
+	sq_diff_sum = sq_diff_sum / acc->num;
 	/* as the individual summed values can each not exceed 2^32, and we're
 	 * dividing by the number of summands, the resulting value can also not exceed 2^32 */
 	OSMO_ASSERT(sq_diff_sum <= UINT32_MAX);
@@ -552,23 +566,23 @@ static void lchan_meas_compute_extended(struct gsm_lchan *lchan)
 int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 {
 	struct gsm_meas_rep_unidir *mru;
-	uint32_t ber_full_sum = 0;
-	uint32_t irssi_full_sum = 0;
-	int32_t ci_full_sum = 0;
-	uint32_t ber_sub_sum = 0;
-	uint32_t irssi_sub_sum = 0;
-	int32_t ci_sub_sum = 0;
-	int32_t ta256b_sum = 0;
-	unsigned int num_meas_sub = 0;
-	unsigned int num_meas_sub_actual = 0;
+	struct bts_ul_meas_acc acc;
+	uint32_t ber_full_sum;
+	uint32_t irssi_full_sum;
+	int32_t ci_full_sum;
+	uint32_t ber_sub_sum;
+	uint32_t irssi_sub_sum;
+	int32_t ci_sub_sum;
+	int32_t ta256b_sum;
+	unsigned int num_meas_sub;
+	unsigned int num_meas_sub_actual;
 	unsigned int num_meas_sub_subst = 0;
 	unsigned int num_meas_sub_expect;
 	unsigned int num_ul_meas;
-	unsigned int num_ul_meas_actual = 0;
+	unsigned int num_ul_meas_actual;
 	unsigned int num_ul_meas_subst = 0;
 	unsigned int num_ul_meas_expect;
 	unsigned int num_ul_meas_excess = 0;
-	int i;
 
 	/* if measurement period is not complete, abort */
 	if (!is_meas_complete(lchan, fn))
@@ -593,9 +607,15 @@ int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 		num_meas_sub_expect = 1;
 	}
 
-	if (lchan->meas.num_ul_meas > num_ul_meas_expect)
+	acc = lchan->meas.ul_acc;
+	if (lchan->meas.num_ul_meas > num_ul_meas_expect) {
 		num_ul_meas_excess = lchan->meas.num_ul_meas - num_ul_meas_expect;
-	num_ul_meas = num_ul_meas_expect;
+		/* fill up the current period with the newest part of the previous one */
+		if (acc.num < num_ul_meas_expect)
+			ul_meas_acc_add_prev(&acc, &lchan->meas.ul_acc_prev,
+					     num_ul_meas_expect - acc.num);
+	}
+	num_ul_meas = OSMO_MAX(num_ul_meas_expect, acc.num);
 
 	LOGPLCHAN(lchan, DMEAS, LOGL_DEBUG, "Received %u UL measurements, expected %u\n",
 		  lchan->meas.num_ul_meas, num_ul_meas_expect);
@@ -604,58 +624,40 @@ int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 			  num_ul_meas_excess);
 
 	/* Measurement computation step 1: add up */
-	for (i = 0; i < num_ul_meas; i++) {
-		const struct bts_ul_meas *m;
-		bool is_sub = false;
-
-		/* Note: We will always compute over a full measurement,
-		 * interval even when not enough measurement samples are in
-		 * the buffer. As soon as we run out of measurement values
-		 * we continue the calculation using dummy values. This works
-		 * well for the BER, since there we can safely assume 100%
-		 * since a missing measurement means that the data (block)
-		 * is lost as well (some phys do not give us measurement
-		 * reports for lost blocks or blocks that are spaced out for
-		 * DTX). However, for RSSI and TA this does not work since
-		 * there we would distort the calculation if we would replace
-		 * them with a made up number. This means for those values we
-		 * only compute over the data we have actually received. */
-
-		if (i < lchan->meas.num_ul_meas) {
-			m = &lchan->meas.uplink[i + num_ul_meas_excess];
-			if (m->is_sub) {
-				irssi_sub_sum += m->inv_rssi;
-				ci_sub_sum += m->ci_cb;
-				num_meas_sub_actual++;
-				is_sub = true;
-			}
-			irssi_full_sum += m->inv_rssi;
-			ta256b_sum += m->ta_offs_256bits;
-			ci_full_sum += m->ci_cb;
-
-			num_ul_meas_actual++;
-		} else {
-			m = &measurement_dummy;
-
-			/* For AMR the amount of SUB frames is defined by the
-			 * the occurrence of DTX periods, which are dynamically
-			 * negotiated in AMR, so we can not know if and how many
-			 * SUB frames are missing. */
-			if (lchan->tch_mode != GSM48_CMODE_SPEECH_AMR) {
-				if (num_meas_sub <= i) {
-					num_meas_sub_subst++;
-					is_sub = true;
-				}
-			}
-
-			num_ul_meas_subst++;
-		}
-
-		ber_full_sum += m->ber10k;
-		if (is_sub) {
-			num_meas_sub++;
-			ber_sub_sum += m->ber10k;
-		}
+	num_ul_meas_actual = acc.num;
+	num_meas_sub_actual = acc.num_sub;
+	num_meas_sub = acc.num_sub;
+	ber_full_sum = acc.ber10k_sum;
+	ber_sub_sum = acc.ber10k_sub_sum;
+	irssi_full_sum = acc.inv_rssi_sum;
+	irssi_sub_sum = acc.inv_rssi_sub_sum;
+	ci_full_sum = acc.ci_cb_sum;
+	ci_sub_sum = acc.ci_cb_sub_sum;
+	ta256b_sum = acc.toa256_sum;
+
+	/* Note: We will always compute over a full measurement,
+	 * interval even when not enough measurement samples are in
+	 * the buffer. As soon as we run out of measurement values
+	 * we continue the calculation using dummy values. This works
+	 * well for the BER, since there we can safely assume 100%
+	 * since a missing measurement means that the data (block)
+	 * is lost as well (some phys do not give us measurement
+	 * reports for lost blocks or blocks that are spaced out for
+	 * DTX). However, for RSSI and TA this does not work since
+	 * there we would distort the calculation if we would replace
+	 * them with a made up number. This means for those values we
+	 * only compute over the data we have actually received. */
+	num_ul_meas_subst = num_ul_meas - num_ul_meas_actual;
+	ber_full_sum += num_ul_meas_subst * measurement_dummy.ber10k;
+
+	/* For AMR the amount of SUB frames is defined by the
+	 * the occurrence of DTX periods, which are dynamically
+	 * negotiated in AMR, so we can not know if and how many
+	 * SUB frames are missing. */
+	if (lchan->tch_mode != GSM48_CMODE_SPEECH_AMR) {
+		num_meas_sub_subst = num_ul_meas_subst;
+		num_meas_sub += num_meas_sub_subst;
+		ber_sub_sum += num_meas_sub_subst * measurement_dummy.ber10k;
 	}
 
 	if (lchan->tch_mode != GSM48_CMODE_SPEECH_AMR) {
@@ -746,9 +748,11 @@ int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 
 	lchan->meas.flags |= LC_UL_M_F_RES_VALID;
 
-	lchan_meas_compute_extended(lchan);
+	lchan_meas_compute_extended(lchan, &acc);
 
 	lchan->meas.num_ul_meas = 0;
+	memset(&lchan->meas.ul_acc, 0, sizeof(lchan->meas.ul_acc));
+	memset(&lchan->meas.ul_acc_prev, 0, sizeof(lchan->meas.ul_acc_prev));
 
 	/* return 1 to indicate that the computation has been done and the next
 	 * interval begins. */
@@ -786,6 +790,17 @@ static inline bool ms_to_valid(const struct gsm_lchan *lchan)
 	return (lchan->ms_t_offs >= 0) || (lchan->p_offs >= 0);
 }
 
+/* The decisions below are taken once per SACCH period, the scheduler and
+ * l1sap only look at the resulting flags in lchan->rep_acch and
+ * lchan->top_acch_active.  Count the periods during which they are set. */
+static void acch_count_active(const struct gsm_lchan *lchan, unsigned int ctr)
+{
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+
+	if (bts->ctrs != NULL)
+		rate_ctr_inc2(bts->ctrs, ctr);
+}
+
 /* Decide if repeated FACCH should be applied or not. If RXQUAL level, that the
  * MS reports is high enough, FACCH repetition is not needed. */
 static void repeated_dl_facch_active_decision(struct gsm_lchan *lchan,
@@ -847,6 +862,8 @@ static void repeated_dl_facch_active_decision(struct gsm_lchan *lchan,
 		lchan->rep_acch.dl_facch_active = false;
 
 out:
+	if (lchan->rep_acch.dl_facch_active)
+		acch_count_active(lchan, BTS_CTR_ACCH_REP_DL_FACCH);
 	if (lchan->rep_acch.dl_facch_active == prev_repeated_dl_facch_active)
 		return;
 	if (lchan->rep_acch.dl_facch_active)
@@ -866,7 +883,7 @@ static void acch_overpower_active_decision(struct gsm_lchan *lchan,
 		return;
 	/* RxQual threshold is disabled => overpower is always on */
 	if (lchan->top_acch_cap.rxqual == 0)
-		return;
+		goto out;
 
 	/* If DTx is active on Downlink, use the '-SUB' */
 	if (meas_res->dtx_used)
@@ -890,6 +907,10 @@ static void acch_overpower_active_decision(struct gsm_lchan *lchan,
 			  lchan->top_acch_active ? "inactive => active"
 						  : "active => inactive");
 	}
+
+out:
+	if (lchan->top_acch_active)
+		acch_count_active(lchan, BTS_CTR_ACCH_OVERPOWER);
 }
 
 static bool data_is_rr_meas_rep(const uint8_t *data)
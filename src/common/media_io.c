@@ -0,0 +1,325 @@
+/* Receiving RTP in a background thread */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Without the media thread, the TCH RTS handler polls the RTP socket of
+ * every lchan every 20 ms, one recvmsg() each, no matter whether a packet
+ * arrived.  With it, a single thread waits for all RTP sockets in one
+ * epoll set and reads whatever arrived with recvmmsg() straight into a
+ * single-producer / single-consumer ring per socket.  The TCH RTS handler
+ * then only parses the RTP header of the queued packets and hands the
+ * payload to l1sap_rtp_rx_cb(), as osmo_rtp_socket_poll() would.
+ *
+ * The thread never touches the lchan nor the RTP session, so there is no
+ * locking on the data path.  The mutex only orders the removal of a socket
+ * against the thread: a removed channel is freed by the thread once the
+ * events it may still hold for it are processed.  Channels are allocated
+ * with calloc(), as talloc is not thread-safe.
+ */
+
+#define _GNU_SOURCE /* recvmmsg(), pthread_setname_np() */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/media_io.h>
+
+#define MIO_RING_LEN	16		/* packets per socket, must be a power of 2 */
+#define MIO_PKT_MAX	256		/* RTP header + payload (CSD: 160 octets) */
+#define MIO_BATCH	8		/* max. packets per recvmmsg() */
+#define MIO_EVENTS	64		/* max. ready sockets per epoll_wait() */
+#define MIO_WAIT_MS	100		/* free removed channels at least this often */
+
+struct mio_slot {
+	uint16_t len;
+	uint8_t buf[MIO_PKT_MAX];
+};
+
+struct media_io_chan {
+	int fd;
+	bool deleted;			/* protected by media_io.lock */
+	struct media_io_chan *gc_next;
+
+	/* head and tail on separate cache lines, to avoid false sharing */
+	uint8_t pad0[64];
+	unsigned int head;		/* written by the media thread only */
+	uint32_t drops;			/* written by the media thread only */
+	uint8_t pad1[64];
+	unsigned int tail;		/* written by the main thread only */
+	uint8_t pad2[64];
+
+	/* main thread only */
+	uint32_t drops_seen;
+	struct media_io_chan_stats stats;
+	bool seq_valid;
+	uint32_t seq_base;
+	uint32_t seq_max;		/* extended highest sequence number */
+
+	struct mio_slot ring[MIO_RING_LEN];
+};
+
+struct media_io {
+	int epfd;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct media_io_chan *gc;	/* removed channels, protected by lock */
+};
+
+/* read everything the ring has room for, drop the rest */
+static void mio_chan_rx(struct media_io_chan *mc)
+{
+	struct mmsghdr msgs[MIO_BATCH];
+	struct iovec iov[MIO_BATCH];
+	unsigned int head = mc->head;
+	unsigned int room, n, i;
+	uint8_t scratch[MIO_PKT_MAX];
+	int rc;
+
+	room = MIO_RING_LEN - (head - __atomic_load_n(&mc->tail, __ATOMIC_ACQUIRE));
+	if (room == 0) {
+		while (recv(mc->fd, scratch, sizeof(scratch), MSG_DONTWAIT) >= 0)
+			__atomic_store_n(&mc->drops, mc->drops + 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	n = OSMO_MIN(room, MIO_BATCH);
+	for (i = 0; i < n; i++) {
+		struct mio_slot *slot = &mc->ring[(head + i) & (MIO_RING_LEN - 1)];
+
+		iov[i] = (struct iovec) {
+			.iov_base = slot->buf,
+			.iov_len = sizeof(slot->buf),
+		};
+		msgs[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+			},
+		};
+	}
+
+	rc = recvmmsg(mc->fd, msgs, n, MSG_DONTWAIT, NULL);
+	if (rc <= 0)
+		return;
+
+	for (i = 0; i < rc; i++)
+		mc->ring[(head + i) & (MIO_RING_LEN - 1)].len = msgs[i].msg_len;
+	__atomic_store_n(&mc->head, head + rc, __ATOMIC_RELEASE);
+}
+
+static void *mio_thread(void *arg)
+{
+	struct media_io *mio = arg;
+	struct epoll_event ev[MIO_EVENTS];
+	struct media_io_chan *mc;
+	int n, i;
+
+	while (true) {
+		n = epoll_wait(mio->epfd, ev, ARRAY_SIZE(ev), MIO_WAIT_MS);
+
+		pthread_mutex_lock(&mio->lock);
+		for (i = 0; i < n; i++) {
+			mc = ev[i].data.ptr;
+			if (!mc->deleted)
+				mio_chan_rx(mc);
+		}
+		/* no event refers to them anymore */
+		while ((mc = mio->gc) != NULL) {
+			mio->gc = mc->gc_next;
+			free(mc);
+		}
+		pthread_mutex_unlock(&mio->lock);
+	}
+
+	return NULL;
+}
+
+/*! Start the media I/O thread.
+ *  \param[in] ctx talloc context to allocate from.
+ *  \returns media I/O state on success; NULL on error. */
+struct media_io *media_io_start(void *ctx)
+{
+	struct media_io *mio;
+	int rc;
+
+	mio = talloc_zero(ctx, struct media_io);
+	if (mio == NULL)
+		return NULL;
+
+	mio->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (mio->epfd < 0) {
+		LOGP(DRTP, LOGL_ERROR, "Failed to create the media I/O epoll set: %s\n",
+		     strerror(errno));
+		talloc_free(mio);
+		return NULL;
+	}
+	pthread_mutex_init(&mio->lock, NULL);
+
+	rc = pthread_create(&mio->thread, NULL, mio_thread, mio);
+	if (rc != 0) {
+		LOGP(DRTP, LOGL_ERROR, "Failed to start the media I/O thread: %s\n", strerror(rc));
+		close(mio->epfd);
+		talloc_free(mio);
+		return NULL;
+	}
+	pthread_setname_np(mio->thread, "media-io");
+
+	return mio;
+}
+
+/*! Receive the RTP packets of socket \a fd in the media I/O thread.
+ *  \returns the receive channel; NULL on error. */
+struct media_io_chan *media_io_chan_add(struct media_io *mio, int fd)
+{
+	struct media_io_chan *mc;
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+	};
+
+	mc = calloc(1, sizeof(*mc));
+	if (mc == NULL)
+		return NULL;
+	mc->fd = fd;
+
+	ev.data.ptr = mc;
+	if (epoll_ctl(mio->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		LOGP(DRTP, LOGL_ERROR, "Failed to add RTP socket %d to the media I/O thread: %s\n",
+		     fd, strerror(errno));
+		free(mc);
+		return NULL;
+	}
+
+	return mc;
+}
+
+/*! Stop receiving; must be called before the socket is closed */
+void media_io_chan_del(struct media_io *mio, struct media_io_chan *mc)
+{
+	pthread_mutex_lock(&mio->lock);
+	epoll_ctl(mio->epfd, EPOLL_CTL_DEL, mc->fd, NULL);
+	mc->deleted = true;
+	mc->gc_next = mio->gc;
+	mio->gc = mc;
+	pthread_mutex_unlock(&mio->lock);
+}
+
+/* parse an RTP header (RFC 3550, 5.1), account the sequence number
+ * \returns length of the payload at *pl; negative if invalid */
+static int mio_rtp_parse(struct media_io_chan *mc, const uint8_t *buf, unsigned int len,
+			 const uint8_t **pl, uint16_t *seq, uint32_t *ts, bool *marker)
+{
+	unsigned int hdr_len, pad_len = 0;
+	int16_t delta;
+
+	if (len < 12 || (buf[0] >> 6) != 2)
+		return -EINVAL;
+
+	hdr_len = 12 + 4 * (buf[0] & 0x0f);
+	if (buf[0] & 0x10) {
+		if (len < hdr_len + 4)
+			return -EINVAL;
+		hdr_len += 4 + 4 * osmo_load16be(buf + hdr_len + 2);
+	}
+	if (buf[0] & 0x20)
+		pad_len = buf[len - 1];
+	if (len < hdr_len + pad_len)
+		return -EINVAL;
+
+	*pl = buf + hdr_len;
+	*marker = buf[1] & 0x80;
+	*seq = osmo_load16be(buf + 2);
+	*ts = osmo_load32be(buf + 4);
+
+	if (!mc->seq_valid) {
+		mc->seq_valid = true;
+		mc->seq_base = *seq;
+		mc->seq_max = *seq;
+	} else {
+		delta = (int16_t) (*seq - (uint16_t) mc->seq_max);
+		if (delta > 0)
+			mc->seq_max += delta;
+	}
+
+	return len - hdr_len - pad_len;
+}
+
+/*! Hand the RTP packets received since the last poll to \a cb (main thread).
+ *  \param[out] new_drops packets dropped by the thread since the last poll
+ *  \returns number of packets handed to \a cb */
+unsigned int media_io_chan_poll(struct media_io_chan *mc, media_io_rx_cb cb, void *priv,
+				uint32_t *new_drops)
+{
+	unsigned int tail = mc->tail;
+	unsigned int head = __atomic_load_n(&mc->head, __ATOMIC_ACQUIRE);
+	struct media_io_chan_stats *st = &mc->stats;
+	uint32_t drops = __atomic_load_n(&mc->drops, __ATOMIC_RELAXED);
+	unsigned int num = 0;
+	const uint8_t *pl;
+	uint32_t ts;
+	uint16_t seq;
+	bool marker;
+	int pl_len;
+
+	if (head - tail > st->depth_max)
+		st->depth_max = head - tail;
+	*new_drops = drops - mc->drops_seen;
+	mc->drops_seen = drops;
+	st->drops = drops;
+
+	for (; tail != head; tail++) {
+		const struct mio_slot *slot = &mc->ring[tail & (MIO_RING_LEN - 1)];
+
+		pl_len = mio_rtp_parse(mc, slot->buf, slot->len, &pl, &seq, &ts, &marker);
+		if (pl_len < 0)
+			continue;
+		st->packets++;
+		st->octets += pl_len;
+		cb(priv, pl, pl_len, seq, ts, marker);
+		num++;
+	}
+	__atomic_store_n(&mc->tail, tail, __ATOMIC_RELEASE);
+
+	return num;
+}
+
+void media_io_chan_stats(const struct media_io_chan *mc, struct media_io_chan_stats *st)
+{
+	uint32_t expected;
+
+	*st = mc->stats;
+	st->depth = __atomic_load_n(&mc->head, __ATOMIC_ACQUIRE) - mc->tail;
+	if (mc->seq_valid) {
+		expected = mc->seq_max - mc->seq_base + 1;
+		st->lost = expected > st->packets ? expected - st->packets : 0;
+	}
+}
@@ -0,0 +1,206 @@
+/* Sensor supervision core shared by the BTS management daemons */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: AGPL-3.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/mgr_sensor.h>
+
+static const struct value_string state_names[] = {
+	{ STATE_NORMAL,			"NORMAL" },
+	{ STATE_WARNING_HYST,		"WARNING (HYST)" },
+	{ STATE_WARNING,		"WARNING" },
+	{ STATE_CRITICAL,		"CRITICAL" },
+	{ 0, NULL }
+};
+
+const char *mgr_sensor_state_name(enum mgr_sensor_state state)
+{
+	return get_value_string(state_names, state);
+}
+
+/*! Compute the state following \a current_state.
+ *  \returns the new state; -1 if the state does not change. */
+int mgr_sensor_next_state(enum mgr_sensor_state current_state, int critical, int warning)
+{
+	int next_state = -1;
+	switch (current_state) {
+	case STATE_NORMAL:
+		if (critical)
+			next_state = STATE_CRITICAL;
+		else if (warning)
+			next_state = STATE_WARNING;
+		break;
+	case STATE_WARNING_HYST:
+		if (critical)
+			next_state = STATE_CRITICAL;
+		else if (warning)
+			next_state = STATE_WARNING;
+		else
+			next_state = STATE_NORMAL;
+		break;
+	case STATE_WARNING:
+		if (critical)
+			next_state = STATE_CRITICAL;
+		else if (!warning)
+			next_state = STATE_WARNING_HYST;
+		break;
+	case STATE_CRITICAL:
+		if (!critical && !warning)
+			next_state = STATE_WARNING;
+		break;
+	};
+
+	return next_state;
+}
+
+/*! Fold a reading and its (upper) thresholds into \a res */
+void mgr_sensor_eval(struct mgr_sensor_result *res, int value, int thresh_warn, int thresh_crit)
+{
+	if (value > thresh_warn)
+		res->warning = 1;
+	if (value > thresh_crit)
+		res->critical = 1;
+	if (value > thresh_warn - MGR_SENSOR_NEAR_MARGIN)
+		res->near = true;
+}
+
+static void sched_cb(void *data)
+{
+	struct mgr_sensor_sched *s = data;
+
+	s->fast = s->check_cb(s->data);
+	mgr_sensor_sched_rearm(s);
+}
+
+void mgr_sensor_sched_init(struct mgr_sensor_sched *s, unsigned int period, unsigned int fast_period,
+			   int log_ss, bool (*check_cb)(void *data), void *data)
+{
+	memset(s, 0, sizeof(*s));
+	s->period = period;
+	s->fast_period = OSMO_MIN(fast_period, period);
+	s->log_ss = log_ss;
+	s->check_cb = check_cb;
+	s->data = data;
+	osmo_timer_setup(&s->timer, sched_cb, s);
+}
+
+/*! Check the sensors right now and then periodically */
+void mgr_sensor_sched_start(struct mgr_sensor_sched *s)
+{
+	sched_cb(s);
+}
+
+/*! Check the sensors once the current event loop iteration is done.  Any
+ *  number of triggers before that results in a single check, so a burst
+ *  of sensor events leads to at most one state transition and one set of
+ *  CTRL/alarm messages. */
+void mgr_sensor_sched_trigger(struct mgr_sensor_sched *s)
+{
+	osmo_timer_schedule(&s->timer, 0, 0);
+}
+
+/*! (Re)start the period from now, without checking the sensors */
+void mgr_sensor_sched_rearm(struct mgr_sensor_sched *s)
+{
+	unsigned int period = s->fast ? s->fast_period : s->period;
+
+	LOGP(s->log_ss, LOGL_DEBUG, "Next sensor check in %u sec\n", period);
+	osmo_timer_schedule(&s->timer, period, 0);
+}
+
+struct mgr_sensor_watch {
+	struct osmo_fd ofd;
+	struct mgr_sensor_sched *sched;
+};
+
+/* The attribute must be read to completion again before sysfs_notify()
+ * wakes us up the next time */
+static int watch_read(int fd)
+{
+	char buf[32];
+
+	if (lseek(fd, 0, SEEK_SET) < 0)
+		return -errno;
+	if (read(fd, buf, sizeof(buf)) < 0)
+		return -errno;
+	return 0;
+}
+
+static int watch_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct mgr_sensor_watch *w = ofd->data;
+
+	if (!(what & OSMO_FD_EXCEPT))
+		return 0;
+
+	LOGP(w->sched->log_ss, LOGL_DEBUG, "Sensor event on fd %d\n", ofd->fd);
+	watch_read(ofd->fd);
+	mgr_sensor_sched_trigger(w->sched);
+	return 0;
+}
+
+/*! Check the sensors as soon as the sysfs attribute \a path changes.  Only
+ *  attributes for which the driver calls sysfs_notify(), like the hwmon
+ *  *_alarm files, ever signal a change; the periodic check still runs.
+ *  \returns 0 on success; negative on error (e.g. no such attribute). */
+int mgr_sensor_watch(struct mgr_sensor_sched *s, void *ctx, const char *path)
+{
+	struct mgr_sensor_watch *w;
+	int fd, rc;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	rc = watch_read(fd);
+	if (rc < 0) {
+		close(fd);
+		return rc;
+	}
+
+	w = talloc_zero(ctx, struct mgr_sensor_watch);
+	if (!w) {
+		close(fd);
+		return -ENOMEM;
+	}
+	w->sched = s;
+
+	osmo_fd_setup(&w->ofd, fd, OSMO_FD_EXCEPT, watch_cb, w, 0);
+	rc = osmo_fd_register(&w->ofd);
+	if (rc < 0) {
+		close(fd);
+		talloc_free(w);
+		return rc;
+	}
+
+	LOGP(s->log_ss, LOGL_INFO, "Watching %s for sensor events\n", path);
+	return 0;
+}
@@ -208,7 +208,17 @@ static void st_op_enabled_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_state
 
 static void st_op_enabled(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
+	struct gsm_bts_bb_trx *bb_transc = (struct gsm_bts_bb_trx *)fi->priv;
+
 	switch (event) {
+	case NM_EV_OML_UP:
+		/* OML link back within X17, the RF was kept up: announce us as we are */
+		oml_mo_tx_sw_act_rep(&bb_transc->mo);
+		oml_tx_state_changed(&bb_transc->mo);
+		ev_dispatch_children(bb_transc, event);
+		return;
+	case NM_EV_RSL_UP:
+		return;
 	case NM_EV_RSL_DOWN:
 		break;
 	case NM_EV_PHYLINK_DOWN:
@@ -282,6 +292,8 @@ static struct osmo_fsm_state nm_bb_transc_fsm_states[] = {
 	},
 	[NM_BBTRANSC_ST_OP_ENABLED] = {
 		.in_event_mask =
+			X(NM_EV_OML_UP) |
+			X(NM_EV_RSL_UP) |
 			X(NM_EV_RSL_DOWN) |
 			X(NM_EV_PHYLINK_DOWN) |
 			X(NM_EV_DISABLE),
@@ -155,6 +155,30 @@ static void st_op_enabled_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_state
 
 static void st_op_enabled(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
+	struct gsm_bts *bts = (struct gsm_bts *)fi->priv;
+	struct nm_fsm_ev_setattr_data *setattr_data;
+	int rc;
+
+	switch (event) {
+	case NM_EV_OML_UP:
+		/* OML link back within X17, the RF was kept up: announce us as we are */
+		oml_mo_tx_sw_act_rep(&bts->mo);
+		oml_tx_state_changed(&bts->mo);
+		ev_dispatch_children(bts, event);
+		return;
+	case NM_EV_RX_SETATTR:
+		/* re-sent by the BSC after such a re-attach, see X17 */
+		setattr_data = (struct nm_fsm_ev_setattr_data *)data;
+		if (!bts->abis_grace.reattached) {
+			oml_fom_ack_nack_copy_msg(setattr_data->msg, NM_NACK_CANT_PERFORM);
+			return;
+		}
+		rc = bts_model_apply_oml(bts, setattr_data->msg, &bts->mo, bts);
+		oml_fom_ack_nack_copy_msg(setattr_data->msg, rc);
+		return;
+	default:
+		OSMO_ASSERT(0);
+	}
 }
 
 static void nm_bts_allstate(struct osmo_fsm_inst *fi, uint32_t event, void *data)
@@ -204,7 +228,9 @@ static struct osmo_fsm_state nm_bts_fsm_states[] = {
 		.action = st_op_disabled_offline,
 	},
 	[NM_BTS_ST_OP_ENABLED] = {
-		.in_event_mask = 0,
+		.in_event_mask =
+			X(NM_EV_OML_UP) |
+			X(NM_EV_RX_SETATTR),
 		.out_state_mask =
 			X(NM_BTS_ST_OP_DISABLED_NOTINSTALLED),
 		.name = "ENABLED",
@@ -134,6 +134,18 @@ static void st_op_enabled_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_state
 
 static void st_op_enabled(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
+	struct gsm_bts_sm *site_mgr = (struct gsm_bts_sm *)fi->priv;
+
+	switch (event) {
+	case NM_EV_OML_UP:
+		/* OML link back within X17, the RF was kept up: announce us as we are */
+		oml_mo_tx_sw_act_rep(&site_mgr->mo);
+		oml_tx_state_changed(&site_mgr->mo);
+		ev_dispatch_children(site_mgr, event);
+		return;
+	default:
+		OSMO_ASSERT(0);
+	}
 }
 
 static void nm_bts_sm_allstate(struct osmo_fsm_inst *fi, uint32_t event, void *data)
@@ -183,7 +195,8 @@ static struct osmo_fsm_state nm_bts_sm_fsm_states[] = {
 		.action = st_op_disabled_offline,
 	},
 	[NM_BTS_SM_ST_OP_ENABLED] = {
-		.in_event_mask = 0,
+		.in_event_mask =
+			X(NM_EV_OML_UP),
 		.out_state_mask =
 			X(NM_BTS_SM_ST_OP_DISABLED_NOTINSTALLED),
 		.name = "ENABLED",
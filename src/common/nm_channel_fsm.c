@@ -204,8 +204,25 @@ static void st_op_enabled_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_state
 static void st_op_enabled(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
 	struct gsm_bts_trx_ts *ts = (struct gsm_bts_trx_ts *)fi->priv;
+	struct nm_fsm_ev_setattr_data *setattr_data;
+	int rc;
 
 	switch (event) {
+	case NM_EV_OML_UP:
+		/* OML link back within X17, the RF was kept up: announce us as we are */
+		oml_mo_tx_sw_act_rep(&ts->mo);
+		oml_tx_state_changed(&ts->mo);
+		return;
+	case NM_EV_RX_SETATTR:
+		/* re-sent by the BSC after such a re-attach, see X17 */
+		setattr_data = (struct nm_fsm_ev_setattr_data *)data;
+		if (!ts->trx->bts->abis_grace.reattached) {
+			oml_fom_ack_nack_copy_msg(setattr_data->msg, NM_NACK_CANT_PERFORM);
+			return;
+		}
+		rc = bts_model_apply_oml(ts->trx->bts, setattr_data->msg, &ts->mo, ts);
+		oml_fom_ack_nack_copy_msg(setattr_data->msg, rc);
+		return;
 	case NM_EV_BBTRANSC_DISABLED:
 	case NM_EV_RCARRIER_DISABLED:
 		if (!ts_can_be_enabled(ts))
@@ -287,6 +304,8 @@ static struct osmo_fsm_state nm_chan_fsm_states[] = {
 	},
 	[NM_CHAN_ST_OP_ENABLED] = {
 		.in_event_mask =
+			X(NM_EV_OML_UP) |
+			X(NM_EV_RX_SETATTR) |
 			X(NM_EV_BBTRANSC_DISABLED) |
 			X(NM_EV_RCARRIER_DISABLED) |
 			X(NM_EV_DISABLE),
@@ -187,7 +187,28 @@ static void st_op_enabled_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_state
 
 static void st_op_enabled(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 {
+	struct gsm_bts_trx *trx = (struct gsm_bts_trx *)fi->priv;
+	struct nm_fsm_ev_setattr_data *setattr_data;
+	int rc;
+
 	switch (event) {
+	case NM_EV_OML_UP:
+		/* OML link back within X17, the RF was kept up: announce us as we are */
+		oml_mo_tx_sw_act_rep(&trx->mo);
+		oml_tx_state_changed(&trx->mo);
+		return;
+	case NM_EV_RX_SETATTR:
+		/* re-sent by the BSC after such a re-attach, see X17 */
+		setattr_data = (struct nm_fsm_ev_setattr_data *)data;
+		if (!trx->bts->abis_grace.reattached) {
+			oml_fom_ack_nack_copy_msg(setattr_data->msg, NM_NACK_CANT_PERFORM);
+			return;
+		}
+		rc = bts_model_apply_oml(trx->bts, setattr_data->msg, &trx->mo, trx);
+		oml_fom_ack_nack_copy_msg(setattr_data->msg, rc);
+		return;
+	case NM_EV_RSL_UP:
+		return;
 	case NM_EV_RSL_DOWN:
 		break;
 	case NM_EV_PHYLINK_DOWN:
@@ -256,6 +277,9 @@ static struct osmo_fsm_state nm_rcarrier_fsm_states[] = {
 	},
 	[NM_RCARRIER_ST_OP_ENABLED] = {
 		.in_event_mask =
+			X(NM_EV_OML_UP) |
+			X(NM_EV_RX_SETATTR) |
+			X(NM_EV_RSL_UP) |
 			X(NM_EV_RSL_DOWN) |
 			X(NM_EV_PHYLINK_DOWN) |
 			X(NM_EV_DISABLE),
@@ -65,6 +65,16 @@ int bts_asci_notification_add(struct gsm_bts *bts, const uint8_t *group_call_ref
 		n->nch_drx_info.value = *nch_drx_info;
 	}
 
+	/* encode the Group Call information only once, see append_asci_notification() */
+	struct bitvec gci_bv = {
+		.data_len = sizeof(n->gci.data),
+		.data = n->gci.data,
+	};
+	append_group_call_information(&gci_bv, n->group_call_ref,
+				      n->chan_desc.present ? n->chan_desc.value : NULL,
+				      n->chan_desc.len);
+	n->gci.bits = gci_bv.cur_bit;
+
 	LOGP(DASCI, LOGL_INFO, "Added ASCI Notification for group call reference %s\n",
 	     osmo_hexdump_nospc(n->group_call_ref, ARRAY_SIZE(n->group_call_ref)));
 
@@ -142,29 +152,41 @@ void append_group_call_information(struct bitvec *bv, const uint8_t *gcr, const
 	/* spec reference: TS 44.018 Section 9.1.21a */
 
 	/* <Group Call Reference : bit(36)> */
-	struct bitvec *gcr_bv = bitvec_alloc(5*8, NULL);
-	OSMO_ASSERT(gcr_bv);
-	bitvec_unpack(gcr_bv, gcr);
-	for (unsigned int i = 0; i < 36; i++)
-		bitvec_set_bit(bv, bitvec_get_bit_pos(gcr_bv, i));
+	bitvec_set_bytes(bv, gcr, 4);
+	bitvec_set_uint(bv, gcr[4] >> 4, 4);
 
 	/* Group Channel Description */
 	if (ch_desc && ch_desc_len) {
-		struct bitvec *chd_bv = bitvec_alloc(ch_desc_len*8, NULL);
-		OSMO_ASSERT(chd_bv);
-		bitvec_unpack(chd_bv, ch_desc);
 		bitvec_set_bit(bv, 1);
 		/* <Channel Description : bit(24)> */
-		for (unsigned int i = 0; i < ch_desc_len * 8; i++)
-			bitvec_set_bit(bv, bitvec_get_bit_pos(chd_bv, i));
-		bitvec_free(chd_bv);
+		bitvec_set_bytes(bv, ch_desc, ch_desc_len);
 		/* FIXME: hopping */
 		bitvec_set_bit(bv, 0);
 	} else {
 		bitvec_set_bit(bv, 0);
 	}
+}
+
+/*! append the "Group Call Information" of a notification, as encoded by
+ *  bts_asci_notification_add(), to the caller-provided bit-vector.
+ *  \param[out] bv caller-provided output bit-vector
+ *  \param[in] n the notification */
+void append_asci_notification(struct bitvec *bv, const struct asci_notification *n)
+{
+	unsigned int bytes = n->gci.bits / 8;
+	unsigned int bits = n->gci.bits % 8;
+
+	/* not encoded, i.e. not added via bts_asci_notification_add() */
+	if (OSMO_UNLIKELY(n->gci.bits == 0)) {
+		append_group_call_information(bv, n->group_call_ref,
+					      n->chan_desc.present ? n->chan_desc.value : NULL,
+					      n->chan_desc.len);
+		return;
+	}
 
-	bitvec_free(gcr_bv);
+	bitvec_set_bytes(bv, n->gci.data, bytes);
+	if (bits)
+		bitvec_set_uint(bv, n->gci.data[bytes] >> (8 - bits), bits);
 }
 
 #define L2_PLEN(len)	(((len - 1) << 2) | 0x01)
@@ -212,9 +234,7 @@ int bts_asci_notify_nch_gen_msg(struct gsm_bts *bts, uint8_t *out_buf)
 	 *   { 0 | 1 < Group Call information > < List of Group Call NCH information > } ; */
 	if (notif) {
 		bitvec_set_bit(&bv, 1);
-		append_group_call_information(&bv, notif->group_call_ref,
-						   notif->chan_desc.present ? notif->chan_desc.value : NULL,
-						   notif->chan_desc.len);
+		append_asci_notification(&bv, notif);
 	}
 	bitvec_set_bit(&bv, 0);	/* End of list */
 
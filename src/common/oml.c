@@ -1027,6 +1027,15 @@ static int oml_rx_set_chan_attr(struct gsm_bts_trx_ts *ts, struct msgb *msg)
 		return oml_fom_ack_nack(msg, NM_NACK_SPEC_IMPL_NOTSUPP);
 	}
 
+	/* A timeslot kept running across the loss of the OML link (X17) can not
+	 * be turned into another channel combination by the BSC re-attaching */
+	if (ts->mo.nm_state.operational == NM_OPSTATE_ENABLED && TLVP_PRES_LEN(&tp, NM_ATT_CHAN_COMB, 1) &&
+	    abis_nm_pchan4chcomb(*TLVP_VAL(&tp, NM_ATT_CHAN_COMB)) != ts->pchan) {
+		LOGPFOH(DOML, LOGL_ERROR, foh, "SET CHAN ATTR: cannot change the Chan Comb "
+			"of an enabled timeslot (pchan=%s)\n", gsm_pchan_name(ts->pchan));
+		return oml_fom_ack_nack(msg, NM_NACK_CANT_PERFORM);
+	}
+
 	/* merge existing CHAN attributes with new attributes */
 	tp_merged = osmo_tlvp_copy(ts->mo.nm_attr, ts->trx);
 	talloc_set_name_const(tp_merged, "oml_chan_attr");
@@ -1499,6 +1508,12 @@ static int oml_ipa_set_attr(struct gsm_bts *bts, struct msgb *msg)
 	if ((obj = gsm_objclass2obj(bts, foh->obj_class, &foh->obj_inst, &c)) == NULL)
 		return oml_fom_ack_nack(msg, c);
 
+	/* An enabled object only takes the attributes re-sent by the BSC after
+	 * re-attaching within X17: reject anything else before it is applied */
+	if (mo->nm_state.operational == NM_OPSTATE_ENABLED && !bts->abis_grace.reattached) {
+		LOGPFOH(DOML, LOGL_ERROR, foh, "IPA SET ATTR: object is enabled\n");
+		return oml_fom_ack_nack(msg, NM_NACK_CANT_PERFORM);
+	}
 
 	switch (mo->obj_class) {
 	case NM_OC_GPRS_NSE:
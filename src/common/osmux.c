@@ -101,6 +101,9 @@ static void osmux_deliver_cb(struct msgb *batch_msg, void *data)
 	socklen_t dest_len;
 	ssize_t rc;
 
+	bts->osmux.batch_fill[OSMO_MIN(handle->pending, OSMUX_BATCH_FILL_MAX)]++;
+	handle->pending = 0;
+
 	switch (handle->rem_addr.u.sa.sa_family) {
 	case AF_INET6:
 		dest_len = sizeof(handle->rem_addr.u.sin6);
@@ -243,37 +246,24 @@ static struct msgb *osmux_recv(struct osmo_fd *ofd, struct osmo_sockaddr *addr)
 	return msg;
 }
 
-static struct gsm_lchan *osmux_lchan_find(struct gsm_bts *bts, const struct osmo_sockaddr *rem_addr, uint8_t osmux_cid)
+/*! Find the connected lchan a received Osmux frame is destined to.
+ *  Local CIDs are allocated from a common pool, so the CID alone selects the
+ *  lchan; the remote address is checked to ignore frames from other peers.
+ *  \returns lchan; NULL if there is none */
+struct gsm_lchan *osmux_lchan_find(const struct gsm_bts *bts, const struct osmo_sockaddr *rem_addr,
+				   uint8_t osmux_cid)
 {
-	/* TODO: Optimize this by maintaining a hashmap local_cid->lchan in bts */
-	struct gsm_bts_trx *trx;
-
-	llist_for_each_entry(trx, &bts->trx_list, list) { /* C0..n */
-		unsigned int tn;
-		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
-			struct gsm_bts_trx_ts *ts = &trx->ts[tn];
-			uint8_t subslot, subslots;
-			if (!ts_is_tch(ts))
-				continue;
+	struct gsm_lchan *lchan = bts->osmux.lchan_by_cid[osmux_cid];
+	struct osmux_handle *h;
 
-			subslots = ts_subslots(ts);
-			for (subslot = 0; subslot < subslots; subslot++) {
-				struct gsm_lchan *lchan = &ts->lchan[subslot];
-				struct osmux_handle *h;
-				if (!lchan->abis_ip.osmux.use)
-					continue;
-				if (!lchan_osmux_connected(lchan))
-					continue;
-				if (lchan->abis_ip.osmux.local_cid != osmux_cid)
-					continue;
-				h = osmux_xfrm_input_get_deliver_cb_data(lchan->abis_ip.osmux.in);
-				if (osmo_sockaddr_cmp(&h->rem_addr, rem_addr) != 0)
-					continue;
-				return lchan; /* Found it! */
-			}
-		}
-	}
-	return NULL;
+	if (!lchan)
+		return NULL;
+
+	h = osmux_xfrm_input_get_deliver_cb_data(lchan->abis_ip.osmux.in);
+	if (osmo_sockaddr_cmp(&h->rem_addr, rem_addr) != 0)
+		return NULL;
+
+	return lchan;
 }
 
 static int osmux_read_fd_cb(struct osmo_fd *ofd, unsigned int what)
@@ -312,6 +302,7 @@ int bts_osmux_init(struct gsm_bts *bts)
 	bts->osmux.batch_factor = 4;
 	bts->osmux.batch_size = OSMUX_BATCH_DEFAULT_MAX;
 	bts->osmux.dummy_padding = false;
+	bts->osmux.batch_flush = OSMUX_BATCH_FLUSH_TIMER;
 	INIT_LLIST_HEAD(&bts->osmux.osmux_handle_list);
 	bts->osmux.fd.fd = -1;
 	return 0;
@@ -454,6 +445,8 @@ void lchan_osmux_release(struct gsm_lchan *lchan)
 
 	/* Now the remote / tx part, if ever set (connected): */
 	if (lchan->abis_ip.osmux.in) {
+		if (bts->osmux.lchan_by_cid[lchan->abis_ip.osmux.local_cid] == lchan)
+			bts->osmux.lchan_by_cid[lchan->abis_ip.osmux.local_cid] = NULL;
 		osmux_xfrm_input_close_circuit(lchan->abis_ip.osmux.in,
 					       lchan->abis_ip.osmux.remote_cid);
 		osmux_handle_put(bts, lchan->abis_ip.osmux.in);
@@ -497,6 +490,7 @@ int lchan_osmux_connect(struct gsm_lchan *lchan)
 		lchan->abis_ip.osmux.in = NULL;
 		return -1;
 	}
+	bts->osmux.lchan_by_cid[lchan->abis_ip.osmux.local_cid] = lchan;
 	return 0;
 }
 
@@ -528,9 +522,48 @@ int lchan_osmux_send_frame(struct gsm_lchan *lchan, const uint8_t *payload,
 		/* batch full, build and deliver it */
 		osmux_xfrm_input_deliver(lchan->abis_ip.osmux.in);
 	}
+	if (rc == 0) {
+		struct osmux_handle *h = osmux_xfrm_input_get_deliver_cb_data(lchan->abis_ip.osmux.in);
+		h->pending++;
+	}
 	return 0;
 }
 
+/* Whether fn is the first TDMA frame of one of the 6 speech blocks of a
+ * 26-multiframe, i.e. all TCH frames of the previous block were received */
+static bool fn_is_speech_block_start(uint32_t fn)
+{
+	switch (fn % 26) {
+	case 0:
+	case 4:
+	case 8:
+	case 13:
+	case 17:
+	case 21:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*! to be called for every TDMA frame: with 'batch-flush tdma', deliver the
+ *  batches towards all peers at the end of every speech block period, so that
+ *  each batch contains the Uplink frames of one block period */
+void bts_osmux_tdma_tick(struct gsm_bts *bts, uint32_t fn)
+{
+	struct osmux_handle *h;
+
+	if (bts->osmux.batch_flush != OSMUX_BATCH_FLUSH_TDMA)
+		return;
+	if (!fn_is_speech_block_start(fn))
+		return;
+
+	llist_for_each_entry(h, &bts->osmux.osmux_handle_list, head) {
+		if (h->pending > 0)
+			osmux_xfrm_input_deliver(h->in);
+	}
+}
+
 int lchan_osmux_skipped_frame(struct gsm_lchan *lchan, unsigned int duration)
 {
 	struct msgb *msg;
@@ -32,6 +32,9 @@
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/hashtable.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/stat_item.h>
 
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/gsm/gsm0502.h>
@@ -45,8 +48,15 @@
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/notification.h>
 
-#define MAX_PAGING_BLOCKS_CCCH	9
-#define MAX_BS_PA_MFRMS		9
+/* log2 of the number of buckets of the identity hash table */
+#define PAGING_HASH_BITS	10
+
+/* number of one second slots of the expiry timer wheel, must be larger
+ * than the maximum paging lifetime (see VTY 'paging lifetime') */
+#define PAGING_WHEEL_SLOTS	64
+
+/* number of cached ETWS pages, the 4 bit page number limits it to 15 */
+#define PAGING_ETWS_PAGES_MAX	16
 
 enum paging_record_type {
 	PAGING_RECORD_NORMAL,
@@ -58,7 +68,16 @@ struct paging_record {
 	enum paging_record_type type;
 	union {
 		struct {
-			time_t expiration_time;
+			/* entry in paging_state->identity_hash */
+			struct hlist_node hnode;
+			/* entry in paging_state->wheel[expiration_tick % PAGING_WHEEL_SLOTS] */
+			struct llist_head wheel_list;
+			uint32_t expiration_tick;
+			/* FN at the time of queueing, for paging_stats.wait_hist */
+			uint32_t enqueue_fn;
+			/* number of PAGING REQUESTs the identity was included in */
+			uint16_t num_sent;
+			uint8_t paging_group;
 			uint8_t chan_needed;
 			uint8_t identity_lv[9];
 		} normal;
@@ -82,13 +101,64 @@ struct paging_state {
 
 	/* total number of currently active paging records in queue */
 	unsigned int num_paging;
-	struct llist_head paging_queue[MAX_PAGING_BLOCKS_CCCH*MAX_BS_PA_MFRMS];
+	struct llist_head paging_queue[PAGING_GROUPS_MAX];
+	/* all normal paging records, by identity (see paging_identity_hash()) */
+	DECLARE_HASHTABLE(identity_hash, PAGING_HASH_BITS);
+
+	/* pool of unused normal paging records, sized by num_paging_max */
+	struct llist_head free_records;
+	unsigned int num_records;
+
+	/* expiry of the normal paging records, in seconds of CLOCK_MONOTONIC */
+	struct llist_head wheel[PAGING_WHEEL_SLOTS];
+	struct osmo_timer_list wheel_timer;
+	uint32_t tick;
+
+	/* the empty PAGING REQUEST TYPE 1, as last encoded for the given NLN */
+	struct {
+		bool valid;
+		bool nln_present;
+		uint8_t nln;
+		uint8_t nln_status;
+		uint8_t msg[GSM_MACBLOCK_LEN];
+	} empty_msg;
+
+	/* the PAGING REQUEST TYPE 1 with each page of the ETWS primary
+	 * notification of the given bts->etws.generation */
+	struct {
+		unsigned int generation;
+		uint32_t valid;		/* bit-mask of the pages encoded in msg[] */
+		uint8_t msg[PAGING_ETWS_PAGES_MAX][GSM_MACBLOCK_LEN];
+	} etws_msg;
+
+	struct paging_stats stats;
+	struct osmo_stat_item_group *statg;
 
 	/* prioritization of cs pagings will automatically become
 	 * active on congestions (queue almost full) */
 	bool cs_priority_active;
 };
 
+enum paging_stat_item {
+	PAGING_STAT_QUEUE_LEN,
+	PAGING_STAT_WAIT,
+};
+
+static const struct osmo_stat_item_desc paging_stat_desc[] = {
+	[PAGING_STAT_QUEUE_LEN] = { "paging:queue-length",
+				    "Number of paging records in the queue", "records", 16, 0 },
+	[PAGING_STAT_WAIT] = { "paging:wait",
+			       "Time between queueing and first transmission of a paging", "ms", 16, 0 },
+};
+
+static const struct osmo_stat_item_group_desc paging_statg_desc = {
+	"paging",
+	"paging queue",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(paging_stat_desc),
+	paging_stat_desc
+};
+
 /* The prioritization of cs pagings is controlled by a hysteresis. When the
  * fill state of the paging queue exceeds the upper fill level
  * THRESHOLD_CONGESTED [%], then PS pagings (immediate assignments and pagings
@@ -107,6 +177,9 @@ static void check_congestion(struct paging_state *ps)
 	unsigned int treshold_upper = pag_queue_max * THRESHOLD_CONGESTED / 100;
 	unsigned int treshold_lower = pag_queue_max * THRESHOLD_CLEAR / 100;
 
+	osmo_stat_item_set(osmo_stat_item_group_get_item(ps->statg, PAGING_STAT_QUEUE_LEN),
+			   pag_queue_len);
+
 	if (pag_queue_len > treshold_upper && ps->cs_priority_active == false) {
 		ps->cs_priority_active = true;
 		rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_CONG);
@@ -114,6 +187,54 @@ static void check_congestion(struct paging_state *ps)
 		ps->cs_priority_active = false;
 }
 
+/* Make sure that the pool holds at least 'num' normal paging records.  The
+ * pool never shrinks, as records may still be queued; num_paging_max still
+ * limits the number of records in use. */
+static int paging_pool_grow(struct paging_state *ps, unsigned int num)
+{
+	struct paging_record *chunk;
+	unsigned int i;
+
+	if (num <= ps->num_records)
+		return 0;
+
+	chunk = talloc_array(ps, struct paging_record, num - ps->num_records);
+	if (!chunk)
+		return -ENOMEM;
+	for (i = 0; i < num - ps->num_records; i++)
+		llist_add_tail(&chunk[i].list, &ps->free_records);
+	ps->num_records = num;
+
+	return 0;
+}
+
+/* Take a normal paging record from the pool, NULL if it is exhausted */
+static struct paging_record *paging_record_alloc(struct paging_state *ps)
+{
+	struct paging_record *pr;
+
+	pr = llist_first_entry_or_null(&ps->free_records, struct paging_record, list);
+	if (!pr)
+		return NULL;
+	llist_del(&pr->list);
+
+	memset(pr, 0, sizeof(*pr));
+	pr->type = PAGING_RECORD_NORMAL;
+	INIT_LLIST_HEAD(&pr->u.normal.wheel_list);
+	return pr;
+}
+
+/* (Re-)Schedule the expiry of a normal paging record, 'lifetime' seconds from now */
+static void paging_record_set_expiry(struct paging_state *ps, struct paging_record *pr,
+				     unsigned int lifetime)
+{
+	lifetime = OSMO_MIN(lifetime, PAGING_WHEEL_SLOTS - 1);
+	pr->u.normal.expiration_tick = ps->tick + lifetime;
+	llist_del_init(&pr->u.normal.wheel_list);
+	llist_add_tail(&pr->u.normal.wheel_list,
+		       &ps->wheel[pr->u.normal.expiration_tick % PAGING_WHEEL_SLOTS]);
+}
+
 unsigned int paging_get_lifetime(struct paging_state *ps)
 {
 	return ps->paging_lifetime;
@@ -132,6 +253,8 @@ void paging_set_lifetime(struct paging_state *ps, unsigned int lifetime)
 void paging_set_queue_max(struct paging_state *ps, unsigned int queue_max)
 {
 	ps->num_paging_max = queue_max;
+	if (paging_pool_grow(ps, queue_max) < 0)
+		LOGP(DPAG, LOGL_ERROR, "Failed to allocate %u paging records\n", queue_max);
 }
 
 static int tmsi_mi_to_uint(uint32_t *out, const uint8_t *tmsi_lv)
@@ -146,6 +269,146 @@ static int tmsi_mi_to_uint(uint32_t *out, const uint8_t *tmsi_lv)
 	return 0;
 }
 
+/* Key of a paging record in paging_state->identity_hash: the TMSI itself,
+ * or a FNV-1a digest of the identity LV for any other identity type */
+static uint32_t paging_identity_hash(const uint8_t *identity_lv)
+{
+	uint32_t hash = 2166136261u;
+	unsigned int i;
+
+	if (tmsi_mi_to_uint(&hash, identity_lv) == 0)
+		return hash;
+
+	for (i = 0; i < identity_lv[0] + 1; i++) {
+		hash ^= identity_lv[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static struct paging_record *paging_find_identity(struct paging_state *ps, uint8_t paging_group,
+						  const uint8_t *identity_lv)
+{
+	struct paging_record *pr;
+
+	hash_for_each_possible(ps->identity_hash, pr, u.normal.hnode,
+			       paging_identity_hash(identity_lv)) {
+		if (pr->u.normal.paging_group != paging_group)
+			continue;
+		if (identity_lv[0] == pr->u.normal.identity_lv[0] &&
+		    !memcmp(identity_lv+1, pr->u.normal.identity_lv+1,
+							identity_lv[0]))
+			return pr;
+	}
+
+	return NULL;
+}
+
+/* Free a paging record, which is not (or no longer) in a paging queue */
+static void paging_record_free(struct paging_state *ps, struct paging_record *pr)
+{
+	if (pr->type == PAGING_RECORD_NORMAL) {
+		hash_del(&pr->u.normal.hnode);
+		llist_del_init(&pr->u.normal.wheel_list);
+		llist_add(&pr->list, &ps->free_records);
+	} else {
+		talloc_free(pr);
+	}
+}
+
+static void paging_group_len_inc(struct paging_state *ps, uint8_t group)
+{
+	struct paging_stats *st = &ps->stats;
+
+	st->group_len[group]++;
+	if (st->group_len[group] > st->group_len_max[group])
+		st->group_len_max[group] = st->group_len[group];
+}
+
+/* A normal paging record was included in a PAGING REQUEST at 'fn' */
+static void paging_record_sent(struct paging_state *ps, struct paging_record *pr, uint32_t fn)
+{
+	uint32_t wait;
+	unsigned int i;
+
+	if (pr->u.normal.num_sent++ > 0)
+		return;
+
+	wait = GSM_TDMA_FN_SUB(fn, pr->u.normal.enqueue_fn);
+	for (i = 0; i < PAGING_WAIT_HIST_LEN - 1; i++) {
+		if (wait < 51 << i)
+			break;
+	}
+	ps->stats.wait_hist[i]++;
+	osmo_stat_item_set(osmo_stat_item_group_get_item(ps->statg, PAGING_STAT_WAIT),
+			   wait * 120 / 26);
+}
+
+/* Remove an expired normal paging record from the queue */
+static void paging_record_expire(struct paging_state *ps, struct paging_record *pr)
+{
+	unsigned int n = OSMO_MIN(pr->u.normal.num_sent, PAGING_REPEAT_HIST_LEN);
+
+	if (n > 0)
+		ps->stats.repeat_hist[n - 1]++;
+	ps->stats.group_len[pr->u.normal.paging_group]--;
+
+	paging_record_free(ps, pr);
+	ps->num_paging--;
+}
+
+static uint32_t paging_wheel_now(void)
+{
+	struct timespec ts;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+/* Expire the records of one slot of the timer wheel.  Records which were
+ * not sent yet stay queued, paging_gen_msg() frees them once they were
+ * sent at least once (like with a lifetime of 0). */
+static void paging_wheel_expire_slot(struct paging_state *ps, struct llist_head *slot)
+{
+	struct paging_record *pr, *pr2;
+
+	llist_for_each_entry_safe(pr, pr2, slot, u.normal.wheel_list) {
+		if ((int32_t)(pr->u.normal.expiration_tick - ps->tick) > 0)
+			continue;
+		if (pr->u.normal.num_sent == 0) {
+			llist_del_init(&pr->u.normal.wheel_list);
+			continue;
+		}
+		llist_del(&pr->list);
+		paging_record_expire(ps, pr);
+		LOGP(DPAG, LOGL_INFO, "Expired paging record, queue_len=%u\n",
+		     ps->num_paging);
+	}
+}
+
+static void paging_wheel_timer_cb(void *data)
+{
+	struct paging_state *ps = data;
+	uint32_t now = paging_wheel_now();
+	unsigned int i;
+
+	if (now - ps->tick >= PAGING_WHEEL_SLOTS) {
+		/* we missed at least one full turn, check all slots */
+		ps->tick = now;
+		for (i = 0; i < ARRAY_SIZE(ps->wheel); i++)
+			paging_wheel_expire_slot(ps, &ps->wheel[i]);
+	} else {
+		/* catch up with the seconds we missed (if any) */
+		while (ps->tick != now) {
+			ps->tick++;
+			paging_wheel_expire_slot(ps, &ps->wheel[ps->tick % PAGING_WHEEL_SLOTS]);
+		}
+	}
+
+	osmo_timer_schedule(&ps->wheel_timer, 1, 0);
+}
+
 /* paging block numbers in a simple non-combined CCCH */
 static const uint8_t block_by_tdma51[51] = {
 	255, 255,		/* FCCH, SCH */
@@ -224,7 +487,7 @@ int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
 		return -EINVAL;
 	}
 
-	if (ps->num_paging >= ps->num_paging_max) {
+	if (ps->num_paging >= ps->num_paging_max || llist_empty(&ps->free_records)) {
 		LOGP(DPAG, LOGL_NOTICE, "Dropping paging, queue full (%u)\n",
 			ps->num_paging);
 		rate_ctr_inc2(ps->bts->ctrs, BTS_CTR_PAGING_DROP);
@@ -232,40 +495,34 @@ int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
 	}
 
 	/* Check if we already have this identity */
-	llist_for_each_entry(pr, group_q, list) {
-		if (pr->type != PAGING_RECORD_NORMAL)
-			continue;
-		if (identity_lv[0] == pr->u.normal.identity_lv[0] &&
-		    !memcmp(identity_lv+1, pr->u.normal.identity_lv+1,
-							identity_lv[0])) {
-			LOGP(DPAG, LOGL_INFO, "Ignoring duplicate paging\n");
-			pr->u.normal.expiration_time =
-					time(NULL) + ps->paging_lifetime;
-			return -EEXIST;
-		}
+	pr = paging_find_identity(ps, paging_group, identity_lv);
+	if (pr != NULL) {
+		LOGP(DPAG, LOGL_INFO, "Ignoring duplicate paging\n");
+		paging_record_set_expiry(ps, pr, ps->paging_lifetime);
+		return -EEXIST;
 	}
 
-	pr = talloc_zero(ps, struct paging_record);
-	if (!pr)
-		return -ENOMEM;
-	pr->type = PAGING_RECORD_NORMAL;
-
-	if (*identity_lv + 1 > sizeof(pr->u.normal.identity_lv)) {
-		talloc_free(pr);
+	if (*identity_lv + 1 > sizeof(pr->u.normal.identity_lv))
 		return -E2BIG;
-	}
+
+	pr = paging_record_alloc(ps);
+	OSMO_ASSERT(pr != NULL); /* see the check for a full queue above */
 
 	LOGP(DPAG, LOGL_INFO, "Add paging to queue (group=%u, queue_len=%u)\n",
 		paging_group, ps->num_paging+1);
 
-	pr->u.normal.expiration_time = time(NULL) + ps->paging_lifetime;
+	paging_record_set_expiry(ps, pr, ps->paging_lifetime);
+	pr->u.normal.enqueue_fn = ps->bts->gsm_time.fn;
+	pr->u.normal.paging_group = paging_group;
 	pr->u.normal.chan_needed = chan_needed;
 	memcpy(&pr->u.normal.identity_lv, identity_lv, identity_lv[0]+1);
+	hash_add(ps->identity_hash, &pr->u.normal.hnode, paging_identity_hash(identity_lv));
 
 	/* enqueue the new identity to the HEAD of the queue,
 	 * to ensure it will be paged quickly at least once.  */
 	llist_add(&pr->list, group_q);
 	ps->num_paging++;
+	paging_group_len_inc(ps, paging_group);
 
 	return 0;
 }
@@ -373,9 +630,7 @@ void append_p1_rest_octets(struct bitvec *bv, const struct p1_rest_octets *p1ro,
 	bitvec_set_bit(bv, L);		/* no Priority2 */
 	if (notif) {
 		bitvec_set_bit(bv, H);		/* Group Call Info */
-		append_group_call_information(bv, notif->group_call_ref,
-					      notif->chan_desc.present ? notif->chan_desc.value : NULL,
-					      notif->chan_desc.len);
+		append_asci_notification(bv, notif);
 	} else {
 		bitvec_set_bit(bv, L);		/* no Group Call Info */
 	}
@@ -652,6 +907,71 @@ static void build_p1_rest_octets(struct p1_rest_octets *p1ro, struct gsm_bts *bt
 	bts->etws.next_page = (bts->etws.next_page + 1) % bts->etws.num_pages;
 }
 
+/* Generate the empty PAGING REQUEST TYPE 1.  This is by far the most common
+ * message on the PCH, and it only depends on the NLN, so it is only encoded
+ * again when the NLN changes. */
+static int paging_gen_empty_msg(struct paging_state *ps, uint8_t *out_buf)
+{
+	const struct gsm_bts *bts = ps->bts;
+	bool nln_present = (bts->asci.pos_nch >= 0);
+
+	if (!ps->empty_msg.valid ||
+	    ps->empty_msg.nln_present != nln_present ||
+	    ps->empty_msg.nln != bts->asci.nln ||
+	    ps->empty_msg.nln_status != bts->asci.nln_status) {
+		struct p1_rest_octets p1ro;
+		memset(&p1ro, 0, sizeof(p1ro));
+		/* Use NLN to notify MS about ongoing VGCS/VBS calls.
+		 * This is required to make the phone read the NCH to get an updated list of ongoing calls.
+		 * Without this the phone will not allow making VGCS/VBS calls. */
+		p1ro.nln_pch.present = nln_present;
+		p1ro.nln_pch.nln = bts->asci.nln;
+		p1ro.nln_pch.nln_status = bts->asci.nln_status;
+		/* There is nobody to be paged, send Type1 with two empty ID */
+		fill_paging_type_1(ps->empty_msg.msg, empty_id_lv, 0, NULL, 0, &p1ro, NULL);
+
+		ps->empty_msg.valid = true;
+		ps->empty_msg.nln_present = nln_present;
+		ps->empty_msg.nln = bts->asci.nln;
+		ps->empty_msg.nln_status = bts->asci.nln_status;
+	}
+
+	memcpy(out_buf, ps->empty_msg.msg, GSM_MACBLOCK_LEN);
+	return GSM_MACBLOCK_LEN;
+}
+
+/* Generate the PAGING REQUEST TYPE 1 with the next page of the ETWS primary
+ * notification.  The same few pages are repeated on every paging block for
+ * as long as the notification is active, so each one is encoded only once. */
+static int paging_gen_etws_msg(struct paging_state *ps, uint8_t *out_buf)
+{
+	struct gsm_bts *bts = ps->bts;
+	uint8_t page = bts->etws.next_page;
+	struct p1_rest_octets p1ro;
+
+	if (ps->etws_msg.generation != bts->etws.generation) {
+		ps->etws_msg.generation = bts->etws.generation;
+		ps->etws_msg.valid = 0;
+	}
+
+	if (page < PAGING_ETWS_PAGES_MAX && (ps->etws_msg.valid & (1 << page))) {
+		bts->etws.next_page = (page + 1) % bts->etws.num_pages;
+		memcpy(out_buf, ps->etws_msg.msg[page], GSM_MACBLOCK_LEN);
+		return GSM_MACBLOCK_LEN;
+	}
+
+	build_p1_rest_octets(&p1ro, bts);
+	/* we intentioanally don't try to add notifications here, as ETWS is more critical */
+	fill_paging_type_1(out_buf, empty_id_lv, 0, NULL, 0, &p1ro, NULL);
+
+	if (page < PAGING_ETWS_PAGES_MAX) {
+		memcpy(ps->etws_msg.msg[page], out_buf, GSM_MACBLOCK_LEN);
+		ps->etws_msg.valid |= (1 << page);
+	}
+
+	return GSM_MACBLOCK_LEN;
+}
+
 /* generate paging message for given gsm time */
 int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *gt,
 		   int *is_empty)
@@ -679,27 +999,13 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 	group_q = &ps->paging_queue[group];
 
 	if (ps->bts->etws.prim_notif) {
-		struct p1_rest_octets p1ro;
-		build_p1_rest_octets(&p1ro, bts);
-		/* we intentioanally don't try to add notifications here, as ETWS is more critical */
-		len = fill_paging_type_1(out_buf, empty_id_lv, 0, NULL, 0, &p1ro, NULL);
+		len = paging_gen_etws_msg(ps, out_buf);
 	} else if (llist_empty(group_q)) {
-		struct p1_rest_octets p1ro;
-		memset(&p1ro, 0, sizeof(p1ro));
-		/* Use NLN to notify MS about ongoing VGCS/VBS calls.
-		 * This is required to make the phone read the NCH to get an updated list of ongoing calls.
-		 * Without this the phone will not allow making VGCS/VBS calls. */
-		p1ro.nln_pch.present = (bts->asci.pos_nch >= 0);
-		p1ro.nln_pch.nln = bts->asci.nln;
-		p1ro.nln_pch.nln_status = bts->asci.nln_status;
-		/* There is nobody to be paged, send Type1 with two empty ID */
-		//DEBUGP(DPAG, "Tx PAGING TYPE 1 (empty)\n");
-		len = fill_paging_type_1(out_buf, empty_id_lv, 0, NULL, 0, &p1ro, NULL);
+		len = paging_gen_empty_msg(ps, out_buf);
 		*is_empty = 1;
 	} else {
 		struct paging_record *pr[4];
 		unsigned int num_pr = 0, macblock = 0;
-		time_t now = time(NULL);
 		unsigned int i, num_imsi = 0;
 
 		bts->load.ccch.pch_used += 1;
@@ -819,9 +1125,9 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 			rate_ctr_inc2(bts->ctrs, BTS_CTR_PAGING_SENT);
 			/* check if we can expire the paging record,
 			 * or if we need to re-queue it */
-			if (pr[i]->u.normal.expiration_time <= now) {
-				talloc_free(pr[i]);
-				ps->num_paging--;
+			paging_record_sent(ps, pr[i], gt->fn);
+			if ((int32_t)(pr[i]->u.normal.expiration_tick - ps->tick) <= 0) {
+				paging_record_expire(ps, pr[i]);
 				LOGP(DPAG, LOGL_INFO, "Removed paging record, queue_len=%u\n",
 					ps->num_paging);
 			} else
@@ -858,6 +1164,13 @@ static int paging_signal_cbfn(unsigned int subsys, unsigned int signal, void *hd
 
 static int initialized = 0;
 
+static int paging_state_talloc_destructor(struct paging_state *ps)
+{
+	osmo_timer_del(&ps->wheel_timer);
+	osmo_stat_item_group_free(ps->statg);
+	return 0;
+}
+
 struct paging_state *paging_init(struct gsm_bts *bts,
 				 unsigned int num_paging_max,
 				 unsigned int paging_lifetime)
@@ -876,6 +1189,25 @@ struct paging_state *paging_init(struct gsm_bts *bts,
 
 	for (i = 0; i < ARRAY_SIZE(ps->paging_queue); i++)
 		INIT_LLIST_HEAD(&ps->paging_queue[i]);
+	hash_init(ps->identity_hash);
+	INIT_LLIST_HEAD(&ps->free_records);
+	if (paging_pool_grow(ps, num_paging_max) < 0) {
+		talloc_free(ps);
+		return NULL;
+	}
+
+	ps->statg = osmo_stat_item_group_alloc(ps, &paging_statg_desc, bts->nr);
+	if (!ps->statg) {
+		talloc_free(ps);
+		return NULL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(ps->wheel); i++)
+		INIT_LLIST_HEAD(&ps->wheel[i]);
+	ps->tick = paging_wheel_now();
+	osmo_timer_setup(&ps->wheel_timer, paging_wheel_timer_cb, ps);
+	osmo_timer_schedule(&ps->wheel_timer, 1, 0);
+	talloc_set_destructor(ps, paging_state_talloc_destructor);
 
 	if (!initialized) {
 		osmo_signal_register_handler(SS_GLOBAL, paging_signal_cbfn, NULL);
@@ -888,7 +1220,7 @@ void paging_config(struct paging_state *ps,
 		  unsigned int num_paging_max,
 		  unsigned int paging_lifetime)
 {
-	ps->num_paging_max = num_paging_max;
+	paging_set_queue_max(ps, num_paging_max);
 	ps->paging_lifetime = paging_lifetime;
 }
 
@@ -901,7 +1233,7 @@ void paging_reset(struct paging_state *ps)
 		struct paging_record *pr, *pr2;
 		llist_for_each_entry_safe(pr, pr2, queue, list) {
 			llist_del(&pr->list);
-			talloc_free(pr);
+			paging_record_free(ps, pr);
 			ps->num_paging--;
 		}
 	}
@@ -910,6 +1242,7 @@ void paging_reset(struct paging_state *ps)
 		LOGP(DPAG, LOGL_NOTICE, "num_paging != 0 after flushing all records?!?\n");
 
 	ps->num_paging = 0;
+	memset(ps->stats.group_len, 0, sizeof(ps->stats.group_len));
 }
 
 /**
@@ -926,3 +1259,8 @@ int paging_queue_length(struct paging_state *ps)
 {
 	return ps->num_paging;
 }
+
+const struct paging_stats *paging_get_stats(const struct paging_state *ps)
+{
+	return &ps->stats;
+}
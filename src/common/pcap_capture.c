@@ -0,0 +1,405 @@
+/* pcapng capture of the GSMTAP Um frames and RTP into memory mapped files */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Instead of sending GSMTAP to a remote host and capturing it there, the
+ * frames are written right away as pcapng Enhanced Packet Blocks, wrapped
+ * in the IPv4/UDP headers Wireshark expects for GSMTAP (port 4729), into
+ * a file mapped into memory.  Like for the TRXD capture of osmo-bts-trx,
+ * writing a packet is a memcpy() on the main thread, the kernel takes care
+ * of the write-back.
+ *
+ * A pcapng file cannot be a ring, so the capture rotates through up to
+ * max_files files of file_size bytes each, named PATH.0, PATH.1, ...,
+ * overwriting the oldest one.  Only the rotation, once per file, makes a
+ * few syscalls.  A file is truncated to the written length when it is
+ * closed; the current one should be copied after 'pcap-capture stop' (if
+ * copied before, Wireshark reports an error after the last packet).
+ *
+ * RTP packets are recorded between the addresses of the lchan.  In the
+ * Uplink, the RTP sequence number and timestamp are not known here and
+ * are derived from the TDMA frame number instead.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/gsmtap.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/lchan.h>
+#include <osmo-bts/pcap_capture.h>
+
+#define PCAPNG_BT_SHB		0x0a0d0d0a	/* Section Header Block */
+#define PCAPNG_BT_IDB		0x00000001	/* Interface Description Block */
+#define PCAPNG_BT_EPB		0x00000006	/* Enhanced Packet Block */
+#define PCAPNG_BYTE_ORDER_MAGIC	0x1a2b3c4d
+#define PCAPNG_OPT_IF_TSRESOL	9
+#define LINKTYPE_IPV4		228
+
+#define CAP_SNAPLEN		0xffff
+#define CAP_PKT_MAX		2048	/* max. size of an EPB, GSMTAP and RTP are way smaller */
+#define CAP_MIN_FILE_SIZE	(64 * 1024)
+#define CAP_PAD4(len)		(((len) + 3) & ~3)
+
+struct pcapng_shb {
+	uint32_t type;
+	uint32_t len;
+	uint32_t byte_order_magic;
+	uint16_t major;
+	uint16_t minor;
+	int64_t section_len;
+	uint32_t len2;
+} __attribute__((packed));
+
+struct pcapng_idb {
+	uint32_t type;
+	uint32_t len;
+	uint16_t linktype;
+	uint16_t reserved;
+	uint32_t snaplen;
+	/* if_tsresol: nanoseconds */
+	uint16_t opt_tsresol_code;
+	uint16_t opt_tsresol_len;
+	uint8_t opt_tsresol_val;
+	uint8_t opt_tsresol_pad[3];
+	/* opt_endofopt */
+	uint32_t opt_end;
+	uint32_t len2;
+} __attribute__((packed));
+
+struct pcapng_epb {
+	uint32_t type;
+	uint32_t len;
+	uint32_t if_id;
+	uint32_t ts_high;
+	uint32_t ts_low;
+	uint32_t cap_len;
+	uint32_t orig_len;
+	uint8_t data[0];	/* padded to 32 bit, followed by the length again */
+} __attribute__((packed));
+
+struct cap_ipv4_udp {
+	uint8_t ver_ihl;
+	uint8_t tos;
+	uint16_t tot_len;
+	uint16_t id;
+	uint16_t frag_off;
+	uint8_t ttl;
+	uint8_t protocol;
+	uint16_t check;
+	uint32_t saddr;
+	uint32_t daddr;
+	uint16_t sport;
+	uint16_t dport;
+	uint16_t udp_len;
+	uint16_t udp_check;
+} __attribute__((packed));
+
+struct pcap_capture {
+	char *path;		/* name given by the user */
+	char *cur_path;		/* name of the current file */
+	unsigned int max_files;
+	size_t file_size;
+
+	int fd;
+	uint8_t *map;
+	size_t used;
+
+	uint64_t num_pkts;
+	uint64_t num_files;
+};
+
+static void cap_file_close(struct pcap_capture *cap)
+{
+	if (cap->map != NULL) {
+		munmap(cap->map, cap->file_size);
+		cap->map = NULL;
+	}
+	if (cap->fd >= 0) {
+		/* drop the unused (zero) tail, so that the file is valid pcapng */
+		if (ftruncate(cap->fd, cap->used) != 0)
+			LOGP(DLGLOBAL, LOGL_ERROR, "pcap-capture: failed to truncate %s: %s\n",
+			     cap->cur_path, strerror(errno));
+		close(cap->fd);
+		cap->fd = -1;
+	}
+}
+
+static int cap_file_open(struct pcap_capture *cap)
+{
+	struct pcapng_shb *shb;
+	struct pcapng_idb *idb;
+
+	talloc_free(cap->cur_path);
+	cap->cur_path = talloc_asprintf(cap, "%s.%u", cap->path,
+					(unsigned int) (cap->num_files % cap->max_files));
+
+	cap->fd = open(cap->cur_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (cap->fd < 0)
+		return -errno;
+	if (ftruncate(cap->fd, cap->file_size) != 0)
+		return -errno;
+
+	cap->map = mmap(NULL, cap->file_size, PROT_READ | PROT_WRITE, MAP_SHARED, cap->fd, 0);
+	if (cap->map == MAP_FAILED) {
+		cap->map = NULL;
+		return -errno;
+	}
+
+	shb = (struct pcapng_shb *) cap->map;
+	*shb = (struct pcapng_shb) {
+		.type = PCAPNG_BT_SHB,
+		.len = sizeof(*shb),
+		.byte_order_magic = PCAPNG_BYTE_ORDER_MAGIC,
+		.major = 1,
+		.minor = 0,
+		.section_len = -1,
+		.len2 = sizeof(*shb),
+	};
+	idb = (struct pcapng_idb *) (cap->map + sizeof(*shb));
+	*idb = (struct pcapng_idb) {
+		.type = PCAPNG_BT_IDB,
+		.len = sizeof(*idb),
+		.linktype = LINKTYPE_IPV4,
+		.snaplen = CAP_SNAPLEN,
+		.opt_tsresol_code = PCAPNG_OPT_IF_TSRESOL,
+		.opt_tsresol_len = 1,
+		.opt_tsresol_val = 9,
+		.len2 = sizeof(*idb),
+	};
+
+	cap->used = sizeof(*shb) + sizeof(*idb);
+	cap->num_files++;
+	return 0;
+}
+
+static int cap_destructor(struct pcap_capture *cap)
+{
+	cap_file_close(cap);
+	return 0;
+}
+
+/*! start capturing into (new) files
+ *  \param[in] ctx talloc context to allocate from
+ *  \param[in] path base name of the files (PATH.0, PATH.1, ... are truncated if they exist)
+ *  \param[in] file_size max. size of each file in bytes
+ *  \param[in] max_files number of files to rotate through
+ *  \returns capture state on success; NULL on error (errno is set) */
+struct pcap_capture *pcap_capture_start(void *ctx, const char *path, size_t file_size,
+					unsigned int max_files)
+{
+	struct pcap_capture *cap;
+	int rc;
+
+	if (file_size < CAP_MIN_FILE_SIZE || max_files == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	cap = talloc_zero(ctx, struct pcap_capture);
+	if (cap == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	cap->fd = -1;
+	cap->path = talloc_strdup(cap, path);
+	cap->file_size = file_size & ~(size_t) 3;
+	cap->max_files = max_files;
+	talloc_set_destructor(cap, cap_destructor);
+
+	rc = cap_file_open(cap);
+	if (rc < 0) {
+		talloc_free(cap);
+		errno = -rc;
+		return NULL;
+	}
+
+	return cap;
+}
+
+/*! stop capturing, truncate and close the current file */
+void pcap_capture_stop(struct pcap_capture *cap)
+{
+	talloc_free(cap);
+}
+
+void pcap_capture_get_stats(const struct pcap_capture *cap, struct pcap_capture_stats *st)
+{
+	*st = (struct pcap_capture_stats) {
+		.num_pkts = cap->num_pkts,
+		.num_files = cap->num_files,
+		.used = cap->used,
+		.file_size = cap->file_size,
+		.path = cap->cur_path,
+	};
+}
+
+static uint16_t ipv4_csum(const void *hdr, size_t len)
+{
+	const uint16_t *p = hdr;
+	uint32_t sum = 0;
+
+	for (; len > 1; len -= 2)
+		sum += *p++;
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum;
+}
+
+/* Reserve an EPB for an IPv4/UDP packet with the given UDP payload length,
+ * rotating to the next file if needed.  Returns the UDP payload, NULL if
+ * the packet cannot be written. */
+static uint8_t *cap_udp_pkt_start(struct pcap_capture *cap, uint32_t saddr, uint16_t sport,
+				  uint32_t daddr, uint16_t dport, size_t pl_len)
+{
+	size_t pkt_len = sizeof(struct cap_ipv4_udp) + pl_len;
+	size_t blk_len = sizeof(struct pcapng_epb) + CAP_PAD4(pkt_len) + sizeof(uint32_t);
+	struct cap_ipv4_udp *ip;
+	struct pcapng_epb *epb;
+	struct timespec ts;
+	uint64_t ts_ns;
+
+	if (OSMO_UNLIKELY(blk_len > CAP_PKT_MAX))
+		return NULL;
+
+	if (OSMO_UNLIKELY(cap->used + blk_len > cap->file_size)) {
+		cap_file_close(cap);
+		if (cap_file_open(cap) < 0) {
+			LOGP(DLGLOBAL, LOGL_ERROR, "pcap-capture: failed to start %s: %s\n",
+			     cap->cur_path, strerror(errno));
+			cap_file_close(cap);
+			return NULL;
+		}
+	}
+	if (OSMO_UNLIKELY(cap->map == NULL))
+		return NULL;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts_ns = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+	epb = (struct pcapng_epb *) (cap->map + cap->used);
+	*epb = (struct pcapng_epb) {
+		.type = PCAPNG_BT_EPB,
+		.len = blk_len,
+		.if_id = 0,
+		.ts_high = ts_ns >> 32,
+		.ts_low = ts_ns & 0xffffffff,
+		.cap_len = pkt_len,
+		.orig_len = pkt_len,
+	};
+	/* the file was zero-filled by ftruncate(), so the padding is zero */
+	memcpy(cap->map + cap->used + blk_len - sizeof(uint32_t), &epb->len, sizeof(uint32_t));
+
+	ip = (struct cap_ipv4_udp *) epb->data;
+	*ip = (struct cap_ipv4_udp) {
+		.ver_ihl = 0x45,
+		.tot_len = htons(pkt_len),
+		.ttl = 64,
+		.protocol = IPPROTO_UDP,
+		.saddr = saddr,
+		.daddr = daddr,
+		.sport = htons(sport),
+		.dport = htons(dport),
+		.udp_len = htons(pkt_len - 20),
+	};
+	ip->check = ipv4_csum(ip, 20);
+
+	cap->used += blk_len;
+	cap->num_pkts++;
+
+	return epb->data + sizeof(*ip);
+}
+
+/*! write a GSMTAP Um frame, takes the same arguments as gsmtap_send() */
+void pcap_capture_gsmtap(struct pcap_capture *cap, uint16_t arfcn, uint8_t ts,
+			 uint8_t chan_type, uint8_t ss, uint32_t fn,
+			 int8_t signal_dbm, int8_t snr, const uint8_t *data,
+			 unsigned int len)
+{
+	const uint32_t lo = htonl(INADDR_LOOPBACK);
+	struct gsmtap_hdr *gh;
+	uint8_t *pl;
+
+	pl = cap_udp_pkt_start(cap, lo, GSMTAP_UDP_PORT, lo, GSMTAP_UDP_PORT, sizeof(*gh) + len);
+	if (pl == NULL)
+		return;
+
+	gh = (struct gsmtap_hdr *) pl;
+	*gh = (struct gsmtap_hdr) {
+		.version = GSMTAP_VERSION,
+		.hdr_len = sizeof(*gh) / 4,
+		.type = GSMTAP_TYPE_UM,
+		.timeslot = ts,
+		.sub_slot = ss,
+		.arfcn = htons(arfcn),
+		.signal_dbm = signal_dbm,
+		.snr_db = snr,
+		.frame_number = htonl(fn),
+		.sub_type = chan_type,
+	};
+	memcpy(pl + sizeof(*gh), data, len);
+}
+
+/*! write an RTP packet of an lchan
+ *  \param[in] uplink true for BTS -> remote, false for remote -> BTS
+ *  \param[in] seq RTP sequence number (Uplink: ignored)
+ *  \param[in] timestamp RTP timestamp (Uplink: the TDMA frame number) */
+void pcap_capture_rtp(struct pcap_capture *cap, const struct gsm_lchan *lchan, bool uplink,
+		      uint16_t seq, uint32_t timestamp, bool marker,
+		      const uint8_t *pl, unsigned int pl_len)
+{
+	const uint32_t local_ip = htonl(lchan->abis_ip.bound_ip);
+	const uint32_t remote_ip = lchan->abis_ip.connect_ip;
+	uint8_t *rtp;
+
+	if (uplink) {
+		/* 8000 samples per second, 26 TDMA frames per 120 ms */
+		timestamp = (uint64_t) timestamp * 8 * 120 / 26;
+		seq = timestamp / 160; /* 20 ms per frame */
+		rtp = cap_udp_pkt_start(cap, local_ip, lchan->abis_ip.bound_port,
+					remote_ip, lchan->abis_ip.connect_port, 12 + pl_len);
+	} else {
+		rtp = cap_udp_pkt_start(cap, remote_ip, lchan->abis_ip.connect_port,
+					local_ip, lchan->abis_ip.bound_port, 12 + pl_len);
+	}
+	if (rtp == NULL)
+		return;
+
+	rtp[0] = 0x80; /* version 2 */
+	rtp[1] = (marker ? 0x80 : 0x00) | (lchan->abis_ip.rtp_payload & 0x7f);
+	osmo_store16be(seq, &rtp[2]);
+	osmo_store32be(timestamp, &rtp[4]);
+	osmo_store32be(lchan->abis_ip.conn_id, &rtp[8]); /* SSRC */
+	memcpy(&rtp[12], pl, pl_len);
+}
@@ -17,6 +17,7 @@
  *
  */
 
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -26,10 +27,13 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/rate_ctr.h>
 #include <osmocom/core/socket.h>
 #include <osmocom/core/write_queue.h>
 #include <osmocom/gsm/gsm23003.h>
@@ -45,9 +49,16 @@
 #include <osmo-bts/l1sap.h>
 #include <osmo-bts/oml.h>
 #include <osmo-bts/abis_osmo.h>
+#include <osmo-bts/trace.h>
 
 uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx);
 
+static int pcu_sock_send_state(struct pcu_sock_state *state, struct msgb *msg);
+static int pcu_sock_send_all(struct msgb *msg);
+static struct pcu_sock_state *pcu_sock_state_trx(const struct gsm_bts_trx *trx);
+static bool pcu_sock_connected(const struct pcu_sock_state *state);
+static bool pcu_any_connected(void);
+
 int pcu_direct = 0;
 static int avail_lai = 0, avail_nse = 0, avail_cell = 0, avail_nsvc[2] = {0, 0};
 
@@ -67,14 +78,75 @@ static const char *sapi_string[] = {
  * PCU messages
  */
 
+/* The per-block primitives (RTS.req, DATA.ind, TIME.ind, INTERF.ind) are
+ * allocated at a high rate and freed as soon as they have been written to
+ * the PCU socket.  Like for the RSL messages (see rsl.c), the msgbs (all of
+ * the same size) are recycled via a talloc destructor.  Not thread-safe:
+ * main thread only. */
+#define PCU_MSGB_POOL_MAX 64 /* max. number of pooled msgbs */
+
+static struct pcu_msgb_pool g_pcu_msgb_pool = {
+	.free = LLIST_HEAD_INIT(g_pcu_msgb_pool.free),
+};
+
+const struct pcu_msgb_pool *pcu_msgb_pool_get(void)
+{
+	return &g_pcu_msgb_pool;
+}
+
+/* called by talloc_free(), i.e. by msgb_free() */
+static int pcu_msgb_pool_destructor(struct msgb *msg)
+{
+	struct pcu_msgb_pool *pool = &g_pcu_msgb_pool;
+
+	OSMO_ASSERT(msg->data_len == sizeof(struct gsm_pcu_if));
+	pool->in_use--;
+
+	if (pool->free_len >= PCU_MSGB_POOL_MAX)
+		return 0; /* actually free it */
+
+	talloc_set_destructor(msg, NULL);
+	llist_add(&msg->list, &pool->free);
+	pool->free_len++;
+
+	return -1; /* keep the memory */
+}
+
+/* reset a recycled msgb to the state msgb_alloc() leaves it in */
+static void pcu_msgb_pool_reset(struct msgb *msg)
+{
+	uint16_t data_len = msg->data_len;
+
+	memset(msg, 0, sizeof(*msg) + data_len);
+	msg->data_len = data_len;
+	msg->data = msg->_data;
+	msg->head = msg->_data;
+	msg->tail = msg->_data;
+}
+
 struct msgb *pcu_msgb_alloc(uint8_t msg_type, uint8_t bts_nr)
 {
+	struct pcu_msgb_pool *pool = &g_pcu_msgb_pool;
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
 
-	msg = msgb_alloc(sizeof(struct gsm_pcu_if), "pcu_sock_tx");
-	if (!msg)
-		return NULL;
+	if (OSMO_LIKELY(!llist_empty(&pool->free))) {
+		msg = llist_first_entry(&pool->free, struct msgb, list);
+		llist_del(&msg->list);
+		pool->free_len--;
+		pcu_msgb_pool_reset(msg);
+		pool->hits++;
+	} else {
+		msg = msgb_alloc(sizeof(struct gsm_pcu_if), "pcu_sock_tx");
+		if (!msg)
+			return NULL;
+		pool->misses++;
+	}
+
+	talloc_set_destructor(msg, pcu_msgb_pool_destructor);
+	if (++pool->in_use > pool->in_use_max)
+		pool->in_use_max = pool->in_use;
+
 	msgb_put(msg, sizeof(struct gsm_pcu_if));
 	pcu_prim = (struct gsm_pcu_if *) msg->data;
 	pcu_prim->msg_type = msg_type;
@@ -232,7 +304,8 @@ static void info_ind_fill_trx(struct gsm_pcu_if_info_trx *trx_info,
 	}
 }
 
-int pcu_tx_info_ind(void)
+/* Send INFO.ind to one PCU socket, with only the PDCH of the TRX it serves */
+static int pcu_tx_info_ind_state(struct pcu_sock_state *state)
 {
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
@@ -357,10 +430,31 @@ int pcu_tx_info_ind(void)
 			break;
 		}
 
+		/* served by another PCU: the TRX has no PDCH for this one */
+		if (pcu_sock_state_trx(trx) != state)
+			continue;
+
 		info_ind_fill_trx(&info_ind->trx[trx->nr], trx);
 	}
 
-	return pcu_sock_send(msg);
+	return pcu_sock_send_state(state, msg);
+}
+
+int pcu_tx_info_ind(void)
+{
+	struct pcu_sock_state **states = g_bts_sm->gprs.pcu_state;
+	unsigned int i;
+	int rc;
+
+	/* the primary PCU, even if not connected, for the return value */
+	rc = pcu_tx_info_ind_state(states[0]);
+
+	for (i = 1; i < PCU_SOCK_NUM_MAX; i++) {
+		if (pcu_sock_connected(states[i]))
+			pcu_tx_info_ind_state(states[i]);
+	}
+
+	return rc;
 }
 
 static int pcu_if_signal_cb(unsigned int subsys, unsigned int signal,
@@ -407,8 +501,8 @@ static int pcu_if_signal_cb(unsigned int subsys, unsigned int signal,
 		return -EINVAL;
 	}
 
-	/* Do not send INFO.ind if PCU is not connected */
-	if (!pcu_connected())
+	/* Do not send INFO.ind if no PCU is connected */
+	if (!pcu_any_connected())
 		return 0;
 
 	/* If all infos have been received, of if one info is updated after
@@ -437,7 +531,7 @@ int pcu_tx_app_info_req(struct gsm_bts *bts, uint8_t app_type, uint8_t len, cons
 	ai_req->len = len;
 	memcpy(ai_req->data, app_data, ai_req->len);
 
-	return pcu_sock_send(msg);
+	return pcu_sock_send_all(msg);
 }
 
 int pcu_tx_rts_req(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
@@ -464,26 +558,32 @@ int pcu_tx_rts_req(struct gsm_bts_trx_ts *ts, uint8_t is_ptcch, uint32_t fn,
 	rts_req->ts_nr = ts->nr;
 	rts_req->block_nr = block_nr;
 
-	return pcu_sock_send(msg);
+	return pcu_sock_send_state(pcu_sock_state_trx(ts->trx), msg);
 }
 
-int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t sapi, uint32_t fn,
-	uint16_t arfcn, uint8_t block_nr, uint8_t *data, uint8_t len,
-	int8_t rssi, uint16_t ber10k, int16_t bto, int16_t lqual)
+struct msgb *pcu_data_ind_alloc(const struct gsm_bts *bts, uint8_t **data)
 {
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
-	struct gsm_pcu_if_data *data_ind;
-	struct gsm_bts *bts = ts->trx->bts;
-
-	LOGP(DPCU, LOGL_DEBUG, "Sending data indication: sapi=%s arfcn=%d block=%d data=%s\n",
-	     sapi_string[sapi], arfcn, block_nr, osmo_hexdump(data, len));
 
 	msg = pcu_msgb_alloc(PCU_IF_MSG_DATA_IND, bts->nr);
 	if (!msg)
-		return -ENOMEM;
+		return NULL;
 	pcu_prim = (struct gsm_pcu_if *) msg->data;
-	data_ind = &pcu_prim->u.data_ind;
+	*data = &pcu_prim->u.data_ind.data[0];
+
+	return msg;
+}
+
+int pcu_data_ind_send(struct gsm_bts_trx_ts *ts, struct msgb *msg, uint8_t sapi, uint32_t fn,
+	uint16_t arfcn, uint8_t block_nr, uint8_t len,
+	int8_t rssi, uint16_t ber10k, int16_t bto, int16_t lqual)
+{
+	struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) msg->data;
+	struct gsm_pcu_if_data *data_ind = &pcu_prim->u.data_ind;
+
+	LOGP(DPCU, LOGL_DEBUG, "Sending data indication: sapi=%s arfcn=%d block=%d data=%s\n",
+	     sapi_string[sapi], arfcn, block_nr, osmo_hexdump(data_ind->data, len));
 
 	data_ind->sapi = sapi;
 	data_ind->rssi = rssi;
@@ -495,20 +595,48 @@ int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t sapi, uint32_t fn,
 	data_ind->ber10k = ber10k;
 	data_ind->ta_offs_qbits = bto;
 	data_ind->lqual_cb = lqual;
-	if (len)
-		memcpy(data_ind->data, data, len);
 	data_ind->len = len;
 
-	return pcu_sock_send(msg);
+	/* System Information is needed by every PCU */
+	if (sapi == PCU_IF_SAPI_BCCH)
+		return pcu_sock_send_all(msg);
+	return pcu_sock_send_state(pcu_sock_state_trx(ts->trx), msg);
+}
+
+int pcu_tx_data_ind(struct gsm_bts_trx_ts *ts, uint8_t sapi, uint32_t fn,
+	uint16_t arfcn, uint8_t block_nr, uint8_t *data, uint8_t len,
+	int8_t rssi, uint16_t ber10k, int16_t bto, int16_t lqual)
+{
+	struct msgb *msg;
+	uint8_t *payload;
+
+	msg = pcu_data_ind_alloc(ts->trx->bts, &payload);
+	if (!msg)
+		return -ENOMEM;
+	if (len)
+		memcpy(payload, data, len);
+
+	return pcu_data_ind_send(ts, msg, sapi, fn, arfcn, block_nr, len,
+				 rssi, ber10k, bto, lqual);
 }
 
 int pcu_tx_rach_ind(uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr,
 		    int16_t qta, uint16_t ra, uint32_t fn, uint8_t is_11bit,
 		    enum ph_burst_type burst_type, uint8_t sapi)
 {
+	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state[0];
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
 	struct gsm_pcu_if_rach_ind *rach_ind;
+	const struct gsm_bts_trx *trx;
+	const struct gsm_bts *bts;
+
+	/* Access Bursts on a PDCH go to the PCU serving it, the ones
+	 * on the RACH (CCCH) to the primary PCU */
+	if (sapi != PCU_IF_SAPI_RACH &&
+	    (bts = gsm_bts_num(g_bts_sm, bts_nr)) != NULL &&
+	    (trx = gsm_bts_trx_num(bts, trx_nr)) != NULL)
+		state = pcu_sock_state_trx(trx);
 
 	LOGP(DPCU, LOGL_INFO, "Sending RACH indication: qta=%d, ra=%d, "
 		"fn=%d\n", qta, ra, fn);
@@ -528,10 +656,16 @@ int pcu_tx_rach_ind(uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr,
 	rach_ind->trx_nr = trx_nr;
 	rach_ind->ts_nr = ts_nr;
 
-	return pcu_sock_send(msg);
+	return pcu_sock_send_state(state, msg);
 }
 
-int pcu_tx_time_ind(uint32_t fn)
+/*! Send a TIME.ind to the PCU, if fn starts a MAC block.
+ *  \param[in] bts BTS instance.
+ *  \param[in] fn current TDMA frame number.
+ *  \param[in] discont whether fn does not follow the previous frame number;
+ *  the TIME.ind is then sent regardless of 'pcu-time-ind-interval'.
+ *  \returns 0 on success (or if skipped); negative on error. */
+int pcu_tx_time_ind(struct gsm_bts *bts, uint32_t fn, bool discont)
 {
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
@@ -542,6 +676,18 @@ int pcu_tx_time_ind(uint32_t fn)
 	if (fn13 != 0 && fn13 != 4 && fn13 != 8)
 		return 0;
 
+	/* don't allocate a msgb (every block) just to drop it */
+	if (!pcu_any_connected())
+		return -EIO;
+
+	/* The PCU learns the FN from RTS.req/DATA.ind as well, so optionally
+	 * TIME.ind is sent every N-th block only (and on FN discontinuities) */
+	if (bts->pcu.time_ind_skip > 0 && !discont) {
+		bts->pcu.time_ind_skip--;
+		return 0;
+	}
+	bts->pcu.time_ind_skip = bts->pcu.time_ind_interval - 1;
+
 	msg = pcu_msgb_alloc(PCU_IF_MSG_TIME_IND, 0);
 	if (!msg)
 		return -ENOMEM;
@@ -550,7 +696,8 @@ int pcu_tx_time_ind(uint32_t fn)
 
 	time_ind->fn = fn;
 
-	return pcu_sock_send(msg);
+	/* every PCU needs the clock */
+	return pcu_sock_send_all(msg);
 }
 
 int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn)
@@ -560,6 +707,9 @@ int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn)
 	struct msgb *msg;
 	unsigned int tn;
 
+	if (!pcu_connected_trx(trx))
+		return -EIO;
+
 	msg = pcu_msgb_alloc(PCU_IF_MSG_INTERF_IND, trx->bts->nr);
 	if (!msg)
 		return -ENOMEM;
@@ -583,12 +733,12 @@ int pcu_tx_interf_ind(const struct gsm_bts_trx *trx, uint32_t fn)
 		interf_ind->interf[tn] = -1 * lchan->meas.interf_meas_avg_dbm;
 	}
 
-	return pcu_sock_send(msg);
+	return pcu_sock_send_state(pcu_sock_state_trx(trx), msg);
 }
 
 int pcu_tx_pag_req(const uint8_t *identity_lv, uint8_t chan_needed)
 {
-	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
+	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state[0];
 	struct msgb *msg;
 	struct gsm_pcu_if *pcu_prim;
 	struct gsm_pcu_if_pag_req *pag_req;
@@ -660,7 +810,7 @@ int pcu_tx_susp_req(struct gsm_lchan *lchan, uint32_t tlli, const uint8_t *ra_id
 	return pcu_sock_send(msg);
 }
 
-static int pcu_rx_data_req(struct gsm_bts *bts, uint8_t msg_type,
+static int pcu_rx_data_req(struct pcu_sock_state *state, struct gsm_bts *bts, uint8_t msg_type,
 	const struct gsm_pcu_if_data *data_req)
 {
 	uint8_t is_ptcch;
@@ -674,6 +824,14 @@ static int pcu_rx_data_req(struct gsm_bts *bts, uint8_t msg_type,
 		data_req->arfcn, data_req->block_nr,
 		osmo_hexdump(data_req->data, data_req->len));
 
+	/* CCCH is served by the primary PCU only */
+	if ((data_req->sapi == PCU_IF_SAPI_PCH_2 || data_req->sapi == PCU_IF_SAPI_AGCH_2) &&
+	    state != g_bts_sm->gprs.pcu_state[0]) {
+		LOGP(DPCU, LOGL_ERROR, "Received PCU data request for sapi %s "
+		     "on a PCU socket shard\n", sapi_string[data_req->sapi]);
+		return -EINVAL;
+	}
+
 	switch (data_req->sapi) {
 	case PCU_IF_SAPI_PCH_2:
 	{
@@ -729,6 +887,12 @@ static int pcu_rx_data_req(struct gsm_bts *bts, uint8_t msg_type,
 			rc = -EINVAL;
 			break;
 		}
+		if (pcu_sock_state_trx(trx) != state) {
+			LOGPTRX(trx, DPCU, LOGL_ERROR, "Received PCU data request "
+				"from a PCU not serving this TRX\n");
+			rc = -EINVAL;
+			break;
+		}
 		ts = &trx->ts[data_req->ts_nr];
 		if (!ts_should_be_pdch(ts)) {
 			LOGP(DPCU, LOGL_ERROR, "%s: Received PCU DATA request for non-PDCH TS\n",
@@ -836,7 +1000,7 @@ static int pcu_tx_si_all(struct gsm_bts *bts)
 	return 0;
 }
 
-static int pcu_rx_txt_ind(struct gsm_bts *bts,
+static int pcu_rx_txt_ind(struct pcu_sock_state *state, struct gsm_bts *bts,
 			  struct gsm_pcu_if_txt_ind *txt)
 {
 	int rc;
@@ -845,6 +1009,14 @@ static int pcu_rx_txt_ind(struct gsm_bts *bts,
 	case PCU_VERSION:
 		LOGP(DPCU, LOGL_INFO, "OsmoPCU version %s connected\n",
 		     txt->text);
+		/* GPRS is advertised (and its version reported) as long
+		 * as the primary PCU is connected, a shard only needs SI */
+		if (state != g_bts_sm->gprs.pcu_state[0]) {
+			rc = pcu_tx_si_all(bts);
+			if (rc < 0)
+				return -EINVAL;
+			break;
+		}
 		oml_tx_failure_event_rep(&bts->gprs.cell.mo, NM_SEVER_CEASED, OSMO_EVT_PCU_VERS, txt->text);
 		osmo_strlcpy(bts->pcu_version, txt->text, MAX_VERSION_LENGTH);
 
@@ -870,7 +1042,7 @@ static int pcu_rx_txt_ind(struct gsm_bts *bts,
 	return 0;
 }
 
-static int pcu_rx_act_req(struct gsm_bts *bts,
+static int pcu_rx_act_req(struct pcu_sock_state *state, struct gsm_bts *bts,
 	const struct gsm_pcu_if_act_req *act_req)
 {
 	struct gsm_bts_trx *trx;
@@ -883,6 +1055,11 @@ static int pcu_rx_act_req(struct gsm_bts *bts,
 	trx = gsm_bts_trx_num(bts, act_req->trx_nr);
 	if (!trx || act_req->ts_nr >= 8)
 		return -EINVAL;
+	if (pcu_sock_state_trx(trx) != state) {
+		LOGPTRX(trx, DPCU, LOGL_ERROR, "%s request from a PCU not serving this TRX\n",
+			(act_req->activate) ? "Activate" : "Deactivate");
+		return -EINVAL;
+	}
 
 	lchan = trx->ts[act_req->ts_nr].lchan;
 	lchan->rel_act_kind = LCHAN_REL_ACT_PCU;
@@ -918,7 +1095,10 @@ static int pcu_rx_act_req(struct gsm_bts *bts,
 			return -EINVAL; \
 		} \
 	} while (0)
-static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len)
+/* rx_msg holds the primitive in its data area (pcu_prim, but not yet put).
+ * It may be taken over by forwarding it, in which case *rx_msg is cleared. */
+static int pcu_rx(struct pcu_sock_state *state, uint8_t msg_type, struct gsm_pcu_if *pcu_prim,
+		  size_t prim_len, struct msgb **rx_msg)
 {
 	int rc = 0;
 	struct gsm_bts *bts;
@@ -932,7 +1112,7 @@ static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len
 	switch (msg_type) {
 	case PCU_IF_MSG_DATA_REQ:
 		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.data_req);
-		rc = pcu_rx_data_req(bts, msg_type, &pcu_prim->u.data_req);
+		rc = pcu_rx_data_req(state, bts, msg_type, &pcu_prim->u.data_req);
 		break;
 	case PCU_IF_MSG_PAG_REQ:
 		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.pag_req);
@@ -940,11 +1120,11 @@ static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len
 		break;
 	case PCU_IF_MSG_ACT_REQ:
 		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.act_req);
-		rc = pcu_rx_act_req(bts, &pcu_prim->u.act_req);
+		rc = pcu_rx_act_req(state, bts, &pcu_prim->u.act_req);
 		break;
 	case PCU_IF_MSG_TXT_IND:
 		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.txt_ind);
-		rc = pcu_rx_txt_ind(bts, &pcu_prim->u.txt_ind);
+		rc = pcu_rx_txt_ind(state, bts, &pcu_prim->u.txt_ind);
 		break;
 	case PCU_IF_MSG_CONTAINER:
 		CHECK_IF_MSG_SIZE(prim_len, pcu_prim->u.container);
@@ -955,7 +1135,10 @@ static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len
 			     "container size is %zu, discarding\n", prim_len, exp_len);
 			return -EINVAL;
 		}
-		rc = abis_osmo_pcu_tx_container(bts, &pcu_prim->u.container);
+		/* Forward the receive buffer itself, trimmed to the container */
+		msgb_put(*rx_msg, exp_len);
+		rc = abis_osmo_pcu_tx_container(bts, *rx_msg);
+		*rx_msg = NULL;
 		break;
 	default:
 		LOGP(DPCU, LOGL_ERROR, "Received unknown PCU msg type %d\n",
@@ -970,26 +1153,234 @@ static int pcu_rx(uint8_t msg_type, struct gsm_pcu_if *pcu_prim, size_t prim_len
  * PCU socket interface
  */
 
+/* Max. number of primitives received/sent per recvmmsg()/sendmmsg() call */
+#define PCU_SOCK_BATCH 16
+
+/* Time the upqueue may stay full (shedding primitives) before the
+ * connection to the PCU is considered dead and closed */
+#define PCU_SOCK_OVERLOAD_MS 2000
+
+/* Size of the receive buffers: the largest primitive plus room for the
+ * IPA headers in case a container is forwarded to the BSC in place */
+#define PCU_SOCK_RX_BUF_SIZE (ABIS_OSMO_HEADROOM_SIZE + sizeof(struct gsm_pcu_if) + 1000)
+
 struct pcu_sock_state {
+	uint8_t nr;			/* index in g_bts_sm->gprs.pcu_state[] */
 	struct osmo_fd listen_bfd;	/* fd for listen socket */
 	struct osmo_wqueue upqueue;	/* For sending messages; has fd for conn. to PCU */
+	unsigned int upqueue_len_max;	/* high-water mark of the upqueue length */
+	struct timespec overload_since;	/* when the upqueue became full (zero if not full) */
+	struct msgb *rx_msg[PCU_SOCK_BATCH]; /* receive buffers of pcu_sock_read() */
 };
 
 static void pcu_sock_close(struct pcu_sock_state *state);
 
+/* Return the counter for shedding the primitive, or -1 if it must not be
+ * shed: RTS.req and DATA.ind are of no use once the PCU lags behind by a
+ * full queue, TIME.ind and INTERF.ind are superseded by the next one.
+ * INFO.ind is only ever superseded (see pcu_prim_sheddable()). */
+static int pcu_prim_shed_ctr(const struct gsm_pcu_if *pcu_prim)
+{
+	switch (pcu_prim->msg_type) {
+	case PCU_IF_MSG_INFO_IND:
+		return BTS_CTR_PCU_SHED_INFO;
+	case PCU_IF_MSG_RTS_REQ:
+		return BTS_CTR_PCU_SHED_RTS;
+	case PCU_IF_MSG_DATA_IND:
+		return BTS_CTR_PCU_SHED_DATA;
+	case PCU_IF_MSG_TIME_IND:
+		return BTS_CTR_PCU_SHED_TIME;
+	case PCU_IF_MSG_INTERF_IND:
+		return BTS_CTR_PCU_SHED_INTERF;
+	default:
+		return -1;
+	}
+}
+
+/* Whether the primitive may be shed to make room in a full queue */
+static bool pcu_prim_sheddable(const struct gsm_pcu_if *pcu_prim)
+{
+	return pcu_prim->msg_type != PCU_IF_MSG_INFO_IND && pcu_prim_shed_ctr(pcu_prim) >= 0;
+}
+
+/* Find a queued primitive superseded by pcu_prim (TIME.ind, INTERF.ind of the
+ * same TRX, INFO.ind: each of them carries the complete current state) */
+static struct msgb *pcu_sock_find_superseded(struct osmo_wqueue *queue, const struct gsm_pcu_if *pcu_prim)
+{
+	struct msgb *msg;
+
+	if (pcu_prim->msg_type != PCU_IF_MSG_INFO_IND &&
+	    pcu_prim->msg_type != PCU_IF_MSG_TIME_IND &&
+	    pcu_prim->msg_type != PCU_IF_MSG_INTERF_IND)
+		return NULL;
+
+	llist_for_each_entry(msg, &queue->msg_queue, list) {
+		const struct gsm_pcu_if *queued = (const struct gsm_pcu_if *) msg->data;
+
+		if (queued->msg_type != pcu_prim->msg_type || queued->bts_nr != pcu_prim->bts_nr)
+			continue;
+		if (queued->msg_type == PCU_IF_MSG_INTERF_IND &&
+		    queued->u.interf_ind.trx_nr != pcu_prim->u.interf_ind.trx_nr)
+			continue;
+		return msg;
+	}
+
+	return NULL;
+}
+
+/* Find the oldest queued primitive which may be shed */
+static struct msgb *pcu_sock_find_sheddable(struct osmo_wqueue *queue)
+{
+	struct msgb *msg;
+
+	llist_for_each_entry(msg, &queue->msg_queue, list) {
+		if (pcu_prim_sheddable((const struct gsm_pcu_if *) msg->data))
+			return msg;
+	}
+
+	return NULL;
+}
+
+/* Drop a primitive (queued or not) and account it */
+static void pcu_sock_shed(struct pcu_sock_state *state, struct gsm_bts *bts, struct msgb *msg, bool queued)
+{
+	int ctr = pcu_prim_shed_ctr((const struct gsm_pcu_if *) msg->data);
+
+	OSMO_ASSERT(ctr >= 0);
+	rate_ctr_inc2(bts->ctrs, ctr);
+
+	if (queued) {
+		llist_del(&msg->list);
+		state->upqueue.current_length--;
+	}
+	msgb_free(msg);
+}
+
+/* Enqueue a primitive for the PCU.  Instead of closing the connection as
+ * soon as the queue is full, primitives are shed (see pcu_prim_sheddable()).
+ * Only if the queue stays full for PCU_SOCK_OVERLOAD_MS, or if it is full
+ * of primitives which must not be shed, -ENOSPC is returned. */
+static int pcu_sock_enqueue(struct pcu_sock_state *state, struct msgb *msg)
+{
+	const struct gsm_pcu_if *pcu_prim = (const struct gsm_pcu_if *) msg->data;
+	struct osmo_wqueue *queue = &state->upqueue;
+	struct gsm_bts *bts;
+	struct msgb *old;
+	struct timespec now;
+	int rc;
+
+	/* FIXME: allow multiple BTS */
+	bts = llist_entry(g_bts_sm->bts_list.next, struct gsm_bts, list);
+
+	/* the new primitive takes the place of the superseded one in the queue */
+	if ((old = pcu_sock_find_superseded(queue, pcu_prim)) != NULL) {
+		llist_add(&msg->list, &old->list);
+		llist_del(&old->list);
+		pcu_sock_shed(state, bts, old, false);
+		return 0;
+	}
+
+	if (queue->current_length < queue->max_length) {
+		state->overload_since = (struct timespec) { 0 };
+	} else {
+		osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+		if (state->overload_since.tv_sec == 0 && state->overload_since.tv_nsec == 0) {
+			LOGP(DPCU, LOGL_NOTICE, "PCU socket queue full (%u messages), shedding primitives\n",
+			     queue->max_length);
+			state->overload_since = now;
+		} else if ((now.tv_sec - state->overload_since.tv_sec) * 1000
+			   + (now.tv_nsec - state->overload_since.tv_nsec) / 1000000 > PCU_SOCK_OVERLOAD_MS) {
+			return -ENOSPC;
+		}
+
+		if ((old = pcu_sock_find_sheddable(queue)) != NULL) {
+			pcu_sock_shed(state, bts, old, true);
+		} else if (pcu_prim_sheddable(pcu_prim)) {
+			pcu_sock_shed(state, bts, msg, false);
+			return 0;
+		} else {
+			return -ENOSPC;
+		}
+	}
+
+	rc = osmo_wqueue_enqueue(queue, msg);
+	if (rc < 0)
+		return rc;
+
+	if (queue->current_length > state->upqueue_len_max)
+		state->upqueue_len_max = queue->current_length;
+
+	return 0;
+}
+
+/*! Get the length of the queue of primitives towards the PCU.
+ *  \param[out] len current length.
+ *  \param[out] len_hwm high-water mark of the length.
+ *  \param[out] len_max configured maximum length.
+ *  \returns false if the PCU socket has not been created. */
+bool pcu_sock_queue_len(unsigned int *len, unsigned int *len_hwm, unsigned int *len_max)
+{
+	const struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state[0];
+
+	if (!state)
+		return false;
+
+	*len = state->upqueue.current_length;
+	*len_hwm = state->upqueue_len_max;
+	*len_max = state->upqueue.max_length;
+	return true;
+}
+
+/* The PCU socket serving the PDCH of a TRX.  A TRX assigned to a shard which
+ * is not configured is served by the primary PCU socket. */
+static struct pcu_sock_state *pcu_sock_state_trx(const struct gsm_bts_trx *trx)
+{
+	struct pcu_sock_state *state = NULL;
+
+	if (OSMO_LIKELY(trx->pcu_sock_nr < PCU_SOCK_NUM_MAX))
+		state = g_bts_sm->gprs.pcu_state[trx->pcu_sock_nr];
+	return state ? state : g_bts_sm->gprs.pcu_state[0];
+}
+
+/* Send a primitive to the primary PCU */
 int pcu_sock_send(struct msgb *msg)
 {
-	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
+	return pcu_sock_send_state(g_bts_sm->gprs.pcu_state[0], msg);
+}
+
+/* Send a primitive to the primary PCU and a copy to every connected shard */
+static int pcu_sock_send_all(struct msgb *msg)
+{
+	struct pcu_sock_state **states = g_bts_sm->gprs.pcu_state;
+	struct msgb *copy;
+	unsigned int i;
+
+	for (i = 1; i < PCU_SOCK_NUM_MAX; i++) {
+		if (!pcu_sock_connected(states[i]))
+			continue;
+		copy = msgb_copy(msg, "pcu_sock_tx");
+		if (copy)
+			pcu_sock_send_state(states[i], copy);
+	}
+
+	return pcu_sock_send_state(states[0], msg);
+}
+
+static int pcu_sock_send_state(struct pcu_sock_state *state, struct msgb *msg)
+{
 	struct osmo_fd *conn_bfd;
 	struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) msg->data;
 	int rc;
 
+	TRACE(OSMO_BTS_PCU_SOCK_SEND_START(pcu_prim->msg_type));
+
 	if (!state) {
 		if (pcu_prim->msg_type != PCU_IF_MSG_TIME_IND &&
 		    pcu_prim->msg_type != PCU_IF_MSG_INTERF_IND)
 			LOGP(DPCU, LOGL_INFO, "PCU socket not created, "
 				"dropping message\n");
 		msgb_free(msg);
+		TRACE(OSMO_BTS_PCU_SOCK_SEND_DONE(-EINVAL));
 		return -EINVAL;
 	}
 	conn_bfd = &state->upqueue.bfd;
@@ -999,18 +1390,21 @@ int pcu_sock_send(struct msgb *msg)
 			LOGP(DPCU, LOGL_NOTICE, "PCU socket not connected, "
 				"dropping message\n");
 		msgb_free(msg);
+		TRACE(OSMO_BTS_PCU_SOCK_SEND_DONE(-EIO));
 		return -EIO;
 	}
 
-	rc = osmo_wqueue_enqueue(&state->upqueue, msg);
+	rc = pcu_sock_enqueue(state, msg);
 	if (rc < 0) {
 		if (rc == -ENOSPC)
-			LOGP(DPCU, LOGL_NOTICE, "PCU not reacting (more than %u messages waiting). Closing connection\n",
-			     state->upqueue.max_length);
+			LOGP(DPCU, LOGL_NOTICE, "PCU not reacting (more than %u messages waiting for %u ms). "
+			     "Closing connection\n", state->upqueue.max_length, PCU_SOCK_OVERLOAD_MS);
 		pcu_sock_close(state);
 		msgb_free(msg);
+		TRACE(OSMO_BTS_PCU_SOCK_SEND_DONE(rc));
 		return rc;
 	}
+	TRACE(OSMO_BTS_PCU_SOCK_SEND_DONE(0));
 	return 0;
 }
 
@@ -1024,19 +1418,25 @@ static void pcu_sock_close(struct pcu_sock_state *state)
 	/* FIXME: allow multiple BTS */
 	bts = llist_entry(g_bts_sm->bts_list.next, struct gsm_bts, list);
 
-	LOGP(DPCU, LOGL_NOTICE, "PCU socket has LOST connection\n");
-	oml_tx_failure_event_rep(&bts->gprs.cell.mo, NM_SEVER_MAJOR, OSMO_EVT_PCU_VERS,
-				 "PCU socket has LOST connection");
-
-	bts->pcu_version[0] = '\0';
-
 	osmo_fd_unregister(bfd);
 	close(bfd->fd);
 	bfd->fd = -1;
 
-	/* patch SI3 to remove GPRS indicator */
-	regenerate_si3_restoctets(bts);
-	regenerate_si4_restoctets(bts);
+	if (state->nr == 0) {
+		LOGP(DPCU, LOGL_NOTICE, "PCU socket has LOST connection\n");
+		oml_tx_failure_event_rep(&bts->gprs.cell.mo, NM_SEVER_MAJOR, OSMO_EVT_PCU_VERS,
+					 "PCU socket has LOST connection");
+
+		bts->pcu_version[0] = '\0';
+		/* send the first TIME.ind to the next PCU right away */
+		bts->pcu.time_ind_skip = 0;
+
+		/* patch SI3 to remove GPRS indicator */
+		regenerate_si3_restoctets(bts);
+		regenerate_si4_restoctets(bts);
+	} else {
+		LOGP(DPCU, LOGL_NOTICE, "PCU socket shard %u has LOST connection\n", state->nr);
+	}
 
 	/* re-enable the generation of ACCEPT for new connections */
 	osmo_fd_read_enable(&state->listen_bfd);
@@ -1047,8 +1447,10 @@ static void pcu_sock_close(struct pcu_sock_state *state)
 	osmo_signal_dispatch(SS_GLOBAL, S_NEW_SYSINFO, bts);
 #endif
 
-	/* Deactivate all active PDCH timeslots */
+	/* Deactivate all active PDCH timeslots served by this PCU */
 	llist_for_each_entry(trx, &bts->trx_list, list) {
+		if (pcu_sock_state_trx(trx) != state)
+			continue;
 		for (tn = 0; tn < 8; tn++) {
 			struct gsm_bts_trx_ts *ts = &trx->ts[tn];
 
@@ -1063,70 +1465,132 @@ static void pcu_sock_close(struct pcu_sock_state *state)
 	}
 
 	osmo_wqueue_clear(&state->upqueue);
+	state->overload_since = (struct timespec) { 0 };
 }
 
+/* The receive buffers are msgbs, kept empty and with headroom: as we always
+ * synchronously process the primitives in pcu_rx() and its callbacks, they
+ * can be reused.  Only a buffer taken over by pcu_rx() (a container sent on
+ * to the BSC as is) needs to be replaced. */
 static int pcu_sock_read(struct osmo_fd *bfd)
 {
 	struct pcu_sock_state *state = (struct pcu_sock_state *)bfd->data;
-	struct gsm_pcu_if *pcu_prim;
-	struct msgb *msg;
-	int rc;
+	struct mmsghdr mmsg[PCU_SOCK_BATCH];
+	struct iovec iov[PCU_SOCK_BATCH];
+	int rc = 0, n, i;
+
+	for (i = 0; i < PCU_SOCK_BATCH; i++) {
+		if (!state->rx_msg[i]) {
+			state->rx_msg[i] = msgb_alloc_headroom(PCU_SOCK_RX_BUF_SIZE, ABIS_OSMO_HEADROOM_SIZE,
+							       "pcu_sock_rx");
+			if (!state->rx_msg[i])
+				break;
+		}
+		iov[i] = (struct iovec) {
+			.iov_base = msgb_data(state->rx_msg[i]),
+			.iov_len = msgb_tailroom(state->rx_msg[i]),
+		};
+		mmsg[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+			},
+		};
+	}
 
-	msg = msgb_alloc(sizeof(*pcu_prim) + 1000, "pcu_sock_rx");
-	if (!msg)
+	if (i == 0)
 		return -ENOMEM;
 
-	pcu_prim = (struct gsm_pcu_if *) msg->tail;
-
-	rc = recv(bfd->fd, msg->tail, msgb_tailroom(msg), 0);
-	if (rc == 0)
+	/* Fetch all the primitives the PCU has sent so far (up to a batch) */
+	n = recvmmsg(bfd->fd, mmsg, i, MSG_DONTWAIT, NULL);
+	if (n == 0)
 		goto close;
 
-	if (rc < 0) {
-		if (errno == EAGAIN) {
-			msgb_free(msg);
+	if (n < 0) {
+		if (errno == EAGAIN)
 			return 0;
-		}
 		goto close;
 	}
 
-	if (rc < PCUIF_HDR_SIZE) {
-		LOGP(DPCU, LOGL_ERROR, "Received %d bytes on PCU Socket, but primitive hdr size "
-		     "is %zu, discarding\n", rc, PCUIF_HDR_SIZE);
-		msgb_free(msg);
-		return 0;
-	}
+	for (i = 0; i < n; i++) {
+		struct gsm_pcu_if *pcu_prim = (struct gsm_pcu_if *) msgb_data(state->rx_msg[i]);
+		unsigned int len = mmsg[i].msg_len;
 
-	rc = pcu_rx(pcu_prim->msg_type, pcu_prim, rc);
+		if (len == 0)
+			goto close;
 
-	/* as we always synchronously process the message in pcu_rx() and
-	 * its callbacks, we can free the message here. */
-	msgb_free(msg);
+		if (len < PCUIF_HDR_SIZE) {
+			LOGP(DPCU, LOGL_ERROR, "Received %u bytes on PCU Socket, but primitive hdr size "
+			     "is %zu, discarding\n", len, PCUIF_HDR_SIZE);
+			continue;
+		}
+
+		rc = pcu_rx(state, pcu_prim->msg_type, pcu_prim, len, &state->rx_msg[i]);
+
+		/* pcu_rx() may have closed the connection (e.g. version mismatch) */
+		if (bfd->fd < 0)
+			return -1;
+	}
 
 	return rc;
 
 close:
-	msgb_free(msg);
 	pcu_sock_close(state);
 	return -1;
 }
 
-static int pcu_sock_write(struct osmo_fd *bfd, struct msgb *msg)
+static int pcu_sock_write(struct osmo_fd *bfd)
 {
 	struct pcu_sock_state *state = bfd->data;
-	int rc;
+	struct mmsghdr mmsg[PCU_SOCK_BATCH];
+	struct iovec iov[PCU_SOCK_BATCH];
+	struct msgb *msgs[PCU_SOCK_BATCH];
+	struct msgb *msg;
+	int rc, n = 0, i;
+
+	/* Send the oldest queued primitives (up to a batch) in one go */
+	llist_for_each_entry(msg, &state->upqueue.msg_queue, list) {
+		/* bug hunter 8-): maybe someone forgot msgb_put(...) ? */
+		OSMO_ASSERT(msgb_length(msg) > 0);
+		iov[n] = (struct iovec) {
+			.iov_base = msgb_data(msg),
+			.iov_len = msgb_length(msg),
+		};
+		mmsg[n] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = &iov[n],
+				.msg_iovlen = 1,
+			},
+		};
+		msgs[n] = msg;
+		if (++n == PCU_SOCK_BATCH)
+			break;
+	}
 
-	/* bug hunter 8-): maybe someone forgot msgb_put(...) ? */
-	OSMO_ASSERT(msgb_length(msg) > 0);
-	/* try to send it over the socket */
-	rc = write(bfd->fd, msgb_data(msg), msgb_length(msg));
+	if (n == 0) {
+		osmo_fd_write_disable(bfd);
+		return 0;
+	}
+
+	rc = sendmmsg(bfd->fd, mmsg, n, MSG_DONTWAIT);
 	if (OSMO_UNLIKELY(rc == 0))
 		goto close;
 	if (OSMO_UNLIKELY(rc < 0)) {
 		if (errno == EAGAIN)
-			return -EAGAIN;
-		return -1;
+			return 0;
+		/* like osmo_wqueue_bfd_cb(), drop the message which failed */
+		rc = 1;
 	}
+
+	for (i = 0; i < rc; i++) {
+		llist_del(&msgs[i]->list);
+		state->upqueue.current_length--;
+		msgb_free(msgs[i]);
+	}
+
+	if (llist_empty(&state->upqueue.msg_queue))
+		osmo_fd_write_disable(bfd);
+
 	return 0;
 
 close:
@@ -1134,6 +1598,25 @@ close:
 	return -1;
 }
 
+/* Callback of the connection to the PCU.  Like osmo_wqueue_bfd_cb(), but
+ * reading and writing several primitives per poll() wakeup. */
+static int pcu_sock_conn_cb(struct osmo_fd *bfd, unsigned int what)
+{
+	int rc = 0;
+
+	if (what & OSMO_FD_READ) {
+		rc = pcu_sock_read(bfd);
+		/* connection closed */
+		if (bfd->fd < 0)
+			return rc;
+	}
+
+	if (what & OSMO_FD_WRITE)
+		rc = pcu_sock_write(bfd);
+
+	return rc;
+}
+
 /* accept connection coming from PCU */
 static int pcu_sock_accept(struct osmo_fd *bfd, unsigned int flags)
 {
@@ -1158,7 +1641,7 @@ static int pcu_sock_accept(struct osmo_fd *bfd, unsigned int flags)
 		return 0;
 	}
 
-	osmo_fd_setup(conn_bfd, fd, OSMO_FD_READ, osmo_wqueue_bfd_cb, state, 0);
+	osmo_fd_setup(conn_bfd, fd, OSMO_FD_READ, pcu_sock_conn_cb, state, 0);
 
 	if (osmo_fd_register(conn_bfd) != 0) {
 		LOGP(DPCU, LOGL_ERROR, "Failed to register new connection fd\n");
@@ -1167,27 +1650,33 @@ static int pcu_sock_accept(struct osmo_fd *bfd, unsigned int flags)
 		return -1;
 	}
 
-	LOGP(DPCU, LOGL_NOTICE, "PCU socket connected to external PCU\n");
+	if (state->nr == 0)
+		LOGP(DPCU, LOGL_NOTICE, "PCU socket connected to external PCU\n");
+	else
+		LOGP(DPCU, LOGL_NOTICE, "PCU socket shard %u connected to external PCU\n", state->nr);
 
 	/* send current info */
-	pcu_tx_info_ind();
+	pcu_tx_info_ind_state(state);
 
 	return 0;
 }
 
-int pcu_sock_init(const char *path, int qlength_max)
+static int pcu_sock_open(uint8_t nr, const char *path, int qlength_max)
 {
 	struct pcu_sock_state *state;
 	struct osmo_fd *bfd;
 	int rc;
 
+	OSMO_ASSERT(nr < PCU_SOCK_NUM_MAX);
+	if (g_bts_sm->gprs.pcu_state[nr] != NULL)
+		return -EEXIST;
+
 	state = talloc_zero(g_bts_sm, struct pcu_sock_state);
 	if (!state)
 		return -ENOMEM;
+	state->nr = nr;
 
 	osmo_wqueue_init(&state->upqueue, qlength_max);
-	state->upqueue.read_cb = pcu_sock_read;
-	state->upqueue.write_cb = pcu_sock_write;
 	state->upqueue.bfd.fd = -1;
 
 	bfd = &state->listen_bfd;
@@ -1211,40 +1700,97 @@ int pcu_sock_init(const char *path, int qlength_max)
 		return rc;
 	}
 
-	osmo_signal_register_handler(SS_GLOBAL, pcu_if_signal_cb, NULL);
+	g_bts_sm->gprs.pcu_state[nr] = state;
 
-	g_bts_sm->gprs.pcu_state = state;
+	LOGP(DPCU, LOGL_INFO, "Started listening on PCU socket %u (PCU IF v%u): %s\n",
+	     nr, PCU_IF_VERSION, path);
 
-	LOGP(DPCU, LOGL_INFO, "Started listening on PCU socket (PCU IF v%u): %s\n", PCU_IF_VERSION, path);
+	return 0;
+}
+
+/*! Open the primary PCU socket */
+int pcu_sock_init(const char *path, int qlength_max)
+{
+	int rc;
+
+	rc = pcu_sock_open(0, path, qlength_max);
+	if (rc < 0)
+		return rc;
 
+	osmo_signal_register_handler(SS_GLOBAL, pcu_if_signal_cb, NULL);
 	return 0;
 }
 
-void pcu_sock_exit(void)
+/*! Open an additional PCU socket, serving the PDCH of the TRX assigned to it.
+ *  \param[in] nr number of the shard (1..PCU_SOCK_NUM_MAX-1).
+ *  \param[in] path UNIX socket path.
+ *  \param[in] qlength_max max. length of the queue towards the PCU. */
+int pcu_sock_init_shard(uint8_t nr, const char *path, int qlength_max)
 {
-	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
-	struct osmo_fd *bfd, *conn_bfd;
+	if (nr == 0 || nr >= PCU_SOCK_NUM_MAX)
+		return -EINVAL;
+	return pcu_sock_open(nr, path, qlength_max);
+}
 
-	if (!state)
-		return;
+static void pcu_sock_free(struct pcu_sock_state *state)
+{
+	struct osmo_fd *bfd, *conn_bfd;
+	unsigned int i;
 
-	osmo_signal_unregister_handler(SS_GLOBAL, pcu_if_signal_cb, NULL);
 	conn_bfd = &state->upqueue.bfd;
 	if (conn_bfd->fd > 0)
 		pcu_sock_close(state);
 	bfd = &state->listen_bfd;
 	close(bfd->fd);
 	osmo_fd_unregister(bfd);
+	for (i = 0; i < ARRAY_SIZE(state->rx_msg); i++)
+		msgb_free(state->rx_msg[i]);
+	g_bts_sm->gprs.pcu_state[state->nr] = NULL;
 	talloc_free(state);
-	g_bts_sm->gprs.pcu_state = NULL;
 }
 
-bool pcu_connected(void) {
-	struct pcu_sock_state *state = g_bts_sm->gprs.pcu_state;
+void pcu_sock_exit(void)
+{
+	unsigned int i;
+
+	if (!g_bts_sm->gprs.pcu_state[0])
+		return;
 
+	osmo_signal_unregister_handler(SS_GLOBAL, pcu_if_signal_cb, NULL);
+
+	for (i = 0; i < PCU_SOCK_NUM_MAX; i++) {
+		if (g_bts_sm->gprs.pcu_state[i])
+			pcu_sock_free(g_bts_sm->gprs.pcu_state[i]);
+	}
+}
+
+static bool pcu_sock_connected(const struct pcu_sock_state *state)
+{
 	if (!state)
 		return false;
 	if (state->upqueue.bfd.fd <= 0)
 		return false;
 	return true;
 }
+
+static bool pcu_any_connected(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < PCU_SOCK_NUM_MAX; i++) {
+		if (pcu_sock_connected(g_bts_sm->gprs.pcu_state[i]))
+			return true;
+	}
+	return false;
+}
+
+/*! Whether the primary PCU is connected */
+bool pcu_connected(void) {
+	return pcu_sock_connected(g_bts_sm->gprs.pcu_state[0]);
+}
+
+/*! Whether the PCU serving the PDCH of a TRX is connected */
+bool pcu_connected_trx(const struct gsm_bts_trx *trx)
+{
+	return pcu_sock_connected(pcu_sock_state_trx(trx));
+}
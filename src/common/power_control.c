@@ -302,6 +302,9 @@ int lchan_ms_pwr_ctrl(struct gsm_lchan *lchan,
 		  rxlev2dbm(params->rxlev_meas.lower_thresh), rxlev2dbm(params->rxlev_meas.upper_thresh),
 		  ul_lqual_cb/10, ul_lqual_cb_avg/10, ci_meas->lower_thresh, ci_meas->upper_thresh);
 
+	pwr_ctrl_log_add(lchan, PWR_CTRL_LOG_MS_PWR, &state->last_dir, new_dbm > current_dbm,
+			 state->current, new_power_lvl, rxlev_avg, ul_lqual_cb_avg);
+
 	/* store the resulting new MS power level in the lchan */
 	state->current = new_power_lvl;
 	bts_model_adjst_ms_pwr(lchan);
@@ -398,6 +401,9 @@ int lchan_bs_pwr_ctrl(struct gsm_lchan *lchan,
 		  state->current, new_att, state->max, rxlev2dbm(rxlev), rxlev2dbm(rxlev_avg),
 		  rxlev2dbm(params->rxlev_meas.lower_thresh), rxlev2dbm(params->rxlev_meas.upper_thresh),
 		  rxqual, rxqual_avg, params->rxqual_meas.lower_thresh, params->rxqual_meas.upper_thresh);
+	/* Less attenuation means more power */
+	pwr_ctrl_log_add(lchan, PWR_CTRL_LOG_BS_PWR, &state->last_dir, new_att < state->current,
+			 state->current, new_att, rxlev_avg, rxqual_avg);
 	state->current = new_att;
 	return 1;
 }
@@ -0,0 +1,79 @@
+/* Log of the MS/BS Power and TA Control Loop decisions */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Every level change of one of the control loops is counted (raise, lower
+ * and reversal of the direction of the last change on the same lchan) and
+ * recorded in a fixed size ring buffer per BTS, which can be inspected with
+ * 'show bts <0-255> control-loop-log'.  Recording is a single struct copy,
+ * it is always enabled.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <osmocom/core/rate_ctr.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/power_control.h>
+
+/*! record a level change of a control loop in the decision log of the BTS.
+ *  \param lchan logical channel whose level has changed.
+ *  \param[in] loop control loop which has changed the level.
+ *  \param last_dir direction of the last change of this loop on the lchan.
+ *  \param[in] raise whether the (power, TA) level was raised or lowered.
+ *  \param[in] old level before the change.
+ *  \param[in] new level after the change.
+ *  \param[in] avg0 first averaged input value (see struct pwr_ctrl_log_entry).
+ *  \param[in] avg1 second averaged input value.
+ */
+void pwr_ctrl_log_add(struct gsm_lchan *lchan, enum pwr_ctrl_log_loop loop,
+		      int8_t *last_dir, bool raise, uint8_t old, uint8_t new,
+		      int16_t avg0, int16_t avg1)
+{
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+	struct pwr_ctrl_log *pcl = &bts->pwr_ctrl_log;
+	int8_t dir = raise ? 1 : -1;
+	unsigned int ctr;
+
+	/* The counters are ordered in groups of raise, lower and reversal
+	 * (the unit tests run the loops on a BTS without counters) */
+	if (bts->ctrs != NULL) {
+		ctr = BTS_CTR_LOOP_MS_PWR_RAISE + loop * 3;
+		rate_ctr_inc2(bts->ctrs, raise ? ctr : ctr + 1);
+		if (*last_dir == -dir)
+			rate_ctr_inc2(bts->ctrs, ctr + 2);
+	}
+	*last_dir = dir;
+
+	pcl->entries[pcl->num++ % PWR_CTRL_LOG_LEN] = (struct pwr_ctrl_log_entry) {
+		.fn = bts->gsm_time.fn,
+		.trx_nr = lchan->ts->trx->nr,
+		.ts_nr = lchan->ts->nr,
+		.lchan_nr = lchan->nr,
+		.loop = loop,
+		.old = old,
+		.new = new,
+		.avg = { avg0, avg1 },
+	};
+}
@@ -0,0 +1,121 @@
+/* Sharded rate counters for the hot paths */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * rate_ctr_add2() and friends update the counter in the shared group,
+ * which is neither safe from more than one thread, nor cheap when the
+ * cache line bounces between the CPUs.  A rate_ctr_shard_group shadows a
+ * group with one slot of counters per thread, each slot on cache lines of
+ * its own.  A thread only ever writes to its own slot, without any atomic
+ * read-modify-write.  The main thread periodically adds what has been
+ * counted since the last flush to the rate_ctr_group, so the VTY, CTRL and
+ * stats reporter see the same counters as before, only up to one flush
+ * period late.
+ *
+ * The main thread uses slot 0; any other thread has to get a slot with
+ * rate_ctr_shard_thread_register() before using sharded counters.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/rate_ctr_shard.h>
+
+#define CACHE_LINE_SIZE		64
+#define CTRS_PER_LINE		(CACHE_LINE_SIZE / sizeof(uint64_t))
+
+__thread unsigned int rate_ctr_shard_slot;
+
+/* next free slot, updated by the registering threads */
+static unsigned int g_next_slot = 1;
+
+/*! Allocate the per-thread shadow of a rate counter group.
+ *  \param[in] ctx talloc context (the group should be freed with it).
+ *  \param[in] ctrg rate counter group the counts are flushed to.
+ *  \returns the allocated group, NULL on error. */
+struct rate_ctr_shard_group *rate_ctr_shard_group_alloc(void *ctx, struct rate_ctr_group *ctrg)
+{
+	struct rate_ctr_shard_group *sg;
+	unsigned int num_ctr = ctrg->desc->num_ctr;
+	void *mem;
+
+	sg = talloc_zero(ctx, struct rate_ctr_shard_group);
+	if (sg == NULL)
+		return NULL;
+
+	sg->ctrg = ctrg;
+	sg->num_ctr = num_ctr;
+	sg->stride = (num_ctr + CTRS_PER_LINE - 1) / CTRS_PER_LINE * CTRS_PER_LINE;
+
+	/* talloc does not align to cache lines, leave room for doing so */
+	mem = talloc_zero_size(sg, RATE_CTR_SHARD_THREADS * sg->stride * sizeof(uint64_t)
+				   + CACHE_LINE_SIZE - 1);
+	sg->flushed = talloc_zero_array(sg, uint64_t, RATE_CTR_SHARD_THREADS * sg->stride);
+	if (mem == NULL || sg->flushed == NULL) {
+		talloc_free(sg);
+		return NULL;
+	}
+	sg->slots = (uint64_t *)(((uintptr_t)mem + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+
+	return sg;
+}
+
+/*! Get a slot for the calling (non-main) thread.
+ *  \returns 0 on success; -ENOSPC if all slots are taken. */
+int rate_ctr_shard_thread_register(void)
+{
+	unsigned int slot;
+
+	if (rate_ctr_shard_slot != 0)
+		return 0;
+
+	slot = __atomic_fetch_add(&g_next_slot, 1, __ATOMIC_RELAXED);
+	if (slot >= RATE_CTR_SHARD_THREADS)
+		return -ENOSPC;
+
+	rate_ctr_shard_slot = slot;
+	return 0;
+}
+
+/*! Add the counts since the last flush to the rate counter group.  To be
+ *  called from the main thread, e.g. once per 51-multiframe. */
+void rate_ctr_shard_flush(struct rate_ctr_shard_group *sg)
+{
+	unsigned int slot, i;
+
+	for (slot = 0; slot < RATE_CTR_SHARD_THREADS; slot++) {
+		const uint64_t *cur = &sg->slots[slot * sg->stride];
+		uint64_t *last = &sg->flushed[slot * sg->stride];
+
+		for (i = 0; i < sg->num_ctr; i++) {
+			uint64_t val = __atomic_load_n(&cur[i], __ATOMIC_RELAXED);
+
+			if (val == last[i])
+				continue;
+			rate_ctr_add2(sg->ctrg, i, val - last[i]);
+			last[i] = val;
+		}
+	}
+}
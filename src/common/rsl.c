@@ -58,6 +58,9 @@
 #include <osmo-bts/pcuif_proto.h>
 #include <osmo-bts/notification.h>
 #include <osmo-bts/asci.h>
+#include <osmo-bts/rtp_input_preen.h>
+#include <osmo-bts/media_io.h>
+#include <osmo-bts/trace.h>
 
 //#define FAKE_CIPH_MODE_COMPL
 
@@ -124,6 +127,106 @@ void gsm48_gen_starting_time(uint8_t *out, struct gsm_time *gtime)
 	out[1] = (gtime->t3 << 5) | gtime->t2;
 }
 
+/*
+ * rsl_tlv_parse() clears and fills a struct tlv_parsed for all 256 IEs,
+ * i.e. 4 KiB per message.  For the frequent messages below, only the
+ * entries of the IEs they can contain are initialized and filled, in one
+ * pass over the message.  The handlers keep using the TLVP_*() macros, but
+ * must not look at IEs which are not in the set of their message.
+ */
+
+static const uint8_t rsl_ies_chan_activ[] = {
+	RSL_IE_ACT_TYPE,
+	RSL_IE_CHAN_MODE,
+	RSL_IE_CHAN_IDENT,
+	RSL_IE_ENCR_INFO,
+	RSL_IE_HANDO_REF,
+	RSL_IE_BS_POWER,
+	RSL_IE_MS_POWER,
+	RSL_IE_TIMING_ADVANCE,
+	RSL_IE_BS_POWER_PARAM,
+	RSL_IE_MS_POWER_PARAM,
+	RSL_IE_SACCH_INFO,
+	RSL_IE_MR_CONFIG,
+	RSL_IE_OSMO_TRAINING_SEQUENCE,
+	RSL_IE_OSMO_REP_ACCH_CAP,
+	RSL_IE_OSMO_TEMP_OVP_ACCH_CAP,
+};
+
+static const uint8_t rsl_ies_paging_cmd[] = {
+	RSL_IE_PAGING_GROUP,
+	RSL_IE_MS_IDENTITY,
+	RSL_IE_CHAN_NEEDED,
+};
+
+static const uint8_t rsl_ies_imm_ass[] = {
+	RSL_IE_FULL_IMM_ASS_INFO,
+};
+
+static const uint8_t rsl_ies_ipac_XXcx[] = {
+	RSL_IE_IPAC_REMOTE_IP,
+	RSL_IE_IPAC_REMOTE_PORT,
+	RSL_IE_IPAC_SPEECH_MODE,
+	RSL_IE_IPAC_RTP_PAYLOAD,
+	RSL_IE_IPAC_RTP_PAYLOAD2,
+	RSL_IE_IPAC_RTP_CSD_FMT,
+	RSL_IE_OSMO_OSMUX_CID,
+};
+
+#define RSL_IE_SET(msg) \
+	{ .ies = rsl_ies_##msg, .num = ARRAY_SIZE(rsl_ies_##msg) }
+
+struct rsl_ie_set rsl_ie_set_chan_activ = RSL_IE_SET(chan_activ);
+struct rsl_ie_set rsl_ie_set_paging_cmd = RSL_IE_SET(paging_cmd);
+struct rsl_ie_set rsl_ie_set_imm_ass = RSL_IE_SET(imm_ass);
+struct rsl_ie_set rsl_ie_set_ipac_XXcx = RSL_IE_SET(ipac_XXcx);
+
+/*! Parse the IEs of an RSL message which are in the given set.
+ *  Like rsl_tlv_parse(), the first occurrence of an IE is kept and an
+ *  encoding error fails the whole message; IEs not in the set are skipped.
+ *  \param[out] tp only the entries of the IEs in the set are written
+ *  \param[in] set IEs the message can contain
+ *  \returns number of IEs of the set found; negative on error */
+int rsl_tlv_parse_ies(struct tlv_parsed *tp, struct rsl_ie_set *set,
+		      const uint8_t *buf, int buf_len)
+{
+	unsigned int i, num_parsed = 0;
+	int ofs = 0;
+
+	if (OSMO_UNLIKELY(!set->mask_built)) {
+		for (i = 0; i < set->num; i++)
+			set->mask[set->ies[i] / 8] |= 1 << (set->ies[i] % 8);
+		set->mask_built = true;
+	}
+
+	for (i = 0; i < set->num; i++) {
+		tp->lv[set->ies[i]].len = 0;
+		tp->lv[set->ies[i]].val = NULL;
+	}
+
+	while (ofs < buf_len) {
+		const uint8_t *val;
+		uint16_t len;
+		uint8_t tag;
+		int rv;
+
+		rv = tlv_parse_one(&tag, &len, &val, &rsl_att_tlvdef, &buf[ofs], buf_len - ofs);
+		if (rv < 0)
+			return rv;
+		ofs += rv;
+
+		if (~set->mask[tag / 8] & (1 << (tag % 8)))
+			continue;
+		if (tp->lv[tag].val != NULL)
+			continue;
+		tp->lv[tag].len = len;
+		tp->lv[tag].val = val;
+		num_parsed++;
+	}
+
+	return num_parsed;
+}
+
 /* Handle RSL Channel Mode IE (see section 9.3.6) */
 static int rsl_handle_chan_mod_ie(struct gsm_lchan *lchan,
 				  const struct tlv_parsed *tp,
@@ -297,6 +400,8 @@ static int rsl_handle_chan_mod_ie(struct gsm_lchan *lchan,
 
 #undef RSL_CMODE
 
+	rtp_input_preen_setup(lchan);
+
 	if (!bts_supports_cm(lchan->ts->trx->bts, cm)) {
 		LOGPLCHAN(lchan, DRSL, LOGL_ERROR, "Channel type=0x%02x/mode=%s "
 			  "is not supported by the PHY\n", cm->chan_rt,
@@ -391,15 +496,92 @@ static struct gsm_lchan *lchan_lookup(struct gsm_bts_trx *trx, uint8_t chan_nr,
 	return lchan;
 }
 
+/* Outgoing RSL messages (MEAS RES, CHAN RQD, DATA IND, CCCH LOAD IND, ...)
+ * are allocated at a high rate and freed as soon as they have been written
+ * to the Abis link.  Like for the L1SAP primitives (see l1sap.c), msgbs of
+ * the common size are recycled via a talloc destructor.  Messages with a
+ * header larger than the one of a (dedicated or common) channel message
+ * are not pooled.  Not thread-safe: main thread only. */
+#define RSL_MSGB_POOL_MAX 128 /* max. number of pooled msgbs */
+#define RSL_MSGB_TAILROOM 600
+#define RSL_MSGB_HDR_MAX sizeof(struct abis_rsl_dchan_hdr)
+#define RSL_MSGB_SIZE \
+	(sizeof(struct ipaccess_head) + RSL_MSGB_HDR_MAX + RSL_MSGB_TAILROOM)
+
+static struct rsl_msgb_pool g_rsl_msgb_pool = {
+	.free = LLIST_HEAD_INIT(g_rsl_msgb_pool.free),
+};
+
+const struct rsl_msgb_pool *rsl_msgb_pool_get(void)
+{
+	return &g_rsl_msgb_pool;
+}
+
+/* called by talloc_free(), i.e. by msgb_free() */
+static int rsl_msgb_pool_destructor(struct msgb *msg)
+{
+	struct rsl_msgb_pool *pool = &g_rsl_msgb_pool;
+
+	OSMO_ASSERT(msg->data_len == RSL_MSGB_SIZE);
+	pool->in_use--;
+
+	if (pool->free_len >= RSL_MSGB_POOL_MAX)
+		return 0; /* actually free it */
+
+	talloc_set_destructor(msg, NULL);
+	llist_add(&msg->list, &pool->free);
+	pool->free_len++;
+
+	return -1; /* keep the memory */
+}
+
+/* reset a recycled msgb to the state msgb_alloc() leaves it in */
+static void rsl_msgb_pool_reset(struct msgb *msg)
+{
+	uint16_t data_len = msg->data_len;
+
+	memset(msg, 0, sizeof(*msg) + data_len);
+	msg->data_len = data_len;
+	msg->data = msg->_data;
+	msg->head = msg->_data;
+	msg->tail = msg->_data;
+}
+
 static struct msgb *rsl_msgb_alloc(int hdr_size)
 {
+	struct rsl_msgb_pool *pool = &g_rsl_msgb_pool;
 	struct msgb *nmsg;
 
+	if (hdr_size > RSL_MSGB_HDR_MAX) {
+		/* not pooled */
+		hdr_size += sizeof(struct ipaccess_head);
+		nmsg = msgb_alloc_headroom(RSL_MSGB_TAILROOM + hdr_size, hdr_size, "RSL");
+		if (!nmsg)
+			return NULL;
+		nmsg->l3h = nmsg->data;
+		return nmsg;
+	}
+
 	hdr_size += sizeof(struct ipaccess_head);
 
-	nmsg = msgb_alloc_headroom(600+hdr_size, hdr_size, "RSL");
-	if (!nmsg)
-		return NULL;
+	if (OSMO_LIKELY(!llist_empty(&pool->free))) {
+		nmsg = llist_first_entry(&pool->free, struct msgb, list);
+		llist_del(&nmsg->list);
+		pool->free_len--;
+		rsl_msgb_pool_reset(nmsg);
+		msgb_reserve(nmsg, hdr_size);
+		pool->hits++;
+	} else {
+		nmsg = bts_hp_msgb_alloc_headroom(RSL_MSGB_SIZE, hdr_size, "RSL");
+		if (!nmsg)
+			return NULL;
+		pool->misses++;
+	}
+
+	talloc_set_destructor(nmsg, rsl_msgb_pool_destructor);
+	if (++pool->in_use > pool->in_use_max)
+		pool->in_use_max = pool->in_use;
+
 	nmsg->l3h = nmsg->data;
 	return nmsg;
 }
@@ -713,13 +895,15 @@ static int rsl_rx_bcch_info(struct gsm_bts_trx *trx, struct msgb *msg)
 			break;
 		}
 	}
+	bts_sysinfo_sched_update(bts);
 	osmo_signal_dispatch(SS_GLOBAL, S_NEW_SYSINFO, bts);
 
 	return 0;
 }
 
 /* 8.5.2 CCCH Load Indication (PCH) */
-int rsl_tx_ccch_load_ind_pch(struct gsm_bts *bts, uint16_t paging_avail)
+int rsl_tx_ccch_load_ind_pch(struct gsm_bts *bts, uint16_t paging_avail,
+			     const uint8_t *cpu_load, uint8_t cpu_load_len)
 {
 	struct msgb *msg;
 
@@ -728,6 +912,9 @@ int rsl_tx_ccch_load_ind_pch(struct gsm_bts *bts, uint16_t paging_avail)
 		return -ENOMEM;
 	rsl_cch_push_hdr(msg, RSL_MT_CCCH_LOAD_IND, RSL_CHAN_PCH_AGCH);
 	msgb_tv16_put(msg, RSL_IE_PAGING_LOAD, paging_avail);
+	/* Osmocom extension, see load_put_cpu_load() */
+	if (cpu_load_len > 0)
+		msgb_tlv_put(msg, OSMO_BTS_RSL_IE_CPU_LOAD, cpu_load_len, cpu_load);
 	msg->trx = bts->c0;
 
 	return abis_bts_rsl_sendmsg(msg);
@@ -780,8 +967,8 @@ static int rsl_rx_paging_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 	const uint8_t *identity_lv;
 	int rc;
 
-	if (rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg)) < 0) {
-		LOGPTRX(trx, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse() failed\n", __func__);
+	if (rsl_tlv_parse_ies(&tp, &rsl_ie_set_paging_cmd, msgb_l3(msg), msgb_l3len(msg)) < 0) {
+		LOGPTRX(trx, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse_ies() failed\n", __func__);
 		return rsl_tx_error_report(trx, RSL_ERR_PROTO, &cch->chan_nr, NULL, msg);
 	}
 
@@ -961,6 +1148,7 @@ static int rsl_rx_osmo_etws_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 		bts->etws.page_size = 0;
 		bts->etws.num_pages = 0;
 		bts->etws.next_page = 0;
+		bts->etws.generation++;
 	} else {
 		LOGP(DRSL, LOGL_NOTICE, "ETWS Primary Notification: %s\n",
 		     osmo_hexdump(TLVP_VAL(&tp, RSL_IE_SMSCB_MSG),
@@ -973,6 +1161,8 @@ static int rsl_rx_osmo_etws_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 		bts->etws.num_pages = bts->etws.prim_notif_len / bts->etws.page_size;
 		if (bts->etws.prim_notif_len % bts->etws.page_size)
 			bts->etws.num_pages++;
+		bts->etws.next_page = 0;
+		bts->etws.generation++;
 
 		/* toggle the PNI to allow phones to distinguish new from old primary notification */
 		bts->etws.pni = !bts->etws.pni;
@@ -1054,46 +1244,17 @@ static int rsl_rx_sacch_fill(struct gsm_bts_trx *trx, struct msgb *msg)
 		LOGP(DRSL, LOGL_NOTICE, " Rx SACCH SI 0x%02x not supported.\n", rsl_si);
 		return rsl_tx_error_report(trx, RSL_ERR_IE_CONTENT, NULL, NULL, msg);
 	}
+	/* The lchans which adhere to the BTS-global default read it from
+	 * bts->si_buf[], see lchan_sacch_get(): no need to propagate it. */
 	if (TLVP_PRESENT(&tp, RSL_IE_L3_INFO)) {
 		uint16_t len = TLVP_LEN(&tp, RSL_IE_L3_INFO);
-		struct gsm_bts_trx *t;
 
 		lapdm_ui_prefix_bts(bts, TLVP_VAL(&tp, RSL_IE_L3_INFO), osmo_si, len);
 
-		/* Propagate SI change to all lchans which adhere to BTS-global default. */
-		llist_for_each_entry(t, &bts->trx_list, list) {
-			int i, j;
-			for (i = 0; i < ARRAY_SIZE(t->ts); i++) {
-				struct gsm_bts_trx_ts *ts = &t->ts[i];
-				for (j = 0; j < ARRAY_SIZE(ts->lchan); j++) {
-					struct gsm_lchan *lchan = &ts->lchan[j];
-					if (lchan->state == LCHAN_S_NONE || (lchan->si.overridden & (1 << osmo_si)))
-						continue;
-					lapdm_ui_prefix_lchan(lchan, TLVP_VAL(&tp, RSL_IE_L3_INFO), osmo_si, len);
-				}
-			}
-		}
-
 		LOGP(DRSL, LOGL_INFO, " Rx RSL SACCH FILLING (SI%s, %u bytes)\n",
 		     get_value_string(osmo_sitype_strs, osmo_si), len);
 	} else {
-		struct gsm_bts_trx *t;
-
 		bts->si_valid &= ~(1 << osmo_si);
-
-		/* Propagate SI change to all lchans which adhere to BTS-global default. */
-		llist_for_each_entry(t, &bts->trx_list, list) {
-			int i, j;
-			for (i = 0; i < ARRAY_SIZE(t->ts); i++) {
-				struct gsm_bts_trx_ts *ts = &t->ts[i];
-				for (j = 0; j < ARRAY_SIZE(ts->lchan); j++) {
-					struct gsm_lchan *lchan = &ts->lchan[j];
-					if (lchan->state == LCHAN_S_NONE || (lchan->si.overridden & (1 << osmo_si)))
-						continue;
-					lchan->si.valid &= ~(1 << osmo_si);
-				}
-			}
-		}
 		LOGP(DRSL, LOGL_INFO, " Rx RSL Disabling SACCH FILLING (SI%s)\n",
 			get_value_string(osmo_sitype_strs, osmo_si));
 	}
@@ -1349,8 +1510,8 @@ static int rsl_rx_imm_ass(struct gsm_bts_trx *trx, struct msgb *msg)
 	struct abis_rsl_cchan_hdr *cch = msgb_l2(msg);
 	struct tlv_parsed tp;
 
-	if (rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg)) < 0) {
-		LOGPTRX(trx, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse() failed\n", __func__);
+	if (rsl_tlv_parse_ies(&tp, &rsl_ie_set_imm_ass, msgb_l3(msg), msgb_l3len(msg)) < 0) {
+		LOGPTRX(trx, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse_ies() failed\n", __func__);
 		return rsl_tx_error_report(trx, RSL_ERR_PROTO, &cch->chan_nr, NULL, msg);
 	}
 
@@ -1519,6 +1680,9 @@ static int rsl_tx_chan_act_ack(struct gsm_lchan *lchan)
 	/* since activation was successful, do some lchan initialization */
 	lchan_meas_reset(lchan);
 
+	bts_proc_lat_add(lchan->ts->trx->bts, BTS_PROC_LAT_CHAN_ACT, &lchan->chan_act_time.rx);
+	lchan->chan_act_time.rx = (struct timespec) { 0 };
+
 	return abis_bts_rsl_sendmsg(msg);
 }
 
@@ -1578,6 +1742,9 @@ static int _rsl_tx_chan_act_nack(struct gsm_bts_trx *trx, uint8_t chan_nr, uint8
 		LOGP(DRSL, LOGL_NOTICE, "0x%02x: ", chan_nr);
 	LOGPC(DRSL, LOGL_NOTICE, "Sending Channel Activated NACK: cause = 0x%02x\n", cause);
 
+	if (lchan)
+		lchan->chan_act_time.rx = (struct timespec) { 0 };
+
 	msg = rsl_msgb_alloc(sizeof(struct abis_rsl_dchan_hdr));
 	if (!msg)
 		return -ENOMEM;
@@ -1654,28 +1821,14 @@ int rsl_tx_chan_rqd(struct gsm_bts_trx *trx, struct gsm_time *gtime,
 	return abis_bts_rsl_sendmsg(nmsg);
 }
 
-/* copy the SACCH related sysinfo from BTS global buffer to lchan specific buffer */
-static void copy_sacch_si_to_lchan(struct gsm_lchan *lchan)
+/* use the BTS-global SACCH filling on the lchan (read through, see lchan_sacch_get()) */
+static void lchan_use_bts_sacch_si(struct gsm_lchan *lchan)
 {
-	struct gsm_bts *bts = lchan->ts->trx->bts;
-	unsigned int i;
+	osmo_static_assert(_MAX_SYSINFO_TYPE <= sizeof(lchan->si.valid) * 8,
+			   si_enum_vals_fit_in_bit_mask);
 
-	for (i = 0; i < ARRAY_SIZE(rsl_sacch_sitypes); i++) {
-		uint8_t rsl_si = rsl_sacch_sitypes[i];
-		int osmo_si = osmo_rsl2sitype(rsl_si);
-		uint32_t osmo_si_shifted = (1 << osmo_si);
-		osmo_static_assert(_MAX_SYSINFO_TYPE <= sizeof(osmo_si_shifted) * 8,
-				   si_enum_vals_fit_in_bit_mask);
-
-		if (osmo_si == SYSINFO_TYPE_NONE)
-			continue;
-		if (!(bts->si_valid & osmo_si_shifted)) {
-			lchan->si.valid &= ~osmo_si_shifted;
-			continue;
-		}
-		lchan->si.valid |= osmo_si_shifted;
-		memcpy(GSM_LCHAN_SI(lchan, osmo_si), GSM_BTS_SI(bts, osmo_si), sizeof(sysinfo_buf_t));
-	}
+	lchan->si.overridden = 0;
+	lchan->si.valid = 0;
 }
 
 
@@ -1721,7 +1874,7 @@ static void clear_lchan_for_pdch_activ(struct gsm_lchan *lchan)
 	memset(&lchan->ms_power_ctrl, 0, sizeof(lchan->ms_power_ctrl));
 	memset(&lchan->bs_power_ctrl, 0, sizeof(lchan->bs_power_ctrl));
 	lchan->ta_ctrl.current = 0;
-	copy_sacch_si_to_lchan(lchan);
+	lchan_use_bts_sacch_si(lchan);
 	memset(&lchan->tch, 0, sizeof(lchan->tch));
 }
 
@@ -1882,8 +2035,8 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 	bool reactivation = false;
 	int rc;
 
-	if (rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg)) < 0) {
-		LOGPLCHAN(lchan, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse() failed\n", __func__);
+	if (rsl_tlv_parse_ies(&tp, &rsl_ie_set_chan_activ, msgb_l3(msg), msgb_l3len(msg)) < 0) {
+		LOGPLCHAN(lchan, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse_ies() failed\n", __func__);
 		return rsl_tx_chan_act_nack(lchan, RSL_ERR_PROTO);
 	}
 
@@ -1928,6 +2081,7 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 			 * mode than this activation needs it to be.
 			 * Re-connect, then come back to rsl_rx_chan_activ().
 			 */
+			osmo_clock_gettime(CLOCK_MONOTONIC, &ts->dyn.switch_start);
 			rc = dyn_ts_l1_reconnect(ts);
 			if (rc)
 				return rsl_tx_chan_act_nack(lchan, RSL_ERR_NORMAL_UNSPEC);
@@ -2062,6 +2216,10 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 		const uint8_t *cur = val;
 		uint8_t num_msgs = *cur++;
 		unsigned int i;
+
+		/* replaces the BTS-global SACCH filling as a whole */
+		lchan->si.overridden = LCHAN_SACCH_SI_MASK;
+		lchan->si.valid = 0;
 		for (i = 0; i < num_msgs; i++) {
 			uint8_t rsl_si = *cur++;
 			uint8_t si_len = *cur++;
@@ -2093,7 +2251,7 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 		}
 	} else {
 		/* use standard SACCH filling of the BTS */
-		copy_sacch_si_to_lchan(lchan);
+		lchan_use_bts_sacch_si(lchan);
 	}
 
 	/* 9.3.52 MultiRate Configuration */
@@ -2140,7 +2298,7 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 		 * the PCU is not connected yet, ignore for now; the PCU will
 		 * catch up (and send the RSL ack) once it connects.
 		 */
-		if (pcu_connected()) {
+		if (pcu_connected_trx(ts->trx)) {
 			DEBUGP(DRSL, "%s Activate via PCU\n", gsm_ts_and_pchan_name(ts));
 			rc = pcu_tx_info_ind();
 		}
@@ -2429,9 +2587,12 @@ static int rsl_rx_mode_modif(struct msgb *msg)
 	struct abis_rsl_dchan_hdr *dch = msgb_l2(msg);
 	struct gsm_lchan *lchan = msg->lchan;
 	struct tlv_parsed tp;
+	struct timespec start;
 	uint8_t cause;
 	int rc;
 
+	osmo_clock_gettime(CLOCK_MONOTONIC, &start);
+
 	if (rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg)) < 0) {
 		LOGPLCHAN(lchan, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse() failed\n", __func__);
 		return rsl_tx_mode_modif_nack(lchan, RSL_ERR_PROTO);
@@ -2485,6 +2646,7 @@ static int rsl_rx_mode_modif(struct msgb *msg)
 	l1sap_chan_modify(lchan->ts->trx, dch->chan_nr);
 
 	/* FIXME: delay this until L1 says OK? */
+	bts_proc_lat_add(lchan->ts->trx->bts, BTS_PROC_LAT_MODE_MODIF, &start);
 	rsl_tx_mode_modif_ack(lchan);
 
 	return 0;
@@ -2678,6 +2840,7 @@ static int rsl_rx_sacch_inf_mod(struct msgb *msg)
 		LOGPLCHAN(lchan, DRSL, LOGL_INFO, "Rx RSL SACCH FILLING (SI%s)\n",
 			  get_value_string(osmo_sitype_strs, osmo_si));
 	} else {
+		lchan->si.overridden |= (1 << osmo_si);
 		lchan->si.valid &= ~(1 << osmo_si);
 		LOGPLCHAN(lchan, DRSL, LOGL_INFO, "Rx RSL Disabling SACCH FILLING (SI%s)\n",
 			  get_value_string(osmo_sitype_strs, osmo_si));
@@ -2733,6 +2896,16 @@ static void rsl_add_rtp_stats(struct gsm_lchan *lchan, struct msgb *msg)
 				      &packets_sent, &octets_sent,
 				      &packets_recv, &octets_recv,
 				      &packets_lost, &arrival_jitter);
+		/* ortp does not see the packets received by the media thread */
+		if (lchan->abis_ip.media) {
+			struct media_io_chan_stats st;
+
+			media_io_chan_stats(lchan->abis_ip.media, &st);
+			packets_recv = st.packets;
+			octets_recv = st.octets;
+			packets_lost = st.lost;
+			arrival_jitter = 0;
+		}
 
 		/* msgb_put_u32() uses osmo_store32be(),
 		 * so we don't need to call htonl(). */
@@ -2945,6 +3118,9 @@ static int rsl_rx_ipac_XXcx(struct msgb *msg)
 	struct in_addr ia;
 	enum rsl_ipac_rtp_csd_format_d csd_fmt_d;
 	enum rsl_ipac_rtp_csd_format_ir csd_fmt_ir;
+	struct timespec start;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &start);
 
 	if (dch->c.msg_type == RSL_MT_IPAC_CRCX)
 		name = "CRCX";
@@ -2956,8 +3132,8 @@ static int rsl_rx_ipac_XXcx(struct msgb *msg)
 		return tx_ipac_XXcx_nack(lchan, 0x52,
 					 0, dch->c.msg_type);
 
-	if (rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg)) < 0) {
-		LOGPLCHAN(lchan, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse() failed\n", __func__);
+	if (rsl_tlv_parse_ies(&tp, &rsl_ie_set_ipac_XXcx, msgb_l3(msg), msgb_l3len(msg)) < 0) {
+		LOGPLCHAN(lchan, DRSL, LOGL_ERROR, "%s(): rsl_tlv_parse_ies() failed\n", __func__);
 		return tx_ipac_XXcx_nack(lchan, RSL_ERR_PROTO, 0, dch->c.msg_type);
 	}
 
@@ -3122,6 +3298,8 @@ static int rsl_rx_ipac_XXcx(struct msgb *msg)
 
 	/* FIXME: CSD, jitterbuffer, compression */
 
+	bts_proc_lat_add(bts, dch->c.msg_type == RSL_MT_IPAC_CRCX ?
+			 BTS_PROC_LAT_IPAC_CRCX : BTS_PROC_LAT_IPAC_MDCX, &start);
 	return rsl_tx_ipac_XXcx_ack(lchan, payload_type2 ? 1 : 0,
 				    dch->c.msg_type);
 }
@@ -3276,6 +3454,7 @@ static void rsl_rx_dyn_pdch(struct msgb *msg, bool pdch_act)
 
 	ts->flags |= pdch_act? TS_F_PDCH_ACT_PENDING
 			     : TS_F_PDCH_DEACT_PENDING;
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts->dyn.pdch_start);
 
 	/* ensure that this is indeed a dynamic-PDCH channel */
 	if (ts->pchan != GSM_PCHAN_TCH_F_PDCH) {
@@ -3293,6 +3472,7 @@ static void rsl_rx_dyn_pdch(struct msgb *msg, bool pdch_act)
 		return;
 	}
 
+	ts->dyn.switch_start = ts->dyn.pdch_start;
 	if (pdch_act) {
 		/* Clear TCH state. Only first lchan matters for PDCH */
 		clear_lchan_for_pdch_activ(ts->lchan);
@@ -3307,7 +3487,7 @@ static void rsl_rx_dyn_pdch(struct msgb *msg, bool pdch_act)
 		 * disconnect immediately from here. The PCU will catch up when
 		 * it connects. */
 		/* TODO: timeout on channel connect / disconnect request from PCU? */
-		if (pcu_connected())
+		if (pcu_connected_trx(ts->trx))
 			rc = pcu_tx_info_ind();
 		else
 			rc = bts_model_ts_disconnect(ts);
@@ -3419,7 +3599,7 @@ static void ipacc_dyn_pdch_ts_connected(struct gsm_bts_trx_ts *ts, int rc)
 		/* The PDTCH is connected, now tell the PCU about it. Except
 		 * when the PCU is not connected (yet), then there's nothing
 		 * left to do now. The PCU will catch up when it connects. */
-		if (!pcu_connected()) {
+		if (!pcu_connected_trx(ts->trx)) {
 			ipacc_dyn_pdch_complete(ts, 0);
 			return;
 		}
@@ -3468,6 +3648,10 @@ void cb_ts_connected(struct gsm_bts_trx_ts *ts, int rc)
 {
 	OSMO_ASSERT(ts);
 
+	if (rc == 0)
+		bts_proc_lat_add(ts->trx->bts, BTS_PROC_LAT_TS_SWITCH, &ts->dyn.switch_start);
+	ts->dyn.switch_start = (struct timespec){ 0 };
+
 	switch (ts->pchan) {
 	case GSM_PCHAN_TCH_F_PDCH:
 		return ipacc_dyn_pdch_ts_connected(ts, rc);
@@ -3492,6 +3676,10 @@ void ipacc_dyn_pdch_complete(struct gsm_bts_trx_ts *ts, int rc)
 
 	ts->flags &= ~TS_F_PDCH_PENDING_MASK;
 
+	if (rc == 0)
+		bts_proc_lat_add(ts->trx->bts, BTS_PROC_LAT_IPAC_PDCH, &ts->dyn.pdch_start);
+	ts->dyn.pdch_start = (struct timespec){ 0 };
+
 	if (rc != 0) {
 		LOGP(DRSL, LOGL_ERROR,
 		     "PDCH %s on dynamic TCH/F_PDCH returned error %d\n",
@@ -3949,6 +4137,8 @@ static int rsl_rx_dchan(struct gsm_bts_trx *trx, struct msgb *msg)
 
 	switch (dch->c.msg_type) {
 	case RSL_MT_CHAN_ACTIV:
+		/* not in rsl_rx_chan_activ(), as it is re-entered for dynamic timeslots */
+		osmo_clock_gettime(CLOCK_MONOTONIC, &msg->lchan->chan_act_time.rx);
 		ret = rsl_rx_chan_activ(msg);
 		break;
 	case RSL_MT_RF_CHAN_REL:
@@ -4078,9 +4268,62 @@ static int rsl_rx_ipaccess(struct gsm_bts_trx *trx, struct msgb *msg)
 	return ret;
 }
 
+/* RSL message discriminators handled by down_rsl() */
+enum rsl_rx_discr {
+	RSL_RX_DISCR_RLL,
+	RSL_RX_DISCR_COM_CHAN,
+	RSL_RX_DISCR_DED_CHAN,
+	RSL_RX_DISCR_TRX,
+	RSL_RX_DISCR_IPACCESS,
+	_NUM_RSL_RX_DISCR
+};
+
+static const struct {
+	uint8_t msg_discr;
+	int (*rx)(struct gsm_bts_trx *trx, struct msgb *msg);
+} rsl_rx_discr_desc[_NUM_RSL_RX_DISCR] = {
+	/* exception: RLL messages are _NOT_ freed as they are now
+	 * owned by LAPDm which might have queued them */
+	[RSL_RX_DISCR_RLL]	= { ABIS_RSL_MDISC_RLL,		rsl_rx_rll },
+	[RSL_RX_DISCR_COM_CHAN]	= { ABIS_RSL_MDISC_COM_CHAN,	rsl_rx_cchan },
+	[RSL_RX_DISCR_DED_CHAN]	= { ABIS_RSL_MDISC_DED_CHAN,	rsl_rx_dchan },
+	[RSL_RX_DISCR_TRX]	= { ABIS_RSL_MDISC_TRX,		rsl_rx_trx },
+	[RSL_RX_DISCR_IPACCESS]	= { ABIS_RSL_MDISC_IPACCESS,	rsl_rx_ipaccess },
+};
+
+/* msg_discr (without the T bit) -> enum rsl_rx_discr + 1, 0 if unknown */
+static const uint8_t rsl_rx_discr_by_msg_discr[128] = {
+	[ABIS_RSL_MDISC_RLL >> 1]	= RSL_RX_DISCR_RLL + 1,
+	[ABIS_RSL_MDISC_COM_CHAN >> 1]	= RSL_RX_DISCR_COM_CHAN + 1,
+	[ABIS_RSL_MDISC_DED_CHAN >> 1]	= RSL_RX_DISCR_DED_CHAN + 1,
+	[ABIS_RSL_MDISC_TRX >> 1]	= RSL_RX_DISCR_TRX + 1,
+	[ABIS_RSL_MDISC_IPACCESS >> 1]	= RSL_RX_DISCR_IPACCESS + 1,
+};
+
+static struct rsl_rx_stats rsl_rx_stats[_NUM_RSL_RX_DISCR][256];
+
+/*! Get the statistics of the received RSL messages (see 'show rsl stats').
+ *  \param[in] idx entry number, starting at 0.
+ *  \returns the entry; NULL if idx is past the last one. */
+const struct rsl_rx_stats *rsl_rx_stats_get(unsigned int idx)
+{
+	struct rsl_rx_stats *st;
+
+	if (idx >= _NUM_RSL_RX_DISCR * 256)
+		return NULL;
+
+	st = &rsl_rx_stats[idx / 256][idx % 256];
+	st->msg_discr = rsl_rx_discr_desc[idx / 256].msg_discr;
+	st->msg_type = idx % 256;
+	return st;
+}
+
 int down_rsl(struct gsm_bts_trx *trx, struct msgb *msg)
 {
 	struct abis_rsl_common_hdr *rslh;
+	struct rsl_rx_stats *st;
+	struct timespec start, end;
+	unsigned int discr;
 	int ret = 0;
 
 	OSMO_ASSERT(trx);
@@ -4095,34 +4338,32 @@ int down_rsl(struct gsm_bts_trx *trx, struct msgb *msg)
 		return -EIO;
 	}
 
-	switch (rslh->msg_discr & 0xfe) {
-	case ABIS_RSL_MDISC_RLL:
-		ret = rsl_rx_rll(trx, msg);
-		/* exception: RLL messages are _NOT_ freed as they are now
-		 * owned by LAPDm which might have queued them */
-		break;
-	case ABIS_RSL_MDISC_COM_CHAN:
-		ret = rsl_rx_cchan(trx, msg);
-		break;
-	case ABIS_RSL_MDISC_DED_CHAN:
-		ret = rsl_rx_dchan(trx, msg);
-		break;
-	case ABIS_RSL_MDISC_TRX:
-		ret = rsl_rx_trx(trx, msg);
-		break;
-	case ABIS_RSL_MDISC_IPACCESS:
-		ret = rsl_rx_ipaccess(trx, msg);
-		break;
-	default:
+	TRACE(OSMO_BTS_DOWN_RSL_START(trx->nr, rslh->msg_discr));
+
+	discr = rsl_rx_discr_by_msg_discr[rslh->msg_discr >> 1];
+	if (discr == 0) {
 		LOGP(DRSL, LOGL_NOTICE, "unknown RSL msg_discr 0x%02x\n",
 			rslh->msg_discr);
 		rsl_tx_error_report(trx, RSL_ERR_MSG_DISCR, NULL, NULL, msg);
 		msgb_free(msg);
-		ret = -EINVAL;
+		TRACE(OSMO_BTS_DOWN_RSL_DONE(trx->nr, -EINVAL));
+		return -EINVAL;
 	}
 
+	/* the handler may free the msg */
+	st = &rsl_rx_stats[discr - 1][rslh->msg_type];
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &start);
+	ret = rsl_rx_discr_desc[discr - 1].rx(trx, msg);
+	osmo_clock_gettime(CLOCK_MONOTONIC, &end);
+
+	st->count++;
+	st->time_ns += (end.tv_sec - start.tv_sec) * 1000000000ULL + end.tv_nsec - start.tv_nsec;
+
 	/* we don't free here, as rsl_rx{cchan,dchan,trx,ipaccess,rll} are
 	 * responsible for owning the msg */
 
+	TRACE(OSMO_BTS_DOWN_RSL_DONE(trx->nr, ret));
+
 	return ret;
 }
@@ -61,29 +61,23 @@ static bool amr_is_octet_aligned(const uint8_t *rtp_pl, unsigned rtp_pl_len)
 	return true;
 }
 
+/* FR and EFR: fixed length, signature in the upper nibble of the first octet */
 static enum pl_input_decision
-input_preen_fr(const uint8_t *rtp_pl, unsigned rtp_pl_len)
+input_preen_fixed(const struct gsm_lchan *lchan, const uint8_t *rtp_pl,
+		  unsigned rtp_pl_len, bool *rfc5993_sid_flag)
 {
-	if (rtp_pl_len != GSM_FR_BYTES)
-		return PL_DECISION_DROP;
-	if ((rtp_pl[0] & 0xF0) != 0xD0)
-		return PL_DECISION_DROP;
-	return PL_DECISION_ACCEPT;
-}
+	const struct rtp_input_preen *preen = lchan->abis_ip.preen;
 
-static enum pl_input_decision
-input_preen_efr(const uint8_t *rtp_pl, unsigned rtp_pl_len)
-{
-	if (rtp_pl_len != GSM_EFR_BYTES)
+	if (rtp_pl_len != preen->len)
 		return PL_DECISION_DROP;
-	if ((rtp_pl[0] & 0xF0) != 0xC0)
+	if ((rtp_pl[0] & 0xF0) != preen->sig)
 		return PL_DECISION_DROP;
 	return PL_DECISION_ACCEPT;
 }
 
 static enum pl_input_decision
-input_preen_hr(const uint8_t *rtp_pl, unsigned rtp_pl_len,
-		bool *rfc5993_sid_flag)
+input_preen_hr(const struct gsm_lchan *lchan, const uint8_t *rtp_pl,
+	       unsigned rtp_pl_len, bool *rfc5993_sid_flag)
 {
 	switch (rtp_pl_len) {
 	case GSM_HR_BYTES:
@@ -111,6 +105,66 @@ input_preen_hr(const uint8_t *rtp_pl, unsigned rtp_pl_len,
 	}
 }
 
+static enum pl_input_decision
+input_preen_amr(const struct gsm_lchan *lchan, const uint8_t *rtp_pl,
+		unsigned rtp_pl_len, bool *rfc5993_sid_flag)
+{
+	/* Avoid forwarding bw-efficient AMR to lower layers,
+	 * most bts models don't support it. */
+	if (!amr_is_octet_aligned(rtp_pl, rtp_pl_len)) {
+		LOGPLCHAN(lchan, DL1P, LOGL_NOTICE,
+			  "RTP->L1: Dropping unexpected AMR encoding (bw-efficient?) %s\n",
+			  osmo_hexdump(rtp_pl, rtp_pl_len));
+		return PL_DECISION_DROP;
+	}
+	return PL_DECISION_ACCEPT;
+}
+
+static enum pl_input_decision
+input_preen_none(const struct gsm_lchan *lchan, const uint8_t *rtp_pl,
+		 unsigned rtp_pl_len, bool *rfc5993_sid_flag)
+{
+	return PL_DECISION_ACCEPT;
+}
+
+static const struct rtp_input_preen preen_fr = {
+	.fn = input_preen_fixed,
+	.len = GSM_FR_BYTES,
+	.sig = 0xD0,
+};
+static const struct rtp_input_preen preen_efr = {
+	.fn = input_preen_fixed,
+	.len = GSM_EFR_BYTES,
+	.sig = 0xC0,
+};
+static const struct rtp_input_preen preen_hr = { .fn = input_preen_hr };
+static const struct rtp_input_preen preen_amr = { .fn = input_preen_amr };
+static const struct rtp_input_preen preen_none = { .fn = input_preen_none };
+
+/*! Select the validation of the RTP input for the channel mode of \a lchan,
+ *  so that the per-packet path does not need to look at the mode.  Must be
+ *  called whenever lchan->tch_mode is (re)assigned. */
+void rtp_input_preen_setup(struct gsm_lchan *lchan)
+{
+	switch (lchan->tch_mode) {
+	case GSM48_CMODE_SPEECH_V1:
+		if (lchan->type == GSM_LCHAN_TCH_F)
+			lchan->abis_ip.preen = &preen_fr;
+		else
+			lchan->abis_ip.preen = &preen_hr;
+		break;
+	case GSM48_CMODE_SPEECH_EFR:
+		lchan->abis_ip.preen = &preen_efr;
+		break;
+	case GSM48_CMODE_SPEECH_AMR:
+		lchan->abis_ip.preen = &preen_amr;
+		break;
+	default:
+		lchan->abis_ip.preen = &preen_none;
+		break;
+	}
+}
+
 enum pl_input_decision
 rtp_payload_input_preen(struct gsm_lchan *lchan, const uint8_t *rtp_pl,
 			unsigned rtp_pl_len, bool *rfc5993_sid_flag)
@@ -127,25 +181,9 @@ rtp_payload_input_preen(struct gsm_lchan *lchan, const uint8_t *rtp_pl,
 	if (rtp_pl_len == 0)
 		return PL_DECISION_DROP;
 
-	switch (lchan->tch_mode) {
-	case GSM48_CMODE_SPEECH_V1:
-		if (lchan->type == GSM_LCHAN_TCH_F)
-			return input_preen_fr(rtp_pl, rtp_pl_len);
-		else
-			return input_preen_hr(rtp_pl, rtp_pl_len, rfc5993_sid_flag);
-	case GSM48_CMODE_SPEECH_EFR:
-		return input_preen_efr(rtp_pl, rtp_pl_len);
-	case GSM48_CMODE_SPEECH_AMR:
-		/* Avoid forwarding bw-efficient AMR to lower layers,
-		 * most bts models don't support it. */
-		if (!amr_is_octet_aligned(rtp_pl, rtp_pl_len)) {
-			LOGPLCHAN(lchan, DL1P, LOGL_NOTICE,
-				  "RTP->L1: Dropping unexpected AMR encoding (bw-efficient?) %s\n",
-				  osmo_hexdump(rtp_pl, rtp_pl_len));
-			return PL_DECISION_DROP;
-		}
-		return PL_DECISION_ACCEPT;
-	default:
+	/* not set up if no Channel Mode has been received (yet) */
+	if (OSMO_UNLIKELY(!lchan->abis_ip.preen))
 		return PL_DECISION_ACCEPT;
-	}
+
+	return lchan->abis_ip.preen->fn(lchan, rtp_pl, rtp_pl_len, rfc5993_sid_flag);
 }
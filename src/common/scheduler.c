@@ -26,6 +26,13 @@
 #include <errno.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/talloc.h>
@@ -574,14 +581,13 @@ const struct trx_chan_desc trx_chan_desc[_TRX_CHAN_MAX] = {
 	},
 };
 
-enum {
-	L1SCHED_TS_CTR_DL_LATE,
-	L1SCHED_TS_CTR_DL_NOT_FOUND,
-};
-
 static const struct rate_ctr_desc l1sched_ts_ctr_desc[] = {
 	[L1SCHED_TS_CTR_DL_LATE] =	{"l1sched_ts:dl_late", "Downlink frames arrived too late to submit to lower layers"},
 	[L1SCHED_TS_CTR_DL_NOT_FOUND] =	{"l1sched_ts:dl_not_found", "Downlink frames not found while scheduling"},
+	[L1SCHED_TS_CTR_CPU_RTS_US] =	{"l1sched_ts:cpu_rts_us", "CPU time of the RTS handlers (us, with cpu-accounting)"},
+	[L1SCHED_TS_CTR_CPU_DL_US] =	{"l1sched_ts:cpu_dl_us", "CPU time of the Downlink burst handlers (us, with cpu-accounting)"},
+	[L1SCHED_TS_CTR_CPU_UL_US] =	{"l1sched_ts:cpu_ul_us", "CPU time of the Uplink burst handlers (us, with cpu-accounting)"},
+	[L1SCHED_TS_CTR_UL_LOST_FN] =	{"l1sched_ts:ul_lost_fn", "Uplink TDMA frames of active logical channels lost"},
 };
 static const struct rate_ctr_group_desc l1sched_ts_ctrg_desc = {
 	"l1sched_ts",
@@ -595,14 +601,112 @@ static const struct rate_ctr_group_desc l1sched_ts_ctrg_desc = {
  * init / exit
  */
 
-static void trx_sched_init_ts(struct gsm_bts_trx_ts *ts,
-			      const unsigned int rate_ctr_idx)
+/* Size of a burst buffer slot: sufficient to store up to 24 GMSK modulated
+ * bursts for CSD or up to 8 8PSK modulated bursts for EGPRS. */
+#define BURST_BUF_SIZE		(24 * GSM_NBITS_NB_GMSK_PAYLOAD)
+/* Worst case number of slots in use on a timeslot: SDCCH/8 (DL + UL) and
+ * SACCH/8 (DL + UL + previous UL) on all 8 sub-slots, plus the CBCH.  Shadow
+ * timeslots only carry TCH/H or TCH/F with their SACCH. */
+#define BURST_BUF_SLOTS		(8 * 2 + 8 * 3 + 1)
+#define BURST_BUF_SLOTS_SHADOW	(2 * 3 + 2 * 3)
+
+osmo_static_assert(BURST_BUF_SLOTS <= 64, burst_bufs_used_size)
+
+/* Hand out 'n' contiguous slots from the burst buffer arena of the timeslot */
+static void *burst_buf_get(struct l1sched_ts *l1ts, unsigned int n)
+{
+	const uint64_t mask = (1ULL << n) - 1;
+	unsigned int i;
+	uint8_t *buf;
+
+	for (i = 0; i + n <= l1ts->burst_bufs_num; i++) {
+		if (l1ts->burst_bufs_used & (mask << i))
+			continue;
+		l1ts->burst_bufs_used |= mask << i;
+		buf = l1ts->burst_bufs + i * BURST_BUF_SIZE;
+		memset(buf, 0, n * BURST_BUF_SIZE);
+		return buf;
+	}
+
+	/* Shall not happen, but better fall back to the heap than fail */
+	LOGP(DL1C, LOGL_NOTICE, "%s: burst buffer arena exhausted\n",
+	     gsm_ts_name(l1ts->ts));
+	return talloc_zero_size(l1ts, n * BURST_BUF_SIZE);
+}
+
+static void burst_buf_put(struct l1sched_ts *l1ts, void *buf, unsigned int n)
+{
+	const uint8_t *ptr = buf;
+	unsigned int i;
+
+	if (buf == NULL)
+		return;
+	if (ptr < l1ts->burst_bufs || ptr >= l1ts->burst_bufs + l1ts->burst_bufs_num * BURST_BUF_SIZE) {
+		talloc_free(buf);
+		return;
+	}
+
+	i = (ptr - l1ts->burst_bufs) / BURST_BUF_SIZE;
+	l1ts->burst_bufs_used &= ~(((1ULL << n) - 1) << i);
+}
+
+/* Worst case number of logical channels with an Uplink on a timeslot:
+ * SDCCH/8 and SACCH/8 on all 8 sub-slots; shadow timeslots as above. */
+#define MEAS_RINGS		(8 * 2)
+#define MEAS_RINGS_SHADOW	(2 * 2)
+
+osmo_static_assert(MEAS_RINGS <= 32, meas_rings_used_size)
+
+/* Hand out a measurement history from the arena of the timeslot */
+static struct l1sched_meas_ring *meas_ring_get(struct l1sched_ts *l1ts)
+{
+	unsigned int i;
+
+	for (i = 0; i < l1ts->meas_rings_num; i++) {
+		if (l1ts->meas_rings_used & (1U << i))
+			continue;
+		l1ts->meas_rings_used |= 1U << i;
+		memset(&l1ts->meas_rings[i], 0, sizeof(l1ts->meas_rings[i]));
+		return &l1ts->meas_rings[i];
+	}
+
+	/* Shall not happen, but better fall back to the heap than fail */
+	LOGP(DL1C, LOGL_NOTICE, "%s: measurement history arena exhausted\n",
+	     gsm_ts_name(l1ts->ts));
+	return talloc_zero(l1ts, struct l1sched_meas_ring);
+}
+
+static void meas_ring_put(struct l1sched_ts *l1ts, struct l1sched_meas_ring *ring)
+{
+	if (ring == NULL)
+		return;
+	if (ring < l1ts->meas_rings || ring >= l1ts->meas_rings + l1ts->meas_rings_num) {
+		talloc_free(ring);
+		return;
+	}
+
+	l1ts->meas_rings_used &= ~(1U << (ring - l1ts->meas_rings));
+}
+
+/* TCH/F and TCH/H keep each Uplink burst twice (ring buffer),
+ * see BUFRPOS() in osmo-bts-trx/sched_utils.h. */
+static unsigned int ul_burst_buf_slots(enum trx_chan_type chan)
+{
+	if (chan == TRXC_TCHF || chan == TRXC_TCHH_0 || chan == TRXC_TCHH_1)
+		return 2;
+	return 1;
+}
+
+static void trx_sched_alloc_ts(struct gsm_bts_trx_ts *ts,
+			       const unsigned int rate_ctr_idx)
 {
 	struct l1sched_ts *l1ts;
 	unsigned int i;
 	char name[128];
 
-	l1ts = talloc_zero(ts->trx, struct l1sched_ts);
+	/* Allocated from the hugepage pool (if any), along with the burst
+	 * buffer arena and the dispatch tables, which are its children */
+	l1ts = talloc_zero(bts_hp_ctx(ts->trx), struct l1sched_ts);
 	OSMO_ASSERT(l1ts != NULL);
 
 	/* Link both structures */
@@ -617,7 +721,20 @@ static void trx_sched_init_ts(struct gsm_bts_trx_ts *ts,
 		 ts->vamos.is_shadow ? "-shadow" : "");
 	rate_ctr_group_set_name(l1ts->ctrs, name);
 
-	INIT_LLIST_HEAD(&l1ts->dl_prims);
+	for (i = 0; i < ARRAY_SIZE(l1ts->dl_prims); i++)
+		INIT_LLIST_HEAD(&l1ts->dl_prims[i]);
+
+	/* One contiguous arena for the burst buffers of all logical channels,
+	 * so that activating and releasing channels does not hit the heap */
+	l1ts->burst_bufs_num = ts->vamos.is_shadow ? BURST_BUF_SLOTS_SHADOW : BURST_BUF_SLOTS;
+	l1ts->burst_bufs = talloc_zero_size(l1ts, l1ts->burst_bufs_num * BURST_BUF_SIZE);
+	OSMO_ASSERT(l1ts->burst_bufs != NULL);
+
+	/* The measurement histories are kept out of l1sched_chan_state, as only
+	 * the few channels on the multiframe of the timeslot can be active */
+	l1ts->meas_rings_num = ts->vamos.is_shadow ? MEAS_RINGS_SHADOW : MEAS_RINGS;
+	l1ts->meas_rings = talloc_zero_array(l1ts, struct l1sched_meas_ring, l1ts->meas_rings_num);
+	OSMO_ASSERT(l1ts->meas_rings != NULL);
 
 	for (i = 0; i < ARRAY_SIZE(l1ts->chan_state); i++) {
 		struct l1sched_chan_state *chan_state;
@@ -626,10 +743,11 @@ static void trx_sched_init_ts(struct gsm_bts_trx_ts *ts,
 	}
 }
 
+/* The scheduler structures of a timeslot are only allocated once it gets a
+ * channel combination, see trx_sched_set_pchan(): locked TRX and timeslots
+ * configured as NONE cost neither memory nor rate counter groups. */
 void trx_sched_init(struct gsm_bts_trx *trx)
 {
-	unsigned int tn;
-
 	OSMO_ASSERT(trx != NULL);
 
 	LOGPTRX(trx, DL1C, LOGL_DEBUG, "Init scheduler structures\n");
@@ -637,14 +755,20 @@ void trx_sched_init(struct gsm_bts_trx *trx)
 	/* Allocate shadow timeslots */
 	gsm_bts_trx_init_shadow_ts(trx);
 
-	for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
-		unsigned int rate_ctr_idx = trx->nr * 100 + tn;
-		struct gsm_bts_trx_ts *ts = &trx->ts[tn];
+	/* Have the buffers of this TRX served from pre-faulted memory */
+	bts_mem_prefault_heap(trx->bts);
+}
 
-		/* Init primary and shadow timeslots */
-		trx_sched_init_ts(ts, rate_ctr_idx);
-		trx_sched_init_ts(ts->vamos.peer, rate_ctr_idx + 10);
-	}
+/* Allocate the structures of a primary timeslot and its shadow (if any) */
+static void trx_sched_ts_alloc(struct gsm_bts_trx_ts *ts)
+{
+	unsigned int rate_ctr_idx = ts->trx->nr * 100 + ts->nr;
+
+	LOGP(DL1C, LOGL_DEBUG, "%s Alloc scheduler structures\n", gsm_ts_name(ts));
+
+	trx_sched_alloc_ts(ts, rate_ctr_idx);
+	if (ts->vamos.peer != NULL)
+		trx_sched_alloc_ts(ts->vamos.peer, rate_ctr_idx + 10);
 }
 
 static void trx_sched_clean_ts(struct gsm_bts_trx_ts *ts)
@@ -652,7 +776,12 @@ static void trx_sched_clean_ts(struct gsm_bts_trx_ts *ts)
 	struct l1sched_ts *l1ts = ts->priv;
 	unsigned int i;
 
-	msgb_queue_free(&l1ts->dl_prims);
+	if (l1ts == NULL)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(l1ts->dl_prims); i++)
+		msgb_queue_free(&l1ts->dl_prims[i]);
+	l1ts->dl_prims_num = 0;
 	rate_ctr_group_free(l1ts->ctrs);
 	l1ts->ctrs = NULL;
 
@@ -678,51 +807,122 @@ void trx_sched_clean(struct gsm_bts_trx *trx)
 		trx_sched_clean_ts(ts->vamos.peer);
 	}
 
+	trx->l1sched_ts_active = 0x00;
+
 	/* Free previously allocated shadow timeslots */
 	gsm_bts_trx_free_shadow_ts(trx);
 }
 
+/* obtain TDMA FN, chan_nr and link_id of a queued Downlink primitive */
+static int sched_dl_prim_info(struct msgb *msg, uint32_t *fn,
+			      uint8_t *chan_nr, uint8_t *link_id)
+{
+	const struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
+
+	switch (l1sap->oph.primitive) {
+	case PRIM_PH_DATA:
+		*chan_nr = l1sap->u.data.chan_nr;
+		*link_id = l1sap->u.data.link_id;
+		*fn = l1sap->u.data.fn;
+		return 0;
+	case PRIM_TCH:
+		*chan_nr = l1sap->u.tch.chan_nr;
+		*link_id = 0;
+		*fn = l1sap->u.tch.fn;
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* Put a Downlink primitive into the ring bucket of its TDMA FN */
+static void sched_dl_prim_enqueue(struct l1sched_ts *l1ts, struct msgb *msg, uint32_t fn)
+{
+	msgb_enqueue(&l1ts->dl_prims[fn % L1SCHED_DL_PRIMS_RING_LEN], msg);
+	l1ts->dl_prims_num++;
+}
+
+/* Unlink a Downlink primitive from its ring bucket */
+static void sched_dl_prim_unlink(struct l1sched_ts *l1ts, struct msgb *msg)
+{
+	llist_del(&msg->list);
+	OSMO_ASSERT(l1ts->dl_prims_num > 0);
+	l1ts->dl_prims_num--;
+}
+
+/* Unlink, count and free a primitive which arrived too late */
+static void sched_dl_prim_drop_late(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br,
+				    struct msgb *msg, uint32_t l1sap_fn, uint8_t chan_nr)
+{
+	LOGL1SB(DL1P, LOGL_NOTICE, l1ts, br,
+	     "Prim %u is out of range (%u vs exp %u), or channel %s with "
+	     "type %s is already disabled. If this happens in "
+	     "conjunction with PCU, increase 'rts-advance' by 5.\n",
+	     GSM_TDMA_FN_SUB(l1sap_fn, br->fn), l1sap_fn, br->fn,
+	     get_lchan_by_chan_nr(l1ts->ts->trx, chan_nr)->name,
+	     trx_chan_desc[br->chan].name);
+	rate_ctr_inc2(l1ts->ctrs, L1SCHED_TS_CTR_DL_LATE);
+	sched_dl_prim_unlink(l1ts, msg);
+	msgb_free(msg);
+}
+
+/* Drop late prims from the ring buckets of the frames passed since the last call */
+static void sched_dl_prims_sweep(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br)
+{
+	uint32_t num_fn, i;
+
+	if (!l1ts->dl_prims_sweep_valid) {
+		l1ts->dl_prims_sweep_valid = true;
+		num_fn = L1SCHED_DL_PRIMS_RING_LEN;
+	} else {
+		num_fn = GSM_TDMA_FN_SUB(br->fn, l1ts->dl_prims_sweep_fn);
+		if (num_fn > L1SCHED_DL_PRIMS_RING_LEN)
+			num_fn = L1SCHED_DL_PRIMS_RING_LEN;
+	}
+	l1ts->dl_prims_sweep_fn = br->fn;
+
+	if (l1ts->dl_prims_num == 0)
+		return;
+
+	for (i = 1; i <= num_fn; i++) {
+		const uint32_t fn = GSM_TDMA_FN_SUB(br->fn, i);
+		struct llist_head *q = &l1ts->dl_prims[fn % L1SCHED_DL_PRIMS_RING_LEN];
+		struct msgb *msg, *msg2;
+
+		llist_for_each_entry_safe(msg, msg2, q, list) {
+			uint32_t l1sap_fn;
+			uint8_t chan_nr, link_id;
+
+			if (sched_dl_prim_info(msg, &l1sap_fn, &chan_nr, &link_id) != 0)
+				continue; /* dropped by _sched_dequeue_prim() */
+			if (GSM_TDMA_FN_SUB(l1sap_fn, br->fn) > 100) /* l1sap_fn < fn */
+				sched_dl_prim_drop_late(l1ts, br, msg, l1sap_fn, chan_nr);
+		}
+	}
+}
+
 struct msgb *_sched_dequeue_prim(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br)
 {
+	struct llist_head *q = &l1ts->dl_prims[br->fn % L1SCHED_DL_PRIMS_RING_LEN];
 	struct msgb *msg, *msg2;
-	uint32_t prim_fn, l1sap_fn;
+	uint32_t l1sap_fn;
 	uint8_t chan_nr, link_id;
 
-	/* get prim of current fn from queue */
-	llist_for_each_entry_safe(msg, msg2, &l1ts->dl_prims, list) {
-		struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
-		switch (l1sap->oph.primitive) {
-		case PRIM_PH_DATA:
-			chan_nr = l1sap->u.data.chan_nr;
-			link_id = l1sap->u.data.link_id;
-			l1sap_fn = l1sap->u.data.fn;
-			break;
-		case PRIM_TCH:
-			chan_nr = l1sap->u.tch.chan_nr;
-			link_id = 0;
-			l1sap_fn = l1sap->u.tch.fn;
-			break;
-		default:
+	/* drop prims which have not been picked up in time */
+	sched_dl_prims_sweep(l1ts, br);
+
+	/* get prim of current fn from its ring bucket */
+	llist_for_each_entry_safe(msg, msg2, q, list) {
+		if (sched_dl_prim_info(msg, &l1sap_fn, &chan_nr, &link_id) != 0) {
 			LOGL1SB(DL1P, LOGL_ERROR, l1ts, br, "Prim has wrong type.\n");
 			goto free_msg;
 		}
-		prim_fn = GSM_TDMA_FN_SUB(l1sap_fn, br->fn);
-		if (prim_fn > 100) { /* l1sap_fn < fn */
-			LOGL1SB(DL1P, LOGL_NOTICE, l1ts, br,
-			     "Prim %u is out of range (%u vs exp %u), or channel %s with "
-			     "type %s is already disabled. If this happens in "
-			     "conjunction with PCU, increase 'rts-advance' by 5.\n",
-			     prim_fn, l1sap_fn, br->fn,
-			     get_lchan_by_chan_nr(l1ts->ts->trx, chan_nr)->name,
-			     trx_chan_desc[br->chan].name);
-			rate_ctr_inc2(l1ts->ctrs, L1SCHED_TS_CTR_DL_LATE);
-			/* unlink and free message */
-			llist_del(&msg->list);
-			msgb_free(msg);
+		if (l1sap_fn != br->fn) {
+			if (GSM_TDMA_FN_SUB(l1sap_fn, br->fn) > 100) /* l1sap_fn < fn */
+				sched_dl_prim_drop_late(l1ts, br, msg, l1sap_fn, chan_nr);
+			/* else: l1sap_fn > fn, one ring period ahead */
 			continue;
 		}
-		if (prim_fn > 0) /* l1sap_fn > fn */
-			break;
 
 		/* l1sap_fn == fn */
 		if ((chan_nr ^ (trx_chan_desc[br->chan].chan_nr | br->tn))
@@ -734,21 +934,45 @@ struct msgb *_sched_dequeue_prim(struct l1sched_ts *l1ts, const struct trx_dl_bu
 		}
 
 		/* unlink and return message */
-		llist_del(&msg->list);
+		sched_dl_prim_unlink(l1ts, msg);
 		return msg;
 	}
 
-	/* Queue was traversed with no candidate, no prim is available for current FN: */
+	/* No prim is available for current FN: */
 	rate_ctr_inc2(l1ts->ctrs, L1SCHED_TS_CTR_DL_NOT_FOUND);
 	return NULL;
 
 free_msg:
 	/* unlink and free message */
-	llist_del(&msg->list);
+	sched_dl_prim_unlink(l1ts, msg);
 	msgb_free(msg);
 	return NULL;
 }
 
+/* Find the prim queued for the given FN and logical channel, leaving it queued.
+ * Unlike _sched_dequeue_prim(), neither late prims are dropped nor is a
+ * missing prim accounted. */
+struct msgb *_sched_peek_prim(struct l1sched_ts *l1ts, uint32_t fn, enum trx_chan_type chan)
+{
+	struct llist_head *q = &l1ts->dl_prims[fn % L1SCHED_DL_PRIMS_RING_LEN];
+	struct msgb *msg;
+	uint32_t l1sap_fn;
+	uint8_t chan_nr, link_id;
+
+	llist_for_each_entry(msg, q, list) {
+		if (sched_dl_prim_info(msg, &l1sap_fn, &chan_nr, &link_id) != 0)
+			continue;
+		if (l1sap_fn != fn)
+			continue;
+		if ((chan_nr ^ (trx_chan_desc[chan].chan_nr | l1ts->ts->nr))
+		 || ((link_id & 0xc0) ^ trx_chan_desc[chan].link_id))
+			continue;
+		return msg;
+	}
+
+	return NULL;
+}
+
 int _sched_compose_ph_data_ind(struct l1sched_ts *l1ts, uint32_t fn,
 			       enum trx_chan_type chan,
 			       const uint8_t *data, size_t data_len,
@@ -787,6 +1011,36 @@ int _sched_compose_ph_data_ind(struct l1sched_ts *l1ts, uint32_t fn,
 	return 0;
 }
 
+struct msgb *_sched_pdtch_ind_alloc(struct l1sched_ts *l1ts, enum trx_chan_type chan,
+				    uint8_t **data)
+{
+	uint8_t chan_nr = trx_chan_desc[chan].chan_nr | l1ts->ts->nr;
+
+	return l1sap_pdtch_ind_alloc(l1ts->ts->trx, chan_nr, data);
+}
+
+int _sched_compose_pdtch_ind(struct l1sched_ts *l1ts, struct msgb *msg, uint32_t fn,
+			     enum trx_chan_type chan, size_t data_len,
+			     uint16_t ber10k, float rssi,
+			     int16_t ta_offs_256bits, int16_t link_qual_cb,
+			     enum osmo_ph_pres_info_type presence_info)
+{
+	struct ph_data_param data_ind = {
+		.chan_nr = trx_chan_desc[chan].chan_nr | l1ts->ts->nr,
+		.link_id = trx_chan_desc[chan].link_id,
+		.fn = fn,
+		.rssi = (int8_t) (rssi),
+		.ber10k = ber10k,
+		.ta_offs_256bits = ta_offs_256bits,
+		.lqual_cb = link_qual_cb,
+		.pdch_presence_info = presence_info,
+	};
+
+	l1sap_pdtch_ind_send(l1ts->ts->trx, msg, &data_ind, data_len);
+
+	return 0;
+}
+
 int _sched_compose_tch_ind(struct l1sched_ts *l1ts, uint32_t fn,
 			   enum trx_chan_type chan,
 			   const uint8_t *data, size_t data_len,
@@ -839,6 +1093,12 @@ int trx_sched_ph_data_req(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap
 	uint8_t tn = L1SAP_CHAN2TS(l1sap->u.data.chan_nr);
 	struct l1sched_ts *l1ts = trx->ts[tn].priv;
 
+	/* no channel combination on this timeslot */
+	if (OSMO_UNLIKELY(l1ts == NULL)) {
+		msgb_free(l1sap->oph.msg);
+		return -ENODEV;
+	}
+
 	LOGL1S(DL1P, LOGL_DEBUG, l1ts, -1, l1sap->u.data.fn,
 		"PH-DATA.req: chan_nr=0x%02x link_id=0x%02x\n",
 		l1sap->u.data.chan_nr, l1sap->u.data.link_id);
@@ -853,7 +1113,7 @@ int trx_sched_ph_data_req(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap
 	if (trx->ts[tn].vamos.is_shadow)
 		l1sap->u.data.chan_nr &= ~RSL_CHAN_OSMO_VAMOS_MASK;
 
-	msgb_enqueue(&l1ts->dl_prims, l1sap->oph.msg);
+	sched_dl_prim_enqueue(l1ts, l1sap->oph.msg, l1sap->u.data.fn);
 
 	return 0;
 }
@@ -863,6 +1123,12 @@ int trx_sched_tch_req(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 	uint8_t tn = L1SAP_CHAN2TS(l1sap->u.tch.chan_nr);
 	struct l1sched_ts *l1ts = trx->ts[tn].priv;
 
+	/* no channel combination on this timeslot */
+	if (OSMO_UNLIKELY(l1ts == NULL)) {
+		msgb_free(l1sap->oph.msg);
+		return -ENODEV;
+	}
+
 	LOGL1S(DL1P, LOGL_DEBUG, l1ts, -1, l1sap->u.tch.fn,
 	       "TCH.req: chan_nr=0x%02x\n", l1sap->u.tch.chan_nr);
 
@@ -876,7 +1142,7 @@ int trx_sched_tch_req(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
 	if (trx->ts[tn].vamos.is_shadow)
 		l1sap->u.tch.chan_nr &= ~RSL_CHAN_OSMO_VAMOS_MASK;
 
-	msgb_enqueue(&l1ts->dl_prims, l1sap->oph.msg);
+	sched_dl_prim_enqueue(l1ts, l1sap->oph.msg, l1sap->u.tch.fn);
 
 	return 0;
 }
@@ -1002,61 +1268,179 @@ static int rts_tchh_fn(const struct l1sched_ts *l1ts, const struct trx_dl_burst_
 	return rts_tch_common(l1ts, br, sched_tchh_dl_facch_map[br->fn % 26]);
 }
 
+/* (re)build the per-timeslot dispatch tables for the given multiframe */
+static void trx_sched_build_mf_tables(struct l1sched_ts *l1ts, const struct trx_sched_multiframe *mf)
+{
+	unsigned int i;
+
+	TALLOC_FREE(l1ts->mf_dl);
+	TALLOC_FREE(l1ts->mf_ul);
+
+	l1ts->mf_dl = talloc_array(l1ts, struct l1sched_dl_frame, mf->period);
+	l1ts->mf_ul = talloc_array(l1ts, struct l1sched_ul_frame, mf->period);
+	OSMO_ASSERT(l1ts->mf_dl != NULL && l1ts->mf_ul != NULL);
+
+	for (i = 0; i < mf->period; i++) {
+		const struct trx_sched_frame *frame = &mf->frames[i];
+
+		l1ts->mf_dl[i] = (struct l1sched_dl_frame) {
+			.rts_fn = trx_chan_desc[frame->dl_chan].rts_fn,
+			.dl_fn = trx_chan_desc[frame->dl_chan].dl_fn,
+			.chan_state = &l1ts->chan_state[frame->dl_chan],
+			.chan = frame->dl_chan,
+			.bid = frame->dl_bid,
+		};
+		l1ts->mf_ul[i] = (struct l1sched_ul_frame) {
+			.ul_fn = trx_chan_desc[frame->ul_chan].ul_fn,
+			.chan_state = &l1ts->chan_state[frame->ul_chan],
+			.chan = frame->ul_chan,
+			.bid = frame->ul_bid,
+		};
+	}
+
+	l1ts->mf_period = mf->period;
+	l1ts->mf_frames = mf->frames;
+}
+
+/* Select the dispatch tables of multiframe 'mf_index'.  The tables of the
+ * current multiframe are staged rather than freed, so that a dynamic TS
+ * switching back and forth only swaps pointers instead of rebuilding them
+ * (the chan_state they point to is per timeslot and does not move). */
+static void trx_sched_select_mf(struct l1sched_ts *l1ts, uint8_t mf_index)
+{
+	const struct trx_sched_multiframe *mf = &trx_sched_multiframes[mf_index];
+	unsigned int i;
+
+	if (l1ts->mf_dl != NULL && l1ts->mf_index == mf_index)
+		return;
+
+	if (l1ts->mf_dl != NULL) {
+		if (l1ts->mf_staged_num == ARRAY_SIZE(l1ts->mf_staged)) {
+			/* drop the least recently used one */
+			talloc_free(l1ts->mf_staged[0].dl);
+			talloc_free(l1ts->mf_staged[0].ul);
+			memmove(&l1ts->mf_staged[0], &l1ts->mf_staged[1],
+				sizeof(l1ts->mf_staged[0]) * --l1ts->mf_staged_num);
+		}
+		l1ts->mf_staged[l1ts->mf_staged_num].mf_index = l1ts->mf_index;
+		l1ts->mf_staged[l1ts->mf_staged_num].dl = l1ts->mf_dl;
+		l1ts->mf_staged[l1ts->mf_staged_num].ul = l1ts->mf_ul;
+		l1ts->mf_staged_num++;
+		l1ts->mf_dl = NULL;
+		l1ts->mf_ul = NULL;
+	}
+
+	for (i = 0; i < l1ts->mf_staged_num; i++) {
+		if (l1ts->mf_staged[i].mf_index != mf_index)
+			continue;
+		l1ts->mf_dl = l1ts->mf_staged[i].dl;
+		l1ts->mf_ul = l1ts->mf_staged[i].ul;
+		memmove(&l1ts->mf_staged[i], &l1ts->mf_staged[i + 1],
+			sizeof(l1ts->mf_staged[0]) * (l1ts->mf_staged_num - i - 1));
+		l1ts->mf_staged_num--;
+		l1ts->mf_period = mf->period;
+		l1ts->mf_frames = mf->frames;
+		l1ts->mf_index = mf_index;
+		return;
+	}
+
+	trx_sched_build_mf_tables(l1ts, mf);
+	l1ts->mf_index = mf_index;
+}
+
 /* set multiframe scheduler to given pchan */
 int trx_sched_set_pchan(struct gsm_bts_trx_ts *ts, enum gsm_phys_chan_config pchan)
 {
-	struct l1sched_ts *l1ts = ts->priv;
 	int i = find_sched_mframe_idx(pchan, ts->nr);
 	if (i < 0) {
 		LOGP(DL1C, LOGL_NOTICE, "%s Failed to configure multiframe (pchan=0x%02x)\n",
 		     gsm_ts_name(ts), pchan);
 		return -ENOTSUP;
 	}
-	l1ts->mf_index = i;
-	l1ts->mf_period = trx_sched_multiframes[i].period;
-	l1ts->mf_frames = trx_sched_multiframes[i].frames;
-	if (ts->vamos.peer != NULL) {
-		l1ts = ts->vamos.peer->priv;
-		l1ts->mf_index = i;
-		l1ts->mf_period = trx_sched_multiframes[i].period;
-		l1ts->mf_frames = trx_sched_multiframes[i].frames;
+
+	if (pchan == GSM_PCHAN_NONE) {
+		/* Dynamic timeslots are only NONE until the next switch,
+		 * keep their structures (and rate counters) around */
+		if (ts->pchan == GSM_PCHAN_NONE) {
+			if (ts->priv != NULL)
+				LOGP(DL1C, LOGL_DEBUG, "%s Free scheduler structures\n", gsm_ts_name(ts));
+			trx_sched_clean_ts(ts);
+			if (ts->vamos.peer != NULL)
+				trx_sched_clean_ts(ts->vamos.peer);
+			trx_sched_update_ts_active(ts);
+			return 0;
+		}
+		if (ts->priv == NULL)
+			return 0;
+	} else if (ts->priv == NULL) {
+		trx_sched_ts_alloc(ts);
 	}
+
+	trx_sched_select_mf(ts->priv, i);
+	if (ts->vamos.peer != NULL)
+		trx_sched_select_mf(ts->vamos.peer->priv, i);
+	trx_sched_update_ts_active(ts);
 	LOGP(DL1C, LOGL_NOTICE, "%s Configured multiframe with '%s'\n",
 	     gsm_ts_name(ts), trx_sched_multiframes[i].name);
 	return 0;
 }
 
-/* Remove all matching (by chan_nr & link_id) primitives from the given queue */
-static void trx_sched_queue_filter(struct llist_head *q, uint8_t chan_nr, uint8_t link_id)
+/* Update the bitmap of timeslots with active logical channels for the given
+ * (primary or shadow) timeslot, see gsm_bts_trx->l1sched_ts_active. */
+static void trx_sched_update_ts_active(const struct gsm_bts_trx_ts *ts)
+{
+	const struct l1sched_ts *l1ts = ts->priv;
+	const struct l1sched_ts *peer_l1ts = NULL;
+	struct gsm_bts_trx *trx = ts->trx;
+
+	if (ts->vamos.peer != NULL)
+		peer_l1ts = ts->vamos.peer->priv;
+
+	if ((l1ts != NULL && l1ts->num_active_chans > 0) ||
+	    (peer_l1ts != NULL && peer_l1ts->num_active_chans > 0))
+		trx->l1sched_ts_active |= (1 << ts->nr);
+	else
+		trx->l1sched_ts_active &= ~(1 << ts->nr);
+}
+
+/* Remove all matching (by chan_nr & link_id) primitives from the Downlink ring */
+static void trx_sched_queue_filter(struct l1sched_ts *l1ts, uint8_t chan_nr, uint8_t link_id)
 {
 	struct msgb *msg, *_msg;
+	unsigned int i;
 
-	llist_for_each_entry_safe(msg, _msg, q, list) {
-		struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
-		switch (l1sap->oph.primitive) {
-		case PRIM_PH_DATA:
-			if (l1sap->u.data.chan_nr != chan_nr)
-				continue;
-			if (l1sap->u.data.link_id != link_id)
-				continue;
-			break;
-		case PRIM_TCH:
-			if (l1sap->u.tch.chan_nr != chan_nr)
-				continue;
-			if (link_id != 0x00)
-				continue;
-			break;
-		default:
-			/* Shall not happen */
-			OSMO_ASSERT(0);
-		}
+	for (i = 0; i < ARRAY_SIZE(l1ts->dl_prims) && l1ts->dl_prims_num > 0; i++) {
+		llist_for_each_entry_safe(msg, _msg, &l1ts->dl_prims[i], list) {
+			struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
+			switch (l1sap->oph.primitive) {
+			case PRIM_PH_DATA:
+				if (l1sap->u.data.chan_nr != chan_nr)
+					continue;
+				if (l1sap->u.data.link_id != link_id)
+					continue;
+				break;
+			case PRIM_TCH:
+				if (l1sap->u.tch.chan_nr != chan_nr)
+					continue;
+				if (link_id != 0x00)
+					continue;
+				break;
+			default:
+				/* Shall not happen */
+				OSMO_ASSERT(0);
+			}
 
-		/* Unlink and free() */
-		llist_del(&msg->list);
-		talloc_free(msg);
+			/* Unlink and free() */
+			sched_dl_prim_unlink(l1ts, msg);
+			talloc_free(msg);
+		}
 	}
 }
 
+/* generation of the logical channel states, it changes on every (de)activation
+ * so that results computed asynchronously for a previous one can be told apart */
+static uint32_t chan_state_gen;
+
 static void _trx_sched_set_lchan(struct gsm_lchan *lchan,
 				 enum trx_chan_type chan,
 				 bool active)
@@ -1078,32 +1462,41 @@ static void _trx_sched_set_lchan(struct gsm_lchan *lchan,
 		/* Bind to generic 'struct gsm_lchan' */
 		chan_state->lchan = lchan;
 
-		/* Allocate memory for Rx/Tx burst buffers.  Use the maximim size
-		 * of 24 * (2 * 58) bytes, which is sufficient to store up to 24 GMSK
-		 * modulated bursts for CSD or up to 8 8PSK modulated bursts for EGPRS. */
-		const size_t buf_size = 24 * GSM_NBITS_NB_GMSK_PAYLOAD;
+		/* Take the Rx/Tx burst buffers from the arena of the timeslot,
+		 * those of one channel are adjacent */
 		if (trx_chan_desc[chan].dl_fn != NULL)
-			chan_state->dl_bursts = talloc_zero_size(l1ts, buf_size);
+			chan_state->dl_bursts = burst_buf_get(l1ts, 1);
 		if (trx_chan_desc[chan].ul_fn != NULL) {
-			chan_state->ul_bursts = talloc_zero_size(l1ts, buf_size);
+			chan_state->ul_bursts = burst_buf_get(l1ts, ul_burst_buf_slots(chan));
 			if (L1SAP_IS_LINK_SACCH(trx_chan_desc[chan].link_id))
-				chan_state->ul_bursts_prev = talloc_zero_size(l1ts, buf_size);
+				chan_state->ul_bursts_prev = burst_buf_get(l1ts, 1);
+			chan_state->meas.hist = meas_ring_get(l1ts);
 		}
 	} else {
 		chan_state->ho_rach_detect = 0;
 
-		/* Remove pending Tx prims belonging to this lchan */
-		trx_sched_queue_filter(&l1ts->dl_prims,
-				       trx_chan_desc[chan].chan_nr,
-				       trx_chan_desc[chan].link_id);
-
-		/* Release memory used by Rx/Tx burst buffers */
-		TALLOC_FREE(chan_state->dl_bursts);
-		TALLOC_FREE(chan_state->ul_bursts);
-		TALLOC_FREE(chan_state->ul_bursts_prev);
+		/* Return the Rx/Tx burst buffers to the arena */
+		burst_buf_put(l1ts, chan_state->dl_bursts, 1);
+		burst_buf_put(l1ts, chan_state->ul_bursts, ul_burst_buf_slots(chan));
+		burst_buf_put(l1ts, chan_state->ul_bursts_prev, 1);
+		chan_state->dl_bursts = NULL;
+		chan_state->ul_bursts = NULL;
+		chan_state->ul_bursts_prev = NULL;
+		meas_ring_put(l1ts, chan_state->meas.hist);
+		chan_state->meas.hist = NULL;
+		TALLOC_FREE(chan_state->a5_ks);
+		msgb_free(chan_state->dl_facch_deferred);
+		chan_state->dl_facch_deferred = NULL;
 	}
 
 	chan_state->active = active;
+	chan_state->gen = ++chan_state_gen;
+
+	if (active)
+		l1ts->num_active_chans++;
+	else
+		l1ts->num_active_chans--;
+	trx_sched_update_ts_active(lchan->ts);
 }
 
 /* setting all logical channels given attributes to active/inactive */
@@ -1134,6 +1527,10 @@ int trx_sched_set_lchan(struct gsm_lchan *lchan, uint8_t chan_nr, uint8_t link_i
 		if (l1ts->chan_state[chan].active == active)
 			continue;
 		found = true;
+		/* Remove pending Tx prims belonging to this lchan */
+		if (!active)
+			trx_sched_queue_filter(l1ts, trx_chan_desc[chan].chan_nr,
+					       trx_chan_desc[chan].link_id);
 		_trx_sched_set_lchan(lchan, chan, active);
 	}
 
@@ -1163,12 +1560,96 @@ int trx_sched_set_bcch_ccch(struct gsm_lchan *lchan, bool active)
 
 		if (l1ts->chan_state[chan].active == active)
 			continue;
+		if (!active)
+			trx_sched_queue_filter(l1ts, trx_chan_desc[chan].chan_nr,
+					       trx_chan_desc[chan].link_id);
 		_trx_sched_set_lchan(lchan, chan, active);
 	}
 
 	return 0;
 }
 
+/* Remove all primitives of the lchans in lchan_mask from the Downlink ring */
+static void trx_sched_queue_filter_lchans(struct l1sched_ts *l1ts, uint32_t lchan_mask)
+{
+	struct msgb *msg, *_msg;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(l1ts->dl_prims) && l1ts->dl_prims_num > 0; i++) {
+		llist_for_each_entry_safe(msg, _msg, &l1ts->dl_prims[i], list) {
+			struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
+			uint8_t chan_nr;
+
+			switch (l1sap->oph.primitive) {
+			case PRIM_PH_DATA:
+				chan_nr = l1sap->u.data.chan_nr;
+				break;
+			case PRIM_TCH:
+				chan_nr = l1sap->u.tch.chan_nr;
+				break;
+			default:
+				/* Shall not happen */
+				OSMO_ASSERT(0);
+			}
+
+			/* BCCH/CCCH are not released along with the lchans */
+			if ((chan_nr & 0xE0) == 0x80)
+				continue;
+			if (l1ts->ts->vamos.is_shadow)
+				chan_nr &= ~RSL_CHAN_OSMO_VAMOS_MASK;
+			if (~lchan_mask & (1 << l1sap_chan2ss(chan_nr)))
+				continue;
+
+			/* Unlink and free() */
+			sched_dl_prim_unlink(l1ts, msg);
+			talloc_free(msg);
+		}
+	}
+}
+
+/* Deactivate the dedicated and associated channels of all lchans of a
+ * timeslot given in lchan_mask (bit N = ts->lchan[N]) at once.  Unlike a
+ * trx_sched_set_lchan() call per lchan and link, which walks the Downlink
+ * ring for every logical channel, the ring is walked only once here, and
+ * handover RACH detection is only disabled where it is actually enabled. */
+int trx_sched_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	struct l1sched_ts *l1ts = ts->priv;
+	uint32_t ho_mask = 0;
+	unsigned int ln;
+
+	if (!l1ts) {
+		LOGP(DL1C, LOGL_ERROR, "%s Releasing lchans with uninitialized scheduler structure\n",
+		     gsm_ts_name(ts));
+		return -EINVAL;
+	}
+
+	trx_sched_queue_filter_lchans(l1ts, lchan_mask);
+
+	for (enum trx_chan_type chan = 0; chan < _TRX_CHAN_MAX; chan++) {
+		struct l1sched_chan_state *chan_state = &l1ts->chan_state[chan];
+
+		if (!chan_state->active || chan_state->lchan == NULL)
+			continue;
+		if ((trx_chan_desc[chan].chan_nr & 0xE0) == 0x80)
+			continue;
+		ln = chan_state->lchan - ts->lchan;
+		if (~lchan_mask & (1 << ln))
+			continue;
+		if (chan_state->ho_rach_detect)
+			ho_mask |= (1 << ln);
+		_trx_sched_set_lchan(chan_state->lchan, chan, false);
+	}
+
+	/* disable handover detection */
+	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
+		if (ho_mask & (1 << ln))
+			_sched_act_rach_det(ts->trx, ts->nr, ln, 0);
+	}
+
+	return 0;
+}
+
 /* setting all logical channels given attributes to active/inactive */
 int trx_sched_set_mode(struct gsm_bts_trx_ts *ts, uint8_t chan_nr, uint8_t rsl_cmode,
 	uint8_t tch_mode, int codecs, uint8_t codec0, uint8_t codec1,
@@ -1184,6 +1665,9 @@ int trx_sched_set_mode(struct gsm_bts_trx_ts *ts, uint8_t chan_nr, uint8_t rsl_c
 	if (ts->pchan == GSM_PCHAN_PDCH)
 		return 0;
 
+	if (!l1ts)
+		return -EINVAL;
+
 	/* VAMOS: convert Osmocom specific channel number to a generic one,
 	 * otherwise we won't match anything in trx_chan_desc[]. */
 	if (ts->vamos.is_shadow)
@@ -1241,6 +1725,9 @@ int trx_sched_set_cipher(struct gsm_lchan *lchan, uint8_t chan_nr, bool downlink
 	if (ts_pchan(lchan->ts) == GSM_PCHAN_PDCH)
 		return 0;
 
+	if (!lchan->ts->priv)
+		return -EINVAL;
+
 	/* VAMOS: convert Osmocom specific channel number to a generic one,
 	 * otherwise we won't match anything in trx_chan_desc[]. */
 	if (lchan->ts->vamos.is_shadow)
@@ -1266,14 +1753,27 @@ int trx_sched_set_cipher(struct gsm_lchan *lchan, uint8_t chan_nr, bool downlink
 				  algo, (downlink) ? "downlink" : "uplink",
 				  trx_chan_desc[i].name);
 
+			/* Keystream cache is allocated on demand, and only invalidated
+			 * here: it's released together with the burst buffers. */
+			if (algo && l1cs->a5_ks == NULL)
+				l1cs->a5_ks = talloc_zero(l1ts, struct l1sched_a5_ks_cache);
+
 			if (downlink) {
 				l1cs->dl_encr_algo = algo;
 				memcpy(l1cs->dl_encr_key, lchan->encr.key, lchan->encr.key_len);
 				l1cs->dl_encr_key_len = lchan->encr.key_len;
+				if (l1cs->a5_ks != NULL) {
+					memset(l1cs->a5_ks->dl, 0, sizeof(l1cs->a5_ks->dl));
+					a5_kasumi_key_expand(&l1cs->a5_ks->dl_key, algo, l1cs->dl_encr_key);
+				}
 			} else {
 				l1cs->ul_encr_algo = algo;
 				memcpy(l1cs->ul_encr_key, lchan->encr.key, lchan->encr.key_len);
 				l1cs->ul_encr_key_len = lchan->encr.key_len;
+				if (l1cs->a5_ks != NULL) {
+					memset(l1cs->a5_ks->ul, 0, sizeof(l1cs->a5_ks->ul));
+					a5_kasumi_key_expand(&l1cs->a5_ks->ul_key, algo, l1cs->ul_encr_key);
+				}
 			}
 			rc = 0;
 		}
@@ -1282,48 +1782,167 @@ int trx_sched_set_cipher(struct gsm_lchan *lchan, uint8_t chan_nr, bool downlink
 	return rc;
 }
 
+/* Whether both directions are ciphered with the same algorithm and key */
+static inline bool sched_a5_ks_symmetric(const struct l1sched_chan_state *l1cs)
+{
+	return l1cs->dl_encr_algo == l1cs->ul_encr_algo &&
+	       l1cs->dl_encr_key_len == l1cs->ul_encr_key_len &&
+	       !memcmp(l1cs->dl_encr_key, l1cs->ul_encr_key, l1cs->dl_encr_key_len);
+}
+
+/* osmo_a5() with the key of the given direction, using the pre-expanded
+ * key schedule for A5/3 and A5/4 */
+static void sched_a5(const struct l1sched_chan_state *l1cs, bool dl_key,
+		     uint32_t fn, ubit_t *dl, ubit_t *ul)
+{
+	int algo = dl_key ? l1cs->dl_encr_algo : l1cs->ul_encr_algo;
+
+	if (algo == 3 || algo == 4)
+		a5_kasumi(dl_key ? &l1cs->a5_ks->dl_key : &l1cs->a5_ks->ul_key, fn, dl, ul);
+	else
+		osmo_a5(algo, dl_key ? l1cs->dl_encr_key : l1cs->ul_encr_key, fn, dl, ul);
+}
+
+/* Look up the A5 keystream for the given TDMA frame, compute it on cache miss */
+static const ubit_t *sched_a5_ks_get(const struct l1sched_chan_state *l1cs,
+				     uint32_t fn, bool downlink)
+{
+	struct l1sched_a5_ks *e, *o;
+
+	if (downlink) {
+		e = &l1cs->a5_ks->dl[fn % L1SCHED_A5_KS_CACHE_LEN];
+		o = &l1cs->a5_ks->ul[fn % L1SCHED_A5_KS_CACHE_LEN];
+	} else {
+		e = &l1cs->a5_ks->ul[fn % L1SCHED_A5_KS_CACHE_LEN];
+		o = &l1cs->a5_ks->dl[fn % L1SCHED_A5_KS_CACHE_LEN];
+	}
+
+	if (e->valid && e->fn == fn)
+		return &e->ks[0];
+
+	/* A single A5/x run yields the keystream of both directions for a given
+	 * TDMA frame, so fill the cache of the opposite direction too when it
+	 * uses the same key.  The Uplink bursts of this frame arrive a few frames
+	 * after its Downlink bursts have been sent, so the entry is still there
+	 * by then, saving every second KASUMI run (A5/3 and A5/4). */
+	if (sched_a5_ks_symmetric(l1cs) && !(o->valid && o->fn == fn)) {
+		if (downlink)
+			sched_a5(l1cs, true, fn, &e->ks[0], &o->ks[0]);
+		else
+			sched_a5(l1cs, false, fn, &o->ks[0], &e->ks[0]);
+		o->valid = true;
+		o->fn = fn;
+	} else if (downlink) {
+		sched_a5(l1cs, true, fn, &e->ks[0], NULL);
+	} else {
+		sched_a5(l1cs, false, fn, NULL, &e->ks[0]);
+	}
+	e->valid = true;
+	e->fn = fn;
+
+	return &e->ks[0];
+}
+
+/* Pre-compute the A5 keystream for the logical channels mapped onto the given
+ * Downlink and Uplink TDMA frames, so that ciphering becomes a pure lookup. This
+ * is meant to be called in the idle part of a TDMA frame, after all bursts have
+ * been sent to the PHY. */
+void trx_sched_a5_prefill(struct l1sched_ts *l1ts, uint32_t dl_fn, uint32_t ul_fn)
+{
+	const struct l1sched_chan_state *l1cs;
+
+	if (l1ts == NULL || !l1ts->mf_index)
+		return;
+
+	l1cs = l1ts->mf_dl[dl_fn % l1ts->mf_period].chan_state;
+	if (l1cs->active && l1cs->dl_encr_algo && l1cs->a5_ks != NULL)
+		sched_a5_ks_get(l1cs, dl_fn, true);
+
+	l1cs = l1ts->mf_ul[ul_fn % l1ts->mf_period].chan_state;
+	if (l1cs->active && l1cs->ul_encr_algo && l1cs->a5_ks != NULL)
+		sched_a5_ks_get(l1cs, ul_fn, false);
+}
+
+static inline bool sched_cpu_acct_enabled(const struct l1sched_ts *l1ts)
+{
+	return OSMO_UNLIKELY(l1ts->ts->trx->bts->sched_cpu_acct);
+}
+
+static inline uint64_t sched_cpu_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Account the time since start_ns to the handler of chan */
+static void sched_cpu_account(struct l1sched_ts *l1ts, enum l1sched_cpu_dir dir,
+			      enum trx_chan_type chan, uint64_t start_ns)
+{
+	struct l1sched_cpu_stats *st = &l1ts->cpu[dir][chan];
+	struct gsm_bts_trx_ts *ts = l1ts->ts;
+	uint32_t ns = sched_cpu_now_ns() - start_ns;
+	uint32_t rem;
+
+	st->ns += ns;
+	st->calls++;
+	if (ns > st->max_ns)
+		st->max_ns = ns;
+
+	/* VAMOS pairs are reported as one timeslot, see load_report_cb() */
+	if (ts->vamos.is_shadow)
+		ts = ts->vamos.peer;
+	ts->cpu_load_ns += ns;
+
+	/* most handlers take less than a microsecond */
+	rem = l1ts->cpu_ctr_rem_ns[dir] + ns;
+	if (rem >= 1000)
+		rate_ctr_add2(l1ts->ctrs, L1SCHED_TS_CTR_CPU_RTS_US + dir, rem / 1000);
+	l1ts->cpu_ctr_rem_ns[dir] = rem % 1000;
+}
+
 /* process ready-to-send */
-int _sched_rts(const struct l1sched_ts *l1ts, uint32_t fn)
+int _sched_rts(struct l1sched_ts *l1ts, uint32_t fn)
 {
-	const struct trx_sched_frame *frame;
-	uint8_t offset, period, bid;
-	trx_sched_rts_func *func;
-	enum trx_chan_type chan;
+	const struct l1sched_dl_frame *frame;
+	uint64_t start_ns;
+	int rc;
 
 	/* no multiframe set */
 	if (!l1ts->mf_index)
 		return 0;
 
-	/* get frame from multiframe */
-	period = l1ts->mf_period;
-	offset = fn % period;
-	frame = l1ts->mf_frames + offset;
-
-	chan = frame->dl_chan;
-	bid = frame->dl_bid;
-	func = trx_chan_desc[frame->dl_chan].rts_fn;
+	/* get frame from the dispatch table */
+	frame = &l1ts->mf_dl[fn % l1ts->mf_period];
 
 	/* only on bid == 0 */
-	if (bid != 0)
+	if (frame->bid != 0)
 		return 0;
 
 	/* no RTS function */
-	if (!func)
+	if (!frame->rts_fn)
 		return 0;
 
 	/* check if channel is active */
-	if (!l1ts->chan_state[chan].active)
+	if (!frame->chan_state->active)
 	 	return -EINVAL;
 
 	/* There is no burst, just for logging */
 	struct trx_dl_burst_req dbr = {
 		.fn = fn,
 		.tn = l1ts->ts->nr,
-		.bid = bid,
-		.chan = chan,
+		.bid = frame->bid,
+		.chan = frame->chan,
 	};
 
-	return func(l1ts, &dbr);
+	if (!sched_cpu_acct_enabled(l1ts))
+		return frame->rts_fn(l1ts, &dbr);
+
+	start_ns = sched_cpu_now_ns();
+	rc = frame->rts_fn(l1ts, &dbr);
+	sched_cpu_account(l1ts, L1SCHED_CPU_RTS, frame->chan, start_ns);
+	return rc;
 }
 
 static void trx_sched_apply_att(const struct gsm_lchan *lchan,
@@ -1346,27 +1965,71 @@ static void trx_sched_apply_att(const struct gsm_lchan *lchan,
 	}
 }
 
+/* Apply the A5 keystream to n unpacked (hard) bits: bits[i] ^= ks[i] */
+static inline void sched_a5_xor_ubits(ubit_t *bits, const ubit_t *ks, unsigned int n)
+{
+	unsigned int i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 16 <= n; i += 16) {
+		__m128i b = _mm_loadu_si128((const __m128i *)&bits[i]);
+		__m128i k = _mm_loadu_si128((const __m128i *)&ks[i]);
+		_mm_storeu_si128((__m128i *)&bits[i], _mm_xor_si128(b, k));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 16 <= n; i += 16)
+		vst1q_u8(&bits[i], veorq_u8(vld1q_u8(&bits[i]), vld1q_u8(&ks[i])));
+#endif
+
+	for (; i < n; i++)
+		bits[i] ^= ks[i];
+}
+
+/* Apply the A5 keystream to n soft-bits: negate bits[i] if ks[i] is set.
+ * With m = -ks[i] (either 0 or -1), this is (bits[i] ^ m) - m, branch-free. */
+static inline void sched_a5_flip_sbits(sbit_t *bits, const ubit_t *ks, unsigned int n)
+{
+	unsigned int i = 0;
+
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i b = _mm_loadu_si128((const __m128i *)&bits[i]);
+		__m128i m = _mm_sub_epi8(zero, _mm_loadu_si128((const __m128i *)&ks[i]));
+		_mm_storeu_si128((__m128i *)&bits[i], _mm_sub_epi8(_mm_xor_si128(b, m), m));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 16 <= n; i += 16) {
+		int8x16_t b = vld1q_s8(&bits[i]);
+		int8x16_t m = vnegq_s8(vreinterpretq_s8_u8(vld1q_u8(&ks[i])));
+		vst1q_s8(&bits[i], vsubq_s8(veorq_s8(b, m), m));
+	}
+#endif
+
+	for (; i < n; i++) {
+		const sbit_t m = -(sbit_t)ks[i];
+		bits[i] = (bits[i] ^ m) - m;
+	}
+}
+
 /* process downlink burst */
 void _sched_dl_burst(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 {
 	const struct l1sched_chan_state *l1cs;
-	const struct trx_sched_frame *frame;
-	uint8_t offset, period;
-	trx_sched_dl_func *func;
+	const struct l1sched_dl_frame *frame;
+	uint64_t start_ns;
+	int rc;
 
 	if (!l1ts->mf_index)
 		return;
 
-	/* get frame from multiframe */
-	period = l1ts->mf_period;
-	offset = br->fn % period;
-	frame = l1ts->mf_frames + offset;
+	/* get frame from the dispatch table */
+	frame = &l1ts->mf_dl[br->fn % l1ts->mf_period];
 
-	br->chan = frame->dl_chan;
-	br->bid = frame->dl_bid;
-	func = trx_chan_desc[br->chan].dl_fn;
+	br->chan = frame->chan;
+	br->bid = frame->bid;
 
-	l1cs = &l1ts->chan_state[br->chan];
+	l1cs = frame->chan_state;
 
 	/* check if channel is active */
 	if (!l1cs->active)
@@ -1377,7 +2040,14 @@ void _sched_dl_burst(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 	br->tsc = l1ts->ts->tsc;
 
 	/* get burst from function */
-	if (func(l1ts, br) != 0)
+	if (!sched_cpu_acct_enabled(l1ts)) {
+		rc = frame->dl_fn(l1ts, br);
+	} else {
+		start_ns = sched_cpu_now_ns();
+		rc = frame->dl_fn(l1ts, br);
+		sched_cpu_account(l1ts, L1SCHED_CPU_DL, br->chan, start_ns);
+	}
+	if (rc != 0)
 		return;
 
 	/* Modulation is indicated by func() */
@@ -1389,14 +2059,10 @@ void _sched_dl_burst(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 
 	/* encrypt */
 	if (br->burst_len && l1cs->dl_encr_algo) {
-		ubit_t ks[114];
-		int i;
+		const ubit_t *ks = sched_a5_ks_get(l1cs, br->fn, true);
 
-		osmo_a5(l1cs->dl_encr_algo, l1cs->dl_encr_key, br->fn, ks, NULL);
-		for (i = 0; i < 57; i++) {
-			br->burst[i +  3] ^= ks[i];
-			br->burst[i + 88] ^= ks[i + 57];
-		}
+		sched_a5_xor_ubits(&br->burst[3], &ks[0], 57);
+		sched_a5_xor_ubits(&br->burst[88], &ks[57], 57);
 	}
 }
 
@@ -1437,7 +2103,13 @@ static int trx_sched_calc_frame_loss(struct l1sched_ts *l1ts,
 			"Too many (>%u) contiguous TDMA frames=%u elapsed "
 			"since the last processed fn=%u\n", l1ts->mf_period,
 			elapsed_fs, l1cs->last_tdma_fn);
-		/* FIXME: how should this affect the measurements? */
+		/* Replaying the gap burst by burst would only cost time: drop
+		 * the block received in part before the gap instead, so that
+		 * it is not completed with the bursts received after it.  The
+		 * measurement history is averaged over the bursts of the next
+		 * block again, so it needs no update. */
+		l1cs->ul_mask = 0x00;
+		rate_ctr_add2(l1ts->ctrs, L1SCHED_TS_CTR_UL_LOST_FN, elapsed_fs - 1);
 		return -EINVAL;
 	}
 
@@ -1461,7 +2133,9 @@ static int trx_sched_calc_frame_loss(struct l1sched_ts *l1ts,
 	if (l1cs->lost_tdma_fs > 0) {
 		LOGL1SB(DL1P, LOGL_NOTICE, l1ts, bi,
 			"At least %u TDMA frames were lost since the last "
-			"processed fn=%u\n", l1cs->lost_tdma_fs, l1cs->last_tdma_fn);
+			"processed fn=%u, substituting them with NOPE.ind\n",
+			l1cs->lost_tdma_fs, l1cs->last_tdma_fn);
+		rate_ctr_add2(l1ts->ctrs, L1SCHED_TS_CTR_UL_LOST_FN, l1cs->lost_tdma_fs);
 
 		/**
 		 * HACK: substitute lost bursts by zero-filled ones
@@ -1471,11 +2145,14 @@ static int trx_sched_calc_frame_loss(struct l1sched_ts *l1ts,
 		 */
 		trx_sched_ul_func *func;
 
+		/* Zero-filled soft-bits for the dummy burst indication */
+		static sbit_t nope_burst[GSM_BURST_LEN];
+
 		/* Prepare dummy burst indication */
 		struct trx_ul_burst_ind dbi = {
 			.flags = TRX_BI_F_NOPE_IND,
 			.burst_len = GSM_BURST_LEN,
-			.burst = { 0 },
+			.burst = &nope_burst[0],
 			.rssi = -128,
 			.toa256 = 0,
 			.chan = bi->chan,
@@ -1495,7 +2172,7 @@ static int trx_sched_calc_frame_loss(struct l1sched_ts *l1ts,
 			dbi.bid = frame->ul_bid;
 			dbi.fn = fn_i;
 
-			LOGL1SB(DL1P, LOGL_NOTICE, l1ts, &dbi,
+			LOGL1SB(DL1P, LOGL_DEBUG, l1ts, &dbi,
 				"Substituting lost burst with NOPE.ind\n");
 
 			func(l1ts, &dbi);
@@ -1507,38 +2184,43 @@ static int trx_sched_calc_frame_loss(struct l1sched_ts *l1ts,
 	return 0;
 }
 
-/* Process a single noise measurement for an inactive timeslot. */
-static void trx_sched_noise_meas(struct l1sched_chan_state *l1cs,
-				 const struct trx_ul_burst_ind *bi)
+/* Process a single noise measurement for an inactive timeslot.  The samples
+ * are only summed up here, in arrays shared by all logical channels of the
+ * timeslot, so that the burst path does not touch the (large) channel states. */
+static inline void trx_sched_noise_meas(struct l1sched_ts *l1ts,
+					const struct trx_ul_burst_ind *bi)
 {
-	int *Avg = &l1cs->meas.interf_avg;
-
-	/* EWMA (Exponentially Weighted Moving Average):
-	*
-	*   Avg[n] = a * Val[n] + (1 - a) * Avg[n - 1]
-	*
-	* Implemented using the '+=' operator:
-	*
-	*   Avg += a * Val - a * Avg
-	*   Avg += a * (Val - Avg)
-	*
-	* We use constant 'a' = 0.5, what is equal to:
-	*
-	*   Avg += (Val - Avg) / 2
-	*
-	* We don't really need precisity here, so no scaling.
-	*/
-
-	*Avg += (bi->rssi - *Avg) / 2;
+	l1ts->noise.sum[bi->chan] += bi->rssi;
+	l1ts->noise.num[bi->chan]++;
+}
+
+/* Average the noise measurements summed up since the last call (once per
+ * SACCH period); channels without new samples keep their last average. */
+void trx_sched_noise_meas_reduce(struct l1sched_ts *l1ts)
+{
+	unsigned int i;
+
+	for (i = 0; i < _TRX_CHAN_MAX; i++) {
+		if (l1ts->noise.num[i] == 0)
+			continue;
+		l1ts->chan_state[i].meas.interf_avg =
+			l1ts->noise.sum[i] / (int32_t) l1ts->noise.num[i];
+	}
+
+	memset(&l1ts->noise, 0, sizeof(l1ts->noise));
 }
 
 /* Process an Uplink burst indication */
 int trx_sched_ul_burst(struct l1sched_ts *l1ts, struct trx_ul_burst_ind *bi)
 {
 	struct l1sched_chan_state *l1cs;
-	const struct trx_sched_frame *frame;
-	uint8_t offset, period;
+	const struct l1sched_ul_frame *frame;
 	trx_sched_ul_func *func;
+	uint64_t start_ns = 0;
+
+	/* no channel combination on this timeslot */
+	if (OSMO_UNLIKELY(l1ts == NULL))
+		return -EINVAL;
 
 	/* VAMOS: redirect to the shadow timeslot */
 	if (bi->flags & TRX_BI_F_SHADOW_IND)
@@ -1547,21 +2229,19 @@ int trx_sched_ul_burst(struct l1sched_ts *l1ts, struct trx_ul_burst_ind *bi)
 	if (!l1ts->mf_index)
 		return -EINVAL;
 
-	/* get frame from multiframe */
-	period = l1ts->mf_period;
-	offset = bi->fn % period;
-	frame = l1ts->mf_frames + offset;
+	/* get frame from the dispatch table */
+	frame = &l1ts->mf_ul[bi->fn % l1ts->mf_period];
 
-	bi->chan = frame->ul_chan;
-	bi->bid = frame->ul_bid;
-	l1cs = &l1ts->chan_state[bi->chan];
-	func = trx_chan_desc[bi->chan].ul_fn;
+	bi->chan = frame->chan;
+	bi->bid = frame->bid;
+	l1cs = frame->chan_state;
+	func = frame->ul_fn;
 
 	/* check if channel is active */
 	if (!l1cs->active) {
 		/* handle noise measurements on dedicated and idle channels */
 		if (TRX_CHAN_IS_DEDIC(bi->chan) || bi->chan == TRXC_IDLE)
-			trx_sched_noise_meas(l1cs, bi);
+			trx_sched_noise_meas(l1ts, bi);
 		return 0;
 	}
 
@@ -1576,29 +2256,32 @@ int trx_sched_ul_burst(struct l1sched_ts *l1ts, struct trx_ul_burst_ind *bi)
 	l1cs->last_tdma_fn = bi->fn;
 	l1cs->proc_tdma_fs++;
 
+	if (sched_cpu_acct_enabled(l1ts))
+		start_ns = sched_cpu_now_ns();
+
 	/* handle NOPE indications */
 	if (bi->flags & TRX_BI_F_NOPE_IND) {
 		/* NOTE: Uplink burst handler must check bi->burst_len before
 		 * accessing bi->burst to avoid uninitialized memory access. */
-		return func(l1ts, bi);
+		int rc = func(l1ts, bi);
+		if (start_ns)
+			sched_cpu_account(l1ts, L1SCHED_CPU_UL, bi->chan, start_ns);
+		return rc;
 	}
 
 	/* decrypt */
 	if (bi->burst_len && l1cs->ul_encr_algo) {
-		ubit_t ks[114];
-		int i;
-
-		osmo_a5(l1cs->ul_encr_algo, l1cs->ul_encr_key, bi->fn, NULL, ks);
-		for (i = 0; i < 57; i++) {
-			if (ks[i])
-				bi->burst[i + 3] = - bi->burst[i + 3];
-			if (ks[i + 57])
-				bi->burst[i + 88] = - bi->burst[i + 88];
-		}
+		const ubit_t *ks = sched_a5_ks_get(l1cs, bi->fn, false);
+
+		sched_a5_flip_sbits(&bi->burst[3], &ks[0], 57);
+		sched_a5_flip_sbits(&bi->burst[88], &ks[57], 57);
 	}
 
 	/* Invoke the logical channel handler */
 	func(l1ts, bi);
 
+	if (start_ns)
+		sched_cpu_account(l1ts, L1SCHED_CPU_UL, bi->chan, start_ns);
+
 	return 0;
 }
@@ -986,7 +986,15 @@ const struct trx_sched_multiframe trx_sched_multiframes[] = {
  * scheduler functions
  */
 
-int find_sched_mframe_idx(enum gsm_phys_chan_config pchan, uint8_t tn)
+/* Frame positions of each multiframe, built once on first use */
+static struct trx_sched_mf_bits mf_bits[ARRAY_SIZE(trx_sched_multiframes)];
+static bool mf_bits_built;
+
+/* Index into trx_sched_multiframes[] plus one by (pchan, TS number),
+ * 0 if not looked up yet, -1 if there is no multiframe at all */
+static int8_t mf_idx_cache[_GSM_PCHAN_MAX][TRX_NR_TS];
+
+static int find_sched_mframe_idx_slow(enum gsm_phys_chan_config pchan, uint8_t tn)
 {
 	int i;
 
@@ -999,24 +1007,25 @@ int find_sched_mframe_idx(enum gsm_phys_chan_config pchan, uint8_t tn)
 	return -1;
 }
 
-/* Determine if given frame number contains SACCH (true) or other (false) burst */
-bool trx_sched_is_sacch_fn(const struct gsm_bts_trx_ts *ts, uint32_t fn, bool uplink)
+int find_sched_mframe_idx(enum gsm_phys_chan_config pchan, uint8_t tn)
 {
-	int i;
-	const struct trx_sched_multiframe *sched;
-	const struct trx_sched_frame *frame;
-	enum trx_chan_type ch_type;
+	int8_t *cached;
 
-	i = find_sched_mframe_idx(ts_pchan(ts), ts->nr);
-	if (i < 0)
-		return -EINVAL;
-	sched = &trx_sched_multiframes[i];
-	frame = &sched->frames[fn % sched->period];
-	if (uplink)
-		ch_type = frame->ul_chan;
-	else
-		ch_type = frame->dl_chan;
+	if (pchan < 0 || pchan >= _GSM_PCHAN_MAX || tn >= TRX_NR_TS)
+		return find_sched_mframe_idx_slow(pchan, tn);
+
+	cached = &mf_idx_cache[pchan][tn];
+	if (*cached == 0) {
+		int i = find_sched_mframe_idx_slow(pchan, tn);
+		*cached = i < 0 ? -1 : i + 1;
+	}
+	if (*cached < 0)
+		return -1;
+	return *cached - 1;
+}
 
+static bool chan_is_sacch(enum trx_chan_type ch_type)
+{
 	switch (ch_type) {
 	case TRXC_SACCH4_0:
 	case TRXC_SACCH4_1:
@@ -1038,3 +1047,70 @@ bool trx_sched_is_sacch_fn(const struct gsm_bts_trx_ts *ts, uint32_t fn, bool up
 		return false;
 	}
 }
+
+static void mf_bit_set(uint64_t *bits, unsigned int pos)
+{
+	bits[pos / 64] |= (uint64_t)1 << (pos % 64);
+}
+
+static void mf_bits_build(void)
+{
+	unsigned int i, fn;
+
+	for (i = 0; i < ARRAY_SIZE(trx_sched_multiframes); i++) {
+		const struct trx_sched_multiframe *mf = &trx_sched_multiframes[i];
+		struct trx_sched_mf_bits *bits = &mf_bits[i];
+
+		OSMO_ASSERT(mf->period <= sizeof(bits->ul_sacch) * 8);
+		bits->period = mf->period;
+
+		for (fn = 0; fn < mf->period; fn++) {
+			const struct trx_sched_frame *frame = &mf->frames[fn];
+
+			if (chan_is_sacch(frame->ul_chan))
+				mf_bit_set(bits->ul_sacch, fn);
+			if (chan_is_sacch(frame->dl_chan))
+				mf_bit_set(bits->dl_sacch, fn);
+			if (frame->ul_chan == TRXC_TCHF || frame->ul_chan == TRXC_TCHH_0 ||
+			    frame->ul_chan == TRXC_TCHH_1)
+				mf_bit_set(bits->ul_facch, fn);
+			if (frame->dl_chan == TRXC_TCHF || frame->dl_chan == TRXC_TCHH_0 ||
+			    frame->dl_chan == TRXC_TCHH_1)
+				mf_bit_set(bits->dl_facch, fn);
+			if (frame->ul_chan == TRXC_IDLE)
+				mf_bit_set(bits->ul_idle, fn);
+			if (frame->dl_chan == TRXC_IDLE)
+				mf_bit_set(bits->dl_idle, fn);
+		}
+	}
+
+	mf_bits_built = true;
+}
+
+/*! Get the frame positions of the multiframe used for a pchan on a timeslot.
+ *  \param[in] pchan physical channel config
+ *  \param[in] tn TDMA timeslot number
+ *  \returns pointer to the static positions, NULL if there is no multiframe */
+const struct trx_sched_mf_bits *trx_sched_mf_bits_get(enum gsm_phys_chan_config pchan, uint8_t tn)
+{
+	int i = find_sched_mframe_idx(pchan, tn);
+
+	if (i < 0)
+		return NULL;
+	if (!mf_bits_built)
+		mf_bits_build();
+	return &mf_bits[i];
+}
+
+/* Determine if given frame number contains SACCH (true) or other (false) burst */
+bool trx_sched_is_sacch_fn(const struct gsm_bts_trx_ts *ts, uint32_t fn, bool uplink)
+{
+	const struct trx_sched_mf_bits *bits;
+
+	bits = trx_sched_mf_bits_get(ts_pchan(ts), ts->nr);
+	if (bits == NULL)
+		return -EINVAL;
+	if (bits->period == 0)
+		return false;
+	return trx_sched_mf_bit_test(uplink ? bits->ul_sacch : bits->dl_sacch, bits->period, fn);
+}
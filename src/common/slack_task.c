@@ -0,0 +1,160 @@
+/* Low priority work run in the slack of the TDMA frame processing */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: AGPL-3.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Periodic housekeeping is still timed by osmo_timers, but their callbacks
+ * only queue a slack task.  A BTS model that processes the TDMA frames on
+ * the main loop (osmo-bts-trx) drives the queue: once the bursts of a frame
+ * were sent to the PHY, it runs queued tasks in what is left of the frame,
+ * up to a per-frame budget.  A task that waited for more than
+ * SLACK_TASK_MAX_WAIT_MS is run even without slack, so that a permanently
+ * loaded BTS still reports its load.  Without a driver (the other models,
+ * or while the TRX clock is stopped), the queue is run on the next main
+ * loop iteration, just like the timers did before.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/timer_compat.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/slack_task.h>
+
+static LLIST_HEAD(slack_queue);
+static bool slack_driven;
+static struct osmo_timer_list slack_flush_timer;
+
+static int64_t elapsed_us(const struct timespec *from, const struct timespec *to)
+{
+	struct timespec diff;
+
+	timespecsub(to, from, &diff);
+	return (int64_t) diff.tv_sec * 1000000 + diff.tv_nsec / 1000;
+}
+
+static void slack_task_exec(struct slack_task *t)
+{
+	llist_del(&t->list);
+	t->queued = false;
+	t->cb(t->data);
+}
+
+/* no driver: run everything queued on this main loop iteration */
+static void slack_flush_cb(void *data)
+{
+	struct slack_task *t;
+
+	while (!slack_driven && !llist_empty(&slack_queue)) {
+		t = llist_first_entry(&slack_queue, struct slack_task, list);
+		slack_task_exec(t);
+	}
+}
+
+static void slack_flush_schedule(void)
+{
+	if (!slack_flush_timer.cb)
+		osmo_timer_setup(&slack_flush_timer, slack_flush_cb, NULL);
+	if (!osmo_timer_pending(&slack_flush_timer))
+		osmo_timer_schedule(&slack_flush_timer, 0, 0);
+}
+
+void slack_task_init(struct slack_task *t, const char *name, void (*cb)(void *data), void *data)
+{
+	INIT_LLIST_HEAD(&t->list);
+	t->name = name;
+	t->cb = cb;
+	t->data = data;
+	t->queued = false;
+}
+
+/*! Queue \a t to be run in the next slack; no-op if it is already queued */
+void slack_task_queue(struct slack_task *t)
+{
+	if (t->queued)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &t->queued_at);
+	llist_add_tail(&t->list, &slack_queue);
+	t->queued = true;
+
+	if (!slack_driven)
+		slack_flush_schedule();
+}
+
+void slack_task_cancel(struct slack_task *t)
+{
+	if (!t->queued)
+		return;
+	llist_del(&t->list);
+	t->queued = false;
+}
+
+/*! Announce whether slack_task_run() is called once per TDMA frame */
+void slack_task_set_driven(bool driven)
+{
+	if (slack_driven == driven)
+		return;
+	slack_driven = driven;
+	if (!driven && !llist_empty(&slack_queue))
+		slack_flush_schedule();
+}
+
+/*! Run queued tasks in FIFO order until \a budget_us is used up.
+ *  \param[in] budget_us time left for low priority work in this frame
+ *  \param[out] late number of tasks run beyond the budget because they had
+ *  waited for longer than SLACK_TASK_MAX_WAIT_MS (optional)
+ *  \returns number of tasks run */
+unsigned int slack_task_run(int64_t budget_us, unsigned int *late)
+{
+	struct timespec tv_start, tv_now;
+	struct slack_task *t;
+	unsigned int num = 0, num_late = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &tv_start);
+	tv_now = tv_start;
+
+	while (!llist_empty(&slack_queue)) {
+		t = llist_first_entry(&slack_queue, struct slack_task, list);
+
+		/* the queue is FIFO, so nothing behind it waited any longer */
+		if (elapsed_us(&tv_start, &tv_now) >= budget_us) {
+			if (elapsed_us(&t->queued_at, &tv_now) < SLACK_TASK_MAX_WAIT_MS * 1000)
+				break;
+			LOGP(DLGLOBAL, LOGL_DEBUG, "Slack task '%s' waited for too long, running it\n",
+			     t->name);
+			num_late++;
+		}
+
+		slack_task_exec(t);
+		num++;
+		clock_gettime(CLOCK_MONOTONIC, &tv_now);
+	}
+
+	if (late)
+		*late = num_late;
+	return num;
+}
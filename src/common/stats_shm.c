@@ -0,0 +1,224 @@
+/* Read-only shared memory export of the rate counters and stat items */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: AGPL-3.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The counters are copied into the region by a slack task, queued by a
+ * timer on the main loop, so the snapshot costs one walk over all counter
+ * groups per interval, no matter how often the region is read.  Readers never write to it and
+ * never talk to the BTS, see stats_shm.h for the seqlock protocol.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/slack_task.h>
+#include <osmo-bts/stats_shm.h>
+
+struct stats_shm {
+	char *name;
+	struct stats_shm_hdr *hdr;
+	size_t size;
+	unsigned int interval_ms;
+	struct osmo_timer_list timer;
+	struct slack_task task;
+
+	/* state of the current snapshot */
+	unsigned int num;
+	bool overflow_logged;
+};
+
+static struct stats_shm_entry *next_entry(struct stats_shm *ss)
+{
+	if (ss->num >= STATS_SHM_MAX_ENTRIES) {
+		if (!ss->overflow_logged) {
+			LOGP(DLGLOBAL, LOGL_NOTICE, "Stats shm %s: more than %u counters, "
+			     "exporting only the first ones\n", ss->name, STATS_SHM_MAX_ENTRIES);
+			ss->overflow_logged = true;
+		}
+		return NULL;
+	}
+	return &ss->hdr->entries[ss->num++];
+}
+
+static int handle_counter(struct rate_ctr_group *ctrg, struct rate_ctr *ctr,
+			  const struct rate_ctr_desc *desc, void *data)
+{
+	struct stats_shm_entry *e = next_entry(data);
+
+	if (!e)
+		return -ENOSPC;
+	snprintf(e->name, sizeof(e->name), "%s.%u.%s",
+		 ctrg->desc->group_name_prefix, ctrg->idx, desc->name);
+	e->type = STATS_SHM_T_COUNTER;
+	e->value = ctr->current;
+	return 0;
+}
+
+static int handle_ctr_group(struct rate_ctr_group *ctrg, void *data)
+{
+	return rate_ctr_for_each_counter(ctrg, handle_counter, data);
+}
+
+static int handle_item(struct osmo_stat_item_group *statg, struct osmo_stat_item *item, void *data)
+{
+	struct stats_shm_entry *e = next_entry(data);
+
+	if (!e)
+		return -ENOSPC;
+	snprintf(e->name, sizeof(e->name), "%s.%u.%s",
+		 statg->desc->group_name_prefix, statg->idx, osmo_stat_item_get_desc(item)->name);
+	e->type = STATS_SHM_T_GAUGE;
+	e->value = osmo_stat_item_get_last(item);
+	return 0;
+}
+
+static int handle_statg(struct osmo_stat_item_group *statg, void *data)
+{
+	return osmo_stat_item_for_each_item(statg, handle_item, data);
+}
+
+static void snapshot(struct stats_shm *ss)
+{
+	struct stats_shm_hdr *hdr = ss->hdr;
+	uint32_t seq = hdr->seq;
+	struct timespec ts;
+
+	__atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	ss->num = 0;
+	rate_ctr_for_each_group(handle_ctr_group, ss);
+	osmo_stat_item_for_each_group(handle_statg, ss);
+
+	osmo_clock_gettime(CLOCK_REALTIME, &ts);
+	hdr->timestamp_us = (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	hdr->num_entries = ss->num;
+
+	__atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void task_cb(void *data)
+{
+	snapshot(data);
+}
+
+static void timer_cb(void *data)
+{
+	struct stats_shm *ss = data;
+
+	slack_task_queue(&ss->task);
+	osmo_timer_schedule(&ss->timer, ss->interval_ms / 1000, (ss->interval_ms % 1000) * 1000);
+}
+
+static int stats_shm_destructor(struct stats_shm *ss)
+{
+	osmo_timer_del(&ss->timer);
+	slack_task_cancel(&ss->task);
+	if (ss->hdr) {
+		munmap(ss->hdr, ss->size);
+		shm_unlink(ss->name);
+	}
+	return 0;
+}
+
+/*! Create the shared memory object \a name (see shm_open(3)) and export a
+ *  snapshot of all counters into it every \a interval_ms.
+ *  \returns the export instance; NULL on error. */
+struct stats_shm *stats_shm_start(void *ctx, const char *name, unsigned int interval_ms)
+{
+	struct stats_shm *ss;
+	void *addr;
+	int fd;
+
+	ss = talloc_zero(ctx, struct stats_shm);
+	if (!ss)
+		return NULL;
+	/* a portable shm name consists of a slash followed by the name */
+	ss->name = talloc_asprintf(ss, "%s%s", name[0] == '/' ? "" : "/", name);
+	ss->size = sizeof(struct stats_shm_hdr) + STATS_SHM_MAX_ENTRIES * sizeof(struct stats_shm_entry);
+	ss->interval_ms = interval_ms;
+	osmo_timer_setup(&ss->timer, timer_cb, ss);
+	slack_task_init(&ss->task, "stats-shm", task_cb, ss);
+	talloc_set_destructor(ss, stats_shm_destructor);
+
+	fd = shm_open(ss->name, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Stats shm %s: shm_open() failed: %s\n",
+		     ss->name, strerror(errno));
+		talloc_free(ss);
+		return NULL;
+	}
+	if (ftruncate(fd, ss->size) < 0) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Stats shm %s: ftruncate() failed: %s\n",
+		     ss->name, strerror(errno));
+		close(fd);
+		shm_unlink(ss->name);
+		talloc_free(ss);
+		return NULL;
+	}
+	addr = mmap(NULL, ss->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED) {
+		LOGP(DLGLOBAL, LOGL_ERROR, "Stats shm %s: mmap() failed: %s\n",
+		     ss->name, strerror(errno));
+		shm_unlink(ss->name);
+		talloc_free(ss);
+		return NULL;
+	}
+	ss->hdr = addr;
+
+	/* the object may be left over from a previous run: readers check the
+	 * magic first, so only set it once the rest is valid */
+	__atomic_store_n(&ss->hdr->magic, 0, __ATOMIC_RELAXED);
+	ss->hdr->version = STATS_SHM_VERSION;
+	ss->hdr->entry_size = sizeof(struct stats_shm_entry);
+	ss->hdr->max_entries = STATS_SHM_MAX_ENTRIES;
+	ss->hdr->interval_ms = interval_ms;
+	snapshot(ss);
+	__atomic_store_n(&ss->hdr->magic, STATS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	osmo_timer_schedule(&ss->timer, interval_ms / 1000, (interval_ms % 1000) * 1000);
+
+	LOGP(DLGLOBAL, LOGL_NOTICE, "Exporting the counters to shared memory %s every %u ms\n",
+	     ss->name, interval_ms);
+	return ss;
+}
+
+/*! Stop the export and remove the shared memory object */
+void stats_shm_stop(struct stats_shm *ss)
+{
+	talloc_free(ss);
+}
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <errno.h>
 
+#include <osmocom/core/utils.h>
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/sysinfo.h>
 
@@ -39,11 +40,14 @@ static inline uint8_t *get_si2q_inc_index(struct gsm_bts *bts)
 	return (uint8_t *)GSM_BTS_SI2Q(bts, i);
 }
 
-/* Apply the rules from 05.02 6.3.1.3 Mapping of BCCH Data */
-uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time)
+/* Apply the rules from 05.02 6.3.1.3 Mapping of BCCH Data: determine which SI is
+ * sent on which TC, for the SI currently present.  This is done whenever the set of
+ * SI changes, so that bts_sysinfo_get() only needs to look the SI up. */
+void bts_sysinfo_sched_update(struct gsm_bts *bts)
 {
+	enum osmo_sysinfo_type *tc = bts->si.sched.tc;
+	enum osmo_sysinfo_type *tc4_sub = bts->si.sched.tc4;
 	unsigned int tc4_cnt = 0;
-	unsigned int tc4_sub[4];
 
 	/* System information type 2 bis or 2 ter messages are sent if
 	 * needed, as determined by the system operator.  If only one of
@@ -69,86 +73,78 @@ uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time)
 	 * 4 consecutive occurrences of TC = 4. */
 
 	/* We only implement BCCH Norm at this time */
-	switch (g_time->tc) {
-	case 0:
-		/* System Information Type 1 need only be sent if
-		 * frequency hopping is in use or when the NCH is
-		 * present in a cell. If the MS finds another message
-		 * when TC = 0, it can assume that System Information
-		 * Type 1 is not in use.  */
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_1))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_1);
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-	case 1:
-		/* A SI 2 message will be sent at least every time TC = 1. */
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-	case 2:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_3);
-	case 3:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_4);
-	case 4:
-		/* iterate over 2ter, 2quater, 9, 13 */
-		/* determine how many SI we need to send on TC=4,
-		 * and which of them we send when */
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) && GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis)) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_2ter;
-			tc4_cnt += 1;
-		}
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
-		    (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) || GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_2quater;
-			tc4_cnt += 1;
-		}
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_13) && pcu_connected()) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_13;
-			tc4_cnt += 1;
-		}
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_9)) {
-			/* FIXME: check SI3 scheduling info! */
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_9;
-			tc4_cnt += 1;
-		}
-		/* simply send SI2 if we have nothing else to send */
-		if (tc4_cnt == 0)
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-		else {
-			/* increment static counter by one, modulo count */
-			bts->si.tc4_ctr = (bts->si.tc4_ctr + 1) % tc4_cnt;
 
-			if (tc4_sub[bts->si.tc4_ctr] == SYSINFO_TYPE_2quater)
-				return get_si2q_inc_index(bts);
+	/* System Information Type 1 need only be sent if
+	 * frequency hopping is in use or when the NCH is
+	 * present in a cell. If the MS finds another message
+	 * when TC = 0, it can assume that System Information
+	 * Type 1 is not in use.  */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_1))
+		tc[0] = SYSINFO_TYPE_1;
+	else
+		tc[0] = SYSINFO_TYPE_2;
+
+	/* A SI 2 message will be sent at least every time TC = 1. */
+	tc[1] = SYSINFO_TYPE_2;
+	tc[2] = SYSINFO_TYPE_3;
+	tc[3] = SYSINFO_TYPE_4;
+
+	/* iterate over 2ter, 2quater, 9, 13 */
+	/* determine how many SI we need to send on TC=4,
+	 * and which of them we send when */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) && GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))
+		tc4_sub[tc4_cnt++] = SYSINFO_TYPE_2ter;
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
+	    (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) || GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter)))
+		tc4_sub[tc4_cnt++] = SYSINFO_TYPE_2quater;
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_13) && pcu_connected())
+		tc4_sub[tc4_cnt++] = SYSINFO_TYPE_13;
+	/* FIXME: check SI3 scheduling info! */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_9))
+		tc4_sub[tc4_cnt++] = SYSINFO_TYPE_9;
+	/* simply send SI2 if we have nothing else to send */
+	tc[4] = SYSINFO_TYPE_2;
+	bts->si.sched.tc4_cnt = tc4_cnt;
+
+	/* 2bis, 2ter, 2quater */
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))
+		tc[5] = SYSINFO_TYPE_2bis;
+	else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
+		tc[5] = SYSINFO_TYPE_2ter;
+	else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater))
+		tc[5] = SYSINFO_TYPE_2quater;
+	else /* simply send SI2 if we have nothing else to send */
+		tc[5] = SYSINFO_TYPE_2;
+
+	tc[6] = SYSINFO_TYPE_3;
+	tc[7] = SYSINFO_TYPE_4;
+
+	bts->si.sched.si_valid = bts->si_valid;
+	bts->si.sched.pcu_connected = pcu_connected();
+	bts->si.sched.valid = true;
+}
 
-			return GSM_BTS_SI(bts, tc4_sub[bts->si.tc4_ctr]);
-		}
-	case 5:
-		/* 2bis, 2ter, 2quater */
-		if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) && !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2bis);
-
-		else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) && !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2ter);
-
-		else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) && GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2bis);
-
-		else if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
-			 !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) && !GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return get_si2q_inc_index(bts);
-
-			/* simply send SI2 if we have nothing else to send */
-		else
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-		break;
-	case 6:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_3);
-	case 7:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_4);
+uint8_t *bts_sysinfo_get(struct gsm_bts *bts, const struct gsm_time *g_time)
+{
+	enum osmo_sysinfo_type si_type;
+
+	/* SI may also be disabled (e.g. on OML state changes) outside of BCCH INFO,
+	 * and SI13 depends on the PCU connection state */
+	if (OSMO_UNLIKELY(!bts->si.sched.valid || bts->si.sched.si_valid != bts->si_valid ||
+			  bts->si.sched.pcu_connected != pcu_connected()))
+		bts_sysinfo_sched_update(bts);
+
+	si_type = bts->si.sched.tc[g_time->tc];
+	if (g_time->tc == 4 && bts->si.sched.tc4_cnt > 0) {
+		/* increment static counter by one, modulo count */
+		bts->si.tc4_ctr = (bts->si.tc4_ctr + 1) % bts->si.sched.tc4_cnt;
+		si_type = bts->si.sched.tc4[bts->si.tc4_ctr];
 	}
 
-	/* this should never bve reached. We must transmit a BCCH
-	 * message on the normal BCCH in all cases. */
-	OSMO_ASSERT(0);
-	return 0;
+	if (si_type == SYSINFO_TYPE_2quater)
+		return get_si2q_inc_index(bts);
+
+	return GSM_BTS_SI(bts, si_type);
 }
 
 uint8_t num_agch(const struct gsm_bts_trx *trx, const char * arg)
@@ -22,7 +22,10 @@
 
 /* Related specs: 3GPP TS 45.010 sections 5.5, 5.6 */
 
+#include <osmocom/core/rate_ctr.h>
+
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
 #include <osmo-bts/bts_trx.h>
 #include <osmo-bts/logging.h>
 
@@ -38,6 +41,13 @@
 #define TA_MAX_INC_STEP 2
 #define TA_MAX_DEC_STEP 2
 
+static void ta_ctrl_count_clamped(const struct gsm_lchan *lchan)
+{
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+
+	if (bts->ctrs != NULL)
+		rate_ctr_inc2(bts->ctrs, BTS_CTR_LOOP_TA_CLAMPED);
+}
 
 /*! compute the new "Ordered Timing Advance" communicated to the MS and store it in lchan.
  * \param lchan logical channel for which to compute (and in which to store) new power value.
@@ -64,13 +74,17 @@ void lchan_ms_ta_ctrl(struct gsm_lchan *lchan, uint8_t ms_tx_ta, int16_t toa256)
 	if (toa256 >= 0) {
 		if ((toa256 - (256 * delta_ta)) > TOA256_THRESH)
 			delta_ta++;
-		if (delta_ta > TA_MAX_INC_STEP)
+		if (delta_ta > TA_MAX_INC_STEP) {
 			delta_ta = TA_MAX_INC_STEP;
+			ta_ctrl_count_clamped(lchan);
+		}
 	} else {
 		if ((toa256 - (256 * delta_ta)) < -TOA256_THRESH)
 			delta_ta--;
-		if (delta_ta < -TA_MAX_DEC_STEP)
+		if (delta_ta < -TA_MAX_DEC_STEP) {
 			delta_ta = -TA_MAX_DEC_STEP;
+			ta_ctrl_count_clamped(lchan);
+		}
 	}
 
 	new_ta = ms_tx_ta + delta_ta;
@@ -97,6 +111,10 @@ void lchan_ms_ta_ctrl(struct gsm_lchan *lchan, uint8_t ms_tx_ta, int16_t toa256)
 		  (uint8_t)new_ta > lchan->ta_ctrl.current ? "late" : "early",
 		  toa256);
 
+	pwr_ctrl_log_add(lchan, PWR_CTRL_LOG_TA, &lchan->ta_ctrl.last_dir,
+			 (uint8_t)new_ta > lchan->ta_ctrl.current,
+			 lchan->ta_ctrl.current, (uint8_t)new_ta, toa256, 0);
+
 	/* store the resulting new TA in the lchan */
 	lchan->ta_ctrl.current = (uint8_t)new_ta;
 }
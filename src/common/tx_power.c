@@ -159,6 +159,27 @@ static int we_are_ramping_up(const struct gsm_bts_trx *trx)
 
 static void power_ramp_do_step(struct gsm_bts_trx *trx, int first);
 
+/* account the duration of the ramp which just reached its target */
+static void power_ramp_stats_done(struct gsm_bts_trx *trx)
+{
+	struct trx_power_params *tpp = &trx->power_params;
+	struct timespec now;
+	unsigned long long ms;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (now.tv_sec - tpp->ramp.stats.start.tv_sec) * 1000ULL
+	   + now.tv_nsec / 1000000 - tpp->ramp.stats.start.tv_nsec / 1000000;
+
+	tpp->ramp.stats.count++;
+	tpp->ramp.stats.last_ms = ms;
+	tpp->ramp.stats.last_steps = tpp->ramp.stats.steps;
+	if (ms > tpp->ramp.stats.max_ms)
+		tpp->ramp.stats.max_ms = ms;
+
+	LOGPTRX(trx, DL1C, LOGL_INFO, "power ramp reached %d mdBm after %llu ms in %u steps\n",
+		tpp->p_total_tgt_mdBm, ms, tpp->ramp.stats.steps);
+}
+
 /* timer call-back for the ramp timer */
 static void power_ramp_timer_cb(void *_trx)
 {
@@ -182,6 +203,7 @@ static void power_ramp_timer_cb(void *_trx)
 		"ramping TRX board output power to %d mdBm.\n", p_trxout_eff_mdBm);
 
 	/* Instruct L1 to apply new effective TRX output power required */
+	tpp->ramp.stats.steps++;
 	bts_model_change_power(trx, p_trxout_eff_mdBm);
 }
 
@@ -212,6 +234,7 @@ static void power_ramp_do_step(struct gsm_bts_trx *trx, int first)
 
 	/* we had finished in last loop iteration */
 	if (!first && tpp->ramp.attenuation_mdB == 0) {
+		power_ramp_stats_done(trx);
 		if (tpp->ramp.compl_cb)
 			tpp->ramp.compl_cb(trx);
 		return;
@@ -236,7 +259,8 @@ static void power_ramp_do_step(struct gsm_bts_trx *trx, int first)
 	/* schedule timer for the next step */
 	tpp->ramp.step_timer.data = trx;
 	tpp->ramp.step_timer.cb = power_ramp_timer_cb;
-	osmo_timer_schedule(&tpp->ramp.step_timer, tpp->ramp.step_interval_sec, 0);
+	osmo_timer_schedule(&tpp->ramp.step_timer, tpp->ramp.step_interval_ms / 1000,
+			    (tpp->ramp.step_interval_ms % 1000) * 1000);
 }
 
 int _power_ramp_start(struct gsm_bts_trx *trx, int p_total_tgt_mdBm, int bypass, ramp_compl_cb_t ramp_compl_cb, bool skip_ramping)
@@ -263,6 +287,8 @@ int _power_ramp_start(struct gsm_bts_trx *trx, int p_total_tgt_mdBm, int bypass,
 	/* set the new target */
 	tpp->p_total_tgt_mdBm = p_total_tgt_mdBm;
 	tpp->ramp.compl_cb = ramp_compl_cb;
+	osmo_clock_gettime(CLOCK_MONOTONIC, &tpp->ramp.stats.start);
+	tpp->ramp.stats.steps = 0;
 
 	if (skip_ramping) {
 		/* Jump straight to the target power */
@@ -307,6 +333,19 @@ void power_ramp_abort(struct gsm_bts_trx *trx)
 	osmo_timer_del(&trx->power_params.ramp.step_timer);
 }
 
+/* Whether the output power is at the given target, or being ramped to it.
+ * Used to avoid restarting the ramp (and the round-trips to the PHY) when
+ * the BSC re-sends unchanged attributes, e.g. after reconnecting. */
+bool power_ramp_target_is(const struct gsm_bts_trx *trx, int p_total_tgt_mdBm)
+{
+	const struct trx_power_params *tpp = &trx->power_params;
+
+	if (tpp->p_total_tgt_mdBm != p_total_tgt_mdBm)
+		return false;
+	return tpp->p_total_cur_mdBm == p_total_tgt_mdBm ||
+	       osmo_timer_pending(&tpp->ramp.step_timer);
+}
+
 /* determine the initial transceiver output power at start-up time */
 int power_ramp_initial_power_mdBm(const struct gsm_bts_trx *trx)
 {
@@ -22,7 +22,9 @@
 #include "btsconfig.h"
 
 #include <inttypes.h>
+#include <stdlib.h>
 #include <limits.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -31,6 +33,7 @@
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/gsm/abis_nm.h>
+#include <osmocom/gsm/rsl.h>
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/vty/vty.h>
 #include <osmocom/vty/stats.h>
@@ -57,10 +60,15 @@
 #include <osmo-bts/signal.h>
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/pcuif_proto.h>
+#include <osmo-bts/pcu_if.h>
 #include <osmo-bts/measurement.h>
 #include <osmo-bts/vty.h>
 #include <osmo-bts/l1sap.h>
 #include <osmo-bts/osmux.h>
+#include <osmo-bts/cbch.h>
+#include <osmo-bts/stats_shm.h>
+#include <osmo-bts/media_io.h>
+#include <osmo-bts/pcap_capture.h>
 
 #define VTY_STR	"Configure the VTY\n"
 
@@ -301,6 +309,21 @@ DEFUN(cfg_bts_osmux_dummy_padding,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_bts_osmux_batch_flush,
+      cfg_bts_osmux_batch_flush_cmd,
+      "batch-flush (timer|tdma)",
+      "Batch flushing\n"
+      "Deliver the batches by the Osmux batch timer (default)\n"
+      "Deliver the batches at the end of every 20 ms speech block period\n")
+{
+	struct gsm_bts *bts = vty->index;
+	if (strcmp(argv[0], "tdma") == 0)
+		bts->osmux.batch_flush = OSMUX_BATCH_FLUSH_TDMA;
+	else
+		bts->osmux.batch_flush = OSMUX_BATCH_FLUSH_TIMER;
+	return CMD_SUCCESS;
+}
+
 DEFUN_ATTR(cfg_bts_trx, cfg_bts_trx_cmd,
 	   "trx <0-254>",
 	   "Select a TRX to configure\n" "TRX number\n",
@@ -391,6 +414,8 @@ static void config_write_osmux(struct vty *vty, const char *prefix, const struct
 	vty_out(vty, "%s batch-factor %d%s", prefix, bts->osmux.batch_factor, VTY_NEWLINE);
 	vty_out(vty, "%s batch-size %u%s", prefix, bts->osmux.batch_size, VTY_NEWLINE);
 	vty_out(vty, "%s dummy-padding %s%s", prefix, bts->osmux.dummy_padding ? "on" : "off", VTY_NEWLINE);
+	vty_out(vty, "%s batch-flush %s%s", prefix,
+		bts->osmux.batch_flush == OSMUX_BATCH_FLUSH_TDMA ? "tdma" : "timer", VTY_NEWLINE);
 }
 
 static void config_write_bts_single(struct vty *vty, const struct gsm_bts *bts)
@@ -414,12 +439,22 @@ static void config_write_bts_single(struct vty *vty, const struct gsm_bts *bts)
 	if (bts->rtp_jitter_adaptive)
 		vty_out(vty, " adaptive");
 	vty_out(vty, "%s", VTY_NEWLINE);
+	if (bts->rtp_tch_jitter_buf_ms > 0) {
+		vty_out(vty, " rtp tch-jitter-buffer %u", bts->rtp_tch_jitter_buf_ms);
+		if (bts->rtp_tch_jitter_adaptive)
+			vty_out(vty, " adaptive");
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
 	vty_out(vty, " rtp port-range %u %u%s", bts->rtp_port_range_start,
 		bts->rtp_port_range_end, VTY_NEWLINE);
 	if (bts->rtp_ip_dscp != -1)
 		vty_out(vty, " rtp ip-dscp %d%s", bts->rtp_ip_dscp, VTY_NEWLINE);
 	if (bts->rtp_priority != -1)
 		vty_out(vty, " rtp socket-priority %d%s", bts->rtp_priority, VTY_NEWLINE);
+	if (bts->rtp_pool.size > 0)
+		vty_out(vty, " rtp socket-pool %u%s", bts->rtp_pool.size, VTY_NEWLINE);
+	if (bts->media_io.enabled)
+		vty_out(vty, " rtp media-thread%s", VTY_NEWLINE);
 	if (bts->rtp_nogaps_mode)
 		vty_out(vty, " rtp continuous-streaming%s", VTY_NEWLINE);
 	vty_out(vty, " %srtp internal-uplink-ecu%s",
@@ -462,6 +497,54 @@ static void config_write_bts_single(struct vty *vty, const struct gsm_bts *bts)
 		sapi_buf = osmo_str_tolower(get_value_string(gsmtap_sapi_names, GSMTAP_CHANNEL_ACCH));
 		vty_out(vty, " gsmtap-sapi %s%s", sapi_buf, VTY_NEWLINE);
 	}
+	if (bts->gsmtap.sampling != 1)
+		vty_out(vty, " gsmtap-sampling %u%s", bts->gsmtap.sampling, VTY_NEWLINE);
+	if (bts->pcap.sapi_mask != UINT32_MAX || !bts->pcap.sapi_acch) {
+		vty_out(vty, " pcap-capture-sapi disable-all%s", VTY_NEWLINE);
+		for (i = 0; i < sizeof(uint32_t) * 8; i++) {
+			if (!(bts->pcap.sapi_mask & ((uint32_t) 1 << i)))
+				continue;
+			sapi_buf = get_value_string_or_null(gsmtap_sapi_names, i);
+			if (sapi_buf == NULL)
+				continue;
+			sapi_buf = osmo_str_tolower(sapi_buf);
+			vty_out(vty, " pcap-capture-sapi %s%s", sapi_buf, VTY_NEWLINE);
+		}
+		if (bts->pcap.sapi_acch) {
+			sapi_buf = osmo_str_tolower(get_value_string(gsmtap_sapi_names, GSMTAP_CHANNEL_ACCH));
+			vty_out(vty, " pcap-capture-sapi %s%s", sapi_buf, VTY_NEWLINE);
+		}
+	}
+	if (bts->pcap.rtp)
+		vty_out(vty, " pcap-capture-rtp%s", VTY_NEWLINE);
+	if (bts->rsl_coalesce_bytes > 0)
+		vty_out(vty, " rsl-coalesce %u%s", bts->rsl_coalesce_bytes, VTY_NEWLINE);
+	if (bts->mem_lock.enabled)
+		vty_out(vty, " memory-lock heap-reserve %u%s", bts->mem_lock.heap_reserve_mb, VTY_NEWLINE);
+	if (bts->mem_hugepages > 0)
+		vty_out(vty, " memory-hugepages %u%s", bts->mem_hugepages, VTY_NEWLINE);
+	if (bts->vgcs_talker_window_ms > 0)
+		vty_out(vty, " vgcs-talker-window %u%s", bts->vgcs_talker_window_ms, VTY_NEWLINE);
+	if (bts->rach_shed.rate > 0) {
+		vty_out(vty, " rach-shed rate %u", bts->rach_shed.rate);
+		if (bts->rach_shed.burst != BTS_RACH_SHED_BURST_DEFAULT)
+			vty_out(vty, " burst %u", bts->rach_shed.burst);
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
+	if (bts->rach_shed.wait_ind >= 0)
+		vty_out(vty, " rach-shed reject wait-indication %d%s", bts->rach_shed.wait_ind, VTY_NEWLINE);
+	if (bts->rach_dedup.window_fn > 0)
+		vty_out(vty, " rach-dedup %u%s", bts->rach_dedup.window_fn, VTY_NEWLINE);
+	if (bts->sched_cpu_acct)
+		vty_out(vty, " scheduler cpu-accounting%s", VTY_NEWLINE);
+	if (bts->sched_cpu_load_ind)
+		vty_out(vty, " scheduler cpu-load-indication%s", VTY_NEWLINE);
+	if (bts->stats_shm.name != NULL) {
+		vty_out(vty, " stats-shm %s", bts->stats_shm.name);
+		if (bts->stats_shm.interval_ms != STATS_SHM_INTERVAL_DEFAULT)
+			vty_out(vty, " interval %u", bts->stats_shm.interval_ms);
+		vty_out(vty, "%s", VTY_NEWLINE);
+	}
 	vty_out(vty, " min-qual-rach %d%s", bts->min_qual_rach,
 		VTY_NEWLINE);
 	vty_out(vty, " min-qual-norm %d%s", bts->min_qual_norm,
@@ -470,8 +553,14 @@ static void config_write_bts_single(struct vty *vty, const struct gsm_bts *bts)
 		VTY_NEWLINE);
 	if (strcmp(bts->pcu.sock_path, PCU_SOCK_DEFAULT))
 		vty_out(vty, " pcu-socket %s%s", bts->pcu.sock_path, VTY_NEWLINE);
+	for (i = 1; i < ARRAY_SIZE(bts->pcu.shard_sock_path); i++) {
+		if (bts->pcu.shard_sock_path[i] != NULL)
+			vty_out(vty, " pcu-socket-shard %d %s%s", i, bts->pcu.shard_sock_path[i], VTY_NEWLINE);
+	}
 	if (bts->pcu.sock_wqueue_len_max != BTS_CFG_PCU_SOCK_WQUEUE_LEN_MAX_MAX)
 		vty_out(vty, " pcu-socket-wqueue-length %u%s", bts->pcu.sock_wqueue_len_max, VTY_NEWLINE);
+	if (bts->pcu.time_ind_interval != 1)
+		vty_out(vty, " pcu-time-ind-interval %u%s", bts->pcu.time_ind_interval, VTY_NEWLINE);
 	if (bts->supp_meas_toa256)
 		vty_out(vty, " supp-meas-info toa256%s", VTY_NEWLINE);
 	vty_out(vty, " smscb queue-max-length %d%s", bts->smscb_queue_max_len, VTY_NEWLINE);
@@ -494,13 +583,19 @@ static void config_write_bts_single(struct vty *vty, const struct gsm_bts *bts)
 			tpp->ramp.max_initial_pout_mdBm, VTY_NEWLINE);
 		vty_out(vty, "  power-ramp step-size %d mdB%s",
 			tpp->ramp.step_size_mdB, VTY_NEWLINE);
-		vty_out(vty, "  power-ramp step-interval %d%s",
-			tpp->ramp.step_interval_sec, VTY_NEWLINE);
+		if (tpp->ramp.step_interval_ms % 1000 == 0)
+			vty_out(vty, "  power-ramp step-interval %u%s",
+				tpp->ramp.step_interval_ms / 1000, VTY_NEWLINE);
+		else
+			vty_out(vty, "  power-ramp step-interval %u ms%s",
+				tpp->ramp.step_interval_ms, VTY_NEWLINE);
 		vty_out(vty, "  ms-power-control %s%s",
 			trx->ms_pwr_ctl_soft ? "osmo" : "dsp",
 			VTY_NEWLINE);
 		vty_out(vty, "  ta-control interval %u%s",
 			trx->ta_ctrl_interval, VTY_NEWLINE);
+		if (trx->pcu_sock_nr != 0)
+			vty_out(vty, "  pcu-socket-shard %u%s", trx->pcu_sock_nr, VTY_NEWLINE);
 		vty_out(vty, "  phy %u instance %u%s", pinst->phy_link->num,
 			pinst->num, VTY_NEWLINE);
 
@@ -718,6 +813,22 @@ DEFUN_USRATTR(cfg_bts_rtp_jitbuf,
 	return CMD_SUCCESS;
 }
 
+DEFUN_USRATTR(cfg_bts_rtp_tch_jitbuf,
+	      cfg_bts_rtp_tch_jitbuf_cmd,
+	      X(BTS_VTY_ATTR_NEW_LCHAN),
+	      "rtp tch-jitter-buffer <0-1000> [adaptive]",
+	      RTP_STR "Timestamp ordered jitter buffer in front of the DL TCH scheduler\n"
+	      "Max. buffering delay in ms (0 to disable)\n"
+	      "Adapt the buffering delay to the measured jitter\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rtp_tch_jitter_buf_ms = atoi(argv[0]);
+	bts->rtp_tch_jitter_adaptive = argc > 1;
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_bts_rtp_port_range,
       cfg_bts_rtp_port_range_cmd,
       "rtp port-range <1-65534> <1-65534>",
@@ -752,6 +863,7 @@ DEFUN(cfg_bts_rtp_port_range,
 	bts->rtp_port_range_start = start;
 	bts->rtp_port_range_end = end;
 	bts->rtp_port_range_next = bts->rtp_port_range_start;
+	lchan_rtp_pool_flush(bts);
 
 	return CMD_SUCCESS;
 }
@@ -766,6 +878,7 @@ DEFUN_USRATTR(cfg_bts_rtp_ip_dscp,
 	int dscp = atoi(argv[0]);
 
 	bts->rtp_ip_dscp = dscp;
+	lchan_rtp_pool_flush(bts);
 
 	return CMD_SUCCESS;
 }
@@ -781,7 +894,46 @@ DEFUN_USRATTR(cfg_bts_rtp_priority,
 	int prio = atoi(argv[0]);
 
 	bts->rtp_priority = prio;
+	lchan_rtp_pool_flush(bts);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_rtp_socket_pool,
+      cfg_bts_rtp_socket_pool_cmd,
+      "rtp socket-pool <0-256>",
+      RTP_STR "Keep pre-bound RTP/RTCP sockets ready for IPA CRCX\n"
+      "Number of sockets (0 to disable)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	if (lchan_rtp_pool_resize(bts, atoi(argv[0])) < 0) {
+		vty_out(vty, "%% Failed to allocate the RTP socket pool%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_rtp_media_thread,
+      cfg_bts_rtp_media_thread_cmd,
+      "rtp media-thread",
+      RTP_STR "Receive RTP in a background thread (applies to new connections)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->media_io.enabled = true;
+	return CMD_SUCCESS;
+}
 
+DEFUN(cfg_bts_no_rtp_media_thread,
+      cfg_bts_no_rtp_media_thread_cmd,
+      "no rtp media-thread",
+      NO_STR RTP_STR "Poll the RTP sockets from the TDMA scheduler (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->media_io.enabled = false;
 	return CMD_SUCCESS;
 }
 
@@ -879,7 +1031,7 @@ DEFUN_ATTR(cfg_bts_agch_queue_mgmt_params,
 	   AGCH_QUEUE_STR
 	   "Threshold to start cleanup\nin % of the maximum queue length\n"
 	   "Low water mark for cleanup\nin % of the maximum queue length\n"
-	   "High water mark for cleanup\nin % of the maximum queue length\n",
+	   "High water mark for cleanup (no longer used)\nin % of the maximum queue length\n",
 	   CMD_ATTR_IMMEDIATE)
 {
 	struct gsm_bts *bts = vty->index;
@@ -1042,6 +1194,32 @@ DEFUN(cfg_bts_pcu_sock_path, cfg_bts_pcu_sock_path_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_bts_pcu_sock_shard, cfg_bts_pcu_sock_shard_cmd,
+	"pcu-socket-shard <1-3> PATH",
+	"Configure an additional PCU socket, serving the PDCH of the TRX assigned to it\n"
+	"Number of the PCU socket shard\n"
+	"UNIX socket path\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	osmo_talloc_replace_string(bts, &bts->pcu.shard_sock_path[atoi(argv[0])], argv[1]);
+
+	/* FIXME: re-open the interface? */
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_pcu_sock_shard, cfg_bts_no_pcu_sock_shard_cmd,
+	"no pcu-socket-shard <1-3>",
+	NO_STR "Remove an additional PCU socket, its TRX are served by the 'pcu-socket'\n"
+	"Number of the PCU socket shard\n")
+{
+	struct gsm_bts *bts = vty->index;
+	int nr = atoi(argv[0]);
+
+	TALLOC_FREE(bts->pcu.shard_sock_path[nr]);
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_bts_pcu_sock_ql, cfg_bts_pcu_sock_ql_cmd,
 	"pcu-socket-wqueue-length <1-" OSMO_STRINGIFY_VAL(BTS_CFG_PCU_SOCK_WQUEUE_LEN_MAX_MAX) ">",
 	"Configure the PCU socket queue length\n"
@@ -1052,6 +1230,23 @@ DEFUN(cfg_bts_pcu_sock_ql, cfg_bts_pcu_sock_ql_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_bts_pcu_time_ind_interval, cfg_bts_pcu_time_ind_interval_cmd,
+	"pcu-time-ind-interval <1-52>",
+	"Send a TIME.ind to the PCU only every N-th TDMA block (and whenever the frame number jumps)\n"
+	"Interval in blocks (default 1, i.e. every block)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->pcu.time_ind_interval = atoi(argv[0]);
+	bts->pcu.time_ind_skip = 0;
+
+	if (bts->pcu.time_ind_interval > 1)
+		vty_out(vty, "%% Make sure that the PCU derives the frame number from "
+			"RTS.req/DATA.ind%s", VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN_ATTR(cfg_bts_supp_meas_toa256, cfg_bts_supp_meas_toa256_cmd,
 	   "supp-meas-info toa256",
 	   "Configure the RSL Supplementary Measurement Info\n"
@@ -1098,6 +1293,7 @@ DEFUN_ATTR(cfg_bts_smscb_tgt_qlen, cfg_bts_smscb_tgt_qlen_cmd,
 {
 	struct gsm_bts *bts = vty->index;
 	bts->smscb_queue_tgt_len = atoi(argv[0]);
+	bts_cbch_update_load(bts);
 	return CMD_SUCCESS;
 }
 
@@ -1109,6 +1305,7 @@ DEFUN_ATTR(cfg_bts_smscb_qhyst, cfg_bts_smscb_qhyst_cmd,
 {
 	struct gsm_bts *bts = vty->index;
 	bts->smscb_queue_hyst = atoi(argv[0]);
+	bts_cbch_update_load(bts);
 	return CMD_SUCCESS;
 }
 
@@ -1174,7 +1371,18 @@ DEFUN(cfg_trx_pr_step_interval, cfg_trx_pr_step_interval_cmd,
 {
 	struct gsm_bts_trx *trx = vty->index;
 
-	trx->power_params.ramp.step_interval_sec = atoi(argv[0]);
+	trx->power_params.ramp.step_interval_ms = atoi(argv[0]) * 1000;
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_trx_pr_step_interval_ms, cfg_trx_pr_step_interval_ms_cmd,
+	"power-ramp step-interval <1-100000> ms",
+	PR_STR "Power increase by step\n"
+	"Step time\n" "Step time in milliseconds\n")
+{
+	struct gsm_bts_trx *trx = vty->index;
+
+	trx->power_params.ramp.step_interval_ms = atoi(argv[0]);
 	return CMD_SUCCESS;
 }
 
@@ -1217,6 +1425,18 @@ DEFUN(cfg_ta_ctrl_interval, cfg_ta_ctrl_interval_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_trx_pcu_sock_shard, cfg_trx_pcu_sock_shard_cmd,
+	"pcu-socket-shard <0-3>",
+	"Select the PCU socket serving the PDCH of this TRX\n"
+	"Number of the 'pcu-socket-shard' (0 for the 'pcu-socket', default)\n")
+{
+	struct gsm_bts_trx *trx = vty->index;
+
+	trx->pcu_sock_nr = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_trx_phy, cfg_trx_phy_cmd,
 	"phy <0-255> instance <0-255>",
 	"Configure PHY Link+Instance for this TRX\n"
@@ -1307,6 +1527,8 @@ static const char *stringify_radio_link_timeout(int val)
 static void bts_dump_vty(struct vty *vty, const struct gsm_bts *bts)
 {
 	const struct gsm_bts_trx *trx;
+	unsigned int pcu_len, pcu_len_hwm, pcu_len_max;
+	struct rusage ru;
 
 	vty_out(vty, "BTS %u is of type '%s', in band %s, has CI %u LAC %u, "
 		"BSIC %u and %u TRX%s",
@@ -1328,6 +1550,9 @@ static void bts_dump_vty(struct vty *vty, const struct gsm_bts *bts)
 	if (strnlen(bts->pcu_version, MAX_VERSION_LENGTH))
 		vty_out(vty, "  PCU version %s connected%s",
 			bts->pcu_version, VTY_NEWLINE);
+	if (pcu_sock_queue_len(&pcu_len, &pcu_len_hwm, &pcu_len_max))
+		vty_out(vty, "  PCU socket queue: %u of %u messages (high-water mark %u)%s",
+			pcu_len, pcu_len_max, pcu_len_hwm, VTY_NEWLINE);
 	vty_out(vty, "  Paging: Queue size %u, occupied %u, lifetime %us%s",
 		paging_get_queue_max(bts->paging_state), paging_queue_length(bts->paging_state),
 		paging_get_lifetime(bts->paging_state), VTY_NEWLINE);
@@ -1350,6 +1575,16 @@ static void bts_dump_vty(struct vty *vty, const struct gsm_bts *bts)
 		VTY_NEWLINE);
 	vty_out(vty, "  OML Link state: %s.%s",
 		bts->oml_link ? "connected" : "disconnected", VTY_NEWLINE);
+	if (bts->abis_tts.last_rsl_ms > 0)
+		vty_out(vty, "  A-bis time to service: %llu ms (OML link up after %llu ms, "
+			"%u connection attempts)%s", bts->abis_tts.last_rsl_ms,
+			bts->abis_tts.last_oml_ms, bts->abis_tts.last_attempts, VTY_NEWLINE);
+	if (osmo_timer_pending(&bts->abis_grace.timer)) {
+		struct timeval remaining;
+		osmo_timer_remaining(&bts->abis_grace.timer, NULL, &remaining);
+		vty_out(vty, "  RF kept up without A-bis for another %ld s (X17)%s",
+			(long)remaining.tv_sec, VTY_NEWLINE);
+	}
 	vty_out(vty, "  PH-RTS.ind FN advance average: %d, min: %d, max: %d%s",
 		bts_get_avg_fn_advance(bts), bts->fn_stats.min, bts->fn_stats.max, VTY_NEWLINE);
 	vty_out(vty, "  Radio Link Timeout (OML): %s%s",
@@ -1362,6 +1597,14 @@ static void bts_dump_vty(struct vty *vty, const struct gsm_bts *bts)
 		vty_out(vty, "  BCCH carrier power reduction: %u dB%s",
 			bts->c0_power_red_db, VTY_NEWLINE);
 	}
+	if (getrusage(RUSAGE_SELF, &ru) == 0)
+		vty_out(vty, "  Memory: %s, page faults: %ld major, %ld minor%s",
+			bts->mem_lock.locked ? "locked" : "not locked",
+			ru.ru_majflt, ru.ru_minflt, VTY_NEWLINE);
+	if (tall_bts_hp_ctx != NULL)
+		vty_out(vty, "  Hugepage pool: %u pages, %zu bytes in %zu blocks in use%s",
+			bts->mem_hugepages, talloc_total_size(tall_bts_hp_ctx),
+			talloc_total_blocks(tall_bts_hp_ctx) - 1, VTY_NEWLINE);
 
 	llist_for_each_entry(trx, &bts->trx_list, list) {
 		const struct phy_instance *pinst = trx_phy_instance(trx);
@@ -1470,155 +1713,568 @@ DEFUN(show_bts_gprs, show_bts_gprs_cmd,
 	return CMD_SUCCESS;
 }
 
-DEFUN(test_send_failure_event_report, test_send_failure_event_report_cmd, "test send-failure-event-report <0-255>",
-      "Various testing commands\n"
-      "Send a test OML failure event report to the BSC\n" BTS_NR_STR)
+DEFUN(show_bts_osmux, show_bts_osmux_cmd,
+      "show bts <0-255> osmux",
+      SHOW_STR "Display information about a BTS\n"
+      BTS_NR_STR "Osmux state and batching statistics\n")
 {
-	int bts_nr = atoi(argv[0]);
+	const struct osmux_handle *h;
 	const struct gsm_bts *bts;
+	unsigned int i;
 
-	if (bts_nr >= g_bts_sm->num_bts) {
-		vty_out(vty, "%% can't find BTS '%s'%s", argv[0], VTY_NEWLINE);
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% can't find BTS '%s'%s",
+			argv[0], VTY_NEWLINE);
 		return CMD_WARNING;
 	}
 
-	bts = gsm_bts_num(g_bts_sm, bts_nr);
-	oml_tx_failure_event_rep(&bts->mo, NM_SEVER_MINOR, OSMO_EVT_WARN_SW_WARN, "test message sent from VTY");
+	vty_out(vty, "BTS %u Osmux batches delivered by %s%s", bts->nr,
+		bts->osmux.batch_flush == OSMUX_BATCH_FLUSH_TDMA ? "speech block period" : "batch timer",
+		VTY_NEWLINE);
+	llist_for_each_entry(h, &bts->osmux.osmux_handle_list, head) {
+		vty_out(vty, "  Peer %s: %d lchans, %u frames pending%s",
+			osmo_sockaddr_to_str(&h->rem_addr), h->refcnt, h->pending, VTY_NEWLINE);
+	}
+
+	vty_out(vty, "  Batch fill (frames: batches):%s", VTY_NEWLINE);
+	for (i = 0; i <= OSMUX_BATCH_FILL_MAX; i++) {
+		if (bts->osmux.batch_fill[i] == 0)
+			continue;
+		vty_out(vty, "    %2u%s: %llu%s", i, i == OSMUX_BATCH_FILL_MAX ? "+" : " ",
+			bts->osmux.batch_fill[i], VTY_NEWLINE);
+	}
 
 	return CMD_SUCCESS;
 }
 
-DEFUN_HIDDEN(radio_link_timeout, radio_link_timeout_cmd, "bts <0-0> radio-link-timeout (oml|infinite|<4-64>)",
-		"BTS Specific Commands\n" BTS_NR_STR "Manually override Radio Link Timeout\n"
-		"Use value provided by BSC via A-bis OML (Connection Failure Criterion)\n"
-		"Use infinite timeout (DANGEROUS: only use during testing!)\n"
-		"Number of lost SACCH blocks\n")
+DEFUN(show_bts_paging, show_bts_paging_cmd,
+      "show bts <0-255> paging",
+      SHOW_STR "Display information about a BTS\n"
+      BTS_NR_STR "Paging queue statistics\n")
 {
-	int bts_nr = atoi(argv[0]);
-	struct gsm_bts *bts = gsm_bts_num(g_bts_sm, bts_nr);
+	const struct paging_stats *st;
+	struct gsm_bts *bts;
+	unsigned int i;
 
-	if (!bts) {
-		vty_out(vty, "%% can't find BTS '%s'%s", argv[0], VTY_NEWLINE);
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% can't find BTS '%s'%s",
+			argv[0], VTY_NEWLINE);
 		return CMD_WARNING;
 	}
 
-	if (!strcmp(argv[1], "oml")) {
-		bts->radio_link_timeout.current = bts->radio_link_timeout.oml;
-		bts->radio_link_timeout.vty_override = false;
-	} else if (!strcmp(argv[1], "infinite")) {
-		bts->radio_link_timeout.current = -1;
-		bts->radio_link_timeout.vty_override = true;
-		vty_out(vty, "%% INFINITE RADIO LINK TIMEOUT, USE ONLY FOR BTS RF TESTING%s", VTY_NEWLINE);
-	} else {
-		bts->radio_link_timeout.current = atoi(argv[1]);
-		bts->radio_link_timeout.vty_override = true;
+	st = paging_get_stats(bts->paging_state);
+	vty_out(vty, "BTS %u paging queue: %d of %u records, lifetime %u s%s", bts->nr,
+		paging_queue_length(bts->paging_state), paging_get_queue_max(bts->paging_state),
+		paging_get_lifetime(bts->paging_state), VTY_NEWLINE);
+
+	vty_out(vty, "  Time until first transmission (ms: records):%s", VTY_NEWLINE);
+	for (i = 0; i < PAGING_WAIT_HIST_LEN; i++) {
+		unsigned int ms = (51 << OSMO_MIN(i, PAGING_WAIT_HIST_LEN - 2)) * 120 / 26;
+		vty_out(vty, "    %s %5u: %llu%s", i < PAGING_WAIT_HIST_LEN - 1 ? "< " : ">=",
+			ms, st->wait_hist[i], VTY_NEWLINE);
+	}
+
+	vty_out(vty, "  Transmissions until expiry (transmissions: records):%s", VTY_NEWLINE);
+	for (i = 0; i < PAGING_REPEAT_HIST_LEN; i++) {
+		if (st->repeat_hist[i] == 0)
+			continue;
+		vty_out(vty, "    %2u%s: %llu%s", i + 1, i == PAGING_REPEAT_HIST_LEN - 1 ? "+" : " ",
+			st->repeat_hist[i], VTY_NEWLINE);
+	}
+
+	vty_out(vty, "  Records per paging group (current/max.):%s", VTY_NEWLINE);
+	for (i = 0; i < PAGING_GROUPS_MAX; i++) {
+		if (st->group_len_max[i] == 0)
+			continue;
+		vty_out(vty, "    %2u: %u/%u%s", i, st->group_len[i], st->group_len_max[i], VTY_NEWLINE);
 	}
 
 	return CMD_SUCCESS;
 }
 
-DEFUN(bts_c0_power_red,
-      bts_c0_power_red_cmd,
-      "bts <0-0> c0-power-red <0-6>",
-      "BTS Specific Commands\n" BTS_NR_STR
-      "BCCH carrier power reduction operation\n"
-      "Power reduction value (in dB, even numbers only)\n")
+DEFUN(show_bts_si_sched, show_bts_si_sched_cmd,
+      "show bts <0-255> sysinfo-schedule",
+      SHOW_STR "Display information about a BTS\n"
+      BTS_NR_STR "BCCH Norm System Information schedule\n")
 {
-	const int bts_nr = atoi(argv[0]);
-	const int red = atoi(argv[1]);
 	struct gsm_bts *bts;
+	unsigned int tc, i;
 
 	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
 	if (bts == NULL) {
-		vty_out(vty, "%% No such BTS (%d)%s", bts_nr, VTY_NEWLINE);
+		vty_out(vty, "%% can't find BTS '%s'%s",
+			argv[0], VTY_NEWLINE);
 		return CMD_WARNING;
 	}
 
-	if (red % 2 != 0) {
-		vty_out(vty, "%% Incorrect BCCH power reduction value, "
-			"an even number is expected%s", VTY_NEWLINE);
-		return CMD_WARNING;
-	}
+	/* in case the PCU (dis)connected since the last BCCH block */
+	bts_sysinfo_sched_update(bts);
 
-	if (bts_set_c0_pwr_red(bts, red) != 0) {
-		vty_out(vty, "%% BCCH carrier power reduction operation mode "
-			"is not supported for BTS (%d)%s", bts_nr, VTY_NEWLINE);
-		return CMD_WARNING;
+	vty_out(vty, "BTS %u BCCH Norm schedule (TC: SI):%s", bts->nr, VTY_NEWLINE);
+	for (tc = 0; tc < ARRAY_SIZE(bts->si.sched.tc); tc++) {
+		vty_out(vty, "  %u:", tc);
+		if (tc == 4 && bts->si.sched.tc4_cnt > 0) {
+			for (i = 0; i < bts->si.sched.tc4_cnt; i++)
+				vty_out(vty, " SI%s", get_value_string(osmo_sitype_strs, bts->si.sched.tc4[i]));
+			vty_out(vty, " (in turn)");
+		} else {
+			vty_out(vty, " SI%s", get_value_string(osmo_sitype_strs, bts->si.sched.tc[tc]));
+		}
+		if (!GSM_BTS_HAS_SI(bts, bts->si.sched.tc[tc]) && (tc != 4 || bts->si.sched.tc4_cnt == 0))
+			vty_out(vty, " (not present)");
+		vty_out(vty, "%s", VTY_NEWLINE);
 	}
+	if (GSM_BTS_HAS_SI(bts, SYSINFO_TYPE_2quater))
+		vty_out(vty, "  SI2quater: %u instances, sent in turn%s", bts->si2q_count + 1, VTY_NEWLINE);
 
 	return CMD_SUCCESS;
 }
 
-/* TODO: generalize and move indention handling to libosmocore */
-#define cfg_out(vty, fmt, args...) \
-	vty_out(vty, "%*s" fmt, indent, "", ##args)
-
-static void dump_dpc_meas_params(struct vty *vty, const unsigned int indent,
-				 const struct gsm_power_ctrl_meas_params *mp,
-				 const char *pname, const unsigned int pn)
+DEFUN(show_bts_rsl_coalesce, show_bts_rsl_coalesce_cmd,
+      "show bts <0-255> rsl-coalesce",
+      SHOW_STR "Display information about a BTS\n"
+      BTS_NR_STR "RSL Tx coalescing statistics\n")
 {
-	cfg_out(vty, "Lower threshold (L_%s_XX_P): %u%s",
-		pname, mp->lower_thresh, VTY_NEWLINE);
-	cfg_out(vty, "Upper threshold (U_%s_XX_P): %u%s",
-		pname, mp->upper_thresh, VTY_NEWLINE);
+	const struct gsm_bts_trx *trx;
+	const struct gsm_bts *bts;
+	unsigned long long batches;
+	unsigned int i;
 
-	cfg_out(vty, "Lower threshold comparators: P%u=%02u / N%u=%02u%s",
-		pn, mp->lower_cmp_p, pn, mp->lower_cmp_n, VTY_NEWLINE);
-	cfg_out(vty, "Upper threshold comparators: P%u=%02u / N%u=%02u%s",
-		pn + 1, mp->upper_cmp_p, pn + 1, mp->upper_cmp_n, VTY_NEWLINE);
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% can't find BTS '%s'%s",
+			argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
 
-	cfg_out(vty, "Pre-processing algorithm: ");
-	switch (mp->algo) {
-	case GSM_PWR_CTRL_MEAS_AVG_ALGO_UNWEIGHTED:
-		vty_out(vty, "unweighted average%s", VTY_NEWLINE);
-		break;
-	case GSM_PWR_CTRL_MEAS_AVG_ALGO_WEIGHTED:
-		vty_out(vty, "weighted average%s", VTY_NEWLINE);
-		break;
-	case GSM_PWR_CTRL_MEAS_AVG_ALGO_MOD_MEDIAN:
-		vty_out(vty, "modified median%s", VTY_NEWLINE);
-		break;
-	case GSM_PWR_CTRL_MEAS_AVG_ALGO_OSMO_EWMA:
-		vty_out(vty, "EWMA (alpha=%u)%s",
-			mp->ewma.alpha, VTY_NEWLINE);
-		break;
-	case GSM_PWR_CTRL_MEAS_AVG_ALGO_NONE:
-		vty_out(vty, "disabled (pass-through)%s", VTY_NEWLINE);
-		return;
-	default:
-		vty_out(vty, "unknown%s", VTY_NEWLINE);
-		return;
+	if (bts->rsl_coalesce_bytes > 0)
+		vty_out(vty, "BTS %u RSL coalescing: max. %u bytes per batch%s", bts->nr,
+			bts->rsl_coalesce_bytes, VTY_NEWLINE);
+	else
+		vty_out(vty, "BTS %u RSL coalescing: off%s", bts->nr, VTY_NEWLINE);
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		batches = 0;
+		for (i = 0; i <= RSL_COALESCE_FILL_MAX; i++)
+			batches += trx->rsl_coalesce.batch_fill[i];
+		if (batches == 0)
+			continue;
+
+		vty_out(vty, "  TRX %u: %llu batches, corked avg %llu us, max %u us%s", trx->nr, batches,
+			trx->rsl_coalesce.corked_sum_us / batches, trx->rsl_coalesce.corked_max_us,
+			VTY_NEWLINE);
+		vty_out(vty, "  Batch fill (messages: batches):%s", VTY_NEWLINE);
+		for (i = 0; i <= RSL_COALESCE_FILL_MAX; i++) {
+			if (trx->rsl_coalesce.batch_fill[i] == 0)
+				continue;
+			vty_out(vty, "    %2u%s: %llu%s", i, i == RSL_COALESCE_FILL_MAX ? "+" : " ",
+				trx->rsl_coalesce.batch_fill[i], VTY_NEWLINE);
+		}
 	}
 
-	cfg_out(vty, "Pre-processing parameters: Hreqave=%u / Hreqt=%u%s",
-		mp->h_reqave, mp->h_reqt, VTY_NEWLINE);
+	return CMD_SUCCESS;
 }
 
-static void dump_dpc_params(struct vty *vty, const unsigned int indent,
-			    const struct gsm_power_ctrl_params *cp, bool uplink)
+DEFUN(show_bts_proc_lat, show_bts_proc_lat_cmd,
+      "show bts <0-255> latency",
+      SHOW_STR "Display information about a BTS\n"
+      BTS_NR_STR "Latency of the channel activation/modification procedures\n")
 {
-	cfg_out(vty, "Power control interval: %u ms (every %u SACCH block(s))%s",
-		cp->ctrl_interval ? cp->ctrl_interval * 2 * 480 : 480,
-		cp->ctrl_interval ? cp->ctrl_interval * 2 : 1,
-		VTY_NEWLINE);
+	const struct bts_proc_lat_stats *st;
+	const struct gsm_bts *bts;
+	unsigned int i, j;
 
-	cfg_out(vty, "Power increase step size: %u%s",
-		cp->inc_step_size_db, VTY_NEWLINE);
-	cfg_out(vty, "Power reduce step size: %u%s",
-		cp->red_step_size_db, VTY_NEWLINE);
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% can't find BTS '%s'%s",
+			argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
 
-	cfg_out(vty, "RxLev measurement processing:%s", VTY_NEWLINE);
-	dump_dpc_meas_params(vty, indent + 2, &cp->rxlev_meas, "RXLEV", 1);
+	vty_out(vty, "BTS %u (%s) procedure latency:%s", bts->nr,
+		btsvariant2str(bts->variant), VTY_NEWLINE);
 
-	cfg_out(vty, "RxQual measurement processing:%s", VTY_NEWLINE);
-	dump_dpc_meas_params(vty, indent + 2, &cp->rxqual_meas, "RXQUAL", 3);
+	for (i = 0; i < _NUM_BTS_PROC_LAT; i++) {
+		st = &bts->proc_lat[i];
+		if (st->count == 0)
+			continue;
 
-	if (uplink) {
-		cfg_out(vty, "C/I measurement processing (FR/EFR):%s", VTY_NEWLINE);
-		dump_dpc_meas_params(vty, indent + 2, &cp->ci_fr_meas, "CI_FR", 0);
+		vty_out(vty, "  %s: %llu times, avg %llu us, max %llu us%s",
+			get_value_string(bts_proc_lat_names, i), st->count,
+			st->sum_us / st->count, st->max_us, VTY_NEWLINE);
+		for (j = 0; j < BTS_PROC_LAT_HIST_LEN; j++) {
+			if (st->hist[j] == 0)
+				continue;
+			vty_out(vty, "    %s %7u us: %llu%s", j < BTS_PROC_LAT_HIST_LEN - 1 ? "< " : ">=",
+				250 << OSMO_MIN(j, BTS_PROC_LAT_HIST_LEN - 2), st->hist[j], VTY_NEWLINE);
+		}
+	}
 
-		cfg_out(vty, "C/I measurement processing (HR):%s", VTY_NEWLINE);
-		dump_dpc_meas_params(vty, indent + 2, &cp->ci_hr_meas, "CI_HR", 0);
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_bts_pwr_ctrl_log, show_bts_pwr_ctrl_log_cmd,
+      "show bts <0-255> control-loop-log",
+      SHOW_STR "Display information about a BTS\n"
+      BTS_NR_STR "Recent level changes of the MS/BS Power and TA Control Loops\n")
+{
+	const struct pwr_ctrl_log_entry *e;
+	const struct pwr_ctrl_log *pcl;
+	const struct gsm_bts *bts;
+	unsigned int i, num;
+
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% can't find BTS '%s'%s",
+			argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	pcl = &bts->pwr_ctrl_log;
+	num = OSMO_MIN(pcl->num, PWR_CTRL_LOG_LEN);
+	vty_out(vty, "BTS %u control loop log (last %u of %u level changes):%s",
+		bts->nr, num, pcl->num, VTY_NEWLINE);
+
+	/* oldest entry first */
+	for (i = pcl->num - num; i != pcl->num; i++) {
+		e = &pcl->entries[i % PWR_CTRL_LOG_LEN];
+		vty_out(vty, "  fn=%-7u TRX %u TS %u SS %u ", e->fn, e->trx_nr, e->ts_nr, e->lchan_nr);
+		switch (e->loop) {
+		case PWR_CTRL_LOG_MS_PWR:
+			vty_out(vty, "MS power level %u => %u (RxLev %d, C/I %d cB)%s",
+				e->old, e->new, e->avg[0], e->avg[1], VTY_NEWLINE);
+			break;
+		case PWR_CTRL_LOG_BS_PWR:
+			vty_out(vty, "BS attenuation %u => %u dB (RxLev %d, RxQual %d)%s",
+				e->old, e->new, e->avg[0], e->avg[1], VTY_NEWLINE);
+			break;
+		case PWR_CTRL_LOG_TA:
+			vty_out(vty, "TA %u => %u (ToA256 %d)%s",
+				e->old, e->new, e->avg[0], VTY_NEWLINE);
+			break;
+		}
+	}
+
+	return CMD_SUCCESS;
+}
+
+static int rsl_rx_stats_cmp(const void *a, const void *b)
+{
+	const struct rsl_rx_stats *st_a = *(const struct rsl_rx_stats **)a;
+	const struct rsl_rx_stats *st_b = *(const struct rsl_rx_stats **)b;
+
+	/* most time consuming first */
+	if (st_a->time_ns != st_b->time_ns)
+		return st_a->time_ns < st_b->time_ns ? 1 : -1;
+	return 0;
+}
+
+DEFUN(show_rsl_stats, show_rsl_stats_cmd,
+      "show rsl stats",
+      SHOW_STR "Radio Signalling Link (RSL)\n"
+      "Number and handling time of the received RSL messages\n")
+{
+	const struct rsl_rx_stats *st, **sorted;
+	unsigned int i, num = 0;
+
+	for (i = 0; rsl_rx_stats_get(i) != NULL; i++)
+		;
+	sorted = talloc_array(tall_bts_ctx, const struct rsl_rx_stats *, i);
+	if (sorted == NULL)
+		return CMD_WARNING;
+
+	for (i = 0; (st = rsl_rx_stats_get(i)) != NULL; i++) {
+		if (st->count > 0)
+			sorted[num++] = st;
+	}
+	qsort(sorted, num, sizeof(*sorted), rsl_rx_stats_cmp);
+
+	vty_out(vty, "Received RSL messages (messages, handling time total / avg.):%s", VTY_NEWLINE);
+	for (i = 0; i < num; i++) {
+		st = sorted[i];
+		vty_out(vty, "  %-28s %10llu %10.3f ms %8.1f us%s",
+			rsl_or_ipac_msg_name(st->msg_type),
+			st->count, st->time_ns / 1e6, st->time_ns / 1e3 / st->count, VTY_NEWLINE);
+	}
+
+	talloc_free(sorted);
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_rsl_msgb_pool, show_rsl_msgb_pool_cmd,
+      "show rsl msgb-pool",
+      SHOW_STR "Radio Signalling Link (RSL)\n"
+      "Pool of msgbs for outgoing RSL messages\n")
+{
+	const struct rsl_msgb_pool *pool = rsl_msgb_pool_get();
+
+	vty_out(vty, "In use: %u (high-water mark %u), pooled: %u%s",
+		pool->in_use, pool->in_use_max, pool->free_len, VTY_NEWLINE);
+	vty_out(vty, "Hits: %llu, misses: %llu%s",
+		pool->hits, pool->misses, VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_l1sap_msgb_pool, show_l1sap_msgb_pool_cmd,
+      "show l1sap msgb-pool",
+      SHOW_STR "L1 Service Access Point\n"
+      "Pool of msgbs for L1SAP primitives\n")
+{
+	const struct l1sap_msgb_pool *pool;
+	unsigned int i;
+
+	for (i = 0; (pool = l1sap_msgb_pool_get(i)) != NULL; i++) {
+		vty_out(vty, "msgb pool for L2 length up to %u octets:%s",
+			pool->l2_len, VTY_NEWLINE);
+		vty_out(vty, "  In use: %u (high-water mark %u), pooled: %u%s",
+			pool->in_use, pool->in_use_max, pool->free_len, VTY_NEWLINE);
+		vty_out(vty, "  Hits: %llu, misses: %llu%s",
+			pool->hits, pool->misses, VTY_NEWLINE);
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_pcu_msgb_pool, show_pcu_msgb_pool_cmd,
+      "show pcu msgb-pool",
+      SHOW_STR "Packet Control Unit (PCU)\n"
+      "Pool of msgbs for primitives towards the PCU\n")
+{
+	const struct pcu_msgb_pool *pool = pcu_msgb_pool_get();
+
+	vty_out(vty, "In use: %u (high-water mark %u), pooled: %u%s",
+		pool->in_use, pool->in_use_max, pool->free_len, VTY_NEWLINE);
+	vty_out(vty, "Hits: %llu, misses: %llu%s",
+		pool->hits, pool->misses, VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(test_send_failure_event_report, test_send_failure_event_report_cmd, "test send-failure-event-report <0-255>",
+      "Various testing commands\n"
+      "Send a test OML failure event report to the BSC\n" BTS_NR_STR)
+{
+	int bts_nr = atoi(argv[0]);
+	const struct gsm_bts *bts;
+
+	if (bts_nr >= g_bts_sm->num_bts) {
+		vty_out(vty, "%% can't find BTS '%s'%s", argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	bts = gsm_bts_num(g_bts_sm, bts_nr);
+	oml_tx_failure_event_rep(&bts->mo, NM_SEVER_MINOR, OSMO_EVT_WARN_SW_WARN, "test message sent from VTY");
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_HIDDEN(radio_link_timeout, radio_link_timeout_cmd, "bts <0-0> radio-link-timeout (oml|infinite|<4-64>)",
+		"BTS Specific Commands\n" BTS_NR_STR "Manually override Radio Link Timeout\n"
+		"Use value provided by BSC via A-bis OML (Connection Failure Criterion)\n"
+		"Use infinite timeout (DANGEROUS: only use during testing!)\n"
+		"Number of lost SACCH blocks\n")
+{
+	int bts_nr = atoi(argv[0]);
+	struct gsm_bts *bts = gsm_bts_num(g_bts_sm, bts_nr);
+
+	if (!bts) {
+		vty_out(vty, "%% can't find BTS '%s'%s", argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (!strcmp(argv[1], "oml")) {
+		bts->radio_link_timeout.current = bts->radio_link_timeout.oml;
+		bts->radio_link_timeout.vty_override = false;
+	} else if (!strcmp(argv[1], "infinite")) {
+		bts->radio_link_timeout.current = -1;
+		bts->radio_link_timeout.vty_override = true;
+		vty_out(vty, "%% INFINITE RADIO LINK TIMEOUT, USE ONLY FOR BTS RF TESTING%s", VTY_NEWLINE);
+	} else {
+		bts->radio_link_timeout.current = atoi(argv[1]);
+		bts->radio_link_timeout.vty_override = true;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(bts_c0_power_red,
+      bts_c0_power_red_cmd,
+      "bts <0-0> c0-power-red <0-6>",
+      "BTS Specific Commands\n" BTS_NR_STR
+      "BCCH carrier power reduction operation\n"
+      "Power reduction value (in dB, even numbers only)\n")
+{
+	const int bts_nr = atoi(argv[0]);
+	const int red = atoi(argv[1]);
+	struct gsm_bts *bts;
+
+	bts = gsm_bts_num(g_bts_sm, atoi(argv[0]));
+	if (bts == NULL) {
+		vty_out(vty, "%% No such BTS (%d)%s", bts_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (red % 2 != 0) {
+		vty_out(vty, "%% Incorrect BCCH power reduction value, "
+			"an even number is expected%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (bts_set_c0_pwr_red(bts, red) != 0) {
+		vty_out(vty, "%% BCCH carrier power reduction operation mode "
+			"is not supported for BTS (%d)%s", bts_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+#define PCAP_CAPTURE_STR "pcapng capture of GSMTAP Um (and RTP) into local files\n"
+
+DEFUN(bts_pcap_capture_start,
+      bts_pcap_capture_start_cmd,
+      "bts <0-255> pcap-capture start FILE [<1-1024>] [<1-64>]",
+      "BTS Specific Commands\n" BTS_NR_STR PCAP_CAPTURE_STR
+      "Start capturing (restart if already running)\n"
+      "Base name of the files, FILE.0, FILE.1, ... are overwritten\n"
+      "Size of each file in MiB (default 16)\n"
+      "Number of files to rotate through (default 4)\n")
+{
+	const int bts_nr = atoi(argv[0]);
+	size_t file_size = 16;
+	unsigned int num_files = 4;
+	struct gsm_bts *bts;
+
+	bts = gsm_bts_num(g_bts_sm, bts_nr);
+	if (bts == NULL) {
+		vty_out(vty, "%% No such BTS (%d)%s", bts_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (argc > 2)
+		file_size = atoi(argv[2]);
+	if (argc > 3)
+		num_files = atoi(argv[3]);
+
+	if (bts->pcap.cap != NULL) {
+		pcap_capture_stop(bts->pcap.cap);
+		bts->pcap.cap = NULL;
+	}
+
+	bts->pcap.cap = pcap_capture_start(bts, argv[1], file_size * 1024 * 1024, num_files);
+	if (bts->pcap.cap == NULL) {
+		vty_out(vty, "%% Failed to start the capture into %s.0: %s%s",
+			argv[1], strerror(errno), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(bts_pcap_capture_stop,
+      bts_pcap_capture_stop_cmd,
+      "bts <0-255> pcap-capture stop",
+      "BTS Specific Commands\n" BTS_NR_STR PCAP_CAPTURE_STR
+      "Stop capturing and close the current file\n")
+{
+	const int bts_nr = atoi(argv[0]);
+	struct pcap_capture_stats st;
+	struct gsm_bts *bts;
+
+	bts = gsm_bts_num(g_bts_sm, bts_nr);
+	if (bts == NULL) {
+		vty_out(vty, "%% No such BTS (%d)%s", bts_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (bts->pcap.cap == NULL) {
+		vty_out(vty, "%% No capture running for BTS (%d)%s", bts_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	pcap_capture_get_stats(bts->pcap.cap, &st);
+	vty_out(vty, "Captured %" PRIu64 " packets into %" PRIu64 " file(s), last one is %s%s",
+		st.num_pkts, st.num_files, st.path, VTY_NEWLINE);
+
+	pcap_capture_stop(bts->pcap.cap);
+	bts->pcap.cap = NULL;
+
+	return CMD_SUCCESS;
+}
+
+/* TODO: generalize and move indention handling to libosmocore */
+#define cfg_out(vty, fmt, args...) \
+	vty_out(vty, "%*s" fmt, indent, "", ##args)
+
+static void dump_dpc_meas_params(struct vty *vty, const unsigned int indent,
+				 const struct gsm_power_ctrl_meas_params *mp,
+				 const char *pname, const unsigned int pn)
+{
+	cfg_out(vty, "Lower threshold (L_%s_XX_P): %u%s",
+		pname, mp->lower_thresh, VTY_NEWLINE);
+	cfg_out(vty, "Upper threshold (U_%s_XX_P): %u%s",
+		pname, mp->upper_thresh, VTY_NEWLINE);
+
+	cfg_out(vty, "Lower threshold comparators: P%u=%02u / N%u=%02u%s",
+		pn, mp->lower_cmp_p, pn, mp->lower_cmp_n, VTY_NEWLINE);
+	cfg_out(vty, "Upper threshold comparators: P%u=%02u / N%u=%02u%s",
+		pn + 1, mp->upper_cmp_p, pn + 1, mp->upper_cmp_n, VTY_NEWLINE);
+
+	cfg_out(vty, "Pre-processing algorithm: ");
+	switch (mp->algo) {
+	case GSM_PWR_CTRL_MEAS_AVG_ALGO_UNWEIGHTED:
+		vty_out(vty, "unweighted average%s", VTY_NEWLINE);
+		break;
+	case GSM_PWR_CTRL_MEAS_AVG_ALGO_WEIGHTED:
+		vty_out(vty, "weighted average%s", VTY_NEWLINE);
+		break;
+	case GSM_PWR_CTRL_MEAS_AVG_ALGO_MOD_MEDIAN:
+		vty_out(vty, "modified median%s", VTY_NEWLINE);
+		break;
+	case GSM_PWR_CTRL_MEAS_AVG_ALGO_OSMO_EWMA:
+		vty_out(vty, "EWMA (alpha=%u)%s",
+			mp->ewma.alpha, VTY_NEWLINE);
+		break;
+	case GSM_PWR_CTRL_MEAS_AVG_ALGO_NONE:
+		vty_out(vty, "disabled (pass-through)%s", VTY_NEWLINE);
+		return;
+	default:
+		vty_out(vty, "unknown%s", VTY_NEWLINE);
+		return;
+	}
+
+	cfg_out(vty, "Pre-processing parameters: Hreqave=%u / Hreqt=%u%s",
+		mp->h_reqave, mp->h_reqt, VTY_NEWLINE);
+}
+
+static void dump_dpc_params(struct vty *vty, const unsigned int indent,
+			    const struct gsm_power_ctrl_params *cp, bool uplink)
+{
+	cfg_out(vty, "Power control interval: %u ms (every %u SACCH block(s))%s",
+		cp->ctrl_interval ? cp->ctrl_interval * 2 * 480 : 480,
+		cp->ctrl_interval ? cp->ctrl_interval * 2 : 1,
+		VTY_NEWLINE);
+
+	cfg_out(vty, "Power increase step size: %u%s",
+		cp->inc_step_size_db, VTY_NEWLINE);
+	cfg_out(vty, "Power reduce step size: %u%s",
+		cp->red_step_size_db, VTY_NEWLINE);
+
+	cfg_out(vty, "RxLev measurement processing:%s", VTY_NEWLINE);
+	dump_dpc_meas_params(vty, indent + 2, &cp->rxlev_meas, "RXLEV", 1);
+
+	cfg_out(vty, "RxQual measurement processing:%s", VTY_NEWLINE);
+	dump_dpc_meas_params(vty, indent + 2, &cp->rxqual_meas, "RXQUAL", 3);
+
+	if (uplink) {
+		cfg_out(vty, "C/I measurement processing (FR/EFR):%s", VTY_NEWLINE);
+		dump_dpc_meas_params(vty, indent + 2, &cp->ci_fr_meas, "CI_FR", 0);
+
+		cfg_out(vty, "C/I measurement processing (HR):%s", VTY_NEWLINE);
+		dump_dpc_meas_params(vty, indent + 2, &cp->ci_hr_meas, "CI_HR", 0);
 
 		cfg_out(vty, "C/I measurement processing (AMR-FR):%s", VTY_NEWLINE);
 		dump_dpc_meas_params(vty, indent + 2, &cp->ci_amr_fr_meas, "CI_AMR_FR", 0);
@@ -1636,6 +2292,8 @@ static void dump_dpc_params(struct vty *vty, const unsigned int indent,
 
 static void trx_dump_vty(struct vty *vty, const struct gsm_bts_trx *trx)
 {
+	const struct trx_power_params *tpp = &trx->power_params;
+
 	vty_out(vty, "TRX %u of BTS %u is on ARFCN %u%s",
 		trx->nr, trx->bts->nr, trx->arfcn, VTY_NEWLINE);
 	vty_out(vty, "Description: %s%s",
@@ -1663,6 +2321,11 @@ static void trx_dump_vty(struct vty *vty, const struct gsm_bts_trx *trx)
 	vty_out(vty, "  Baseband Transceiver NM State: ");
 	net_dump_nmstate(vty, &trx->bb_transc.mo.nm_state);
 	vty_out(vty, "  IPA stream ID: 0x%02x%s", trx->rsl_tei, VTY_NEWLINE);
+	if (tpp->ramp.stats.count > 0) {
+		vty_out(vty, "  Power ramps: %u, last %llu ms (%u steps), max %llu ms%s",
+			tpp->ramp.stats.count, tpp->ramp.stats.last_ms,
+			tpp->ramp.stats.last_steps, tpp->ramp.stats.max_ms, VTY_NEWLINE);
+	}
 }
 
 static inline void print_all_trx(struct vty *vty, const struct gsm_bts *bts)
@@ -1714,17 +2377,22 @@ DEFUN(show_trx,
 }
 
 
+/* One vty_out() per timeslot, see dyn_ts_status() */
 static void ts_dump_vty(struct vty *vty, const struct gsm_bts_trx_ts *ts)
 {
-	vty_out(vty, "BTS %u, TRX %u, Timeslot %u, phys cfg %s, TSC %u",
-		ts->trx->bts->nr, ts->trx->nr, ts->nr,
-		gsm_pchan_name(ts->pchan), ts->tsc);
+	const struct gsm_nm_state *nms = &ts->mo.nm_state;
+	const char *mode = "";
+
 	if (ts->pchan == GSM_PCHAN_TCH_F_PDCH)
-		vty_out(vty, " (%s mode)",
-			ts->flags & TS_F_PDCH_ACTIVE ? "PDCH" : "TCH/F");
-	vty_out(vty, "%s", VTY_NEWLINE);
-	vty_out(vty, "  NM State: ");
-	net_dump_nmstate(vty, &ts->mo.nm_state);
+		mode = ts->flags & TS_F_PDCH_ACTIVE ? " (PDCH mode)" : " (TCH/F mode)";
+
+	vty_out(vty, "BTS %u, TRX %u, Timeslot %u, phys cfg %s, TSC %u%s%s"
+		"  NM State: Oper '%s', Admin '%s', Avail '%s'%s",
+		ts->trx->bts->nr, ts->trx->nr, ts->nr,
+		gsm_pchan_name(ts->pchan), ts->tsc, mode, VTY_NEWLINE,
+		abis_nm_opstate_name(nms->operational),
+		get_value_string(abis_nm_adm_state_names, nms->administrative),
+		abis_nm_avail_name(nms->availability), VTY_NEWLINE);
 }
 
 DEFUN(show_ts,
@@ -1804,33 +2472,36 @@ DEFUN(show_ts,
 
 /* call vty_out() to print a string like " as TCH/H" for dynamic timeslots.
  * Don't do anything if the ts is not dynamic. */
-static void vty_out_dyn_ts_status(struct vty *vty, const struct gsm_bts_trx_ts *ts)
+/* Format the dyn TS status into \a buf, so that the callers print each line
+ * with a single vty_out(): "show lchan summary" with many TRX is polled by
+ * monitoring tools and runs on the same event loop as the frame handling. */
+static const char *dyn_ts_status(char *buf, size_t len, const struct gsm_bts_trx_ts *ts)
 {
 	switch (ts->pchan) {
 	case GSM_PCHAN_OSMO_DYN:
 		if (ts->dyn.pchan_is == ts->dyn.pchan_want)
-			vty_out(vty, " as %s",
-				gsm_pchan_name(ts->dyn.pchan_is));
+			snprintf(buf, len, " as %s",
+				 gsm_pchan_name(ts->dyn.pchan_is));
 		else
-			vty_out(vty, " switching %s -> %s",
-				gsm_pchan_name(ts->dyn.pchan_is),
-				gsm_pchan_name(ts->dyn.pchan_want));
-		break;
+			snprintf(buf, len, " switching %s -> %s",
+				 gsm_pchan_name(ts->dyn.pchan_is),
+				 gsm_pchan_name(ts->dyn.pchan_want));
+		return buf;
 	case GSM_PCHAN_TCH_F_PDCH:
 		if ((ts->flags & TS_F_PDCH_PENDING_MASK) == 0)
-			vty_out(vty, " as %s",
-				(ts->flags & TS_F_PDCH_ACTIVE)? "PDCH"
-							      : "TCH/F");
+			snprintf(buf, len, " as %s",
+				 (ts->flags & TS_F_PDCH_ACTIVE)? "PDCH"
+							       : "TCH/F");
 		else
-			vty_out(vty, " switching %s -> %s",
-				(ts->flags & TS_F_PDCH_ACTIVE)? "PDCH"
-							      : "TCH/F",
-				(ts->flags & TS_F_PDCH_ACT_PENDING)? "PDCH"
-								   : "TCH/F");
-		break;
+			snprintf(buf, len, " switching %s -> %s",
+				 (ts->flags & TS_F_PDCH_ACTIVE)? "PDCH"
+							       : "TCH/F",
+				 (ts->flags & TS_F_PDCH_ACT_PENDING)? "PDCH"
+								    : "TCH/F");
+		return buf;
 	default:
 		/* no dyn ts */
-		break;
+		return "";
 	}
 }
 
@@ -1977,6 +2648,7 @@ static void lchan_acch_top_state_dump(struct vty *vty, unsigned int indent,
 static void lchan_dump_full_vty(struct vty *vty, const struct gsm_lchan *lchan)
 {
 	struct in_addr ia;
+	char buf[64];
 
 	vty_out(vty, "BTS %u, TRX %u, Timeslot %u (%s), Lchan %u: Type %s%s",
 		lchan->ts->trx->bts->nr, lchan->ts->trx->nr, lchan->ts->nr,
@@ -1985,14 +2657,12 @@ static void lchan_dump_full_vty(struct vty *vty, const struct gsm_lchan *lchan)
 	/* show dyn TS details, if applicable */
 	switch (lchan->ts->pchan) {
 	case GSM_PCHAN_OSMO_DYN:
-		vty_out(vty, "  Osmocom Dyn TS:");
-		vty_out_dyn_ts_status(vty, lchan->ts);
-		vty_out(vty, VTY_NEWLINE);
+		vty_out(vty, "  Osmocom Dyn TS:%s%s",
+			dyn_ts_status(buf, sizeof(buf), lchan->ts), VTY_NEWLINE);
 		break;
 	case GSM_PCHAN_TCH_F_PDCH:
-		vty_out(vty, "  IPACC Dyn PDCH TS:");
-		vty_out_dyn_ts_status(vty, lchan->ts);
-		vty_out(vty, VTY_NEWLINE);
+		vty_out(vty, "  IPACC Dyn PDCH TS:%s%s",
+			dyn_ts_status(buf, sizeof(buf), lchan->ts), VTY_NEWLINE);
 		break;
 	default:
 		/* no dyn ts */
@@ -2049,8 +2719,8 @@ static void lchan_dump_full_vty(struct vty *vty, const struct gsm_lchan *lchan)
 		LAPDM_ESTABLISHED(lchan->lapdm_ch.lapdm_acch, DL_SAPI3) ? '3' : '-',
 		VTY_NEWLINE);
 #undef LAPDM_ESTABLISHED
-	vty_out(vty, "  Valid System Information: 0x%08x%s",
-		lchan->si.valid, VTY_NEWLINE);
+	vty_out(vty, "  Valid System Information: 0x%08x (overridden 0x%08x)%s",
+		lchan_sacch_si_valid(lchan), lchan->si.overridden, VTY_NEWLINE);
 	/* TODO: L1 SAPI (but those are BTS speific :( */
 	/* TODO: AMR bits */
 	vty_out(vty, "  MS Timing Offset: %d, propagation delay: %d symbols %s",
@@ -2060,6 +2730,23 @@ static void lchan_dump_full_vty(struct vty *vty, const struct gsm_lchan *lchan)
 			lchan->encr.alg_id-1, lchan_ciph_state_name(lchan->ciph_state),
 			lchan->ciph_ns, VTY_NEWLINE);
 	}
+	if (lchan->dl_tch_jb.max_depth > 0) {
+		const struct gsm_lchan_dl_tch_jb *jb = &lchan->dl_tch_jb;
+
+		vty_out(vty, "  DL TCH jitter buffer: %u/%u frames (max. %u), jitter %u samples%s",
+			lchan->dl_tch_queue_len, lchan_dl_tch_jb_target(lchan),
+			2 * jb->max_depth, jb->jitter16 >> 4, VTY_NEWLINE);
+		vty_out(vty, "   late %u, early %u, reorder %u, dup %u, underrun %u%s",
+			jb->stats.late, jb->stats.early, jb->stats.reorder,
+			jb->stats.dup, jb->stats.underrun, VTY_NEWLINE);
+	}
+	if (lchan->abis_ip.media) {
+		struct media_io_chan_stats st;
+
+		media_io_chan_stats(lchan->abis_ip.media, &st);
+		vty_out(vty, "  RTP media thread: queue %u (max. %u), received %u, lost %u, dropped %u%s",
+			st.depth, st.depth_max, st.packets, st.lost, st.drops, VTY_NEWLINE);
+	}
 	if (lchan->loopback)
 		vty_out(vty, "  RTP/PDCH Loopback Enabled%s", VTY_NEWLINE);
 	vty_out(vty, "  Radio Link Failure Counter 'S': %d%s", lchan->s, VTY_NEWLINE);
@@ -2084,14 +2771,15 @@ static void lchan_dump_full_vty(struct vty *vty, const struct gsm_lchan *lchan)
 static void lchan_dump_short_vty(struct vty *vty, const struct gsm_lchan *lchan)
 {
 	const struct gsm_meas_rep_unidir *mru = &lchan->meas.ul_res;
+	char buf[64];
 
-	vty_out(vty, "BTS %u, TRX %u, Timeslot %u (%s) %s",
+	vty_out(vty, "BTS %u, TRX %u, Timeslot %u (%s) %s%s"
+		", Lchan %u, Type %s, State %s - "
+		"RXL-FULL-ul: %4d dBm%s",
 		lchan->ts->trx->bts->nr, lchan->ts->trx->nr, lchan->ts->nr,
 		lchan->ts->vamos.is_shadow ? "shadow" : "primary",
-		gsm_pchan_name(lchan->ts->pchan));
-	vty_out_dyn_ts_status(vty, lchan->ts);
-	vty_out(vty, ", Lchan %u, Type %s, State %s - "
-		"RXL-FULL-ul: %4d dBm%s",
+		gsm_pchan_name(lchan->ts->pchan),
+		dyn_ts_status(buf, sizeof(buf), lchan->ts),
 		lchan->nr,
 		gsm_lchant_name(lchan->type), gsm_lchans_name(lchan->state),
 		rxlev2dbm(mru->full.rx_lev),
@@ -2401,6 +3089,370 @@ DEFUN(cfg_bts_no_gsmtap_sapi, cfg_bts_no_gsmtap_sapi_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_bts_gsmtap_sampling, cfg_bts_gsmtap_sampling_cmd,
+	"gsmtap-sampling <1-65535>",
+	"Send only every Nth GSMTAP Um message (default 1, i.e. all)\n"
+	"Sampling ratio (1 out of N messages is sent)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->gsmtap.sampling = atoi(argv[0]);
+	bts->gsmtap.sampling_cnt = 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_pcap_sapi_all, cfg_bts_pcap_sapi_all_cmd,
+	"pcap-capture-sapi (enable-all|disable-all)",
+	"Enable/disable capturing of UL/DL messages by 'bts N pcap-capture'\n"
+	"Enable all kinds of messages (all SAPI, default)\n"
+	"Disable all kinds of messages (all SAPI)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	if (argv[0][0] == 'e') {
+		bts->pcap.sapi_mask = UINT32_MAX;
+		bts->pcap.sapi_acch = 1;
+	} else {
+		bts->pcap.sapi_mask = 0x00;
+		bts->pcap.sapi_acch = 0;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_pcap_sapi, cfg_bts_pcap_sapi_cmd,
+	"HIDDEN", "HIDDEN")
+{
+	struct gsm_bts *bts = vty->index;
+	int sapi;
+
+	sapi = get_string_value(gsmtap_sapi_names, argv[0]);
+	OSMO_ASSERT(sapi >= 0);
+
+	if (sapi == GSMTAP_CHANNEL_ACCH)
+		bts->pcap.sapi_acch = 1;
+	else
+		bts->pcap.sapi_mask |= (1 << sapi);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_pcap_sapi, cfg_bts_no_pcap_sapi_cmd,
+	"HIDDEN", "HIDDEN")
+{
+	struct gsm_bts *bts = vty->index;
+	int sapi;
+
+	sapi = get_string_value(gsmtap_sapi_names, argv[0]);
+	OSMO_ASSERT(sapi >= 0);
+
+	if (sapi == GSMTAP_CHANNEL_ACCH)
+		bts->pcap.sapi_acch = 0;
+	else
+		bts->pcap.sapi_mask &= ~(1 << sapi);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_pcap_rtp, cfg_bts_pcap_rtp_cmd,
+	"pcap-capture-rtp",
+	"Also capture the RTP of the lchans by 'bts N pcap-capture'\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->pcap.rtp = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_pcap_rtp, cfg_bts_no_pcap_rtp_cmd,
+	"no pcap-capture-rtp",
+	NO_STR "Do not capture the RTP of the lchans (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->pcap.rtp = false;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_rsl_coalesce, cfg_bts_rsl_coalesce_cmd,
+	"rsl-coalesce <64-65535>",
+	"Coalesce the RSL messages sent within one TDMA frame into fewer TCP segments\n"
+	"Max. number of bytes per batch, the batch is flushed once reached\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rsl_coalesce_bytes = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_rsl_coalesce, cfg_bts_no_rsl_coalesce_cmd,
+	"no rsl-coalesce",
+	NO_STR "Send each RSL message without waiting for others (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	/* a pending batch is flushed on the next TDMA frame */
+	bts->rsl_coalesce_bytes = 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_memory_lock, cfg_bts_memory_lock_cmd,
+	"memory-lock [heap-reserve <0-1024>]",
+	"Lock the process memory into RAM (mlockall), avoiding page faults in the frame handling\n"
+	"Heap to pre-fault per TRX on TRX initialization\n"
+	"Heap size in MiB (default 4)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->mem_lock.enabled = true;
+	if (argc > 0)
+		bts->mem_lock.heap_reserve_mb = atoi(argv[0]);
+
+	/* the memory is locked once the configuration has been read */
+	if (vty->type != VTY_FILE && !bts->mem_lock.locked)
+		vty_out(vty, "%% memory-lock takes effect on restart%s", VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_memory_lock, cfg_bts_no_memory_lock_cmd,
+	"no memory-lock",
+	NO_STR "Do not lock the process memory into RAM (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->mem_lock.enabled = false;
+	if (bts->mem_lock.locked)
+		vty_out(vty, "%% The memory stays locked until restart%s", VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_memory_hugepages, cfg_bts_memory_hugepages_cmd,
+	"memory-hugepages <1-1024>",
+	"Allocate the scheduler structures and L1SAP/RSL msgbs from a pool of huge pages\n"
+	"Size of the pool in huge pages (2 MiB each)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->mem_hugepages = atoi(argv[0]);
+
+	/* the pool is set up once the configuration has been read */
+	if (vty->type != VTY_FILE)
+		vty_out(vty, "%% memory-hugepages takes effect on restart%s", VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_memory_hugepages, cfg_bts_no_memory_hugepages_cmd,
+	"no memory-hugepages",
+	NO_STR "Allocate from the heap (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->mem_hugepages = 0;
+	if (vty->type != VTY_FILE)
+		vty_out(vty, "%% memory-hugepages takes effect on restart%s", VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_vgcs_talker_window, cfg_bts_vgcs_talker_window_cmd,
+	"vgcs-talker-window <1-500>",
+	"Collect the talker RACHs on a VGCS channel for a while and grant the uplink "
+	"to the strongest one, instead of the first one\n"
+	"Length of the window in ms\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->vgcs_talker_window_ms = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_vgcs_talker_window, cfg_bts_no_vgcs_talker_window_cmd,
+	"no vgcs-talker-window",
+	NO_STR "Grant the uplink to the first talker (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->vgcs_talker_window_ms = 0;
+
+	return CMD_SUCCESS;
+}
+
+#define RACH_SHED_STR "RACH overload control: limit the CHAN RQD sent to the BSC\n"
+
+DEFUN(cfg_bts_rach_shed, cfg_bts_rach_shed_cmd,
+	"rach-shed rate <1-10000> [burst <1-1000>]",
+	RACH_SHED_STR
+	"Maximum rate of CHAN RQD (emergency calls are always sent)\n"
+	"CHAN RQD per second\n"
+	"Number of CHAN RQD which may exceed the rate at once\n"
+	"Number of CHAN RQD (default 10)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rach_shed.rate = atoi(argv[0]);
+	bts->rach_shed.burst = argc > 1 ? atoi(argv[1]) : BTS_RACH_SHED_BURST_DEFAULT;
+	bts->rach_shed.level = bts->rach_shed.burst * 1000;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_rach_shed, cfg_bts_no_rach_shed_cmd,
+	"no rach-shed",
+	NO_STR RACH_SHED_STR)
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rach_shed.rate = 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_rach_shed_reject, cfg_bts_rach_shed_reject_cmd,
+	"rach-shed reject wait-indication <0-255>",
+	RACH_SHED_STR
+	"Answer the shed RACH requests with an IMMEDIATE ASSIGNMENT REJECT\n"
+	"Wait Indication (T3122) of the IMMEDIATE ASSIGNMENT REJECT\n"
+	"T3122 in seconds\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rach_shed.wait_ind = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_rach_shed_reject, cfg_bts_no_rach_shed_reject_cmd,
+	"no rach-shed reject",
+	NO_STR RACH_SHED_STR
+	"Ignore the shed RACH requests, i.e. let the MS retry (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rach_shed.wait_ind = -1;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_rach_dedup, cfg_bts_rach_dedup_cmd,
+	"rach-dedup <1-1000>",
+	"Send only one CHAN RQD for the RACH requests with the same RA on the same "
+	"timeslot within a window\n"
+	"Length of the window in TDMA frames\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rach_dedup.window_fn = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_rach_dedup, cfg_bts_no_rach_dedup_cmd,
+	"no rach-dedup",
+	NO_STR "Send a CHAN RQD for every RACH request (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->rach_dedup.window_fn = 0;
+
+	return CMD_SUCCESS;
+}
+
+#define SCHED_STR "L1 scheduler (osmo-bts-trx, osmo-bts-virtual)\n"
+
+DEFUN(cfg_bts_sched_cpu_acct, cfg_bts_sched_cpu_acct_cmd,
+	"scheduler cpu-accounting",
+	SCHED_STR "Measure the time spent in the handlers of each timeslot and logical channel\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->sched_cpu_acct = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_sched_cpu_acct, cfg_bts_no_sched_cpu_acct_cmd,
+	"no scheduler cpu-accounting",
+	NO_STR SCHED_STR "Do not measure the time spent in the handlers (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->sched_cpu_acct = false;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_sched_cpu_load_ind, cfg_bts_sched_cpu_load_ind_cmd,
+	"scheduler cpu-load-indication",
+	SCHED_STR "Report the accounted CPU load per TRX and timeslot in the CCCH LOAD INDICATION "
+	"(Osmocom specific, requires 'scheduler cpu-accounting')\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->sched_cpu_load_ind = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_sched_cpu_load_ind, cfg_bts_no_sched_cpu_load_ind_cmd,
+	"no scheduler cpu-load-indication",
+	NO_STR SCHED_STR "Do not report the CPU load to the BSC (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	bts->sched_cpu_load_ind = false;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_stats_shm, cfg_bts_stats_shm_cmd,
+	"stats-shm NAME [interval <10-60000>]",
+	"Export a snapshot of all counters and stat items to a read-only shared memory region\n"
+	"Name of the shared memory object (see shm_open(3))\n"
+	"Interval between two snapshots\n" "Interval in ms (default 100)\n")
+{
+	struct gsm_bts *bts = vty->index;
+	unsigned int interval_ms = argc > 1 ? atoi(argv[1]) : STATS_SHM_INTERVAL_DEFAULT;
+
+	/* stop first, the old instance removes the object on its way out */
+	if (bts->stats_shm.inst != NULL)
+		stats_shm_stop(bts->stats_shm.inst);
+	osmo_talloc_replace_string(bts, &bts->stats_shm.name, argv[0]);
+	bts->stats_shm.interval_ms = interval_ms;
+
+	bts->stats_shm.inst = stats_shm_start(bts, argv[0], interval_ms);
+	if (bts->stats_shm.inst == NULL) {
+		vty_out(vty, "%% Failed to set up the shared memory region '%s'%s", argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_stats_shm, cfg_bts_no_stats_shm_cmd,
+	"no stats-shm",
+	NO_STR "Stop exporting the counters to shared memory (default)\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	if (bts->stats_shm.inst != NULL)
+		stats_shm_stop(bts->stats_shm.inst);
+	bts->stats_shm.inst = NULL;
+	if (bts->stats_shm.name != NULL)
+		talloc_free(bts->stats_shm.name);
+	bts->stats_shm.name = NULL;
+
+	return CMD_SUCCESS;
+}
+
 static struct cmd_node phy_node = {
 	PHY_NODE,
 	"%s(phy)# ",
@@ -2700,6 +3752,20 @@ int bts_vty_init(void *ctx)
 						NO_STR "Disable sending of UL/DL messages over GSMTAP\n",
 						"\n", "", 0);
 
+	cfg_bts_pcap_sapi_cmd.string = vty_cmd_string_from_valstr(ctx, gsmtap_sapi_names,
+						"pcap-capture-sapi (",
+						"|",")", VTY_DO_LOWER);
+	cfg_bts_pcap_sapi_cmd.doc = vty_cmd_string_from_valstr(ctx, gsmtap_sapi_names,
+						"Enable capturing of UL/DL messages by 'bts N pcap-capture'\n",
+						"\n", "", 0);
+
+	cfg_bts_no_pcap_sapi_cmd.string = vty_cmd_string_from_valstr(ctx, gsmtap_sapi_names,
+						"no pcap-capture-sapi (",
+						"|",")", VTY_DO_LOWER);
+	cfg_bts_no_pcap_sapi_cmd.doc = vty_cmd_string_from_valstr(ctx, gsmtap_sapi_names,
+						NO_STR "Disable capturing of UL/DL messages by 'bts N pcap-capture'\n",
+						"\n", "", 0);
+
 	logging_fltr_l1_sapi_cmd.string = vty_cmd_string_from_valstr(ctx, l1sap_common_sapi_names,
 						"logging filter l1-sapi (",
 						"|", ")", VTY_DO_LOWER);
@@ -2720,6 +3786,16 @@ int bts_vty_init(void *ctx)
 	install_element_ve(&show_lchan_cmd);
 	install_element_ve(&show_lchan_summary_cmd);
 	install_element_ve(&show_bts_gprs_cmd);
+	install_element_ve(&show_bts_osmux_cmd);
+	install_element_ve(&show_bts_pwr_ctrl_log_cmd);
+	install_element_ve(&show_bts_paging_cmd);
+	install_element_ve(&show_bts_si_sched_cmd);
+	install_element_ve(&show_bts_rsl_coalesce_cmd);
+	install_element_ve(&show_bts_proc_lat_cmd);
+	install_element_ve(&show_rsl_stats_cmd);
+	install_element_ve(&show_rsl_msgb_pool_cmd);
+	install_element_ve(&show_l1sap_msgb_pool_cmd);
+	install_element_ve(&show_pcu_msgb_pool_cmd);
 
 	install_element_ve(&logging_fltr_l1_sapi_cmd);
 	install_element_ve(&no_logging_fltr_l1_sapi_cmd);
@@ -2735,9 +3811,13 @@ int bts_vty_init(void *ctx)
 	install_element(BTS_NODE, &cfg_bts_no_oml_ip_cmd);
 	install_element(BTS_NODE, &cfg_bts_rtp_bind_ip_cmd);
 	install_element(BTS_NODE, &cfg_bts_rtp_jitbuf_cmd);
+	install_element(BTS_NODE, &cfg_bts_rtp_tch_jitbuf_cmd);
 	install_element(BTS_NODE, &cfg_bts_rtp_port_range_cmd);
 	install_element(BTS_NODE, &cfg_bts_rtp_ip_dscp_cmd);
 	install_element(BTS_NODE, &cfg_bts_rtp_priority_cmd);
+	install_element(BTS_NODE, &cfg_bts_rtp_socket_pool_cmd);
+	install_element(BTS_NODE, &cfg_bts_rtp_media_thread_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_rtp_media_thread_cmd);
 	install_element(BTS_NODE, &cfg_bts_rtp_cont_stream_cmd);
 	install_element(BTS_NODE, &cfg_bts_no_rtp_cont_stream_cmd);
 	install_element(BTS_NODE, &cfg_bts_rtp_int_ul_ecu_cmd);
@@ -2758,7 +3838,10 @@ int bts_vty_init(void *ctx)
 	install_element(BTS_NODE, &cfg_bts_min_qual_norm_cmd);
 	install_element(BTS_NODE, &cfg_bts_max_ber_rach_cmd);
 	install_element(BTS_NODE, &cfg_bts_pcu_sock_path_cmd);
+	install_element(BTS_NODE, &cfg_bts_pcu_sock_shard_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_pcu_sock_shard_cmd);
 	install_element(BTS_NODE, &cfg_bts_pcu_sock_ql_cmd);
+	install_element(BTS_NODE, &cfg_bts_pcu_time_ind_interval_cmd);
 	install_element(BTS_NODE, &cfg_bts_supp_meas_toa256_cmd);
 	install_element(BTS_NODE, &cfg_bts_no_supp_meas_toa256_cmd);
 	install_element(BTS_NODE, &cfg_bts_smscb_max_qlen_cmd);
@@ -2772,6 +3855,32 @@ int bts_vty_init(void *ctx)
 	install_element(BTS_NODE, &cfg_bts_gsmtap_sapi_all_cmd);
 	install_element(BTS_NODE, &cfg_bts_gsmtap_sapi_cmd);
 	install_element(BTS_NODE, &cfg_bts_no_gsmtap_sapi_cmd);
+	install_element(BTS_NODE, &cfg_bts_gsmtap_sampling_cmd);
+	install_element(BTS_NODE, &cfg_bts_pcap_sapi_all_cmd);
+	install_element(BTS_NODE, &cfg_bts_pcap_sapi_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_pcap_sapi_cmd);
+	install_element(BTS_NODE, &cfg_bts_pcap_rtp_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_pcap_rtp_cmd);
+	install_element(BTS_NODE, &cfg_bts_rsl_coalesce_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_rsl_coalesce_cmd);
+	install_element(BTS_NODE, &cfg_bts_memory_lock_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_memory_lock_cmd);
+	install_element(BTS_NODE, &cfg_bts_memory_hugepages_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_memory_hugepages_cmd);
+	install_element(BTS_NODE, &cfg_bts_vgcs_talker_window_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_vgcs_talker_window_cmd);
+	install_element(BTS_NODE, &cfg_bts_rach_shed_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_rach_shed_cmd);
+	install_element(BTS_NODE, &cfg_bts_rach_shed_reject_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_rach_shed_reject_cmd);
+	install_element(BTS_NODE, &cfg_bts_rach_dedup_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_rach_dedup_cmd);
+	install_element(BTS_NODE, &cfg_bts_sched_cpu_acct_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_sched_cpu_acct_cmd);
+	install_element(BTS_NODE, &cfg_bts_sched_cpu_load_ind_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_sched_cpu_load_ind_cmd);
+	install_element(BTS_NODE, &cfg_bts_stats_shm_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_stats_shm_cmd);
 
 	/* Osmux Node */
 	install_element(BTS_NODE, &cfg_bts_osmux_cmd);
@@ -2783,6 +3892,7 @@ int bts_vty_init(void *ctx)
 	install_element(OSMUX_NODE, &cfg_bts_osmux_batch_factor_cmd);
 	install_element(OSMUX_NODE, &cfg_bts_osmux_batch_size_cmd);
 	install_element(OSMUX_NODE, &cfg_bts_osmux_dummy_padding_cmd);
+	install_element(OSMUX_NODE, &cfg_bts_osmux_batch_flush_cmd);
 
 	/* add and link to TRX config node */
 	install_element(BTS_NODE, &cfg_bts_trx_cmd);
@@ -2792,8 +3902,10 @@ int bts_vty_init(void *ctx)
 	install_element(TRX_NODE, &cfg_trx_pr_max_initial_cmd);
 	install_element(TRX_NODE, &cfg_trx_pr_step_size_cmd);
 	install_element(TRX_NODE, &cfg_trx_pr_step_interval_cmd);
+	install_element(TRX_NODE, &cfg_trx_pr_step_interval_ms_cmd);
 	install_element(TRX_NODE, &cfg_trx_ms_power_control_cmd);
 	install_element(TRX_NODE, &cfg_ta_ctrl_interval_cmd);
+	install_element(TRX_NODE, &cfg_trx_pcu_sock_shard_cmd);
 	install_element(TRX_NODE, &cfg_trx_phy_cmd);
 
 	install_element(ENABLE_NODE, &bts_t_t_l_jitter_buf_cmd);
@@ -2804,6 +3916,8 @@ int bts_vty_init(void *ctx)
 	install_element(ENABLE_NODE, &test_send_failure_event_report_cmd);
 	install_element(ENABLE_NODE, &radio_link_timeout_cmd);
 	install_element(ENABLE_NODE, &bts_c0_power_red_cmd);
+	install_element(ENABLE_NODE, &bts_pcap_capture_start_cmd);
+	install_element(ENABLE_NODE, &bts_pcap_capture_stop_cmd);
 
 	install_element(CONFIG_NODE, &cfg_phy_cmd);
 	install_node(&phy_node, config_write_phy);
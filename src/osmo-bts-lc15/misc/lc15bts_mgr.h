@@ -7,9 +7,12 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/timer.h>
 
+#include <osmo-bts/mgr_sensor.h>
+
 #include <stdint.h>
 
 #define LC15BTS_SENSOR_TIMER_DURATION			60
+#define LC15BTS_SENSOR_TIMER_FAST_DURATION		10
 #define LC15BTS_PREVENT_TIMER_DURATION			15 * 60
 #define LC15BTS_PREVENT_TIMER_SHORT_DURATION		5 * 60
 #define LC15BTS_PREVENT_TIMER_NONE			0
@@ -84,13 +87,6 @@ enum {
 	SENSOR_ACT_NORM_BTS_SRV_ON=	0x10,
 };
 
-enum lc15bts_sensor_state {
-	STATE_NORMAL,		/* Everything is fine */
-	STATE_WARNING_HYST,	/* Go back to normal next? */
-	STATE_WARNING,		/* We are above the warning threshold */
-	STATE_CRITICAL,		/* We have an issue. Wait for below warning */
-};
-
 enum lc15bts_leds_name {
 	LC15BTS_LED_RED = 0,
 	LC15BTS_LED_GREEN,
@@ -234,7 +230,7 @@ struct lc15bts_mgr_instance {
 		int action_crit;
 		int action_comb;
 
-		enum lc15bts_sensor_state state;
+		enum mgr_sensor_state state;
 	} state;
 
 	struct {
@@ -411,7 +407,7 @@ int lc15bts_mgr_vty_init(void);
 int lc15bts_mgr_parse_config(struct lc15bts_mgr_instance *mgr);
 int lc15bts_mgr_nl_init(void);
 int lc15bts_mgr_sensor_init(struct lc15bts_mgr_instance *mgr);
-const char *lc15bts_mgr_sensor_get_state(enum lc15bts_sensor_state state);
+const char *lc15bts_mgr_sensor_get_state(enum mgr_sensor_state state);
 
 int lc15bts_mgr_calib_init(struct lc15bts_mgr_instance *mgr);
 int lc15bts_mgr_control_init(struct lc15bts_mgr_instance *mgr);
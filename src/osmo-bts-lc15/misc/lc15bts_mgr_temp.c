@@ -38,52 +38,11 @@
 #include <osmocom/core/linuxlist.h>
 
 struct lc15bts_mgr_instance *s_mgr;
-static struct osmo_timer_list sensor_ctrl_timer;
+static struct mgr_sensor_sched sensor_sched;
 
-static const struct value_string state_names[] = {
-	{ STATE_NORMAL,			"NORMAL" },
-	{ STATE_WARNING_HYST,		"WARNING (HYST)" },
-	{ STATE_WARNING,		"WARNING" },
-	{ STATE_CRITICAL,		"CRITICAL" },
-	{ 0, NULL }
-};
-
-const char *lc15bts_mgr_sensor_get_state(enum lc15bts_sensor_state state)
+const char *lc15bts_mgr_sensor_get_state(enum mgr_sensor_state state)
 {
-	return get_value_string(state_names, state);
-}
-
-static int next_state(enum lc15bts_sensor_state current_state, int critical, int warning)
-{
-	int next_state = -1;
-	switch (current_state) {
-	case STATE_NORMAL:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (warning)
-			next_state = STATE_WARNING;
-		break;
-	case STATE_WARNING_HYST:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (warning)
-			next_state = STATE_WARNING;
-		else
-			next_state = STATE_NORMAL;
-		break;
-	case STATE_WARNING:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (!warning)
-			next_state = STATE_WARNING_HYST;
-		break;
-	case STATE_CRITICAL:
-		if (!critical && !warning)
-			next_state = STATE_WARNING;
-		break;
-	};
-
-	return next_state;
+	return mgr_sensor_state_name(state);
 }
 
 static void handle_normal_actions(int actions)
@@ -184,15 +143,15 @@ static void execute_critical_act(struct lc15bts_mgr_instance *manager)
 static void lc15bts_mgr_sensor_handle(struct lc15bts_mgr_instance *manager,
 			int critical, int warning)
 {
-	int new_state = next_state(manager->state.state, critical, warning);
+	int new_state = mgr_sensor_next_state(manager->state.state, critical, warning);
 
 	/* Nothing changed */
 	if (new_state < 0)
 		return;
 
 	LOGP(DTEMP, LOGL_NOTICE, "Moving from state %s to %s.\n",
-		get_value_string(state_names, manager->state.state),
-		get_value_string(state_names, new_state));
+		mgr_sensor_state_name(manager->state.state),
+		mgr_sensor_state_name(new_state));
 	manager->state.state = new_state;
 	switch (manager->state.state) {
 	case STATE_NORMAL:
@@ -210,169 +169,58 @@ static void lc15bts_mgr_sensor_handle(struct lc15bts_mgr_instance *manager,
 	};
 } 
 
-static void sensor_ctrl_check(struct lc15bts_mgr_instance *mgr)
+/* Returns true if the sensors should be checked at the fast rate */
+static bool sensor_ctrl_check(void *_data)
 {
-	int rc;
-	int temp = 0;
-	int warn_thresh_passed = 0;
-	int crit_thresh_passed = 0;
+	struct lc15bts_mgr_instance *mgr = _data;
+	const struct {
+		enum lc15bts_temp_sensor sensor;
+		const char *name;
+		const struct lc15bts_temp_limit *limit;
+	} temps[] = {
+		{ LC15BTS_TEMP_SUPPLY,	"supply",	&mgr->temp.supply_temp_limit },
+		{ LC15BTS_TEMP_SOC,	"SoC",		&mgr->temp.soc_temp_limit },
+		{ LC15BTS_TEMP_FPGA,	"FPGA",		&mgr->temp.fpga_temp_limit },
+		{ LC15BTS_TEMP_RMSDET,	"RMS detector",	&mgr->temp.rmsdet_temp_limit },
+		{ LC15BTS_TEMP_OCXO,	"OCXO",		&mgr->temp.ocxo_temp_limit },
+		{ LC15BTS_TEMP_TX0,	"TX #0",	&mgr->temp.tx0_temp_limit },
+		{ LC15BTS_TEMP_TX1,	"TX #1",	&mgr->temp.tx1_temp_limit },
+		{ LC15BTS_TEMP_PA0,	"PA #0",	&mgr->temp.pa0_temp_limit },
+		{ LC15BTS_TEMP_PA1,	"PA #1",	&mgr->temp.pa1_temp_limit },
+	};
+	struct mgr_sensor_result res = { 0 };
+	unsigned int i;
+	int rc, temp;
 
 	LOGP(DTEMP, LOGL_DEBUG, "Going to check the temperature.\n");
 
-	/* Read the current supply temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_SUPPLY, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the supply temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.supply_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.supply_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "Supply temperature is: %d\n", temp);
-	}
-
-	/* Read the current SoC temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_SOC, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the SoC temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.soc_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.soc_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "SoC temperature is: %d\n", temp);
-	}
-
-	/* Read the current fpga temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_FPGA, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the fpga temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.fpga_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.fpga_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "FPGA temperature is: %d\n", temp);
-	}
-
-	/* Read the current RMS detector temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_RMSDET, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the RMS detector temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.rmsdet_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.rmsdet_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "RMS detector temperature is: %d\n", temp);
-	}
-
-	/* Read the current OCXO temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_OCXO, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the OCXO temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.ocxo_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.ocxo_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "OCXO temperature is: %d\n", temp);
-	}
-
-	/* Read the current TX #0 temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_TX0, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the TX #0 temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.tx0_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.tx0_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "TX #0 temperature is: %d\n", temp);
-	}
-
-	/* Read the current TX #1 temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_TX1, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the TX #1 temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.tx1_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.tx1_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "TX #1 temperature is: %d\n", temp);
-	}
-
-	/* Read the current PA #0 temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_PA0, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the PA #0 temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
-		temp = temp / 1000;
-		if (temp > mgr->temp.pa0_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.pa0_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "PA #0 temperature is: %d\n", temp);
-	}
-
-	/* Read the current PA #1 temperature */
-	rc = lc15bts_temp_get(LC15BTS_TEMP_PA1, &temp);
-	if (rc < 0) {
-		LOGP(DTEMP, LOGL_ERROR,
-			"Failed to read the PA #1 temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
-	} else {
+	for (i = 0; i < ARRAY_SIZE(temps); i++) {
+		rc = lc15bts_temp_get(temps[i].sensor, &temp);
+		if (rc < 0) {
+			LOGP(DTEMP, LOGL_ERROR,
+				"Failed to read the %s temperature. rc=%d\n", temps[i].name, rc);
+			res.warning = res.critical = 1;
+			continue;
+		}
 		temp = temp / 1000;
-		if (temp > mgr->temp.pa1_temp_limit.thresh_warn_max)
-			warn_thresh_passed = 1;
-		if (temp > mgr->temp.pa1_temp_limit.thresh_crit_max)
-			crit_thresh_passed = 1;
-		LOGP(DTEMP, LOGL_DEBUG, "PA #1 temperature is: %d\n", temp);
+		mgr_sensor_eval(&res, temp, temps[i].limit->thresh_warn_max,
+				temps[i].limit->thresh_crit_max);
+		LOGP(DTEMP, LOGL_DEBUG, "%s temperature is: %d\n", temps[i].name, temp);
 	}
 
-	lc15bts_mgr_sensor_handle(mgr, crit_thresh_passed, warn_thresh_passed);
-}
+	lc15bts_mgr_sensor_handle(mgr, res.critical, res.warning);
 
-static void sensor_ctrl_check_cb(void *_data)
-{
-	struct lc15bts_mgr_instance *mgr = _data;
-	sensor_ctrl_check(mgr);
-	/* Check every minute? XXX make it configurable! */
-	osmo_timer_schedule(&sensor_ctrl_timer, LC15BTS_SENSOR_TIMER_DURATION, 0);
-	LOGP(DTEMP, LOGL_DEBUG,"Check sensors timer expired\n");
 	/* TODO: do we want to notify if some sensors could not be read? */
 	lc15bts_swd_event(mgr, SWD_CHECK_TEMP_SENSOR);
+
+	return res.near || mgr->state.state != STATE_NORMAL;
 }
 
 int lc15bts_mgr_sensor_init(struct lc15bts_mgr_instance *mgr)
 {
 	s_mgr = mgr;
-	sensor_ctrl_timer.cb = sensor_ctrl_check_cb;
-	sensor_ctrl_timer.data = s_mgr;
-	sensor_ctrl_check_cb(s_mgr);
+	mgr_sensor_sched_init(&sensor_sched, LC15BTS_SENSOR_TIMER_DURATION,
+			      LC15BTS_SENSOR_TIMER_FAST_DURATION, DTEMP, sensor_ctrl_check, s_mgr);
+	mgr_sensor_sched_start(&sensor_sched);
 	return 0;
 }
@@ -43,11 +43,15 @@ struct calib_send_state {
 	int last_file_idx;
 };
 
+/* max. number of primitives read per readv() */
+#define L1_READV_MAX 8
+
 struct oc2gl1_hdl {
 	struct gsm_time gsm_time;
 	HANDLE hLayer1;				/* handle to the L1 instance in the DSP */
 	uint32_t dsp_trace_f;			/* currently operational DSP trace flags */
 	struct llist_head wlc_list;
+	struct osmo_timer_list wlc_timer;	/* timeout of the oldest entry of wlc_list */
 	struct llist_head alarm_list;	/* list of sent alarms */
 
 	struct phy_instance *phy_inst;
@@ -57,6 +61,8 @@ struct oc2gl1_hdl {
 
 	struct osmo_fd read_ofd[_NUM_MQ_READ];	/* osmo file descriptors */
 	struct osmo_wqueue write_q[_NUM_MQ_WRITE];
+	/* msgbs for the next readv(), kept if not filled by the previous one */
+	struct msgb *read_msg[_NUM_MQ_READ][L1_READV_MAX];
 
 	struct {
 		/* from DSP/FPGA after L1 Init */
@@ -82,6 +82,9 @@ static const char *wr_devnames[] = {
 osmo_static_assert(sizeof(GsmL1_Prim_t) + 128 <= OC2GBTS_PRIM_SIZE, l1_prim)
 osmo_static_assert(sizeof(Oc2g_Prim_t) + 128 <= OC2GBTS_PRIM_SIZE, super_prim)
 
+/* max. length of the write queues, all of which can be written per writev() */
+#define L1_WQUEUE_LEN 10
+
 static int wqueue_vector_cb(struct osmo_fd *fd, unsigned int what)
 {
 	struct osmo_wqueue *queue;
@@ -95,7 +98,7 @@ static int wqueue_vector_cb(struct osmo_fd *fd, unsigned int what)
 		queue->except_cb(fd);
 
 	if (what & OSMO_FD_WRITE) {
-		struct iovec iov[5];
+		struct iovec iov[L1_WQUEUE_LEN];
 		struct msgb *msg, *tmp;
 		int written, count = 0;
 
@@ -189,39 +192,50 @@ static int read_dispatch_one(struct oc2gl1_hdl *fl1h, struct msgb *msg, int queu
 
 static int l1if_fd_cb(struct osmo_fd *ofd, unsigned int what)
 {
+	struct oc2gl1_hdl *hdl = ofd->data;
 	int i, rc;
 
 	const uint32_t prim_size = prim_size_for_queue(ofd->priv_nr);
 	uint32_t count;
 
-	struct iovec iov[3];
+	struct msgb **spare = hdl->read_msg[ofd->priv_nr];
+	struct iovec iov[L1_READV_MAX];
 	struct msgb *msg[ARRAY_SIZE(iov)];
 
+	/* the msgbs not filled by the previous readv() are reused */
 	for (i = 0; i < ARRAY_SIZE(iov); ++i) {
-		msg[i] = msgb_alloc_headroom(prim_size + 128, 128, "1l_fd");
-		msg[i]->l1h = msg[i]->data;
+		if (!spare[i]) {
+			spare[i] = msgb_alloc_headroom(prim_size + 128, 128, "1l_fd");
+			spare[i]->l1h = spare[i]->data;
+		}
 
-		iov[i].iov_base = msg[i]->l1h;
-		iov[i].iov_len = msgb_tailroom(msg[i]);
+		iov[i].iov_base = spare[i]->l1h;
+		iov[i].iov_len = msgb_tailroom(spare[i]);
 	}
 
 	rc = readv(ofd->fd, iov, ARRAY_SIZE(iov));
 	if (rc < 0) {
 		LOGP(DL1C, LOGL_ERROR, "failed to read from fd: %s\n", strerror(errno));
-		/* N. B: we do not abort to let the cycle below cleanup allocated memory properly,
-		   the return value is ignored by the caller anyway.
-		   TODO: use libexplain's explain_readv() to provide detailed error description */
+		/* TODO: use libexplain's explain_readv() to provide detailed error description */
 		count = 0;
 	} else
 		count = rc / prim_size;
 
+	/* take the filled msgbs first, the dispatching may close the transport */
 	for (i = 0; i < count; ++i) {
+		msg[i] = spare[i];
+		spare[i] = NULL;
 		msgb_put(msg[i], prim_size);
-		read_dispatch_one(ofd->data, msg[i], ofd->priv_nr);
 	}
 
-	for (i = count; i < ARRAY_SIZE(iov); ++i)
-		msgb_free(msg[i]);
+	/* keep the spare msgbs contiguous from the start */
+	for (i = count; i < ARRAY_SIZE(iov); ++i) {
+		spare[i - count] = spare[i];
+		spare[i] = NULL;
+	}
+
+	for (i = 0; i < count; ++i)
+		read_dispatch_one(hdl, msg[i], ofd->priv_nr);
 
 	return 1;
 }
@@ -282,7 +296,7 @@ int l1if_transport_open(int q, struct oc2gl1_hdl *hdl)
 			buf, strerror(errno));
 		goto out_read;
 	}
-	osmo_wqueue_init(wq, 10);
+	osmo_wqueue_init(wq, L1_WQUEUE_LEN);
 	wq->write_cb = l1fd_write_cb;
 	osmo_fd_setup(write_ofd, rc, OSMO_FD_WRITE, wqueue_vector_cb, hdl, q);
 	rc = osmo_fd_register(write_ofd);
@@ -305,11 +319,19 @@ int l1if_transport_close(int q, struct oc2gl1_hdl *hdl)
 {
 	struct osmo_fd *read_ofd = &hdl->read_ofd[q];
 	struct osmo_fd *write_ofd = &hdl->write_q[q].bfd;
+	unsigned int i;
 
 	osmo_fd_unregister(read_ofd);
 	close(read_ofd->fd);
 	read_ofd->fd = -1;
 
+	for (i = 0; i < ARRAY_SIZE(hdl->read_msg[q]); i++) {
+		if (hdl->read_msg[q][i]) {
+			msgb_free(hdl->read_msg[q][i]);
+			hdl->read_msg[q][i] = NULL;
+		}
+	}
+
 	osmo_fd_unregister(write_ofd);
 	close(write_ofd->fd);
 	write_ofd->fd = -1;
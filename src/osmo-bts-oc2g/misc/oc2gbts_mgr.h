@@ -7,10 +7,13 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/timer.h>
 
+#include <osmo-bts/mgr_sensor.h>
+
 #include <stdint.h>
 #include <gps.h>
 
 #define OC2GBTS_SENSOR_TIMER_DURATION			60
+#define OC2GBTS_SENSOR_TIMER_FAST_DURATION		10
 #define OC2GBTS_PREVENT_TIMER_DURATION			15 * 60
 #define OC2GBTS_PREVENT_TIMER_SHORT_DURATION		5 * 60
 #define OC2GBTS_PREVENT_TIMER_NONE			0
@@ -81,13 +84,6 @@ enum {
 	SENSOR_ACT_NORM_BTS_SRV_ON=	0x10,
 };
 
-enum oc2gbts_sensor_state {
-	STATE_NORMAL,		/* Everything is fine */
-	STATE_WARNING_HYST,	/* Go back to normal next? */
-	STATE_WARNING,		/* We are above the warning threshold */
-	STATE_CRITICAL,		/* We have an issue. Wait for below warning */
-};
-
 enum oc2gbts_leds_name {
 	OC2GBTS_LED_RED = 0,
 	OC2GBTS_LED_GREEN,
@@ -228,7 +224,7 @@ struct oc2gbts_mgr_instance {
 		int action_crit;
 		int action_comb;
 
-		enum oc2gbts_sensor_state state;
+		enum mgr_sensor_state state;
 	} state;
 
 	struct {
@@ -384,7 +380,7 @@ int oc2gbts_mgr_vty_init(void);
 int oc2gbts_mgr_parse_config(struct oc2gbts_mgr_instance *mgr);
 int oc2gbts_mgr_nl_init(void);
 int oc2gbts_mgr_sensor_init(struct oc2gbts_mgr_instance *mgr);
-const char *oc2gbts_mgr_sensor_get_state(enum oc2gbts_sensor_state state);
+const char *oc2gbts_mgr_sensor_get_state(enum mgr_sensor_state state);
 
 int oc2gbts_mgr_calib_init(struct oc2gbts_mgr_instance *mgr);
 int oc2gbts_mgr_control_init(struct oc2gbts_mgr_instance *mgr);
@@ -39,55 +39,11 @@
 #include <osmocom/core/linuxlist.h>
 
 struct oc2gbts_mgr_instance *s_mgr;
-static struct osmo_timer_list sensor_ctrl_timer;
+static struct mgr_sensor_sched sensor_sched;
 
-static const struct value_string state_names[] = {
-	{ STATE_NORMAL,			"NORMAL" },
-	{ STATE_WARNING_HYST,	"WARNING (HYST)" },
-	{ STATE_WARNING,		"WARNING" },
-	{ STATE_CRITICAL,		"CRITICAL" },
-	{ 0, NULL }
-};
-
-/* private function prototype */
-static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr);
-
-const char *oc2gbts_mgr_sensor_get_state(enum oc2gbts_sensor_state state)
+const char *oc2gbts_mgr_sensor_get_state(enum mgr_sensor_state state)
 {
-	return get_value_string(state_names, state);
-}
-
-static int next_state(enum oc2gbts_sensor_state current_state, int critical, int warning)
-{
-	int next_state = -1;
-	switch (current_state) {
-	case STATE_NORMAL:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (warning)
-			next_state = STATE_WARNING;
-		break;
-	case STATE_WARNING_HYST:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (warning)
-			next_state = STATE_WARNING;
-		else
-			next_state = STATE_NORMAL;
-		break;
-	case STATE_WARNING:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (!warning)
-			next_state = STATE_WARNING_HYST;
-		break;
-	case STATE_CRITICAL:
-		if (!critical && !warning)
-			next_state = STATE_WARNING;
-		break;
-	};
-
-	return next_state;
+	return mgr_sensor_state_name(state);
 }
 
 static void handle_normal_actions(int actions)
@@ -396,8 +352,7 @@ static void preventive_timer_cb(void *_data)
 	}
 
 	/* restart check sensor timer */
-	osmo_timer_del(&sensor_ctrl_timer);
-	osmo_timer_schedule(&sensor_ctrl_timer, OC2GBTS_SENSOR_TIMER_DURATION, 0);
+	mgr_sensor_sched_rearm(&sensor_sched);
 
 	return;
 
@@ -467,7 +422,7 @@ static void execute_critical_act(struct oc2gbts_mgr_instance *manager)
 static void oc2gbts_mgr_sensor_handle(struct oc2gbts_mgr_instance *manager,
 			int critical, int warning)
 {
-	int new_state = next_state(manager->state.state, critical, warning);
+	int new_state = mgr_sensor_next_state(manager->state.state, critical, warning);
 
 	/* run preventive action if it is possible */
 	execute_preventive_act(manager);
@@ -476,8 +431,8 @@ static void oc2gbts_mgr_sensor_handle(struct oc2gbts_mgr_instance *manager,
 	if (new_state < 0)
 		return;
 	LOGP(DTEMP, LOGL_INFO, "Moving from state %s to %s.\n",
-		get_value_string(state_names, manager->state.state),
-		get_value_string(state_names, new_state));
+		mgr_sensor_state_name(manager->state.state),
+		mgr_sensor_state_name(new_state));
 	manager->state.state = new_state;
 	switch (manager->state.state) {
 	case STATE_NORMAL:
@@ -532,13 +487,15 @@ static void schedule_preventive_action(struct oc2gbts_mgr_instance *mgr, int act
 	return;
 }
 
-static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
+/* Returns true if the sensors should be checked at the fast rate */
+static bool sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 {
 	int rc;
 	int temp, volt, vswr, power = 0;
 	int warn_thresh_passed = 0;
 	int crit_thresh_passed = 0;
 	int action = 0;
+	bool near = false;
 
 	LOGP(DTEMP, LOGL_INFO, "Going to check the temperature.\n");
 
@@ -550,6 +507,8 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 		warn_thresh_passed = crit_thresh_passed = 1;
 	} else {
 		temp = temp / 1000;
+		if (temp > mgr->temp.supply_temp_limit.thresh_warn_max - MGR_SENSOR_NEAR_MARGIN)
+			near = true;
 		if (temp > mgr->temp.supply_temp_limit.thresh_warn_max) {
 			LOGP(DTEMP, LOGL_NOTICE, "System has reached warning because supply temperature is over %d\n", mgr->temp.supply_temp_limit.thresh_warn_max);
 			warn_thresh_passed = 1;
@@ -584,6 +543,8 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 		warn_thresh_passed = crit_thresh_passed = 1;
 	} else {
 		temp = temp / 1000;
+		if (temp > mgr->temp.soc_temp_limit.thresh_warn_max - MGR_SENSOR_NEAR_MARGIN)
+			near = true;
 		if (temp > mgr->temp.soc_temp_limit.thresh_warn_max) {
 			LOGP(DTEMP, LOGL_NOTICE, "System has reached warning because SoC temperature is over %d\n", mgr->temp.soc_temp_limit.thresh_warn_max);
 			warn_thresh_passed = 1;
@@ -618,6 +579,8 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 		warn_thresh_passed = crit_thresh_passed = 1;
 	} else {
 		temp = temp / 1000;
+		if (temp > mgr->temp.fpga_temp_limit.thresh_warn_max - MGR_SENSOR_NEAR_MARGIN)
+			near = true;
 		if (temp > mgr->temp.fpga_temp_limit.thresh_warn_max) {
 			LOGP(DTEMP, LOGL_NOTICE, "System has reached warning because fpga temperature is over %d\n", mgr->temp.fpga_temp_limit.thresh_warn_max);
 			warn_thresh_passed = 1;
@@ -653,6 +616,8 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 			warn_thresh_passed = crit_thresh_passed = 1;
 		} else {
 			temp = temp / 1000;
+			if (temp > mgr->temp.rmsdet_temp_limit.thresh_warn_max - MGR_SENSOR_NEAR_MARGIN)
+				near = true;
 			if (temp > mgr->temp.rmsdet_temp_limit.thresh_warn_max) {
 				LOGP(DTEMP, LOGL_NOTICE, "System has reached warning because RMS detector temperature is over %d\n", mgr->temp.rmsdet_temp_limit.thresh_warn_max);
 				warn_thresh_passed = 1;
@@ -688,6 +653,8 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 		warn_thresh_passed = crit_thresh_passed = 1;
 	} else {
 		temp = temp / 1000;
+		if (temp > mgr->temp.ocxo_temp_limit.thresh_warn_max - MGR_SENSOR_NEAR_MARGIN)
+			near = true;
 		if (temp > mgr->temp.ocxo_temp_limit.thresh_warn_max) {
 			LOGP(DTEMP, LOGL_NOTICE, "System has reached warning because OCXO temperature is over %d\n", mgr->temp.ocxo_temp_limit.thresh_warn_max);
 			warn_thresh_passed = 1;
@@ -722,6 +689,8 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 		warn_thresh_passed = crit_thresh_passed = 1;
 	} else {
 		temp = temp / 1000;
+		if (temp > mgr->temp.tx_temp_limit.thresh_warn_max - MGR_SENSOR_NEAR_MARGIN)
+			near = true;
 		if (temp > mgr->temp.tx_temp_limit.thresh_warn_max) {
 			LOGP(DTEMP, LOGL_NOTICE, "System has reached warning because TX temperature is over %d\n", mgr->temp.tx_temp_limit.thresh_warn_max);
 			warn_thresh_passed = 1;
@@ -757,6 +726,8 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 			warn_thresh_passed = crit_thresh_passed = 1;
 		} else {
 			temp = temp / 1000;
+			if (temp > mgr->temp.pa_temp_limit.thresh_warn_max - MGR_SENSOR_NEAR_MARGIN)
+				near = true;
 			if (temp > mgr->temp.pa_temp_limit.thresh_warn_max) {
 				LOGP(DTEMP, LOGL_NOTICE, "System has reached warning because PA temperature because is over %d\n", mgr->temp.pa_temp_limit.thresh_warn_max);
 				warn_thresh_passed = 1;
@@ -947,17 +918,18 @@ static void sensor_ctrl_check(struct oc2gbts_mgr_instance *mgr)
 
 	select_led_pattern(mgr);
 	oc2gbts_mgr_sensor_handle(mgr, crit_thresh_passed, warn_thresh_passed);
+
+	return near || mgr->state.state != STATE_NORMAL;
 }
 
-static void sensor_ctrl_check_cb(void *_data)
+static bool sensor_ctrl_check_cb(void *_data)
 {
 	struct oc2gbts_mgr_instance *mgr = _data;
-	sensor_ctrl_check(mgr);
-	/* Check every minute? XXX make it configurable! */
-	osmo_timer_schedule(&sensor_ctrl_timer, OC2GBTS_SENSOR_TIMER_DURATION, 0);
-	LOGP(DTEMP, LOGL_DEBUG,"Check sensors timer expired\n");
+	bool fast = sensor_ctrl_check(mgr);
+
 	/* TODO: do we want to notify if some sensors could not be read? */
 	oc2gbts_swd_event(mgr, SWD_CHECK_TEMP_SENSOR);
+	return fast;
 }
 
 int oc2gbts_mgr_sensor_init(struct oc2gbts_mgr_instance *mgr)
@@ -972,9 +944,9 @@ int oc2gbts_mgr_sensor_init(struct oc2gbts_mgr_instance *mgr)
 	}
 
 	s_mgr = mgr;
-	sensor_ctrl_timer.cb = sensor_ctrl_check_cb;
-	sensor_ctrl_timer.data = s_mgr;
-	sensor_ctrl_check_cb(s_mgr);
+	mgr_sensor_sched_init(&sensor_sched, OC2GBTS_SENSOR_TIMER_DURATION,
+			      OC2GBTS_SENSOR_TIMER_FAST_DURATION, DTEMP, sensor_ctrl_check_cb, s_mgr);
+	mgr_sensor_sched_start(&sensor_sched);
 	return rc;
 }
 
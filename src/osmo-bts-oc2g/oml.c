@@ -1835,7 +1835,7 @@ int bts_model_apply_oml(struct gsm_bts *bts, const struct msgb *msg,
 		}
 
 		/* Did we go through MphInit yet? If yes fire and forget */
-		if (fl1h->hLayer1) {
+		if (fl1h->hLayer1 && !power_ramp_target_is(trx, get_p_target_mdBm(trx, 0))) {
 			power_ramp_start(trx, get_p_target_mdBm(trx, 0), 0, NULL);
 
 			if (fl1h->phy_inst->u.oc2g.tx_pwr_red_8psk != trx->max_power_backoff_8psk) {
@@ -2031,6 +2031,18 @@ int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 	return l1if_gsm_req_compl(fl1h, msg, ts_disconnect_cb, NULL);
 }
 
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	/* the DSP releases its SAPIs one by one, see bts_model_lchan_deactivate() */
+	return -ENOTSUP;
+}
+
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2)
+{
+	/* the DSP encodes the CBCH blocks itself */
+	return -ENOTSUP;
+}
+
 static int ts_connect_cb(struct gsm_bts_trx *trx, struct msgb *l1_msg,
 			 void *data)
 {
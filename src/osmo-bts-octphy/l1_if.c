@@ -71,8 +71,12 @@
 
 #define cPKTAPI_FIFO_ID_MSG                                0xAAAA0001
 
-/* maximum window of unacknowledged commands */
+/* initial, minimum and maximum window of unacknowledged commands */
 #define UNACK_CMD_WINDOW	8
+#define UNACK_CMD_WINDOW_MIN	1
+#define UNACK_CMD_WINDOW_MAX	32
+/* response time beyond twice the minimum (plus this) shrinks the window */
+#define CMD_WINDOW_RTT_SLACK_US	2000
 /* maximum number of re-transmissions of a command */
 #define MAX_RETRANS		3
 /* timeout until which we expect PHY to respond */
@@ -186,6 +190,8 @@ struct wait_l1_conf {
 	void *cb_data;
 	/* number of re-transmissions so far */
 	uint32_t num_retrans;
+	/* time of the (first) transmission, for the RTT */
+	struct timespec tx_time;
 };
 
 static void release_wlc(struct wait_l1_conf *wlc)
@@ -214,10 +220,69 @@ static struct llist_head *llist_first(struct llist_head *head)
 	return head->next;
 }
 
+/* Multiplicative decrease of the command window, at most once per window:
+ * responses to commands sent before the decrease don't shrink it again */
+static void cmd_window_decrease(struct octphy_hdl *fl1h, const char *reason)
+{
+	struct octphy_cmd_window *cw = &fl1h->cmd_window;
+
+	if ((int32_t) (fl1h->wlc_last_trans_id - cw->hold_trans_id) < 0)
+		return;
+
+	cw->size = OSMO_MAX(cw->size / 2, UNACK_CMD_WINDOW_MIN);
+	cw->acked = 0;
+	cw->hold_trans_id = fl1h->next_trans_id;
+	cw->decreases++;
+	LOGP(DL1C, LOGL_INFO, "Command window decreased to %u (%s)\n",
+	     cw->size, reason);
+}
+
+/* Account the in-order response to a command in the window: measure the
+ * RTT and grow the window by one per window of responses, as long as the
+ * window was the limit and the PHY doesn't respond any slower */
+static void cmd_window_ack(struct octphy_hdl *fl1h, const struct wait_l1_conf *wlc)
+{
+	struct octphy_cmd_window *cw = &fl1h->cmd_window;
+	struct timespec now;
+	uint32_t rtt_us;
+
+	fl1h->wlc_last_trans_id = wlc->trans_id;
+
+	/* the RTT of a retransmitted command is ambiguous */
+	if (wlc->num_retrans)
+		return;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	rtt_us = (now.tv_sec - wlc->tx_time.tv_sec) * 1000000
+		 + (now.tv_nsec - wlc->tx_time.tv_nsec) / 1000;
+
+	if (!cw->rtt_min_us || rtt_us < cw->rtt_min_us)
+		cw->rtt_min_us = rtt_us;
+	if (rtt_us > cw->rtt_max_us)
+		cw->rtt_max_us = rtt_us;
+	cw->rtt_avg_us = cw->rtt_avg_us ? (7 * cw->rtt_avg_us + rtt_us) / 8 : rtt_us;
+
+	if (rtt_us > 2 * cw->rtt_min_us + CMD_WINDOW_RTT_SLACK_US) {
+		cmd_window_decrease(fl1h, "response time");
+		return;
+	}
+
+	if (!fl1h->wlc_postponed_len || cw->size >= UNACK_CMD_WINDOW_MAX)
+		return;
+	if (++cw->acked < cw->size)
+		return;
+
+	cw->size++;
+	cw->acked = 0;
+	cw->increases++;
+	if (cw->size > cw->size_max)
+		cw->size_max = cw->size;
+}
+
 static void check_refill_window(struct octphy_hdl *fl1h, struct wait_l1_conf *recent)
 {
 	struct wait_l1_conf *wlc;
-	int space = UNACK_CMD_WINDOW - fl1h->wlc_list_len;
+	int space = fl1h->cmd_window.size - fl1h->wlc_list_len;
 	int i;
 
 	for (i = 0; i < space; i++) {
@@ -243,6 +308,7 @@ static void check_refill_window(struct octphy_hdl *fl1h, struct wait_l1_conf *re
 			     wlc->trans_id);
 		}
 		msg = msgb_copy(wlc->cmd_msg, "Tx from wlc_postponed");
+		osmo_clock_gettime(CLOCK_MONOTONIC, &wlc->tx_time);
 		/* queue for execution and response handling */
 		if (osmo_wqueue_enqueue(&fl1h->phy_wq, msg) != 0) {
 			LOGP(DL1C, LOGL_ERROR, "Tx Write queue full. dropping msg\n");
@@ -1316,6 +1382,9 @@ static int retransmit_wlc_upto(struct octphy_hdl *fl1h, uint32_t trans_id)
 		}
 	}
 
+	if (count)
+		cmd_window_decrease(fl1h, "retransmission");
+
 	return count;
 }
 
@@ -1340,6 +1409,7 @@ static int rx_octvc1_resp(struct msgb *msg, uint32_t msg_id, uint32_t trans_id)
 			/* process the received response */
 			llist_del(&wlc->list);
 			fl1h->wlc_list_len--;
+			cmd_window_ack(fl1h, wlc);
 			if (wlc->cb) {
 				/* call-back function must take msgb
 				 * ownership. */
@@ -1760,6 +1830,93 @@ static int octphy_write_cb(struct osmo_fd *fd, struct msgb *msg)
 	return rc;
 }
 
+/* Rx from the PACKET_MMAP ring: all packets of all the blocks retired by
+ * the kernel are consumed without any syscall */
+static void octphy_ring_read(struct octphy_hdl *fl1h)
+{
+	struct tpacket_block_desc *bd;
+	struct tpacket3_hdr *th;
+	struct msgb *msg;
+	unsigned int i;
+
+	while ((bd = octpkt_ring_rx_block(fl1h->ring))) {
+		th = (struct tpacket3_hdr *) ((uint8_t *) bd + bd->hdr.bh1.offset_to_first_pkt);
+		for (i = 0; i < bd->hdr.bh1.num_pkts; i++) {
+			msg = msgb_alloc_headroom(1500, 24, "PHY Rx");
+			if (!msg)
+				break;
+			if (th->tp_snaplen > msgb_tailroom(msg)) {
+				LOGP(DL1C, LOGL_ERROR, "Rx packet too long (%u)\n",
+					th->tp_snaplen);
+				msgb_free(msg);
+			} else {
+				/* SOCK_DGRAM: tp_mac points to the OCTPKT header */
+				memcpy(msgb_put(msg, th->tp_snaplen),
+				       (uint8_t *) th + th->tp_mac, th->tp_snaplen);
+				msg->dst = fl1h;
+				rx_octphy_msg(msg);
+			}
+			th = (struct tpacket3_hdr *) ((uint8_t *) th + th->tp_next_offset);
+		}
+		octpkt_ring_rx_release(fl1h->ring, bd);
+	}
+}
+
+/* Tx via the PACKET_MMAP ring: the write queue is copied into as many
+ * free frames as there are, and all of them are sent with one syscall */
+static void octphy_ring_write(struct octphy_hdl *fl1h)
+{
+	struct osmo_wqueue *wq = &fl1h->phy_wq;
+	struct msgb *msg;
+	unsigned int num = 0;
+	int rc;
+
+	while (!llist_empty(&wq->msg_queue)) {
+		msg = llist_first_entry(&wq->msg_queue, struct msgb, list);
+		rc = octpkt_ring_tx_put(fl1h->ring, msgb_data(msg), msgb_length(msg));
+		if (rc == -ENOBUFS)
+			break;
+		if (rc < 0)
+			LOGP(DL1P, LOGL_ERROR, "Tx to PHY has failed: %s\n",
+				strerror(-rc));
+		else
+			num++;
+		llist_del(&msg->list);
+		wq->current_length--;
+		msgb_free(msg);
+	}
+
+	if (num) {
+		rc = sendto(wq->bfd.fd, NULL, 0, 0,
+			    (struct sockaddr *) &fl1h->phy_addr,
+			    sizeof(fl1h->phy_addr));
+		if (rc < 0 && errno != EAGAIN)
+			LOGP(DL1P, LOGL_ERROR, "Tx to PHY has failed: %s\n",
+				strerror(errno));
+	}
+
+	/* if the ring is full, POLLOUT signals free frames again */
+	if (llist_empty(&wq->msg_queue))
+		osmo_fd_write_disable(&wq->bfd);
+}
+
+static int octphy_ring_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct octphy_hdl *fl1h = ofd->data;
+
+	if (what & OSMO_FD_READ)
+		octphy_ring_read(fl1h);
+
+	if (what & OSMO_FD_WRITE) {
+		if (fl1h->ring->tx_nr)
+			octphy_ring_write(fl1h);
+		else
+			osmo_wqueue_bfd_cb(ofd, OSMO_FD_WRITE);
+	}
+
+	return 0;
+}
+
 struct octphy_hdl *l1if_open(struct phy_link *plink)
 {
 	struct octphy_hdl *fl1h;
@@ -1773,6 +1930,8 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 
 	INIT_LLIST_HEAD(&fl1h->wlc_list);
 	INIT_LLIST_HEAD(&fl1h->wlc_postponed);
+	fl1h->cmd_window.size = UNACK_CMD_WINDOW;
+	fl1h->cmd_window.size_max = UNACK_CMD_WINDOW;
 	fl1h->phy_link = plink;
 
 	if (!phy_dev) {
@@ -1822,8 +1981,27 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 	fl1h->phy_wq.write_cb = octphy_write_cb;
 	fl1h->phy_wq.read_cb = octphy_read_cb;
 	osmo_fd_setup(&fl1h->phy_wq.bfd, sfd, OSMO_FD_READ, osmo_wqueue_bfd_cb, fl1h, 0);
+
+	if (plink->u.octphy.packet_mmap) {
+		fl1h->ring = talloc_zero(fl1h, struct octpkt_ring);
+		rc = fl1h->ring ? osmo_sock_packet_ring_init(sfd, fl1h->ring) : -ENOMEM;
+		if (rc < 0) {
+			LOGP(DL1C, LOGL_FATAL, "Error setting up the PACKET_MMAP "
+				"rings of the PHY socket: %s\n", strerror(-rc));
+			close(sfd);
+			talloc_free(fl1h);
+			return NULL;
+		}
+		if (!fl1h->ring->tx_nr)
+			LOGP(DL1C, LOGL_NOTICE, "No PACKET_MMAP Tx ring "
+				"(Linux >= 4.11 needed), using sendto()\n");
+		fl1h->phy_wq.bfd.cb = octphy_ring_fd_cb;
+	}
+
 	rc = osmo_fd_register(&fl1h->phy_wq.bfd);
 	if (rc < 0) {
+		if (fl1h->ring)
+			osmo_sock_packet_ring_exit(fl1h->ring);
 		close(sfd);
 		talloc_free(fl1h);
 		return NULL;
@@ -1835,6 +2013,8 @@ struct octphy_hdl *l1if_open(struct phy_link *plink)
 int l1if_close(struct octphy_hdl *fl1h)
 {
 	osmo_fd_unregister(&fl1h->phy_wq.bfd);
+	if (fl1h->ring)
+		osmo_sock_packet_ring_exit(fl1h->ring);
 	close(fl1h->phy_wq.bfd.fd);
 	talloc_free(fl1h);
 
@@ -25,6 +25,8 @@ struct octphy_hdl {
 
 	/* packet socket to talk with PHY */
 	struct osmo_wqueue phy_wq;
+	/* PACKET_MMAP rings of the socket, NULL unless 'octphy packet-mmap' */
+	struct octpkt_ring *ring;
 
 	/* address parameters of the PHY */
 	uint32_t session_id;
@@ -52,6 +54,20 @@ struct octphy_hdl {
 	 * Command Window' */
 	struct llist_head wlc_list;
 	int wlc_list_len;
+	/* trans_id of the last in-order response */
+	uint32_t wlc_last_trans_id;
+	/* the size of the window adapts to the response time of the PHY */
+	struct octphy_cmd_window {
+		unsigned int size;		/* current size */
+		unsigned int size_max;		/* largest size so far */
+		unsigned int acked;		/* responses since the last increase */
+		uint32_t hold_trans_id;		/* no decrease before this response */
+		uint32_t rtt_min_us;
+		uint32_t rtt_avg_us;
+		uint32_t rtt_max_us;
+		uint32_t increases;
+		uint32_t decreases;
+	} cmd_window;
 	struct {
 		/* messages retransmitted due to discontinuity of transaction
 		 * ID in responses from PHY */
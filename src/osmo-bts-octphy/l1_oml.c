@@ -1750,7 +1750,9 @@ int bts_model_apply_oml(struct gsm_bts *bts, const struct msgb *msg,
 	switch (foh->msg_type) {
 	case NM_MT_SET_RADIO_ATTR:
 		trx = obj;
-		power_ramp_start(trx, get_p_target_mdBm(trx, 0), 0, NULL);
+		/* the BSC re-sends unchanged attributes, e.g. after reconnecting */
+		if (!power_ramp_target_is(trx, get_p_target_mdBm(trx, 0)))
+			power_ramp_start(trx, get_p_target_mdBm(trx, 0), 0, NULL);
 		break;
 	}
 
@@ -1817,6 +1819,18 @@ int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 	return l1if_req_compl(fl1h, msg, ts_disconnect_cb, NULL);
 }
 
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	/* the PHY releases its logical channels one by one, see bts_model_lchan_deactivate() */
+	return -ENOTSUP;
+}
+
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2)
+{
+	/* the PHY encodes the CBCH blocks itself */
+	return -ENOTSUP;
+}
+
 void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
 			 enum gsm_phys_chan_config as_pchan)
 {
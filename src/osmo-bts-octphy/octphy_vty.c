@@ -216,6 +216,24 @@ DEFUN(cfg_phy_over_sample_16x, cfg_phy_over_sample_16x_cmd,
 }
 #endif
 
+DEFUN(cfg_phy_packet_mmap, cfg_phy_packet_mmap_cmd,
+      "octphy packet-mmap <0-1>",
+      OCT_STR "Use PACKET_MMAP rings on the packet socket to the PHY (restart required)\n"
+      "0 = recvfrom()/sendto() per packet, 1 = PACKET_MMAP rings\n")
+{
+	struct phy_link *plink = vty->index;
+
+	if (plink->state != PHY_LINK_SHUTDOWN) {
+		vty_out(vty, "Can only reconfigure a PHY link that is down%s",
+			VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	plink->u.octphy.packet_mmap = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
 void show_rf_port_stats_cb(struct msgb *resp, void *data)
 {
 	struct vty *vty = (struct vty*) data;
@@ -395,6 +413,8 @@ void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink)
 	vty_out(vty, " octphy over-sample-16x %u%s", plink->u.octphy.over_sample_16x,
 		VTY_NEWLINE);
 #endif
+	if (plink->u.octphy.packet_mmap)
+		vty_out(vty, " octphy packet-mmap 1%s", VTY_NEWLINE);
 }
 
 void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance *pinst)
@@ -434,6 +454,37 @@ DEFUN(show_sys_info, show_sys_info_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(show_cmd_window, show_cmd_window_cmd,
+	"show phy <0-255> cmd-window",
+	SHOW_TRX_STR "Display the state of the unacknowledged command window\n")
+{
+	int phy_nr = atoi(argv[0]);
+	struct phy_link *plink = phy_link_by_num(phy_nr);
+	const struct octphy_cmd_window *cw;
+	struct octphy_hdl *fl1h;
+
+	if (!plink) {
+		vty_out(vty, "Cannot find PHY number %u%s",
+			phy_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	fl1h = plink->u.octphy.hdl;
+	cw = &fl1h->cmd_window;
+
+	vty_out(vty, "Window size: %u (max. %u), in flight: %d, postponed: %d%s",
+		cw->size, cw->size_max, fl1h->wlc_list_len,
+		fl1h->wlc_postponed_len, VTY_NEWLINE);
+	vty_out(vty, "Window increases: %u, decreases: %u%s",
+		cw->increases, cw->decreases, VTY_NEWLINE);
+	vty_out(vty, "Response time (us): min %u, avg %u, max %u%s",
+		cw->rtt_min_us, cw->rtt_avg_us, cw->rtt_max_us, VTY_NEWLINE);
+	vty_out(vty, "Postponed commands: %u, retransmitted: %u (trans_id), "
+		"%u (supervisory)%s", fl1h->stats.wlc_postponed,
+		fl1h->stats.retrans_cmds_trans_id, fl1h->stats.retrans_cmds_supv,
+		VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
 
 int bts_model_vty_init(void *ctx)
 {
@@ -449,9 +500,11 @@ int bts_model_vty_init(void *ctx)
 #if OCTPHY_USE_16X_OVERSAMPLING == 1
 	install_element(PHY_NODE, &cfg_phy_over_sample_16x_cmd);
 #endif
+	install_element(PHY_NODE, &cfg_phy_packet_mmap_cmd);
 	install_element_ve(&show_rf_port_stats_cmd);
 	install_element_ve(&show_clk_sync_stats_cmd);
 	install_element_ve(&show_sys_info_cmd);
+	install_element_ve(&show_cmd_window_cmd);
 
 	return 0;
 }
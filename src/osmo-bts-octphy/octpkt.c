@@ -97,6 +97,7 @@ void octvc1_fill_msg_hdr(tOCTVC1_MSG_HEADER *mh, uint32_t len,
 #include <sys/ioctl.h>
 #include <net/if.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
 #include <linux/if_packet.h>
 #include <net/ethernet.h>
 
@@ -156,3 +157,118 @@ err:
 	close(sfd);
 	return -1;
 }
+
+/* PACKET_MMAP ring geometry.  Rx blocks are retired by the kernel when
+ * full or after OCTPKT_RING_RX_TOV_MS, so they are kept small to not
+ * delay the indications from the PHY any longer than necessary. */
+#define OCTPKT_RING_BLOCK_SIZE	(1 << 13)
+#define OCTPKT_RING_FRAME_SIZE	(1 << 11)
+#define OCTPKT_RING_RX_BLOCKS	64
+#define OCTPKT_RING_RX_TOV_MS	1
+#define OCTPKT_RING_TX_BLOCKS	16
+
+/*! \brief Set up a TPACKET_V3 Rx ring and Tx ring on a packet socket
+ *  \param[in] sfd packet socket as returned by osmo_sock_packet_init()
+ *  \param[out] ring ring state to initialize
+ *  \returns 0 on success; negative errno on error
+ *
+ * The Tx ring requires Linux >= 4.11 for TPACKET_V3.  If it cannot be
+ * set up, \a ring->tx_nr is 0 and sendto() must be used for Tx. */
+int osmo_sock_packet_ring_init(int sfd, struct octpkt_ring *ring)
+{
+	struct tpacket_req3 req;
+	size_t rx_len, tx_len = 0;
+	int ver = TPACKET_V3;
+
+	memset(ring, 0, sizeof(*ring));
+
+	if (setsockopt(sfd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0)
+		return -errno;
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = OCTPKT_RING_BLOCK_SIZE;
+	req.tp_frame_size = OCTPKT_RING_FRAME_SIZE;
+	req.tp_block_nr = OCTPKT_RING_RX_BLOCKS;
+	req.tp_frame_nr = OCTPKT_RING_RX_BLOCKS * (OCTPKT_RING_BLOCK_SIZE / OCTPKT_RING_FRAME_SIZE);
+	req.tp_retire_blk_tov = OCTPKT_RING_RX_TOV_MS;
+	if (setsockopt(sfd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+		return -errno;
+	rx_len = (size_t) req.tp_block_size * req.tp_block_nr;
+
+	req.tp_block_nr = OCTPKT_RING_TX_BLOCKS;
+	req.tp_frame_nr = OCTPKT_RING_TX_BLOCKS * (OCTPKT_RING_BLOCK_SIZE / OCTPKT_RING_FRAME_SIZE);
+	req.tp_retire_blk_tov = 0;
+	if (setsockopt(sfd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) == 0) {
+		tx_len = (size_t) req.tp_block_size * req.tp_block_nr;
+		ring->tx_nr = req.tp_frame_nr;
+	}
+
+	/* the Tx ring (if any) is mapped right after the Rx ring */
+	ring->map = mmap(NULL, rx_len + tx_len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, sfd, 0);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		return -errno;
+	}
+	ring->map_len = rx_len + tx_len;
+	ring->rx_nr = OCTPKT_RING_RX_BLOCKS;
+
+	return 0;
+}
+
+/*! \brief Unmap the rings set up by osmo_sock_packet_ring_init() */
+void osmo_sock_packet_ring_exit(struct octpkt_ring *ring)
+{
+	if (ring->map)
+		munmap(ring->map, ring->map_len);
+	ring->map = NULL;
+}
+
+/*! \brief Get the next Rx block handed over by the kernel (if any);
+ *  it must be returned by octpkt_ring_rx_release() once consumed */
+struct tpacket_block_desc *octpkt_ring_rx_block(struct octpkt_ring *ring)
+{
+	struct tpacket_block_desc *bd;
+
+	bd = (struct tpacket_block_desc *)
+		(ring->map + (size_t) ring->rx_cur * OCTPKT_RING_BLOCK_SIZE);
+	if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+		return NULL;
+
+	return bd;
+}
+
+/*! \brief Return an Rx block to the kernel and advance the ring */
+void octpkt_ring_rx_release(struct octpkt_ring *ring, struct tpacket_block_desc *bd)
+{
+	__atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+	ring->rx_cur = (ring->rx_cur + 1) % ring->rx_nr;
+}
+
+/*! \brief Queue a packet in the next free Tx frame; the queued frames
+ *  are transmitted by the next sendto() with a zero-length buffer
+ *  \returns 0 on success; -ENOBUFS if the ring is full; -EMSGSIZE */
+int octpkt_ring_tx_put(struct octpkt_ring *ring, const uint8_t *data, size_t len)
+{
+	struct tpacket3_hdr *th;
+
+	if (len > OCTPKT_RING_FRAME_SIZE - TPACKET3_HDRLEN + sizeof(struct sockaddr_ll))
+		return -EMSGSIZE;
+
+	th = (struct tpacket3_hdr *)
+		(ring->map + (size_t) ring->rx_nr * OCTPKT_RING_BLOCK_SIZE
+			   + (size_t) ring->tx_cur * OCTPKT_RING_FRAME_SIZE);
+	if (__atomic_load_n(&th->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+		return -ENOBUFS;
+
+	/* without PACKET_TX_HAS_OFF, the payload of a SOCK_DGRAM frame
+	 * starts where the struct sockaddr_ll of an Rx frame would be */
+	memcpy((uint8_t *) th + TPACKET3_HDRLEN - sizeof(struct sockaddr_ll), data, len);
+	th->tp_len = len;
+	th->tp_next_offset = 0;
+	__atomic_store_n(&th->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+	ring->tx_cur = (ring->tx_cur + 1) % ring->tx_nr;
+
+	return 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 
 /* push a common header (1 dword) to the start of a msgb */
 void octpkt_push_common_hdr(struct msgb *msg, uint8_t format,
@@ -19,4 +20,22 @@ void octvocnet_push_ctl_hdr(struct msgb *msg, uint32_t dest_fifo_id,
 int osmo_sock_packet_init(uint16_t type, uint16_t proto, const char *bind_dev,
 			  unsigned int flags);
 
+/* TPACKET_V3 (PACKET_MMAP) rings of a packet socket */
+struct octpkt_ring {
+	uint8_t *map;		/* Rx ring, followed by the Tx ring (if any) */
+	size_t map_len;
+	unsigned int rx_nr;	/* number of Rx blocks */
+	unsigned int rx_cur;	/* next Rx block to consume */
+	unsigned int tx_nr;	/* number of Tx frames (0: no Tx ring) */
+	unsigned int tx_cur;	/* next Tx frame to fill */
+};
+
+struct tpacket_block_desc;
+
+int osmo_sock_packet_ring_init(int sfd, struct octpkt_ring *ring);
+void osmo_sock_packet_ring_exit(struct octpkt_ring *ring);
+struct tpacket_block_desc *octpkt_ring_rx_block(struct octpkt_ring *ring);
+void octpkt_ring_rx_release(struct octpkt_ring *ring, struct tpacket_block_desc *bd);
+int octpkt_ring_tx_put(struct octpkt_ring *ring, const uint8_t *data, size_t len);
+
 int tx_trx_open(struct gsm_bts_trx *trx);
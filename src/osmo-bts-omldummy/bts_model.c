@@ -185,7 +185,7 @@ int bts_model_trx_init(struct gsm_bts_trx *trx)
 {
 	struct trx_power_params *tpp = &trx->power_params;
 	/* Speed up shutdown, we don't care about power ramping in omldummy */
-	tpp->ramp.step_interval_sec = 0;
+	tpp->ramp.step_interval_ms = 0;
 	return 0;
 }
 
@@ -216,6 +216,16 @@ int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 	return -ENOTSUP;
 }
 
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	return -ENOTSUP;
+}
+
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2)
+{
+	return -ENOTSUP;
+}
+
 void bts_model_ts_connect(struct gsm_bts_trx_ts *ts, enum gsm_phys_chan_config as_pchan)
 {
 	return;
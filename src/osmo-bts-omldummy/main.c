@@ -1,12 +1,19 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 
 #define _GNU_SOURCE
 #include <getopt.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/application.h>
+#include <osmocom/core/timer.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/abis.h>
 #include <osmo-bts/bts.h>
@@ -15,7 +22,8 @@
 
 static void print_usage(const char *prog_name)
 {
-	printf("Usage: %s [-h] [--features FOO,BAR,BAZ] dst_host site_id [trx_num]\n", prog_name);
+	printf("Usage: %s [-h] [--features FOO,BAR,BAZ] [--instances N] [--stats-interval SEC]\n"
+	       "	dst_host site_id [trx_num]\n", prog_name);
 }
 
 static void print_help(const char *prog_name)
@@ -26,6 +34,9 @@ static void print_help(const char *prog_name)
 	       "				The names correspond to BTS_FEAT_* constants\n"
 	       "				as defined in osmocom/gsm/bts_features.h,\n"
 	       "				e.g. '-f VAMOS'\n");
+	printf("  -n --instances N		Emulate N BTS with the site IDs site_id ... site_id+N-1,\n"
+	       "				each one is restarted when its A-bis link is lost.\n");
+	printf("  -s --stats-interval SEC	Print the state of each instance every SEC seconds.\n");
 }
 
 struct {
@@ -33,8 +44,11 @@ struct {
 	int site_id;
 	int trx_num;
 	char *features;
+	unsigned int instances;
+	unsigned int stats_interval;
 } cmdline = {
 	.trx_num = 8,
+	.instances = 1,
 };
 
 void parse_cmdline(int argc, char **argv)
@@ -44,10 +58,12 @@ void parse_cmdline(int argc, char **argv)
 		static struct option long_options[] = {
 			{"help", 0, 0, 'h'},
 			{"features", 1, 0, 'f'},
+			{"instances", 1, 0, 'n'},
+			{"stats-interval", 1, 0, 's'},
 			{0}
 		};
 
-		c = getopt_long(argc, argv, "hf:", long_options, &option_index);
+		c = getopt_long(argc, argv, "hf:n:s:", long_options, &option_index);
 		if (c == -1)
 			break;
 
@@ -58,6 +74,16 @@ void parse_cmdline(int argc, char **argv)
 		case 'f':
 			cmdline.features = optarg;
 			break;
+		case 'n':
+			cmdline.instances = atoi(optarg);
+			if (cmdline.instances < 1) {
+				fprintf(stderr, "Invalid number of instances: '%s'\n", optarg);
+				exit(-1);
+			}
+			break;
+		case 's':
+			cmdline.stats_interval = atoi(optarg);
+			break;
 		default:
 			/* catch unknown options *as well as* missing arguments. */
 			fprintf(stderr, "Error in command line options. Exiting.\n");
@@ -104,15 +130,72 @@ void set_bts_features(struct bitvec *features, char *features_str)
 	}
 }
 
-int main(int argc, char **argv)
+/* The OML object model of the common code (g_bts_sm, the site manager and
+ * the GPRS NSE) exists once per process, so each emulated BTS runs in a
+ * forked child process of its own.  The children report their state into
+ * a shared anonymous mapping, the parent restarts them and prints it. */
+struct instance_state {
+	pid_t pid;
+	int site_id;
+	unsigned int restarts;
+	time_t restart_at;		/* pid == 0: when to start the instance again */
+	bool oml_up;
+	unsigned int rsl_up;		/* number of TRX with an RSL link */
+	unsigned int attempts;		/* connection attempts during the current outage */
+	unsigned long long last_oml_ms;	/* last time to OML link up */
+	unsigned long long last_rsl_ms;	/* last time to C0 RSL link up */
+};
+
+static struct instance_state *g_inst;
+static struct osmo_timer_list state_timer;
+
+static void state_timer_cb(void *data)
+{
+	struct gsm_bts *bts = data;
+	struct gsm_bts_trx *trx;
+	unsigned int rsl_up = 0;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		if (trx->rsl_link)
+			rsl_up++;
+	}
+
+	g_inst->oml_up = bts->oml_link != NULL;
+	g_inst->rsl_up = rsl_up;
+	g_inst->attempts = bts->abis_tts.attempts;
+	g_inst->last_oml_ms = bts->abis_tts.last_oml_ms;
+	g_inst->last_rsl_ms = bts->abis_tts.last_rsl_ms;
+
+	osmo_timer_schedule(&state_timer, 1, 0);
+}
+
+static void print_instances(const struct instance_state *inst, unsigned int num)
+{
+	unsigned int i, oml_up = 0, in_service = 0;
+
+	printf("%8s %8s %8s %4s %4s %9s %12s %12s\n", "site_id", "pid", "restarts",
+	       "OML", "RSL", "attempts", "oml_up ms", "rsl_up ms");
+	for (i = 0; i < num; i++) {
+		printf("%8d %8d %8u %4s %4u %9u %12llu %12llu\n", inst[i].site_id,
+		       (int) inst[i].pid, inst[i].restarts, inst[i].oml_up ? "up" : "down",
+		       inst[i].rsl_up, inst[i].attempts, inst[i].last_oml_ms, inst[i].last_rsl_ms);
+		if (inst[i].oml_up)
+			oml_up++;
+		if ((int) inst[i].rsl_up == cmdline.trx_num)
+			in_service++;
+	}
+	printf("%u instances: %u with OML up, %u with all %d RSL links up\n",
+	       num, oml_up, in_service, cmdline.trx_num);
+	fflush(stdout);
+}
+
+static int run_instance(void)
 {
 	struct gsm_bts *bts;
 	struct gsm_bts_trx *trx;
 	struct bsc_oml_host *bsc_oml_host;
 	int i;
 
-	parse_cmdline(argc, argv);
-
 	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
 	msgb_talloc_ctx_init(tall_bts_ctx, 10*1024);
 
@@ -126,7 +209,7 @@ int main(int argc, char **argv)
 	if (!bts)
 		exit(1);
 
-	bts->ip_access.site_id = cmdline.site_id;
+	bts->ip_access.site_id = g_inst->site_id;
 	bts->ip_access.bts_id = 0;
 
 	/* Additional TRXs */
@@ -158,9 +241,94 @@ int main(int argc, char **argv)
 	if (abis_open(bts, "OMLdummy") != 0)
 		exit(1);
 
+	osmo_timer_setup(&state_timer, state_timer_cb, bts);
+	osmo_timer_schedule(&state_timer, 0, 0);
+
 	while (1) {
 		osmo_select_main(0);
 	}
 
 	return EXIT_SUCCESS;
 }
+
+static void start_instance(struct instance_state *inst)
+{
+	pid_t pid = fork();
+
+	if (pid < 0) {
+		fprintf(stderr, "Failed to fork instance for site_id %d: %s\n",
+			inst->site_id, strerror(errno));
+		exit(1);
+	}
+	if (pid == 0) {
+		g_inst = inst;
+		exit(run_instance());
+	}
+
+	inst->pid = pid;
+	inst->oml_up = false;
+	inst->rsl_up = 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct instance_state *inst;
+	struct timespec next = {}, now;
+	unsigned int i;
+
+	parse_cmdline(argc, argv);
+
+	inst = mmap(NULL, cmdline.instances * sizeof(*inst), PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (inst == MAP_FAILED) {
+		fprintf(stderr, "Failed to map the instance state: %s\n", strerror(errno));
+		exit(1);
+	}
+	memset(inst, 0, cmdline.instances * sizeof(*inst));
+
+	/* A single instance without stats runs in this process, as before */
+	if (cmdline.instances == 1 && cmdline.stats_interval == 0) {
+		inst[0].site_id = cmdline.site_id;
+		g_inst = &inst[0];
+		return run_instance();
+	}
+
+	for (i = 0; i < cmdline.instances; i++) {
+		inst[i].site_id = cmdline.site_id + i;
+		start_instance(&inst[i]);
+	}
+
+	while (1) {
+		int status;
+		pid_t pid;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			for (i = 0; i < cmdline.instances; i++) {
+				if (inst[i].pid != pid)
+					continue;
+				/* like respawn.sh, give the BSC a second before reconnecting */
+				inst[i].pid = 0;
+				inst[i].restart_at = now.tv_sec + 1;
+				break;
+			}
+		}
+
+		for (i = 0; i < cmdline.instances; i++) {
+			if (inst[i].pid == 0 && now.tv_sec >= inst[i].restart_at) {
+				inst[i].restarts++;
+				start_instance(&inst[i]);
+			}
+		}
+
+		if (cmdline.stats_interval > 0 && now.tv_sec >= next.tv_sec) {
+			print_instances(inst, cmdline.instances);
+			next.tv_sec = now.tv_sec + cmdline.stats_interval;
+		}
+
+		usleep(100 * 1000);
+	}
+
+	return EXIT_SUCCESS;
+}
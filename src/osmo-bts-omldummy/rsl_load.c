@@ -0,0 +1,1215 @@
+/* RSL/OML message-rate load generator: acts as a (very) minimal BSC,
+ * brings up a BTS via OML and drives a mix of RSL procedures against it. */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: AGPL-3.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <getopt.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/ctrl/ports.h>
+#include <osmocom/gsm/tlv.h>
+#include <osmocom/gsm/ipa.h>
+#include <osmocom/gsm/abis_nm.h>
+#include <osmocom/gsm/rsl.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/gsm/protocol/gsm_12_21.h>
+#include <osmocom/gsm/protocol/ipaccess.h>
+#include <osmocom/abis/abis.h>
+#include <osmocom/abis/e1_input.h>
+#include <osmocom/abis/ipaccess.h>
+
+enum {
+	DLOAD,
+};
+
+static const struct log_info_cat load_log_cat[] = {
+	[DLOAD] = {
+		.name = "DLOAD",
+		.description = "RSL/OML load generator",
+		.enabled = 1, .loglevel = LOGL_NOTICE,
+	},
+};
+
+static const struct log_info load_log_info = {
+	.cat = load_log_cat,
+	.num_cat = ARRAY_SIZE(load_log_cat),
+};
+
+enum load_proc {
+	PROC_CHAN_ACT,		/* CHAN ACTIV -> ACK, (hold), RF CHAN REL -> ACK */
+	PROC_PAGING,		/* PAGING CMD */
+	PROC_IMM_ASS,		/* IMM ASS CMD */
+	_NUM_PROC
+};
+
+static const struct value_string load_proc_names[] = {
+	{ PROC_CHAN_ACT,	"chan-act" },
+	{ PROC_PAGING,		"paging" },
+	{ PROC_IMM_ASS,		"imm-ass" },
+	{ 0, NULL }
+};
+
+/* BTS counters fetched via CTRL before and after the run */
+static const char *default_ctrs[] = {
+	"paging:rcvd", "paging:drop", "paging:cong", "paging:sent",
+	"agch:rcvd", "agch:sent", "agch:delete",
+};
+
+#define MAX_TRX		8
+#define NUM_TS		8
+#define MAX_EXTRA_CTRS	16
+#define TICK_US		10000
+#define OML_TIMEOUT_S	10
+#define DRAIN_TIMEOUT_S	2
+
+static struct {
+	const char *bind_ip;
+	const char *ctrl_host;
+	uint16_t ctrl_port;
+	unsigned int num_trx;
+	uint16_t arfcn;
+	uint8_t bsic;
+	unsigned int rate;
+	unsigned int duration;
+	unsigned int hold_ms;
+	unsigned int weight[_NUM_PROC];
+	const char *extra_ctrs[MAX_EXTRA_CTRS];
+	unsigned int num_extra_ctrs;
+} cfg = {
+	.bind_ip = "0.0.0.0",
+	.ctrl_host = "127.0.0.1",
+	.ctrl_port = OSMO_CTRL_PORT_BTS,
+	.num_trx = 1,
+	.arfcn = 868,
+	.bsic = 63,
+	.rate = 100,
+	.duration = 10,
+	.weight = {
+		[PROC_CHAN_ACT]	= 1,
+		[PROC_PAGING]	= 1,
+		[PROC_IMM_ASS]	= 1,
+	},
+};
+
+struct lat_samples {
+	uint32_t *us;
+	size_t num;
+	size_t alloc;
+};
+
+enum load_lchan_state {
+	LCHAN_IDLE,
+	LCHAN_ACT_PEND,
+	LCHAN_ACTIVE,
+	LCHAN_REL_PEND,
+};
+
+struct load_lchan {
+	struct load_trx *trx;
+	uint8_t chan_nr;
+	bool sdcch;
+	enum load_lchan_state state;
+	struct timespec t_tx;
+	struct osmo_timer_list hold_timer;
+};
+
+struct load_trx {
+	uint8_t nr;
+	struct e1inp_sign_link *rsl_link;
+	/* TS0 of TRX0: 4 x SDCCH/4; TS1..7 (TS0..7 on other TRX): TCH/F */
+	struct load_lchan lchan[NUM_TS + 3];
+	unsigned int num_lchan;
+};
+
+static struct {
+	void *ctx;
+	struct e1inp_line *line;
+	struct e1inp_sign_link *oml_link;
+	struct load_trx trx[MAX_TRX];
+
+	/* OML bring-up */
+	struct oml_step *steps;
+	unsigned int num_steps, cur_step;
+	unsigned int num_chan_enabled;
+	struct osmo_timer_list oml_timer;
+
+	/* load phase */
+	bool running, draining;
+	struct timespec t_start, t_last_tick, t_stop;
+	double credit;
+	struct osmo_timer_list tick_timer;
+	uint32_t tmsi;
+	uint8_t ra;
+
+	unsigned long long ctr_before[ARRAY_SIZE(default_ctrs) + MAX_EXTRA_CTRS];
+	bool ctr_valid;
+
+	/* results */
+	unsigned long long sent[_NUM_PROC];
+	unsigned long long no_lchan;
+	unsigned long long act_nack, rel_pend;
+	unsigned long long delete_ind, ccch_load_pch, ccch_load_rach, err_rep, other;
+	struct lat_samples lat_act, lat_rel;
+} g;
+
+struct oml_step {
+	uint8_t mdisc;
+	uint8_t msg_type;
+	uint8_t obj_class;
+	struct abis_om_obj_inst inst;
+};
+
+static uint64_t ts_us(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000ULL + ts->tv_nsec / 1000;
+}
+
+static uint64_t elapsed_us(const struct timespec *t0)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ts_us(&now) - ts_us(t0);
+}
+
+static void lat_add(struct lat_samples *l, const struct timespec *t0)
+{
+	if (l->num == l->alloc) {
+		l->alloc = l->alloc ? l->alloc * 2 : 1024;
+		l->us = talloc_realloc(g.ctx, l->us, uint32_t, l->alloc);
+		OSMO_ASSERT(l->us);
+	}
+	l->us[l->num++] = elapsed_us(t0);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static double lat_pct_ms(const struct lat_samples *l, unsigned int pct)
+{
+	size_t idx;
+
+	if (!l->num)
+		return 0;
+	idx = (l->num * pct + 99) / 100;
+	if (idx > 0)
+		idx--;
+	return l->us[OSMO_MIN(idx, l->num - 1)] / 1000.0;
+}
+
+/*
+ * OML
+ */
+
+static void oml_add_step(uint8_t mdisc, uint8_t msg_type, uint8_t obj_class,
+			 uint8_t bts_nr, uint8_t trx_nr, uint8_t ts_nr)
+{
+	g.steps = talloc_realloc(g.ctx, g.steps, struct oml_step, g.num_steps + 1);
+	OSMO_ASSERT(g.steps);
+	g.steps[g.num_steps++] = (struct oml_step) {
+		.mdisc = mdisc,
+		.msg_type = msg_type,
+		.obj_class = obj_class,
+		.inst = { .bts_nr = bts_nr, .trx_nr = trx_nr, .ts_nr = ts_nr },
+	};
+}
+
+/* The same order in which OsmoBSC brings up an osmo-bts */
+static void oml_build_steps(void)
+{
+	unsigned int i, tn;
+
+	oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_OPSTART, NM_OC_SITE_MANAGER, 0xff, 0xff, 0xff);
+
+	oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_SET_BTS_ATTR, NM_OC_BTS, 0, 0xff, 0xff);
+	oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_OPSTART, NM_OC_BTS, 0, 0xff, 0xff);
+	oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_CHG_ADM_STATE, NM_OC_BTS, 0, 0xff, 0xff);
+
+	for (i = 0; i < cfg.num_trx; i++) {
+		oml_add_step(ABIS_OM_MDISC_MANUF, NM_MT_IPACC_RSL_CONNECT, NM_OC_BASEB_TRANSC, 0, i, 0xff);
+		oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_OPSTART, NM_OC_BASEB_TRANSC, 0, i, 0xff);
+		oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_CHG_ADM_STATE, NM_OC_BASEB_TRANSC, 0, i, 0xff);
+
+		oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_SET_RADIO_ATTR, NM_OC_RADIO_CARRIER, 0, i, 0xff);
+		oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_OPSTART, NM_OC_RADIO_CARRIER, 0, i, 0xff);
+		oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_CHG_ADM_STATE, NM_OC_RADIO_CARRIER, 0, i, 0xff);
+
+		for (tn = 0; tn < NUM_TS; tn++) {
+			oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_SET_CHAN_ATTR, NM_OC_CHANNEL, 0, i, tn);
+			oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_OPSTART, NM_OC_CHANNEL, 0, i, tn);
+			oml_add_step(ABIS_OM_MDISC_FOM, NM_MT_CHG_ADM_STATE, NM_OC_CHANNEL, 0, i, tn);
+		}
+	}
+}
+
+static void oml_tx_step(const struct oml_step *step)
+{
+	struct abis_om_fom_hdr *foh;
+	struct abis_om_hdr *oh;
+	struct msgb *msg;
+	uint8_t arfcn[2];
+	uint16_t trx_arfcn;
+
+	msg = msgb_alloc_headroom(1024, 128, "OML");
+	OSMO_ASSERT(msg);
+
+	msg->l3h = msgb_put(msg, sizeof(*foh));
+	foh = (struct abis_om_fom_hdr *) msg->l3h;
+	foh->msg_type = step->msg_type;
+	foh->obj_class = step->obj_class;
+	foh->obj_inst = step->inst;
+
+	switch (step->msg_type) {
+	case NM_MT_SET_BTS_ATTR:
+		msgb_tv16_put(msg, NM_ATT_BCCH_ARFCN, cfg.arfcn);
+		msgb_tv_put(msg, NM_ATT_BSIC, cfg.bsic);
+		break;
+	case NM_MT_SET_RADIO_ATTR:
+		trx_arfcn = cfg.arfcn + 2 * step->inst.trx_nr;
+		osmo_store16be(trx_arfcn, arfcn);
+		msgb_tv_put(msg, NM_ATT_RF_MAXPOWR_R, 0);
+		msgb_tl16v_put(msg, NM_ATT_ARFCN_LIST, sizeof(arfcn), arfcn);
+		break;
+	case NM_MT_SET_CHAN_ATTR:
+		if (step->inst.trx_nr == 0 && step->inst.ts_nr == 0)
+			msgb_tv_put(msg, NM_ATT_CHAN_COMB, NM_CHANC_BCCHComb);
+		else
+			msgb_tv_put(msg, NM_ATT_CHAN_COMB, NM_CHANC_TCHFull);
+		msgb_tv_put(msg, NM_ATT_TSC, cfg.bsic & 0x07);
+		break;
+	case NM_MT_CHG_ADM_STATE:
+		msgb_tv_put(msg, NM_ATT_ADM_STATE, NM_STATE_UNLOCKED);
+		break;
+	case NM_MT_IPACC_RSL_CONNECT:
+		/* the BTS connects to the IP address of the OML link */
+		msgb_tv16_put(msg, NM_ATT_IPACC_DST_IP_PORT, IPA_TCP_PORT_RSL);
+		msgb_tv_put(msg, NM_ATT_IPACC_STREAM_ID, 0);
+		break;
+	}
+
+	if (step->mdisc == ABIS_OM_MDISC_MANUF) {
+		uint8_t *manuf = msgb_push(msg, LV_GROSS_LEN(sizeof(abis_nm_ipa_magic)));
+		lv_put(manuf, sizeof(abis_nm_ipa_magic), (const uint8_t *) abis_nm_ipa_magic);
+	}
+
+	oh = (struct abis_om_hdr *) msgb_push(msg, sizeof(*oh));
+	oh->mdisc = step->mdisc;
+	oh->placement = ABIS_OM_PLACEMENT_ONLY;
+	oh->sequence = 0;
+	oh->length = msgb_l3len(msg);
+	msg->l2h = (uint8_t *) oh;
+
+	LOGP(DLOAD, LOGL_DEBUG, "Tx OML %s %s\n", abis_nm_dump_foh(foh),
+	     get_value_string(abis_nm_msgtype_names, step->msg_type));
+
+	msg->dst = g.oml_link;
+	abis_sendmsg(msg);
+}
+
+static void load_start(void);
+
+static bool load_ready(void)
+{
+	unsigned int i;
+
+	if (g.cur_step < g.num_steps)
+		return false;
+	for (i = 0; i < cfg.num_trx; i++) {
+		if (!g.trx[i].rsl_link)
+			return false;
+	}
+	return g.num_chan_enabled >= cfg.num_trx * NUM_TS;
+}
+
+static void oml_timer_cb(void *data)
+{
+	if (g.cur_step < g.num_steps) {
+		LOGP(DLOAD, LOGL_FATAL, "Timeout waiting for the ACK of OML step %u/%u\n",
+		     g.cur_step + 1, g.num_steps);
+		exit(1);
+	}
+
+	LOGP(DLOAD, LOGL_ERROR, "Only %u of %u timeslots enabled, RSL %s; starting anyway\n",
+	     g.num_chan_enabled, cfg.num_trx * NUM_TS,
+	     g.trx[cfg.num_trx - 1].rsl_link ? "up" : "not up");
+	load_start();
+}
+
+static void oml_next_step(void)
+{
+	if (g.cur_step < g.num_steps) {
+		oml_tx_step(&g.steps[g.cur_step]);
+		osmo_timer_schedule(&g.oml_timer, OML_TIMEOUT_S, 0);
+		return;
+	}
+
+	if (load_ready()) {
+		osmo_timer_del(&g.oml_timer);
+		load_start();
+	}
+}
+
+static void oml_rx_statechg(const struct abis_om_fom_hdr *foh, size_t len)
+{
+	struct tlv_parsed tp;
+
+	if (foh->obj_class != NM_OC_CHANNEL)
+		return;
+	if (tlv_parse(&tp, &abis_nm_att_tlvdef, foh->data, len, 0, 0) < 0)
+		return;
+	if (!TLVP_PRES_LEN(&tp, NM_ATT_OPER_STATE, 1))
+		return;
+	if (*TLVP_VAL(&tp, NM_ATT_OPER_STATE) != NM_OPSTATE_ENABLED)
+		return;
+
+	g.num_chan_enabled++;
+	if (!g.running && load_ready()) {
+		osmo_timer_del(&g.oml_timer);
+		load_start();
+	}
+}
+
+static void oml_rx(struct msgb *msg)
+{
+	struct abis_om_hdr *oh = msgb_l2(msg);
+	struct abis_om_fom_hdr *foh;
+	const struct oml_step *step;
+	size_t len;
+
+	if (msgb_l2len(msg) < sizeof(*oh) + sizeof(*foh))
+		return;
+
+	if (oh->mdisc == ABIS_OM_MDISC_MANUF) {
+		if (msgb_l2len(msg) < sizeof(*oh) + 1 + oh->data[0] + sizeof(*foh))
+			return;
+		foh = (struct abis_om_fom_hdr *) (oh->data + 1 + oh->data[0]);
+	} else {
+		foh = (struct abis_om_fom_hdr *) oh->data;
+	}
+	len = msg->tail - foh->data;
+
+	if (foh->msg_type == NM_MT_STATECHG_EVENT_REP) {
+		oml_rx_statechg(foh, len);
+		return;
+	}
+
+	if (g.cur_step >= g.num_steps)
+		return;
+	step = &g.steps[g.cur_step];
+	if (foh->obj_class != step->obj_class ||
+	    memcmp(&foh->obj_inst, &step->inst, sizeof(step->inst)))
+		return;
+
+	if (foh->msg_type == step->msg_type + 1) {
+		/* ACK */
+		g.cur_step++;
+		oml_next_step();
+	} else if (foh->msg_type == step->msg_type + 2) {
+		LOGP(DLOAD, LOGL_FATAL, "Rx %s for %s\n",
+		     get_value_string(abis_nm_msgtype_names, foh->msg_type), abis_nm_dump_foh(foh));
+		exit(1);
+	}
+}
+
+/*
+ * RSL
+ */
+
+static struct msgb *rsl_msgb_alloc(void)
+{
+	struct msgb *msg = msgb_alloc_headroom(512, 128, "RSL");
+	OSMO_ASSERT(msg);
+	return msg;
+}
+
+static void rsl_send(struct load_trx *trx, struct msgb *msg)
+{
+	msg->dst = trx->rsl_link;
+	abis_sendmsg(msg);
+}
+
+static void rsl_push_dch_hdr(struct msgb *msg, uint8_t msg_type, uint8_t chan_nr)
+{
+	struct abis_rsl_dchan_hdr *dch;
+
+	dch = (struct abis_rsl_dchan_hdr *) msgb_push(msg, sizeof(*dch));
+	dch->c.msg_discr = ABIS_RSL_MDISC_DED_CHAN;
+	dch->c.msg_type = msg_type;
+	dch->ie_chan = RSL_IE_CHAN_NR;
+	dch->chan_nr = chan_nr;
+	msg->l2h = (uint8_t *) dch;
+}
+
+static void rsl_push_cch_hdr(struct msgb *msg, uint8_t msg_type, uint8_t chan_nr)
+{
+	struct abis_rsl_cchan_hdr *cch;
+
+	cch = (struct abis_rsl_cchan_hdr *) msgb_push(msg, sizeof(*cch));
+	cch->c.msg_discr = ABIS_RSL_MDISC_COM_CHAN;
+	cch->c.msg_type = msg_type;
+	cch->ie_chan = RSL_IE_CHAN_NR;
+	cch->chan_nr = chan_nr;
+	msg->l2h = (uint8_t *) cch;
+}
+
+static void tx_chan_act(struct load_lchan *lchan)
+{
+	struct rsl_ie_chan_mode cm = { 0 };
+	struct msgb *msg = rsl_msgb_alloc();
+
+	if (lchan->sdcch) {
+		cm.spd_ind = RSL_CMOD_SPD_SIGN;
+		cm.chan_rt = RSL_CMOD_CRT_SDCCH;
+	} else {
+		cm.spd_ind = RSL_CMOD_SPD_SPEECH;
+		cm.chan_rt = RSL_CMOD_CRT_TCH_Bm;
+		cm.chan_rate = RSL_CMOD_SP_GSM1;
+	}
+
+	msgb_tv_put(msg, RSL_IE_ACT_TYPE, RSL_ACT_INTRA_NORM_ASS);
+	msgb_tlv_put(msg, RSL_IE_CHAN_MODE, sizeof(cm), (const uint8_t *) &cm);
+	msgb_tv_put(msg, RSL_IE_BS_POWER, 0);
+	msgb_tv_put(msg, RSL_IE_MS_POWER, 0);
+	msgb_tv_put(msg, RSL_IE_TIMING_ADVANCE, 0);
+	rsl_push_dch_hdr(msg, RSL_MT_CHAN_ACTIV, lchan->chan_nr);
+
+	lchan->state = LCHAN_ACT_PEND;
+	clock_gettime(CLOCK_MONOTONIC, &lchan->t_tx);
+	rsl_send(lchan->trx, msg);
+}
+
+static void tx_rf_chan_rel(struct load_lchan *lchan)
+{
+	struct msgb *msg = rsl_msgb_alloc();
+
+	rsl_push_dch_hdr(msg, RSL_MT_RF_CHAN_REL, lchan->chan_nr);
+
+	lchan->state = LCHAN_REL_PEND;
+	clock_gettime(CLOCK_MONOTONIC, &lchan->t_tx);
+	rsl_send(lchan->trx, msg);
+}
+
+static void hold_timer_cb(void *data)
+{
+	tx_rf_chan_rel(data);
+}
+
+static void tx_paging_cmd(void)
+{
+	struct msgb *msg = rsl_msgb_alloc();
+	uint8_t mi[5];
+
+	/* TMSI, a new one for each PAGING CMD */
+	mi[0] = 0xf0 | GSM_MI_TYPE_TMSI;
+	osmo_store32be(g.tmsi++, &mi[1]);
+
+	msgb_tv_put(msg, RSL_IE_PAGING_GROUP, 0);
+	msgb_tlv_put(msg, RSL_IE_MS_IDENTITY, sizeof(mi), mi);
+	rsl_push_cch_hdr(msg, RSL_MT_PAGING_CMD, RSL_CHAN_PCH_AGCH);
+	rsl_send(&g.trx[0], msg);
+}
+
+static void tx_imm_ass_cmd(void)
+{
+	struct msgb *msg = rsl_msgb_alloc();
+	uint8_t buf[GSM_MACBLOCK_LEN];
+	struct gsm48_imm_ass *ia = (struct gsm48_imm_ass *) buf;
+
+	memset(buf, 0x2b, sizeof(buf));
+	memset(ia, 0, sizeof(*ia));
+	ia->l2_plen = GSM48_LEN2PLEN(sizeof(*ia) - 1);
+	ia->proto_discr = GSM48_PDISC_RR;
+	ia->msg_type = GSM48_MT_RR_IMM_ASS;
+	ia->page_mode = GSM48_PM_SAME;
+	/* A TCH/F on the BCCH timeslot does not exist, so the BTS does not
+	 * hold the message back waiting for the channel (Early IA) but
+	 * queues it on the AGCH right away. */
+	ia->chan_desc.chan_nr = RSL_CHAN_Bm_ACCH | 0;
+	ia->chan_desc.h0.tsc = cfg.bsic & 0x07;
+	ia->chan_desc.h0.arfcn_high = cfg.arfcn >> 8;
+	ia->chan_desc.h0.arfcn_low = cfg.arfcn & 0xff;
+	ia->req_ref.ra = g.ra++;
+
+	msgb_tlv_put(msg, RSL_IE_FULL_IMM_ASS_INFO, sizeof(buf), buf);
+	rsl_push_cch_hdr(msg, RSL_MT_IMMEDIATE_ASSIGN_CMD, RSL_CHAN_PCH_AGCH);
+	rsl_send(&g.trx[0], msg);
+}
+
+static struct load_lchan *lchan_lookup(struct load_trx *trx, uint8_t chan_nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < trx->num_lchan; i++) {
+		if (trx->lchan[i].chan_nr == chan_nr)
+			return &trx->lchan[i];
+	}
+	return NULL;
+}
+
+/* Round robin over all TRX, so that the load is spread evenly */
+static struct load_lchan *lchan_find_idle(void)
+{
+	static unsigned int next;
+	unsigned int i, num = 0;
+
+	for (i = 0; i < cfg.num_trx; i++)
+		num += g.trx[i].num_lchan;
+
+	for (i = 0; i < num; i++) {
+		unsigned int idx = (next + i) % num;
+		unsigned int t = 0;
+		struct load_lchan *lchan;
+
+		while (idx >= g.trx[t].num_lchan)
+			idx -= g.trx[t++].num_lchan;
+		lchan = &g.trx[t].lchan[idx];
+		if (lchan->state == LCHAN_IDLE) {
+			next = (next + i + 1) % num;
+			return lchan;
+		}
+	}
+
+	return NULL;
+}
+
+static void rsl_rx_dchan(struct load_trx *trx, struct msgb *msg)
+{
+	struct abis_rsl_dchan_hdr *dch = msgb_l2(msg);
+	struct load_lchan *lchan;
+
+	if (msgb_l2len(msg) < sizeof(*dch))
+		return;
+	if (!(lchan = lchan_lookup(trx, dch->chan_nr))) {
+		g.other++;
+		return;
+	}
+
+	switch (dch->c.msg_type) {
+	case RSL_MT_CHAN_ACTIV_ACK:
+		if (lchan->state != LCHAN_ACT_PEND)
+			break;
+		lat_add(&g.lat_act, &lchan->t_tx);
+		lchan->state = LCHAN_ACTIVE;
+		if (cfg.hold_ms && !g.draining)
+			osmo_timer_schedule(&lchan->hold_timer, cfg.hold_ms / 1000, (cfg.hold_ms % 1000) * 1000);
+		else
+			tx_rf_chan_rel(lchan);
+		break;
+	case RSL_MT_CHAN_ACTIV_NACK:
+		g.act_nack++;
+		lchan->state = LCHAN_IDLE;
+		break;
+	case RSL_MT_RF_CHAN_REL_ACK:
+		if (lchan->state != LCHAN_REL_PEND)
+			break;
+		lat_add(&g.lat_rel, &lchan->t_tx);
+		lchan->state = LCHAN_IDLE;
+		break;
+	default:
+		/* CONN FAIL IND, MEAS RES, ... */
+		g.other++;
+		break;
+	}
+}
+
+static void rsl_rx_cchan(struct load_trx *trx, struct msgb *msg)
+{
+	struct abis_rsl_cchan_hdr *cch = msgb_l2(msg);
+
+	if (msgb_l2len(msg) < sizeof(*cch))
+		return;
+
+	switch (cch->c.msg_type) {
+	case RSL_MT_DELETE_IND:
+		g.delete_ind++;
+		break;
+	case RSL_MT_CCCH_LOAD_IND:
+		if (cch->chan_nr == RSL_CHAN_RACH)
+			g.ccch_load_rach++;
+		else
+			g.ccch_load_pch++;
+		break;
+	default:
+		g.other++;
+		break;
+	}
+}
+
+static void rsl_rx(struct load_trx *trx, struct msgb *msg)
+{
+	struct abis_rsl_common_hdr *rh = msgb_l2(msg);
+
+	if (msgb_l2len(msg) < sizeof(*rh))
+		return;
+
+	switch (rh->msg_discr & 0xfe) {
+	case ABIS_RSL_MDISC_DED_CHAN:
+		rsl_rx_dchan(trx, msg);
+		break;
+	case ABIS_RSL_MDISC_COM_CHAN:
+		rsl_rx_cchan(trx, msg);
+		break;
+	case ABIS_RSL_MDISC_TRX:
+		if (rh->msg_type == RSL_MT_ERROR_REPORT)
+			g.err_rep++;
+		break;
+	default:
+		g.other++;
+		break;
+	}
+}
+
+/*
+ * CTRL: a blocking GET is good enough before and after the run
+ */
+
+static int ctrl_get(int fd, unsigned int id, const char *var, unsigned long long *val)
+{
+	char buf[512];
+	uint8_t hdr[3];
+	int len, rc;
+	char *p;
+
+	len = snprintf(buf + 4, sizeof(buf) - 4, "GET %u rate_ctr.abs.bts.0.%s", id, var);
+	if (len < 0 || len >= (int)sizeof(buf) - 4)
+		return -EINVAL;
+	osmo_store16be(len + 1, buf);
+	buf[2] = IPAC_PROTO_OSMO;
+	buf[3] = IPAC_PROTO_EXT_CTRL;
+	if (write(fd, buf, len + 4) != len + 4)
+		return -EIO;
+
+	if (read(fd, hdr, sizeof(hdr)) != sizeof(hdr))
+		return -EIO;
+	len = osmo_load16be(hdr);
+	if (len < 1 || len >= (int)sizeof(buf))
+		return -EIO;
+	for (rc = 0; rc < len; ) {
+		int n = read(fd, buf + rc, len - rc);
+		if (n <= 0)
+			return -EIO;
+		rc += n;
+	}
+	buf[len] = '\0';
+
+	/* "\x00GET_REPLY <id> <var> <value>" or "\x00ERROR <id> <reason>" */
+	if (strncmp(buf + 1, "GET_REPLY ", 10))
+		return -ENOENT;
+	if (!(p = strrchr(buf + 1, ' ')))
+		return -EIO;
+	*val = strtoull(p + 1, NULL, 10);
+	return 0;
+}
+
+static int ctrl_get_all(unsigned long long *vals)
+{
+	struct timeval tv = { .tv_sec = 1 };
+	unsigned int i, n = 0;
+	int fd, rc = 0;
+
+	fd = osmo_sock_init(AF_INET, SOCK_STREAM, IPPROTO_TCP, cfg.ctrl_host, cfg.ctrl_port,
+			    OSMO_SOCK_F_CONNECT);
+	if (fd < 0)
+		return fd;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	for (i = 0; i < ARRAY_SIZE(default_ctrs) && rc == 0; i++)
+		rc = ctrl_get(fd, n++, default_ctrs[i], &vals[i]);
+	for (i = 0; i < cfg.num_extra_ctrs && rc == 0; i++)
+		rc = ctrl_get(fd, n++, cfg.extra_ctrs[i], &vals[ARRAY_SIZE(default_ctrs) + i]);
+
+	close(fd);
+	return rc;
+}
+
+/*
+ * Load phase
+ */
+
+/* Pick the procedure that lags most behind its share of the mix */
+static enum load_proc next_proc(void)
+{
+	enum load_proc best = PROC_CHAN_ACT;
+	double best_ratio = -1;
+	unsigned int i;
+
+	for (i = 0; i < _NUM_PROC; i++) {
+		double ratio;
+
+		if (!cfg.weight[i])
+			continue;
+		ratio = (double)g.sent[i] / cfg.weight[i];
+		if (best_ratio < 0 || ratio < best_ratio) {
+			best = i;
+			best_ratio = ratio;
+		}
+	}
+
+	return best;
+}
+
+static void load_tx_one(void)
+{
+	enum load_proc proc = next_proc();
+	struct load_lchan *lchan;
+
+	switch (proc) {
+	case PROC_CHAN_ACT:
+		if (!(lchan = lchan_find_idle())) {
+			/* all busy: the BTS does not keep up (or -H is too long) */
+			g.no_lchan++;
+			break;
+		}
+		tx_chan_act(lchan);
+		break;
+	case PROC_PAGING:
+		tx_paging_cmd();
+		break;
+	case PROC_IMM_ASS:
+		tx_imm_ass_cmd();
+		break;
+	default:
+		OSMO_ASSERT(0);
+	}
+
+	g.sent[proc]++;
+}
+
+static bool lchans_idle(void)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < cfg.num_trx; i++) {
+		for (j = 0; j < g.trx[i].num_lchan; j++) {
+			if (g.trx[i].lchan[j].state != LCHAN_IDLE)
+				return false;
+		}
+	}
+	return true;
+}
+
+static void print_lat(const char *name, struct lat_samples *l)
+{
+	qsort(l->us, l->num, sizeof(*l->us), cmp_u32);
+	printf("%-16s %10zu responses, latency p50 %7.2f ms, p90 %7.2f ms, p99 %7.2f ms, max %7.2f ms\n",
+	       name, l->num, lat_pct_ms(l, 50), lat_pct_ms(l, 90), lat_pct_ms(l, 99), lat_pct_ms(l, 100));
+}
+
+static void load_report(void)
+{
+	unsigned long long ctr_after[ARRAY_SIZE(default_ctrs) + MAX_EXTRA_CTRS];
+	double secs = (ts_us(&g.t_stop) - ts_us(&g.t_start)) / 1e6;
+	unsigned int i, j;
+
+	printf("\n%u TRX, target rate %u/s, %.1f s\n", cfg.num_trx, cfg.rate, secs);
+	for (i = 0; i < _NUM_PROC; i++) {
+		printf("%-16s %10llu sent, %9.1f/s\n", get_value_string(load_proc_names, i),
+		       g.sent[i], secs > 0 ? g.sent[i] / secs : 0);
+	}
+	printf("\n");
+	print_lat("CHAN ACTIV", &g.lat_act);
+	print_lat("RF CHAN REL", &g.lat_rel);
+	printf("CHAN ACTIV NACK %llu, no idle lchan %llu, unanswered at the end %llu\n",
+	       g.act_nack, g.no_lchan, g.rel_pend);
+	printf("DELETE IND %llu, CCCH LOAD IND (PCH) %llu, CCCH LOAD IND (RACH) %llu, "
+	       "ERROR REPORT %llu, other %llu\n", g.delete_ind, g.ccch_load_pch,
+	       g.ccch_load_rach, g.err_rep, g.other);
+
+	if (!g.ctr_valid || ctrl_get_all(ctr_after) < 0) {
+		printf("\nBTS counters not available (CTRL at %s:%u)\n", cfg.ctrl_host, cfg.ctrl_port);
+		return;
+	}
+
+	printf("\nBTS counters (delta):\n");
+	for (i = 0; i < ARRAY_SIZE(default_ctrs); i++)
+		printf("  %-24s %10llu\n", default_ctrs[i], ctr_after[i] - g.ctr_before[i]);
+	for (j = 0; j < cfg.num_extra_ctrs; j++, i++)
+		printf("  %-24s %10llu\n", cfg.extra_ctrs[j], ctr_after[i] - g.ctr_before[i]);
+}
+
+static void load_finish(int rc)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < cfg.num_trx; i++) {
+		for (j = 0; j < g.trx[i].num_lchan; j++) {
+			if (g.trx[i].lchan[j].state != LCHAN_IDLE)
+				g.rel_pend++;
+		}
+	}
+
+	load_report();
+	exit(rc);
+}
+
+static void tick_cb(void *data)
+{
+	struct timespec now;
+	unsigned int i, j;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (g.draining) {
+		if (lchans_idle() || ts_us(&now) - ts_us(&g.t_stop) >= DRAIN_TIMEOUT_S * 1000000ULL)
+			load_finish(0);
+		osmo_timer_schedule(&g.tick_timer, 0, TICK_US);
+		return;
+	}
+
+	if (ts_us(&now) - ts_us(&g.t_start) >= cfg.duration * 1000000ULL) {
+		g.t_stop = now;
+		g.draining = true;
+		/* release the held channels right away */
+		for (i = 0; i < cfg.num_trx; i++) {
+			for (j = 0; j < g.trx[i].num_lchan; j++) {
+				struct load_lchan *lchan = &g.trx[i].lchan[j];
+				if (lchan->state == LCHAN_ACTIVE && osmo_timer_pending(&lchan->hold_timer)) {
+					osmo_timer_del(&lchan->hold_timer);
+					tx_rf_chan_rel(lchan);
+				}
+			}
+		}
+		osmo_timer_schedule(&g.tick_timer, 0, TICK_US);
+		return;
+	}
+
+	g.credit += cfg.rate * (ts_us(&now) - ts_us(&g.t_last_tick)) / 1e6;
+	g.t_last_tick = now;
+	while (g.credit >= 1) {
+		load_tx_one();
+		g.credit -= 1;
+	}
+
+	osmo_timer_schedule(&g.tick_timer, 0, TICK_US);
+}
+
+static void load_start(void)
+{
+	if (g.running)
+		return;
+	g.running = true;
+
+	g.ctr_valid = ctrl_get_all(g.ctr_before) == 0;
+	if (!g.ctr_valid)
+		LOGP(DLOAD, LOGL_ERROR, "Cannot read the BTS counters via CTRL at %s:%u\n",
+		     cfg.ctrl_host, cfg.ctrl_port);
+
+	LOGP(DLOAD, LOGL_NOTICE, "BTS is up, generating load for %u s\n", cfg.duration);
+	clock_gettime(CLOCK_MONOTONIC, &g.t_start);
+	g.t_last_tick = g.t_start;
+	osmo_timer_setup(&g.tick_timer, tick_cb, NULL);
+	osmo_timer_schedule(&g.tick_timer, 0, TICK_US);
+}
+
+/*
+ * A-bis link
+ */
+
+static struct e1inp_sign_link *sign_link_up(void *unit, struct e1inp_line *line,
+					    enum e1inp_sign_type type)
+{
+	struct ipaccess_unit *dev = unit;
+	struct e1inp_ts *sign_ts;
+	struct load_trx *trx;
+
+	switch (type) {
+	case E1INP_SIGN_OML:
+		if (g.oml_link) {
+			LOGP(DLOAD, LOGL_ERROR, "Second OML connection, ignoring\n");
+			return NULL;
+		}
+		LOGP(DLOAD, LOGL_NOTICE, "OML link up (site_id=%u), configuring the BTS\n", dev->site_id);
+		sign_ts = e1inp_line_ipa_oml_ts(line);
+		e1inp_ts_config_sign(sign_ts, line);
+		g.oml_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_OML, NULL, IPAC_PROTO_OML, 0);
+		oml_next_step();
+		return g.oml_link;
+	default:
+		if (dev->trx_id >= cfg.num_trx) {
+			LOGP(DLOAD, LOGL_ERROR, "RSL link up for unknown TRX%u\n", dev->trx_id);
+			return NULL;
+		}
+		LOGP(DLOAD, LOGL_NOTICE, "RSL link up for TRX%u\n", dev->trx_id);
+		trx = &g.trx[dev->trx_id];
+		sign_ts = e1inp_line_ipa_rsl_ts(line, dev->trx_id);
+		e1inp_ts_config_sign(sign_ts, line);
+		trx->rsl_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_RSL, NULL, 0, 0);
+		if (!g.running && load_ready()) {
+			osmo_timer_del(&g.oml_timer);
+			load_start();
+		}
+		return trx->rsl_link;
+	}
+}
+
+static void sign_link_down(struct e1inp_line *line)
+{
+	LOGP(DLOAD, LOGL_FATAL, "A-bis link to the BTS lost\n");
+	if (g.running) {
+		clock_gettime(CLOCK_MONOTONIC, &g.t_stop);
+		g.ctr_valid = false;
+		load_finish(1);
+	}
+	exit(1);
+}
+
+static int sign_link_cb(struct msgb *msg)
+{
+	struct e1inp_sign_link *link = msg->dst;
+	unsigned int i;
+
+	if (link == g.oml_link) {
+		oml_rx(msg);
+	} else {
+		for (i = 0; i < cfg.num_trx; i++) {
+			if (link == g.trx[i].rsl_link) {
+				rsl_rx(&g.trx[i], msg);
+				break;
+			}
+		}
+	}
+
+	msgb_free(msg);
+	return 0;
+}
+
+static struct e1inp_line_ops line_ops = {
+	.cfg = {
+		.ipa = {
+			.role	= E1INP_LINE_R_BSC,
+		},
+	},
+	.sign_link_up	= sign_link_up,
+	.sign_link_down	= sign_link_down,
+	.sign_link	= sign_link_cb,
+};
+
+static void trx_init(struct load_trx *trx, uint8_t nr)
+{
+	unsigned int i;
+
+	trx->nr = nr;
+	trx->num_lchan = 0;
+
+	if (nr == 0) {
+		for (i = 0; i < 4; i++) {
+			trx->lchan[trx->num_lchan++] = (struct load_lchan) {
+				.chan_nr = RSL_CHAN_SDCCH4_ACCH | (i << 3),
+				.sdcch = true,
+			};
+		}
+	} else {
+		trx->lchan[trx->num_lchan++] = (struct load_lchan) {
+			.chan_nr = RSL_CHAN_Bm_ACCH | 0,
+		};
+	}
+	for (i = 1; i < NUM_TS; i++) {
+		trx->lchan[trx->num_lchan++] = (struct load_lchan) {
+			.chan_nr = RSL_CHAN_Bm_ACCH | i,
+		};
+	}
+
+	for (i = 0; i < trx->num_lchan; i++) {
+		trx->lchan[i].trx = trx;
+		osmo_timer_setup(&trx->lchan[i].hold_timer, hold_timer_cb, &trx->lchan[i]);
+	}
+}
+
+static int parse_mix(char *str)
+{
+	char *saveptr = NULL, *tok;
+
+	memset(cfg.weight, 0, sizeof(cfg.weight));
+	while ((tok = strtok_r(str, ",", &saveptr))) {
+		char *eq = strchr(tok, '=');
+		int proc;
+
+		str = NULL;
+		if (eq)
+			*eq = '\0';
+		proc = get_string_value(load_proc_names, tok);
+		if (proc < 0) {
+			fprintf(stderr, "Unknown procedure: '%s'\n", tok);
+			return -EINVAL;
+		}
+		cfg.weight[proc] = eq ? atoi(eq + 1) : 1;
+	}
+
+	return 0;
+}
+
+static void print_help(const char *prog_name)
+{
+	printf("Usage: %s [options]\n", prog_name);
+	printf("Act as a BSC: wait for an osmo-bts to connect via A-bis/IP, bring it up via OML\n"
+	       "(TS0 of TRX0 CCCH+SDCCH/4, all other timeslots TCH/F) and drive a mix of RSL\n"
+	       "procedures against it at a fixed rate.\n\n");
+	printf("  -h --help			This text.\n");
+	printf("  -b --bind IP			Listen for OML/RSL on IP (default %s).\n", cfg.bind_ip);
+	printf("  -t --trx NUM			Number of TRX to configure (default %u).\n", cfg.num_trx);
+	printf("  -a --arfcn ARFCN		ARFCN of TRX0; TRXn uses ARFCN+2n (default %u).\n", cfg.arfcn);
+	printf("  -r --rate NUM			RSL procedures started per second (default %u).\n", cfg.rate);
+	printf("  -d --duration SECS		Duration of the load phase (default %u).\n", cfg.duration);
+	printf("  -m --mix PROC=W[,PROC=W]	Weights of the procedures: chan-act, paging,\n"
+	       "				imm-ass (default chan-act=1,paging=1,imm-ass=1).\n");
+	printf("  -H --hold MS			Keep activated channels for MS milliseconds\n"
+	       "				before releasing them (default %u).\n", cfg.hold_ms);
+	printf("  -c --ctrl HOST[:PORT]		CTRL interface of the BTS (default %s:%u).\n",
+	       cfg.ctrl_host, cfg.ctrl_port);
+	printf("  -C --counter NAME		Also report the BTS counter NAME (repeatable).\n");
+}
+
+static void parse_cmdline(int argc, char **argv)
+{
+	while (1) {
+		int option_index = 0, c;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"bind", 1, 0, 'b'},
+			{"trx", 1, 0, 't'},
+			{"arfcn", 1, 0, 'a'},
+			{"rate", 1, 0, 'r'},
+			{"duration", 1, 0, 'd'},
+			{"mix", 1, 0, 'm'},
+			{"hold", 1, 0, 'H'},
+			{"ctrl", 1, 0, 'c'},
+			{"counter", 1, 0, 'C'},
+			{0}
+		};
+		char *colon;
+
+		c = getopt_long(argc, argv, "hb:t:a:r:d:m:H:c:C:", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help(argv[0]);
+			exit(0);
+		case 'b':
+			cfg.bind_ip = optarg;
+			break;
+		case 't':
+			cfg.num_trx = atoi(optarg);
+			if (cfg.num_trx < 1 || cfg.num_trx > MAX_TRX) {
+				fprintf(stderr, "Number of TRX must be 1..%u\n", MAX_TRX);
+				exit(1);
+			}
+			break;
+		case 'a':
+			cfg.arfcn = atoi(optarg);
+			break;
+		case 'r':
+			cfg.rate = atoi(optarg);
+			break;
+		case 'd':
+			cfg.duration = atoi(optarg);
+			break;
+		case 'm':
+			if (parse_mix(optarg) < 0)
+				exit(1);
+			break;
+		case 'H':
+			cfg.hold_ms = atoi(optarg);
+			break;
+		case 'c':
+			if ((colon = strchr(optarg, ':'))) {
+				*colon = '\0';
+				cfg.ctrl_port = atoi(colon + 1);
+			}
+			cfg.ctrl_host = optarg;
+			break;
+		case 'C':
+			if (cfg.num_extra_ctrs >= MAX_EXTRA_CTRS) {
+				fprintf(stderr, "Too many counters\n");
+				exit(1);
+			}
+			cfg.extra_ctrs[cfg.num_extra_ctrs++] = optarg;
+			break;
+		default:
+			/* catch unknown options *as well as* missing arguments. */
+			fprintf(stderr, "Error in command line options. Exiting.\n");
+			exit(-1);
+		}
+	}
+
+	if (optind < argc) {
+		print_help(argv[0]);
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+
+	parse_cmdline(argc, argv);
+
+	g.ctx = talloc_named_const(NULL, 1, "rsl-load");
+	msgb_talloc_ctx_init(g.ctx, 0);
+	osmo_init_logging2(g.ctx, &load_log_info);
+	log_set_print_category(osmo_stderr_target, 1);
+
+	libosmo_abis_init(g.ctx);
+
+	for (i = 0; i < cfg.num_trx; i++)
+		trx_init(&g.trx[i], i);
+	oml_build_steps();
+	osmo_timer_setup(&g.oml_timer, oml_timer_cb, NULL);
+
+	g.line = e1inp_line_create(0, "ipa");
+	OSMO_ASSERT(g.line);
+	line_ops.cfg.ipa.addr = cfg.bind_ip;
+	e1inp_line_bind_ops(g.line, &line_ops);
+	if (e1inp_line_update(g.line) < 0) {
+		fprintf(stderr, "Cannot listen for A-bis/IP on %s\n", cfg.bind_ip);
+		exit(1);
+	}
+
+	LOGP(DLOAD, LOGL_NOTICE, "Waiting for the BTS to connect to %s\n", cfg.bind_ip);
+
+	while (1)
+		osmo_select_main(0);
+
+	return EXIT_SUCCESS;
+}
@@ -25,7 +25,11 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
+#include <osmocom/core/talloc.h>
 #include <osmocom/core/utils.h>
 
 #include <osmo-bts/gsm_data.h>
@@ -364,59 +368,184 @@ static int calib_eeprom_read(const struct calib_file_desc *desc, SuperFemto_Prim
 	return 0;
 }
 
+/* is calibration file \a idx relevant for the supported bands? */
+static bool calib_file_needed(uint32_t band_mask, int idx)
+{
+	int band = band_femto2osmo(calib_files[idx].band);
+
+	return band >= 0 && (band_mask & band);
+}
+
 /* determine next calibration file index based on supported bands */
 static int next_calib_file_idx(uint32_t band_mask, int last_idx)
 {
 	int i;
 
 	for (i = last_idx+1; i < ARRAY_SIZE(calib_files); i++) {
-		int band = band_femto2osmo(calib_files[i].band);
-		if (band < 0)
-			continue;
-		if (band_mask & band)
+		if (calib_file_needed(band_mask, i))
 			return i;
 	}
 	return -1;
 }
 
-/* iteratively download the calibration data into the L1 */
+/*
+ * Binary cache of the parsed calibration files.  Parsing the text tables
+ * (one fscanf() per value) takes a noticeable amount of time on the ARM
+ * core, so the resulting primitives are stored along with the mtime and
+ * size of the file they were parsed from.  Entries are only used if the
+ * file is unchanged; the cache is rewritten whenever a file was parsed.
+ */
 
-static int calib_send_compl_cb(struct gsm_bts_trx *trx, struct msgb *l1_msg,
-			       void *data);
+#define CALIB_CACHE_MAGIC	0x53424331	/* "SBC1" */
 
-/* send the calibration table for a single specified file */
-static int calib_file_send(struct femtol1_hdl *fl1h,
-			   const struct calib_file_desc *desc)
+struct calib_cache_hdr {
+	uint32_t magic;
+	uint32_t api_version;		/* SUPERFEMTO_API_VERSION */
+	uint32_t prim_size;		/* sizeof(SuperFemto_Prim_t) */
+	uint32_t num_entries;
+};
+
+struct calib_cache_entry {
+	uint32_t file_idx;
+	uint32_t valid;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t size;
+	SuperFemto_Prim_t prim;		/* before calib_fixup_rx() */
+};
+
+static void calib_cache_key(const struct stat *sb, struct calib_cache_entry *e)
 {
-	struct calib_send_state *st = &fl1h->st;
-	struct msgb *msg;
-	char *calib_path = fl1h->phy_inst->u.sysmobts.calib_path;
+	e->mtime_sec = sb->st_mtim.tv_sec;
+	e->mtime_nsec = sb->st_mtim.tv_nsec;
+	e->size = sb->st_size;
+}
+
+/* read the cache into \a cache (ARRAY_SIZE(calib_files) entries), with
+ * valid=0 for entries which are missing or do not match the header */
+static void calib_cache_read(const char *fname, struct calib_cache_entry *cache)
+{
+	struct calib_cache_hdr hdr;
+	FILE *in;
+	size_t n;
+
+	in = fopen(fname, "r");
+	if (!in)
+		return;
+
+	if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+	    hdr.magic != CALIB_CACHE_MAGIC ||
+	    hdr.api_version != SUPERFEMTO_API_VERSION ||
+	    hdr.prim_size != sizeof(SuperFemto_Prim_t) ||
+	    hdr.num_entries != ARRAY_SIZE(calib_files)) {
+		LOGP(DL1C, LOGL_NOTICE, "Ignoring stale calibration cache '%s'\n", fname);
+		fclose(in);
+		return;
+	}
+
+	n = fread(cache, sizeof(*cache), ARRAY_SIZE(calib_files), in);
+	if (n != ARRAY_SIZE(calib_files)) {
+		LOGP(DL1C, LOGL_NOTICE, "Ignoring truncated calibration cache '%s'\n", fname);
+		memset(cache, 0, sizeof(*cache) * ARRAY_SIZE(calib_files));
+	}
+	fclose(in);
+}
+
+/* write the cache atomically, so that a crash never leaves a partial one */
+static void calib_cache_write(const char *fname, const struct calib_cache_entry *cache)
+{
+	const struct calib_cache_hdr hdr = {
+		.magic = CALIB_CACHE_MAGIC,
+		.api_version = SUPERFEMTO_API_VERSION,
+		.prim_size = sizeof(SuperFemto_Prim_t),
+		.num_entries = ARRAY_SIZE(calib_files),
+	};
+	char tmp[PATH_MAX];
+	FILE *out;
 	int rc;
 
-	msg = sysp_msgb_alloc();
+	snprintf(tmp, sizeof(tmp), "%s.tmp", fname);
+	out = fopen(tmp, "w");
+	if (!out) {
+		LOGP(DL1C, LOGL_NOTICE, "Unable to write calibration cache '%s': %s\n",
+		     tmp, strerror(errno));
+		return;
+	}
 
-	if (calib_path)
-		rc = calib_file_read(calib_path, desc, msgb_sysprim(msg));
-	else
-		rc = calib_eeprom_read(desc, msgb_sysprim(msg));
-	if (rc < 0) {
-		msgb_free(msg);
-
-		/* still, we'd like to continue trying to load
-		 * calibration for all other bands */
-		st->last_file_idx = next_calib_file_idx(fl1h->hw_info.band_support,
-						st->last_file_idx);
-		if (st->last_file_idx >= 0)
-			return calib_file_send(fl1h,
-					       &calib_files[st->last_file_idx]);
-		else
-			return rc;
+	rc = fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+	     fwrite(cache, sizeof(*cache), ARRAY_SIZE(calib_files), out) == ARRAY_SIZE(calib_files);
+	if (fclose(out) != 0)
+		rc = 0;
+	if (!rc || rename(tmp, fname) < 0) {
+		LOGP(DL1C, LOGL_NOTICE, "Unable to write calibration cache '%s'\n", fname);
+		unlink(tmp);
+		return;
+	}
+
+	LOGP(DL1C, LOGL_INFO, "Calibration cache '%s' updated\n", fname);
+}
+
+/* parse the calibration files of all supported bands, using the cache
+ * for those which did not change since it was written */
+static void calib_files_read(struct femtol1_hdl *fl1h, struct calib_cache_entry *cache)
+{
+	const char *calib_path = fl1h->phy_inst->u.sysmobts.calib_path;
+	const char *cache_fname = fl1h->phy_inst->u.sysmobts.calib_cache;
+	struct calib_cache_entry e;
+	char fname[PATH_MAX];
+	struct stat sb;
+	bool dirty = false;
+	int i;
+
+	if (cache_fname)
+		calib_cache_read(cache_fname, cache);
+
+	for (i = 0; i < ARRAY_SIZE(calib_files); i++) {
+		if (!calib_file_needed(fl1h->hw_info.band_support, i))
+			continue;
+
+		snprintf(fname, sizeof(fname), "%s/%s", calib_path, calib_files[i].fname);
+		if (stat(fname, &sb) < 0) {
+			LOGP(DL1C, LOGL_ERROR,
+				"Failed to open '%s' for calibration data.\n", fname);
+			cache[i].valid = 0;
+			continue;
+		}
+
+		memset(&e, 0, sizeof(e));
+		calib_cache_key(&sb, &e);
+		if (cache[i].valid && cache[i].file_idx == i &&
+		    cache[i].mtime_sec == e.mtime_sec && cache[i].mtime_nsec == e.mtime_nsec &&
+		    cache[i].size == e.size) {
+			LOGP(DL1C, LOGL_DEBUG, "Using cached calibration table %s\n",
+			     calib_files[i].fname);
+			continue;
+		}
+
+		e.file_idx = i;
+		e.valid = calib_file_read(calib_path, &calib_files[i], &e.prim) == 0;
+		cache[i] = e;
+		dirty = true;
 	}
-	calib_fixup_rx(fl1h, msgb_sysprim(msg));
 
-	return l1if_req_compl(fl1h, msg, calib_send_compl_cb, NULL);
+	if (cache_fname && dirty)
+		calib_cache_write(cache_fname, cache);
+}
+
+static void calib_eeprom_read_all(struct femtol1_hdl *fl1h, struct calib_cache_entry *cache)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(calib_files); i++) {
+		if (!calib_file_needed(fl1h->hw_info.band_support, i))
+			continue;
+		cache[i].file_idx = i;
+		cache[i].valid = calib_eeprom_read(&calib_files[i], &cache[i].prim) == 0;
+	}
 }
 
+/* download the calibration data into the L1 */
+
 /* completion callback after every SetCalibTbl is confirmed */
 static int calib_send_compl_cb(struct gsm_bts_trx *trx, struct msgb *l1_msg,
 				void *data)
@@ -424,18 +553,15 @@ static int calib_send_compl_cb(struct gsm_bts_trx *trx, struct msgb *l1_msg,
 	struct femtol1_hdl *fl1h = trx_femtol1_hdl(trx);
 	struct calib_send_state *st = &fl1h->st;
 	char *calib_path = fl1h->phy_inst->u.sysmobts.calib_path;
+	const struct calib_file_desc *desc = data;
 
 	LOGP(DL1C, LOGL_NOTICE, "L1 calibration table %s loaded (src: %s)\n",
-		calib_files[st->last_file_idx].fname,
-		calib_path ? "file" : "eeprom");
+		desc->fname, calib_path ? "file" : "eeprom");
 
 	msgb_free(l1_msg);
 
-	st->last_file_idx = next_calib_file_idx(fl1h->hw_info.band_support,
-						st->last_file_idx);
-	if (st->last_file_idx >= 0)
-		return calib_file_send(fl1h,
-				       &calib_files[st->last_file_idx]);
+	if (--st->num_pending > 0)
+		return 0;
 
 	LOGP(DL1C, LOGL_INFO, "L1 calibration table loading complete!\n");
 	eeprom_free_resources();
@@ -443,19 +569,51 @@ static int calib_send_compl_cb(struct gsm_bts_trx *trx, struct msgb *l1_msg,
 	return 0;
 }
 
-
 int calib_load(struct femtol1_hdl *fl1h)
 {
 #if SUPERFEMTO_API_VERSION < SUPERFEMTO_API(2,4,0)
 	LOGP(DL1C, LOGL_ERROR, "L1 calibration is not supported on pre 2.4.0 firmware.\n");
 	return -1;
 #else
-	int idx = next_calib_file_idx(fl1h->hw_info.band_support, -1);
-	if (idx < 0) {
+	struct calib_send_state *st = &fl1h->st;
+	struct calib_cache_entry *cache;
+	struct msgb *msg;
+	int i, rc = -1;
+
+	if (next_calib_file_idx(fl1h->hw_info.band_support, -1) < 0) {
 		LOGP(DL1C, LOGL_ERROR, "No band_support?!?\n");
 		return -1;
 	}
-	return calib_file_send(fl1h, &calib_files[idx]);
+
+	cache = talloc_zero_array(fl1h, struct calib_cache_entry, ARRAY_SIZE(calib_files));
+	if (!cache)
+		return -ENOMEM;
+
+	if (fl1h->phy_inst->u.sysmobts.calib_path)
+		calib_files_read(fl1h, cache);
+	else
+		calib_eeprom_read_all(fl1h, cache);
+
+	/* The tables are independent of each other, so there is no need to
+	 * wait for the confirmation of one before sending the next one; the
+	 * DSP confirms them in order. */
+	st->num_pending = 0;
+	for (i = 0; i < ARRAY_SIZE(calib_files); i++) {
+		if (!calib_file_needed(fl1h->hw_info.band_support, i) || !cache[i].valid)
+			continue;
+
+		msg = sysp_msgb_alloc();
+		memcpy(msgb_sysprim(msg), &cache[i].prim, sizeof(cache[i].prim));
+		calib_fixup_rx(fl1h, msgb_sysprim(msg));
+
+		if (l1if_req_compl(fl1h, msg, calib_send_compl_cb, (void *) &calib_files[i]) < 0)
+			continue;
+		st->num_pending++;
+		rc = 0;
+	}
+
+	talloc_free(cache);
+	return rc;
 #endif
 }
 
@@ -86,10 +86,21 @@
  */
 #define EEPROM_CFG_START_ADDR   0x0100
 
+/**
+ * EEPROM size
+ */
+#define EEPROM_SIZE             0x2000
+
 /**
  * EEPROM configuration max size
  */
-#define EEPROM_CFG_MAX_SIZE     (0x2000 - EEPROM_CFG_START_ADDR)
+#define EEPROM_CFG_MAX_SIZE     (EEPROM_SIZE - EEPROM_CFG_START_ADDR)
+
+/**
+ * Granularity of the in-memory EEPROM image
+ */
+#define EEPROM_PAGE_SIZE        0x100
+#define EEPROM_NUM_PAGES        (EEPROM_SIZE / EEPROM_PAGE_SIZE)
 
 /**
  * EEPROM config magic ID
@@ -404,6 +415,25 @@ static int eeprom_read( int addr, int size, char *pBuff );
 static int eeprom_write( int addr, int size, const char *pBuff );
 static uint16_t eeprom_crc( uint8_t *pu8Data, int len );
 static eeprom_Cfg_t *eeprom_cached_config(void);
+static void eeprom_invalidate_decoded(void);
+
+
+/****************************************************************************
+ *                              Private data                                *
+ ****************************************************************************/
+
+/**
+ * Sections which were already decoded, valid until the next write
+ */
+static struct {
+    int valid;
+    eeprom_SysInfo_t info;
+} g_sysinfo;
+
+static struct {
+    int valid;
+    eeprom_RfClockCal_t cal;
+} g_rfclk;
 
 
 /****************************************************************************
@@ -475,6 +505,12 @@ eeprom_Error_t eeprom_ReadSysInfo( eeprom_SysInfo_t *pSysInfo )
     int err;
     eeprom_Cfg_t ee;
 
+    if ( g_sysinfo.valid )
+    {
+        *pSysInfo = g_sysinfo.info;
+        return EEPROM_SUCCESS;
+    }
+
     // Get a copy of the EEPROM header
     err = eeprom_read( EEPROM_CFG_START_ADDR, sizeof(ee.hdr), (char *) &ee.hdr );
     if ( err != sizeof(ee.hdr) )
@@ -526,6 +562,9 @@ eeprom_Error_t eeprom_ReadSysInfo( eeprom_SysInfo_t *pSysInfo )
             pSysInfo->u8GSM900  = ee.cfg.v1.sysInfo.u2GSM900;
             pSysInfo->u8DCS1800 = ee.cfg.v1.sysInfo.u2DCS1800;
             pSysInfo->u8PCS1900 = ee.cfg.v1.sysInfo.u2PCS1900;
+
+            g_sysinfo.info  = *pSysInfo;
+            g_sysinfo.valid = 1;
             break;
         }
 
@@ -640,9 +679,15 @@ eeprom_Error_t eeprom_ReadRfClockCal( eeprom_RfClockCal_t *pRfClockCal )
     int err;
     eeprom_Cfg_t ee;
 
+    if ( g_rfclk.valid )
+    {
+        *pRfClockCal = g_rfclk.cal;
+        return EEPROM_SUCCESS;
+    }
+
     // Get a copy of the EEPROM header
-    err = eeprom_read( EEPROM_CFG_START_ADDR, sizeof(ee), (char *) &ee );
-    if ( err != sizeof(ee) )
+    err = eeprom_read( EEPROM_CFG_START_ADDR, sizeof(ee.hdr), (char *) &ee.hdr );
+    if ( err != sizeof(ee.hdr) )
     {
         PERROR( "Error while reading the EEPROM content (%d)\n", err );
         return EEPROM_ERR_DEVICE;
@@ -685,6 +730,9 @@ eeprom_Error_t eeprom_ReadRfClockCal( eeprom_RfClockCal_t *pRfClockCal )
             // Expand the content of the section
             pRfClockCal->iClkCor  = ee.cfg.v1.rfClk.i24ClkCor;
             pRfClockCal->u8ClkSrc = ee.cfg.v1.rfClk.u8ClkSrc;
+
+            g_rfclk.cal   = *pRfClockCal;
+            g_rfclk.valid = 1;
             break;
         }
 
@@ -1674,6 +1722,33 @@ int eeprom_dump( int addr, int size, int hex )
 static FILE *g_file;
 static eeprom_Cfg_t *g_cached_cfg;
 
+/**
+ * In-memory image of the EEPROM.  Pages are read from the (slow) I2C
+ * device the first time they are accessed, and then served from memory
+ * until eeprom_invalidate() is called.  Writes go to the device and to
+ * the image.
+ */
+static uint8_t g_image[EEPROM_SIZE];
+static uint32_t g_image_valid;  ///< bitmap of the pages present in g_image
+
+#if EEPROM_NUM_PAGES > 32
+#error "g_image_valid is too small for the EEPROM size"
+#endif
+
+static FILE *eeprom_open(void)
+{
+    if (!g_file) {
+        g_file = fopen( EEPROM_DEV, "r+" );
+        if ( g_file == NULL )
+            perror( "eeprom fopen" );
+    }
+    return g_file;
+}
+
+/**
+ * Release the device and the decoded sections.  The image is kept, so
+ * that later reads (e.g. from the VTY) do not touch the bus again.
+ */
 void eeprom_free_resources(void)
 {
 	if (g_file)
@@ -1686,30 +1761,83 @@ void eeprom_free_resources(void)
 }
 
 /**
- * Read up to 'size' bytes of data from the EEPROM starting at offset 'addr'.
+ * Forget everything read from the EEPROM, e.g. after it was written by
+ * another process.
  */
-static int eeprom_read( int addr, int size, char *pBuff )
+void eeprom_invalidate(void)
 {
-    FILE *f = g_file;
-    int n;
-    
-    if (!f) {
-    	f = fopen( EEPROM_DEV, "r+" );
-    	if ( f == NULL )
+    g_image_valid = 0;
+    eeprom_invalidate_decoded();
+}
+
+static void eeprom_invalidate_decoded(void)
+{
+    g_sysinfo.valid = 0;
+    g_rfclk.valid = 0;
+
+    free(g_cached_cfg);
+    g_cached_cfg = NULL;
+}
+
+/**
+ * Make sure the pages covering [addr, addr+size) are in the image.
+ */
+static int eeprom_load( int addr, int size )
+{
+    int first = addr / EEPROM_PAGE_SIZE;
+    int last = (addr + size - 1) / EEPROM_PAGE_SIZE;
+    int page, n, len;
+    FILE *f;
+
+    for ( page = first; page <= last; page = n )
+    {
+        if ( g_image_valid & (1U << page) )
         {
-            perror( "eeprom fopen" );
+            n = page + 1;
+            continue;
+        }
+
+        // Read all consecutive missing pages at once
+        for ( n = page + 1; n <= last && !(g_image_valid & (1U << n)); ++n )
+            ;
+
+        f = eeprom_open();
+        if ( f == NULL )
+            return -1;
+        if (fseek( f, page * EEPROM_PAGE_SIZE, SEEK_SET ) != 0)
+        {
+            perror( "eeprom fseek" );
             return -1;
         }
-	g_file = f;
+        len = (n - page) * EEPROM_PAGE_SIZE;
+        len = fread( &g_image[page * EEPROM_PAGE_SIZE], 1, len, f );
+
+        // Only complete pages make it into the image
+        for ( n = page + len / EEPROM_PAGE_SIZE; page < n; ++page )
+            g_image_valid |= 1U << page;
+        if ( len % EEPROM_PAGE_SIZE || len == 0 )
+            return -1;
     }
-    if (fseek( f, addr, SEEK_SET ) != 0)
-    {
-        perror( "eeprom fseek" );
+    return 0;
+}
+
+/**
+ * Read up to 'size' bytes of data from the EEPROM starting at offset 'addr'.
+ */
+static int eeprom_read( int addr, int size, char *pBuff )
+{
+    if ( addr < 0 || addr >= EEPROM_SIZE || size < 0 )
         return -1;
-    }
+    if ( addr + size > EEPROM_SIZE )
+        size = EEPROM_SIZE - addr;
+    if ( size == 0 )
+        return 0;
 
-    n = fread( pBuff, 1, size, f );
-    return n;
+    if ( eeprom_load( addr, size ) < 0 )
+        return -1;
+
+    memcpy( pBuff, &g_image[addr], size );
+    return size;
 }
 
 static void eeprom_cache_cfg(void)
@@ -1754,18 +1882,15 @@ static eeprom_Cfg_t *eeprom_cached_config(void)
  */
 static int eeprom_write( int addr, int size, const char *pBuff )
 {
-    FILE *f = g_file;
+    FILE *f;
     int n;
 
-    if (!f) {
-        f = fopen( EEPROM_DEV, "r+" );
-        if ( f == NULL )
-        {
-            perror( "eeprom fopen" );
-            return -1;
-        }
-	g_file = f;
-    }
+    // Whatever was decoded before may be stale now
+    eeprom_invalidate_decoded();
+
+    f = eeprom_open();
+    if ( f == NULL )
+        return -1;
     if (fseek( f, addr, SEEK_SET ) != 0)
     {
         perror( "eeprom fseek" );
@@ -1778,6 +1903,19 @@ static int eeprom_write( int addr, int size, const char *pBuff )
 error:
     fclose( f );
     g_file = NULL;
+
+    // Keep the image in sync; on error, re-read the affected pages later
+    if ( n == size && addr >= 0 && addr + size <= EEPROM_SIZE )
+    {
+        memcpy( &g_image[addr], pBuff, size );
+    }
+    else if ( size > 0 )
+    {
+        int page;
+        for ( page = addr / EEPROM_PAGE_SIZE; page <= (addr + size - 1) / EEPROM_PAGE_SIZE && page < EEPROM_NUM_PAGES; ++page )
+            if ( page >= 0 )
+                g_image_valid &= ~(1U << page);
+    }
     return n;
 }
 
@@ -0,0 +1,240 @@
+/* Bundled datagram I/O shared by l1fwd-proxy and osmo-bts-sysmo-remote */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <osmocom/core/bit16gen.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/write_queue.h>
+
+#include <osmo-bts/logging.h>
+
+#include <sysmocom/femtobts/superfemto.h>
+#include <sysmocom/femtobts/gsml1prim.h>
+
+#include "femtobts.h"
+#include "l1_fwd.h"
+
+/* every primitive must fit into a datagram on its own */
+osmo_static_assert(SYSMOBTS_PRIM_SIZE + 2 <= L1FWD_DGRAM_MAX, l1fwd_dgram_size)
+
+static uint32_t now_us(void)
+{
+	struct timespec ts;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*! Remember when a primitive was queued for forwarding, for the latency
+ *  stats; msgb->cb[0] is 0 for primitives which are not stamped. */
+void l1fwd_msg_stamp(struct msgb *msg)
+{
+	msg->cb[0] = now_us() | 1;
+}
+
+/*! Receive up to L1FWD_MMSG_MAX datagrams and hand each of the primitives
+ *  bundled in them to \a rx_cb, which takes ownership of the msgb.
+ *  \param[out] sa source address of the last datagram (may be NULL).
+ *  \returns 0 on success; negative on error. */
+int l1fwd_sock_read(struct osmo_fd *ofd, struct sockaddr_storage *sa, socklen_t *sa_len,
+		    struct l1fwd_stats *st, l1fwd_rx_cb *rx_cb)
+{
+	static uint8_t buf[L1FWD_MMSG_MAX][L1FWD_DGRAM_MAX];
+	struct sockaddr_storage src[L1FWD_MMSG_MAX];
+	struct mmsghdr mmsg[L1FWD_MMSG_MAX];
+	struct iovec iov[L1FWD_MMSG_MAX];
+	unsigned int i, off, len, plen;
+	struct msgb *msg;
+	int rc;
+
+	for (i = 0; i < L1FWD_MMSG_MAX; i++) {
+		iov[i] = (struct iovec) {
+			.iov_base = buf[i],
+			.iov_len = sizeof(buf[i]),
+		};
+		mmsg[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_name = sa ? &src[i] : NULL,
+				.msg_namelen = sa ? sizeof(src[i]) : 0,
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+			},
+		};
+	}
+
+	rc = recvmmsg(ofd->fd, mmsg, L1FWD_MMSG_MAX, MSG_DONTWAIT, NULL);
+	if (rc < 0) {
+		if (errno == EAGAIN)
+			return 0;
+		LOGP(DL1C, LOGL_ERROR, "Error receiving from UDP (queue %d): %s\n",
+		     ofd->priv_nr, strerror(errno));
+		return -errno;
+	}
+
+	if (rc > 0 && sa) {
+		memcpy(sa, &src[rc - 1], mmsg[rc - 1].msg_hdr.msg_namelen);
+		*sa_len = mmsg[rc - 1].msg_hdr.msg_namelen;
+	}
+
+	st->rx_dgrams += rc;
+	for (i = 0; i < (unsigned int) rc; i++) {
+		len = mmsg[i].msg_len;
+		for (off = 0; off + 2 <= len; off += plen) {
+			plen = osmo_load16be(&buf[i][off]);
+			off += 2;
+			if (plen == 0 || off + plen > len) {
+				LOGP(DL1C, LOGL_ERROR, "Malformed datagram from UDP (queue %d)\n",
+				     ofd->priv_nr);
+				break;
+			}
+
+			msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
+			if (!msg)
+				return -ENOMEM;
+			if (plen > msgb_tailroom(msg)) {
+				LOGP(DL1C, LOGL_ERROR, "Primitive too long from UDP (queue %d): %u\n",
+				     ofd->priv_nr, plen);
+				msgb_free(msg);
+				continue;
+			}
+			msg->l1h = msgb_put(msg, plen);
+			memcpy(msg->l1h, &buf[i][off], plen);
+
+			st->rx_prims++;
+			rx_cb(ofd, msg);
+		}
+	}
+
+	return 0;
+}
+
+/*! Send the primitives of a write queue, bundling up to L1FWD_BUNDLE_MAX of
+ *  them per datagram and up to L1FWD_MMSG_MAX datagrams per sendmmsg().
+ *  \param[in] sa destination address (NULL for a connected socket).
+ *  \returns 0 on success; negative on error. */
+int l1fwd_sock_write(struct osmo_wqueue *wq, const struct sockaddr *sa, socklen_t sa_len,
+		     struct l1fwd_stats *st)
+{
+	uint8_t hdr[L1FWD_MMSG_MAX * L1FWD_BUNDLE_MAX][2];
+	struct iovec iov[L1FWD_MMSG_MAX * L1FWD_BUNDLE_MAX * 2];
+	struct mmsghdr mmsg[L1FWD_MMSG_MAX];
+	unsigned int num_prims[L1FWD_MMSG_MAX];
+	unsigned int num_dgrams = 0, num_iov = 0, n = 0;
+	unsigned int dgram_len = 0, len, i;
+	struct msgb *msg, *tmp;
+	uint32_t now, lat;
+	int rc;
+
+	llist_for_each_entry(msg, &wq->msg_queue, list) {
+		len = msgb_l1len(msg);
+		if (!num_dgrams || num_prims[num_dgrams - 1] >= L1FWD_BUNDLE_MAX ||
+		    dgram_len + 2 + len > L1FWD_DGRAM_MAX) {
+			if (num_dgrams >= L1FWD_MMSG_MAX)
+				break;
+			mmsg[num_dgrams] = (struct mmsghdr) {
+				.msg_hdr = {
+					.msg_name = (void *) sa,
+					.msg_namelen = sa ? sa_len : 0,
+					.msg_iov = &iov[num_iov],
+				},
+			};
+			num_prims[num_dgrams++] = 0;
+			dgram_len = 0;
+		}
+
+		osmo_store16be(len, hdr[n]);
+		iov[num_iov++] = (struct iovec) { .iov_base = hdr[n], .iov_len = 2 };
+		iov[num_iov++] = (struct iovec) { .iov_base = msg->l1h, .iov_len = len };
+		mmsg[num_dgrams - 1].msg_hdr.msg_iovlen += 2;
+		num_prims[num_dgrams - 1]++;
+		dgram_len += 2 + len;
+		n++;
+	}
+
+	if (!num_dgrams) {
+		osmo_fd_write_disable(&wq->bfd);
+		return 0;
+	}
+
+	rc = sendmmsg(wq->bfd.fd, mmsg, num_dgrams, MSG_DONTWAIT);
+	if (rc < 0) {
+		if (errno == EAGAIN)
+			return 0;
+		LOGP(DL1C, LOGL_ERROR, "Error sending to UDP (queue %d): %s\n",
+		     wq->bfd.priv_nr, strerror(errno));
+		/* drop the first datagram, like the write queue would */
+		rc = 1;
+	} else {
+		st->tx_dgrams += rc;
+	}
+
+	for (i = 0, n = 0; i < (unsigned int) rc; i++)
+		n += num_prims[i];
+
+	now = now_us();
+	llist_for_each_entry_safe(msg, tmp, &wq->msg_queue, list) {
+		if (n-- == 0)
+			break;
+		if (msg->cb[0]) {
+			lat = now - (uint32_t) msg->cb[0];
+			st->lat_sum_us += lat;
+			st->lat_num++;
+			if (lat > st->lat_max_us)
+				st->lat_max_us = lat;
+		}
+		st->tx_prims++;
+		llist_del(&msg->list);
+		wq->current_length--;
+		msgb_free(msg);
+	}
+
+	if (llist_empty(&wq->msg_queue))
+		osmo_fd_write_disable(&wq->bfd);
+
+	return 0;
+}
+
+/*! Log the stats of queue \a q since the last call (if any) and reset them */
+void l1fwd_stats_log(int q, struct l1fwd_stats *st)
+{
+	if (!st->rx_prims && !st->tx_prims)
+		return;
+
+	LOGP(DL1C, LOGL_INFO, "UDP queue %d: Rx %u prims in %u datagrams, "
+	     "Tx %u prims in %u datagrams\n", q, st->rx_prims, st->rx_dgrams,
+	     st->tx_prims, st->tx_dgrams);
+	if (st->lat_num)
+		LOGP(DL1C, LOGL_INFO, "UDP queue %d: forwarding latency avg %u max %u us\n",
+		     q, (unsigned int) (st->lat_sum_us / st->lat_num), st->lat_max_us);
+
+	memset(st, 0, sizeof(*st));
+}
@@ -1,5 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/socket.h>
+
 #define L1FWD_L1_PORT	9999
 #define L1FWD_SYS_PORT	9998
 #define L1FWD_TCH_PORT	9997
 #define L1FWD_PDTCH_PORT 9996
 
+/* Each datagram between l1fwd-proxy and osmo-bts-sysmo-remote carries one
+ * or more primitives of the same queue, each preceded by its length (16 bit,
+ * network byte order).  Both ends must be of the same version. */
+#define L1FWD_DGRAM_MAX		8192	/* max. size of a datagram */
+#define L1FWD_BUNDLE_MAX	16	/* max. primitives per datagram */
+#define L1FWD_MMSG_MAX		8	/* max. datagrams per recvmmsg() / sendmmsg() */
+
+/* max. length of the queues towards UDP */
+#define L1FWD_WQUEUE_LEN	64
+
+/* interval of the l1fwd_stats_log() output */
+#define L1FWD_STATS_INTERVAL	10
+
+struct msgb;
+struct osmo_fd;
+struct osmo_wqueue;
+
+struct l1fwd_stats {
+	uint32_t rx_prims;
+	uint32_t rx_dgrams;
+	uint32_t tx_prims;
+	uint32_t tx_dgrams;
+	/* time from l1fwd_msg_stamp() until sent */
+	uint32_t lat_num;
+	uint64_t lat_sum_us;
+	uint32_t lat_max_us;
+};
+
+typedef int l1fwd_rx_cb(struct osmo_fd *ofd, struct msgb *msg);
+
+void l1fwd_msg_stamp(struct msgb *msg);
+int l1fwd_sock_read(struct osmo_fd *ofd, struct sockaddr_storage *sa, socklen_t *sa_len,
+		    struct l1fwd_stats *st, l1fwd_rx_cb *rx_cb);
+int l1fwd_sock_write(struct osmo_wqueue *wq, const struct sockaddr *sa, socklen_t sa_len,
+		     struct l1fwd_stats *st);
+void l1fwd_stats_log(int q, struct l1fwd_stats *st);
@@ -67,6 +67,8 @@ struct l1fwd_hdl {
 	socklen_t remote_sa_len[_NUM_MQ_WRITE];
 
 	struct osmo_wqueue udp_wq[_NUM_MQ_WRITE];
+	struct l1fwd_stats stats[_NUM_MQ_WRITE];
+	struct osmo_timer_list stats_timer;
 
 	struct femtol1_hdl *fl1h;
 };
@@ -78,6 +80,7 @@ int l1if_handle_l1prim(int wq, struct femtol1_hdl *fl1h, struct msgb *msg)
 	struct l1fwd_hdl *l1fh = fl1h->priv;
 
 	/* Enqueue message to UDP socket */
+	l1fwd_msg_stamp(msg);
 	if (osmo_wqueue_enqueue(&l1fh->udp_wq[wq], msg) != 0) {
 		LOGP(DL1C, LOGL_ERROR, "Write queue %d full. dropping msg\n", wq);
 		msgb_free(msg);
@@ -92,6 +95,7 @@ int l1if_handle_sysprim(struct femtol1_hdl *fl1h, struct msgb *msg)
 	struct l1fwd_hdl *l1fh = fl1h->priv;
 
 	/* Enqueue message to UDP socket */
+	l1fwd_msg_stamp(msg);
 	if (osmo_wqueue_enqueue(&l1fh->udp_wq[MQ_SYS_WRITE], msg) != 0) {
 		LOGP(DL1C, LOGL_ERROR, "MQ_SYS_WRITE ful. dropping msg\n");
 		msgb_free(msg);
@@ -101,34 +105,13 @@ int l1if_handle_sysprim(struct femtol1_hdl *fl1h, struct msgb *msg)
 }
 
 
-/* data has arrived on the udp socket */
-static int udp_read_cb(struct osmo_fd *ofd)
+/* a primitive has arrived on the udp socket */
+static int udp_rx_prim(struct osmo_fd *ofd, struct msgb *msg)
 {
-	struct msgb *msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
 	struct l1fwd_hdl *l1fh = ofd->data;
 	struct femtol1_hdl *fl1h = l1fh->fl1h;
-	int rc;
 
-	if (!msg)
-		return -ENOMEM;
-
-	msg->l1h = msg->data;
-
-	l1fh->remote_sa_len[ofd->priv_nr] = sizeof(l1fh->remote_sa[ofd->priv_nr]);
-	rc = recvfrom(ofd->fd, msg->l1h, msgb_tailroom(msg), 0,
-		      (struct sockaddr *) &l1fh->remote_sa[ofd->priv_nr], &l1fh->remote_sa_len[ofd->priv_nr]);
-	if (rc < 0) {
-		perror("read from udp");
-		msgb_free(msg);
-		return rc;
-	} else if (rc == 0) {
-		perror("len=0 read from udp");
-		msgb_free(msg);	
-		return rc;
-	}
-	msgb_put(msg, rc);
-
-	DEBUGP(DL1C, "UDP: Received %u bytes for queue %d\n", rc,
+	DEBUGP(DL1C, "UDP: Received %u bytes for queue %d\n", msgb_l1len(msg),
 		ofd->priv_nr);
 
 	/* put the message into the right queue */
@@ -141,30 +124,34 @@ static int udp_read_cb(struct osmo_fd *ofd)
 	return 0;
 }
 
-/* callback when we can write to the UDP socket */
-static int udp_write_cb(struct osmo_fd *ofd, struct msgb *msg)
+/* the udp socket is readable and/or writable */
+static int udp_fd_cb(struct osmo_fd *ofd, unsigned int what)
 {
-	int rc;
 	struct l1fwd_hdl *l1fh = ofd->data;
+	int q = ofd->priv_nr;
 
-	DEBUGP(DL1C, "UDP: Writing %u bytes for queue %d\n", msgb_l1len(msg),
-		ofd->priv_nr);
+	if (what & OSMO_FD_READ)
+		l1fwd_sock_read(ofd, &l1fh->remote_sa[q], &l1fh->remote_sa_len[q],
+				&l1fh->stats[q], udp_rx_prim);
 
-	rc = sendto(ofd->fd, msg->l1h, msgb_l1len(msg), 0,
-		    (const struct sockaddr *)&l1fh->remote_sa[ofd->priv_nr], l1fh->remote_sa_len[ofd->priv_nr]);
-	if (rc < 0) {
-		LOGP(DL1C, LOGL_ERROR, "error writing to L1 msg_queue: %s\n",
-			strerror(errno));
-		return rc;
-	} else if (rc < msgb_l1len(msg)) {
-		LOGP(DL1C, LOGL_ERROR, "short write to L1 msg_queue: "
-			"%u < %u\n", rc, msgb_l1len(msg));
-		return -EIO;
-	}
+	if (what & OSMO_FD_WRITE)
+		l1fwd_sock_write(&l1fh->udp_wq[q], (const struct sockaddr *) &l1fh->remote_sa[q],
+				 l1fh->remote_sa_len[q], &l1fh->stats[q]);
 
 	return 0;
 }
 
+static void stats_timer_cb(void *data)
+{
+	struct l1fwd_hdl *l1fh = data;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(l1fh->stats); i++)
+		l1fwd_stats_log(i, &l1fh->stats[i]);
+
+	osmo_timer_schedule(&l1fh->stats_timer, L1FWD_STATS_INTERVAL, 0);
+}
+
 int main(int argc, char **argv)
 {
 	struct l1fwd_hdl *l1fh;
@@ -209,11 +196,9 @@ int main(int argc, char **argv)
 	for (i = 0; i < ARRAY_SIZE(l1fh->udp_wq); i++) {
 		struct osmo_wqueue *wq = &l1fh->udp_wq[i];
 
-		osmo_wqueue_init(wq, 10);
-		wq->write_cb = udp_write_cb;
-		wq->read_cb = udp_read_cb;
+		osmo_wqueue_init(wq, L1FWD_WQUEUE_LEN);
 
-		osmo_fd_setup(&wq->bfd, -1, OSMO_FD_READ, osmo_wqueue_bfd_cb, l1fh, i);
+		osmo_fd_setup(&wq->bfd, -1, OSMO_FD_READ, udp_fd_cb, l1fh, i);
 		rc = osmo_sock_init_ofd(&wq->bfd, AF_UNSPEC, SOCK_DGRAM,
 					IPPROTO_UDP, NULL, fwd_udp_ports[i],
 					OSMO_SOCK_F_BIND);
@@ -223,6 +208,9 @@ int main(int argc, char **argv)
 		}
 	}
 
+	osmo_timer_setup(&l1fh->stats_timer, stats_timer_cb, l1fh);
+	osmo_timer_schedule(&l1fh->stats_timer, L1FWD_STATS_INTERVAL, 0);
+
 	while (1) {
 		rc = osmo_select_main(0);		
 		if (rc < 0) {
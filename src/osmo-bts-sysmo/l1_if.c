@@ -68,7 +68,7 @@
 
 struct wait_l1_conf {
 	struct llist_head list;		/* internal linked list */
-	struct osmo_timer_list timer;	/* timer for L1 timeout */
+	struct timespec deadline;	/* when to give up waiting for the confirmation */
 	unsigned int conf_prim_id;	/* primitive we expect in response */
 	HANDLE conf_hLayer3;		/* layer 3 handle we expect in response */
 	unsigned int is_sys_prim;	/* is this a system (1) or L1 (0) primitive */
@@ -76,15 +76,50 @@ struct wait_l1_conf {
 	void *cb_data;
 };
 
+/* All requests have the same timeout, so the oldest one in wlc_list
+ * expires first: a single timer is (re)scheduled for it. */
+static void wlc_timer_schedule(struct femtol1_hdl *fl1h)
+{
+	const struct wait_l1_conf *wlc;
+	struct timespec now;
+	long long us;
+
+	if (llist_empty(&fl1h->wlc_list)) {
+		osmo_timer_del(&fl1h->wlc_timer);
+		return;
+	}
+
+	wlc = llist_first_entry(&fl1h->wlc_list, struct wait_l1_conf, list);
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	us = (wlc->deadline.tv_sec - now.tv_sec) * 1000000LL
+	     + (wlc->deadline.tv_nsec - now.tv_nsec) / 1000;
+	if (us < 0)
+		us = 0;
+	osmo_timer_schedule(&fl1h->wlc_timer, us / 1000000, us % 1000000);
+}
+
+/* remove a request from wlc_list, once its confirmation was received */
+static void unlink_wlc(struct femtol1_hdl *fl1h, struct wait_l1_conf *wlc)
+{
+	bool oldest = fl1h->wlc_list.next == &wlc->list;
+
+	llist_del(&wlc->list);
+	if (oldest)
+		wlc_timer_schedule(fl1h);
+}
+
 static void release_wlc(struct wait_l1_conf *wlc)
 {
-	osmo_timer_del(&wlc->timer);
 	talloc_free(wlc);
 }
 
 static void l1if_req_timeout(void *data)
 {
-	struct wait_l1_conf *wlc = data;
+	struct femtol1_hdl *fl1h = data;
+	struct wait_l1_conf *wlc;
+
+	OSMO_ASSERT(!llist_empty(&fl1h->wlc_list));
+	wlc = llist_first_entry(&fl1h->wlc_list, struct wait_l1_conf, list);
 
 	if (wlc->is_sys_prim)
 		LOGP(DL1C, LOGL_FATAL, "Timeout waiting for SYS primitive %s\n",
@@ -202,12 +237,18 @@ static int _l1if_req_compl(struct femtol1_hdl *fl1h, struct msgb *msg,
 			is_system_prim ? "system primitive" : "gsm");
 		msgb_free(msg);
 	}
-	llist_add(&wlc->list, &fl1h->wlc_list);
+	/* If DSP fails to respond within timeout_secs seconds, we terminate */
+	osmo_clock_gettime(CLOCK_MONOTONIC, &wlc->deadline);
+	wlc->deadline.tv_sec += timeout_secs;
+
+	/* The L1 confirms in order, so several requests for the same
+	 * primitive may be pending: match them oldest first */
+	llist_add_tail(&wlc->list, &fl1h->wlc_list);
 
-	/* schedule a timer for timeout_secs seconds. If DSP fails to respond, we terminate */
-	wlc->timer.data = wlc;
-	wlc->timer.cb = l1if_req_timeout;
-	osmo_timer_schedule(&wlc->timer, timeout_secs, 0);
+	if (!osmo_timer_pending(&fl1h->wlc_timer)) {
+		osmo_timer_setup(&fl1h->wlc_timer, l1if_req_timeout, fl1h);
+		wlc_timer_schedule(fl1h);
+	}
 
 	return 0;
 }
@@ -225,28 +266,87 @@ int l1if_gsm_req_compl(struct femtol1_hdl *fl1h, struct msgb *msg,
 	return _l1if_req_compl(fl1h, msg, 0, cb, data);
 }
 
-/* allocate a msgb containing a GsmL1_Prim_t */
-struct msgb *l1p_msgb_alloc(void)
+/* Every RTS.ind is answered with a freshly allocated primitive, which is
+ * freed once it has been written to the DSP.  Instead of going through
+ * malloc() each time, the msgbs are recycled: a talloc destructor intercepts
+ * msgb_free() and puts the msgb on the free list of its pool, the same way
+ * as for l1sap_msgb_alloc(). */
+#define PRIM_MSGB_POOL_MAX 64 /* max. number of pooled msgbs per pool */
+
+struct prim_msgb_pool {
+	struct llist_head free;		/* pooled (unused) msgbs */
+	unsigned int free_len;		/* number of pooled msgbs */
+};
+
+static struct prim_msgb_pool l1p_msgb_pool = {
+	.free = LLIST_HEAD_INIT(l1p_msgb_pool.free),
+};
+static struct prim_msgb_pool sysp_msgb_pool = {
+	.free = LLIST_HEAD_INIT(sysp_msgb_pool.free),
+};
+
+/* both pools hold msgbs of a single size, so the size tells the pool */
+static struct prim_msgb_pool *prim_msgb_pool_by_size(uint16_t data_len)
+{
+	if (data_len == sizeof(GsmL1_Prim_t))
+		return &l1p_msgb_pool;
+	return &sysp_msgb_pool;
+}
+
+/* called by talloc_free(), i.e. by msgb_free() */
+static int prim_msgb_pool_destructor(struct msgb *msg)
 {
-	struct msgb *msg = msgb_alloc(sizeof(GsmL1_Prim_t), "l1_prim");
+	struct prim_msgb_pool *pool = prim_msgb_pool_by_size(msg->data_len);
 
-	if (msg)
-		msg->l1h = msgb_put(msg, sizeof(GsmL1_Prim_t));
+	if (pool->free_len >= PRIM_MSGB_POOL_MAX)
+		return 0; /* actually free it */
 
-	return msg;
+	talloc_set_destructor(msg, NULL);
+	llist_add(&msg->list, &pool->free);
+	pool->free_len++;
+
+	return -1; /* keep the memory */
 }
 
-/* allocate a msgb containing a SuperFemto_Prim_t */
-struct msgb *sysp_msgb_alloc(void)
+static struct msgb *prim_msgb_pool_alloc(struct prim_msgb_pool *pool,
+					 uint16_t size, const char *name)
 {
-	struct msgb *msg = msgb_alloc(sizeof(SuperFemto_Prim_t), "sys_prim");
+	struct msgb *msg;
+
+	if (OSMO_LIKELY(!llist_empty(&pool->free))) {
+		msg = llist_first_entry(&pool->free, struct msgb, list);
+		llist_del(&msg->list);
+		pool->free_len--;
+		/* reset to the state msgb_alloc() leaves it in */
+		memset(msg, 0, sizeof(*msg) + size);
+		msg->data_len = size;
+		msg->data = msg->_data;
+		msg->head = msg->_data;
+		msg->tail = msg->_data;
+	} else {
+		msg = msgb_alloc(size, name);
+		if (!msg)
+			return NULL;
+	}
 
-	if (msg)
-		msg->l1h = msgb_put(msg, sizeof(SuperFemto_Prim_t));
+	talloc_set_destructor(msg, prim_msgb_pool_destructor);
+	msg->l1h = msgb_put(msg, size);
 
 	return msg;
 }
 
+/* allocate a msgb containing a GsmL1_Prim_t */
+struct msgb *l1p_msgb_alloc(void)
+{
+	return prim_msgb_pool_alloc(&l1p_msgb_pool, sizeof(GsmL1_Prim_t), "l1_prim");
+}
+
+/* allocate a msgb containing a SuperFemto_Prim_t */
+struct msgb *sysp_msgb_alloc(void)
+{
+	return prim_msgb_pool_alloc(&sysp_msgb_pool, sizeof(SuperFemto_Prim_t), "sys_prim");
+}
+
 static GsmL1_PhDataReq_t *
 data_req_from_rts_ind(GsmL1_Prim_t *l1p,
 		const GsmL1_PhReadyToSendInd_t *rts_ind)
@@ -407,9 +507,9 @@ static int ph_data_req(struct gsm_bts_trx *trx, struct msgb *msg,
 			memcpy(l1p->u.phDataReq.msgUnitParam.u8Buffer,
 			       lchan->tch.dtx.facch, msgb_l2len(msg));
 		else if (dtx_dl_amr_enabled(lchan) &&
-			 ((lchan->tch.dtx.dl_amr_fsm->state == ST_ONSET_F) ||
-			 (lchan->tch.dtx.dl_amr_fsm->state == ST_U_INH_F) ||
-			 (lchan->tch.dtx.dl_amr_fsm->state == ST_F1_INH_F))) {
+			 ((lchan->tch.dtx.dl_amr_state == ST_ONSET_F) ||
+			 (lchan->tch.dtx.dl_amr_state == ST_U_INH_F) ||
+			 (lchan->tch.dtx.dl_amr_state == ST_F1_INH_F))) {
 			if (sapi == GsmL1_Sapi_FacchF) {
 				sapi = GsmL1_Sapi_TchF;
 			}
@@ -424,13 +524,13 @@ static int ph_data_req(struct gsm_bts_trx *trx, struct msgb *msg,
 				memcpy(lchan->tch.dtx.facch, msg->l2h,
 				       msgb_l2len(msg));
 				/* prepare ONSET or INH message */
-				if(lchan->tch.dtx.dl_amr_fsm->state == ST_ONSET_F)
+				if(lchan->tch.dtx.dl_amr_state == ST_ONSET_F)
 					l1p->u.phDataReq.msgUnitParam.u8Buffer[0] =
 								GsmL1_TchPlType_Amr_Onset;
-				else if(lchan->tch.dtx.dl_amr_fsm->state == ST_U_INH_F)
+				else if(lchan->tch.dtx.dl_amr_state == ST_U_INH_F)
 					l1p->u.phDataReq.msgUnitParam.u8Buffer[0] =
 								GsmL1_TchPlType_Amr_SidUpdateInH;
-				else if(lchan->tch.dtx.dl_amr_fsm->state == ST_F1_INH_F)
+				else if(lchan->tch.dtx.dl_amr_state == ST_F1_INH_F)
 					l1p->u.phDataReq.msgUnitParam.u8Buffer[0] =
 								GsmL1_TchPlType_Amr_SidFirstInH;
 				/* ignored CMR/CMI pair */
@@ -444,7 +544,7 @@ static int ph_data_req(struct gsm_bts_trx *trx, struct msgb *msg,
 				lchan->tch.dtx.fn = LCHAN_FN_DUMMY;
 			}
 		} else if (dtx_dl_amr_enabled(lchan) &&
-			   lchan->tch.dtx.dl_amr_fsm->state == ST_FACCH) {
+			   lchan->tch.dtx.dl_amr_state == ST_FACCH) {
 			/* update FN so it can be checked by TCH silence
 			   resume handler */
 			lchan->tch.dtx.fn = LCHAN_FN_DUMMY;
@@ -1174,10 +1274,14 @@ int l1if_handle_l1prim(int wq, struct femtol1_hdl *fl1h, struct msgb *msg)
 			get_value_string(femtobts_l1prim_names, l1p->id), wq);
 	}
 
+	/* indications (the vast majority) can't be a response */
+	if (l1p->id >= GsmL1_PrimId_NUM || femtobts_l1prim_type[l1p->id] != L1P_T_CONF)
+		return l1if_handle_ind(fl1h, msg);
+
 	/* check if this is a resposne to a sync-waiting request */
 	llist_for_each_entry(wlc, &fl1h->wlc_list, list) {
 		if (is_prim_compat(l1p, wlc)) {
-			llist_del(&wlc->list);
+			unlink_wlc(fl1h, wlc);
 			if (wlc->cb) {
 				/* call-back function must take
 				 * ownership of msgb */
@@ -1210,7 +1314,7 @@ int l1if_handle_sysprim(struct femtol1_hdl *fl1h, struct msgb *msg)
 		/* the limitation here is that we cannot have multiple callers
 		 * sending the same primitive */
 		if (wlc->is_sys_prim && sysp->id == wlc->conf_prim_id) {
-			llist_del(&wlc->list);
+			unlink_wlc(fl1h, wlc);
 			if (wlc->cb) {
 				/* call-back function must take
 				 * ownership of msgb */
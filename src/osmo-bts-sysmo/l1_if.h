@@ -35,7 +35,7 @@ enum {
 
 struct calib_send_state {
 	const char *path;
-	int last_file_idx;
+	int num_pending;	/* tables sent but not confirmed yet */
 };
 
 enum {
@@ -44,6 +44,9 @@ enum {
 	FIXUP_NOT_NEEDED,
 };
 
+/* max. number of primitives read per readv() */
+#define L1_READV_MAX 8
+
 struct femtol1_hdl {
 	struct gsm_time gsm_time;
 	uint32_t hLayer1;			/* handle to the L1 instance in the DSP */
@@ -51,6 +54,7 @@ struct femtol1_hdl {
 	int clk_cal;
 	uint8_t clk_src;
 	struct llist_head wlc_list;
+	struct osmo_timer_list wlc_timer;	/* timeout of the oldest entry of wlc_list */
 
 	struct phy_instance *phy_inst;		/* Reference to PHY instance */
 
@@ -59,6 +63,8 @@ struct femtol1_hdl {
 
 	struct osmo_fd read_ofd[_NUM_MQ_READ];	/* osmo file descriptors */
 	struct osmo_wqueue write_q[_NUM_MQ_WRITE];
+	/* msgbs for the next readv(), kept if not filled by the previous one */
+	struct msgb *read_msg[_NUM_MQ_READ][L1_READV_MAX];
 
 	struct {
 		/* from DSP/FPGA after L1 Init */
@@ -133,6 +139,7 @@ int l1if_tch_rx_facch(struct gsm_bts_trx *trx, uint8_t chan_nr,
 		      struct msgb *l1p_msg);
 int l1if_tch_fill(struct gsm_lchan *lchan, uint8_t *l1_buffer);
 struct msgb *gen_empty_tch_msg(struct gsm_lchan *lchan, uint32_t fn);
+void hr_jumble(uint8_t *dst, const uint8_t *src);
 
 /* ciphering */
 int l1if_set_ciphering(struct femtol1_hdl *fl1h,
@@ -0,0 +1,156 @@
+/* Recording of the L1 primitives received from the DSP */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+
+#include <sysmocom/femtobts/superfemto.h>
+#include <sysmocom/femtobts/gsml1prim.h>
+
+#include "femtobts.h"
+#include "l1_rec.h"
+
+static FILE *rec_file;
+static struct timespec rec_start;
+
+/*! Start recording the received primitives to the given file.
+ *  \returns 0 on success; negative on error. */
+int l1rec_open(const char *path)
+{
+	struct l1rec_file_hdr fh = {
+		.l1prim_size = sizeof(GsmL1_Prim_t),
+		.sysprim_size = sizeof(SuperFemto_Prim_t),
+	};
+
+	rec_file = fopen(path, "wb");
+	if (rec_file == NULL) {
+		LOGP(DL1C, LOGL_ERROR, "Cannot open L1 recording '%s': %s\n", path, strerror(errno));
+		return -errno;
+	}
+
+	memcpy(fh.magic, L1REC_MAGIC, sizeof(fh.magic));
+	fwrite(&fh, sizeof(fh), 1, rec_file);
+	osmo_clock_gettime(CLOCK_MONOTONIC, &rec_start);
+
+	LOGP(DL1C, LOGL_NOTICE, "Recording the L1 primitives to '%s'\n", path);
+	return 0;
+}
+
+/*! Record a primitive received on queue q (if recording) */
+void l1rec_write(int q, const struct msgb *msg)
+{
+	struct l1rec_hdr rh;
+	struct timespec now;
+
+	if (rec_file == NULL)
+		return;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	rh = (struct l1rec_hdr) {
+		.q = q,
+		.len = msgb_l1len(msg),
+		.time_us = (now.tv_sec - rec_start.tv_sec) * 1000000
+			   + (now.tv_nsec - rec_start.tv_nsec) / 1000,
+	};
+
+	/* buffered by stdio, see l1rec_flush() */
+	if (fwrite(&rh, sizeof(rh), 1, rec_file) != 1 ||
+	    fwrite(msgb_l1(msg), rh.len, 1, rec_file) != 1) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to write the L1 recording, stopping it\n");
+		fclose(rec_file);
+		rec_file = NULL;
+	}
+}
+
+/*! Flush the recorded primitives to the file, called periodically */
+void l1rec_flush(void)
+{
+	if (rec_file != NULL)
+		fflush(rec_file);
+}
+
+/*! Open a recording for reading, checking that it matches this build.
+ *  \returns the file positioned at the first record; NULL on error. */
+FILE *l1rec_open_read(const char *path)
+{
+	struct l1rec_file_hdr fh;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		LOGP(DL1C, LOGL_ERROR, "Cannot open L1 recording '%s': %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	if (fread(&fh, sizeof(fh), 1, f) != 1 ||
+	    memcmp(fh.magic, L1REC_MAGIC, sizeof(fh.magic)) != 0) {
+		LOGP(DL1C, LOGL_ERROR, "'%s' is not an L1 recording\n", path);
+		goto err;
+	}
+	if (fh.l1prim_size != sizeof(GsmL1_Prim_t) || fh.sysprim_size != sizeof(SuperFemto_Prim_t)) {
+		LOGP(DL1C, LOGL_ERROR, "'%s' was recorded with different L1 headers "
+		     "(GsmL1_Prim_t %u vs. %zu, SuperFemto_Prim_t %u vs. %zu bytes)\n", path,
+		     fh.l1prim_size, sizeof(GsmL1_Prim_t), fh.sysprim_size, sizeof(SuperFemto_Prim_t));
+		goto err;
+	}
+
+	return f;
+err:
+	fclose(f);
+	return NULL;
+}
+
+/*! Read the next primitive of a recording.
+ *  \returns msgb with l1h set; NULL at the end of the recording or on error. */
+struct msgb *l1rec_read(FILE *f, int *q, uint32_t *time_us)
+{
+	struct l1rec_hdr rh;
+	struct msgb *msg;
+
+	if (fread(&rh, sizeof(rh), 1, f) != 1)
+		return NULL;
+	if (rh.len == 0 || rh.len > SYSMOBTS_PRIM_SIZE) {
+		LOGP(DL1C, LOGL_ERROR, "Malformed L1 record (queue %u, %u bytes)\n", rh.q, rh.len);
+		return NULL;
+	}
+
+	msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "l1rec");
+	if (msg == NULL)
+		return NULL;
+	msg->l1h = msgb_put(msg, rh.len);
+	if (fread(msg->l1h, rh.len, 1, f) != 1) {
+		msgb_free(msg);
+		return NULL;
+	}
+
+	*q = rh.q;
+	*time_us = rh.time_us;
+	return msg;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* A recording of the primitives received from the DSP, written by
+ * osmo-bts-sysmo-remote (L1FWD_RECORD) and fed to osmo-bts-sysmo-replay
+ * (L1REPLAY_FILE).  Host byte order: record and replay on the same kind
+ * of host, with the same femtobts headers. */
+
+#define L1REC_MAGIC	"OBTSL1R1"
+
+struct l1rec_file_hdr {
+	char magic[8];
+	/* to detect recordings made with other headers */
+	uint32_t l1prim_size;
+	uint32_t sysprim_size;
+} __attribute__((packed));
+
+/* followed by len bytes of the primitive */
+struct l1rec_hdr {
+	uint8_t q;		/* MQ_*_WRITE queue it was received on */
+	uint8_t spare;
+	uint16_t len;
+	uint32_t time_us;	/* since the start of the recording */
+} __attribute__((packed));
+
+struct msgb;
+
+int l1rec_open(const char *path);
+void l1rec_write(int q, const struct msgb *msg);
+void l1rec_flush(void);
+
+FILE *l1rec_open_read(const char *path);
+struct msgb *l1rec_read(FILE *f, int *q, uint32_t *time_us);
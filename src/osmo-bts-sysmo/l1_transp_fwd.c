@@ -52,6 +52,7 @@
 #include "l1_if.h"
 #include "l1_transp.h"
 #include "l1_fwd.h"
+#include "l1_rec.h"
 
 static const uint16_t fwd_udp_ports[] = {
 	[MQ_SYS_WRITE]	= L1FWD_SYS_PORT,
@@ -62,46 +63,52 @@ static const uint16_t fwd_udp_ports[] = {
 #endif
 };
 
-static int fwd_read_cb(struct osmo_fd *ofd)
+static struct l1fwd_stats fwd_stats[_NUM_MQ_WRITE];
+static struct osmo_timer_list fwd_stats_timer;
+
+static int fwd_rx_prim(struct osmo_fd *ofd, struct msgb *msg)
 {
-	struct msgb *msg = msgb_alloc_headroom(SYSMOBTS_PRIM_SIZE, 128, "udp_rx");
 	struct femtol1_hdl *fl1h = ofd->data;
-	int rc;
 
-	if (!msg)
-		return -ENOMEM;
-
-	msg->l1h = msg->data;
-	rc = read(ofd->fd, msg->l1h, msgb_tailroom(msg));
-	if (rc < 0) {
-		LOGP(DL1C, LOGL_ERROR, "Short read from UDP\n");
-		msgb_free(msg);
-		return rc;
-	} else if (rc == 0) {
-		LOGP(DL1C, LOGL_ERROR, "Len=0 from UDP\n");
-		msgb_free(msg);
-		return rc;
-	}
-	msgb_put(msg, rc);
+	l1rec_write(ofd->priv_nr, msg);
 
 	if (ofd->priv_nr == MQ_SYS_WRITE)
-		rc = l1if_handle_sysprim(fl1h, msg);
+		return l1if_handle_sysprim(fl1h, msg);
 	else
-		rc = l1if_handle_l1prim(ofd->priv_nr, fl1h, msg);
+		return l1if_handle_l1prim(ofd->priv_nr, fl1h, msg);
+}
 
-	return rc;
+static int fwd_fd_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct femtol1_hdl *fl1h = ofd->data;
+	int q = ofd->priv_nr;
+
+	if (what & OSMO_FD_READ)
+		l1fwd_sock_read(ofd, NULL, NULL, &fwd_stats[q], fwd_rx_prim);
+
+	/* the socket is connected, no destination address needed */
+	if (what & OSMO_FD_WRITE)
+		l1fwd_sock_write(&fl1h->write_q[q], NULL, 0, &fwd_stats[q]);
+
+	return 0;
 }
 
-static int prim_write_cb(struct osmo_fd *ofd, struct msgb *msg)
+static void fwd_stats_timer_cb(void *data)
 {
-	/* write to the fd */
-	return write(ofd->fd, msg->l1h, msgb_l1len(msg));
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fwd_stats); i++)
+		l1fwd_stats_log(i, &fwd_stats[i]);
+	l1rec_flush();
+
+	osmo_timer_schedule(&fwd_stats_timer, L1FWD_STATS_INTERVAL, 0);
 }
 
 int l1if_transport_open(int q, struct femtol1_hdl *fl1h)
 {
 	int rc;
 	char *bts_host = getenv("L1FWD_BTS_HOST");
+	char *rec_path = getenv("L1FWD_RECORD");
 
 	switch (q) {
 	case MQ_L1_WRITE:
@@ -122,17 +129,23 @@ int l1if_transport_open(int q, struct femtol1_hdl *fl1h)
 	struct osmo_wqueue *wq = &fl1h->write_q[q];
 	struct osmo_fd *ofd = &wq->bfd;
 
-	osmo_wqueue_init(wq, 10);
-	wq->write_cb = prim_write_cb;
-	wq->read_cb = fwd_read_cb;
+	osmo_wqueue_init(wq, L1FWD_WQUEUE_LEN);
 
-	osmo_fd_setup(ofd, -1, OSMO_FD_READ, osmo_wqueue_bfd_cb, fl1h, q);
+	osmo_fd_setup(ofd, -1, OSMO_FD_READ, fwd_fd_cb, fl1h, q);
 	rc = osmo_sock_init_ofd(ofd, AF_UNSPEC, SOCK_DGRAM, IPPROTO_UDP,
 				bts_host, fwd_udp_ports[q],
 				OSMO_SOCK_F_CONNECT);
 	if (rc < 0)
 		return rc;
 
+	if (!osmo_timer_pending(&fwd_stats_timer)) {
+		/* record the primitives received from the DSP, for osmo-bts-sysmo-replay */
+		if (rec_path && l1rec_open(rec_path) < 0)
+			exit(2);
+		osmo_timer_setup(&fwd_stats_timer, fwd_stats_timer_cb, NULL);
+		osmo_timer_schedule(&fwd_stats_timer, L1FWD_STATS_INTERVAL, 0);
+	}
+
 	return 0;
 }
 
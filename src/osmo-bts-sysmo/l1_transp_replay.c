@@ -0,0 +1,230 @@
+/* Interface handler for Sysmocom L1 (replay of a recording) */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * osmo-bts-sysmo-replay feeds the primitives recorded by osmo-bts-sysmo-remote
+ * (L1FWD_RECORD) to the L1 interface as fast as the BTS processes them, so
+ * that l1_if.c, tch.c and oml.c can be profiled on any host, without DSP.
+ * Everything the BTS sends towards the DSP is discarded.  A recorded
+ * confirmation is only delivered once the BTS waits for one, i.e. after it
+ * sent the corresponding request; indications are delivered right away.
+ * The BTS needs the same configuration and the same BSC behaviour as during
+ * the recording (e.g. a BSC on the same host), so that it sends its requests
+ * in the same order and with the same handles.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/write_queue.h>
+#include <osmocom/core/msgb.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+
+#include <sysmocom/femtobts/superfemto.h>
+#include <sysmocom/femtobts/gsml1prim.h>
+#include <sysmocom/femtobts/gsml1const.h>
+#include <sysmocom/femtobts/gsml1types.h>
+
+#include "femtobts.h"
+#include "l1_if.h"
+#include "l1_transp.h"
+#include "l1_rec.h"
+
+/* primitives delivered per main loop iteration, so that Abis and VTY keep up */
+#define REPLAY_BATCH		32
+/* poll interval while a confirmation waits for its request */
+#define REPLAY_WAIT_POLL_MS	10
+/* deliver a confirmation anyway if no request came within this time */
+#define REPLAY_WAIT_MAX_S	5
+#define REPLAY_WQUEUE_LEN	64
+
+static struct {
+	FILE *file;
+	struct femtol1_hdl *fl1h;
+	struct osmo_timer_list timer;
+
+	/* next primitive to deliver, read ahead */
+	struct msgb *next;
+	int next_q;
+	uint32_t next_time_us;
+	struct timespec wait_start;
+	bool waiting;
+
+	/* statistics */
+	struct timespec start;
+	uint64_t rx_prims;	/* delivered to the L1 interface */
+	uint64_t tx_prims;	/* discarded requests of the BTS */
+} replay;
+
+static uint64_t elapsed_us(const struct timespec *since)
+{
+	struct timespec now;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - since->tv_sec) * 1000000ULL
+	       + (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+static bool is_conf(int q, const struct msgb *msg)
+{
+	const GsmL1_Prim_t *l1p;
+
+	if (q == MQ_SYS_WRITE)
+		return true;
+
+	l1p = msgb_l1prim(msg);
+	return l1p->id < GsmL1_PrimId_NUM && femtobts_l1prim_type[l1p->id] == L1P_T_CONF;
+}
+
+static void replay_done(void)
+{
+	uint64_t us = elapsed_us(&replay.start);
+
+	LOGP(DL1C, LOGL_NOTICE, "L1 replay done: %" PRIu64 " primitives delivered, %" PRIu64
+	     " discarded in %" PRIu64 " ms (recorded: %u ms)\n", replay.rx_prims, replay.tx_prims,
+	     us / 1000, replay.next_time_us / 1000);
+	exit(0);
+}
+
+static void replay_timer_cb(void *data)
+{
+	struct femtol1_hdl *fl1h = replay.fl1h;
+	unsigned int i;
+
+	for (i = 0; i < REPLAY_BATCH; i++) {
+		struct msgb *msg;
+		int q;
+
+		if (replay.next == NULL) {
+			replay.next = l1rec_read(replay.file, &replay.next_q, &replay.next_time_us);
+			if (replay.next == NULL)
+				replay_done();
+		}
+
+		/* a confirmation only makes sense once its request was sent */
+		if (is_conf(replay.next_q, replay.next) && llist_empty(&fl1h->wlc_list)) {
+			if (!replay.waiting) {
+				replay.waiting = true;
+				osmo_clock_gettime(CLOCK_MONOTONIC, &replay.wait_start);
+			}
+			if (elapsed_us(&replay.wait_start) < REPLAY_WAIT_MAX_S * 1000000ULL) {
+				osmo_timer_schedule(&replay.timer, 0, REPLAY_WAIT_POLL_MS * 1000);
+				return;
+			}
+			LOGP(DL1C, LOGL_NOTICE, "L1 replay: no request for the confirmation at %u ms "
+			     "of the recording, delivering it anyway\n", replay.next_time_us / 1000);
+		}
+		replay.waiting = false;
+
+		msg = replay.next;
+		q = replay.next_q;
+		replay.next = NULL;
+		replay.rx_prims++;
+
+		if (q == MQ_SYS_WRITE)
+			l1if_handle_sysprim(fl1h, msg);
+		else
+			l1if_handle_l1prim(q, fl1h, msg);
+	}
+
+	osmo_timer_schedule(&replay.timer, 0, 0);
+}
+
+/* what the BTS sends towards the DSP is dropped */
+static int replay_write_cb(struct osmo_fd *ofd, struct msgb *msg)
+{
+	replay.tx_prims++;
+
+	/* the awaited request may just have been sent */
+	if (replay.waiting)
+		osmo_timer_schedule(&replay.timer, 0, 0);
+
+	return 0;
+}
+
+int l1if_transport_open(int q, struct femtol1_hdl *fl1h)
+{
+	struct osmo_wqueue *wq = &fl1h->write_q[q];
+	struct osmo_fd *ofd = &wq->bfd;
+	char *path = getenv("L1REPLAY_FILE");
+	int fd;
+
+	if (replay.file == NULL) {
+		if (!path) {
+			fprintf(stderr, "You have to set the L1REPLAY_FILE environment variable\n");
+			exit(2);
+		}
+		replay.file = l1rec_open_read(path);
+		if (replay.file == NULL)
+			exit(2);
+		replay.fl1h = fl1h;
+		osmo_timer_setup(&replay.timer, replay_timer_cb, NULL);
+	}
+
+	/* a file descriptor which is always writable */
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0)
+		return -errno;
+
+	osmo_wqueue_init(wq, REPLAY_WQUEUE_LEN);
+	wq->write_cb = replay_write_cb;
+	osmo_fd_setup(ofd, fd, 0, osmo_wqueue_bfd_cb, fl1h, q);
+	if (osmo_fd_register(ofd) < 0) {
+		close(fd);
+		return -EIO;
+	}
+
+	/* both queues are open now, start feeding the recording */
+	if (q == MQ_L1_WRITE && !osmo_timer_pending(&replay.timer)) {
+		LOGP(DL1C, LOGL_NOTICE, "Replaying the L1 primitives from '%s'\n", path);
+		osmo_clock_gettime(CLOCK_MONOTONIC, &replay.start);
+		osmo_timer_schedule(&replay.timer, 0, 0);
+	}
+
+	return 0;
+}
+
+int l1if_transport_close(int q, struct femtol1_hdl *fl1h)
+{
+	struct osmo_wqueue *wq = &fl1h->write_q[q];
+	struct osmo_fd *ofd = &wq->bfd;
+
+	osmo_wqueue_clear(wq);
+	osmo_fd_unregister(ofd);
+	close(ofd->fd);
+
+	if (q == MQ_L1_WRITE)
+		osmo_timer_del(&replay.timer);
+
+	return 0;
+}
@@ -7,6 +7,8 @@
 #include <osmocom/core/select.h>
 #include <osmocom/core/timer.h>
 
+#include <osmo-bts/mgr_sensor.h>
+
 #include <gps.h>
 
 #if !defined(GPSD_API_MAJOR_VERSION) || GPSD_API_MAJOR_VERSION < 5
@@ -42,13 +44,6 @@ enum {
 	TEMP_ACT_NORM_BTS_SRV_ON=	0x10,
 };
 
-enum sysmobts_temp_state {
-	STATE_NORMAL,		/* Everything is fine */
-	STATE_WARNING_HYST,	/* Go back to normal next? */
-	STATE_WARNING,		/* We are above the warning threshold */
-	STATE_CRITICAL,		/* We have an issue. Wait for below warning */
-};
-
 /**
  * Temperature Limits. We separate from a threshold
  * that will generate a warning and one that is so
@@ -85,7 +80,7 @@ struct sysmobts_mgr_instance {
 	int action_warn;
 	int action_crit;
 
-	enum sysmobts_temp_state state;
+	enum mgr_sensor_state state;
 
 	struct {
 		int initial_calib_started;
@@ -117,7 +112,7 @@ int sysmobts_mgr_parse_config(struct sysmobts_mgr_instance *mgr);
 int sysmobts_mgr_nl_init(void);
 int sysmobts_mgr_temp_init(struct sysmobts_mgr_instance *mgr,
 			   struct ctrl_connection *ctrl);
-const char *sysmobts_mgr_temp_get_state(enum sysmobts_temp_state state);
+const char *sysmobts_mgr_temp_get_state(enum mgr_sensor_state state);
 
 
 int sysmobts_mgr_calib_init(struct sysmobts_mgr_instance *mgr);
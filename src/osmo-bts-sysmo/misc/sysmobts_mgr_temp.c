@@ -29,54 +29,18 @@
 #include <osmocom/core/utils.h>
 
 #include <stdlib.h>
+#include <limits.h>
 
-static struct sysmobts_mgr_instance *s_mgr;
-static struct osmo_timer_list temp_ctrl_timer;
+/* Check every two minutes, and faster close to the thresholds. XXX make it configurable! */
+#define TEMP_TIMER_DURATION		(2 * 60)
+#define TEMP_TIMER_FAST_DURATION	15
 
-static const struct value_string state_names[] = {
-	{ STATE_NORMAL,			"NORMAL" },
-	{ STATE_WARNING_HYST,		"WARNING (HYST)" },
-	{ STATE_WARNING,		"WARNING" },
-	{ STATE_CRITICAL,		"CRITICAL" },
-	{ 0, NULL }
-};
+static struct sysmobts_mgr_instance *s_mgr;
+static struct mgr_sensor_sched temp_sched;
 
-const char *sysmobts_mgr_temp_get_state(enum sysmobts_temp_state state)
+const char *sysmobts_mgr_temp_get_state(enum mgr_sensor_state state)
 {
-	return get_value_string(state_names, state);
-}
-
-static int next_state(enum sysmobts_temp_state current_state, int critical, int warning)
-{
-	int next_state = -1;
-	switch (current_state) {
-	case STATE_NORMAL:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (warning)
-			next_state = STATE_WARNING;
-		break;
-	case STATE_WARNING_HYST:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (warning)
-			next_state = STATE_WARNING;
-		else
-			next_state = STATE_NORMAL;
-		break;
-	case STATE_WARNING:
-		if (critical)
-			next_state = STATE_CRITICAL;
-		else if (!warning)
-			next_state = STATE_WARNING_HYST;
-		break;
-	case STATE_CRITICAL:
-		if (!critical && !warning)
-			next_state = STATE_WARNING;
-		break;
-	};
-
-	return next_state;
+	return mgr_sensor_state_name(state);
 }
 
 static void handle_normal_actions(int actions)
@@ -190,7 +154,7 @@ static void sysmobts_mgr_temp_handle(struct sysmobts_mgr_instance *manager,
 				     struct ctrl_connection *ctrl, int critical,
 				     int warning)
 {
-	int new_state = next_state(manager->state, critical, warning);
+	int new_state = mgr_sensor_next_state(manager->state, critical, warning);
 	struct ctrl_cmd *rep;
 	char *oml_alert = NULL;
 
@@ -199,8 +163,8 @@ static void sysmobts_mgr_temp_handle(struct sysmobts_mgr_instance *manager,
 		return;
 
 	LOGP(DTEMP, LOGL_NOTICE, "Moving from state %s to %s.\n",
-		get_value_string(state_names, manager->state),
-		get_value_string(state_names, new_state));
+		mgr_sensor_state_name(manager->state),
+		mgr_sensor_state_name(new_state));
 	manager->state = new_state;
 	switch (manager->state) {
 	case STATE_NORMAL:
@@ -237,11 +201,11 @@ static void sysmobts_mgr_temp_handle(struct sysmobts_mgr_instance *manager,
 	talloc_free(rep);
 }
 
-static void temp_ctrl_check(struct ctrl_connection *ctrl)
+/* Returns true if the temperature should be checked at the fast rate */
+static bool temp_ctrl_check(void *ctrl)
 {
+	struct mgr_sensor_result res = { 0 };
 	int rc;
-	int warn_thresh_passed = 0;
-	int crit_thresh_passed = 0;
 
 	LOGP(DTEMP, LOGL_DEBUG, "Going to check the temperature.\n");
 
@@ -250,13 +214,11 @@ static void temp_ctrl_check(struct ctrl_connection *ctrl)
 	if (rc < 0) {
 		LOGP(DTEMP, LOGL_ERROR,
 			"Failed to read the digital temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
+		res.warning = res.critical = 1;
 	} else {
 		int temp = rc / 1000;
-		if (temp > s_mgr->digital_limit.thresh_warn)
-			warn_thresh_passed = 1;
-		if (temp > s_mgr->digital_limit.thresh_crit)
-			crit_thresh_passed = 1;
+		mgr_sensor_eval(&res, temp, s_mgr->digital_limit.thresh_warn,
+				s_mgr->digital_limit.thresh_crit);
 		LOGP(DTEMP, LOGL_DEBUG, "Digital temperature is: %d\n", temp);
 	}
 
@@ -265,13 +227,11 @@ static void temp_ctrl_check(struct ctrl_connection *ctrl)
 	if (rc < 0) {
 		LOGP(DTEMP, LOGL_ERROR,
 			"Failed to read the RF temperature. rc=%d\n", rc);
-		warn_thresh_passed = crit_thresh_passed = 1;
+		res.warning = res.critical = 1;
 	} else {
 		int temp = rc / 1000;
-		if (temp > s_mgr->rf_limit.thresh_warn)
-			warn_thresh_passed = 1;
-		if (temp > s_mgr->rf_limit.thresh_crit)
-			crit_thresh_passed = 1;
+		mgr_sensor_eval(&res, temp, s_mgr->rf_limit.thresh_warn,
+				s_mgr->rf_limit.thresh_crit);
 		LOGP(DTEMP, LOGL_DEBUG, "RF temperature is: %d\n", temp);
 	}
 
@@ -283,39 +243,44 @@ static void temp_ctrl_check(struct ctrl_connection *ctrl)
 			/* XXX what do here? */
 			LOGP(DTEMP, LOGL_ERROR,
 				"Failed to read the temperature! Reboot?!\n");
-			warn_thresh_passed = 1;
-			crit_thresh_passed = 1;
+			res.warning = res.critical = 1;
 		} else {
 			LOGP(DTEMP, LOGL_DEBUG, "SBTS2050 board(%d) PA(%d)\n",
 				temp_board, temp_pa);
-			if (temp_pa > s_mgr->pa_limit.thresh_warn)
-				warn_thresh_passed = 1;
-			if (temp_pa > s_mgr->pa_limit.thresh_crit)
-				crit_thresh_passed = 1;
-			if (temp_board > s_mgr->board_limit.thresh_warn)
-				warn_thresh_passed = 1;
-			if (temp_board > s_mgr->board_limit.thresh_crit)
-				crit_thresh_passed = 1;
+			mgr_sensor_eval(&res, temp_pa, s_mgr->pa_limit.thresh_warn,
+					s_mgr->pa_limit.thresh_crit);
+			mgr_sensor_eval(&res, temp_board, s_mgr->board_limit.thresh_warn,
+					s_mgr->board_limit.thresh_crit);
 		}
 	}
 
-	sysmobts_mgr_temp_handle(s_mgr, ctrl, crit_thresh_passed,
-				 warn_thresh_passed);
-}
-
-static void temp_ctrl_check_cb(void *ctrl)
-{
-	temp_ctrl_check(ctrl);
-	/* Check every two minutes? XXX make it configurable! */
-	osmo_timer_schedule(&temp_ctrl_timer, 2 * 60, 0);
+	sysmobts_mgr_temp_handle(s_mgr, ctrl, res.critical, res.warning);
+	return res.near || s_mgr->state != STATE_NORMAL;
 }
 
 int sysmobts_mgr_temp_init(struct sysmobts_mgr_instance *mgr,
 			   struct ctrl_connection *ctrl)
 {
+	static const enum sysmobts_temp_type alarms[] = {
+		SYSMOBTS_TEMP_MAX_ALARM, SYSMOBTS_TEMP_CRIT_ALARM,
+	};
+	char path[PATH_MAX];
+	int sensor;
+	unsigned int i;
+
 	s_mgr = mgr;
-	temp_ctrl_timer.cb = temp_ctrl_check_cb;
-	temp_ctrl_timer.data = ctrl;
-	temp_ctrl_check_cb(ctrl);
+	mgr_sensor_sched_init(&temp_sched, TEMP_TIMER_DURATION, TEMP_TIMER_FAST_DURATION,
+			      DTEMP, temp_ctrl_check, ctrl);
+
+	/* React right away if the hwmon driver signals its own limits */
+	for (sensor = SYSMOBTS_TEMP_DIGITAL; sensor <= SYSMOBTS_TEMP_RF; sensor++) {
+		for (i = 0; i < ARRAY_SIZE(alarms); i++) {
+			if (sysmobts_temp_path(path, sizeof(path), sensor, alarms[i]) < 0)
+				continue;
+			mgr_sensor_watch(&temp_sched, tall_mgr_ctx, path);
+		}
+	}
+
+	mgr_sensor_sched_start(&temp_sched);
 	return 0;
 }
@@ -52,15 +52,15 @@ static const char *temp_type_str[_NUM_TEMP_TYPES] = {
 	[SYSMOBTS_TEMP_INPUT] = "input",
 	[SYSMOBTS_TEMP_LOWEST] = "lowest",
 	[SYSMOBTS_TEMP_HIGHEST] = "highest",
+	[SYSMOBTS_TEMP_MAX_ALARM] = "max_alarm",
+	[SYSMOBTS_TEMP_CRIT_ALARM] = "crit_alarm",
 };
 
-int sysmobts_temp_get(enum sysmobts_temp_sensor sensor,
-		      enum sysmobts_temp_type type)
+/*! Build the hwmon path of attribute \a type of \a sensor.
+ *  \returns 0 on success; negative on error. */
+int sysmobts_temp_path(char *buf, size_t len, enum sysmobts_temp_sensor sensor,
+		       enum sysmobts_temp_type type)
 {
-	char buf[PATH_MAX];
-	char tempstr[8];
-	int fd, rc;
-
 	if (sensor < SYSMOBTS_TEMP_DIGITAL ||
 	    sensor > SYSMOBTS_TEMP_RF)
 		return -EINVAL;
@@ -68,8 +68,20 @@ int sysmobts_temp_get(enum sysmobts_temp_sensor sensor,
 	if (type >= ARRAY_SIZE(temp_type_str))
 		return -EINVAL;
 
-	snprintf(buf, sizeof(buf)-1, TEMP_PATH, sensor, temp_type_str[type]);
-	buf[sizeof(buf)-1] = '\0';
+	snprintf(buf, len, TEMP_PATH, sensor, temp_type_str[type]);
+	return 0;
+}
+
+int sysmobts_temp_get(enum sysmobts_temp_sensor sensor,
+		      enum sysmobts_temp_type type)
+{
+	char buf[PATH_MAX];
+	char tempstr[8];
+	int fd, rc;
+
+	rc = sysmobts_temp_path(buf, sizeof(buf), sensor, type);
+	if (rc < 0)
+		return rc;
 
 	fd = open(buf, O_RDONLY);
 	if (fd < 0)
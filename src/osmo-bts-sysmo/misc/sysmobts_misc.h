@@ -2,6 +2,7 @@
 #define _SYSMOBTS_MISC_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 enum sysmobts_temp_sensor {
 	SYSMOBTS_TEMP_DIGITAL = 1,
@@ -12,9 +13,13 @@ enum sysmobts_temp_type {
 	SYSMOBTS_TEMP_INPUT,
 	SYSMOBTS_TEMP_LOWEST,
 	SYSMOBTS_TEMP_HIGHEST,
+	SYSMOBTS_TEMP_MAX_ALARM,
+	SYSMOBTS_TEMP_CRIT_ALARM,
 	_NUM_TEMP_TYPES
 };
 
+int sysmobts_temp_path(char *buf, size_t len, enum sysmobts_temp_sensor sensor,
+		       enum sysmobts_temp_type type);
 int sysmobts_temp_get(enum sysmobts_temp_sensor sensor,
 		      enum sysmobts_temp_type type);
 
@@ -1728,8 +1728,9 @@ int bts_model_apply_oml(struct gsm_bts *bts, const struct msgb *msg,
 		trx = obj;
 		fl1h = trx_femtol1_hdl(trx);
 
-		/* Did we go through MphInit yet? If yes fire and forget */
-		if (fl1h->hLayer1)
+		/* Did we go through MphInit yet? If yes fire and forget,
+		 * unless the power does not change */
+		if (fl1h->hLayer1 && !power_ramp_target_is(trx, get_p_target_mdBm(trx, 0)))
 			power_ramp_start(trx, get_p_target_mdBm(trx, 0), 0, NULL);
 		break;
 	}
@@ -1916,6 +1917,18 @@ int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 	return l1if_gsm_req_compl(fl1h, msg, ts_disconnect_cb, NULL);
 }
 
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	/* the DSP releases its SAPIs one by one, see bts_model_lchan_deactivate() */
+	return -ENOTSUP;
+}
+
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2)
+{
+	/* the DSP encodes the CBCH blocks itself */
+	return -ENOTSUP;
+}
+
 static int ts_connect_cb(struct gsm_bts_trx *trx, struct msgb *l1_msg,
 			 void *data)
 {
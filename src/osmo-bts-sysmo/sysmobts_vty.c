@@ -147,6 +147,28 @@ DEFUN(cfg_phy_cal_path, cfg_phy_cal_path_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_phy_cal_cache, cfg_phy_cal_cache_cmd,
+	"trx-calibration-cache PATH",
+	"Cache the parsed TRX calibration data in a binary file\n" "Path name of the cache file\n")
+{
+	struct phy_instance *pinst = vty->index;
+
+	osmo_talloc_replace_string(pinst, &pinst->u.sysmobts.calib_cache, argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_no_cal_cache, cfg_phy_no_cal_cache_cmd,
+	"no trx-calibration-cache",
+	NO_STR "Do not cache the parsed TRX calibration data\n")
+{
+	struct phy_instance *pinst = vty->index;
+
+	TALLOC_FREE(pinst->u.sysmobts.calib_cache);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN_DEPRECATED(cfg_trx_ul_power_target, cfg_trx_ul_power_target_cmd,
 	"uplink-power-target <-110-0>",
 	"Obsolete alias for bts uplink-power-target\n"
@@ -478,6 +500,9 @@ void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance
 	if (pinst->u.sysmobts.calib_path)
 		vty_out(vty, "  trx-calibration-path %s%s",
 			pinst->u.sysmobts.calib_path, VTY_NEWLINE);
+	if (pinst->u.sysmobts.calib_cache)
+		vty_out(vty, "  trx-calibration-cache %s%s",
+			pinst->u.sysmobts.calib_cache, VTY_NEWLINE);
 	if (pinst->u.sysmobts.clk_src)
 		vty_out(vty, "  clock-source %s%s",
 			get_value_string(femtobts_clksrc_names,
@@ -545,6 +570,8 @@ int bts_model_vty_init(void *ctx)
 	install_element(PHY_INST_NODE, &cfg_phy_clkcal_def_cmd);
 	install_element(PHY_INST_NODE, &cfg_phy_clksrc_cmd);
 	install_element(PHY_INST_NODE, &cfg_phy_cal_path_cmd);
+	install_element(PHY_INST_NODE, &cfg_phy_cal_cache_cmd);
+	install_element(PHY_INST_NODE, &cfg_phy_no_cal_cache_cmd);
 
 	return 0;
 }
@@ -153,39 +153,62 @@ static int rtppayload_to_l1_efr(uint8_t *l1_payload, const uint8_t *rtp_payload,
 #endif /* L1_HAS_EFR */
 
 #ifdef USE_L1_RTP_MODE
+/* read a field of up to 16 bits at bit offset 'pos' (MSB first) */
+static inline unsigned int hr_get_field(const uint8_t *buf, unsigned int pos, unsigned int len)
+{
+	const uint8_t *b = &buf[pos >> 3];
+	uint32_t w = (b[0] << 16) | (b[1] << 8) | b[2];
+
+	return (w >> (24 - (pos & 7) - len)) & ((1 << len) - 1);
+}
+
+/* OR a field of up to 16 bits into the buffer at bit offset 'pos' (MSB first) */
+static inline void hr_put_field(uint8_t *buf, unsigned int pos, unsigned int len, unsigned int val)
+{
+	uint8_t *b = &buf[pos >> 3];
+	uint32_t w = val << (24 - (pos & 7) - len);
+
+	b[0] |= w >> 16;
+	b[1] |= w >> 8;
+	b[2] |= w;
+}
+
 /* change the bit-order of each unaligned field inside the HR codec
  * payload from little-endian bit-ordering to bit-endian and vice-versa.
  * This is required on all sysmoBTS DSP versions < 5.3.3 in order to
  * be compliant with ETSI TS 101 318 Chapter 5.2 */
-static void hr_jumble(uint8_t *dst, const uint8_t *src)
+void hr_jumble(uint8_t *dst, const uint8_t *src)
 {
 	/* Table 2 / Section 5.2.1 of ETSI TS 101 381 */
-	const int p_unvoiced[] =
+	static const uint8_t p_unvoiced[] =
 		{ 5, 11,  9,  8,  1,  2,  7,  7,  5,  7,  7,  5,  7,  7,  5,  7,  7,  5 };
 	/* Table 3 / Section 5.2.1 of ETSI TS 101 381 */
-	const int p_voiced[] =
+	static const uint8_t p_voiced[] =
 		{ 5, 11,  9,  8,  1,  2,  8,  9,  5,  4,  9,  5,  4,  9,  5,  4,  9,  5 };
 
-	int base, i, j, l, si, di;
-	const int *p;
+	/* two octets of padding, so that hr_{get,put}_field() may access
+	 * the three octets around the last field */
+	uint8_t in[GSM_HR_BYTES + 2] = { 0 };
+	uint8_t out[GSM_HR_BYTES + 2] = { 0 };
+	unsigned int base, i, l, v;
+	const uint8_t *p;
 
-	memset(dst, 0x00, GSM_HR_BYTES);
+	memcpy(in, src, GSM_HR_BYTES);
 
 	p = (src[4] & 0x30) ? p_voiced : p_unvoiced;
 
+	/* reverse each field as a whole, instead of bit by bit */
 	base = 0;
-	for (i = 0; i < 18; i++) {
+	for (i = 0; i < ARRAY_SIZE(p_voiced); i++) {
 		l = p[i];
-		for (j = 0; j < l; j++) {
-			si = base + j;
-			di = base + l - j - 1;
-
-			if (src[si >> 3] & (1 << (7 - (si & 7))))
-				dst[di >> 3] |= (1 << (7 - (di & 7)));
-		}
+		v = hr_get_field(in, base, l);
+		v = ((osmo_revbytebits_8(v & 0xff) << 8) | osmo_revbytebits_8(v >> 8)) >> (16 - l);
+		hr_put_field(out, base, l, v);
 
 		base += l;
 	}
+
+	memcpy(dst, out, GSM_HR_BYTES);
 }
 #endif /* USE_L1_RTP_MODE */
 
@@ -426,7 +449,7 @@ int l1if_tch_encode(struct gsm_lchan *lchan, uint8_t *data, uint8_t *len,
 		}
 
 		/* DTX DL-specific logic below: */
-		switch (lchan->tch.dtx.dl_amr_fsm->state) {
+		switch (lchan->tch.dtx.dl_amr_state) {
 		case ST_ONSET_V:
 			*payload_type = GsmL1_TchPlType_Amr_Onset;
 			dtx_cache_payload(lchan, rtp_pl, rtp_pl_len, fn, 0);
@@ -471,7 +494,7 @@ int l1if_tch_encode(struct gsm_lchan *lchan, uint8_t *data, uint8_t *len,
 			return -EBADMSG;
 		default:
 			LOGP(DRTP, LOGL_ERROR, "Unhandled DTX DL AMR FSM state "
-			     "%d\n", lchan->tch.dtx.dl_amr_fsm->state);
+			     "%d\n", lchan->tch.dtx.dl_amr_state);
 			return -EINVAL;
 		}
 		break;
@@ -69,9 +69,7 @@ void trx_loop_amr_input(struct l1sched_chan_state *chan_state,
 
 	/* If the current codec mode can be degraded */
 	if (mi > 0) {
-		/* The threshold/hysteresis is in 0.5 dB steps, convert to cB:
-		 * 1dB is 10cB, so 0.5dB is 5cB - this is why we multiply by 5. */
-		const int thresh_lower_cb = cfg->mode[mi - 1].threshold * 5;
+		const int thresh_lower_cb = cfg->thresh_dn_cb[mi];
 
 		/* Degrade if the link quality is below THR_MX_Dn(i - 1) */
 		if (lqual_cb < thresh_lower_cb) {
@@ -86,10 +84,7 @@ void trx_loop_amr_input(struct l1sched_chan_state *chan_state,
 
 	/* If the current codec mode can be upgraded */
 	if (mi < chan_state->codecs - 1) {
-		/* The threshold/hysteresis is in 0.5 dB steps, convert to cB:
-		 * 1dB is 10cB, so 0.5dB is 5cB - this is why we multiply by 5. */
-		const int thresh_upper_cb = cfg->mode[mi].threshold * 5 \
-					  + cfg->mode[mi].hysteresis * 5;
+		const int thresh_upper_cb = cfg->thresh_up_cb[mi];
 
 		/* Upgrade if the link quality is above THR_MX_Up(i) */
 		if (lqual_cb > thresh_upper_cb) {
@@ -0,0 +1,288 @@
+/* Placement of the threads, memory and TRXD sockets of a PHY link */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * On multi-socket hosts, the TDMA scheduler, the TRXD socket processing and
+ * the memory they work on are best kept on the NUMA node the NIC talking to
+ * the transceiver is attached to.  The placement is applied when the PHY
+ * link is opened, on the main thread: its CPU affinity, and the memory
+ * policy for the allocations made from then on (the scheduler structures
+ * allocated by trx_sched_set_pchan() and the msgb pools filled at run time).
+ * The worker threads get the same CPU set when they are started.
+ *
+ * The memory policy is set with the plain set_mempolicy() syscall, so that
+ * there is no dependency on libnuma.  Memory which has been faulted in
+ * before stays where it is.
+ */
+
+#define _GNU_SOURCE /* cpu_set_t, sched_getcpu(), pthread_*affinity_np() */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/phy_link.h>
+
+#include "cpu_placement.h"
+
+/* Node mask passed to the kernel, big enough for 'mem-node <0-63>' */
+#define MEM_NODE_MASK_BITS	128
+#define MEM_NODE_MASK_LONGS	(MEM_NODE_MASK_BITS / (8 * sizeof(unsigned long)))
+
+/* Parse a CPU list like "2-5,8" */
+static int cpus_parse(const char *str, cpu_set_t *set)
+{
+	const char *p = str;
+
+	CPU_ZERO(set);
+
+	while (*p != '\0') {
+		unsigned long first, last;
+		char *end;
+
+		if (!isdigit((unsigned char) *p))
+			return -EINVAL;
+		first = last = strtoul(p, &end, 10);
+		if (*end == '-') {
+			p = end + 1;
+			if (!isdigit((unsigned char) *p))
+				return -EINVAL;
+			last = strtoul(p, &end, 10);
+		}
+		if (last < first || last >= CPU_SETSIZE)
+			return -EINVAL;
+		for (; first <= last; first++)
+			CPU_SET(first, set);
+
+		p = end;
+		if (*p == ',' && *(p + 1) != '\0')
+			p++;
+		else if (*p != '\0')
+			return -EINVAL;
+	}
+
+	return CPU_COUNT(set) > 0 ? 0 : -EINVAL;
+}
+
+/* Print a CPU set as list of ranges, the inverse of cpus_parse() */
+static void cpus_print(char *buf, size_t buf_len, const cpu_set_t *set)
+{
+	unsigned int cpu, first;
+	size_t pos = 0;
+
+	buf[0] = '\0';
+	for (cpu = 0; cpu < CPU_SETSIZE && pos < buf_len; cpu++) {
+		if (!CPU_ISSET(cpu, set))
+			continue;
+		first = cpu;
+		while (cpu + 1 < CPU_SETSIZE && CPU_ISSET(cpu + 1, set))
+			cpu++;
+		if (cpu == first)
+			pos += snprintf(buf + pos, buf_len - pos, "%s%u", pos ? "," : "", first);
+		else
+			pos += snprintf(buf + pos, buf_len - pos, "%s%u-%u", pos ? "," : "", first, cpu);
+	}
+}
+
+/*! Check a CPU list given for 'osmotrx cpu-placement cpus'. */
+bool cpu_placement_cpus_valid(const char *cpus)
+{
+	cpu_set_t set;
+
+	return cpus_parse(cpus, &set) == 0;
+}
+
+/*! Apply the placement of a PHY link to the calling (main) thread.
+ *  \returns 0 on success; negative on error. */
+int cpu_placement_apply(const struct phy_link *plink)
+{
+	const char *cpus = plink->u.osmotrx.placement.cpus;
+	int mem_node = plink->u.osmotrx.placement.mem_node;
+	cpu_set_t set;
+
+	if (cpus != NULL) {
+		if (cpus_parse(cpus, &set) != 0)
+			return -EINVAL;
+		if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+			LOGPPHL(plink, DL1C, LOGL_ERROR, "Failed to set the CPU affinity to %s: %s\n",
+				cpus, strerror(errno));
+			return -errno;
+		}
+		LOGPPHL(plink, DL1C, LOGL_NOTICE, "Main thread bound to CPU(s) %s\n", cpus);
+	}
+
+	if (mem_node >= 0) {
+		unsigned long mask[MEM_NODE_MASK_LONGS] = { 0 };
+
+		mask[mem_node / (8 * sizeof(unsigned long))] |= 1UL << (mem_node % (8 * sizeof(unsigned long)));
+		if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, MEM_NODE_MASK_BITS) != 0) {
+			LOGPPHL(plink, DL1C, LOGL_ERROR, "Failed to prefer memory of NUMA node %d: %s\n",
+				mem_node, strerror(errno));
+			return -errno;
+		}
+		LOGPPHL(plink, DL1C, LOGL_NOTICE, "Preferring memory of NUMA node %d\n", mem_node);
+	}
+
+	return 0;
+}
+
+/*! Bind a worker thread started for a PHY link to its CPU set (if any).
+ *  \returns 0 on success; negative on error. */
+int cpu_placement_apply_thread(const struct phy_link *plink, pthread_t thread, const char *name)
+{
+	const char *cpus = plink->u.osmotrx.placement.cpus;
+	cpu_set_t set;
+	int rc;
+
+	if (cpus == NULL)
+		return 0;
+	if (cpus_parse(cpus, &set) != 0)
+		return -EINVAL;
+
+	rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+	if (rc != 0) {
+		LOGPPHL(plink, DL1C, LOGL_ERROR, "Failed to set the CPU affinity of %s to %s: %s\n",
+			name, cpus, strerror(rc));
+		return -rc;
+	}
+
+	return 0;
+}
+
+/*! Apply the socket options of a PHY link to a TRXD socket.  Failures are
+ *  logged, but do not prevent using the socket. */
+void cpu_placement_apply_trxd(const struct phy_link *plink, int fd)
+{
+	int val;
+
+	if (plink->u.osmotrx.placement.trxd_incoming_cpu >= 0) {
+		val = plink->u.osmotrx.placement.trxd_incoming_cpu;
+#ifdef SO_INCOMING_CPU
+		if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &val, sizeof(val)) != 0)
+			LOGPPHL(plink, DTRX, LOGL_ERROR, "Failed to set SO_INCOMING_CPU %d on the TRXD socket: %s\n",
+				val, strerror(errno));
+#else
+		LOGPPHL(plink, DTRX, LOGL_ERROR, "SO_INCOMING_CPU is not supported, ignoring\n");
+#endif
+	}
+
+	if (plink->u.osmotrx.placement.trxd_busy_poll > 0) {
+		val = plink->u.osmotrx.placement.trxd_busy_poll;
+#ifdef SO_BUSY_POLL
+		/* raising it above net.core.busy_read requires CAP_NET_ADMIN */
+		if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) != 0)
+			LOGPPHL(plink, DTRX, LOGL_ERROR, "Failed to set SO_BUSY_POLL %d us on the TRXD socket: %s\n",
+				val, strerror(errno));
+#else
+		LOGPPHL(plink, DTRX, LOGL_ERROR, "SO_BUSY_POLL is not supported, ignoring\n");
+#endif
+	}
+}
+
+/*! Print the CPU affinity of a thread. */
+int cpu_placement_thread_cpus(pthread_t thread, char *buf, size_t buf_len)
+{
+	cpu_set_t set;
+	int rc;
+
+	rc = pthread_getaffinity_np(thread, sizeof(set), &set);
+	if (rc != 0)
+		return -rc;
+	cpus_print(buf, buf_len, &set);
+	return 0;
+}
+
+/*! CPU the calling thread is running on, or negative on error. */
+int cpu_placement_current_cpu(void)
+{
+	return sched_getcpu();
+}
+
+/*! Print the memory policy of the calling thread. */
+int cpu_placement_mem_policy(char *buf, size_t buf_len)
+{
+	unsigned long mask[MEM_NODE_MASK_LONGS] = { 0 };
+	unsigned int node;
+	size_t pos;
+	int mode;
+
+	if (syscall(SYS_get_mempolicy, &mode, mask, MEM_NODE_MASK_BITS, NULL, 0) != 0)
+		return -errno;
+
+	switch (mode) {
+	case MPOL_DEFAULT:
+		snprintf(buf, buf_len, "default");
+		return 0;
+	case MPOL_PREFERRED:
+		pos = snprintf(buf, buf_len, "preferred");
+		break;
+	case MPOL_BIND:
+		pos = snprintf(buf, buf_len, "bind");
+		break;
+	case MPOL_INTERLEAVE:
+		pos = snprintf(buf, buf_len, "interleave");
+		break;
+	default:
+		pos = snprintf(buf, buf_len, "mode %d", mode);
+		break;
+	}
+
+	for (node = 0; node < MEM_NODE_MASK_BITS && pos < buf_len; node++) {
+		if (mask[node / (8 * sizeof(unsigned long))] & (1UL << (node % (8 * sizeof(unsigned long)))))
+			pos += snprintf(buf + pos, buf_len - pos, " node %u", node);
+	}
+
+	return 0;
+}
+
+/*! Read back the effective socket options of a TRXD socket (-1: unknown). */
+int cpu_placement_trxd_get(int fd, int *incoming_cpu, int *busy_poll_us)
+{
+	socklen_t len;
+
+	*incoming_cpu = -1;
+	*busy_poll_us = -1;
+
+#ifdef SO_INCOMING_CPU
+	len = sizeof(*incoming_cpu);
+	if (getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, incoming_cpu, &len) != 0)
+		*incoming_cpu = -1;
+#endif
+#ifdef SO_BUSY_POLL
+	len = sizeof(*busy_poll_us);
+	if (getsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, busy_poll_us, &len) != 0)
+		*busy_poll_us = -1;
+#endif
+	(void) len;
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+struct phy_link;
+
+/* Placement of the threads, memory and TRXD sockets of a PHY link on the
+ * CPUs / NUMA node close to the transceiver, see 'osmotrx cpu-placement' */
+
+bool cpu_placement_cpus_valid(const char *cpus);
+int cpu_placement_apply(const struct phy_link *plink);
+int cpu_placement_apply_thread(const struct phy_link *plink, pthread_t thread, const char *name);
+void cpu_placement_apply_trxd(const struct phy_link *plink, int fd);
+
+/* Effective placement, for 'show cpu-placement' */
+int cpu_placement_thread_cpus(pthread_t thread, char *buf, size_t buf_len);
+int cpu_placement_current_cpu(void);
+int cpu_placement_mem_policy(char *buf, size_t buf_len);
+int cpu_placement_trxd_get(int fd, int *incoming_cpu, int *busy_poll_us);
@@ -0,0 +1,229 @@
+/* TDMA frame budget watchdog, sheds optional work under load */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * trx_fn_timer_cb() feeds the load of every TDMA frame: the time spent in
+ * bts_sched_fn() plus the lateness of the FN timer, which accounts for the
+ * work done in the other callbacks of the main loop (TRXD, Abis, VTY...).
+ * Once per check period, the longest frame is compared against the budget
+ * of a TDMA frame.  Above 'high' percent, or if FN timer expirations were
+ * missed, one more step of optional work is shed.  Only after a number of
+ * consecutive periods below 'low' percent, the last shed step is restored.
+ * One step per period keeps the watchdog from overreacting to a single
+ * slow frame, the gap between the thresholds and the quiet periods keep it
+ * from oscillating.
+ */
+
+#include <stdint.h>
+#include <inttypes.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm0502.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/logging.h>
+
+#include "l1_if.h"
+#include "fn_budget.h"
+
+/*! TDMA frames per check period (one TCH multiframe) */
+#define FN_BUDGET_PERIOD_FRAMES		26
+/*! consecutive quiet check periods (~2 s) before a step is restored */
+#define FN_BUDGET_QUIET_PERIODS		17
+
+/* category log levels of a log target, saved by FN_BUDGET_STEP_DEBUG_LOG */
+struct fn_budget_saved_log {
+	struct llist_head list;
+	struct log_target *target;
+	unsigned int num_cat;
+	uint8_t loglevel[0];
+};
+
+static const struct value_string fn_budget_step_names[] = {
+	{ FN_BUDGET_STEP_GSMTAP,	"gsmtap" },
+	{ FN_BUDGET_STEP_DEBUG_LOG,	"debug-log" },
+	{ FN_BUDGET_STEP_INTERF_MEAS,	"interf-meas" },
+	{ FN_BUDGET_STEP_REP_ACCH,	"rep-acch" },
+	{ FN_BUDGET_STEP_STATS,		"stats" },
+	{ 0, NULL }
+};
+
+const char *fn_budget_step_name(enum fn_budget_step step)
+{
+	return get_value_string(fn_budget_step_names, step);
+}
+
+void fn_budget_init(struct fn_budget *fb)
+{
+	fb->enabled = false;
+	fb->high_pct = 80;
+	fb->low_pct = 50;
+	INIT_LLIST_HEAD(&fb->saved_log);
+}
+
+static bool log_target_exists(const struct log_target *target)
+{
+	const struct log_target *tgt;
+
+	llist_for_each_entry(tgt, &osmo_log_target_list, entry) {
+		if (tgt == target)
+			return true;
+	}
+	return false;
+}
+
+/* raise the level of all categories logging below NOTICE to NOTICE */
+static void shed_debug_log(struct fn_budget *fb, void *ctx)
+{
+	struct fn_budget_saved_log *saved;
+	struct log_target *tgt;
+	unsigned int i;
+
+	llist_for_each_entry(tgt, &osmo_log_target_list, entry) {
+		saved = talloc_size(ctx, sizeof(*saved) + osmo_log_info->num_cat);
+		if (saved == NULL)
+			continue;
+		saved->target = tgt;
+		saved->num_cat = osmo_log_info->num_cat;
+
+		for (i = 0; i < saved->num_cat; i++) {
+			saved->loglevel[i] = tgt->categories[i].loglevel;
+			if (tgt->categories[i].loglevel < LOGL_NOTICE)
+				log_set_category_filter(tgt, i, tgt->categories[i].enabled, LOGL_NOTICE);
+		}
+		llist_add_tail(&saved->list, &fb->saved_log);
+	}
+}
+
+/* restore the saved levels, unless changed (e.g. via VTY) in the meantime */
+static void restore_debug_log(struct fn_budget *fb)
+{
+	struct fn_budget_saved_log *saved, *tmp;
+	struct log_target *tgt;
+	unsigned int i;
+
+	llist_for_each_entry_safe(saved, tmp, &fb->saved_log, list) {
+		tgt = saved->target;
+		if (log_target_exists(tgt)) {
+			for (i = 0; i < saved->num_cat; i++) {
+				if (saved->loglevel[i] < LOGL_NOTICE &&
+				    tgt->categories[i].loglevel == LOGL_NOTICE)
+					log_set_category_filter(tgt, i, tgt->categories[i].enabled,
+								saved->loglevel[i]);
+			}
+		}
+		llist_del(&saved->list);
+		talloc_free(saved);
+	}
+}
+
+static void fn_budget_apply(struct gsm_bts *bts, enum fn_budget_step step, bool shed)
+{
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
+	struct fn_budget *fb = &bts_trx->fn_budget;
+
+	switch (step) {
+	case FN_BUDGET_STEP_GSMTAP:
+		bts->gsmtap.shed = shed;
+		break;
+	case FN_BUDGET_STEP_DEBUG_LOG:
+		if (shed)
+			shed_debug_log(fb, bts_trx);
+		else
+			restore_debug_log(fb);
+		break;
+	default:
+		/* checked with fn_budget_shed() where the work is done */
+		break;
+	}
+}
+
+/*! Account the load of a TDMA frame, shed or restore optional work.
+ *  \param[in] bts BTS instance
+ *  \param[in] load_us processing time of the frame plus the FN timer lateness
+ *  \param[in] missed number of FN timer expirations missed before this frame */
+void fn_budget_feed(struct gsm_bts *bts, int64_t load_us, unsigned int missed)
+{
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
+	struct fn_budget *fb = &bts_trx->fn_budget;
+	int64_t high_us, low_us;
+
+	if (!fb->enabled)
+		return;
+
+	if (load_us > fb->load_us_max)
+		fb->load_us_max = load_us;
+	fb->missed += missed;
+	if (++fb->frames < FN_BUDGET_PERIOD_FRAMES)
+		return;
+
+	high_us = GSM_TDMA_FN_DURATION_uS * fb->high_pct / 100;
+	low_us = GSM_TDMA_FN_DURATION_uS * fb->low_pct / 100;
+
+	if (fb->missed > 0 || fb->load_us_max > high_us) {
+		fb->quiet_periods = 0;
+		if (fb->level < _NUM_FN_BUDGET_STEP) {
+			fn_budget_apply(bts, fb->level, true);
+			rate_ctr_inc2(bts_trx->ctrs, BTSTRX_CTR_FN_BUDGET_SHED_GSMTAP + fb->level);
+			LOGP(DL1C, LOGL_NOTICE, "TDMA frame budget: longest frame %" PRId64 " us, "
+			     "%u FN missed, shedding '%s'\n", fb->load_us_max, fb->missed,
+			     fn_budget_step_name(fb->level));
+			fb->level++;
+		}
+	} else if (fb->load_us_max < low_us && fb->level > 0) {
+		if (++fb->quiet_periods >= FN_BUDGET_QUIET_PERIODS) {
+			fb->quiet_periods = 0;
+			fb->level--;
+			fn_budget_apply(bts, fb->level, false);
+			LOGP(DL1C, LOGL_NOTICE, "TDMA frame budget: longest frame %" PRId64 " us, "
+			     "restoring '%s'\n", fb->load_us_max, fn_budget_step_name(fb->level));
+		}
+	} else {
+		fb->quiet_periods = 0;
+	}
+
+	osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_FN_BUDGET_LEVEL),
+			   fb->level);
+
+	fb->frames = 0;
+	fb->load_us_max = 0;
+	fb->missed = 0;
+}
+
+/*! Restore everything shed, e.g. when the watchdog is disabled */
+void fn_budget_restore_all(struct gsm_bts *bts)
+{
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
+	struct fn_budget *fb = &bts_trx->fn_budget;
+
+	while (fb->level > 0) {
+		fb->level--;
+		fn_budget_apply(bts, fb->level, false);
+	}
+
+	osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_FN_BUDGET_LEVEL), 0);
+	fb->frames = 0;
+	fb->load_us_max = 0;
+	fb->missed = 0;
+	fb->quiet_periods = 0;
+}
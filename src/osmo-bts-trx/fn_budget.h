@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <osmocom/core/linuxlist.h>
+
+struct gsm_bts;
+
+/* Optional work, shed in this order when the TDMA frame processing runs out
+ * of headroom and restored in the reverse order, see 'fn-budget-watchdog' */
+enum fn_budget_step {
+	FN_BUDGET_STEP_GSMTAP,		/* GSMTAP Um logging (pcap capture is kept) */
+	FN_BUDGET_STEP_DEBUG_LOG,	/* DEBUG and INFO log messages */
+	FN_BUDGET_STEP_INTERF_MEAS,	/* every other interference report */
+	FN_BUDGET_STEP_REP_ACCH,	/* combining of repeated Uplink SACCH blocks */
+	FN_BUDGET_STEP_STATS,		/* per-frame stat items, frequent counter flushes */
+	_NUM_FN_BUDGET_STEP
+};
+
+struct fn_budget {
+	/* configuration */
+	bool enabled;
+	uint8_t high_pct;	/* shed the next step above this share of a TDMA frame */
+	uint8_t low_pct;	/* restore the last step below it */
+
+	/* number of steps currently shed */
+	unsigned int level;
+
+	/* the current check period */
+	unsigned int frames;
+	int64_t load_us_max;	/* longest frame: processing time plus timer lateness */
+	unsigned int missed;	/* FN timer expirations missed */
+	/* consecutive check periods below low_pct */
+	unsigned int quiet_periods;
+
+	/* log levels saved by FN_BUDGET_STEP_DEBUG_LOG */
+	struct llist_head saved_log;
+};
+
+void fn_budget_init(struct fn_budget *fb);
+void fn_budget_feed(struct gsm_bts *bts, int64_t load_us, unsigned int missed);
+void fn_budget_restore_all(struct gsm_bts *bts);
+const char *fn_budget_step_name(enum fn_budget_step step);
+
+static inline bool fn_budget_shed(const struct fn_budget *fb, enum fn_budget_step step)
+{
+	return fb->level > step;
+}
@@ -31,6 +31,7 @@
 #include <osmocom/core/bits.h>
 #include <osmocom/core/fsm.h>
 #include <osmocom/codec/ecu.h>
+#include <osmocom/coding/gsm0503_coding.h>
 #include <osmocom/gsm/abis_nm.h>
 #include <osmocom/gsm/rsl.h>
 
@@ -248,7 +249,8 @@ static uint8_t trx_set_trx(struct gsm_bts_trx *trx)
 	   is already running. Otherwise skip, power ramping will be started
 	   after TRX is running */
 	if (plink->u.osmotrx.powered && l1h->config.forced_max_power_red == -1 &&
-	    trx->mo.nm_state.administrative == NM_STATE_UNLOCKED)
+	    trx->mo.nm_state.administrative == NM_STATE_UNLOCKED &&
+	    !power_ramp_target_is(pinst->trx, get_p_nominal_mdBm(pinst->trx)))
 		power_ramp_start(pinst->trx, get_p_nominal_mdBm(pinst->trx), 0, NULL);
 
 	return 0;
@@ -317,6 +319,7 @@ static uint8_t trx_set_ts_as_pchan(struct gsm_bts_trx_ts *ts,
 static uint8_t trx_set_ts(struct gsm_bts_trx_ts *ts)
 {
 	enum gsm_phys_chan_config pchan;
+	uint8_t rc;
 
 	/* For dynamic timeslots, pick the pchan type that should currently be
 	 * active. This should only be called during init, PDCH transitions
@@ -336,7 +339,13 @@ static uint8_t trx_set_ts(struct gsm_bts_trx_ts *ts)
 		break;
 	}
 
-	return trx_set_ts_as_pchan(ts, pchan);
+	rc = trx_set_ts_as_pchan(ts, pchan);
+
+	/* (re)build the hopping sequence tables (if enabled), once the
+	 * scheduler structures of the timeslot have been allocated */
+	trx_sched_fh_setup(ts);
+
+	return rc;
 }
 
 
@@ -702,6 +711,39 @@ int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 	return 0;
 }
 
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	unsigned int ln;
+
+	/* deactivate dedicated and associated channels in one pass */
+	trx_sched_release_lchans(ts, lchan_mask);
+
+	for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++) {
+		struct gsm_lchan *lchan = &ts->lchan[ln];
+		uint8_t chan_nr = gsm_lchan2chan_nr(lchan);
+
+		if (~lchan_mask & (1 << ln))
+			continue;
+		if ((chan_nr & 0xE0) == 0x80) {
+			LOGPLCHAN(lchan, DL1C, LOGL_ERROR, "Cannot deactivate"
+				  " channel %s\n", rsl_chan_nr_str(chan_nr));
+			continue;
+		}
+
+		lchan->ciph_state = 0;
+		lchan_set_state(lchan, LCHAN_S_NONE);
+		mph_info_chan_confirm(ts->trx, chan_nr, PRIM_INFO_DEACTIVATE, 0);
+	}
+
+	return 0;
+}
+
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2)
+{
+	/* taken by xcch_encode_cached() via bts_cbch_get_bursts() */
+	return gsm0503_xcch_encode(bursts, l2);
+}
+
 void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
 			 enum gsm_phys_chan_config as_pchan)
 {
@@ -2,10 +2,16 @@
 #define L1_IF_H_TRX
 
 #include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
 
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/phy_link.h>
+#include <osmo-bts/rate_ctr_shard.h>
 #include "trx_if.h"
+#include "fn_budget.h"
+
+struct mmsghdr;
+struct iovec;
 
 /*
  * TRX frame clock handling
@@ -32,6 +38,70 @@ enum {
 	BTSTRX_CTR_SCHED_DL_FH_NO_CARRIER,
 	BTSTRX_CTR_SCHED_DL_FH_CACHE_MISS,
 	BTSTRX_CTR_SCHED_UL_FH_NO_CARRIER,
+	BTSTRX_CTR_TRXD_RX_BATCH_1,
+	BTSTRX_CTR_TRXD_RX_BATCH_2_3,
+	BTSTRX_CTR_TRXD_RX_BATCH_4_7,
+	BTSTRX_CTR_TRXD_RX_BATCH_8_15,
+	BTSTRX_CTR_TRXD_RX_BATCH_16_PLUS,
+	BTSTRX_CTR_SCHED_UL_RACH_TS0,
+	BTSTRX_CTR_SCHED_UL_RACH_TS1,
+	BTSTRX_CTR_SCHED_UL_RACH_TS2,
+	BTSTRX_CTR_SCHED_UL_RACH_TS_FALLBACK,
+	BTSTRX_CTR_SCHED_UL_RACH_BAD,
+	BTSTRX_CTR_TRXD_RX_LOST,
+	BTSTRX_CTR_TRXD_RX_REORDERED,
+	BTSTRX_CTR_SCHED_UL_GATED_XCCH,
+	BTSTRX_CTR_SCHED_UL_GATED_TCHF,
+	BTSTRX_CTR_SCHED_UL_GATED_TCHH,
+	BTSTRX_CTR_SCHED_UL_GATED_PDTCH,
+	BTSTRX_CTR_SCHED_DL_ENC_CACHE_HIT,
+	BTSTRX_CTR_SCHED_DL_ENC_CACHE_MISS,
+	BTSTRX_CTR_SCHED_DL_ENC_AHEAD,
+	BTSTRX_CTR_SCHED_DL_ENC_CBCH,
+	BTSTRX_CTR_UL_DEC_BUSY_US,
+	BTSTRX_CTR_SCHED_UL_FACCH_SKIPPED,
+	BTSTRX_CTR_SCHED_UL_FACCH_MISPREDICT,
+	BTSTRX_CTR_SCHED_DL_FACCH_DELAY_0MS,
+	BTSTRX_CTR_SCHED_DL_FACCH_DELAY_25MS,
+	BTSTRX_CTR_SCHED_DL_FACCH_DELAY_50MS,
+	BTSTRX_CTR_SCHED_DL_FACCH_DELAY_100MS,
+	BTSTRX_CTR_SCHED_DL_FACCH_DELAY_MORE,
+	/* one per enum fn_budget_step, in the same order */
+	BTSTRX_CTR_FN_BUDGET_SHED_GSMTAP,
+	BTSTRX_CTR_FN_BUDGET_SHED_DEBUG_LOG,
+	BTSTRX_CTR_FN_BUDGET_SHED_INTERF_MEAS,
+	BTSTRX_CTR_FN_BUDGET_SHED_REP_ACCH,
+	BTSTRX_CTR_FN_BUDGET_SHED_STATS,
+	BTSTRX_CTR_SLACK_TASK_RUN,
+	BTSTRX_CTR_SLACK_TASK_LATE,
+};
+
+/* bts-trx specific stat items */
+enum {
+	BTSTRX_STAT_TRXD_TX_FLUSH_US,
+	BTSTRX_STAT_FN_TIMER_ERROR_US,
+	BTSTRX_STAT_FN_PROC_US,
+	BTSTRX_STAT_UL_DEC_INFLIGHT,
+	BTSTRX_STAT_UL_DEC_LATENCY_US,
+	BTSTRX_STAT_UL_DEC_BATCH_LEN,
+	BTSTRX_STAT_TRXD_RX_JITTER_US,
+	BTSTRX_STAT_CLK_DRIFT_PPB,
+	BTSTRX_STAT_CLK_JITTER_US,
+	BTSTRX_STAT_FN_BUDGET_LEVEL,
+};
+
+/*! number of buckets in a frame clock histogram */
+#define TRX_CLK_HIST_BUCKETS 16
+
+/*! log2 histogram of a time value in microseconds: bucket 0 counts values
+ *  below 1 us, bucket N counts values in [2^(N-1), 2^N) us, and the last
+ *  bucket counts everything exceeding the range of the others */
+struct trx_clk_hist {
+	uint32_t buckets[TRX_CLK_HIST_BUCKETS];
+	/*! total number of samples */
+	uint32_t count;
+	/*! largest sample seen */
+	uint32_t max_us;
 };
 
 /*! clock state of a given TRX */
@@ -52,14 +122,56 @@ struct osmo_trx_clock_state {
 	} last_clk_ind;
 	/*! Osmocom FD wrapper for timerfd */
 	struct osmo_fd fn_timer_ofd;
+	/*! absolute OS scheduling error of the FN period timer */
+	struct trx_clk_hist sched_err_hist;
+	/*! time spent processing one TDMA frame in bts_sched_fn() */
+	struct trx_clk_hist proc_time_hist;
+	/*! longest TDMA frame processing time since the last rts-advance check */
+	int64_t proc_us_max;
+	/*! frame clock estimator driving the FN timer, see 'osmotrx clock-filter' */
+	struct {
+		/*! has the drift estimate been initialized? */
+		bool valid;
+		/*! rate error of the local clock against the TRX clock (ppb) */
+		int64_t drift_ppb;
+		/*! jitter of the CLOCK indications against the estimate (1/16 us) */
+		int64_t jitter_us16;
+		/*! current FN timer interval (ns) */
+		int64_t interval_ns;
+	} est;
+};
+
+/*! number of entries in the cache of encoded xCCH blocks (power of 2) */
+#define TRX_XCCH_ENC_CACHE_SIZE 32
+
+/*! direct-mapped cache of encoded xCCH blocks, keyed on the L2 payload.
+ *  The content of BCCH, CCCH and SDCCH blocks repeats a lot (System
+ *  Information, empty Paging Requests, LAPDm fill frames), so most of
+ *  them need not go through the convolutional encoder again. */
+struct trx_xcch_enc_cache {
+	struct {
+		bool valid;
+		uint8_t l2[GSM_MACBLOCK_LEN];
+		ubit_t bursts[4 * GSM_NBITS_NB_GMSK_PAYLOAD];
+	} ent[TRX_XCCH_ENC_CACHE_SIZE];
 };
 
 /* gsm_bts->model_priv, specific to osmo-bts-trx */
 struct bts_trx_priv {
 	struct osmo_trx_clock_state clk_s;
+	struct trx_xcch_enc_cache xcch_enc_cache;
+	struct fn_budget fn_budget;		/* see 'fn-budget-watchdog' */
 	struct rate_ctr_group *ctrs;		/* bts-trx specific rate counters */
+	struct rate_ctr_shard_group *ctrs_shard; /* hot path updates of ctrs */
+	struct osmo_stat_item_group *stats;	/* bts-trx specific stat items */
 };
 
+struct trx_l1h;
+struct trx_dl_burst_req;
+
+typedef int trx_data_rx_fn(struct trx_l1h *l1h, uint8_t *buf, ssize_t buf_len);
+typedef int trx_data_tx_fn(struct trx_l1h *l1h, const struct trx_dl_burst_req *br);
+
 struct trx_config {
 	uint8_t			trxd_pdu_ver_req; /* requested TRXD PDU version */
 	uint8_t			trxd_pdu_ver_use; /* actual TRXD PDU version in use */
@@ -114,10 +226,14 @@ struct trx_config {
 		bool tsc_valid;
 	}			setslot[TRX_NR_TS];
 	bool			setslot_sent[TRX_NR_TS];
+
+	struct timespec		prov_start;	/* TRX_PROV_EV_OPEN, for the provisioning timeline */
 };
 
 struct trx_l1h {
 	struct llist_head	trx_ctrl_list;
+	/* Number of commands at the head of trx_ctrl_list awaiting a response */
+	unsigned int		trx_ctrl_inflight;
 	/* Latest RSPed cmd, used to catch duplicate RSPs from sent retransmissions */
 	struct trx_ctrl_msg 	*last_acked;
 
@@ -128,6 +244,41 @@ struct trx_l1h {
 	struct osmo_timer_list	trx_ctrl_timer;
 	struct osmo_fd		trx_ofd_data;
 
+	/* TRXD handlers for config.trxd_pdu_ver_use, see trx_if_set_pdu_ver() */
+	trx_data_rx_fn		*trxd_rx_fn;
+	trx_data_tx_fn		*trxd_tx_fn;
+
+	/* TRXD Rx buffers, allocated on open; see 'osmotrx trxd-rx-batch' */
+	struct {
+		unsigned int	depth;	/* number of allocated message slots */
+		struct mmsghdr	*msgs;
+		struct iovec	*iovs;
+		uint8_t		*bufs;	/* depth * TRXD_MSG_BUF_SIZE */
+		/* TRXDv4: soft-bits of the burst being indicated */
+		sbit_t		burst[EGPRS_BURST_LEN];
+	} trxd_rx_batch;
+
+	/* TRXD Rx sequence numbers and jitter, see 'osmotrx trxd-seqnum' */
+	struct {
+		bool		valid;		/* has a datagram been received yet? */
+		uint16_t	seq_next;	/* next expected sequence number */
+		uint32_t	fn_last;	/* TDMA frame number of the last datagram */
+		struct timespec	last;		/* arrival time of the last datagram */
+		uint32_t	jitter_us16;	/* inter-arrival jitter (1/16 us) */
+		uint32_t	num;		/* datagrams received */
+		uint32_t	lost;		/* datagrams missing in the sequence */
+		uint32_t	reordered;	/* datagrams received out of order */
+	} trxd_rx_seq;
+
+	/* TRXD Tx batching state, see trx_if_send_burst() */
+	struct {
+		uint8_t		buf[TRXD_MSG_BUF_SIZE];
+		uint8_t		*pos;		/* where the next PDU is encoded */
+		uint8_t		*last_pdu;	/* last encoded PDU (for BATCH.ind) */
+		unsigned int	pdu_num;	/* number of PDUs in the buffer */
+		uint16_t	seq;		/* next sequence number to send */
+	} trxd_tx;
+
 	/* transceiver config */
 	struct trx_config	config;
 	struct osmo_fsm_inst	*provision_fi;
@@ -78,6 +78,146 @@ static const struct rate_ctr_desc btstrx_ctr_desc[] = {
 		"trx_sched:ul_fh_no_carrier",
 		"Frequency hopping: no carrier found for an Uplink burst (check hopping parameters)"
 	},
+	[BTSTRX_CTR_TRXD_RX_BATCH_1] = {
+		"trx_if:trxd_rx_batch_1",
+		"TRXD batched receive: recvmmsg() calls returning 1 datagram"
+	},
+	[BTSTRX_CTR_TRXD_RX_BATCH_2_3] = {
+		"trx_if:trxd_rx_batch_2_3",
+		"TRXD batched receive: recvmmsg() calls returning 2..3 datagrams"
+	},
+	[BTSTRX_CTR_TRXD_RX_BATCH_4_7] = {
+		"trx_if:trxd_rx_batch_4_7",
+		"TRXD batched receive: recvmmsg() calls returning 4..7 datagrams"
+	},
+	[BTSTRX_CTR_TRXD_RX_BATCH_8_15] = {
+		"trx_if:trxd_rx_batch_8_15",
+		"TRXD batched receive: recvmmsg() calls returning 8..15 datagrams"
+	},
+	[BTSTRX_CTR_TRXD_RX_BATCH_16_PLUS] = {
+		"trx_if:trxd_rx_batch_16_plus",
+		"TRXD batched receive: recvmmsg() calls returning 16 or more datagrams"
+	},
+	[BTSTRX_CTR_SCHED_UL_RACH_TS0] = {
+		"trx_sched:ul_rach_ts0",
+		"Access Bursts decoded as 8-bit RACH (synch. sequence TS0)"
+	},
+	[BTSTRX_CTR_SCHED_UL_RACH_TS1] = {
+		"trx_sched:ul_rach_ts1",
+		"Access Bursts decoded as 11-bit RACH (synch. sequence TS1, 8-PSK)"
+	},
+	[BTSTRX_CTR_SCHED_UL_RACH_TS2] = {
+		"trx_sched:ul_rach_ts2",
+		"Access Bursts decoded as 11-bit RACH (synch. sequence TS2, GMSK)"
+	},
+	[BTSTRX_CTR_SCHED_UL_RACH_TS_FALLBACK] = {
+		"trx_sched:ul_rach_ts_fallback",
+		"Access Bursts with unknown synch. sequence, decoded as TS0"
+	},
+	[BTSTRX_CTR_SCHED_UL_RACH_BAD] = {
+		"trx_sched:ul_rach_bad",
+		"Access Bursts which failed to decode"
+	},
+	[BTSTRX_CTR_TRXD_RX_LOST] = {
+		"trx_if:trxd_rx_lost",
+		"TRXD datagrams missing in the sequence (see 'osmotrx trxd-seqnum')"
+	},
+	[BTSTRX_CTR_TRXD_RX_REORDERED] = {
+		"trx_if:trxd_rx_reordered",
+		"TRXD datagrams received out of order (see 'osmotrx trxd-seqnum')"
+	},
+	[BTSTRX_CTR_SCHED_UL_GATED_XCCH] = {
+		"trx_sched:ul_gated_xcch",
+		"xCCH blocks declared bad without decoding (see 'osmotrx ul-decode-gate')"
+	},
+	[BTSTRX_CTR_SCHED_UL_GATED_TCHF] = {
+		"trx_sched:ul_gated_tchf",
+		"TCH/F blocks declared bad without decoding (see 'osmotrx ul-decode-gate')"
+	},
+	[BTSTRX_CTR_SCHED_UL_GATED_TCHH] = {
+		"trx_sched:ul_gated_tchh",
+		"TCH/H blocks declared bad without decoding (see 'osmotrx ul-decode-gate')"
+	},
+	[BTSTRX_CTR_SCHED_UL_GATED_PDTCH] = {
+		"trx_sched:ul_gated_pdtch",
+		"PDTCH blocks declared bad without decoding (see 'osmotrx ul-decode-gate')"
+	},
+	[BTSTRX_CTR_SCHED_DL_ENC_CACHE_HIT] = {
+		"trx_sched:dl_enc_cache_hit",
+		"BCCH/CCCH/SDCCH blocks taken from the cache of encoded blocks"
+	},
+	[BTSTRX_CTR_SCHED_DL_ENC_CACHE_MISS] = {
+		"trx_sched:dl_enc_cache_miss",
+		"BCCH/CCCH/SDCCH blocks not found in the cache of encoded blocks"
+	},
+	[BTSTRX_CTR_SCHED_DL_ENC_AHEAD] = {
+		"trx_sched:dl_enc_ahead",
+		"xCCH blocks encoded in the slack of a preceding frame (see 'osmotrx dl-encode-ahead')"
+	},
+	[BTSTRX_CTR_SCHED_DL_ENC_CBCH] = {
+		"trx_sched:dl_enc_cbch",
+		"CBCH blocks sent as encoded when the SMSCB message was accepted"
+	},
+	[BTSTRX_CTR_UL_DEC_BUSY_US] = {
+		"trx_sched:ul_dec_busy_us",
+		"Time spent by the Uplink decoder threads decoding PDTCH blocks (microseconds)"
+	},
+	[BTSTRX_CTR_SCHED_UL_FACCH_SKIPPED] = {
+		"trx_sched:ul_facch_skipped",
+		"CSD blocks not decoded as FACCH, the stealing flags indicating data (see 'osmotrx ul-facch-steal-threshold')"
+	},
+	[BTSTRX_CTR_SCHED_UL_FACCH_MISPREDICT] = {
+		"trx_sched:ul_facch_mispredict",
+		"TCH blocks whose decoding result contradicts the stealing flags (see 'osmotrx ul-facch-steal-threshold')"
+	},
+	[BTSTRX_CTR_SCHED_DL_FACCH_DELAY_0MS] = {
+		"trx_sched:dl_facch_delay_0ms",
+		"Downlink FACCH blocks sent in the block they were requested for"
+	},
+	[BTSTRX_CTR_SCHED_DL_FACCH_DELAY_25MS] = {
+		"trx_sched:dl_facch_delay_25ms",
+		"Downlink FACCH blocks kept back for up to 25 ms (see 'osmotrx dl-facch-max-delay')"
+	},
+	[BTSTRX_CTR_SCHED_DL_FACCH_DELAY_50MS] = {
+		"trx_sched:dl_facch_delay_50ms",
+		"Downlink FACCH blocks kept back for 25 to 50 ms (see 'osmotrx dl-facch-max-delay')"
+	},
+	[BTSTRX_CTR_SCHED_DL_FACCH_DELAY_100MS] = {
+		"trx_sched:dl_facch_delay_100ms",
+		"Downlink FACCH blocks kept back for 50 to 100 ms (see 'osmotrx dl-facch-max-delay')"
+	},
+	[BTSTRX_CTR_SCHED_DL_FACCH_DELAY_MORE] = {
+		"trx_sched:dl_facch_delay_more",
+		"Downlink FACCH blocks kept back for more than 100 ms (see 'osmotrx dl-facch-max-delay')"
+	},
+	[BTSTRX_CTR_FN_BUDGET_SHED_GSMTAP] = {
+		"trx_sched:fn_budget_shed_gsmtap",
+		"TDMA frame budget exceeded: GSMTAP Um logging suspended (see 'fn-budget-watchdog')"
+	},
+	[BTSTRX_CTR_FN_BUDGET_SHED_DEBUG_LOG] = {
+		"trx_sched:fn_budget_shed_debug_log",
+		"TDMA frame budget exceeded: DEBUG and INFO logging suspended (see 'fn-budget-watchdog')"
+	},
+	[BTSTRX_CTR_FN_BUDGET_SHED_INTERF_MEAS] = {
+		"trx_sched:fn_budget_shed_interf_meas",
+		"TDMA frame budget exceeded: interference reporting halved (see 'fn-budget-watchdog')"
+	},
+	[BTSTRX_CTR_FN_BUDGET_SHED_REP_ACCH] = {
+		"trx_sched:fn_budget_shed_rep_acch",
+		"TDMA frame budget exceeded: combining of repeated UL SACCH suspended (see 'fn-budget-watchdog')"
+	},
+	[BTSTRX_CTR_FN_BUDGET_SHED_STATS] = {
+		"trx_sched:fn_budget_shed_stats",
+		"TDMA frame budget exceeded: stats refreshed less often (see 'fn-budget-watchdog')"
+	},
+	[BTSTRX_CTR_SLACK_TASK_RUN] = {
+		"trx_sched:slack_task_run",
+		"Low priority tasks run in the slack of a TDMA frame"
+	},
+	[BTSTRX_CTR_SLACK_TASK_LATE] = {
+		"trx_sched:slack_task_late",
+		"Low priority tasks run without slack, after waiting for too long"
+	},
 };
 static const struct rate_ctr_group_desc btstrx_ctrg_desc = {
 	"bts-trx",
@@ -87,6 +227,66 @@ static const struct rate_ctr_group_desc btstrx_ctrg_desc = {
 	btstrx_ctr_desc
 };
 
+static const struct osmo_stat_item_desc btstrx_stat_desc[] = {
+	[BTSTRX_STAT_TRXD_TX_FLUSH_US] = {
+		"trx_if:trxd_tx_flush_us",
+		"Time spent sending the Downlink TRXD datagrams of all TRX for one TDMA frame",
+		"us", 16, 0
+	},
+	[BTSTRX_STAT_FN_TIMER_ERROR_US] = {
+		"sched:fn_timer_error_us",
+		"OS scheduling error of the TDMA frame period timer",
+		"us", 16, 0
+	},
+	[BTSTRX_STAT_FN_PROC_US] = {
+		"sched:fn_proc_us",
+		"Time spent scheduling one TDMA frame, from RTS until the TRXD datagrams are sent",
+		"us", 16, 0
+	},
+	[BTSTRX_STAT_UL_DEC_INFLIGHT] = {
+		"ul_decoder:inflight",
+		"Uplink blocks submitted to the decoder threads and not yet delivered",
+		"blocks", 16, 0
+	},
+	[BTSTRX_STAT_UL_DEC_LATENCY_US] = {
+		"ul_decoder:latency_us",
+		"Time from submitting an Uplink block to the decoder threads until its delivery",
+		"us", 16, 0
+	},
+	[BTSTRX_STAT_UL_DEC_BATCH_LEN] = {
+		"ul_decoder:batch_len",
+		"Uplink blocks of all TRX handed over to the decoder threads at once (per block period)",
+		"blocks", 16, 0
+	},
+	[BTSTRX_STAT_TRXD_RX_JITTER_US] = {
+		"trx_if:trxd_rx_jitter_us",
+		"Inter-arrival jitter of the Uplink TRXD datagrams (see 'osmotrx trxd-seqnum')",
+		"us", 16, 0
+	},
+	[BTSTRX_STAT_CLK_DRIFT_PPB] = {
+		"trx_clk:drift_ppb",
+		"Estimated rate error of the local clock against the TRX clock (see 'osmotrx clock-filter')",
+		"ppb", 16, 0
+	},
+	[BTSTRX_STAT_CLK_JITTER_US] = {
+		"trx_clk:jitter_us",
+		"Estimated jitter of the TRX clock indications (see 'osmotrx clock-filter')",
+		"us", 16, 0
+	},
+	[BTSTRX_STAT_FN_BUDGET_LEVEL] = {
+		"trx_sched:fn_budget_level",
+		"Number of optional work steps shed due to the TDMA frame budget (see 'fn-budget-watchdog')",
+		"steps", 16, 0
+	},
+};
+static const struct osmo_stat_item_group_desc btstrx_statg_desc = {
+	"bts-trx",
+	"osmo-bts-trx specific statistics",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(btstrx_stat_desc),
+	btstrx_stat_desc
+};
+
 /* dummy, since no direct dsp support */
 uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx)
 {
@@ -127,7 +327,11 @@ int bts_model_init(struct gsm_bts *bts)
 {
 	struct bts_trx_priv *bts_trx = talloc_zero(bts, struct bts_trx_priv);
 	bts_trx->clk_s.fn_timer_ofd.fd = -1;
+	fn_budget_init(&bts_trx->fn_budget);
 	bts_trx->ctrs = rate_ctr_group_alloc(bts_trx, &btstrx_ctrg_desc, 0);
+	bts_trx->ctrs_shard = rate_ctr_shard_group_alloc(bts_trx, bts_trx->ctrs);
+	OSMO_ASSERT(bts_trx->ctrs_shard != NULL);
+	bts_trx->stats = osmo_stat_item_group_alloc(bts_trx, &btstrx_statg_desc, 0);
 
 	bts->model_priv = bts_trx;
 	bts->variant = BTS_OSMO_TRX;
@@ -190,6 +394,13 @@ void bts_model_phy_link_set_defaults(struct phy_link *plink)
 	plink->u.osmotrx.rts_advance = 3;
 	/* attempt use newest TRXD version by default: */
 	plink->u.osmotrx.trxd_pdu_ver_max = TRX_DATA_PDU_VER;
+	/* one recv() per wakeup, unless configured otherwise */
+	plink->u.osmotrx.trxd_rx_batch = 1;
+	/* wait for each TRXC response before sending the next command */
+	plink->u.osmotrx.trxc_window = 1;
+	/* leave the placement to the kernel (and the 'cpu-sched' node) */
+	plink->u.osmotrx.placement.mem_node = -1;
+	plink->u.osmotrx.placement.trxd_incoming_cpu = -1;
 }
 
 void bts_model_phy_instance_set_defaults(struct phy_instance *pinst)
@@ -21,6 +21,8 @@
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <errno.h>
 
 #include <osmocom/core/bits.h>
@@ -47,36 +49,86 @@ int tx_fcch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 	return 0;
 }
 
+/* The SCH coding (CRC-10 followed by a convolutional code) is affine over
+ * GF(2), so the coded SB info of (BSIC, T1, T2, T3') equals the XOR of
+ * enc(BSIC, 0, T2, T3'), enc(0, T1, 0, 0) and enc(0, 0, 0, 0).  Within a
+ * hyperframe no SCH burst is transmitted twice, but there are only 26 * 5
+ * different (T2, T3') pairs, and T1 changes only every 26 * 51 frames.
+ * Both parts are cached, so that transmitting an SCH burst is a XOR. */
+#define SCH_CODED_LEN 78
+
+static struct {
+	uint8_t bsic;		/* BSIC the t2t3p[] entries were encoded for */
+	bool t2t3p_valid[26][5];
+	ubit_t t2t3p[26][5][SCH_CODED_LEN];
+	bool t1_valid;
+	uint16_t t1;		/* T1 the t1_part was encoded for */
+	ubit_t t1_part[SCH_CODED_LEN];
+} sch_cache;
+
+static void sch_encode(ubit_t *coded, uint8_t bsic, uint16_t t1, uint8_t t2, uint8_t t3p)
+{
+	uint8_t sb_info[4];
+
+	/* create SB info from GSM time and BSIC */
+	sb_info[0] =
+		((bsic &  0x3f) << 2) |
+		((t1   & 0x600) >> 9);
+	sb_info[1] =
+		((t1   & 0x1fe) >> 1);
+	sb_info[2] =
+		((t1   & 0x001) << 7) |
+		((t2   &  0x1f) << 2) |
+		((t3p  &   0x6) >> 1);
+	sb_info[3] =
+		 (t3p  &   0x1);
+
+	gsm0503_sch_encode(coded, sb_info);
+}
+
 /* obtain a to-be-transmitted SCH (synchronization channel) burst */
 int tx_sch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 {
-	ubit_t burst[78];
-	uint8_t sb_info[4];
+	ubit_t burst[SCH_CODED_LEN];
+	const ubit_t *part;
 	struct	gsm_time t;
 	uint8_t t3p, bsic;
+	unsigned int i;
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "Transmitting SCH\n");
 
 	/* BURST BYPASS */
 
-	/* create SB info from GSM time and BSIC */
 	gsm_fn2gsmtime(&t, br->fn);
 	t3p = t.t3 / 10;
 	bsic = l1ts->ts->trx->bts->bsic;
-	sb_info[0] =
-		((bsic &  0x3f) << 2) |
-		((t.t1 & 0x600) >> 9);
-	sb_info[1] =
-		((t.t1 & 0x1fe) >> 1);
-	sb_info[2] =
-		((t.t1 & 0x001) << 7) |
-		((t.t2 &  0x1f) << 2) |
-		((t3p  &   0x6) >> 1);
-	sb_info[3] =
-		 (t3p  &   0x1);
 
-	/* encode bursts */
-	gsm0503_sch_encode(burst, sb_info);
+	/* BSIC and T2/T3' dependent part, invalidated on BSIC change */
+	if (OSMO_UNLIKELY(sch_cache.bsic != bsic)) {
+		memset(sch_cache.t2t3p_valid, 0, sizeof(sch_cache.t2t3p_valid));
+		sch_cache.bsic = bsic;
+	}
+	if (OSMO_UNLIKELY(!sch_cache.t2t3p_valid[t.t2][t3p])) {
+		sch_encode(sch_cache.t2t3p[t.t2][t3p], bsic, 0, t.t2, t3p);
+		sch_cache.t2t3p_valid[t.t2][t3p] = true;
+	}
+
+	/* T1 dependent part, without the constant term */
+	if (OSMO_UNLIKELY(!sch_cache.t1_valid || sch_cache.t1 != t.t1)) {
+		ubit_t zero[SCH_CODED_LEN];
+
+		sch_encode(sch_cache.t1_part, 0, t.t1, 0, 0);
+		sch_encode(zero, 0, 0, 0, 0);
+		for (i = 0; i < SCH_CODED_LEN; i++)
+			sch_cache.t1_part[i] ^= zero[i];
+		sch_cache.t1 = t.t1;
+		sch_cache.t1_valid = true;
+	}
+
+	/* combine both parts */
+	part = sch_cache.t2t3p[t.t2][t3p];
+	for (i = 0; i < SCH_CODED_LEN; i++)
+		burst[i] = part[i] ^ sch_cache.t1_part[i];
 
 	/* compose burst */
 	memcpy(br->burst + 3, burst, 39);
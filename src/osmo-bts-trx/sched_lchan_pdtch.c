@@ -35,8 +35,7 @@
 
 #include <sched_utils.h>
 
-/* Maximum size of a EGPRS message in bytes */
-#define EGPRS_0503_MAX_BYTES	155
+#include "ul_decoder.h"
 
 /*! \brief a single PDTCH burst was received by the PHY, process it */
 int rx_pdtch_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
@@ -46,7 +45,8 @@ int rx_pdtch_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	uint32_t first_fn;
 	uint32_t *mask = &chan_state->ul_mask;
 	struct l1sched_meas_set meas_avg;
-	uint8_t l2[EGPRS_0503_MAX_BYTES];
+	uint8_t l2_buf[EGPRS_0503_MAX_BYTES], *l2 = &l2_buf[0];
+	struct msgb *msg = NULL;
 	int n_errors = 0;
 	int n_bursts_bits = 0;
 	int n_bits_total = 0;
@@ -105,20 +105,39 @@ int rx_pdtch_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	}
 	*mask = 0x0;
 
+	if (trx_sched_ul_gated(l1ts, bi, bursts_p, n_bursts_bits, SCHED_MEAS_AVG_M_S4N4)) {
+		rc = 0;
+		goto gated;
+	}
+
+	/* let the worker threads decode the block, if configured */
+	if (trx_ul_decoder_enabled(l1ts)) {
+		return trx_ul_decoder_submit_pdtch(l1ts, bi, bursts_p, n_bursts_bits,
+						   &meas_avg);
+	}
+
+	/* decode right into the DATA.ind towards the PCU, if possible */
+	msg = _sched_pdtch_ind_alloc(l1ts, bi->chan, &l2);
+
 	/*
 	 * Attempt to decode EGPRS bursts first. For 8-PSK EGPRS this is all we
 	 * do. Attempt GPRS decoding on EGPRS failure. If the burst is GPRS,
 	 * then we incur decoding overhead of 31 bits on the Type 3 EGPRS
 	 * header, which is tolerable.
 	 */
+	TRACE_UL_DECODE_START(l1ts, bi);
 	rc = gsm0503_pdtch_egprs_decode(l2, bursts_p, n_bursts_bits,
 				NULL, &n_errors, &n_bits_total);
+	TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 
 	if ((bi->burst_len == GSM_BURST_LEN) && (rc < 0)) {
+		TRACE_UL_DECODE_START(l1ts, bi);
 		rc = gsm0503_pdtch_decode(l2, bursts_p, NULL,
 				  &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 	}
 
+gated:
 	if (rc > 0) {
 		presence_info = PRES_INFO_BOTH;
 	} else {
@@ -131,6 +150,14 @@ int rx_pdtch_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	ber10k = compute_ber10k(n_bits_total, n_errors);
 
 	first_fn = GSM_TDMA_FN_SUB(bi->fn, 3);
+	if (msg != NULL) {
+		return _sched_compose_pdtch_ind(l1ts, msg, first_fn, bi->chan, rc,
+						ber10k,
+						meas_avg.rssi,
+						meas_avg.toa256,
+						meas_avg.ci_cb,
+						presence_info);
+	}
 	return _sched_compose_ph_data_ind(l1ts, first_fn, bi->chan,
 					  &l2[0], rc,
 					  ber10k,
@@ -37,6 +37,8 @@
 
 #include <sched_utils.h>
 
+#include "l1_if.h"
+
 /* 3GPP TS 05.02, section 5.2.7 */
 #define RACH_EXT_TAIL_LEN	8
 #define RACH_SYNCH_SEQ_LEN	41
@@ -105,6 +107,7 @@ static enum rach_synch_seq_t rach_get_synch_seq(sbit_t *bits, int *best_score)
 int rx_rach_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 {
 	struct gsm_bts_trx *trx = l1ts->ts->trx;
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) trx->bts->model_priv;
 	struct osmo_phsap_prim l1sap;
 	int n_errors = 0;
 	int n_bits_total = 0;
@@ -164,21 +167,28 @@ int rx_rach_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	else
 		l1sap.u.rach_ind.lqual_cb = trx->bts->min_qual_rach;
 
-	/* Decode RACH depending on its synch. sequence */
+	/* Decode RACH depending on its synch. sequence.  The format is decided
+	 * upfront, so only one of the (8-bit or 11-bit) decoders is run. */
 	switch (synch_seq) {
 	case RACH_SYNCH_SEQ_TS1:
 	case RACH_SYNCH_SEQ_TS2:
+		TRACE_UL_DECODE_START(l1ts, bi);
 		rc = gsm0503_rach_ext_decode_ber(&ra11, bi->burst + RACH_EXT_TAIL_LEN + RACH_SYNCH_SEQ_LEN,
 						 trx->bts->bsic, &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		if (rc) {
 			LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Received bad Access Burst\n");
+			rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_RACH_BAD);
 			return 0;
 		}
 
-		if (synch_seq == RACH_SYNCH_SEQ_TS1)
+		if (synch_seq == RACH_SYNCH_SEQ_TS1) {
 			l1sap.u.rach_ind.burst_type = GSM_L1_BURST_TYPE_ACCESS_1;
-		else
+			rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_RACH_TS1);
+		} else {
 			l1sap.u.rach_ind.burst_type = GSM_L1_BURST_TYPE_ACCESS_2;
+			rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_RACH_TS2);
+		}
 
 		l1sap.u.rach_ind.is_11bit = 1;
 		l1sap.u.rach_ind.ra = ra11;
@@ -189,17 +199,22 @@ int rx_rach_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		/* Fall-back to the default TS0 if needed */
 		if (synch_seq != RACH_SYNCH_SEQ_TS0) {
 			LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Falling-back to the default TS0\n");
+			rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_RACH_TS_FALLBACK);
 			synch_seq = RACH_SYNCH_SEQ_TS0;
 		}
 
+		TRACE_UL_DECODE_START(l1ts, bi);
 		rc = gsm0503_rach_decode_ber(&ra, bi->burst + RACH_EXT_TAIL_LEN + RACH_SYNCH_SEQ_LEN,
 					     trx->bts->bsic, &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		if (rc) {
 			LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Received bad Access Burst\n");
+			rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_RACH_BAD);
 			return 0;
 		}
 
 		l1sap.u.rach_ind.burst_type = GSM_L1_BURST_TYPE_ACCESS_0;
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_RACH_TS0);
 		l1sap.u.rach_ind.is_11bit = 0;
 		l1sap.u.rach_ind.ra = ra;
 		break;
@@ -46,6 +46,8 @@
 #include <sched_utils.h>
 #include <amr_loop.h>
 
+#include "l1_if.h"
+
 /* 3GPP TS 45.009, table 3.2.1.3-{1,3}: AMR on Uplink TCH/F.
  *
  * +---+---+---+---+---+---+---+---+
@@ -69,18 +71,61 @@ static const uint8_t sched_tchf_dl_amr_cmi_map[26] = {
 
 extern const uint8_t sched_tchh_dl_amr_cmi_map[26];
 
+static const uint8_t tchf_dl_dummy_facch[GSM_MACBLOCK_LEN] = {
+	0x03, 0x03, 0x01, /* TODO: use randomized padding */
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+};
+
+/* Pre-encoded dummy blocks, sent whenever there is nothing to transmit.
+ * They do not depend on the channel, so they are encoded once on first use. */
+static struct tch_dl_pattern tchf_dl_bfi; /* speech block with inverted CRC3 */
+static struct tch_dl_pattern tchf_dl_facch; /* dummy L2 frame on FACCH/F */
+
+static void tchf_dl_patterns_init(void)
+{
+	ubit_t zeros[8 * BPLEN], ones[8 * BPLEN];
+	int rc;
+
+	if (OSMO_LIKELY(tchf_dl_bfi.valid))
+		return;
+
+	memset(zeros, 0, sizeof(zeros));
+	memset(ones, 1, sizeof(ones));
+	rc = gsm0503_tch_fr_encode(zeros, NULL, 0, 1);
+	gsm0503_tch_fr_encode(ones, NULL, 0, 1);
+	tch_dl_pattern_set(&tchf_dl_bfi, rc, zeros, ones);
+
+	memset(zeros, 0, sizeof(zeros));
+	memset(ones, 1, sizeof(ones));
+	rc = gsm0503_tch_fr_encode(zeros, tchf_dl_dummy_facch, sizeof(tchf_dl_dummy_facch), 1);
+	gsm0503_tch_fr_encode(ones, tchf_dl_dummy_facch, sizeof(tchf_dl_dummy_facch), 1);
+	tch_dl_pattern_set(&tchf_dl_facch, rc, zeros, ones);
+}
+
 static int decode_fr_facch(struct l1sched_ts *l1ts,
 			   const struct trx_ul_burst_ind *bi)
 {
 	struct l1sched_chan_state *chan_state = &l1ts->chan_state[bi->chan];
 	const sbit_t *bursts_p = chan_state->ul_bursts;
+	const uint8_t base = chan_state->ul_bursts_base;
 	struct l1sched_meas_set meas_avg;
 	uint8_t data[GSM_MACBLOCK_LEN];
 	int n_errors, n_bits_total;
-	int rc;
+	int pred, rc;
+
+	/* CSD bursts carry no stealing flags unless FACCH/F took them */
+	pred = trx_sched_ul_facch_pred(l1ts, BUFRTAIL8(bursts_p, base), false);
+	if (pred < 0) {
+		trx_sched_ul_facch_skipped(l1ts, bi);
+		return 0;
+	}
 
-	rc = gsm0503_tch_fr_facch_decode(&data[0], BUFTAIL8(bursts_p),
+	TRACE_UL_DECODE_START(l1ts, bi);
+	rc = gsm0503_tch_fr_facch_decode(&data[0], BUFRTAIL8(bursts_p, base),
 					 &n_errors, &n_bits_total);
+	TRACE_UL_DECODE_DONE(l1ts, bi, rc);
+	trx_sched_ul_facch_result(l1ts, bi, pred, rc == GSM_MACBLOCK_LEN);
 	if (rc != GSM_MACBLOCK_LEN)
 		return rc;
 
@@ -103,14 +148,16 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 {
 	struct l1sched_chan_state *chan_state = &l1ts->chan_state[bi->chan];
 	struct gsm_lchan *lchan = chan_state->lchan;
-	sbit_t *burst, *bursts_p = chan_state->ul_bursts;
+	sbit_t *bursts_p = chan_state->ul_bursts;
 	uint32_t *mask = &chan_state->ul_mask;
+	uint8_t base;
 	uint8_t rsl_cmode = chan_state->rsl_cmode;
 	uint8_t tch_mode = chan_state->tch_mode;
 	uint8_t tch_data[290]; /* large enough to hold 290 unpacked bits for CSD */
 	enum sched_meas_avg_mode meas_avg_mode = SCHED_MEAS_AVG_M_S8N8;
 	struct l1sched_meas_set meas_avg;
 	int rc, amr = 0;
+	int facch_pred = 0;
 	int n_errors = 0;
 	int n_bits_total = 0;
 	unsigned int fn_begin;
@@ -126,12 +173,12 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Received TCH/F, bid=%u\n", bi->bid);
 
-	/* shift the buffer by 4 bursts leftwards */
+	/* advance the ring by 4 bursts */
 	if (bi->bid == 0) {
-		memmove(BUFPOS(bursts_p, 0), BUFPOS(bursts_p, 4), 20 * BPLEN);
-		memset(BUFPOS(bursts_p, 20), 0, 4 * BPLEN);
+		bufr_advance(&chan_state->ul_bursts_base, 4);
 		*mask = *mask << 4;
 	}
+	base = chan_state->ul_bursts_base;
 
 	/* update mask */
 	*mask |= (1 << bi->bid);
@@ -139,12 +186,9 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	/* store measurements */
 	trx_sched_meas_push(chan_state, bi);
 
-	/* copy burst to end of buffer of 24 bursts */
-	burst = BUFPOS(bursts_p, 20 + bi->bid);
-	if (bi->burst_len > 0) {
-		memcpy(burst, bi->burst + 3, 58);
-		memcpy(burst + 58, bi->burst + 87, 58);
-	}
+	/* copy burst to end of the ring of 24 bursts */
+	bufr_store(bursts_p, base, 20 + bi->bid,
+		   bi->burst_len > 0 ? bi->burst : NULL);
 
 	/* wait until complete set of bursts */
 	if (bi->bid != 3)
@@ -158,20 +202,43 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		return 0; /* TODO: send BFI */
 	}
 
+	/* zero bursts which were not received at all (not even a NOPE.ind) */
+	bufr_clear_missing(bursts_p, base, *mask, 4, BUFMAX);
+
+	/* CSD frames are interleaved over more than the 8 bursts checked here */
+	switch (tch_mode) {
+	case GSM48_CMODE_SIGN:
+	case GSM48_CMODE_SPEECH_V1:
+	case GSM48_CMODE_SPEECH_EFR:
+	case GSM48_CMODE_SPEECH_AMR:
+		if (trx_sched_ul_gated(l1ts, bi, BUFRTAIL8(bursts_p, base),
+				       8 * BPLEN, meas_avg_mode)) {
+			rc = 0;
+			goto gated;
+		}
+		/* the decoder itself tries FACCH/F first if the block looks stolen */
+		facch_pred = trx_sched_ul_facch_pred(l1ts, BUFRTAIL8(bursts_p, base), false);
+		break;
+	}
+
 	/* TCH/F: speech and signalling frames are interleaved over 8 bursts, while
 	 * CSD frames are interleaved over 22 bursts.  Unless we're in CSD mode,
 	 * decode only the last 8 bursts to avoid introducing additional delays. */
 	switch (tch_mode) {
 	case GSM48_CMODE_SIGN:
 	case GSM48_CMODE_SPEECH_V1: /* FR */
-		rc = gsm0503_tch_fr_decode(tch_data, BUFTAIL8(bursts_p),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_fr_decode(tch_data, BUFRTAIL8(bursts_p, base),
 					   1, 0, &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		if (rc == GSM_FR_BYTES) /* only for valid *speech* frames */
 			lchan_set_marker(osmo_fr_is_any_sid(tch_data), lchan); /* DTXu */
 		break;
 	case GSM48_CMODE_SPEECH_EFR: /* EFR */
-		rc = gsm0503_tch_fr_decode(tch_data, BUFTAIL8(bursts_p),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_fr_decode(tch_data, BUFRTAIL8(bursts_p, base),
 					   1, 1, &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		if (rc == GSM_EFR_BYTES) /* only for valid *speech* frames */
 			lchan_set_marker(osmo_efr_is_any_sid(tch_data), lchan); /* DTXu */
 		break;
@@ -197,9 +264,11 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		 * we receive an FACCH frame instead of a voice frame (we
 		 * do not know this before we actually decode the frame) */
 		amr = sizeof(struct amr_hdr);
-		rc = gsm0503_tch_afs_decode_dtx(tch_data + amr, BUFTAIL8(bursts_p),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_afs_decode_dtx(tch_data + amr, BUFRTAIL8(bursts_p, base),
 			amr_is_cmr, chan_state->codec, chan_state->codecs, &chan_state->ul_ft,
 			&chan_state->ul_cmr, &n_errors, &n_bits_total, &chan_state->amr_last_dtx);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 
 		/* Tag all frames that are not regular AMR voice frames as
 		 * SUB-Frames */
@@ -254,16 +323,20 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	case GSM48_CMODE_DATA_12k0:
 		/* FACCH/F does not steal TCH/F9.6 frames, but only disturbs some bits */
 		decode_fr_facch(l1ts, bi);
-		rc = gsm0503_tch_fr96_decode(&tch_data[0], BUFPOS(bursts_p, 0),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_fr96_decode(&tch_data[0], BUFRPOS(bursts_p, base, 0),
 					     &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		meas_avg_mode = SCHED_MEAS_AVG_M_S24N22;
 		break;
 	/* CSD (TCH/F4.8): 6.0 kbit/s radio interface rate */
 	case GSM48_CMODE_DATA_6k0:
 		/* FACCH/F does not steal TCH/F4.8 frames, but only disturbs some bits */
 		decode_fr_facch(l1ts, bi);
-		rc = gsm0503_tch_fr48_decode(&tch_data[0], BUFPOS(bursts_p, 0),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_fr48_decode(&tch_data[0], BUFRPOS(bursts_p, base, 0),
 					     &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		meas_avg_mode = SCHED_MEAS_AVG_M_S24N22;
 		break;
 	/* CSD (TCH/F2.4): 3.6 kbit/s radio interface rate */
@@ -272,16 +345,20 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		 * so FACCH/F *does* steal TCH/F2.4 frames completely. */
 		if (decode_fr_facch(l1ts, bi) == GSM_MACBLOCK_LEN)
 			return 0; /* TODO: emit BFI */
-		rc = gsm0503_tch_fr24_decode(&tch_data[0], BUFTAIL8(bursts_p),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_fr24_decode(&tch_data[0], BUFRTAIL8(bursts_p, base),
 					     &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		meas_avg_mode = SCHED_MEAS_AVG_M_S8N8;
 		break;
 	/* CSD (TCH/F14.4): 14.5 kbit/s radio interface rate */
 	case GSM48_CMODE_DATA_14k5:
 		/* FACCH/F does not steal TCH/F14.4 frames, but only disturbs some bits */
 		decode_fr_facch(l1ts, bi);
-		rc = gsm0503_tch_fr144_decode(&tch_data[0], BUFPOS(bursts_p, 0),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_fr144_decode(&tch_data[0], BUFRPOS(bursts_p, base, 0),
 					      &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		meas_avg_mode = SCHED_MEAS_AVG_M_S24N22;
 		break;
 	default:
@@ -291,6 +368,9 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		return -EINVAL;
 	}
 
+	trx_sched_ul_facch_result(l1ts, bi, facch_pred, rc == GSM_MACBLOCK_LEN);
+
+gated:
 	ber10k = compute_ber10k(n_bits_total, n_errors);
 
 	/* average measurements of the last N (depends on mode) bursts */
@@ -339,6 +419,105 @@ int rx_tchf_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 				      is_sub);
 }
 
+/* Longest gap (in TDMA frames) between two blocks which may start a
+ * FACCH/F or FACCH/H, see sched_tchh_dl_facch_map[] */
+#define TCHF_DL_FACCH_GAP_FN	5
+#define TCHH_DL_FACCH_GAP_FN	9
+
+extern const uint8_t sched_tchh_dl_facch_map[26];
+
+/* does the (valid) TCH frame carry speech, which a FACCH would rather not steal? */
+static bool tch_dl_is_speech(const struct l1sched_chan_state *chan_state,
+			     const struct msgb *msg_tch, bool amr_sid)
+{
+	if (chan_state->rsl_cmode != RSL_CMOD_SPD_SPEECH)
+		return false;
+
+	switch (chan_state->tch_mode) {
+	case GSM48_CMODE_SPEECH_V1:
+		if (msgb_l2len(msg_tch) == GSM_HR_BYTES)
+			return !osmo_hr_check_sid(msgb_l2(msg_tch), msgb_l2len(msg_tch));
+		return !osmo_fr_check_sid(msgb_l2(msg_tch), msgb_l2len(msg_tch));
+	case GSM48_CMODE_SPEECH_EFR:
+		return !osmo_efr_check_sid(msgb_l2(msg_tch), msgb_l2len(msg_tch));
+	case GSM48_CMODE_SPEECH_AMR:
+		return !amr_sid;
+	default:
+		return false;
+	}
+}
+
+static void tch_dl_facch_delay_account(struct l1sched_ts *l1ts, uint32_t delay_fn)
+{
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) l1ts->ts->trx->bts->model_priv;
+	unsigned int delay_ms = delay_fn * GSM_TDMA_FN_DURATION_uS / 1000;
+	unsigned int ctr;
+
+	if (delay_ms == 0)
+		ctr = BTSTRX_CTR_SCHED_DL_FACCH_DELAY_0MS;
+	else if (delay_ms <= 25)
+		ctr = BTSTRX_CTR_SCHED_DL_FACCH_DELAY_25MS;
+	else if (delay_ms <= 50)
+		ctr = BTSTRX_CTR_SCHED_DL_FACCH_DELAY_50MS;
+	else if (delay_ms <= 100)
+		ctr = BTSTRX_CTR_SCHED_DL_FACCH_DELAY_100MS;
+	else
+		ctr = BTSTRX_CTR_SCHED_DL_FACCH_DELAY_MORE;
+	rate_ctr_shard_inc(priv->ctrs_shard, ctr);
+}
+
+/* Pick what to send in this block: a FACCH steals a speech frame only once
+ * it cannot wait for a later block without speech (SID, DTX pause, no RTP)
+ * within 'osmotrx dl-facch-max-delay'.  Speech frames have no slack: their
+ * FN is the playout time derived from RTP, a deferred frame would be late.
+ * At most one FACCH is kept back, in the order LAPDm sent them. */
+static void tch_dl_facch_mux(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br,
+			     struct msgb **msg_tch, struct msgb **msg_facch, bool amr_sid)
+{
+	struct l1sched_chan_state *chan_state = &l1ts->chan_state[br->chan];
+	const struct phy_link *plink = l1ts->ts->trx->pinst->phy_link;
+	struct msgb *deferred = chan_state->dl_facch_deferred;
+	uint32_t max_delay_fn, delay_fn, gap_fn;
+
+	if (OSMO_LIKELY(deferred == NULL && *msg_facch == NULL))
+		return;
+
+	if (br->chan == TRXC_TCHF) {
+		gap_fn = TCHF_DL_FACCH_GAP_FN;
+	} else {
+		gap_fn = TCHH_DL_FACCH_GAP_FN;
+		/* a FACCH/H may only start at specific FNs, a new one only arrives there */
+		if (deferred != NULL && (!sched_tchh_dl_facch_map[br->fn % 26] || chan_state->dl_ongoing_facch))
+			return;
+	}
+
+	if (deferred != NULL) {
+		chan_state->dl_facch_deferred = NULL;
+		if (*msg_facch != NULL) {
+			/* the FACCH kept back goes first, the new one waits and
+			 * gets checked against its own bound in the next blocks */
+			chan_state->dl_facch_deferred = *msg_facch;
+			*msg_facch = deferred;
+			goto send;
+		}
+		*msg_facch = deferred;
+	}
+
+	/* the bound may not allow to wait for the next FACCH position */
+	max_delay_fn = plink->u.osmotrx.dl_facch_max_delay_ms * 1000 / GSM_TDMA_FN_DURATION_uS;
+	delay_fn = GSM_TDMA_FN_SUB(br->fn, msgb_l1sap_prim(*msg_facch)->u.data.fn);
+	if (*msg_tch != NULL && delay_fn + gap_fn <= max_delay_fn &&
+	    tch_dl_is_speech(chan_state, *msg_tch, amr_sid)) {
+		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "Keeping FACCH back, not stealing speech\n");
+		chan_state->dl_facch_deferred = *msg_facch;
+		*msg_facch = NULL;
+		return;
+	}
+
+send:
+	tch_dl_facch_delay_account(l1ts, GSM_TDMA_FN_SUB(br->fn, msgb_l1sap_prim(*msg_facch)->u.data.fn));
+}
+
 /* common section for generation of TCH bursts (TCH/H and TCH/F).
  * FIXME: this function is over-complicated, refactor / get rid of it. */
 void tch_dl_dequeue(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br,
@@ -349,6 +528,7 @@ void tch_dl_dequeue(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br,
 	uint8_t rsl_cmode = chan_state->rsl_cmode;
 	uint8_t tch_mode = chan_state->tch_mode;
 	struct osmo_phsap_prim *l1sap;
+	bool amr_sid = false;
 
 	/* get frame and unlink from queue */
 	msg1 = _sched_dequeue_prim(l1ts, br);
@@ -391,7 +571,7 @@ void tch_dl_dequeue(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br,
 	if (*msg_tch != NULL) {
 		int len;
 		uint8_t cmr_codec;
-		int ft, i;
+		int ft;
 		enum osmo_amr_type ft_codec;
 		enum osmo_amr_quality bfi;
 		int8_t sti, cmi;
@@ -423,11 +603,10 @@ void tch_dl_dequeue(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br,
 				LOGL1SB(DL1P, LOGL_ERROR, l1ts, br, "Cannot send invalid AMR payload\n");
 				goto free_bad_msg;
 			}
-			ft = -1;
-			for (i = 0; i < chan_state->codecs; i++) {
-				if (chan_state->codec[i] == ft_codec)
-					ft = i;
-			}
+			if (ft_codec < ARRAY_SIZE(chan_state->lchan->tch.amr_mr.mode_idx))
+				ft = chan_state->lchan->tch.amr_mr.mode_idx[ft_codec];
+			else
+				ft = -1;
 			if (ft < 0) {
 				LOGL1SB(DL1P, LOGL_ERROR, l1ts, br,
 					"Codec (FT = %d) of RTP frame not in list\n", ft_codec);
@@ -443,6 +622,7 @@ void tch_dl_dequeue(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br,
 				goto free_bad_msg;
 			}
 			chan_state->dl_ft = ft;
+			amr_sid = (ft_codec == AMR_SID);
 			if (bfi == AMR_BAD) {
 				LOGL1SB(DL1P, LOGL_NOTICE, l1ts, br, "Transmitting 'bad AMR frame'\n");
 				goto free_bad_msg;
@@ -488,6 +668,8 @@ free_bad_msg:
 			*msg_tch = NULL;
 		}
 	}
+
+	tch_dl_facch_mux(l1ts, br, msg_tch, msg_facch, amr_sid);
 }
 
 /* obtain a to-be-transmitted TCH/F (Full Traffic Channel) burst */
@@ -519,12 +701,7 @@ int tx_tchf_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 	/* dequeue a TCH and/or a FACCH message to be transmitted */
 	tch_dl_dequeue(l1ts, br, &msg_tch, &msg_facch);
 	if (msg_tch == NULL && msg_facch == NULL) {
-		static const uint8_t dummy[GSM_MACBLOCK_LEN] = {
-			0x03, 0x03, 0x01, /* TODO: use randomized padding */
-			0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
-			0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
-		};
-		int rc;
+		tchf_dl_patterns_init();
 
 		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "No TCH or FACCH prim for transmit.\n");
 		/* If the channel mode is TCH/FS or TCH/EFS, transmit a dummy
@@ -539,12 +716,13 @@ int tx_tchf_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 		switch (tch_mode) {
 		case GSM48_CMODE_SPEECH_V1:
 		case GSM48_CMODE_SPEECH_EFR:
-			rc = gsm0503_tch_fr_encode(bursts_p, NULL, 0, 1);
-			if (rc == 0)
+			if (tchf_dl_bfi.rc == 0) {
+				tch_dl_pattern_apply(bursts_p, &tchf_dl_bfi);
 				break;
+			}
 			/* fall-through */
 		default:
-			gsm0503_tch_fr_encode(bursts_p, dummy, sizeof(dummy), 1);
+			tch_dl_pattern_apply(bursts_p, &tchf_dl_facch);
 			chan_state->dl_facch_bursts = 8;
 		}
 		goto send_burst;
@@ -131,13 +131,24 @@ static int decode_hr_facch(struct l1sched_ts *l1ts,
 {
 	struct l1sched_chan_state *chan_state = &l1ts->chan_state[bi->chan];
 	const sbit_t *bursts_p = chan_state->ul_bursts;
+	const uint8_t base = chan_state->ul_bursts_base;
 	struct l1sched_meas_set meas_avg;
 	uint8_t data[GSM_MACBLOCK_LEN];
 	int n_errors, n_bits_total;
-	int rc;
+	int pred, rc;
+
+	/* CSD bursts carry no stealing flags unless FACCH/H took them */
+	pred = trx_sched_ul_facch_pred(l1ts, BUFRTAIL8(bursts_p, base), true);
+	if (pred < 0) {
+		trx_sched_ul_facch_skipped(l1ts, bi);
+		return 0;
+	}
 
-	rc = gsm0503_tch_hr_facch_decode(&data[0], BUFTAIL8(bursts_p),
+	TRACE_UL_DECODE_START(l1ts, bi);
+	rc = gsm0503_tch_hr_facch_decode(&data[0], BUFRTAIL8(bursts_p, base),
 					 &n_errors, &n_bits_total);
+	TRACE_UL_DECODE_DONE(l1ts, bi, rc);
+	trx_sched_ul_facch_result(l1ts, bi, pred, rc == GSM_MACBLOCK_LEN);
 	if (rc != GSM_MACBLOCK_LEN)
 		return rc;
 
@@ -160,13 +171,15 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 {
 	struct l1sched_chan_state *chan_state = &l1ts->chan_state[bi->chan];
 	struct gsm_lchan *lchan = chan_state->lchan;
-	sbit_t *burst, *bursts_p = chan_state->ul_bursts;
+	sbit_t *bursts_p = chan_state->ul_bursts;
 	uint32_t *mask = &chan_state->ul_mask;
+	uint8_t base;
 	uint8_t rsl_cmode = chan_state->rsl_cmode;
 	uint8_t tch_mode = chan_state->tch_mode;
 	uint8_t tch_data[240]; /* large enough to hold 240 unpacked bits for CSD */
 	int rc = 0; /* initialize to make gcc happy */
 	int amr = 0;
+	int facch_pred = 0;
 	int n_errors = 0;
 	int n_bits_total = 0;
 	enum sched_meas_avg_mode meas_avg_mode = SCHED_MEAS_AVG_M_S6N4;
@@ -184,12 +197,12 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 
 	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Received TCH/H, bid=%u\n", bi->bid);
 
-	/* shift the buffer by 2 bursts leftwards */
+	/* advance the ring by 2 bursts */
 	if (bi->bid == 0) {
-		memmove(BUFPOS(bursts_p, 0), BUFPOS(bursts_p, 2), 20 * BPLEN);
-		memset(BUFPOS(bursts_p, 20), 0, 2 * BPLEN);
+		bufr_advance(&chan_state->ul_bursts_base, 2);
 		*mask = *mask << 2;
 	}
+	base = chan_state->ul_bursts_base;
 
 	/* update mask */
 	*mask |= (1 << bi->bid);
@@ -197,12 +210,9 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	/* store measurements */
 	trx_sched_meas_push(chan_state, bi);
 
-	/* copy burst to end of buffer of 24 bursts */
-	burst = BUFPOS(bursts_p, 20 + bi->bid);
-	if (bi->burst_len > 0) {
-		memcpy(burst, bi->burst + 3, 58);
-		memcpy(burst + 58, bi->burst + 87, 58);
-	}
+	/* copy burst to end of the ring of 24 bursts */
+	bufr_store(bursts_p, base, 20 + bi->bid,
+		   bi->burst_len > 0 ? bi->burst : NULL);
 
 	/* wait until complete set of bursts */
 	if (bi->bid != 1)
@@ -216,6 +226,9 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		return 0; /* TODO: send BFI */
 	}
 
+	/* zero bursts which were not received at all (not even a NOPE.ind) */
+	bufr_clear_missing(bursts_p, base, *mask, 2, BUFMAX - 2);
+
 	/* skip decoding of the last 4 bursts of FACCH/H */
 	if (chan_state->ul_ongoing_facch) {
 		chan_state->ul_ongoing_facch = 0;
@@ -227,6 +240,24 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		goto bfi;
 	}
 
+	/* Speech and signalling frames are within the last 6 bursts (the first 6
+	 * of the 8 bursts tail, see bufr_store() above), CSD frames are
+	 * interleaved over more bursts than checked here */
+	switch (tch_mode) {
+	case GSM48_CMODE_SIGN:
+	case GSM48_CMODE_SPEECH_V1:
+	case GSM48_CMODE_SPEECH_AMR:
+		if (trx_sched_ul_gated(l1ts, bi, BUFRTAIL8(bursts_p, base),
+				       6 * BPLEN, meas_avg_mode)) {
+			rc = 0;
+			goto gated;
+		}
+		/* the decoder itself tries FACCH/H first if the block looks stolen */
+		if (sched_tchh_ul_facch_map[bi->fn % 26])
+			facch_pred = trx_sched_ul_facch_pred(l1ts, BUFRTAIL8(bursts_p, base), true);
+		break;
+	}
+
 	/* TCH/H: speech and signalling frames are interleaved over 4 and 6 bursts,
 	 * respectively, while CSD frames are interleaved over 22 bursts.  Unless
 	 * we're in CSD mode, decode only the last 6 bursts to avoid introducing
@@ -236,9 +267,11 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		meas_avg_mode = SCHED_MEAS_AVG_M_S6N6;
 		/* fall-through */
 	case GSM48_CMODE_SPEECH_V1: /* HR or signalling */
-		rc = gsm0503_tch_hr_decode2(tch_data, BUFTAIL8(bursts_p),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_hr_decode2(tch_data, BUFRTAIL8(bursts_p, base),
 					    !sched_tchh_ul_facch_map[bi->fn % 26],
 					    &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		if (rc == GSM_HR_BYTES) { /* only for valid *speech* frames */
 			bool is_sid = osmo_hr_check_sid(tch_data, GSM_HR_BYTES);
 			lchan_set_marker(is_sid, lchan); /* DTXu */
@@ -263,12 +296,14 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 
 		/* See comment in function rx_tchf_fn() */
 		amr = sizeof(struct amr_hdr);
-		rc = gsm0503_tch_ahs_decode_dtx(tch_data + amr, BUFTAIL8(bursts_p),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_ahs_decode_dtx(tch_data + amr, BUFRTAIL8(bursts_p, base),
 						!sched_tchh_ul_facch_map[bi->fn % 26],
 						!fn_is_cmi, chan_state->codec,
 						chan_state->codecs, &chan_state->ul_ft,
 						&chan_state->ul_cmr, &n_errors, &n_bits_total,
 						&chan_state->amr_last_dtx);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 
 		/* Tag all frames that are not regular AMR voice frames
 		   as SUB-Frames */
@@ -325,8 +360,10 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 			return 0; /* CSD: skip decoding attempt, need 2 more bursts */
 		/* FACCH/F does not steal TCH/H4.8 frames, but only disturbs some bits */
 		decode_hr_facch(l1ts, bi);
-		rc = gsm0503_tch_hr48_decode(&tch_data[0], BUFPOS(bursts_p, 0),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_hr48_decode(&tch_data[0], BUFRPOS(bursts_p, base, 0),
 					     &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		meas_avg_mode = SCHED_MEAS_AVG_M_S22N22;
 		break;
 	/* CSD (TCH/H2.4): 3.6 kbit/s radio interface rate */
@@ -335,8 +372,10 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 			return 0; /* CSD: skip decoding attempt, need 2 more bursts */
 		/* FACCH/F does not steal TCH/H2.4 frames, but only disturbs some bits */
 		decode_hr_facch(l1ts, bi);
-		rc = gsm0503_tch_hr24_decode(&tch_data[0], BUFPOS(bursts_p, 0),
+		TRACE_UL_DECODE_START(l1ts, bi);
+		rc = gsm0503_tch_hr24_decode(&tch_data[0], BUFRPOS(bursts_p, base, 0),
 					     &n_errors, &n_bits_total);
+		TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 		meas_avg_mode = SCHED_MEAS_AVG_M_S22N22;
 		break;
 	default:
@@ -346,6 +385,9 @@ int rx_tchh_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		return -EINVAL;
 	}
 
+	trx_sched_ul_facch_result(l1ts, bi, facch_pred, rc == GSM_MACBLOCK_LEN);
+
+gated:
 	ber10k = compute_ber10k(n_bits_total, n_errors);
 
 	/* average measurements of the last N (depends on mode) bursts */
@@ -399,6 +441,38 @@ bfi:
 extern void tch_dl_dequeue(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br,
 			   struct msgb **msg_tch, struct msgb **msg_facch);
 
+static const uint8_t tchh_dl_dummy_facch[GSM_MACBLOCK_LEN] = {
+	0x03, 0x03, 0x01, /* TODO: use randomized padding */
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+};
+
+/* Pre-encoded dummy blocks, sent whenever there is nothing to transmit.
+ * They do not depend on the channel, so they are encoded once on first use. */
+static struct tch_dl_pattern tchh_dl_bfi; /* speech block with inverted CRC3 */
+static struct tch_dl_pattern tchh_dl_facch; /* dummy L2 frame on FACCH/H */
+
+static void tchh_dl_patterns_init(void)
+{
+	ubit_t zeros[8 * BPLEN], ones[8 * BPLEN];
+	int rc;
+
+	if (OSMO_LIKELY(tchh_dl_bfi.valid))
+		return;
+
+	memset(zeros, 0, sizeof(zeros));
+	memset(ones, 1, sizeof(ones));
+	rc = gsm0503_tch_hr_encode(zeros, NULL, 0);
+	gsm0503_tch_hr_encode(ones, NULL, 0);
+	tch_dl_pattern_set(&tchh_dl_bfi, rc, zeros, ones);
+
+	memset(zeros, 0, sizeof(zeros));
+	memset(ones, 1, sizeof(ones));
+	rc = gsm0503_tch_hr_encode(zeros, tchh_dl_dummy_facch, sizeof(tchh_dl_dummy_facch));
+	gsm0503_tch_hr_encode(ones, tchh_dl_dummy_facch, sizeof(tchh_dl_dummy_facch));
+	tch_dl_pattern_set(&tchh_dl_facch, rc, zeros, ones);
+}
+
 /* obtain a to-be-transmitted TCH/H (Half Traffic Channel) burst */
 int tx_tchh_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 {
@@ -445,12 +519,7 @@ int tx_tchh_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 
 	/* no message at all, send a dummy L2 frame on FACCH */
 	if (msg_tch == NULL && msg_facch == NULL) {
-		static const uint8_t dummy[GSM_MACBLOCK_LEN] = {
-			0x03, 0x03, 0x01, /* TODO: use randomized padding */
-			0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
-			0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
-		};
-		int rc;
+		tchh_dl_patterns_init();
 
 		LOGL1SB(DL1P, LOGL_INFO, l1ts, br, "No TCH or FACCH prim for transmit.\n");
 		/* If the channel mode is TCH/HS, transmit a dummy speech block
@@ -462,10 +531,9 @@ int tx_tchh_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 		 * and decide what is the correct BTS Tx behavior for frame
 		 * gaps in TCH/AHS.  See OS#6049.
 		 */
-		if (tch_mode == GSM48_CMODE_SPEECH_V1) {
-			rc = gsm0503_tch_hr_encode(bursts_p, NULL, 0);
-			if (rc == 0)
-				goto send_burst;
+		if (tch_mode == GSM48_CMODE_SPEECH_V1 && tchh_dl_bfi.rc == 0) {
+			tch_dl_pattern_apply(bursts_p, &tchh_dl_bfi);
+			goto send_burst;
 		}
 
 		/* FACCH/H can only be scheduled at specific TDMA offset */
@@ -476,7 +544,7 @@ int tx_tchh_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 			goto send_burst;
 		}
 
-		gsm0503_tch_hr_encode(BUFPOS(bursts_p, 0), dummy, sizeof(dummy));
+		tch_dl_pattern_apply(BUFPOS(bursts_p, 0), &tchh_dl_facch);
 		if (chan_state->rsl_cmode != RSL_CMOD_SPD_DATA)
 			chan_state->dl_ongoing_facch = 1;
 		chan_state->dl_facch_bursts = 6;
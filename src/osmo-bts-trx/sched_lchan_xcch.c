@@ -25,9 +25,11 @@
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
 #include <osmocom/coding/gsm0503_coding.h>
 
 #include <osmo-bts/bts.h>
+#include <osmo-bts/cbch.h>
 #include <osmo-bts/l1sap.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/scheduler.h>
@@ -35,6 +37,8 @@
 
 #include <sched_utils.h>
 
+#include "l1_if.h"
+
 /* Add two arrays of sbits */
 static void add_sbits(sbit_t * current, const sbit_t * previous)
 {
@@ -60,6 +64,7 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	uint16_t ber10k;
 	int rc;
 	struct gsm_lchan *lchan = chan_state->lchan;
+	const struct bts_trx_priv *priv = (const struct bts_trx_priv *) l1ts->ts->trx->bts->model_priv;
 	bool rep_sacch = L1SAP_IS_LINK_SACCH(trx_chan_desc[bi->chan].link_id) && lchan->rep_acch.ul_sacch_active;
 
 	/* If handover RACH detection is turned on, treat this burst as an Access Burst.
@@ -110,8 +115,15 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	}
 	*mask = 0x0;
 
+	if (trx_sched_ul_gated(l1ts, bi, bursts_p, 4 * 116, SCHED_MEAS_AVG_M_S4N4)) {
+		l2_len = 0;
+		goto gated;
+	}
+
 	/* decode */
+	TRACE_UL_DECODE_START(l1ts, bi);
 	rc = gsm0503_xcch_decode(l2, bursts_p, &n_errors, &n_bits_total);
+	TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 	if (rc) {
 		LOGL1SB(DL1P, LOGL_NOTICE, l1ts, bi,
 			BAD_DATA_MSG_FMT "\n", BAD_DATA_MSG_ARGS);
@@ -121,9 +133,12 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 		 * current SACCH block by including the information from the
 		 * information from the previous SACCH block. See also:
 		 * 3GPP TS 44.006, section 11.2 */
-		if (rep_sacch) {
+		if (rep_sacch && chan_state->ul_bursts_prev_valid &&
+		    !fn_budget_shed(&priv->fn_budget, FN_BUDGET_STEP_REP_ACCH)) {
 			add_sbits(bursts_p, chan_state->ul_bursts_prev);
+			TRACE_UL_DECODE_START(l1ts, bi);
 			rc = gsm0503_xcch_decode(l2, bursts_p, &n_errors, &n_bits_total);
+			TRACE_UL_DECODE_DONE(l1ts, bi, rc);
 			if (rc) {
 				LOGL1SB(DL1P, LOGL_NOTICE, l1ts, bi,
 				       "Combining current SACCH block with previous SACCH block also yields bad data (%u/%u)\n",
@@ -138,11 +153,15 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 	} else
 		l2_len = GSM_MACBLOCK_LEN;
 
+gated:
 	ber10k = compute_ber10k(n_bits_total, n_errors);
 
-	/* Keep a copy to ease decoding in the next repetition pass */
+	/* Keep a copy to ease decoding in the next repetition pass.  While
+	 * repetition is off, the buffer goes stale and must not be combined
+	 * with the first block after it is turned on again. */
 	if (rep_sacch)
 		memcpy(chan_state->ul_bursts_prev, bursts_p, 464);
+	chan_state->ul_bursts_prev_valid = rep_sacch;
 
 	return _sched_compose_ph_data_ind(l1ts, *first_fn, bi->chan,
 					  &l2[0], l2_len,
@@ -154,6 +173,116 @@ int rx_data_fn(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
 }
 
 /* obtain a to-be-transmitted xCCH (e.g SACCH or SDCCH) burst */
+/* Encode an xCCH block, using the cache of encoded blocks for the channels
+ * which carry a lot of repeated content.  SACCH blocks are never cached, as
+ * their L1 header (power, timing advance) is specific to the MS.  CBCH blocks
+ * are encoded by cbch.c when the SMSCB message is accepted. */
+static void xcch_encode_cached(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br,
+			       ubit_t *bursts_p, const uint8_t *l2)
+{
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) l1ts->ts->trx->bts->model_priv;
+	struct trx_xcch_enc_cache *cache = &priv->xcch_enc_cache;
+	uint32_t hash = 2166136261u;
+	unsigned int i;
+
+	if (br->chan == TRXC_CBCH) {
+		const ubit_t *bursts = bts_cbch_get_bursts(l1ts->ts->trx->bts, br->fn, l2);
+
+		if (bursts) {
+			memcpy(bursts_p, bursts, SMSCB_BLOCK_BURSTS_LEN);
+			rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_DL_ENC_CBCH);
+			return;
+		}
+	}
+
+	switch (br->chan) {
+	case TRXC_BCCH:
+	case TRXC_CCCH:
+	case TRXC_SDCCH4_0 ... TRXC_SDCCH8_7:
+		break;
+	default:
+		gsm0503_xcch_encode(bursts_p, l2);
+		return;
+	}
+
+	/* FNV-1a over the L2 payload */
+	for (i = 0; i < GSM_MACBLOCK_LEN; i++)
+		hash = (hash ^ l2[i]) * 16777619u;
+	i = hash & (TRX_XCCH_ENC_CACHE_SIZE - 1);
+
+	if (cache->ent[i].valid && !memcmp(cache->ent[i].l2, l2, GSM_MACBLOCK_LEN)) {
+		memcpy(bursts_p, cache->ent[i].bursts, sizeof(cache->ent[i].bursts));
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_DL_ENC_CACHE_HIT);
+		return;
+	}
+
+	gsm0503_xcch_encode(bursts_p, l2);
+	rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_DL_ENC_CACHE_MISS);
+
+	memcpy(cache->ent[i].l2, l2, GSM_MACBLOCK_LEN);
+	memcpy(cache->ent[i].bursts, bursts_p, sizeof(cache->ent[i].bursts));
+	cache->ent[i].valid = true;
+}
+
+/*! Encode an xCCH block ahead of its first burst, if its prim is queued.
+ *  \param[in] l1ts L1 scheduler timeslot.
+ *  \param[in] chan logical channel whose block starts at fn.
+ *  \param[in] fn TDMA frame number of the first burst of the block.
+ *  \returns true if the block has been encoded now. */
+bool tx_data_encode_ahead(struct l1sched_ts *l1ts, enum trx_chan_type chan, uint32_t fn)
+{
+	const struct trx_dl_burst_req br = {
+		.fn = fn,
+		.tn = l1ts->ts->nr,
+		.chan = chan,
+	};
+	struct l1sched_dl_ahead *ahead;
+	struct msgb *msg;
+
+	if (OSMO_UNLIKELY(l1ts->dl_ahead == NULL)) {
+		l1ts->dl_ahead = talloc_zero_array(l1ts, struct l1sched_dl_ahead, L1SCHED_DL_AHEAD_LEN);
+		if (l1ts->dl_ahead == NULL)
+			return false;
+	}
+
+	ahead = &l1ts->dl_ahead[fn % L1SCHED_DL_AHEAD_LEN];
+	if (ahead->valid && ahead->fn == fn && ahead->chan == chan)
+		return false;
+
+	msg = _sched_peek_prim(l1ts, fn, chan);
+	if (msg == NULL || msgb_l2len(msg) != GSM_MACBLOCK_LEN)
+		return false;
+
+	xcch_encode_cached(l1ts, &br, ahead->bursts, msg->l2h);
+	memcpy(ahead->l2, msg->l2h, GSM_MACBLOCK_LEN);
+	ahead->chan = chan;
+	ahead->fn = fn;
+	ahead->valid = true;
+
+	return true;
+}
+
+/* Take the bursts of a block encoded by tx_data_encode_ahead(), if they
+ * are still those of the prim (it may have been replaced meanwhile) */
+static bool tx_data_take_ahead(struct l1sched_ts *l1ts, const struct trx_dl_burst_req *br,
+			       ubit_t *bursts_p, const uint8_t *l2)
+{
+	struct l1sched_dl_ahead *ahead;
+
+	if (OSMO_LIKELY(l1ts->dl_ahead == NULL))
+		return false;
+
+	ahead = &l1ts->dl_ahead[br->fn % L1SCHED_DL_AHEAD_LEN];
+	if (!ahead->valid || ahead->fn != br->fn || ahead->chan != br->chan)
+		return false;
+	ahead->valid = false;
+	if (memcmp(ahead->l2, l2, GSM_MACBLOCK_LEN))
+		return false;
+
+	memcpy(bursts_p, ahead->bursts, sizeof(ahead->bursts));
+	return true;
+}
+
 int tx_data_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 {
 	struct msgb *msg = NULL; /* make GCC happy */
@@ -188,8 +317,13 @@ int tx_data_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 
 	/* BURST BYPASS */
 
-	/* encode bursts */
-	gsm0503_xcch_encode(bursts_p, msg->l2h);
+	/* encode bursts, unless done ahead in the slack of a previous frame */
+	if (tx_data_take_ahead(l1ts, br, bursts_p, msg->l2h)) {
+		struct bts_trx_priv *priv = (struct bts_trx_priv *) l1ts->ts->trx->bts->model_priv;
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_DL_ENC_AHEAD);
+	} else {
+		xcch_encode_cached(l1ts, br, bursts_p, msg->l2h);
+	}
 
 	/* free message */
 	msgb_free(msg);
@@ -0,0 +1,122 @@
+/* Uplink measurement history and averaging for OsmoBTS-TRX */
+
+/* (C) 2020-2021 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/logging.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/scheduler.h>
+
+/* The history is a ring buffer of running sums: each entry holds the sums of
+ * all measurements pushed *before* it, and l1sched_meas_ring->sum holds the
+ * sums including the most recent one.  The sum of any window is then obtained
+ * by a single subtraction.  The sums are unsigned and wrap around, but the
+ * difference is exact as long as the window sum itself fits into int32_t. */
+
+/* Add a set of UL burst measurements to the history */
+void trx_sched_meas_push(struct l1sched_chan_state *chan_state,
+			 const struct trx_ul_burst_ind *bi)
+{
+	struct l1sched_meas_ring *hist = chan_state->meas.hist;
+	unsigned int hist_size = ARRAY_SIZE(hist->buf);
+	unsigned int current = hist->current;
+	struct l1sched_meas_sums *sum = &hist->sum;
+
+	hist->buf[current] = (struct l1sched_meas_hist) {
+		.fn = bi->fn,
+		.sum = *sum,
+	};
+
+	sum->toa256 += (uint32_t)(int32_t)bi->toa256;
+	sum->ci_cb  += (uint32_t)(int32_t)((bi->flags & TRX_BI_F_CI_CB) ? bi->ci_cb : 0);
+	sum->rssi   += (uint32_t)(int32_t)bi->rssi;
+
+	hist->current = (current + 1) % hist_size;
+}
+
+/* Measurement averaging mode sets: [MODE] = { SHIFT, NUM } */
+static const uint8_t trx_sched_meas_modeset[][2] = {
+	[SCHED_MEAS_AVG_M_S24N22] = { 24, 22 },
+	[SCHED_MEAS_AVG_M_S22N22] = { 22, 22 },
+	[SCHED_MEAS_AVG_M_S4N4] = { 4, 4 },
+	[SCHED_MEAS_AVG_M_S8N8] = { 8, 8 },
+	[SCHED_MEAS_AVG_M_S6N4] = { 6, 4 },
+	[SCHED_MEAS_AVG_M_S6N6] = { 6, 6 },
+	[SCHED_MEAS_AVG_M_S8N4] = { 8, 4 },
+	[SCHED_MEAS_AVG_M_S6N2] = { 6, 2 },
+	[SCHED_MEAS_AVG_M_S4N2] = { 4, 2 },
+};
+
+/* Calculate the AVG of n measurements from the history */
+void trx_sched_meas_avg(const struct l1sched_chan_state *chan_state,
+			struct l1sched_meas_set *avg,
+			enum sched_meas_avg_mode mode)
+{
+	const struct l1sched_meas_ring *hist = chan_state->meas.hist;
+	unsigned int hist_size = ARRAY_SIZE(hist->buf);
+	unsigned int current = hist->current;
+	const struct l1sched_meas_sums *head, *tail;
+	unsigned int pos;
+
+	const unsigned int shift = trx_sched_meas_modeset[mode][0];
+	const unsigned int num = trx_sched_meas_modeset[mode][1];
+
+	/* First sample contains TDMA frame number of the first burst */
+	pos = (current + hist_size - shift) % hist_size;
+	head = &hist->buf[pos].sum;
+
+	/* The window ends either with the most recent sample, or before pos + num */
+	if (shift == num)
+		tail = &hist->sum;
+	else
+		tail = &hist->buf[(pos + num) % hist_size].sum;
+
+	/* Calculate the average for each value */
+	*avg = (struct l1sched_meas_set) {
+		.fn     = hist->buf[pos].fn, /* first burst */
+		.rssi   = (float)(int32_t)(tail->rssi - head->rssi) / num,
+		.toa256 = (int32_t)(tail->toa256 - head->toa256) / (int)num,
+		.ci_cb  = (int32_t)(tail->ci_cb - head->ci_cb) / (int)num,
+	};
+
+	LOGP_HOTPATH(DMEAS, LOGL_DEBUG, "%s%sMeasurement AVG (num=%u, shift=%u): "
+	     "RSSI %f, ToA256 %d, C/I %d cB\n",
+	     chan_state->lchan ? gsm_lchan_name(chan_state->lchan) : "",
+	     chan_state->lchan ? " " : "",
+	     num, shift, avg->rssi, avg->toa256, avg->ci_cb);
+}
+
+/* Lookup TDMA frame number of the N-th sample in the history */
+uint32_t trx_sched_lookup_fn(const struct l1sched_chan_state *chan_state,
+			     const unsigned int shift)
+{
+	const struct l1sched_meas_ring *hist = chan_state->meas.hist;
+	const unsigned int hist_size = ARRAY_SIZE(hist->buf);
+	const unsigned int current = hist->current;
+	unsigned int pos;
+
+	/* First sample contains TDMA frame number of the first burst */
+	pos = (current + hist_size - shift) % hist_size;
+	return hist->buf[pos].fn;
+}
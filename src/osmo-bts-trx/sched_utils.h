@@ -22,6 +22,19 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/trace.h>
+
+/* Probe markers around the gsm0503_*_decode() calls in the Uplink handlers */
+#define TRACE_UL_DECODE_START(l1ts, bi) \
+	TRACE(OSMO_BTS_TRX_UL_DECODE_START((l1ts)->ts->trx->nr, (bi)->tn, (bi)->fn, (bi)->chan))
+#define TRACE_UL_DECODE_DONE(l1ts, bi, rc) \
+	TRACE(OSMO_BTS_TRX_UL_DECODE_DONE((l1ts)->ts->trx->nr, (bi)->tn, (bi)->fn, (bi)->chan, rc))
 
 /* Burst Payload LENgth (short alias) */
 #define BPLEN GSM_NBITS_NB_GMSK_PAYLOAD
@@ -35,8 +48,67 @@
 #define BUFPOS(buf, n) &buf[(n) * BPLEN]
 #define BUFTAIL8(buf) BUFPOS(buf, (BUFMAX - 8))
 
+/* Uplink TCH burst RING.  Instead of shifting the whole buffer on every
+ * new block, only the ring base ('ul_bursts_base') is advanced.  The buffer
+ * holds 2 * BUFMAX bursts, each burst is stored twice (BUFMAX apart), so
+ * that any window of up to BUFMAX bursts is contiguous in memory and can
+ * be passed to the gsm0503_*_decode() functions as-is. */
+#define BUFRPOS(buf, base, n) BUFPOS(buf, ((base) + (n)) % BUFMAX)
+#define BUFRTAIL8(buf, base) BUFRPOS(buf, base, (BUFMAX - 8))
+
+/* Advance the ring by one block of 'blen' bursts */
+static inline void bufr_advance(uint8_t *base, unsigned int blen)
+{
+	*base = (*base + blen) % BUFMAX;
+}
+
+/* Store the payload of a GMSK burst at position n (from the oldest burst);
+ * a NULL 'burst' (NOPE.ind) stores zeroes (no soft-bit information). */
+static inline void bufr_store(sbit_t *buf, uint8_t base, unsigned int n,
+			      const sbit_t *burst)
+{
+	sbit_t *pos = BUFRPOS(buf, base, n);
+
+	if (burst != NULL) {
+		memcpy(pos, burst + 3, 58);
+		memcpy(pos + 58, burst + 87, 58);
+	} else {
+		memset(pos, 0, BPLEN);
+	}
+
+	memcpy(pos + BUFMAX * BPLEN, pos, BPLEN);
+}
+
+/* Clear positions of bursts which were never received, so that no stale
+ * bits from the previous ring cycle get decoded.  Bit i of the mask
+ * belongs to the i-th burst of the current block (i < blen), or to an
+ * older block otherwise, like in the shift based buffer.  The current
+ * block ends right before position 'end' (BUFMAX on TCH/F, but BUFMAX - 2
+ * on TCH/H, which stores its bursts at the same positions as TCH/F). */
+static inline void bufr_clear_missing(sbit_t *buf, uint8_t base, uint32_t mask,
+				      unsigned int blen, unsigned int end)
+{
+	unsigned int i, n;
+
+	if (OSMO_LIKELY((mask & 0xffffff) == 0xffffff))
+		return;
+
+	for (i = 0; i < BUFMAX; i++) {
+		if (mask & (1 << i))
+			continue;
+		if (blen * (i / blen + 1) > end)
+			break;
+		n = end - blen * (i / blen + 1) + i % blen;
+		memset(BUFRPOS(buf, base, n), 0, BPLEN);
+		memset(BUFRPOS(buf, base, n) + BUFMAX * BPLEN, 0, BPLEN);
+	}
+}
+
 extern void *tall_bts_ctx;
 
+/* Maximum size of a EGPRS message in bytes */
+#define EGPRS_0503_MAX_BYTES	155
+
 #define BAD_DATA_MSG_FMT "Received bad data (rc=%d, BER %d/%d) ending at fn=%u/%u"
 #define BAD_DATA_MSG_ARGS \
 	rc, n_errors, n_bits_total, bi->fn % l1ts->mf_period, l1ts->mf_period
@@ -49,3 +121,81 @@ static inline uint16_t compute_ber10k(int n_bits_total, int n_errors)
 	else
 		return 10000 * n_errors / n_bits_total;
 }
+
+/*! A pre-encoded Downlink TCH block (dummy speech or FACCH), which is merged
+ *  into the interleaving buffer instead of running the encoder again.  Only
+ *  the bits written by the encoder are taken, the others belong to the
+ *  neighbouring blocks of the diagonal interleaving. */
+struct tch_dl_pattern {
+	bool valid;
+	/*! return value of the encoder */
+	int rc;
+	ubit_t bits[8 * BPLEN];
+	/*! non-zero for each bit written by the encoder */
+	uint8_t mask[8 * BPLEN];
+};
+
+/*! Fill a pattern from the output of two runs of the encoder, one into a
+ *  buffer of zeros and one into a buffer of ones: where they differ, the
+ *  encoder did not write the bit. */
+static inline void tch_dl_pattern_set(struct tch_dl_pattern *p, int rc,
+				      const ubit_t *zeros, const ubit_t *ones)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(p->bits); i++) {
+		p->bits[i] = zeros[i];
+		p->mask[i] = (zeros[i] == ones[i]);
+	}
+	p->rc = rc;
+	p->valid = true;
+}
+
+/*! Merge a pre-encoded pattern into the interleaving buffer */
+static inline void tch_dl_pattern_apply(ubit_t *bursts, const struct tch_dl_pattern *p)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(p->bits); i++) {
+		if (p->mask[i])
+			bursts[i] = p->bits[i];
+	}
+}
+
+/*! Uplink decode gate, see 'osmotrx ul-decode-gate'.
+ *  \param[in] bits the soft-bits of the block to be decoded
+ *  \param[in] nbits number of soft-bits
+ *  \param[in] mode averaging mode for the C/I of the block
+ *  \returns true if the block cannot be decoded and shall be declared bad */
+bool trx_sched_ul_gated(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi,
+			const sbit_t *bits, size_t nbits, enum sched_meas_avg_mode mode);
+
+/*! Soft sum of the stealing flags of a FACCH/F (8 bursts) or FACCH/H (6 bursts)
+ *  block, positive if the block looks stolen.  These are the flags which the
+ *  gsm0503_tch_*_decode() functions check: hu of the first and hl of the last
+ *  4 bursts of the block (bursts 0..3 and 2..5 of a FACCH/H). */
+static inline int tch_steal_score(const sbit_t *bursts, bool half)
+{
+	unsigned int i, nb = half ? 6 : 8;
+	int score = 0;
+
+	for (i = 0; i < 4; i++)
+		score -= bursts[i * BPLEN + 58]; /* hu */
+	for (i = nb - 4; i < nb; i++)
+		score -= bursts[i * BPLEN + 57]; /* hl */
+
+	return score;
+}
+
+/*! FACCH prediction, see 'osmotrx ul-facch-steal-threshold'.
+ *  \param[in] bursts the bursts of the FACCH/F or FACCH/H block
+ *  \param[in] half true for a FACCH/H block
+ *  \returns 1 if FACCH is expected, -1 if not, 0 if the flags are inconclusive */
+int trx_sched_ul_facch_pred(const struct l1sched_ts *l1ts, const sbit_t *bursts, bool half);
+
+/*! Account a decoded block against the FACCH prediction */
+void trx_sched_ul_facch_result(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi,
+			       int pred, bool facch);
+
+/*! Account a FACCH decoding attempt skipped due to the prediction */
+void trx_sched_ul_facch_skipped(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi);
@@ -46,22 +46,13 @@
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/scheduler_backend.h>
 #include <osmo-bts/pcu_if.h>
+#include <osmo-bts/slack_task.h>
+#include <osmo-bts/trace.h>
 
 #include "l1_if.h"
 #include "trx_if.h"
-
-#include "btsconfig.h"
-
-#ifdef HAVE_SYSTEMTAP
-/* include the generated probes header and put markers in code */
-#include "probes.h"
-#define TRACE(probe) probe
-#define TRACE_ENABLED(probe) probe ## _ENABLED()
-#else
-/* Wrap the probe to allow it to be removed when no systemtap available */
-#define TRACE(probe)
-#define TRACE_ENABLED(probe) (0)
-#endif /* HAVE_SYSTEMTAP */
+#include "ul_decoder.h"
+#include "sched_utils.h"
 
 #define SCHED_FH_PARAMS_FMT "hsn=%u, maio=%u, ma_len=%u"
 #define SCHED_FH_PARAMS_VALS(ts) \
@@ -118,23 +109,102 @@ static void lchan_report_interf_meas(const struct gsm_lchan *lchan)
 	gsm_lchan_interf_meas_push((struct gsm_lchan *) lchan, interf_avg);
 }
 
-static void bts_report_interf_meas(const struct gsm_bts *bts)
+/* Every timeslot reports once per SACCH period (104 TDMA frames), but the
+ * work is spread across the period: TS N of TRX M reports in the TDMA frames
+ * with fn % 104 == (M * 8 + N) % 104, rather than all at once. */
+static void bts_report_interf_meas(const struct gsm_bts *bts, uint32_t fn)
 {
+	const struct bts_trx_priv *bts_trx = (const struct bts_trx_priv *)bts->model_priv;
 	const struct gsm_bts_trx *trx;
 	unsigned int tn, ln;
 
+	/* under load, report only every other SACCH period */
+	if (fn_budget_shed(&bts_trx->fn_budget, FN_BUDGET_STEP_INTERF_MEAS) && (fn / 104) % 2)
+		return;
+
 	llist_for_each_entry(trx, &bts->trx_list, list) {
+		const struct gsm_bts_trx_ts *ts;
+
+		tn = (fn % 104 + 104 - (trx->nr * TRX_NR_TS) % 104) % 104;
+		if (tn >= ARRAY_SIZE(trx->ts))
+			continue;
+
+		ts = &trx->ts[tn];
+		/* no channel combination on this timeslot */
+		if (ts->priv == NULL)
+			continue;
+		trx_sched_noise_meas_reduce(ts->priv);
+
 		/* Skip pushing interf_meas for disabled TRX */
 		if (trx->mo.nm_state.operational != NM_OPSTATE_ENABLED ||
 		    trx->bb_transc.mo.nm_state.operational != NM_OPSTATE_ENABLED)
 			continue;
 
-		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
-			const struct gsm_bts_trx_ts *ts = &trx->ts[tn];
-			for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++)
-				lchan_report_interf_meas(&ts->lchan[ln]);
+		for (ln = 0; ln < ARRAY_SIZE(ts->lchan); ln++)
+			lchan_report_interf_meas(&ts->lchan[ln]);
+	}
+}
+
+/* Mobile Allocation Index (MAI) of a hopping timeslot in the given TDMA frame */
+static inline uint8_t sched_fh_mai(const struct gsm_bts_trx_ts *ts, uint32_t fn)
+{
+	const struct l1sched_ts *l1ts = ts->priv;
+	struct gsm_time time;
+
+	if (OSMO_LIKELY(l1ts != NULL && l1ts->fh_mai != NULL))
+		return l1ts->fh_mai[fn % L1SCHED_FH_PERIOD];
+
+	/* Cyclic hopping: no table needed, see trx_sched_fh_setup() */
+	if (ts->hopping.hsn == 0)
+		return (fn + ts->hopping.maio) % ts->hopping.arfcn_num;
+
+	gsm_fn2gsmtime(&time, fn);
+	return gsm0502_hop_seq_gen(&time, SCHED_FH_PARAMS_VALS(ts), NULL);
+}
+
+/*! (re)build the frequency hopping lookup tables of a timeslot.  To be called
+ *  whenever its hopping parameters might have changed, i.e. on Opstart. */
+void trx_sched_fh_setup(struct gsm_bts_trx_ts *ts)
+{
+	struct l1sched_ts *l1ts = ts->priv;
+	const struct gsm_bts_trx *trx;
+	struct gsm_time time;
+	unsigned int fn, i;
+
+	memset(&ts->fh_trx_list[0], 0, sizeof(ts->fh_trx_list));
+	if (l1ts == NULL)
+		return;
+	TALLOC_FREE(l1ts->fh_mai);
+
+	if (!ts->hopping.enabled)
+		return;
+
+	/* Resolve the RF carriers which are known already, the
+	 * others are looked up on demand by dlfh_route_br() */
+	for (i = 0; i < ts->hopping.arfcn_num; i++) {
+		llist_for_each_entry(trx, &ts->trx->bts->trx_list, list) {
+			if (trx->arfcn == ts->hopping.arfcn_list[i]) {
+				ts->fh_trx_list[i] = trx;
+				break;
+			}
 		}
 	}
+
+	/* Cyclic hopping is a single modulo operation, and the sequence
+	 * would not repeat with L1SCHED_FH_PERIOD for all MA lengths */
+	if (ts->hopping.hsn == 0)
+		return;
+
+	l1ts->fh_mai = talloc_size(l1ts, L1SCHED_FH_PERIOD);
+	OSMO_ASSERT(l1ts->fh_mai != NULL);
+
+	for (fn = 0; fn < L1SCHED_FH_PERIOD; fn++) {
+		gsm_fn2gsmtime(&time, fn);
+		l1ts->fh_mai[fn] = gsm0502_hop_seq_gen(&time, SCHED_FH_PARAMS_VALS(ts), NULL);
+	}
+
+	LOGPTRX(ts->trx, DL1C, LOGL_INFO, "TS%u: built hopping sequence table ("
+		SCHED_FH_PARAMS_FMT ")\n", ts->nr, SCHED_FH_PARAMS_VALS(ts));
 }
 
 /* Find a route (PHY instance) for a given Downlink burst request */
@@ -142,14 +212,11 @@ static struct phy_instance *dlfh_route_br(const struct trx_dl_burst_req *br,
 					  struct gsm_bts_trx_ts *ts)
 {
 	const struct gsm_bts_trx *trx;
-	struct gsm_time time;
-	uint16_t idx;
-
-	gsm_fn2gsmtime(&time, br->fn);
+	uint8_t idx;
 
 	/* Check the "cache" first, so we eliminate frequent lookups */
-	idx = gsm0502_hop_seq_gen(&time, SCHED_FH_PARAMS_VALS(ts), NULL);
-	if (ts->fh_trx_list[idx] != NULL)
+	idx = sched_fh_mai(ts, br->fn);
+	if (OSMO_LIKELY(ts->fh_trx_list[idx] != NULL))
 		return ts->fh_trx_list[idx]->pinst;
 
 	struct bts_trx_priv *priv = (struct bts_trx_priv *) ts->trx->bts->model_priv;
@@ -157,7 +224,7 @@ static struct phy_instance *dlfh_route_br(const struct trx_dl_burst_req *br,
 	/* The "cache" may not be filled yet, lookup the transceiver */
 	llist_for_each_entry(trx, &ts->trx->bts->trx_list, list) {
 		if (trx->arfcn == ts->hopping.arfcn_list[idx]) {
-			rate_ctr_inc2(priv->ctrs, BTSTRX_CTR_SCHED_DL_FH_CACHE_MISS);
+			rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_DL_FH_CACHE_MISS);
 			ts->fh_trx_list[idx] = trx;
 			return trx->pinst;
 		}
@@ -167,7 +234,7 @@ static struct phy_instance *dlfh_route_br(const struct trx_dl_burst_req *br,
 		"for a Downlink burst (fn=%u, tn=%u, " SCHED_FH_PARAMS_FMT ")\n",
 		br->fn, br->tn, SCHED_FH_PARAMS_VALS(ts));
 
-	rate_ctr_inc2(priv->ctrs, BTSTRX_CTR_SCHED_DL_FH_NO_CARRIER);
+	rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_DL_FH_NO_CARRIER);
 
 	return NULL;
 }
@@ -191,6 +258,7 @@ static void bts_sched_init_buffers(struct gsm_bts *bts, const uint32_t fn)
 				.trx_num = trx->nr,
 				.fn = sched_fn,
 				.tn = tn,
+				.burst = &br->burst_buf[0],
 			};
 		}
 	}
@@ -209,11 +277,16 @@ static void bts_sched_init_buffers(struct gsm_bts *bts, const uint32_t fn)
 	}
 }
 
-static void bts_sched_flush_buffers(struct gsm_bts *bts)
+static void bts_sched_flush_buffers(struct gsm_bts *bts, const uint32_t fn)
 {
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) bts->model_priv;
 	const struct gsm_bts_trx *trx;
+	struct timespec tv_start, tv_done, tv_diff;
 	unsigned int tn;
 
+	TRACE(OSMO_BTS_TRX_DL_FLUSH_START(fn));
+	clock_gettime(CLOCK_MONOTONIC, &tv_start);
+
 	llist_for_each_entry(trx, &bts->trx_list, list) {
 		const struct phy_instance *pinst = trx->pinst;
 		struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
@@ -226,9 +299,45 @@ static void bts_sched_flush_buffers(struct gsm_bts *bts)
 				continue;
 			trx_if_send_burst(l1h, br);
 		}
+	}
+
+	/* Batch all timeslots into a single TRXD datagram, or all TRX if they
+	 * share the TRXD socket (the others then have nothing left to send) */
+	llist_for_each_entry(trx, &bts->trx_list, list)
+		trx_if_send_burst(trx->pinst->u.osmotrx.hdl, NULL);
+
+	/* Report the time it took to hand over all datagrams to the kernel */
+	clock_gettime(CLOCK_MONOTONIC, &tv_done);
+	timespecsub(&tv_done, &tv_start, &tv_diff);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(priv->stats, BTSTRX_STAT_TRXD_TX_FLUSH_US),
+			   tv_diff.tv_sec * 1000000 + tv_diff.tv_nsec / 1000);
+	TRACE(OSMO_BTS_TRX_DL_FLUSH_DONE(fn));
+}
+
+/* Pre-compute A5 keystream for the Downlink and Uplink bursts of the next TDMA
+ * frame, taking the A5/x (most notably A5/3 KASUMI) computation off the path
+ * between reception of a burst and its decoding. */
+static void bts_sched_a5_prefill(struct gsm_bts *bts, const uint32_t fn)
+{
+	const struct gsm_bts_trx *trx;
+	unsigned int tn;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		const struct phy_link *plink = trx->pinst->phy_link;
+		struct trx_l1h *l1h = trx->pinst->u.osmotrx.hdl;
+		const uint32_t ul_fn = GSM_TDMA_FN_INC(fn);
+		const uint32_t dl_fn = GSM_TDMA_FN_SUM(ul_fn, plink->u.osmotrx.clock_advance);
+
+		if (!trx_if_powered(l1h))
+			continue;
+
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			const struct gsm_bts_trx_ts *ts = &trx->ts[tn];
 
-		/* Batch all timeslots into a single TRXD PDU */
-		trx_if_send_burst(l1h, NULL);
+			trx_sched_a5_prefill(ts->priv, dl_fn, ul_fn);
+			if (ts->vamos.peer->pchan != GSM_PCHAN_NONE)
+				trx_sched_a5_prefill(ts->vamos.peer->priv, dl_fn, ul_fn);
+		}
 	}
 }
 
@@ -237,6 +346,7 @@ static void _sched_dl_shadow_burst(const struct gsm_bts_trx_ts *ts,
 				   struct trx_dl_burst_req *br)
 {
 	struct l1sched_ts *l1ts = ts->priv;
+	struct trx_dl_burst_req sbr;
 
 	/* For the shadow timeslots, physical channel type can be either
 	 * GSM_PCHAN_TCH_{F,H} or GSM_PCHAN_NONE.  Even if the primary
@@ -244,37 +354,213 @@ static void _sched_dl_shadow_burst(const struct gsm_bts_trx_ts *ts,
 	if (ts->pchan == GSM_PCHAN_NONE)
 		return;
 
-	struct trx_dl_burst_req sbr = {
-		.trx_num = br->trx_num,
-		.fn = br->fn,
-		.tn = br->tn,
-	};
+	/* Only the metadata is initialized here, sbr.burst_buf[] is not used:
+	 * the shadow burst goes right behind the primary burst, or in its
+	 * place if there is none, so that the bits need not be merged. */
+	sbr.flags = 0x00;
+	sbr.fn = br->fn;
+	sbr.tn = br->tn;
+	sbr.att = 0;
+	sbr.scpir = 0;
+	sbr.trx_num = br->trx_num;
+	sbr.mod = TRX_MOD_T_GMSK;
+	sbr.tsc_set = 0;
+	sbr.tsc = 0;
+	sbr.burst_len = 0;
+	if (br->burst_len != 0)
+		sbr.burst = br->burst + GSM_BURST_LEN;
+	else
+		sbr.burst = br->burst;
 
 	_sched_dl_burst(l1ts, &sbr);
 
-	if (br->burst_len != 0 && sbr.burst_len != 0) { /* Both present */
-		memcpy(br->burst + GSM_BURST_LEN, sbr.burst, GSM_BURST_LEN);
+	if (sbr.burst_len == 0) {
+		/* No shadow burst, send primary burst alone */
+		return;
+	} else if (br->burst_len != 0) { /* Both present */
 		br->burst_len = 2 * GSM_BURST_LEN;
 		br->mod = TRX_MOD_T_AQPSK;
 		/* FIXME: SCPIR is hard-coded to 0 */
-	} else if (br->burst_len == 0) {
+	} else {
 		/* No primary burst, send shadow burst alone */
-		memcpy(br, &sbr, sizeof(sbr));
-	} else if (sbr.burst_len == 0) {
-		/* No shadow burst, send primary burst alone */
+		br->flags = sbr.flags;
+		br->att = sbr.att;
+		br->scpir = sbr.scpir;
+		br->mod = sbr.mod;
+		br->tsc_set = sbr.tsc_set;
+		br->tsc = sbr.tsc;
+		br->chan = sbr.chan;
+		br->bid = sbr.bid;
+		br->burst_len = sbr.burst_len;
+	}
+}
+
+/*! compute the number of micro-seconds difference elapsed between \a last and \a now */
+static inline int64_t compute_elapsed_us(const struct timespec *last, const struct timespec *now)
+{
+	struct timespec elapsed;
+
+	timespecsub(now, last, &elapsed);
+	return (int64_t)(elapsed.tv_sec * 1000000) + (elapsed.tv_nsec / 1000);
+}
+
+/* account a sample in microseconds to the given log2 histogram */
+static void trx_clk_hist_add(struct trx_clk_hist *hist, int64_t val_us)
+{
+	unsigned int idx = 0;
+
+	if (val_us < 0)
+		val_us = -val_us;
+	if (val_us > UINT32_MAX)
+		val_us = UINT32_MAX;
+
+	if (val_us > 0)
+		idx = 32 - __builtin_clz((uint32_t)val_us);
+	if (idx >= ARRAY_SIZE(hist->buckets))
+		idx = ARRAY_SIZE(hist->buckets) - 1;
+
+	hist->buckets[idx]++;
+	hist->count++;
+	if (val_us > hist->max_us)
+		hist->max_us = val_us;
+}
+
+/*! number of quiet checks (no late DL prims, no high load) before 'rts-advance' is decreased */
+#define RTS_ADV_AUTO_QUIET_PERIODS	64
+
+/* closed-loop control of 'rts-advance' for a PHY link, see 'osmotrx rts-advance auto' */
+static void phy_link_rts_advance_ctrl(struct phy_link *plink, int64_t proc_us_max)
+{
+	struct osmotrx_rts_advance_auto *ctrl = &plink->u.osmotrx.rts_advance_auto;
+	uint32_t rts_advance = plink->u.osmotrx.rts_advance;
+	const struct phy_instance *pinst;
+	uint64_t dl_late = 0, dl_late_delta;
+	unsigned int tn;
+
+	/* sum up the DL_LATE counters of all timeslots on this PHY link */
+	llist_for_each_entry(pinst, &plink->instances, list) {
+		const struct gsm_bts_trx *trx = pinst->trx;
+
+		if (trx == NULL)
+			continue;
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			const struct l1sched_ts *l1ts = trx->ts[tn].priv;
+
+			if (l1ts == NULL)
+				continue;
+			dl_late += rate_ctr_group_get_ctr(l1ts->ctrs, L1SCHED_TS_CTR_DL_LATE)->current;
+		}
+	}
+
+	if (!ctrl->dl_late_valid) {
+		ctrl->dl_late_last = dl_late;
+		ctrl->dl_late_valid = true;
 		return;
 	}
+
+	dl_late_delta = dl_late - ctrl->dl_late_last;
+	ctrl->dl_late_last = dl_late;
+
+	if (dl_late_delta > 0) {
+		/* DL prims arrive too late: request them earlier */
+		ctrl->quiet_periods = 0;
+		if (rts_advance < ctrl->max) {
+			rts_advance++;
+			LOGPPHL(plink, DL1C, LOGL_NOTICE, "%" PRIu64 " DL prims arrived too late, "
+				"increasing rts-advance to %u\n", dl_late_delta, rts_advance);
+		}
+	} else if (proc_us_max > GSM_TDMA_FN_DURATION_uS / 2) {
+		/* high load: do not make the margin any smaller */
+		ctrl->quiet_periods = 0;
+	} else if (++ctrl->quiet_periods >= RTS_ADV_AUTO_QUIET_PERIODS) {
+		ctrl->quiet_periods = 0;
+		if (rts_advance > ctrl->min) {
+			rts_advance--;
+			LOGPPHL(plink, DL1C, LOGL_INFO, "No late DL prims, "
+				"decreasing rts-advance to %u\n", rts_advance);
+		}
+	}
+
+	/* the bounds may have been changed via the VTY */
+	plink->u.osmotrx.rts_advance = OSMO_MIN(OSMO_MAX(rts_advance, ctrl->min), ctrl->max);
 }
 
-/* schedule all frames of all TRX for given FN */
-static void bts_sched_fn(struct gsm_bts *bts, const uint32_t fn)
+/* run the 'rts-advance' control loop for all PHY links serving the given BTS */
+static void bts_sched_rts_advance_ctrl(struct gsm_bts *bts)
 {
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
+	const struct gsm_bts_trx *trx;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		struct phy_link *plink = trx->pinst->phy_link;
+
+		if (!plink->u.osmotrx.rts_advance_auto.enabled)
+			continue;
+		/* handle each PHY link only once, by its first PHY instance */
+		if (trx->pinst != llist_first_entry(&plink->instances, struct phy_instance, list))
+			continue;
+		phy_link_rts_advance_ctrl(plink, bts_trx->clk_s.proc_us_max);
+	}
+
+	bts_trx->clk_s.proc_us_max = 0;
+}
+
+/*! max. number of frames of RTS issued at once when the advance grows */
+#define RTS_FN_CATCH_UP_MAX	4
+
+/* RTS is requested at fn + fn-advance + rts-advance, so each step of the
+ * advance skips (+1) or repeats (-1) the RTS of one frame.  Return the
+ * number of frames to issue RTS for, starting at *rts_fn: the skipped ones
+ * are caught up, the repeated ones are left out. */
+static unsigned int pinst_rts_fn_range(struct phy_instance *pinst, uint32_t *rts_fn)
+{
+	uint32_t delta = GSM_TDMA_FN_SUB(*rts_fn, pinst->u.osmotrx.rts_fn_next);
+	unsigned int num = 1;
+
+	if (OSMO_UNLIKELY(!pinst->u.osmotrx.rts_fn_valid)) {
+		pinst->u.osmotrx.rts_fn_valid = true;
+	} else if (OSMO_UNLIKELY(delta != 0)) {
+		if (delta <= RTS_FN_CATCH_UP_MAX) {
+			/* the advance grew: catch up on the skipped frames */
+			*rts_fn = pinst->u.osmotrx.rts_fn_next;
+			num = delta + 1;
+		} else if (GSM_TDMA_FN_SUB(pinst->u.osmotrx.rts_fn_next, *rts_fn) <= RTS_FN_CATCH_UP_MAX) {
+			/* the advance shrunk: RTS has already been issued for this frame */
+			return 0;
+		}
+		/* else: the clock jumped, start over at the current frame */
+	}
+
+	pinst->u.osmotrx.rts_fn_next = GSM_TDMA_FN_SUM(*rts_fn, num);
+	return num;
+}
+
+/* schedule all frames of all TRX for given FN, return the processing time */
+static int64_t bts_sched_fn(struct gsm_bts *bts, const uint32_t fn)
+{
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
+	bool shed_stats = fn_budget_shed(&bts_trx->fn_budget, FN_BUDGET_STEP_STATS);
+	struct timespec tv_start, tv_done;
 	struct gsm_bts_trx *trx;
 	unsigned int tn;
+	int64_t proc_us;
 
-	/* Report interference measurements */
+	TRACE(OSMO_BTS_TRX_FN_SCHED_START(fn));
+	clock_gettime(CLOCK_MONOTONIC, &tv_start);
+
+	/* Report interference measurements (a few TS per frame) */
+	bts_report_interf_meas(bts, fn);
+
+	/* Adjust 'rts-advance' */
 	if (fn % 104 == 0) /* SACCH period */
-		bts_report_interf_meas(bts);
+		bts_sched_rts_advance_ctrl(bts);
+
+	/* Make the counts of the hot paths visible in the counter group */
+	if (fn % (shed_stats ? 204 : 51) == 0)
+		rate_ctr_shard_flush(bts_trx->ctrs_shard);
+
+	/* Pass the Uplink blocks of the last block period to the decoder threads */
+	trx_ul_decoder_flush();
 
 	/* send time indication */
 	l1if_mph_time_ind(bts, fn);
@@ -286,10 +572,17 @@ static void bts_sched_fn(struct gsm_bts *bts, const uint32_t fn)
 	llist_for_each_entry(trx, &bts->trx_list, list) {
 		const struct phy_link *plink = trx->pinst->phy_link;
 		struct trx_l1h *l1h = trx->pinst->u.osmotrx.hdl;
+		uint32_t rts_fn;
+		unsigned int rts_num, i;
 
 		/* we don't schedule, if power is off */
-		if (!trx_if_powered(l1h))
+		if (!trx_if_powered(l1h)) {
+			trx->pinst->u.osmotrx.rts_fn_valid = false;
 			continue;
+		}
+
+		rts_fn = GSM_TDMA_FN_SUM(fn, plink->u.osmotrx.clock_advance + plink->u.osmotrx.rts_advance);
+		rts_num = pinst_rts_fn_range(trx->pinst, &rts_fn);
 
 		/* process every TS of TRX */
 		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
@@ -298,10 +591,15 @@ static void bts_sched_fn(struct gsm_bts *bts, const uint32_t fn)
 			struct l1sched_ts *l1ts = ts->priv;
 			struct trx_dl_burst_req *br;
 
+			/* nothing to do on timeslots without active logical channels,
+			 * C0 has already been filled with dummy bursts */
+			if (~trx->l1sched_ts_active & (1 << tn))
+				continue;
+
 			/* ready-to-send */
 			TRACE(OSMO_BTS_TRX_DL_RTS_START(trx->nr, tn, fn));
-			_sched_rts(l1ts, GSM_TDMA_FN_SUM(fn, plink->u.osmotrx.clock_advance
-							   + plink->u.osmotrx.rts_advance));
+			for (i = 0; i < rts_num; i++)
+				_sched_rts(l1ts, GSM_TDMA_FN_SUM(rts_fn, i));
 			TRACE(OSMO_BTS_TRX_DL_RTS_DONE(trx->nr, tn, fn));
 
 			/* pre-initialized buffer for the Downlink burst */
@@ -316,16 +614,125 @@ static void bts_sched_fn(struct gsm_bts *bts, const uint32_t fn)
 				br = &pinst->u.osmotrx.br[tn];
 			}
 
+			TRACE(OSMO_BTS_TRX_DL_BURST_START(trx->nr, tn, fn));
+
 			/* get burst for the primary timeslot */
 			_sched_dl_burst(l1ts, br);
 
 			/* get burst for the shadow timeslot */
 			_sched_dl_shadow_burst(ts->vamos.peer, br);
+
+			TRACE(OSMO_BTS_TRX_DL_BURST_DONE(trx->nr, tn, fn));
 		}
 	}
 
 	/* Send everything to the PHY */
-	bts_sched_flush_buffers(bts);
+	bts_sched_flush_buffers(bts, fn);
+
+	/* Use the remaining time to pre-compute A5 keystream for the next frame */
+	bts_sched_a5_prefill(bts, fn);
+
+	clock_gettime(CLOCK_MONOTONIC, &tv_done);
+	proc_us = compute_elapsed_us(&tv_start, &tv_done);
+	trx_clk_hist_add(&bts_trx->clk_s.proc_time_hist, proc_us);
+	if (proc_us > bts_trx->clk_s.proc_us_max)
+		bts_trx->clk_s.proc_us_max = proc_us;
+	if (!shed_stats || fn % 26 == 0)
+		osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_FN_PROC_US),
+				   proc_us);
+
+	TRACE(OSMO_BTS_TRX_FN_SCHED_DONE(fn));
+
+	return proc_us;
+}
+
+bool trx_sched_ul_gated(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi,
+			const sbit_t *bits, size_t nbits, enum sched_meas_avg_mode mode)
+{
+	const struct phy_link *plink = l1ts->ts->trx->pinst->phy_link;
+	const struct gsm_bts *bts = l1ts->ts->trx->bts;
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) bts->model_priv;
+	struct l1sched_meas_set meas_avg;
+	unsigned int ctr;
+	size_t i;
+
+	if (OSMO_LIKELY(!plink->u.osmotrx.ul_decode_gate.erasures &&
+			!plink->u.osmotrx.ul_decode_gate.ci))
+		return false;
+
+	if (plink->u.osmotrx.ul_decode_gate.ci) {
+		trx_sched_meas_avg(&l1ts->chan_state[bi->chan], &meas_avg, mode);
+		if (meas_avg.ci_cb < plink->u.osmotrx.ul_decode_gate.ci_cb)
+			goto gated;
+	}
+
+	if (!plink->u.osmotrx.ul_decode_gate.erasures)
+		return false;
+
+	/* Only erasures: the decoder has nothing to work with */
+	for (i = 0; i < nbits; i++) {
+		if (bits[i] != 0)
+			return false;
+	}
+
+gated:
+	switch (bi->chan) {
+	case TRXC_TCHF:
+		ctr = BTSTRX_CTR_SCHED_UL_GATED_TCHF;
+		break;
+	case TRXC_TCHH_0:
+	case TRXC_TCHH_1:
+		ctr = BTSTRX_CTR_SCHED_UL_GATED_TCHH;
+		break;
+	case TRXC_PDTCH:
+		ctr = BTSTRX_CTR_SCHED_UL_GATED_PDTCH;
+		break;
+	default:
+		ctr = BTSTRX_CTR_SCHED_UL_GATED_XCCH;
+		break;
+	}
+	rate_ctr_shard_inc(priv->ctrs_shard, ctr);
+
+	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Not decoding the block, declaring it bad\n");
+	return true;
+}
+
+int trx_sched_ul_facch_pred(const struct l1sched_ts *l1ts, const sbit_t *bursts, bool half)
+{
+	const struct phy_link *plink = l1ts->ts->trx->pinst->phy_link;
+	int thresh = plink->u.osmotrx.ul_facch_steal_thresh;
+	int score;
+
+	if (OSMO_LIKELY(thresh == 0))
+		return 0;
+
+	score = tch_steal_score(bursts, half);
+	if (score > thresh)
+		return 1;
+	if (score < -thresh)
+		return -1;
+	return 0;
+}
+
+void trx_sched_ul_facch_result(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi,
+			       int pred, bool facch)
+{
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) l1ts->ts->trx->bts->model_priv;
+
+	if (OSMO_LIKELY(pred == 0 || (pred > 0) == facch))
+		return;
+
+	rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_FACCH_MISPREDICT);
+	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Stealing flags %s FACCH, but decoded %s\n",
+		pred > 0 ? "indicate" : "do not indicate", facch ? "FACCH" : "no FACCH");
+}
+
+void trx_sched_ul_facch_skipped(struct l1sched_ts *l1ts, const struct trx_ul_burst_ind *bi)
+{
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) l1ts->ts->trx->bts->model_priv;
+
+	rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_FACCH_SKIPPED);
+	LOGL1SB(DL1P, LOGL_DEBUG, l1ts, bi, "Stealing flags indicate no FACCH, not decoding it\n");
 }
 
 /* Find a route (TRX instance) for a given Uplink burst indication */
@@ -333,17 +740,14 @@ static struct gsm_bts_trx *ulfh_route_bi(const struct trx_ul_burst_ind *bi,
 					 const struct gsm_bts_trx *src_trx)
 {
 	struct gsm_bts_trx *trx;
-	struct gsm_time time;
 	uint16_t arfcn;
 
-	gsm_fn2gsmtime(&time, bi->fn);
-
 	llist_for_each_entry(trx, &src_trx->bts->trx_list, list) {
 		const struct gsm_bts_trx_ts *ts = &trx->ts[bi->tn];
 		if (!ts->hopping.enabled)
 			continue;
 
-		arfcn = gsm0502_hop_seq_gen(&time, SCHED_FH_PARAMS_VALS(ts), ts->hopping.arfcn_list);
+		arfcn = ts->hopping.arfcn_list[sched_fh_mai(ts, bi->fn)];
 		if (src_trx->arfcn == arfcn)
 			return trx;
 	}
@@ -353,7 +757,7 @@ static struct gsm_bts_trx *ulfh_route_bi(const struct trx_ul_burst_ind *bi,
 		bi->fn, bi->tn, SCHED_FH_PARAMS_VALS(&src_trx->ts[bi->tn]));
 
 	struct bts_trx_priv *priv = (struct bts_trx_priv *) src_trx->bts->model_priv;
-	rate_ctr_inc2(priv->ctrs, BTSTRX_CTR_SCHED_UL_FH_NO_CARRIER);
+	rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_SCHED_UL_FH_NO_CARRIER);
 
 	return NULL;
 }
@@ -377,15 +781,6 @@ int trx_sched_route_burst_ind(const struct gsm_bts_trx *trx, struct trx_ul_burst
 /*! maximum number of frame periods we can tolerate without TRX Clock Indication*/
 #define TRX_LOSS_FRAMES		400
 
-/*! compute the number of micro-seconds difference elapsed between \a last and \a now */
-static inline int64_t compute_elapsed_us(const struct timespec *last, const struct timespec *now)
-{
-	struct timespec elapsed;
-
-	timespecsub(now, last, &elapsed);
-	return (int64_t)(elapsed.tv_sec * 1000000) + (elapsed.tv_nsec / 1000);
-}
-
 /*! compute the number of frame number intervals elapsed between \a last and \a now */
 static inline int compute_elapsed_fn(const uint32_t last, const uint32_t now)
 {
@@ -395,6 +790,15 @@ static inline int compute_elapsed_fn(const uint32_t last, const uint32_t now)
 	return elapsed_fn;
 }
 
+/*! limit of the estimated clock rate error (ppb) */
+#define TRX_CLK_EST_MAX_PPB	200000
+/*! CLOCK indications over which the drift estimate is averaged */
+#define TRX_CLK_EST_AVG		16
+/*! phase error corrected per CLOCK indication period: 1 / TRX_CLK_EST_PHASE_DIV */
+#define TRX_CLK_EST_PHASE_DIV	4
+/*! limit of the FN timer interval correction per frame: 1 / TRX_CLK_EST_CORR_DIV */
+#define TRX_CLK_EST_CORR_DIV	100
+
 /*! normalise given 'struct timespec', i.e. carry nanoseconds into seconds */
 static inline void normalize_timespec(struct timespec *ts)
 {
@@ -403,6 +807,91 @@ static inline void normalize_timespec(struct timespec *ts)
 }
 
 /*! this is the timerfd-callback firing for every FN to be processed */
+/* Low priority work gets what is left of the frame after the processing,
+ * minus a margin for the TRXD and Abis handling, but no more than a cap */
+#define TRX_SLACK_MARGIN_US	1000
+#define TRX_SLACK_CAP_US	1500
+
+/* Encode the xCCH blocks starting in the next frames (their prims are queued
+ * 'rts-advance' frames ahead), so that a frame carrying the block boundaries
+ * of many channels does not take much longer than the frames in between.
+ * The earliest blocks go first, until the budget is used up; the others are
+ * encoded in a later frame or by tx_data_fn() as usual.
+ * \param[in] fn the TDMA frame just processed by bts_sched_fn()
+ * \returns time spent (us) */
+static int64_t bts_sched_dl_encode_ahead(struct gsm_bts *bts, const uint32_t fn, int64_t budget_us)
+{
+	const struct gsm_bts_trx *trx;
+	struct timespec tv_start, tv_now;
+	unsigned int ahead, tn;
+	int64_t spent_us = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &tv_start);
+
+	for (ahead = 1; ahead < L1SCHED_DL_AHEAD_LEN; ahead++) {
+		llist_for_each_entry(trx, &bts->trx_list, list) {
+			const struct phy_link *plink = trx->pinst->phy_link;
+			struct trx_l1h *l1h = trx->pinst->u.osmotrx.hdl;
+			uint32_t dl_fn;
+
+			if (!plink->u.osmotrx.dl_encode_ahead || ahead > plink->u.osmotrx.rts_advance)
+				continue;
+			if (!trx_if_powered(l1h))
+				continue;
+
+			dl_fn = GSM_TDMA_FN_SUM(fn, plink->u.osmotrx.clock_advance + ahead);
+
+			for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+				struct l1sched_ts *l1ts = trx->ts[tn].priv;
+				const struct l1sched_dl_frame *frame;
+
+				if (~trx->l1sched_ts_active & (1 << tn))
+					continue;
+
+				frame = &l1ts->mf_dl[dl_fn % l1ts->mf_period];
+				if (frame->dl_fn != tx_data_fn || frame->bid != 0 || !frame->chan_state->active)
+					continue;
+				if (!tx_data_encode_ahead(l1ts, frame->chan, dl_fn))
+					continue;
+
+				clock_gettime(CLOCK_MONOTONIC, &tv_now);
+				spent_us = compute_elapsed_us(&tv_start, &tv_now);
+				if (spent_us >= budget_us)
+					return spent_us;
+			}
+		}
+	}
+
+	return spent_us;
+}
+
+/* run slack tasks until shortly before the next FN timer expiry
+ * \param[in] tv_timer time the current FN timer expiry was handled
+ * \param[in] error_us lateness of the current FN timer expiry */
+static void trx_sched_slack(struct gsm_bts *bts, const struct timespec *tv_timer, int64_t error_us)
+{
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
+	struct timespec tv_now;
+	int64_t budget_us;
+	unsigned int num, late;
+
+	clock_gettime(CLOCK_MONOTONIC, &tv_now);
+	budget_us = GSM_TDMA_FN_DURATION_uS - OSMO_MAX(error_us, 0) - compute_elapsed_us(tv_timer, &tv_now)
+		    - TRX_SLACK_MARGIN_US;
+	budget_us = OSMO_MIN(budget_us, TRX_SLACK_CAP_US);
+
+	/* the next frames come first, then the housekeeping */
+	if (budget_us > 0)
+		budget_us -= bts_sched_dl_encode_ahead(bts, bts_trx->clk_s.last_fn_timer.fn, budget_us);
+
+	num = slack_task_run(budget_us, &late);
+	if (OSMO_LIKELY(num == 0))
+		return;
+	rate_ctr_add2(bts_trx->ctrs, BTSTRX_CTR_SLACK_TASK_RUN, num);
+	if (late > 0)
+		rate_ctr_add2(bts_trx->ctrs, BTSTRX_CTR_SLACK_TASK_LATE, late);
+}
+
 static int trx_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 {
 	struct gsm_bts *bts = ofd->data;
@@ -410,7 +899,7 @@ static int trx_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
 	struct timespec tv_now;
 	uint64_t expire_count;
-	int64_t elapsed_us, error_us;
+	int64_t elapsed_us, error_us, proc_us = 0;
 	int rc, i;
 
 	if (!(what & OSMO_FD_READ))
@@ -444,6 +933,11 @@ static int trx_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 #endif
 	tcs->last_fn_timer.tv = tv_now;
 
+	trx_clk_hist_add(&tcs->sched_err_hist, error_us);
+	if (!fn_budget_shed(&bts_trx->fn_budget, FN_BUDGET_STEP_STATS) || tcs->last_fn_timer.fn % 26 == 0)
+		osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_FN_TIMER_ERROR_US),
+				   error_us);
+
 	/* if someone played with clock, or if the process stalled */
 	if (elapsed_us > GSM_TDMA_FN_DURATION_uS * MAX_FN_SKEW || elapsed_us < 0) {
 		LOGP(DL1C, LOGL_ERROR, "PC clock skew: elapsed_us=%" PRId64 ", error_us=%" PRId64 "\n",
@@ -453,12 +947,18 @@ static int trx_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 
 	/* call bts_sched_fn() for all expired FN */
 	for (i = 0; i < expire_count; i++)
-		bts_sched_fn(bts, GSM_TDMA_FN_INC(tcs->last_fn_timer.fn));
+		proc_us += bts_sched_fn(bts, GSM_TDMA_FN_INC(tcs->last_fn_timer.fn));
+
+	/* the frame load is the processing time plus the lateness of the timer */
+	fn_budget_feed(bts, proc_us + OSMO_MAX(error_us, 0), expire_count - 1);
+
+	trx_sched_slack(bts, &tv_now, error_us);
 
 	return 0;
 
 no_clock:
 	osmo_timerfd_disable(&tcs->fn_timer_ofd);
+	slack_task_set_driven(false);
 	bts_shutdown(bts, "No clock from osmo-trx");
 	return -1;
 }
@@ -505,10 +1005,65 @@ int trx_sched_clock_stopped(struct gsm_bts *bts)
 
 	LOGP(DL1C, LOGL_NOTICE, "GSM clock stopped\n");
 	osmo_fd_close(&tcs->fn_timer_ofd);
+	slack_task_set_driven(false);
 
 	return 0;
 }
 
+/*! update the frame clock estimator with a CLOCK indication and derive the
+ *  FN timer interval from it.
+ *  \param[in] elapsed_fn frames since the previous CLOCK indication
+ *  \param[in] error_us local time since the previous CLOCK indication minus
+ *  the duration of elapsed_fn frames
+ *  \param[in] phase_us how far the TRX clock is ahead of the FN timer
+ *  \returns the FN timer interval to use (ns) */
+static int64_t trx_clk_est_update(struct bts_trx_priv *bts_trx, int64_t elapsed_fn,
+				  int64_t error_us, int64_t phase_us)
+{
+	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
+	int64_t expected_us, sample_ppb, resid_us, corr_ns, max_corr_ns;
+
+	/* The first CLOCK indication, or one after a gap: nothing to compare */
+	if (elapsed_fn <= 0 || elapsed_fn > MAX_FN_SKEW * TRX_CLK_EST_AVG)
+		goto out;
+
+	expected_us = elapsed_fn * GSM_TDMA_FN_DURATION_uS;
+	sample_ppb = error_us * 1000000000 / expected_us;
+
+	if (!tcs->est.valid) {
+		tcs->est.valid = true;
+		tcs->est.drift_ppb = sample_ppb;
+	} else {
+		/* RFC 3550 style jitter of the error against the estimate */
+		resid_us = error_us - tcs->est.drift_ppb * expected_us / 1000000000;
+		if (resid_us < 0)
+			resid_us = -resid_us;
+		tcs->est.jitter_us16 += resid_us - ((tcs->est.jitter_us16 + 8) >> 4);
+		tcs->est.drift_ppb += (sample_ppb - tcs->est.drift_ppb) / TRX_CLK_EST_AVG;
+	}
+
+	tcs->est.drift_ppb = OSMO_MAX(-TRX_CLK_EST_MAX_PPB,
+				      OSMO_MIN(tcs->est.drift_ppb, TRX_CLK_EST_MAX_PPB));
+
+	osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_CLK_DRIFT_PPB),
+			   tcs->est.drift_ppb);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_CLK_JITTER_US),
+			   tcs->est.jitter_us16 >> 4);
+
+out:
+	/* Follow the rate of the TRX clock, and pull in a part of the phase
+	 * error until the next CLOCK indication (expected after as many frames
+	 * as since the previous one). */
+	corr_ns = GSM_TDMA_FN_DURATION_nS * tcs->est.drift_ppb / 1000000000;
+	if (elapsed_fn > 0)
+		corr_ns -= phase_us * 1000 / (elapsed_fn * TRX_CLK_EST_PHASE_DIV);
+	max_corr_ns = GSM_TDMA_FN_DURATION_nS / TRX_CLK_EST_CORR_DIV;
+	corr_ns = OSMO_MAX(-max_corr_ns, OSMO_MIN(corr_ns, max_corr_ns));
+
+	tcs->est.interval_ns = GSM_TDMA_FN_DURATION_nS + corr_ns;
+	return tcs->est.interval_ns;
+}
+
 /*! reset clock with current fn and schedule it. Called when trx becomes
  *  available or when max clock skew is reached */
 static int trx_setup_clock(struct gsm_bts *bts, struct osmo_trx_clock_state *tcs,
@@ -517,6 +1072,8 @@ static int trx_setup_clock(struct gsm_bts *bts, struct osmo_trx_clock_state *tcs
 	/* schedule first FN clock timer */
 	osmo_timerfd_setup(&tcs->fn_timer_ofd, trx_fn_timer_cb, bts);
 	osmo_timerfd_schedule(&tcs->fn_timer_ofd, NULL, interval);
+	/* from now on, the slack tasks are run after each frame */
+	slack_task_set_driven(true);
 
 	tcs->last_fn_timer.fn = fn;
 	tcs->last_fn_timer.tv = *tv_now;
@@ -531,11 +1088,13 @@ int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
 {
 	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)bts->model_priv;
 	struct osmo_trx_clock_state *tcs = &bts_trx->clk_s;
+	const struct phy_link *plink = bts->c0->pinst->phy_link;
 	struct timespec tv_now;
 	int elapsed_fn;
 	int64_t elapsed_us, elapsed_us_since_clk, elapsed_fn_since_clk, error_us_since_clk;
+	int64_t phase_us;
 	unsigned int fn_caught_up = 0;
-	const struct timespec interval = { .tv_sec = 0, .tv_nsec = GSM_TDMA_FN_DURATION_nS };
+	struct timespec interval = { .tv_sec = 0, .tv_nsec = GSM_TDMA_FN_DURATION_nS };
 
 	/* reset lost counter */
 	tcs->fn_without_clock_ind = 0;
@@ -563,10 +1122,12 @@ int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
 		"elapsed_fn=%3"PRId64", error_us=%+5"PRId64"\n",
 		elapsed_us_since_clk, elapsed_fn_since_clk, error_us_since_clk);
 
-	/* TODO: put this computed error_us_since_clk into some filter
-	 * function and use that to adjust our regular timer interval to
-	 * compensate for clock drift between the PC clock and the
-	 * TRX/SDR clock */
+	phase_us = elapsed_fn * GSM_TDMA_FN_DURATION_uS - elapsed_us;
+
+	/* Adjust the FN timer interval to the rate of the TRX clock */
+	if (plink->u.osmotrx.clock_filter)
+		interval.tv_nsec = trx_clk_est_update(bts_trx, elapsed_fn_since_clk,
+						      error_us_since_clk, phase_us);
 
 	tcs->last_clk_ind.tv = tv_now;
 	tcs->last_clk_ind.fn = fn;
@@ -579,7 +1140,18 @@ int trx_sched_clock(struct gsm_bts *bts, uint32_t fn)
 	}
 
 	LOGP(DL1C, LOGL_INFO, "GSM clock jitter: %" PRId64 "us (elapsed_fn=%d)\n",
-		elapsed_fn * GSM_TDMA_FN_DURATION_uS - elapsed_us, elapsed_fn);
+		phase_us, elapsed_fn);
+
+	/* With the filter, a phase error of up to one frame is only pulled in
+	 * by the interval correction, instead of a hard resync */
+	if (plink->u.osmotrx.clock_filter && elapsed_fn >= -1 && elapsed_fn <= 1) {
+		struct timespec first = { .tv_sec = 0 };
+
+		/* Keep the phase of the FN timer, but apply the new interval */
+		first.tv_nsec = OSMO_MAX(interval.tv_nsec - elapsed_us * 1000, 1000);
+		osmo_timerfd_schedule(&tcs->fn_timer_ofd, &first, &interval);
+		return 0;
+	}
 
 	/* too many frames have been processed already */
 	if (elapsed_fn < 0) {
@@ -618,92 +1190,3 @@ void _sched_act_rach_det(struct gsm_bts_trx *trx, uint8_t tn, uint8_t ss, int ac
 	else
 		trx_if_cmd_nohandover(l1h, tn, ss);
 }
-
-/* Add a set of UL burst measurements to the history */
-void trx_sched_meas_push(struct l1sched_chan_state *chan_state,
-			 const struct trx_ul_burst_ind *bi)
-{
-	unsigned int hist_size = ARRAY_SIZE(chan_state->meas.buf);
-	unsigned int current = chan_state->meas.current;
-
-	chan_state->meas.buf[current] = (struct l1sched_meas_set) {
-		.fn = bi->fn,
-		.ci_cb = (bi->flags & TRX_BI_F_CI_CB) ? bi->ci_cb : 0,
-		.toa256 = bi->toa256,
-		.rssi = bi->rssi,
-	};
-
-	chan_state->meas.current = (current + 1) % hist_size;
-}
-
-/* Measurement averaging mode sets: [MODE] = { SHIFT, NUM } */
-static const uint8_t trx_sched_meas_modeset[][2] = {
-	[SCHED_MEAS_AVG_M_S24N22] = { 24, 22 },
-	[SCHED_MEAS_AVG_M_S22N22] = { 22, 22 },
-	[SCHED_MEAS_AVG_M_S4N4] = { 4, 4 },
-	[SCHED_MEAS_AVG_M_S8N8] = { 8, 8 },
-	[SCHED_MEAS_AVG_M_S6N4] = { 6, 4 },
-	[SCHED_MEAS_AVG_M_S6N6] = { 6, 6 },
-	[SCHED_MEAS_AVG_M_S8N4] = { 8, 4 },
-	[SCHED_MEAS_AVG_M_S6N2] = { 6, 2 },
-	[SCHED_MEAS_AVG_M_S4N2] = { 4, 2 },
-};
-
-/* Calculate the AVG of n measurements from the history */
-void trx_sched_meas_avg(const struct l1sched_chan_state *chan_state,
-			struct l1sched_meas_set *avg,
-			enum sched_meas_avg_mode mode)
-{
-	unsigned int hist_size = ARRAY_SIZE(chan_state->meas.buf);
-	unsigned int current = chan_state->meas.current;
-	const struct l1sched_meas_set *set;
-	unsigned int pos, i;
-
-	float rssi_sum = 0;
-	int toa256_sum = 0;
-	int ci_cb_sum = 0;
-
-	const unsigned int shift = trx_sched_meas_modeset[mode][0];
-	const unsigned int num = trx_sched_meas_modeset[mode][1];
-
-	/* Calculate the sum of n entries starting from pos */
-	for (i = 0; i < num; i++) {
-		pos = (current + hist_size - shift + i) % hist_size;
-		set = &chan_state->meas.buf[pos];
-
-		rssi_sum   += set->rssi;
-		toa256_sum += set->toa256;
-		ci_cb_sum  += set->ci_cb;
-	}
-
-	/* First sample contains TDMA frame number of the first burst */
-	pos = (current + hist_size - shift) % hist_size;
-	set = &chan_state->meas.buf[pos];
-
-	/* Calculate the average for each value */
-	*avg = (struct l1sched_meas_set) {
-		.fn     = set->fn, /* first burst */
-		.rssi   = (rssi_sum   / num),
-		.toa256 = (toa256_sum / num),
-		.ci_cb  = (ci_cb_sum  / num),
-	};
-
-	LOGP(DMEAS, LOGL_DEBUG, "%s%sMeasurement AVG (num=%u, shift=%u): "
-	     "RSSI %f, ToA256 %d, C/I %d cB\n",
-	     chan_state->lchan ? gsm_lchan_name(chan_state->lchan) : "",
-	     chan_state->lchan ? " " : "",
-	     num, shift, avg->rssi, avg->toa256, avg->ci_cb);
-}
-
-/* Lookup TDMA frame number of the N-th sample in the history */
-uint32_t trx_sched_lookup_fn(const struct l1sched_chan_state *chan_state,
-			     const unsigned int shift)
-{
-	const unsigned int hist_size = ARRAY_SIZE(chan_state->meas.buf);
-	const unsigned int current = chan_state->meas.current;
-	unsigned int pos;
-
-	/* First sample contains TDMA frame number of the first burst */
-	pos = (current + hist_size - shift) % hist_size;
-	return chan_state->meas.buf[pos].fn;
-}
@@ -0,0 +1,275 @@
+/* Capturing of TRXD datagrams into a memory mapped ring file */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The capture is written on the main thread, right where the datagrams
+ * are received from or sent to the socket.  Writing a record is a memcpy()
+ * into the shared mapping, the kernel takes care of the write-back, so
+ * there is no file I/O on the per-burst path.  The file remains usable
+ * if osmo-bts-trx is killed: the header is updated with every record.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+
+#include "trx_capture.h"
+
+#define CAP_ALIGN(len) \
+	(((len) + TRX_CAPTURE_ALIGN - 1) & ~((uint64_t) TRX_CAPTURE_ALIGN - 1))
+#define CAP_HDR_LEN \
+	CAP_ALIGN(sizeof(struct trx_capture_file_hdr))
+/* Enough for a few of the largest possible datagrams */
+#define CAP_MIN_RING_LEN \
+	(4 * CAP_ALIGN(sizeof(struct trx_capture_rec) + UINT16_MAX))
+
+struct trx_capture {
+	int fd;
+	uint8_t *map;
+	size_t map_len;
+	struct trx_capture_file_hdr *hdr;
+	uint8_t *ring;
+};
+
+static uint64_t cap_ts_ns(clockid_t clk_id)
+{
+	struct timespec ts;
+
+	clock_gettime(clk_id, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int cap_destructor(struct trx_capture *cap)
+{
+	if (cap->map != NULL) {
+		msync(cap->map, cap->map_len, MS_ASYNC);
+		munmap(cap->map, cap->map_len);
+	}
+	if (cap->fd >= 0)
+		close(cap->fd);
+	return 0;
+}
+
+/*! start capturing into a (new) file of the given size
+ *  \param[in] ctx talloc context to allocate from
+ *  \param[in] path name of the file (truncated if it exists)
+ *  \param[in] size total size of the file in bytes
+ *  \param[in] clock_advance configured 'osmotrx fn-advance' (for the replay tool)
+ *  \returns capture state on success; NULL on error (errno is set) */
+struct trx_capture *trx_capture_start(void *ctx, const char *path, size_t size,
+				      uint32_t clock_advance)
+{
+	struct trx_capture *cap;
+	uint64_t ring_len;
+	int err;
+
+	if (size < CAP_HDR_LEN + CAP_MIN_RING_LEN) {
+		errno = EINVAL;
+		return NULL;
+	}
+	/* Round down to the record alignment */
+	ring_len = (size & ~((uint64_t) TRX_CAPTURE_ALIGN - 1)) - CAP_HDR_LEN;
+
+	cap = talloc_zero(ctx, struct trx_capture);
+	if (cap == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	cap->fd = -1;
+	talloc_set_destructor(cap, cap_destructor);
+
+	cap->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (cap->fd < 0)
+		goto err;
+
+	cap->map_len = CAP_HDR_LEN + ring_len;
+	if (ftruncate(cap->fd, cap->map_len) != 0)
+		goto err;
+
+	cap->map = mmap(NULL, cap->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, cap->fd, 0);
+	if (cap->map == MAP_FAILED) {
+		cap->map = NULL;
+		goto err;
+	}
+
+	cap->hdr = (struct trx_capture_file_hdr *) cap->map;
+	cap->ring = cap->map + CAP_HDR_LEN;
+
+	*cap->hdr = (struct trx_capture_file_hdr) {
+		.magic = TRX_CAPTURE_MAGIC,
+		.version = TRX_CAPTURE_VERSION,
+		.hdr_len = CAP_HDR_LEN,
+		.ring_len = ring_len,
+		.start_ts_ns = cap_ts_ns(CLOCK_REALTIME),
+		.clock_advance = clock_advance,
+	};
+
+	return cap;
+
+err:
+	err = errno;
+	talloc_free(cap);
+	errno = err;
+	return NULL;
+}
+
+/*! stop capturing, flush and close the file */
+void trx_capture_stop(struct trx_capture *cap)
+{
+	talloc_free(cap);
+}
+
+/*! get the (live) header of a capture file */
+const struct trx_capture_file_hdr *trx_capture_hdr(const struct trx_capture *cap)
+{
+	return cap->hdr;
+}
+
+/* Drop the oldest records until there are at least 'need' free bytes.  The
+ * free space following the head is always contiguous up to the tail, or
+ * up to the end of the ring if it did not wrap yet. */
+static void cap_evict(struct trx_capture *cap, uint64_t need)
+{
+	struct trx_capture_file_hdr *hdr = cap->hdr;
+
+	while (hdr->ring_len - hdr->used < need) {
+		const struct trx_capture_rec *rec;
+
+		rec = (const struct trx_capture_rec *) &cap->ring[hdr->tail];
+		hdr->tail += rec->rec_len;
+		if (hdr->tail >= hdr->ring_len)
+			hdr->tail = 0;
+		hdr->used -= rec->rec_len;
+	}
+}
+
+/*! append a datagram to the capture ring, overwriting the oldest records if needed
+ *  \param[in] cap capture state
+ *  \param[in] dir direction of the datagram
+ *  \param[in] phy_inst number of the PHY instance
+ *  \param[in] buf the datagram
+ *  \param[in] len length of the datagram */
+void trx_capture_write(struct trx_capture *cap, enum trx_capture_dir dir,
+		       uint8_t phy_inst, const uint8_t *buf, size_t len)
+{
+	struct trx_capture_file_hdr *hdr = cap->hdr;
+	uint64_t rec_len = CAP_ALIGN(sizeof(struct trx_capture_rec) + len);
+	struct trx_capture_rec *rec;
+
+	if (OSMO_UNLIKELY(len > UINT16_MAX || rec_len > hdr->ring_len))
+		return;
+
+	/* Not enough room before the end: pad and wrap around.  Both the
+	 * head and the ring length are aligned, so a pad record always fits. */
+	if (hdr->head + rec_len > hdr->ring_len) {
+		uint64_t pad = hdr->ring_len - hdr->head;
+
+		cap_evict(cap, pad);
+		rec = (struct trx_capture_rec *) &cap->ring[hdr->head];
+		*rec = (struct trx_capture_rec) {
+			.rec_len = pad,
+			.dir = TRX_CAPTURE_PAD,
+		};
+		hdr->used += pad;
+		hdr->head = 0;
+	}
+
+	cap_evict(cap, rec_len);
+
+	rec = (struct trx_capture_rec *) &cap->ring[hdr->head];
+	*rec = (struct trx_capture_rec) {
+		.rec_len = rec_len,
+		.len = len,
+		.dir = dir,
+		.phy_inst = phy_inst,
+		.ts_ns = cap_ts_ns(CLOCK_MONOTONIC),
+	};
+	memcpy(rec->data, buf, len);
+
+	hdr->head += rec_len;
+	if (hdr->head >= hdr->ring_len)
+		hdr->head = 0;
+	hdr->used += rec_len;
+	hdr->num_recs++;
+}
+
+/*! prepare iterating over the records of a mapped capture file
+ *  \param[out] it iterator state
+ *  \param[in] map start of the mapped file
+ *  \param[in] map_len length of the mapped file
+ *  \returns 0 on success; negative on error (not a capture file) */
+int trx_capture_iter_init(struct trx_capture_iter *it, const void *map, size_t map_len)
+{
+	const struct trx_capture_file_hdr *hdr = map;
+
+	if (map_len < sizeof(*hdr))
+		return -EINVAL;
+	if (hdr->magic != TRX_CAPTURE_MAGIC || hdr->version != TRX_CAPTURE_VERSION)
+		return -EINVAL;
+	if (hdr->hdr_len + hdr->ring_len > map_len)
+		return -EINVAL;
+	if (hdr->tail >= hdr->ring_len || hdr->used > hdr->ring_len)
+		return -EINVAL;
+
+	*it = (struct trx_capture_iter) {
+		.hdr = hdr,
+		.ring = (const uint8_t *) map + hdr->hdr_len,
+		.off = hdr->tail,
+		.left = hdr->used,
+	};
+
+	return 0;
+}
+
+/*! get the next record (oldest first)
+ *  \returns the record; NULL when done or when the ring is corrupted */
+const struct trx_capture_rec *trx_capture_iter_next(struct trx_capture_iter *it)
+{
+	const struct trx_capture_rec *rec;
+
+	while (it->left > 0) {
+		rec = (const struct trx_capture_rec *) &it->ring[it->off];
+		if (rec->rec_len < sizeof(*rec) || rec->rec_len % TRX_CAPTURE_ALIGN)
+			return NULL;
+		if (rec->rec_len > it->left || it->off + rec->rec_len > it->hdr->ring_len)
+			return NULL;
+		if (sizeof(*rec) + rec->len > rec->rec_len)
+			return NULL;
+
+		it->off += rec->rec_len;
+		if (it->off >= it->hdr->ring_len)
+			it->off = 0;
+		it->left -= rec->rec_len;
+
+		if (rec->dir != TRX_CAPTURE_PAD)
+			return rec;
+	}
+
+	return NULL;
+}
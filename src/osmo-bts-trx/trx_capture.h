@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* On-disk format of a TRXD capture file, see 'phy N capture start'.
+ *
+ * The file consists of a header followed by a ring of variable length
+ * records, each containing one raw TRXD datagram as it was received from
+ * or sent to the transceiver.  Once the ring is full, the oldest records
+ * are overwritten.  All fields are in host byte order. */
+
+#define TRX_CAPTURE_MAGIC	0x44585254	/* "TRXD" */
+#define TRX_CAPTURE_VERSION	1
+#define TRX_CAPTURE_ALIGN	16
+
+enum trx_capture_dir {
+	TRX_CAPTURE_PAD		= 0,	/* padding up to the end of the ring */
+	TRX_CAPTURE_UL		= 1,	/* TRX -> BTS (trx_data_read_cb()) */
+	TRX_CAPTURE_DL		= 2,	/* BTS -> TRX (trx_if_send_burst()) */
+};
+
+struct trx_capture_file_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t hdr_len;	/* offset of the ring in the file */
+	uint64_t ring_len;	/* size of the ring in bytes */
+	uint64_t head;		/* ring offset of the next record to be written */
+	uint64_t tail;		/* ring offset of the oldest record */
+	uint64_t used;		/* number of occupied bytes in the ring */
+	uint64_t num_recs;	/* total number of records ever written */
+	uint64_t start_ts_ns;	/* CLOCK_REALTIME when the capture was started */
+	uint32_t clock_advance;	/* 'osmotrx fn-advance' at the time of capture */
+	uint32_t spare;
+} __attribute__((packed));
+
+struct trx_capture_rec {
+	uint32_t rec_len;	/* length of the record incl. header and padding */
+	uint16_t len;		/* length of the datagram */
+	uint8_t dir;		/* enum trx_capture_dir */
+	uint8_t phy_inst;	/* number of the PHY instance (i.e. the TRX) */
+	uint64_t ts_ns;		/* CLOCK_MONOTONIC timestamp */
+	uint8_t data[0];
+} __attribute__((packed));
+
+struct trx_capture;
+
+struct trx_capture *trx_capture_start(void *ctx, const char *path, size_t size,
+				      uint32_t clock_advance);
+void trx_capture_stop(struct trx_capture *cap);
+void trx_capture_write(struct trx_capture *cap, enum trx_capture_dir dir,
+		       uint8_t phy_inst, const uint8_t *buf, size_t len);
+const struct trx_capture_file_hdr *trx_capture_hdr(const struct trx_capture *cap);
+
+/* Iterate over the records of a mapped capture file, oldest first */
+struct trx_capture_iter {
+	const struct trx_capture_file_hdr *hdr;
+	const uint8_t *ring;
+	uint64_t off;
+	uint64_t left;		/* number of bytes not yet visited */
+};
+
+int trx_capture_iter_init(struct trx_capture_iter *it, const void *map, size_t map_len);
+const struct trx_capture_rec *trx_capture_iter_next(struct trx_capture_iter *it);
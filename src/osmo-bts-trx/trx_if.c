@@ -26,6 +26,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE /* recvmmsg() */
+
 #include <stdio.h>
 #include <stdint.h>
 #include <unistd.h>
@@ -34,10 +36,18 @@
 #include <string.h>
 
 #include <netinet/in.h>
+#include <sys/socket.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include <osmocom/core/select.h>
 #include <osmocom/core/socket.h>
 #include <osmocom/core/timer.h>
+#include <osmocom/core/timer_compat.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/bits.h>
 #include <osmocom/core/fsm.h>
@@ -46,23 +56,13 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/scheduler.h>
+#include <osmo-bts/trace.h>
 
 #include "l1_if.h"
 #include "trx_if.h"
 #include "trx_provision_fsm.h"
-
-#include "btsconfig.h"
-
-#ifdef HAVE_SYSTEMTAP
-/* include the generated probes header and put markers in code */
-#include "probes.h"
-#define TRACE(probe) probe
-#define TRACE_ENABLED(probe) probe ## _ENABLED()
-#else
-/* Wrap the probe to allow it to be removed when no systemtap available */
-#define TRACE(probe)
-#define TRACE_ENABLED(probe) (0)
-#endif /* HAVE_SYSTEMTAP */
+#include "trx_capture.h"
+#include "cpu_placement.h"
 
 /*
  * socket helper functions
@@ -117,9 +117,8 @@ static int trx_clk_read_cb(struct osmo_fd *ofd, unsigned int what)
 
 	len = recv(ofd->fd, buf, sizeof(buf) - 1, 0);
 	if (len <= 0) {
-		strerror_r(errno, (char *)buf, sizeof(buf));
 		LOGPPHI(pinst, DTRX, LOGL_ERROR,
-			"recv() failed on TRXD with rc=%zd (%s)\n", len, buf);
+			"recv() failed on TRXD with rc=%zd (%s)\n", len, strerror(errno));
 		return len;
 	}
 	buf[len] = '\0';
@@ -158,19 +157,24 @@ static int trx_clk_read_cb(struct osmo_fd *ofd, unsigned int what)
  * TRX ctrl socket
  */
 
-/* send first ctrl message and start timer */
-static void trx_ctrl_send(struct trx_l1h *l1h)
+/* Whether the given command must be the only one in flight.  POWERON and
+ * POWEROFF change the transceiver state, and a transceiver not supporting
+ * SETFORMAT replies with a generic 'RSP ERR 1', which can only be matched
+ * if SETFORMAT is the only command in flight. */
+static bool trx_ctrl_msg_is_barrier(const struct trx_ctrl_msg *tcm)
+{
+	return !strcmp(tcm->cmd, "POWERON") ||
+	       !strcmp(tcm->cmd, "POWEROFF") ||
+	       !strcmp(tcm->cmd, "SETFORMAT");
+}
+
+/* send a single ctrl message */
+static void trx_ctrl_send_msg(struct trx_l1h *l1h, const struct trx_ctrl_msg *tcm)
 {
-	struct trx_ctrl_msg *tcm;
 	char buf[TRXC_MSG_BUF_SIZE];
 	int len;
 	ssize_t snd_len;
 
-	/* get first command */
-	if (llist_empty(&l1h->trx_ctrl_list))
-		return;
-	tcm = llist_entry(l1h->trx_ctrl_list.next, struct trx_ctrl_msg, list);
-
 	len = snprintf(buf, sizeof(buf), "CMD %s%s%s", tcm->cmd, tcm->params_len ? " ":"", tcm->params);
 	OSMO_ASSERT(len < sizeof(buf));
 
@@ -178,16 +182,45 @@ static void trx_ctrl_send(struct trx_l1h *l1h)
 	/* send command */
 	snd_len = send(l1h->trx_ofd_ctrl.fd, buf, len+1, 0);
 	if (snd_len <= 0) {
-		strerror_r(errno, (char *)buf, sizeof(buf));
 		LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
-			"send() failed on TRXC with rc=%zd (%s)\n", snd_len, buf);
+			"send() failed on TRXC with rc=%zd (%s)\n", snd_len, strerror(errno));
+	}
+}
+
+/* send pending ctrl message(s) as allowed by the window and start timer */
+static void trx_ctrl_send(struct trx_l1h *l1h)
+{
+	const struct phy_link *plink = l1h->phy_inst->phy_link;
+	const unsigned int window = OSMO_MAX(plink->u.osmotrx.trxc_window, 1);
+	struct trx_ctrl_msg *tcm, *head;
+	unsigned int i = 0;
+	bool sent = false;
+
+	if (llist_empty(&l1h->trx_ctrl_list))
+		return;
+	head = llist_entry(l1h->trx_ctrl_list.next, struct trx_ctrl_msg, list);
+
+	/* the first trx_ctrl_inflight messages of the queue have been sent already */
+	llist_for_each_entry(tcm, &l1h->trx_ctrl_list, list) {
+		if (i++ < l1h->trx_ctrl_inflight)
+			continue;
+		if (l1h->trx_ctrl_inflight >= window)
+			break;
+		/* barriers are sent alone, and nothing is sent after them until acked */
+		if (l1h->trx_ctrl_inflight > 0 &&
+		    (trx_ctrl_msg_is_barrier(head) || trx_ctrl_msg_is_barrier(tcm)))
+			break;
+		trx_ctrl_send_msg(l1h, tcm);
+		l1h->trx_ctrl_inflight++;
+		sent = true;
 	}
 
 	/* start timer */
-	osmo_timer_schedule(&l1h->trx_ctrl_timer, 2, 0);
+	if (sent)
+		osmo_timer_schedule(&l1h->trx_ctrl_timer, 2, 0);
 }
 
-/* send first ctrl message and start timer */
+/* re-send first ctrl message (or the pending window) and start timer */
 static void trx_ctrl_timer_cb(void *data)
 {
 	struct trx_l1h *l1h = data;
@@ -200,7 +233,16 @@ static void trx_ctrl_timer_cb(void *data)
 	LOGPPHI(l1h->phy_inst, DTRX, LOGL_NOTICE, "No satisfactory response from transceiver(CMD %s%s%s)\n",
 		tcm->cmd, tcm->params_len ? " ":"", tcm->params);
 
-	trx_ctrl_send(l1h);
+	/* nothing in flight (delayed re-try), send all we can */
+	if (l1h->trx_ctrl_inflight == 0) {
+		trx_ctrl_send(l1h);
+		return;
+	}
+
+	/* only re-transmit the oldest command, responses to the others may
+	 * still be on their way and would otherwise end up as duplicates */
+	trx_ctrl_send_msg(l1h, tcm);
+	osmo_timer_schedule(&l1h->trx_ctrl_timer, 2, 0);
 }
 
 void trx_if_init(struct trx_l1h *l1h)
@@ -213,6 +255,13 @@ void trx_if_init(struct trx_l1h *l1h)
 
 	l1h->trx_ofd_ctrl.fd = -1;
 	l1h->trx_ofd_data.fd = -1;
+
+	/* initialize TRXD Tx batching state */
+	l1h->trxd_tx.pos = &l1h->trxd_tx.buf[0];
+	l1h->trxd_tx.last_pdu = NULL;
+	l1h->trxd_tx.pdu_num = 0;
+
+	trx_if_set_pdu_ver(l1h, 0);
 }
 
 /*! Send a new TRX control command.
@@ -269,8 +318,9 @@ static int trx_ctrl_cmd_cb(struct trx_l1h *l1h, int critical, void *cb, const ch
 		tcm->cmd, tcm->params_len ? " " : "", tcm->params);
 	llist_add_tail(&tcm->list, &l1h->trx_ctrl_list);
 
-	/* send message, if we didn't already have pending messages */
-	if (prev == NULL)
+	/* send message, if the window allows it and we're not waiting for a
+	 * delayed re-try (timer armed with nothing in flight) */
+	if (l1h->trx_ctrl_inflight > 0 || !osmo_timer_pending(&l1h->trx_ctrl_timer))
 		trx_ctrl_send(l1h);
 
 	return 0;
@@ -493,6 +543,22 @@ static bool cmd_matches_rsp(struct trx_ctrl_msg *tcm, struct trx_ctrl_rsp *rsp)
 	return true;
 }
 
+/* find the first in-flight command matching the given response */
+static struct trx_ctrl_msg *trx_ctrl_find_inflight(struct trx_l1h *l1h, struct trx_ctrl_rsp *rsp)
+{
+	struct trx_ctrl_msg *tcm;
+	unsigned int i = 0;
+
+	llist_for_each_entry(tcm, &l1h->trx_ctrl_list, list) {
+		if (i++ >= l1h->trx_ctrl_inflight)
+			break;
+		if (cmd_matches_rsp(tcm, rsp))
+			return tcm;
+	}
+
+	return NULL;
+}
+
 static int trx_ctrl_rx_rsp_poweron(struct trx_l1h *l1h, struct trx_ctrl_rsp *rsp)
 {
 	trx_if_cmd_poweronoff_cb *cb = (trx_if_cmd_poweronoff_cb*) rsp->cb;
@@ -698,15 +764,16 @@ static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 		LOGPPHI(l1h->phy_inst, DTRX, LOGL_NOTICE, "Response message without command\n");
 		return -EINVAL;
 	}
-	tcm = llist_entry(l1h->trx_ctrl_list.next, struct trx_ctrl_msg,
-		list);
-
-	/* check if response matches command */
-	if (!cmd_matches_rsp(tcm, &rsp)) {
+	/* find the in-flight command matching the response */
+	tcm = trx_ctrl_find_inflight(l1h, &rsp);
+	if (tcm == NULL) {
+		tcm = llist_entry(l1h->trx_ctrl_list.next, struct trx_ctrl_msg, list);
 		/* RSP from a retransmission, skip it */
 		if (l1h->last_acked && cmd_matches_rsp(l1h->last_acked, &rsp)) {
 			LOGPPHI(l1h->phy_inst, DTRX, LOGL_NOTICE, "Discarding duplicated RSP "
 				"from old CMD '%s'\n", buf);
+			if (l1h->trx_ctrl_inflight > 0)
+				osmo_timer_schedule(&l1h->trx_ctrl_timer, 2, 0);
 			return 0;
 		}
 		LOGPPHI(l1h->phy_inst, DTRX, (tcm->critical) ? LOGL_FATAL : LOGL_NOTICE,
@@ -727,6 +794,8 @@ static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 	llist_del(&tcm->list);
 	talloc_free(l1h->last_acked);
 	l1h->last_acked = tcm;
+	if (l1h->trx_ctrl_inflight > 0)
+		l1h->trx_ctrl_inflight--;
 
 	/* check for response code */
 	rc = trx_ctrl_rx_rsp(l1h, &rsp, tcm);
@@ -742,6 +811,10 @@ static int trx_ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
 
 	trx_ctrl_send(l1h);
 
+	/* keep the re-transmission timer running for the remaining commands */
+	if (l1h->trx_ctrl_inflight > 0 && !osmo_timer_pending(&l1h->trx_ctrl_timer))
+		osmo_timer_schedule(&l1h->trx_ctrl_timer, 2, 0);
+
 	return 0;
 
 rsp_error:
@@ -767,6 +840,8 @@ static const uint8_t trx_data_rx_hdr_len[] = {
 	TRX_UL_V0HDR_LEN, /* TRXDv0 */
 	TRX_UL_V1HDR_LEN, /* TRXDv1 */
 	TRX_UL_V2HDR_LEN, /* TRXDv2 */
+	TRX_UL_V2HDR_LEN, /* TRXDv3 (same Uplink format as TRXDv2) */
+	TRX_UL_V2HDR_LEN, /* TRXDv4 (TRXDv2 header, quantized soft-bits) */
 };
 
 static const uint8_t trx_data_mod_val[] = {
@@ -921,37 +996,142 @@ static int trx_data_handle_pdu_v2(struct phy_instance *phy_inst,
 	return TRX_UL_V2HDR_LEN;
 }
 
-/* TRXD burst handler (version independent) */
-static int trx_data_handle_burst(struct trx_ul_burst_ind *bi,
-				 const uint8_t *buf, size_t buf_len)
+/* Burst length for the modulation types defined in 3GPP TS 45.002 */
+static const size_t trx_data_burst_len[] = {
+	[TRX_MOD_T_GMSK] = 148, /* 1 bit per symbol */
+	[TRX_MOD_T_8PSK] = 444, /* 3 bits per symbol */
+};
+
+/* Convert unsigned soft-bits [254..0] to soft-bits [-127..127] in place.
+ * 127 - MIN(u, 254) maps 255 to -127 like 254, without a branch; in 8 bit
+ * arithmetic it does not even need saturation. */
+static void trx_ubits2sbits_scalar(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (uint8_t) (127 - OSMO_MIN(buf[i], 254));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void trx_ubits2sbits_sse2(uint8_t *buf, size_t len)
 {
+	const __m128i max = _mm_set1_epi8((char) 254);
+	const __m128i off = _mm_set1_epi8(127);
 	size_t i;
 
+	for (i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &buf[i]);
+		v = _mm_sub_epi8(off, _mm_min_epu8(v, max));
+		_mm_storeu_si128((__m128i *) &buf[i], v);
+	}
+	trx_ubits2sbits_scalar(&buf[i], len - i);
+}
+
+__attribute__((target("avx2")))
+static void trx_ubits2sbits_avx2(uint8_t *buf, size_t len)
+{
+	const __m256i max = _mm256_set1_epi8((char) 254);
+	const __m256i off = _mm256_set1_epi8(127);
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) &buf[i]);
+		v = _mm256_sub_epi8(off, _mm256_min_epu8(v, max));
+		_mm256_storeu_si256((__m256i *) &buf[i], v);
+	}
+	trx_ubits2sbits_sse2(&buf[i], len - i);
+}
+#elif defined(__ARM_NEON)
+static void trx_ubits2sbits_neon(uint8_t *buf, size_t len)
+{
+	const uint8x16_t max = vdupq_n_u8(254);
+	const uint8x16_t off = vdupq_n_u8(127);
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(&buf[i]);
+		vst1q_u8(&buf[i], vsubq_u8(off, vminq_u8(v, max)));
+	}
+	trx_ubits2sbits_scalar(&buf[i], len - i);
+}
+#endif
+
+/* Selected once at startup, depending on what the CPU supports */
+static void (*trx_ubits2sbits)(uint8_t *buf, size_t len) = trx_ubits2sbits_scalar;
+
+static __attribute__((constructor)) void trx_ubits2sbits_init(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		trx_ubits2sbits = trx_ubits2sbits_avx2;
+	else if (__builtin_cpu_supports("sse2"))
+		trx_ubits2sbits = trx_ubits2sbits_sse2;
+#elif defined(__ARM_NEON)
+	trx_ubits2sbits = trx_ubits2sbits_neon;
+#endif
+}
+
+/* TRXD burst handler (TRXDv0..v3).  The soft-bits are converted in place,
+ * so the indication refers to the receive buffer (no copy).
+ * Returns the number of octets consumed, or a negative error. */
+static int trx_data_handle_burst(struct trx_ul_burst_ind *bi,
+				 uint8_t *buf, size_t buf_len)
+{
 	/* NOPE.ind contains no burst */
 	if (bi->flags & TRX_BI_F_NOPE_IND) {
+		bi->burst = NULL;
 		bi->burst_len = 0;
 		return 0;
 	}
 
-	/* Modulation types defined in 3GPP TS 45.002 */
-	static const size_t bl[] = {
-		[TRX_MOD_T_GMSK] = 148, /* 1 bit per symbol */
-		[TRX_MOD_T_8PSK] = 444, /* 3 bits per symbol */
-	};
-
-	bi->burst_len = bl[bi->mod];
+	bi->burst_len = trx_data_burst_len[bi->mod];
 	if (OSMO_UNLIKELY(buf_len < bi->burst_len))
 		return -EINVAL;
 
 	/* Convert unsigned soft-bits [254..0] to soft-bits [-127..127] */
+	trx_ubits2sbits(buf, bi->burst_len);
+	bi->burst = (sbit_t *) buf;
+
+	return bi->burst_len;
+}
+
+/* TRXDv4 burst handler: a scale factor octet, followed by the soft-bits
+ * quantized to 4 bit (two's complement, high nibble first).  The burst does
+ * not fit in place, so it is expanded to the given buffer.
+ * Returns the number of octets consumed, or a negative error. */
+static int trx_data_handle_burst_q4(struct trx_ul_burst_ind *bi,
+				    const uint8_t *buf, size_t buf_len,
+				    sbit_t *burst)
+{
+	size_t i, len;
+	int scale, sbit;
+
+	/* NOPE.ind contains no burst */
+	if (bi->flags & TRX_BI_F_NOPE_IND) {
+		bi->burst = NULL;
+		bi->burst_len = 0;
+		return 0;
+	}
+
+	bi->burst_len = trx_data_burst_len[bi->mod];
+	len = 1 + (bi->burst_len + 1) / 2;
+	if (OSMO_UNLIKELY(buf_len < len))
+		return -EINVAL;
+
+	scale = buf[0];
 	for (i = 0; i < bi->burst_len; i++) {
-		if (buf[i] == 255)
-			bi->burst[i] = -127;
-		else
-			bi->burst[i] = 127 - buf[i];
+		uint8_t q = buf[1 + i / 2];
+
+		q = (i & 1) ? (q & 0x0f) : (q >> 4);
+		sbit = ((q & 0x08) ? (int)q - 16 : (int)q) * scale;
+		burst[i] = OSMO_MAX(-127, OSMO_MIN(sbit, 127));
 	}
 
-	return 0;
+	bi->burst = burst;
+	return len;
 }
 
 static const char *trx_data_desc_msg(const struct trx_ul_burst_ind *bi)
@@ -1000,35 +1180,75 @@ static const char *trx_data_desc_msg(const struct trx_ul_burst_ind *bi)
 	return buf;
 }
 
-/* TRXD buffer used by Rx/Tx handlers */
-static uint8_t trx_data_buf[TRXD_MSG_BUF_SIZE];
-
-/* Parse TRXD message from transceiver, compose an UL burst indication. */
-static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
+/* Account a received TRXD datagram with the given sequence number.  The
+ * inter-arrival jitter is estimated like in RFC 3550, section 6.4.1, with
+ * the TDMA frame number as the timestamp of the transceiver. */
+static void trx_data_rx_seq(struct trx_l1h *l1h, uint16_t seq, uint32_t fn)
 {
-	const uint8_t *buf = &trx_data_buf[0];
-	struct trx_l1h *l1h = ofd->data;
-	struct trx_ul_burst_ind bi;
-	ssize_t hdr_len, buf_len;
-	uint8_t pdu_ver;
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) l1h->phy_inst->trx->bts->model_priv;
+	struct timespec now, diff;
+	int64_t d_us;
+	int16_t delta;
 
-	buf_len = recv(ofd->fd, trx_data_buf, sizeof(trx_data_buf), 0);
-	if (OSMO_UNLIKELY(buf_len <= 0)) {
-		strerror_r(errno, (char *) trx_data_buf, sizeof(trx_data_buf));
-		LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
-			"recv() failed on TRXD with rc=%zd (%s)\n",
-			buf_len, trx_data_buf);
-		return buf_len;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	l1h->trxd_rx_seq.num++;
+
+	if (!l1h->trxd_rx_seq.valid) {
+		l1h->trxd_rx_seq.valid = true;
+		goto out;
 	}
 
-	/* Parse PDU version first */
-	pdu_ver = buf[0] >> 4;
+	delta = (int16_t)(seq - l1h->trxd_rx_seq.seq_next);
+	if (OSMO_UNLIKELY(delta < 0)) {
+		/* A late datagram, which was accounted as lost before */
+		l1h->trxd_rx_seq.reordered++;
+		if (l1h->trxd_rx_seq.lost > 0)
+			l1h->trxd_rx_seq.lost--;
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_TRXD_RX_REORDERED);
+		return;
+	}
+	if (OSMO_UNLIKELY(delta > 0)) {
+		l1h->trxd_rx_seq.lost += delta;
+		rate_ctr_shard_add(priv->ctrs_shard, BTSTRX_CTR_TRXD_RX_LOST, delta);
+	}
+
+	timespecsub(&now, &l1h->trxd_rx_seq.last, &diff);
+	d_us = (int64_t) diff.tv_sec * 1000000 + diff.tv_nsec / 1000;
+	d_us -= (int64_t) GSM_TDMA_FN_SUB(fn, l1h->trxd_rx_seq.fn_last) * GSM_TDMA_FN_DURATION_uS;
+	if (d_us < 0)
+		d_us = -d_us;
+	l1h->trxd_rx_seq.jitter_us16 += d_us - ((l1h->trxd_rx_seq.jitter_us16 + 8) >> 4);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(priv->stats, BTSTRX_STAT_TRXD_RX_JITTER_US),
+			   l1h->trxd_rx_seq.jitter_us16 >> 4);
+
+out:
+	l1h->trxd_rx_seq.seq_next = seq + 1;
+	l1h->trxd_rx_seq.fn_last = fn;
+	l1h->trxd_rx_seq.last = now;
+}
+
+/* Parse a single TRXD datagram from transceiver, compose UL burst indications.
+ * Always inlined with a constant pdu_ver, see trx_data_rx_fns[], so that the
+ * batch loop is specialized for the negotiated version. */
+static inline __attribute__((always_inline))
+int trx_data_handle_dgram(struct trx_l1h *l1h, uint8_t *buf, ssize_t buf_len,
+			  const uint8_t pdu_ver)
+{
+	struct trx_capture *cap = l1h->phy_inst->phy_link->u.osmotrx.capture;
+	const bool shared = l1h->phy_inst->phy_link->u.osmotrx.trxd_shared;
+	const struct gsm_bts_trx *trx;
+	struct trx_ul_burst_ind bi;
+	ssize_t hdr_len;
+	int rc;
+
+	if (OSMO_UNLIKELY(cap != NULL))
+		trx_capture_write(cap, TRX_CAPTURE_UL, l1h->phy_inst->num, buf, buf_len);
 
 	/* Make sure that PDU version matches our expectations */
-	if (OSMO_UNLIKELY(pdu_ver != l1h->config.trxd_pdu_ver_use)) {
+	if (OSMO_UNLIKELY((buf[0] >> 4) != pdu_ver)) {
 		LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
 			"Rx TRXD PDU with unexpected version %u (expected %u)\n",
-			pdu_ver, l1h->config.trxd_pdu_ver_use);
+			buf[0] >> 4, pdu_ver);
 		return -EIO;
 	}
 
@@ -1057,6 +1277,8 @@ static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
 			hdr_len = trx_data_handle_hdr_v1(l1h->phy_inst, &bi, buf, buf_len);
 			break;
 		case 2: /* TRXDv2 */
+		case 3: /* TRXDv3 */
+		case 4: /* TRXDv4 */
 			hdr_len = trx_data_handle_pdu_v2(l1h->phy_inst, &bi, buf, buf_len);
 			break;
 		default:
@@ -1080,7 +1302,11 @@ static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
 		buf += hdr_len;
 
 		/* Calculate burst length and parse it (if present) */
-		if (OSMO_UNLIKELY(trx_data_handle_burst(&bi, buf, buf_len) != 0)) {
+		if (pdu_ver >= 4)
+			rc = trx_data_handle_burst_q4(&bi, buf, buf_len, l1h->trxd_rx_batch.burst);
+		else
+			rc = trx_data_handle_burst(&bi, buf, buf_len);
+		if (OSMO_UNLIKELY(rc < 0)) {
 			LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
 				"Rx malformed TRXDv%u PDU: odd burst length=%zd\n",
 				pdu_ver, buf_len);
@@ -1088,37 +1314,222 @@ static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
 		}
 
 		/* We're done with the burst bits now */
-		buf_len -= bi.burst_len;
-		buf += bi.burst_len;
+		buf_len -= rc;
+		buf += rc;
 
 		/* Print header & burst info */
-		LOGPPHI(l1h->phy_inst, DTRX, LOGL_DEBUG, "Rx %s (pdu_ver=%u): %s\n",
+		LOGPPHI_HOTPATH(l1h->phy_inst, DTRX, LOGL_DEBUG, "Rx %s (pdu_ver=%u): %s\n",
 			(bi.flags & TRX_BI_F_NOPE_IND) ? "NOPE.ind" : "UL burst",
 			pdu_ver, trx_data_desc_msg(&bi));
 
 		/* Number of processed PDUs */
 		bi._num_pdus++;
 
+		/* Shared TRXD socket: the PDU tells which TRX it belongs to */
+		trx = l1h->phy_inst->trx;
+		if (trx != NULL && shared && (bi.flags & TRX_BI_F_TRX_NUM))
+			trx = gsm_bts_trx_num(trx->bts, bi.trx_num);
+		if (OSMO_UNLIKELY(trx == NULL)) {
+			LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
+				"Rx TRXD PDU for unknown trx_num=%u\n", bi.trx_num);
+			continue;
+		}
+
 		/* feed received burst into scheduler code */
-		TRACE(OSMO_BTS_TRX_UL_DATA_START(l1h->phy_inst->trx->nr, bi.tn, bi.fn));
-		trx_sched_route_burst_ind(l1h->phy_inst->trx, &bi);
-		TRACE(OSMO_BTS_TRX_UL_DATA_DONE(l1h->phy_inst->trx->nr, bi.tn, bi.fn));
+		TRACE(OSMO_BTS_TRX_UL_DATA_START(trx->nr, bi.tn, bi.fn));
+		trx_sched_route_burst_ind(trx, &bi);
+		TRACE(OSMO_BTS_TRX_UL_DATA_DONE(trx->nr, bi.tn, bi.fn));
 	} while (bi.flags & TRX_BI_F_BATCH_IND);
 
+	/* The sequence number follows the last PDU */
+	if (l1h->phy_inst->phy_link->u.osmotrx.trxd_seqnum && pdu_ver >= 2) {
+		if (OSMO_UNLIKELY(buf_len < 2)) {
+			LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
+				"Rx TRXD datagram without sequence number\n");
+			return -EINVAL;
+		}
+		trx_data_rx_seq(l1h, osmo_load16be(buf), bi.fn);
+	}
+
+	return 0;
+}
+
+static int trx_data_handle_dgram_v0(struct trx_l1h *l1h, uint8_t *buf, ssize_t buf_len)
+{
+	return trx_data_handle_dgram(l1h, buf, buf_len, 0);
+}
+
+static int trx_data_handle_dgram_v1(struct trx_l1h *l1h, uint8_t *buf, ssize_t buf_len)
+{
+	return trx_data_handle_dgram(l1h, buf, buf_len, 1);
+}
+
+static int trx_data_handle_dgram_v2(struct trx_l1h *l1h, uint8_t *buf, ssize_t buf_len)
+{
+	return trx_data_handle_dgram(l1h, buf, buf_len, 2);
+}
+
+static int trx_data_handle_dgram_v3(struct trx_l1h *l1h, uint8_t *buf, ssize_t buf_len)
+{
+	return trx_data_handle_dgram(l1h, buf, buf_len, 3);
+}
+
+static int trx_data_handle_dgram_v4(struct trx_l1h *l1h, uint8_t *buf, ssize_t buf_len)
+{
+	return trx_data_handle_dgram(l1h, buf, buf_len, 4);
+}
+
+/* TRXD Rx handlers by PDU version, installed by trx_if_set_pdu_ver() */
+static trx_data_rx_fn * const trx_data_rx_fns[] = {
+	trx_data_handle_dgram_v0,
+	trx_data_handle_dgram_v1,
+	trx_data_handle_dgram_v2,
+	trx_data_handle_dgram_v3,
+	trx_data_handle_dgram_v4,
+};
+
+/*! allocate the TRXD Rx buffers (and the recvmmsg() state for batched reception)
+ *  \param[inout] l1h TRX Layer1 handle
+ *  \param[in] depth maximum number of datagrams per recvmmsg() call (at least 1)
+ *  \returns 0 on success; negative on error */
+static int trx_data_rx_batch_alloc(struct trx_l1h *l1h, unsigned int depth)
+{
+	unsigned int i;
+
+	l1h->trxd_rx_batch.msgs = talloc_zero_array(l1h, struct mmsghdr, depth);
+	l1h->trxd_rx_batch.iovs = talloc_zero_array(l1h, struct iovec, depth);
+	l1h->trxd_rx_batch.bufs = talloc_size(l1h, depth * TRXD_MSG_BUF_SIZE);
+	if (!l1h->trxd_rx_batch.msgs || !l1h->trxd_rx_batch.iovs || !l1h->trxd_rx_batch.bufs)
+		return -ENOMEM;
+
+	for (i = 0; i < depth; i++) {
+		struct iovec *iov = &l1h->trxd_rx_batch.iovs[i];
+		struct msghdr *hdr = &l1h->trxd_rx_batch.msgs[i].msg_hdr;
+
+		iov->iov_base = &l1h->trxd_rx_batch.bufs[i * TRXD_MSG_BUF_SIZE];
+		iov->iov_len = TRXD_MSG_BUF_SIZE;
+		hdr->msg_iov = iov;
+		hdr->msg_iovlen = 1;
+	}
+
+	l1h->trxd_rx_batch.depth = depth;
+
 	return 0;
 }
 
+/*! free the TRXD Rx buffers and the recvmmsg() state (if any) */
+static void trx_data_rx_batch_free(struct trx_l1h *l1h)
+{
+	TALLOC_FREE(l1h->trxd_rx_batch.msgs);
+	TALLOC_FREE(l1h->trxd_rx_batch.iovs);
+	TALLOC_FREE(l1h->trxd_rx_batch.bufs);
+	l1h->trxd_rx_batch.depth = 0;
+}
+
+/* Account the number of datagrams returned by a single recvmmsg() call */
+static void trx_data_rx_batch_ctr_inc(struct trx_l1h *l1h, unsigned int num)
+{
+	const struct gsm_bts_trx *trx = l1h->phy_inst->trx;
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) trx->bts->model_priv;
+
+	if (num >= 16)
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_TRXD_RX_BATCH_16_PLUS);
+	else if (num >= 8)
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_TRXD_RX_BATCH_8_15);
+	else if (num >= 4)
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_TRXD_RX_BATCH_4_7);
+	else if (num >= 2)
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_TRXD_RX_BATCH_2_3);
+	else
+		rate_ctr_shard_inc(priv->ctrs_shard, BTSTRX_CTR_TRXD_RX_BATCH_1);
+}
+
+/* Drain all queued TRXD datagrams using a single recvmmsg() call. */
+static int trx_data_read_batch(struct trx_l1h *l1h, struct osmo_fd *ofd)
+{
+	int i, num;
+
+	num = recvmmsg(ofd->fd, l1h->trxd_rx_batch.msgs,
+		       l1h->trxd_rx_batch.depth, MSG_DONTWAIT, NULL);
+	if (OSMO_UNLIKELY(num <= 0)) {
+		/* nothing to read (anymore), e.g. another reader of a shared socket was faster */
+		if (num < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
+			"recvmmsg() failed on TRXD with rc=%d (%s)\n",
+			num, strerror(errno));
+		return num;
+	}
+
+	trx_data_rx_batch_ctr_inc(l1h, num);
+
+	/* Process the datagrams in the order they were received.  A malformed
+	 * datagram is logged by the parser, but must not stop the others. */
+	for (i = 0; i < num; i++) {
+		const struct mmsghdr *mh = &l1h->trxd_rx_batch.msgs[i];
+
+		/* an empty datagram has not even a header, the parser reads buf[0] */
+		if (OSMO_UNLIKELY(mh->msg_len == 0))
+			continue;
+
+		if (OSMO_UNLIKELY(mh->msg_hdr.msg_flags & MSG_TRUNC)) {
+			LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
+				"Rx truncated TRXD datagram (len=%u), dropping\n",
+				mh->msg_len);
+			continue;
+		}
+
+		l1h->trxd_rx_fn(l1h, mh->msg_hdr.msg_iov->iov_base, mh->msg_len);
+	}
+
+	return 0;
+}
+
+/* Parse TRXD message from transceiver, compose an UL burst indication. */
+static int trx_data_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct trx_l1h *l1h = ofd->data;
+	ssize_t buf_len;
+	uint8_t *buf;
+
+	if (l1h->trxd_rx_batch.depth > 1)
+		return trx_data_read_batch(l1h, ofd);
+
+	buf = &l1h->trxd_rx_batch.bufs[0];
+	buf_len = recv(ofd->fd, buf, TRXD_MSG_BUF_SIZE, 0);
+	if (OSMO_UNLIKELY(buf_len <= 0)) {
+		LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
+			"recv() failed on TRXD with rc=%zd (%s)\n",
+			buf_len, strerror(errno));
+		return buf_len;
+	}
+
+	return l1h->trxd_rx_fn(l1h, buf, buf_len);
+}
+
+/* TRX Layer1 handle owning the TRXD socket used by the given one */
+static struct trx_l1h *trx_data_l1h(struct trx_l1h *l1h)
+{
+	const struct phy_link *plink = l1h->phy_inst->phy_link;
+	const struct phy_instance *pinst;
+
+	if (!plink->u.osmotrx.trxd_shared || l1h->phy_inst->num == 0)
+		return l1h;
+	pinst = phy_instance_by_num(plink, 0);
+	OSMO_ASSERT(pinst != NULL);
+	return pinst->u.osmotrx.hdl;
+}
+
 /*! Send burst data for given FN/timeslot to TRX
  *  \param[inout] l1h TRX Layer1 handle referring to TX
  *  \param[in] br Downlink burst request structure
- *  \returns 0 on success; negative on error */
+ *  \returns 0 on success; negative on error
+ *
+ *  With 'osmotrx trxd-shared', the bursts of all TRX are batched into the
+ *  datagram of the first PHY instance, until its batching breaker. */
 int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 {
-	uint8_t pdu_ver = l1h->config.trxd_pdu_ver_use;
-	static uint8_t *buf = &trx_data_buf[0];
-	static uint8_t *last_pdu = NULL;
-	static unsigned int pdu_num = 0;
-	ssize_t snd_len, buf_len;
+	l1h = trx_data_l1h(l1h);
 
 	/* Make sure that the PHY is powered on */
 	if (OSMO_UNLIKELY(!trx_if_powered(l1h))) {
@@ -1127,15 +1538,28 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 		return -ENODEV;
 	}
 
+	return l1h->trxd_tx_fn(l1h, br);
+}
+
+/* Encode a DL burst into the TRXD batch (and send it), see trx_if_send_burst().
+ * Always inlined with a constant pdu_ver, see trx_data_tx_fns[]. */
+static inline __attribute__((always_inline))
+int trx_data_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br,
+			const uint8_t pdu_ver)
+{
+	struct trx_capture *cap = l1h->phy_inst->phy_link->u.osmotrx.capture;
+	uint8_t *buf = l1h->trxd_tx.pos;
+	ssize_t snd_len, buf_len;
+
 	/* Burst batching breaker */
 	if (br == NULL) {
-		if (pdu_num > 0)
+		if (l1h->trxd_tx.pdu_num > 0)
 			goto sendall;
 		return -ENOMSG;
 	}
 
 	/* Pointer to the last encoded PDU */
-	last_pdu = &buf[0];
+	l1h->trxd_tx.last_pdu = &buf[0];
 
 	switch (pdu_ver) {
 	/* Both versions have the same PDU format */
@@ -1146,7 +1570,10 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 		buf[5] = br->att;
 		buf += 6;
 		break;
+	/* TRXDv3 only differs in the burst bits */
 	case 2: /* TRXDv2 */
+	case 3: /* TRXDv3 */
+	case 4: /* TRXDv4 */
 		buf[0] = br->tn;
 		/* BATCH.ind will be unset in the last PDU */
 		buf[1] = (br->trx_num & 0x3f) | (1 << 7);
@@ -1157,7 +1584,7 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 		buf[4] = (uint8_t) br->scpir;
 		buf[5] = buf[6] = buf[7] = 0x00; /* Spare */
 		/* Some fields are not present in batched PDUs */
-		if (pdu_num == 0) {
+		if (l1h->trxd_tx.pdu_num == 0) {
 			buf[0] |= (pdu_ver & 0x0f) << 4;
 			osmo_store32be(br->fn, buf + 8);
 			buf += 4;
@@ -1169,42 +1596,102 @@ int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
 		OSMO_ASSERT(0);
 	}
 
-	/* copy ubits {0,1} */
-	memcpy(buf, br->burst, br->burst_len);
-	buf += br->burst_len;
+	if (pdu_ver >= 3) {
+		/* pack ubits {0,1}, the number of bits is given by the modulation */
+		buf += osmo_ubit2pbit(buf, br->burst, br->burst_len);
+	} else {
+		/* copy ubits {0,1} */
+		memcpy(buf, br->burst, br->burst_len);
+		buf += br->burst_len;
+	}
 
 	/* One more PDU in the buffer */
-	pdu_num++;
+	l1h->trxd_tx.pdu_num++;
+	l1h->trxd_tx.pos = buf;
 
 	/* TRXDv2: wait for the batching breaker */
 	if (pdu_ver >= 2)
 		return 0;
 
 sendall:
-	LOGPPHI(l1h->phy_inst, DTRX, LOGL_DEBUG,
+	LOGPPHI_HOTPATH(l1h->phy_inst, DTRX, LOGL_DEBUG,
 		"Tx TRXDv%u datagram with %u PDU(s)\n",
-		pdu_ver, pdu_num);
+		pdu_ver, l1h->trxd_tx.pdu_num);
 
 	/* TRXDv2: unset BATCH.ind in the last PDU */
 	if (pdu_ver >= 2)
-		last_pdu[1] &= ~(1 << 7);
+		l1h->trxd_tx.last_pdu[1] &= ~(1 << 7);
 
-	buf_len = buf - &trx_data_buf[0];
-	buf = &trx_data_buf[0];
-	pdu_num = 0;
+	/* The sequence number follows the last PDU */
+	if (l1h->phy_inst->phy_link->u.osmotrx.trxd_seqnum && pdu_ver >= 2) {
+		osmo_store16be(l1h->trxd_tx.seq++, buf);
+		buf += 2;
+	}
+
+	buf_len = buf - &l1h->trxd_tx.buf[0];
+	l1h->trxd_tx.pos = &l1h->trxd_tx.buf[0];
+	l1h->trxd_tx.pdu_num = 0;
 
-	snd_len = send(l1h->trx_ofd_data.fd, trx_data_buf, buf_len, 0);
+	if (OSMO_UNLIKELY(cap != NULL))
+		trx_capture_write(cap, TRX_CAPTURE_DL, l1h->phy_inst->num, l1h->trxd_tx.buf, buf_len);
+
+	snd_len = send(l1h->trx_ofd_data.fd, l1h->trxd_tx.buf, buf_len, 0);
 	if (OSMO_UNLIKELY(snd_len <= 0)) {
-		strerror_r(errno, (char *) trx_data_buf, sizeof(trx_data_buf));
 		LOGPPHI(l1h->phy_inst, DTRX, LOGL_ERROR,
 			"send() failed on TRXD with rc=%zd (%s)\n",
-			snd_len, trx_data_buf);
+			snd_len, strerror(errno));
 		return -2;
 	}
 
 	return 0;
 }
 
+static int trx_data_send_burst_v0(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
+{
+	return trx_data_send_burst(l1h, br, 0);
+}
+
+static int trx_data_send_burst_v1(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
+{
+	return trx_data_send_burst(l1h, br, 1);
+}
+
+static int trx_data_send_burst_v2(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
+{
+	return trx_data_send_burst(l1h, br, 2);
+}
+
+static int trx_data_send_burst_v3(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
+{
+	return trx_data_send_burst(l1h, br, 3);
+}
+
+static int trx_data_send_burst_v4(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
+{
+	return trx_data_send_burst(l1h, br, 4);
+}
+
+/* TRXD Tx handlers by PDU version, installed by trx_if_set_pdu_ver() */
+static trx_data_tx_fn * const trx_data_tx_fns[] = {
+	trx_data_send_burst_v0,
+	trx_data_send_burst_v1,
+	trx_data_send_burst_v2,
+	trx_data_send_burst_v3,
+	trx_data_send_burst_v4,
+};
+
+/*! set the TRXD PDU version in use and install the matching Rx/Tx handlers
+ *  \param[inout] l1h TRX Layer1 handle
+ *  \param[in] ver TRXD PDU version, as negotiated with SETFORMAT */
+void trx_if_set_pdu_ver(struct trx_l1h *l1h, uint8_t ver)
+{
+	OSMO_ASSERT(ver < ARRAY_SIZE(trx_data_rx_fns));
+
+	l1h->config.trxd_pdu_ver_use = ver;
+	l1h->trxd_rx_fn = trx_data_rx_fns[ver];
+	l1h->trxd_tx_fn = trx_data_tx_fns[ver];
+}
+
 
 /*
  * open/close
@@ -1224,6 +1711,7 @@ void trx_if_flush(struct trx_l1h *l1h)
 	}
 	talloc_free(l1h->last_acked);
 	l1h->last_acked = NULL;
+	l1h->trx_ctrl_inflight = 0;
 
 	/* Tx queue is now empty, so there's no point in keeping the retrans timer armed: */
 	osmo_timer_del(&l1h->trx_ctrl_timer);
@@ -1240,6 +1728,8 @@ void trx_if_close(struct trx_l1h *l1h)
 	/* close sockets */
 	trx_udp_close(&l1h->trx_ofd_ctrl);
 	trx_udp_close(&l1h->trx_ofd_data);
+
+	trx_data_rx_batch_free(l1h);
 }
 
 /*! compute UDP port number used for TRX protocol */
@@ -1274,6 +1764,15 @@ static int trx_if_open(struct trx_l1h *l1h)
 			  compute_port(pinst, true, false), trx_ctrl_read_cb);
 	if (rc < 0)
 		return rc;
+
+	/* Start the TRXD sequence numbering over */
+	memset(&l1h->trxd_rx_seq, 0, sizeof(l1h->trxd_rx_seq));
+	l1h->trxd_tx.seq = 0;
+
+	/* Shared TRXD socket: only the first instance opens it */
+	if (plink->u.osmotrx.trxd_shared && pinst->num != 0)
+		return 0;
+
 	rc = trx_udp_open(l1h, &l1h->trx_ofd_data,
 			  plink->u.osmotrx.local_ip,
 			  compute_port(pinst, false, true),
@@ -1281,6 +1780,15 @@ static int trx_if_open(struct trx_l1h *l1h)
 			  compute_port(pinst, true, true), trx_data_read_cb);
 	if (rc < 0)
 		return rc;
+	cpu_placement_apply_trxd(plink, l1h->trx_ofd_data.fd);
+
+	/* Rx buffers, optionally for batched reception using recvmmsg() */
+	rc = trx_data_rx_batch_alloc(l1h, OSMO_MAX(plink->u.osmotrx.trxd_rx_batch, 1));
+	if (rc < 0)
+		return rc;
+	if (l1h->trxd_rx_batch.depth > 1)
+		LOGPPHI(pinst, DTRX, LOGL_INFO, "Using recvmmsg() for TRXD with batch depth %u\n",
+			l1h->trxd_rx_batch.depth);
 
 	return 0;
 }
@@ -1327,6 +1835,12 @@ int bts_model_phy_link_open(struct phy_link *plink)
 
 	phy_link_state_set(plink, PHY_LINK_CONNECTING);
 
+	/* before trx_sched_init() allocates the scheduler structures */
+	if (cpu_placement_apply(plink) < 0) {
+		phy_link_state_set(plink, PHY_LINK_SHUTDOWN);
+		return -1;
+	}
+
 	/* open the shared/common clock socket */
 	rc = trx_udp_open(plink, &plink->u.osmotrx.trx_ofd_clk,
 			  plink->u.osmotrx.local_ip,
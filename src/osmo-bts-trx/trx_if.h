@@ -43,8 +43,13 @@ int trx_if_cmd_rfmute(struct trx_l1h *l1h, bool mute);
 int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br);
 int trx_if_powered(struct trx_l1h *l1h);
 
-/* The latest supported TRXD PDU version */
-#define TRX_DATA_PDU_VER    2
+/* The latest supported TRXD PDU version.  TRXDv3 uses the TRXDv2 headers,
+ * but carries the Downlink burst bits packed (8 per octet, MSB first). */
+#define TRX_DATA_PDU_VER    3
+/* TRXDv4 additionally quantizes the Uplink soft-bits to 4 bit.  It trades
+ * decoding performance for bandwidth, so it is only used if configured. */
+#define TRX_DATA_PDU_VER_MAX 4
 
 /* Format negotiation command */
 int trx_if_cmd_setformat(struct trx_l1h *l1h, uint8_t ver, trx_if_cmd_generic_cb *cb);
+void trx_if_set_pdu_ver(struct trx_l1h *l1h, uint8_t ver);
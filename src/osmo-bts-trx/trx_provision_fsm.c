@@ -25,6 +25,7 @@
 #include <inttypes.h>
 
 #include <osmocom/core/fsm.h>
+#include <osmocom/core/timer_compat.h>
 #include <osmocom/core/tdef.h>
 #include <osmocom/gsm/protocol/gsm_12_21.h>
 
@@ -44,6 +45,17 @@
 #define trx_prov_fsm_state_chg(fi, NEXT_STATE) \
 	osmo_fsm_inst_state_chg(fi, NEXT_STATE, 0, 0)
 
+/* Log a step of the provisioning timeline of a TRX, relative to TRX_PROV_EV_OPEN */
+static void trx_prov_timeline(struct trx_l1h *l1h, int level, const char *step)
+{
+	struct timespec now, elapsed;
+
+	osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+	timespecsub(&now, &l1h->config.prov_start, &elapsed);
+	LOGPPHI(l1h->phy_inst, DL1C, level, "Provisioning: %s after %lu ms\n", step,
+		(unsigned long)(elapsed.tv_sec * 1000 + elapsed.tv_nsec / 1000000));
+}
+
 static void l1if_poweronoff_cb(struct trx_l1h *l1h, bool poweronoff, int rc)
 {
 	struct phy_instance *pinst = l1h->phy_inst;
@@ -103,7 +115,7 @@ static void trx_provision_reset(struct trx_l1h *l1h)
 	uint8_t tn;
 
 	l1h->config.trxd_pdu_ver_req = pinst->phy_link->u.osmotrx.trxd_pdu_ver_max;
-	l1h->config.trxd_pdu_ver_use = 0;
+	trx_if_set_pdu_ver(l1h, 0);
 	l1h->config.setformat_sent = false;
 	l1h->config.setformat_acked = false;
 
@@ -205,13 +217,28 @@ int l1if_provision_transceiver_trx(struct trx_l1h *l1h)
 		if (plink->u.osmotrx.trxd_pdu_ver_max == 0) {
 			LOGPPHI(pinst, DL1C, LOGL_INFO,
 				"No need to negotiate max TRXD version 0");
-			l1h->config.trxd_pdu_ver_use = 0;
+			trx_if_set_pdu_ver(l1h, 0);
 			l1h->config.setformat_acked = true;
 		} else {
 			trx_if_cmd_setformat(l1h, l1h->config.trxd_pdu_ver_req, l1if_setformat_cb);
 			l1h->config.setformat_acked = false;
 		}
 	}
+
+	/* The receiver settings don't depend on the tuning or the power state,
+	 * so send them along with the above rather than after POWERON */
+	if (l1h->config.rxgain_valid && !l1h->config.rxgain_sent) {
+		trx_if_cmd_setrxgain(l1h, l1h->config.rxgain);
+		l1h->config.rxgain_sent = true;
+	}
+	if (l1h->config.maxdly_valid && !l1h->config.maxdly_sent) {
+		trx_if_cmd_setmaxdly(l1h, l1h->config.maxdly);
+		l1h->config.maxdly_sent = true;
+	}
+	if (l1h->config.maxdlynb_valid && !l1h->config.maxdlynb_sent) {
+		trx_if_cmd_setmaxdlynb(l1h, l1h->config.maxdlynb);
+		l1h->config.maxdlynb_sent = true;
+	}
 	return 0;
 }
 
@@ -356,6 +383,7 @@ static void st_closed(struct osmo_fsm_inst *fi, uint32_t event, void *data)
 
 	switch (event) {
 	case TRX_PROV_EV_OPEN:
+		osmo_clock_gettime(CLOCK_MONOTONIC, &l1h->config.prov_start);
 		/* enable all slots */
 		l1h->config.slotmask = 0xff;
 		if (l1h->phy_inst->num == 0)
@@ -444,34 +472,40 @@ static void st_open_poweroff(struct osmo_fsm_inst *fi, uint32_t event, void *dat
 	case TRX_PROV_EV_RXTUNE_CNF:
 		if (l1h->config.rxtune_sent)
 			l1h->config.rxtune_acked = true;
+		trx_prov_timeline(l1h, LOGL_INFO, "RXTUNE acked");
 		break;
 	case TRX_PROV_EV_TXTUNE_CNF:
 		if (l1h->config.txtune_sent)
 			l1h->config.txtune_acked = true;
+		trx_prov_timeline(l1h, LOGL_INFO, "TXTUNE acked");
 		break;
 	case TRX_PROV_EV_NOMTXPOWER_CNF:
 		nominal_power = (int)(intptr_t)data;
 		if (l1h->config.nomtxpower_sent)
 			l1h->config.nomtxpower_acked = true;
 		l1if_trx_set_nominal_power(trx, nominal_power);
+		trx_prov_timeline(l1h, LOGL_INFO, "NOMTXPOWER acked");
 		break;
 	case TRX_PROV_EV_SETBSIC_CNF:
 		if (l1h->config.bsic_sent)
 			l1h->config.bsic_acked = true;
+		trx_prov_timeline(l1h, LOGL_INFO, "SETBSIC acked");
 		break;
 	case TRX_PROV_EV_SETTSC_CNF:
 		if (l1h->config.tsc_sent)
 			l1h->config.tsc_acked = true;
+		trx_prov_timeline(l1h, LOGL_INFO, "SETTSC acked");
 		break;
 	case TRX_PROV_EV_SETFORMAT_CNF:
 		status = (int)(intptr_t)data;
 		/* Transceiver may suggest a lower version (than requested) */
 		if (status == l1h->config.trxd_pdu_ver_req) {
-			l1h->config.trxd_pdu_ver_use = status;
+			trx_if_set_pdu_ver(l1h, status);
 			l1h->config.setformat_acked = true;
 			LOGPPHI(l1h->phy_inst, DTRX, LOGL_INFO,
 				"Using TRXD PDU version %u\n",
 				l1h->config.trxd_pdu_ver_use);
+			trx_prov_timeline(l1h, LOGL_INFO, "SETFORMAT acked");
 		} else {
 			LOGPPHI(l1h->phy_inst, DTRX, LOGL_DEBUG,
 				"Transceiver suggests TRXD PDU version %u (requested %u)\n",
@@ -499,6 +533,8 @@ static void st_open_poweroff(struct osmo_fsm_inst *fi, uint32_t event, void *dat
 		if (l1h->phy_inst->num != 0 && (!was_ready && trx_is_provisioned(l1h)))
 			trx_signal_ready_trx0(l1h);
 	}
+	if (!was_ready && trx_is_provisioned(l1h))
+		trx_prov_timeline(l1h, LOGL_INFO, "provisioned");
 
 	/* if we gathered all data and could go forward. For TRX0, only after
 	 * all other TRX are prepared, since it will send POWERON commad */
@@ -544,6 +580,7 @@ static void st_open_wait_power_cnf(struct osmo_fsm_inst *fi, uint32_t event, voi
 	case TRX_PROV_EV_POWERON_CNF:
 		rc = (uint16_t)(intptr_t)data;
 		if (rc == 0 && plink->state != PHY_LINK_CONNECTED) {
+			trx_prov_timeline(l1h, LOGL_NOTICE, "POWERON acked");
 			trx_sched_clock_started(pinst->trx->bts);
 			phy_link_state_set(plink, PHY_LINK_CONNECTED);
 			trx_prov_fsm_state_chg(fi, TRX_PROV_ST_OPEN_POWERON);
@@ -573,7 +610,10 @@ static void st_open_poweron_on_enter(struct osmo_fsm_inst *fi, uint32_t prev_sta
 	struct trx_l1h *l1h = (struct trx_l1h *)fi->priv;
 	uint8_t tn;
 
-	/* after power on */
+	if (l1h->phy_inst->num != 0)
+		trx_prov_timeline(l1h, LOGL_NOTICE, "ready for POWERON");
+
+	/* after power on (if changed meanwhile) */
 	if (l1h->config.rxgain_valid && !l1h->config.rxgain_sent) {
 		trx_if_cmd_setrxgain(l1h, l1h->config.rxgain);
 		l1h->config.rxgain_sent = true;
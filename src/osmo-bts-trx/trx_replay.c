@@ -0,0 +1,464 @@
+/* Replay a TRXD capture into osmo-bts-trx, acting as a transceiver */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The tool binds the TRXC / TRXD / clock sockets of a transceiver, accepts
+ * whatever osmo-bts-trx configures via TRXC and, once the BTS powers the
+ * transceiver on, sends the Uplink datagrams of a capture file written by
+ * 'phy N capture start'.  Datagrams are sent unmodified (including their
+ * TDMA frame numbers) either with their original timing, or back-to-back.
+ * The clock indications follow the frame numbers of the capture, so that
+ * in real time mode the BTS keeps its own timing in sync with the replayed
+ * traffic.  In fast mode the Uplink bursts run ahead of the clock, which is
+ * fine for comparing the CPU cost of the Uplink processing.
+ *
+ * Downlink datagrams from the BTS are counted and discarded.  The channels
+ * need to be activated the same way as during the capture (same BSC
+ * configuration and signalling) for the Uplink bursts to be decoded.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <osmocom/core/bit32gen.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm0502.h>
+
+#include "trx_if.h"
+#include "trx_capture.h"
+
+#define REPLAY_MAX_INST		8
+/* Number of datagrams sent back-to-back before servicing the sockets again */
+#define REPLAY_FAST_CHUNK	64
+
+struct replay_inst {
+	struct osmo_fd ofd_ctrl;
+	struct osmo_fd ofd_data;
+	bool powered;
+	unsigned long dl_num;
+};
+
+static struct {
+	const char *local_ip;
+	const char *remote_ip;
+	uint16_t base_port_local;
+	uint16_t base_port_remote;
+	bool fast;
+	int nominal_power;
+} cfg = {
+	.local_ip = "127.0.0.1",
+	.remote_ip = "127.0.0.1",
+	.base_port_local = 5700,
+	.base_port_remote = 5800,
+	.fast = false,
+	.nominal_power = 23,
+};
+
+static struct {
+	const struct trx_capture_rec **recs; /* Uplink records, oldest first */
+	unsigned int num_recs;
+	unsigned int pos;
+	unsigned int num_inst;
+	uint8_t pdu_ver;
+	uint32_t fn_first;
+
+	struct replay_inst inst[REPLAY_MAX_INST];
+	struct osmo_fd ofd_clk;
+	struct osmo_timer_list data_timer;
+	struct osmo_timer_list clk_timer;
+
+	bool running;
+	uint64_t start_ns;	/* CLOCK_MONOTONIC when the replay started */
+	unsigned long ul_num;
+	bool done;
+} replay;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* TDMA frame number of the first PDU of an Uplink datagram */
+static uint32_t rec_fn(const struct trx_capture_rec *rec)
+{
+	if ((rec->data[0] >> 4) >= 2)
+		return rec->len >= 12 ? osmo_load32be(&rec->data[8]) : 0;
+	return rec->len >= 5 ? osmo_load32be(&rec->data[1]) : 0;
+}
+
+static void send_clock(void)
+{
+	char buf[32];
+	uint32_t fn;
+
+	/* The clock follows the capture: first frame number + elapsed frames */
+	fn = (now_ns() - replay.start_ns) / (GSM_TDMA_FN_DURATION_nS);
+	fn = GSM_TDMA_FN_SUM(replay.fn_first, fn % GSM_TDMA_HYPERFRAME);
+
+	snprintf(buf, sizeof(buf), "IND CLOCK %u", fn);
+	send(replay.ofd_clk.fd, buf, strlen(buf) + 1, 0);
+}
+
+static void clk_timer_cb(void *data)
+{
+	send_clock();
+	osmo_timer_schedule(&replay.clk_timer, 1, 0);
+}
+
+static void send_rec(const struct trx_capture_rec *rec)
+{
+	const struct replay_inst *inst = &replay.inst[rec->phy_inst];
+
+	if (send(inst->ofd_data.fd, rec->data, rec->len, 0) < 0) {
+		fprintf(stderr, "send() failed on TRXD: %s\n", strerror(errno));
+		return;
+	}
+	replay.ul_num++;
+}
+
+static void data_timer_cb(void *data)
+{
+	const uint64_t rec_ts0 = replay.recs[0]->ts_ns;
+	unsigned int n = 0;
+
+	while (replay.pos < replay.num_recs) {
+		const struct trx_capture_rec *rec = replay.recs[replay.pos];
+
+		if (cfg.fast) {
+			if (n++ == REPLAY_FAST_CHUNK) {
+				osmo_timer_schedule(&replay.data_timer, 0, 0);
+				return;
+			}
+		} else {
+			uint64_t offset = rec->ts_ns - rec_ts0;
+			uint64_t elapsed = now_ns() - replay.start_ns;
+
+			if (offset > elapsed) {
+				uint64_t delay_us = (offset - elapsed) / 1000;
+				osmo_timer_schedule(&replay.data_timer, delay_us / 1000000,
+						    delay_us % 1000000);
+				return;
+			}
+		}
+
+		send_rec(rec);
+		replay.pos++;
+	}
+
+	replay.done = true;
+}
+
+static void replay_start(void)
+{
+	if (replay.running)
+		return;
+
+	fprintf(stderr, "Transceiver powered on, replaying %u Uplink datagram(s) %s\n",
+		replay.num_recs, cfg.fast ? "as fast as possible" : "in real time");
+
+	replay.running = true;
+	replay.start_ns = now_ns();
+	replay.pos = 0;
+
+	send_clock();
+	osmo_timer_setup(&replay.clk_timer, clk_timer_cb, NULL);
+	osmo_timer_schedule(&replay.clk_timer, 1, 0);
+	osmo_timer_setup(&replay.data_timer, data_timer_cb, NULL);
+	osmo_timer_schedule(&replay.data_timer, 0, 0);
+}
+
+/* Accept every command, answer the ones where the BTS expects specific values */
+static int ctrl_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct replay_inst *inst = ofd->data;
+	char buf[TRXC_MSG_BUF_SIZE];
+	char rsp[TRXC_MSG_BUF_SIZE + 16];
+	const char *params;
+	char verb[32];
+	int len, ver;
+
+	len = recv(ofd->fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0)
+		return len;
+	buf[len] = '\0';
+
+	if (sscanf(buf, "CMD %31s", verb) != 1)
+		return 0;
+	params = buf + 4 + strlen(verb);
+	if (*params == ' ')
+		params++;
+
+	if (!strcmp(verb, "SETFORMAT")) {
+		ver = atoi(params);
+		snprintf(rsp, sizeof(rsp), "RSP SETFORMAT %d %s",
+			 OSMO_MIN(ver, replay.pdu_ver), params);
+	} else if (!strcmp(verb, "NOMTXPOWER")) {
+		snprintf(rsp, sizeof(rsp), "RSP NOMTXPOWER 0 %d", cfg.nominal_power);
+	} else {
+		snprintf(rsp, sizeof(rsp), "RSP %s 0%s%s", verb,
+			 *params != '\0' ? " " : "", params);
+	}
+
+	send(ofd->fd, rsp, strlen(rsp) + 1, 0);
+
+	if (!strcmp(verb, "POWERON")) {
+		inst->powered = true;
+		if (inst == &replay.inst[0])
+			replay_start();
+	} else if (!strcmp(verb, "POWEROFF")) {
+		inst->powered = false;
+	}
+
+	return 0;
+}
+
+static int data_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct replay_inst *inst = ofd->data;
+	uint8_t buf[TRXD_MSG_BUF_SIZE];
+
+	if (recv(ofd->fd, buf, sizeof(buf), 0) > 0)
+		inst->dl_num++;
+
+	return 0;
+}
+
+static int clk_read_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	uint8_t buf[64];
+
+	/* The BTS does not send anything here, just drain the socket */
+	recv(ofd->fd, buf, sizeof(buf), 0);
+	return 0;
+}
+
+static int open_sock(struct osmo_fd *ofd, uint16_t offset,
+		     int (*cb)(struct osmo_fd *fd, unsigned int what), void *data)
+{
+	int rc;
+
+	osmo_fd_setup(ofd, -1, OSMO_FD_READ, cb, data, 0);
+	rc = osmo_sock_init2_ofd(ofd, AF_UNSPEC, SOCK_DGRAM, IPPROTO_UDP,
+				 cfg.local_ip, cfg.base_port_local + offset,
+				 cfg.remote_ip, cfg.base_port_remote + offset,
+				 OSMO_SOCK_F_BIND | OSMO_SOCK_F_CONNECT);
+	if (rc < 0)
+		fprintf(stderr, "Failed to open UDP socket %s:%u -> %s:%u\n",
+			cfg.local_ip, cfg.base_port_local + offset,
+			cfg.remote_ip, cfg.base_port_remote + offset);
+	return rc;
+}
+
+/* Collect the Uplink records of the capture */
+static int load_capture(void *ctx, const void *map, size_t map_len)
+{
+	struct trx_capture_iter it;
+	const struct trx_capture_rec *rec;
+	unsigned int n = 0;
+
+	if (trx_capture_iter_init(&it, map, map_len) < 0) {
+		fprintf(stderr, "Not a TRXD capture file\n");
+		return -EINVAL;
+	}
+
+	replay.recs = talloc_array(ctx, const struct trx_capture_rec *,
+				   it.hdr->num_recs > 0 ? it.hdr->num_recs : 1);
+	if (replay.recs == NULL)
+		return -ENOMEM;
+
+	while ((rec = trx_capture_iter_next(&it)) != NULL) {
+		if (rec->dir != TRX_CAPTURE_UL || rec->len == 0)
+			continue;
+		if (rec->phy_inst >= REPLAY_MAX_INST) {
+			fprintf(stderr, "Skipping datagram of PHY instance %u\n", rec->phy_inst);
+			continue;
+		}
+		if (n == it.hdr->num_recs)
+			break;
+		replay.recs[n++] = rec;
+		replay.num_inst = OSMO_MAX(replay.num_inst, rec->phy_inst + 1);
+	}
+
+	if (it.left > 0)
+		fprintf(stderr, "Capture file is truncated or corrupted, "
+			"replaying the first %u datagram(s)\n", n);
+
+	if (n == 0) {
+		fprintf(stderr, "No Uplink datagrams in the capture file\n");
+		return -ENOENT;
+	}
+
+	replay.num_recs = n;
+	replay.pdu_ver = replay.recs[0]->data[0] >> 4;
+	replay.fn_first = rec_fn(replay.recs[0]);
+
+	return 0;
+}
+
+static void print_help(const char *prog)
+{
+	printf("Usage: %s [OPTIONS] CAPTURE-FILE\n"
+	       "  -h --help                 This help message\n"
+	       "  -f --fast                 Send the datagrams back-to-back (default: real time)\n"
+	       "  -l --local-ip IP          Local (transceiver) IP address (default: %s)\n"
+	       "  -r --remote-ip IP         Remote (BTS) IP address (default: %s)\n"
+	       "  -p --base-port-local N    Local base port (default: %u)\n"
+	       "  -P --base-port-remote N   Remote base port (default: %u)\n"
+	       "  -n --nominal-power DBM    Nominal Tx power to report (default: %d)\n",
+	       prog, cfg.local_ip, cfg.remote_ip, cfg.base_port_local,
+	       cfg.base_port_remote, cfg.nominal_power);
+}
+
+static int handle_options(int argc, char **argv)
+{
+	while (1) {
+		int option_index = 0, c;
+		static const struct option long_options[] = {
+			{ "help", 0, 0, 'h' },
+			{ "fast", 0, 0, 'f' },
+			{ "local-ip", 1, 0, 'l' },
+			{ "remote-ip", 1, 0, 'r' },
+			{ "base-port-local", 1, 0, 'p' },
+			{ "base-port-remote", 1, 0, 'P' },
+			{ "nominal-power", 1, 0, 'n' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "hfl:r:p:P:n:",
+				long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			print_help(argv[0]);
+			exit(0);
+		case 'f':
+			cfg.fast = true;
+			break;
+		case 'l':
+			cfg.local_ip = optarg;
+			break;
+		case 'r':
+			cfg.remote_ip = optarg;
+			break;
+		case 'p':
+			cfg.base_port_local = atoi(optarg);
+			break;
+		case 'P':
+			cfg.base_port_remote = atoi(optarg);
+			break;
+		case 'n':
+			cfg.nominal_power = atoi(optarg);
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	if (optind != argc - 1) {
+		print_help(argv[0]);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 0, "trx_replay");
+	unsigned long dl_num = 0;
+	uint64_t elapsed_ns;
+	struct stat st;
+	unsigned int i;
+	void *map;
+	int fd;
+
+	if (handle_options(argc, argv) < 0)
+		return EXIT_FAILURE;
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stderr, "Failed to open '%s': %s\n", argv[optind], strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Failed to map '%s': %s\n", argv[optind], strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (load_capture(ctx, map, st.st_size) < 0)
+		return EXIT_FAILURE;
+
+	fprintf(stderr, "Loaded %u Uplink datagram(s) for %u PHY instance(s), "
+		"TRXDv%u, first fn=%u\n", replay.num_recs, replay.num_inst,
+		replay.pdu_ver, replay.fn_first);
+
+	if (open_sock(&replay.ofd_clk, 0, clk_read_cb, NULL) < 0)
+		return EXIT_FAILURE;
+	for (i = 0; i < replay.num_inst; i++) {
+		struct replay_inst *inst = &replay.inst[i];
+
+		if (open_sock(&inst->ofd_ctrl, (i << 1) + 1, ctrl_read_cb, inst) < 0)
+			return EXIT_FAILURE;
+		if (open_sock(&inst->ofd_data, (i << 1) + 2, data_read_cb, inst) < 0)
+			return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "Waiting for osmo-bts-trx to power on the transceiver\n");
+
+	while (!replay.done)
+		osmo_select_main(0);
+
+	elapsed_ns = now_ns() - replay.start_ns;
+	for (i = 0; i < replay.num_inst; i++)
+		dl_num += replay.inst[i].dl_num;
+
+	printf("Replayed %lu Uplink datagram(s) in %.3f s, received %lu Downlink datagram(s)\n",
+	       replay.ul_num, elapsed_ns / 1e9, dl_num);
+
+	munmap(map, st.st_size);
+	close(fd);
+	talloc_free(ctx);
+
+	return EXIT_SUCCESS;
+}
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <stdint.h>
 #include <ctype.h>
 #include <inttypes.h>
@@ -42,11 +43,15 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/vty.h>
 #include <osmo-bts/scheduler.h>
+#include <osmo-bts/scheduler_backend.h>
 #include <osmo-bts/bts.h>
 
 #include "l1_if.h"
 #include "trx_if.h"
+#include "trx_capture.h"
 #include "amr_loop.h"
+#include "ul_decoder.h"
+#include "cpu_placement.h"
 
 #define X(x) (1 << x)
 
@@ -88,6 +93,11 @@ DEFUN(show_transceiver, show_transceiver_cmd, "show transceiver",
 				VTY_NEWLINE);
 		else
 			vty_out(vty, " bsic   : undefined%s", VTY_NEWLINE);
+		if (plink->u.osmotrx.trxd_seqnum && l1h->trx_ofd_data.fd >= 0)
+			vty_out(vty, " trxd rx: %u datagrams, %u lost, %u reordered, jitter %u us%s",
+				l1h->trxd_rx_seq.num, l1h->trxd_rx_seq.lost,
+				l1h->trxd_rx_seq.reordered, l1h->trxd_rx_seq.jitter_us16 >> 4,
+				VTY_NEWLINE);
 
 		/* trx->ts[tn].priv is NULL in absence of the A-bis connection */
 		if (trx->rsl_link == NULL)
@@ -98,13 +108,17 @@ DEFUN(show_transceiver, show_transceiver_cmd, "show transceiver",
 			const struct l1sched_ts *l1ts = ts->priv;
 			const struct trx_sched_multiframe *mf;
 
-			OSMO_ASSERT(l1ts != NULL);
+			/* allocated once the timeslot gets a channel combination */
+			if (l1ts == NULL) {
+				vty_out(vty, "  timeslot #%u (NONE)%s", tn, VTY_NEWLINE);
+				continue;
+			}
 			mf = &trx_sched_multiframes[l1ts->mf_index];
 
 			vty_out(vty, "  timeslot #%u (%s)%s",
 				tn, mf->name, VTY_NEWLINE);
 			vty_out(vty, "    pending DL prims    : %u%s",
-				llist_count(&l1ts->dl_prims), VTY_NEWLINE);
+				l1ts->dl_prims_num, VTY_NEWLINE);
 			vty_out(vty, "    interference        : %ddBm%s",
 				l1ts->chan_state[TRXC_IDLE].meas.interf_avg,
 				VTY_NEWLINE);
@@ -114,6 +128,54 @@ DEFUN(show_transceiver, show_transceiver_cmd, "show transceiver",
 	return CMD_SUCCESS;
 }
 
+static const char *cpu_dir_names[_L1SCHED_CPU_DIR_NUM] = {
+	[L1SCHED_CPU_RTS]	= "RTS",
+	[L1SCHED_CPU_DL]	= "DL",
+	[L1SCHED_CPU_UL]	= "UL",
+};
+
+DEFUN(show_trx_ts_cpu, show_trx_ts_cpu_cmd,
+	"show trx <0-255> ts <0-7> cpu",
+	SHOW_STR "Display information about a TRX\n"
+	"TRX number\n" "Timeslot\n" "Timeslot number\n"
+	"Display the CPU time of the scheduler handlers (see 'scheduler cpu-accounting')\n")
+{
+	const struct gsm_bts_trx *trx = gsm_bts_trx_num(g_bts, atoi(argv[0]));
+	const struct l1sched_ts *l1ts;
+	unsigned int dir, chan;
+
+	if (trx == NULL) {
+		vty_out(vty, "%% can't find TRX '%s'%s", argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	/* trx->ts[tn].priv is NULL in absence of a channel combination */
+	l1ts = trx->ts[atoi(argv[1])].priv;
+	if (l1ts == NULL) {
+		vty_out(vty, "%% timeslot is not initialized%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	vty_out(vty, "TRX %u, Timeslot %s (%s): CPU accounting %s%s",
+		trx->nr, argv[1], trx_sched_multiframes[l1ts->mf_index].name,
+		g_bts->sched_cpu_acct ? "enabled" : "disabled", VTY_NEWLINE);
+	vty_out(vty, "  %-12s %-3s %10s %12s %8s %8s%s",
+		"Channel", "Dir", "Calls", "Total (us)", "Avg (ns)", "Max (ns)", VTY_NEWLINE);
+
+	for (chan = 0; chan < _TRX_CHAN_MAX; chan++) {
+		for (dir = 0; dir < _L1SCHED_CPU_DIR_NUM; dir++) {
+			const struct l1sched_cpu_stats *st = &l1ts->cpu[dir][chan];
+
+			if (st->calls == 0)
+				continue;
+			vty_out(vty, "  %-12s %-3s %10u %12" PRIu64 " %8" PRIu64 " %8u%s",
+				trx_chan_desc[chan].name, cpu_dir_names[dir], st->calls,
+				st->ns / 1000, st->ns / st->calls, st->max_ns, VTY_NEWLINE);
+		}
+	}
+
+	return CMD_SUCCESS;
+}
 
 static void show_phy_inst_single(struct vty *vty, struct phy_instance *pinst)
 {
@@ -175,6 +237,15 @@ static void show_phy_single(struct vty *vty, struct phy_link *plink)
 
 	vty_out(vty, "PHY %u%s", plink->num, VTY_NEWLINE);
 
+	if (plink->u.osmotrx.capture != NULL) {
+		const struct trx_capture_file_hdr *hdr;
+
+		hdr = trx_capture_hdr(plink->u.osmotrx.capture);
+		vty_out(vty, " TRXD capture: %" PRIu64 " datagram(s) written, "
+			"%" PRIu64 " of %" PRIu64 " bytes in use%s",
+			hdr->num_recs, hdr->used, hdr->ring_len, VTY_NEWLINE);
+	}
+
 	llist_for_each_entry(pinst, &plink->instances, list)
 		show_phy_inst_single(vty, pinst);
 }
@@ -194,6 +265,206 @@ DEFUN(show_phy, show_phy_cmd, "show phy",
 	return CMD_SUCCESS;
 }
 
+static void show_cpu_placement_phy(struct vty *vty, const struct phy_link *plink)
+{
+	const struct phy_instance *pinst;
+
+	vty_out(vty, "PHY %u: cpus %s, mem-node ", plink->num,
+		plink->u.osmotrx.placement.cpus ? : "(not set)");
+	if (plink->u.osmotrx.placement.mem_node >= 0)
+		vty_out(vty, "%d", plink->u.osmotrx.placement.mem_node);
+	else
+		vty_out(vty, "(not set)");
+	vty_out(vty, "%s", VTY_NEWLINE);
+
+	llist_for_each_entry(pinst, &plink->instances, list) {
+		const struct trx_l1h *l1h = pinst->u.osmotrx.hdl;
+		int incoming_cpu, busy_poll;
+
+		if (l1h == NULL || l1h->trx_ofd_data.fd < 0)
+			continue;
+		cpu_placement_trxd_get(l1h->trx_ofd_data.fd, &incoming_cpu, &busy_poll);
+		vty_out(vty, " %s TRXD socket: incoming-cpu %d (configured %d), "
+			"busy-poll %d us (configured %u us)%s",
+			phy_instance_name(pinst), incoming_cpu,
+			plink->u.osmotrx.placement.trxd_incoming_cpu,
+			busy_poll, plink->u.osmotrx.placement.trxd_busy_poll, VTY_NEWLINE);
+	}
+}
+
+DEFUN(show_cpu_placement, show_cpu_placement_cmd,
+	"show cpu-placement",
+	SHOW_STR "Display the effective CPU and memory placement (see 'osmotrx cpu-placement')\n")
+{
+	char buf[256];
+	pthread_t thread;
+	unsigned int i;
+
+	if (cpu_placement_thread_cpus(pthread_self(), buf, sizeof(buf)) == 0)
+		vty_out(vty, "Main thread: CPUs %s, running on CPU %d%s",
+			buf, cpu_placement_current_cpu(), VTY_NEWLINE);
+	if (cpu_placement_mem_policy(buf, sizeof(buf)) == 0)
+		vty_out(vty, "Main thread: memory policy %s%s", buf, VTY_NEWLINE);
+
+	for (i = 0; trx_ul_decoder_thread(i, &thread); i++) {
+		if (cpu_placement_thread_cpus(thread, buf, sizeof(buf)) == 0)
+			vty_out(vty, "Uplink decoder thread %u: CPUs %s%s", i, buf, VTY_NEWLINE);
+	}
+
+	for (i = 0; i < 255; i++) {
+		const struct phy_link *plink = phy_link_by_num(i);
+		if (!plink)
+			break;
+		show_cpu_placement_phy(vty, plink);
+	}
+
+	return CMD_SUCCESS;
+}
+
+#define PHY_CAPTURE_STR \
+	"Select a PHY\n" "PHY number\n" \
+	"Capture of TRXD datagrams into a file (for osmo-bts-trx-replay)\n"
+
+DEFUN(phy_capture_start, phy_capture_start_cmd,
+	"phy <0-255> capture start FILE [<1-4096>]",
+	PHY_CAPTURE_STR "Start capturing, overwriting the oldest datagrams when the file is full\n"
+	"Name of the capture file (truncated if it exists)\n"
+	"Size of the capture file in MiB (default 64)\n")
+{
+	int phy_nr = atoi(argv[0]);
+	struct phy_link *plink = phy_link_by_num(phy_nr);
+	size_t size_mb = 64;
+	struct trx_capture *cap;
+
+	if (!plink) {
+		vty_out(vty, "%% Cannot find PHY number %d%s", phy_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (plink->u.osmotrx.capture != NULL) {
+		vty_out(vty, "%% PHY %d is already being captured%s", phy_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (argc > 2)
+		size_mb = atoi(argv[2]);
+
+	cap = trx_capture_start(plink, argv[1], size_mb << 20,
+				plink->u.osmotrx.clock_advance);
+	if (cap == NULL) {
+		vty_out(vty, "%% Failed to start capturing into '%s': %s%s",
+			argv[1], strerror(errno), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	plink->u.osmotrx.capture = cap;
+	LOGPPHL(plink, DTRX, LOGL_NOTICE, "Started TRXD capture into '%s' (%zu MiB)\n",
+		argv[1], size_mb);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(phy_capture_stop, phy_capture_stop_cmd,
+	"phy <0-255> capture stop",
+	PHY_CAPTURE_STR "Stop capturing and close the file\n")
+{
+	int phy_nr = atoi(argv[0]);
+	struct phy_link *plink = phy_link_by_num(phy_nr);
+	const struct trx_capture_file_hdr *hdr;
+
+	if (!plink) {
+		vty_out(vty, "%% Cannot find PHY number %d%s", phy_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (plink->u.osmotrx.capture == NULL) {
+		vty_out(vty, "%% PHY %d is not being captured%s", phy_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	hdr = trx_capture_hdr(plink->u.osmotrx.capture);
+	LOGPPHL(plink, DTRX, LOGL_NOTICE, "Stopped TRXD capture (%" PRIu64 " datagrams)\n",
+		hdr->num_recs);
+
+	trx_capture_stop(plink->u.osmotrx.capture);
+	plink->u.osmotrx.capture = NULL;
+
+	return CMD_SUCCESS;
+}
+
+static void show_clk_hist(struct vty *vty, const char *name,
+			  const struct trx_clk_hist *hist)
+{
+	unsigned int i;
+
+	vty_out(vty, " %s: %u samples, max %u us%s",
+		name, hist->count, hist->max_us, VTY_NEWLINE);
+
+	for (i = 0; i < ARRAY_SIZE(hist->buckets); i++) {
+		if (!hist->buckets[i])
+			continue;
+		if (i == 0)
+			vty_out(vty, "  %12s : %u%s", "< 1 us",
+				hist->buckets[i], VTY_NEWLINE);
+		else if (i == ARRAY_SIZE(hist->buckets) - 1)
+			vty_out(vty, "  >= %6u us : %u%s", 1U << (i - 1),
+				hist->buckets[i], VTY_NEWLINE);
+		else
+			vty_out(vty, "  %5u..%-5u us : %u%s", 1U << (i - 1), (1U << i) - 1,
+				hist->buckets[i], VTY_NEWLINE);
+	}
+}
+
+DEFUN(show_phy_clock_stats, show_phy_clock_stats_cmd,
+	"show phy <0-255> clock-stats",
+	SHOW_STR "Display information about the available PHYs\n"
+	"PHY number\n" "Display TDMA frame clock statistics\n")
+{
+	int phy_nr = atoi(argv[0]);
+	struct phy_link *plink = phy_link_by_num(phy_nr);
+	const struct bts_trx_priv *bts_trx;
+	const struct osmo_trx_clock_state *tcs;
+	struct phy_instance *pinst;
+
+	if (!plink) {
+		vty_out(vty, "%% Cannot find PHY number %d%s", phy_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	pinst = phy_instance_by_num(plink, 0);
+	if (!pinst || !pinst->trx) {
+		vty_out(vty, "%% PHY %d is not bound to a TRX%s", phy_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	bts_trx = (const struct bts_trx_priv *) pinst->trx->bts->model_priv;
+	tcs = &bts_trx->clk_s;
+
+	vty_out(vty, "PHY %u TDMA frame clock statistics:%s", plink->num, VTY_NEWLINE);
+	show_clk_hist(vty, "FN timer scheduling error", &tcs->sched_err_hist);
+	show_clk_hist(vty, "TDMA frame processing time", &tcs->proc_time_hist);
+	if (plink->u.osmotrx.rts_advance_auto.enabled)
+		vty_out(vty, " rts-advance: %u (auto, %u..%u)%s", plink->u.osmotrx.rts_advance,
+			plink->u.osmotrx.rts_advance_auto.min,
+			plink->u.osmotrx.rts_advance_auto.max, VTY_NEWLINE);
+	else
+		vty_out(vty, " rts-advance: %u%s", plink->u.osmotrx.rts_advance, VTY_NEWLINE);
+	if (plink->u.osmotrx.clock_filter && tcs->est.valid)
+		vty_out(vty, " clock-filter: drift %+" PRId64 " ppb, jitter %" PRId64 " us, "
+			"interval %" PRId64 " ns%s", tcs->est.drift_ppb, tcs->est.jitter_us16 >> 4,
+			tcs->est.interval_ns, VTY_NEWLINE);
+	if (bts_trx->fn_budget.enabled) {
+		unsigned int i;
+
+		vty_out(vty, " fn-budget-watchdog: %u step(s) shed", bts_trx->fn_budget.level);
+		for (i = 0; i < bts_trx->fn_budget.level; i++)
+			vty_out(vty, "%s%s", i ? ", " : " (", fn_budget_step_name(i));
+		vty_out(vty, "%s%s", bts_trx->fn_budget.level ? ")" : "", VTY_NEWLINE);
+	}
+
+	return CMD_SUCCESS;
+}
+
 DEFUN_USRATTR(cfg_trx_nominal_power, cfg_trx_nominal_power_cmd,
 	      X(BTS_VTY_TRX_POWERCYCLE),
 	      "nominal-tx-power <-10-100>",
@@ -373,6 +644,36 @@ DEFUN_ATTR(cfg_phy_rts_advance, cfg_phy_rts_advance_cmd,
 	struct phy_link *plink = vty->index;
 
 	plink->u.osmotrx.rts_advance = atoi(argv[0]);
+	plink->u.osmotrx.rts_advance_auto.enabled = false;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_rts_advance_auto, cfg_phy_rts_advance_auto_cmd,
+	   "osmotrx rts-advance auto <0-30> <0-30>",
+	   OSMOTRX_STR
+	   "Set the number of frames to be requested (PCU) in advance of current "
+	   "FN. Do not change this, unless you have a good reason!\n"
+	   "Adjust automatically: grow on late Downlink frames, shrink when idle\n"
+	   "Minimum advance in frames\n"
+	   "Maximum advance in frames\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+	int min = atoi(argv[0]);
+	int max = atoi(argv[1]);
+
+	if (min > max) {
+		vty_out(vty, "%% Minimum (%d) must not exceed maximum (%d)%s",
+			min, max, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	plink->u.osmotrx.rts_advance_auto.min = min;
+	plink->u.osmotrx.rts_advance_auto.max = max;
+	plink->u.osmotrx.rts_advance_auto.quiet_periods = 0;
+	plink->u.osmotrx.rts_advance_auto.dl_late_valid = false;
+	plink->u.osmotrx.rts_advance_auto.enabled = true;
 
 	return CMD_SUCCESS;
 }
@@ -544,9 +845,9 @@ DEFUN_USRATTR(cfg_phy_trxd_max_version, cfg_phy_trxd_max_version_cmd,
 		max_ver = TRX_DATA_PDU_VER;
 	else
 		max_ver = atoi(argv[0]);
-	if (max_ver > TRX_DATA_PDU_VER) {
+	if (max_ver > TRX_DATA_PDU_VER_MAX) {
 		vty_out(vty, "%% Format version %d is not supported, maximum supported is %d%s",
-			max_ver, TRX_DATA_PDU_VER, VTY_NEWLINE);
+			max_ver, TRX_DATA_PDU_VER_MAX, VTY_NEWLINE);
 		return CMD_WARNING;
 	}
 	plink->u.osmotrx.trxd_pdu_ver_max = max_ver;
@@ -554,6 +855,357 @@ DEFUN_USRATTR(cfg_phy_trxd_max_version, cfg_phy_trxd_max_version_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN_USRATTR(cfg_phy_trxd_rx_batch, cfg_phy_trxd_rx_batch_cmd,
+	      X(BTS_VTY_TRX_POWERCYCLE),
+	      "osmotrx trxd-rx-batch <1-32>", OSMOTRX_STR
+	      "Set the maximum number of TRXD datagrams to receive per wakeup using recvmmsg()\n"
+	      "Batch depth (1 means one recv() per wakeup, default)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.trxd_rx_batch = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_trxc_window, cfg_phy_trxc_window_cmd,
+	   "osmotrx trxc-window <1-16>", OSMOTRX_STR
+	   "Set the maximum number of TRXC commands awaiting a response at the same time\n"
+	   "Number of commands (1 means strictly one by one, default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.trxc_window = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_USRATTR(cfg_phy_trxd_shared, cfg_phy_trxd_shared_cmd,
+	      X(BTS_VTY_TRX_POWERCYCLE),
+	      "osmotrx trxd-shared", OSMOTRX_STR
+	      "Use one TRXD socket for all PHY instances (TRXDv2 or newer, "
+	      "the PDUs are told apart by their TRX number)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.trxd_shared = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_USRATTR(cfg_phy_no_trxd_shared, cfg_phy_no_trxd_shared_cmd,
+	      X(BTS_VTY_TRX_POWERCYCLE),
+	      "no osmotrx trxd-shared", NO_STR OSMOTRX_STR
+	      "Use a TRXD socket per PHY instance (default)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.trxd_shared = false;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_clock_filter, cfg_phy_clock_filter_cmd,
+	   "osmotrx clock-filter", OSMOTRX_STR
+	   "Smooth the TRX clock indications: follow the rate of the TRX clock with "
+	   "the FN timer instead of resyncing it on every deviation\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.clock_filter = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_no_clock_filter, cfg_phy_no_clock_filter_cmd,
+	   "no osmotrx clock-filter", NO_STR OSMOTRX_STR
+	   "Resync the FN timer on every deviation of the TRX clock indications (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.clock_filter = false;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_USRATTR(cfg_phy_trxd_seqnum, cfg_phy_trxd_seqnum_cmd,
+	      X(BTS_VTY_TRX_POWERCYCLE),
+	      "osmotrx trxd-seqnum", OSMOTRX_STR
+	      "End each TRXD datagram with a sequence number to detect datagram loss "
+	      "and reordering (TRXDv2 or newer, the transceiver must do the same)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.trxd_seqnum = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_USRATTR(cfg_phy_no_trxd_seqnum, cfg_phy_no_trxd_seqnum_cmd,
+	      X(BTS_VTY_TRX_POWERCYCLE),
+	      "no osmotrx trxd-seqnum", NO_STR OSMOTRX_STR
+	      "Send TRXD datagrams without sequence number (default)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.trxd_seqnum = false;
+
+	return CMD_SUCCESS;
+}
+
+#define UL_DECODE_GATE_STR \
+	"Declare Uplink blocks bad without running the channel decoder\n"
+
+DEFUN_ATTR(cfg_phy_ul_decode_gate_erasures, cfg_phy_ul_decode_gate_erasures_cmd,
+	   "osmotrx ul-decode-gate erasures", OSMOTRX_STR UL_DECODE_GATE_STR
+	   "When all bursts of a block are erasures (NOPE.ind or not received)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_decode_gate.erasures = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_ul_decode_gate_ci, cfg_phy_ul_decode_gate_ci_cmd,
+	   "osmotrx ul-decode-gate ci <-100-100>", OSMOTRX_STR UL_DECODE_GATE_STR
+	   "When the average C/I of the bursts of a block is below a threshold\n"
+	   "C/I threshold in centiBels (cB)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_decode_gate.ci = true;
+	plink->u.osmotrx.ul_decode_gate.ci_cb = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_no_ul_decode_gate, cfg_phy_no_ul_decode_gate_cmd,
+	   "no osmotrx ul-decode-gate", NO_STR OSMOTRX_STR
+	   "Always run the channel decoder on Uplink blocks (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_decode_gate.erasures = false;
+	plink->u.osmotrx.ul_decode_gate.ci = false;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_ul_facch_steal_thresh, cfg_phy_ul_facch_steal_thresh_cmd,
+	   "osmotrx ul-facch-steal-threshold <1-1016>", OSMOTRX_STR
+	   "Predict FACCH on Uplink TCH from the soft stealing flags, skip the FACCH "
+	   "decoder on CSD blocks which are clearly not stolen\n"
+	   "Minimum magnitude of the soft sum of the 8 stealing flags of a block\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_facch_steal_thresh = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_no_ul_facch_steal_thresh, cfg_phy_no_ul_facch_steal_thresh_cmd,
+	   "no osmotrx ul-facch-steal-threshold", NO_STR OSMOTRX_STR
+	   "Always try to decode FACCH on Uplink CSD blocks (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_facch_steal_thresh = 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_dl_facch_max_delay, cfg_phy_dl_facch_max_delay_cmd,
+	   "osmotrx dl-facch-max-delay <25-250>", OSMOTRX_STR
+	   "Let a Downlink FACCH wait for a TCH block without speech instead of "
+	   "stealing a speech frame\n"
+	   "Longest time a FACCH may wait (ms)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.dl_facch_max_delay_ms = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_no_dl_facch_max_delay, cfg_phy_no_dl_facch_max_delay_cmd,
+	   "no osmotrx dl-facch-max-delay", NO_STR OSMOTRX_STR
+	   "Let a Downlink FACCH always steal the next TCH block (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.dl_facch_max_delay_ms = 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_dl_encode_ahead, cfg_phy_dl_encode_ahead_cmd,
+	   "osmotrx dl-encode-ahead", OSMOTRX_STR
+	   "Encode the Downlink xCCH blocks in the slack of the frames preceding their first burst\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.dl_encode_ahead = true;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_phy_no_dl_encode_ahead, cfg_phy_no_dl_encode_ahead_cmd,
+	   "no osmotrx dl-encode-ahead", NO_STR OSMOTRX_STR
+	   "Encode the Downlink xCCH blocks at their first burst (default)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.dl_encode_ahead = false;
+
+	return CMD_SUCCESS;
+}
+
+#define FN_BUDGET_STR \
+	"Shed optional work step by step when the TDMA frame processing runs out of headroom\n"
+
+DEFUN_ATTR(cfg_bts_fn_budget, cfg_bts_fn_budget_cmd,
+	   "fn-budget-watchdog high <20-100> low <10-90>", FN_BUDGET_STR
+	   "Shed the next step when a frame takes longer than this\n"
+	   "Percentage of the TDMA frame duration (default 80)\n"
+	   "Restore the last shed step when all frames stay below this\n"
+	   "Percentage of the TDMA frame duration (default 50)\n",
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct gsm_bts *bts = vty->index;
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *) bts->model_priv;
+	int high = atoi(argv[0]);
+	int low = atoi(argv[1]);
+
+	if (low >= high) {
+		vty_out(vty, "%% The low threshold must be below the high threshold%s", VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	bts_trx->fn_budget.enabled = true;
+	bts_trx->fn_budget.high_pct = high;
+	bts_trx->fn_budget.low_pct = low;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN_ATTR(cfg_bts_no_fn_budget, cfg_bts_no_fn_budget_cmd,
+	   "no fn-budget-watchdog", NO_STR FN_BUDGET_STR,
+	   CMD_ATTR_IMMEDIATE)
+{
+	struct gsm_bts *bts = vty->index;
+	struct bts_trx_priv *bts_trx = (struct bts_trx_priv *) bts->model_priv;
+
+	bts_trx->fn_budget.enabled = false;
+	fn_budget_restore_all(bts);
+
+	return CMD_SUCCESS;
+}
+
+#define CPU_PLACEMENT_STR \
+	"Keep the processing of this PHY link close to the transceiver " \
+	"(applied when the PHY link is opened)\n"
+
+DEFUN(cfg_phy_cpu_placement_cpus, cfg_phy_cpu_placement_cpus_cmd,
+      "osmotrx cpu-placement cpus LIST", OSMOTRX_STR CPU_PLACEMENT_STR
+      "Bind the main thread (scheduler, TRXD processing) and the Uplink decoder threads to CPUs\n"
+      "CPU list, e.g. 2-5,8\n")
+{
+	struct phy_link *plink = vty->index;
+
+	if (!cpu_placement_cpus_valid(argv[0])) {
+		vty_out(vty, "%% Invalid CPU list '%s'%s", argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	osmo_talloc_replace_string(plink, &plink->u.osmotrx.placement.cpus, argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_cpu_placement_mem_node, cfg_phy_cpu_placement_mem_node_cmd,
+      "osmotrx cpu-placement mem-node <0-63>", OSMOTRX_STR CPU_PLACEMENT_STR
+      "Prefer memory of a NUMA node for the scheduler structures and msgb pools\n"
+      "NUMA node number\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.placement.mem_node = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_cpu_placement_trxd_incoming_cpu, cfg_phy_cpu_placement_trxd_incoming_cpu_cmd,
+      "osmotrx cpu-placement trxd-incoming-cpu <0-4095>", OSMOTRX_STR CPU_PLACEMENT_STR
+      "Set SO_INCOMING_CPU on the TRXD sockets (with SO_REUSEPORT groups or RFS)\n"
+      "CPU number\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.placement.trxd_incoming_cpu = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_cpu_placement_trxd_busy_poll, cfg_phy_cpu_placement_trxd_busy_poll_cmd,
+      "osmotrx cpu-placement trxd-busy-poll <1-1000000>", OSMOTRX_STR CPU_PLACEMENT_STR
+      "Set SO_BUSY_POLL on the TRXD sockets (may require CAP_NET_ADMIN)\n"
+      "Busy polling time in microseconds\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.placement.trxd_busy_poll = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_no_cpu_placement, cfg_phy_no_cpu_placement_cmd,
+      "no osmotrx cpu-placement (cpus|mem-node|trxd-incoming-cpu|trxd-busy-poll)",
+      NO_STR OSMOTRX_STR CPU_PLACEMENT_STR
+      "Leave the CPU affinity to the kernel and the 'cpu-sched' node (default)\n"
+      "Use the default memory policy (default)\n"
+      "Do not set SO_INCOMING_CPU (default)\n"
+      "Do not set SO_BUSY_POLL (default)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	if (!strcmp(argv[0], "cpus"))
+		TALLOC_FREE(plink->u.osmotrx.placement.cpus);
+	else if (!strcmp(argv[0], "mem-node"))
+		plink->u.osmotrx.placement.mem_node = -1;
+	else if (!strcmp(argv[0], "trxd-incoming-cpu"))
+		plink->u.osmotrx.placement.trxd_incoming_cpu = -1;
+	else
+		plink->u.osmotrx.placement.trxd_busy_poll = 0;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_phy_ul_decoder_threads, cfg_phy_ul_decoder_threads_cmd,
+      "osmotrx ul-decoder-threads <0-16>", OSMOTRX_STR
+      "Decode Uplink PDTCH blocks asynchronously in a pool of worker threads. "
+      "The pool is started on first use and shared by all PHY links.\n"
+      "Number of threads (0 means decode inline, default)\n")
+{
+	struct phy_link *plink = vty->index;
+
+	plink->u.osmotrx.ul_decoder_threads = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
 void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink)
 {
 	if (plink->u.osmotrx.local_ip)
@@ -574,12 +1226,55 @@ void bts_model_config_write_phy(struct vty *vty, const struct phy_link *plink)
 		plink->u.osmotrx.clock_advance, VTY_NEWLINE);
 	vty_out(vty, " osmotrx rts-advance %d%s",
 		plink->u.osmotrx.rts_advance, VTY_NEWLINE);
+	if (plink->u.osmotrx.rts_advance_auto.enabled)
+		vty_out(vty, " osmotrx rts-advance auto %u %u%s",
+			plink->u.osmotrx.rts_advance_auto.min,
+			plink->u.osmotrx.rts_advance_auto.max, VTY_NEWLINE);
 
 	if (plink->u.osmotrx.use_legacy_setbsic)
 		vty_out(vty, " osmotrx legacy-setbsic%s", VTY_NEWLINE);
 
 	if (plink->u.osmotrx.trxd_pdu_ver_max != TRX_DATA_PDU_VER)
 		vty_out(vty, " osmotrx trxd-max-version %d%s", plink->u.osmotrx.trxd_pdu_ver_max, VTY_NEWLINE);
+
+	if (plink->u.osmotrx.trxd_rx_batch > 1)
+		vty_out(vty, " osmotrx trxd-rx-batch %u%s", plink->u.osmotrx.trxd_rx_batch, VTY_NEWLINE);
+	if (plink->u.osmotrx.trxc_window > 1)
+		vty_out(vty, " osmotrx trxc-window %u%s", plink->u.osmotrx.trxc_window, VTY_NEWLINE);
+	if (plink->u.osmotrx.trxd_shared)
+		vty_out(vty, " osmotrx trxd-shared%s", VTY_NEWLINE);
+	if (plink->u.osmotrx.trxd_seqnum)
+		vty_out(vty, " osmotrx trxd-seqnum%s", VTY_NEWLINE);
+	if (plink->u.osmotrx.clock_filter)
+		vty_out(vty, " osmotrx clock-filter%s", VTY_NEWLINE);
+	if (plink->u.osmotrx.ul_decode_gate.erasures)
+		vty_out(vty, " osmotrx ul-decode-gate erasures%s", VTY_NEWLINE);
+	if (plink->u.osmotrx.ul_decode_gate.ci)
+		vty_out(vty, " osmotrx ul-decode-gate ci %d%s",
+			plink->u.osmotrx.ul_decode_gate.ci_cb, VTY_NEWLINE);
+	if (plink->u.osmotrx.ul_facch_steal_thresh > 0)
+		vty_out(vty, " osmotrx ul-facch-steal-threshold %u%s",
+			plink->u.osmotrx.ul_facch_steal_thresh, VTY_NEWLINE);
+	if (plink->u.osmotrx.dl_facch_max_delay_ms > 0)
+		vty_out(vty, " osmotrx dl-facch-max-delay %u%s",
+			plink->u.osmotrx.dl_facch_max_delay_ms, VTY_NEWLINE);
+	if (plink->u.osmotrx.dl_encode_ahead)
+		vty_out(vty, " osmotrx dl-encode-ahead%s", VTY_NEWLINE);
+	if (plink->u.osmotrx.placement.cpus)
+		vty_out(vty, " osmotrx cpu-placement cpus %s%s",
+			plink->u.osmotrx.placement.cpus, VTY_NEWLINE);
+	if (plink->u.osmotrx.placement.mem_node >= 0)
+		vty_out(vty, " osmotrx cpu-placement mem-node %d%s",
+			plink->u.osmotrx.placement.mem_node, VTY_NEWLINE);
+	if (plink->u.osmotrx.placement.trxd_incoming_cpu >= 0)
+		vty_out(vty, " osmotrx cpu-placement trxd-incoming-cpu %d%s",
+			plink->u.osmotrx.placement.trxd_incoming_cpu, VTY_NEWLINE);
+	if (plink->u.osmotrx.placement.trxd_busy_poll > 0)
+		vty_out(vty, " osmotrx cpu-placement trxd-busy-poll %u%s",
+			plink->u.osmotrx.placement.trxd_busy_poll, VTY_NEWLINE);
+	if (plink->u.osmotrx.ul_decoder_threads > 0)
+		vty_out(vty, " osmotrx ul-decoder-threads %u%s",
+			plink->u.osmotrx.ul_decoder_threads, VTY_NEWLINE);
 }
 
 void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance *pinst)
@@ -613,6 +1308,11 @@ void bts_model_config_write_phy_inst(struct vty *vty, const struct phy_instance
 
 void bts_model_config_write_bts(struct vty *vty, const struct gsm_bts *bts)
 {
+	const struct bts_trx_priv *bts_trx = (const struct bts_trx_priv *) bts->model_priv;
+
+	if (bts_trx->fn_budget.enabled)
+		vty_out(vty, " fn-budget-watchdog high %u low %u%s",
+			bts_trx->fn_budget.high_pct, bts_trx->fn_budget.low_pct, VTY_NEWLINE);
 }
 
 void bts_model_config_write_trx(struct vty *vty, const struct gsm_bts_trx *trx)
@@ -628,7 +1328,16 @@ void bts_model_config_write_trx(struct vty *vty, const struct gsm_bts_trx *trx)
 int bts_model_vty_init(void *ctx)
 {
 	install_element_ve(&show_transceiver_cmd);
+	install_element_ve(&show_trx_ts_cpu_cmd);
 	install_element_ve(&show_phy_cmd);
+	install_element_ve(&show_phy_clock_stats_cmd);
+	install_element_ve(&show_cpu_placement_cmd);
+
+	install_element(ENABLE_NODE, &phy_capture_start_cmd);
+	install_element(ENABLE_NODE, &phy_capture_stop_cmd);
+
+	install_element(BTS_NODE, &cfg_bts_fn_budget_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_fn_budget_cmd);
 
 	install_element(TRX_NODE, &cfg_trx_nominal_power_cmd);
 	install_element(TRX_NODE, &cfg_trx_no_nominal_power_cmd);
@@ -640,11 +1349,35 @@ int bts_model_vty_init(void *ctx)
 	install_element(PHY_NODE, &cfg_phy_base_port_cmd);
 	install_element(PHY_NODE, &cfg_phy_fn_advance_cmd);
 	install_element(PHY_NODE, &cfg_phy_rts_advance_cmd);
+	install_element(PHY_NODE, &cfg_phy_rts_advance_auto_cmd);
 	install_element(PHY_NODE, &cfg_phy_transc_ip_cmd);
 	install_element(PHY_NODE, &cfg_phy_osmotrx_ip_cmd);
 	install_element(PHY_NODE, &cfg_phy_setbsic_cmd);
 	install_element(PHY_NODE, &cfg_phy_no_setbsic_cmd);
 	install_element(PHY_NODE, &cfg_phy_trxd_max_version_cmd);
+	install_element(PHY_NODE, &cfg_phy_trxd_rx_batch_cmd);
+	install_element(PHY_NODE, &cfg_phy_trxc_window_cmd);
+	install_element(PHY_NODE, &cfg_phy_trxd_shared_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_trxd_shared_cmd);
+	install_element(PHY_NODE, &cfg_phy_trxd_seqnum_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_trxd_seqnum_cmd);
+	install_element(PHY_NODE, &cfg_phy_clock_filter_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_clock_filter_cmd);
+	install_element(PHY_NODE, &cfg_phy_ul_decode_gate_erasures_cmd);
+	install_element(PHY_NODE, &cfg_phy_ul_decode_gate_ci_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_ul_decode_gate_cmd);
+	install_element(PHY_NODE, &cfg_phy_ul_facch_steal_thresh_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_ul_facch_steal_thresh_cmd);
+	install_element(PHY_NODE, &cfg_phy_dl_facch_max_delay_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_dl_facch_max_delay_cmd);
+	install_element(PHY_NODE, &cfg_phy_dl_encode_ahead_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_dl_encode_ahead_cmd);
+	install_element(PHY_NODE, &cfg_phy_cpu_placement_cpus_cmd);
+	install_element(PHY_NODE, &cfg_phy_cpu_placement_mem_node_cmd);
+	install_element(PHY_NODE, &cfg_phy_cpu_placement_trxd_incoming_cpu_cmd);
+	install_element(PHY_NODE, &cfg_phy_cpu_placement_trxd_busy_poll_cmd);
+	install_element(PHY_NODE, &cfg_phy_no_cpu_placement_cmd);
+	install_element(PHY_NODE, &cfg_phy_ul_decoder_threads_cmd);
 
 	install_element(PHY_INST_NODE, &cfg_phyinst_rxgain_cmd);
 	install_element(PHY_INST_NODE, &cfg_phyinst_tx_atten_cmd);
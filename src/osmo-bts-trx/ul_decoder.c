@@ -0,0 +1,463 @@
+/* Asynchronous Uplink channel decoding in a pool of worker threads */
+
+/* (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The worker threads only ever run the (pure) channel decoder on a copy
+ * of the soft-bits of a complete block.  Everything else, including the
+ * allocation of jobs, logging and the delivery of the decoded block via
+ * _sched_compose_pdtch_ind() or _sched_compose_ph_data_ind(), happens on
+ * the main thread.  Decoded
+ * blocks are delivered in the order they have been submitted.
+ *
+ * PDTCH blocks of all timeslots end on the same TDMA frames, so blocks are
+ * not handed over to the workers one by one, but collected into a batch
+ * per block period.  The batch is passed to the workers at once, when the
+ * first block of the next period is submitted or on the next frame clock
+ * tick at the latest (see trx_ul_decoder_flush()).  The 8PSK (MCS-5..9)
+ * blocks, which take several times longer to decode, are queued in front
+ * of the GMSK ones, so that the long jobs get spread over the workers
+ * first and the short ones fill the gaps.
+ */
+
+#define _GNU_SOURCE /* pthread_setname_np() */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer_compat.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm0502.h>
+#include <osmocom/coding/gsm0503_coding.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/phy_link.h>
+#include <osmo-bts/scheduler.h>
+#include <osmo-bts/scheduler_backend.h>
+
+#include <sched_utils.h>
+
+#include "l1_if.h"
+#include "ul_decoder.h"
+#include "cpu_placement.h"
+
+struct ul_dec_job {
+	struct llist_head list;
+	/*! submission order, results are delivered in this order */
+	uint32_t seq;
+	/*! time of submission, for the latency statistics */
+	struct timespec tv_submit;
+
+	/* where and when the block was received */
+	struct gsm_bts_trx *trx;
+	uint8_t tn;
+	enum trx_chan_type chan;
+	uint32_t gen; /* generation of the logical channel, see l1sched_chan_state */
+	uint32_t fn; /* TDMA FN of the first burst */
+	struct l1sched_meas_set meas_avg;
+
+	/* soft-bits of the block */
+	bool is_8psk; /* 8PSK bursts: MCS-5..9 */
+	bool try_gprs; /* GMSK bursts: try CS-1..4 if EGPRS decoding fails */
+	int n_bursts_bits;
+	sbit_t bursts[GSM0503_EGPRS_BURSTS_NBITS];
+
+	/* decoding results, filled in by the worker thread */
+	int rc;
+	int n_errors;
+	int n_bits_total;
+	uint8_t l2[EGPRS_0503_MAX_BYTES];
+};
+
+static struct {
+	bool running;
+	bool start_failed;
+	unsigned int num_threads;
+	pthread_t *threads;
+
+	/* protects 'pending' and 'done' */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* jobs waiting for a worker thread */
+	struct llist_head pending;
+	/* decoded jobs waiting for the main thread */
+	struct llist_head done;
+
+	/* main thread only: decoded jobs waiting for their predecessors */
+	struct llist_head reorder;
+	/* main thread only: jobs of the current block period, not yet queued */
+	struct llist_head batch;
+	struct llist_head *batch_gmsk; /* first GMSK job of the batch (or the head) */
+	unsigned int batch_len;
+	uint32_t batch_fn;
+	/* main thread only: signalled by the workers when a job is done */
+	struct osmo_fd event_ofd;
+	uint32_t submit_seq;
+	uint32_t deliver_seq;
+	unsigned int inflight;
+} g_ul_dec;
+
+static void ul_dec_job_decode(struct ul_dec_job *job)
+{
+	job->rc = gsm0503_pdtch_egprs_decode(job->l2, job->bursts, job->n_bursts_bits,
+					     NULL, &job->n_errors, &job->n_bits_total);
+	if (job->try_gprs && job->rc < 0) {
+		job->rc = gsm0503_pdtch_decode(job->l2, job->bursts, NULL,
+					       &job->n_errors, &job->n_bits_total);
+	}
+}
+
+static void *ul_dec_worker(void *arg)
+{
+	const uint64_t one = 1;
+	struct ul_dec_job *job;
+	bool count_busy;
+
+	/* the busy time is counted unless there are more workers than slots */
+	count_busy = rate_ctr_shard_thread_register() == 0;
+
+	while (true) {
+		struct timespec tv_start, tv_done, tv_diff;
+
+		pthread_mutex_lock(&g_ul_dec.lock);
+		while (llist_empty(&g_ul_dec.pending))
+			pthread_cond_wait(&g_ul_dec.cond, &g_ul_dec.lock);
+		job = llist_first_entry(&g_ul_dec.pending, struct ul_dec_job, list);
+		llist_del(&job->list);
+		pthread_mutex_unlock(&g_ul_dec.lock);
+
+		clock_gettime(CLOCK_MONOTONIC, &tv_start);
+		ul_dec_job_decode(job);
+		clock_gettime(CLOCK_MONOTONIC, &tv_done);
+
+		if (count_busy) {
+			struct bts_trx_priv *bts_trx = (struct bts_trx_priv *)job->trx->bts->model_priv;
+
+			timespecsub(&tv_done, &tv_start, &tv_diff);
+			rate_ctr_shard_add(bts_trx->ctrs_shard, BTSTRX_CTR_UL_DEC_BUSY_US,
+					   tv_diff.tv_sec * 1000000 + tv_diff.tv_nsec / 1000);
+		}
+
+		pthread_mutex_lock(&g_ul_dec.lock);
+		llist_add_tail(&job->list, &g_ul_dec.done);
+		pthread_mutex_unlock(&g_ul_dec.lock);
+
+		/* wake up the main thread; the eventfd counter cannot overflow here */
+		if (write(g_ul_dec.event_ofd.fd, &one, sizeof(one)) != sizeof(one))
+			continue;
+	}
+
+	return NULL;
+}
+
+/* The decoder threads and the batch are shared by all TRX, just like the
+ * stat items of the BTS they are reported in */
+static void ul_dec_update_stats(const struct gsm_bts *bts, const struct ul_dec_job *job)
+{
+	const struct bts_trx_priv *bts_trx = (const struct bts_trx_priv *)bts->model_priv;
+	struct timespec tv_now, tv_diff;
+
+	osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_UL_DEC_INFLIGHT),
+			   g_ul_dec.inflight);
+	if (job == NULL) {
+		osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_UL_DEC_BATCH_LEN),
+				   g_ul_dec.batch_len);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &tv_now);
+	timespecsub(&tv_now, &job->tv_submit, &tv_diff);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(bts_trx->stats, BTSTRX_STAT_UL_DEC_LATENCY_US),
+			   tv_diff.tv_sec * 1000000 + tv_diff.tv_nsec / 1000);
+}
+
+/* hand a decoded block over to the upper layers, like rx_pdtch_fn() does */
+static void ul_dec_job_deliver(const struct ul_dec_job *job)
+{
+	struct l1sched_ts *l1ts = job->trx->ts[job->tn].priv;
+	enum osmo_ph_pres_info_type presence_info;
+	struct msgb *msg;
+	uint8_t *data;
+	int rc = job->rc;
+
+	ul_dec_update_stats(job->trx->bts, job);
+
+	/* the timeslot may have been reconfigured in the meantime, or the channel
+	 * deactivated and activated again (e.g. a dynamic timeslot switching back) */
+	if (l1ts == NULL || !l1ts->mf_index || !l1ts->chan_state[job->chan].active ||
+	    l1ts->chan_state[job->chan].gen != job->gen) {
+		LOGP(DL1P, LOGL_INFO, "%s: dropping decoded block (fn=%u), "
+		     "the logical channel is not active anymore\n",
+		     gsm_ts_name(&job->trx->ts[job->tn]), job->fn);
+		return;
+	}
+
+	if (rc > 0) {
+		presence_info = PRES_INFO_BOTH;
+	} else {
+		LOGL1S(DL1P, LOGL_DEBUG, l1ts, job->chan, job->fn,
+		       "Received bad data (rc=%d, BER %d/%d)\n",
+		       rc, job->n_errors, job->n_bits_total);
+		rc = 0;
+		presence_info = PRES_INFO_INVALID;
+	}
+
+	/* the PCU msgb pool is not thread-safe, so copy once here */
+	msg = _sched_pdtch_ind_alloc(l1ts, job->chan, &data);
+	if (msg != NULL) {
+		if (rc > 0)
+			memcpy(data, &job->l2[0], rc);
+		_sched_compose_pdtch_ind(l1ts, msg, job->fn, job->chan, rc,
+					 compute_ber10k(job->n_bits_total, job->n_errors),
+					 job->meas_avg.rssi,
+					 job->meas_avg.toa256,
+					 job->meas_avg.ci_cb,
+					 presence_info);
+		return;
+	}
+
+	_sched_compose_ph_data_ind(l1ts, job->fn, job->chan,
+				   &job->l2[0], rc,
+				   compute_ber10k(job->n_bits_total, job->n_errors),
+				   job->meas_avg.rssi,
+				   job->meas_avg.toa256,
+				   job->meas_avg.ci_cb,
+				   presence_info);
+}
+
+/* insert a decoded job into the reorder list, which is sorted by seq */
+static void ul_dec_reorder_insert(struct ul_dec_job *job)
+{
+	struct ul_dec_job *pos;
+
+	llist_for_each_entry_reverse(pos, &g_ul_dec.reorder, list) {
+		if ((int32_t)(job->seq - pos->seq) > 0) {
+			llist_add(&job->list, &pos->list);
+			return;
+		}
+	}
+
+	llist_add(&job->list, &g_ul_dec.reorder);
+}
+
+static int ul_dec_event_cb(struct osmo_fd *ofd, unsigned int what)
+{
+	struct ul_dec_job *job, *job2;
+	uint64_t val;
+	LLIST_HEAD(done);
+
+	if (read(ofd->fd, &val, sizeof(val)) != sizeof(val))
+		return 0;
+
+	pthread_mutex_lock(&g_ul_dec.lock);
+	llist_splice_init(&g_ul_dec.done, &done);
+	pthread_mutex_unlock(&g_ul_dec.lock);
+
+	llist_for_each_entry_safe(job, job2, &done, list) {
+		llist_del(&job->list);
+		ul_dec_reorder_insert(job);
+	}
+
+	/* deliver all blocks whose predecessors have been delivered */
+	while (!llist_empty(&g_ul_dec.reorder)) {
+		job = llist_first_entry(&g_ul_dec.reorder, struct ul_dec_job, list);
+		if (job->seq != g_ul_dec.deliver_seq)
+			break;
+		llist_del(&job->list);
+		g_ul_dec.deliver_seq++;
+		g_ul_dec.inflight--;
+		ul_dec_job_deliver(job);
+		talloc_free(job);
+	}
+
+	return 0;
+}
+
+static int ul_dec_start(const struct phy_link *plink, unsigned int num_threads)
+{
+	unsigned int i;
+	int fd, rc;
+
+	fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd < 0) {
+		LOGP(DL1C, LOGL_ERROR, "Failed to create eventfd for the Uplink decoder: %s\n",
+		     strerror(errno));
+		return -errno;
+	}
+	osmo_fd_setup(&g_ul_dec.event_ofd, fd, OSMO_FD_READ, ul_dec_event_cb, NULL, 0);
+	rc = osmo_fd_register(&g_ul_dec.event_ofd);
+	if (rc < 0) {
+		close(fd);
+		return rc;
+	}
+
+	INIT_LLIST_HEAD(&g_ul_dec.pending);
+	INIT_LLIST_HEAD(&g_ul_dec.done);
+	INIT_LLIST_HEAD(&g_ul_dec.reorder);
+	INIT_LLIST_HEAD(&g_ul_dec.batch);
+	g_ul_dec.batch_gmsk = &g_ul_dec.batch;
+	pthread_mutex_init(&g_ul_dec.lock, NULL);
+	pthread_cond_init(&g_ul_dec.cond, NULL);
+
+	g_ul_dec.threads = talloc_zero_array(tall_bts_ctx, pthread_t, num_threads);
+	OSMO_ASSERT(g_ul_dec.threads != NULL);
+
+	for (i = 0; i < num_threads; i++) {
+		char name[16];
+
+		rc = pthread_create(&g_ul_dec.threads[i], NULL, ul_dec_worker, NULL);
+		if (rc != 0) {
+			LOGP(DL1C, LOGL_ERROR, "Failed to start Uplink decoder thread: %s\n",
+			     strerror(rc));
+			break;
+		}
+		/* allows to set the CPU affinity via the 'cpu-sched' VTY node */
+		snprintf(name, sizeof(name), "ul-decoder%u", i);
+		pthread_setname_np(g_ul_dec.threads[i], name);
+		cpu_placement_apply_thread(plink, g_ul_dec.threads[i], name);
+	}
+
+	if (i == 0) {
+		osmo_fd_close(&g_ul_dec.event_ofd);
+		TALLOC_FREE(g_ul_dec.threads);
+		return -rc;
+	}
+
+	LOGP(DL1C, LOGL_NOTICE, "Started %u Uplink decoder thread(s)\n", i);
+	g_ul_dec.num_threads = i;
+	g_ul_dec.running = true;
+
+	return 0;
+}
+
+/*! Get the given worker thread, for 'show cpu-placement'.
+ *  \returns false if there is no such thread (yet). */
+bool trx_ul_decoder_thread(unsigned int i, pthread_t *thread)
+{
+	if (!g_ul_dec.running || i >= g_ul_dec.num_threads)
+		return false;
+	*thread = g_ul_dec.threads[i];
+	return true;
+}
+
+/*! Shall blocks received on the given timeslot be decoded asynchronously?
+ *  The worker threads are started on first use, i.e. after daemonizing. */
+bool trx_ul_decoder_enabled(const struct l1sched_ts *l1ts)
+{
+	const struct phy_link *plink = l1ts->ts->trx->pinst->phy_link;
+
+	if (plink->u.osmotrx.ul_decoder_threads == 0)
+		return false;
+
+	if (!g_ul_dec.running && !g_ul_dec.start_failed) {
+		if (ul_dec_start(plink, plink->u.osmotrx.ul_decoder_threads) != 0)
+			g_ul_dec.start_failed = true;
+	}
+
+	return g_ul_dec.running;
+}
+
+/*! Submit a complete PDTCH block for decoding by the worker threads.
+ *  \param[in] l1ts timeslot the block was received on.
+ *  \param[in] bi the last burst of the block.
+ *  \param[in] bursts soft-bits of the block (copied).
+ *  \param[in] n_bursts_bits number of soft-bits in bursts.
+ *  \param[in] meas_avg measurements averaged over the block.
+ *  \returns 0 on success; negative on error. */
+int trx_ul_decoder_submit_pdtch(struct l1sched_ts *l1ts,
+				const struct trx_ul_burst_ind *bi,
+				const sbit_t *bursts, int n_bursts_bits,
+				const struct l1sched_meas_set *meas_avg)
+{
+	struct ul_dec_job *job;
+
+	OSMO_ASSERT(n_bursts_bits <= sizeof(job->bursts));
+
+	job = talloc_zero(tall_bts_ctx, struct ul_dec_job);
+	if (job == NULL)
+		return -ENOMEM;
+
+	job->seq = g_ul_dec.submit_seq++;
+	clock_gettime(CLOCK_MONOTONIC, &job->tv_submit);
+	job->trx = l1ts->ts->trx;
+	job->tn = l1ts->ts->nr;
+	job->chan = bi->chan;
+	job->gen = l1ts->chan_state[bi->chan].gen;
+	job->fn = GSM_TDMA_FN_SUB(bi->fn, 3);
+	job->meas_avg = *meas_avg;
+	job->is_8psk = (bi->burst_len == EGPRS_BURST_LEN);
+	job->try_gprs = (bi->burst_len == GSM_BURST_LEN);
+	job->n_bursts_bits = n_bursts_bits;
+	memcpy(job->bursts, bursts, n_bursts_bits);
+
+	/* the first block of a new block period completes the batch */
+	if (g_ul_dec.batch_len > 0 && g_ul_dec.batch_fn != job->fn)
+		trx_ul_decoder_flush();
+
+	/* 8PSK jobs go in front of the GMSK jobs, both in submission order */
+	if (job->is_8psk)
+		llist_add_tail(&job->list, g_ul_dec.batch_gmsk);
+	else
+		llist_add_tail(&job->list, &g_ul_dec.batch);
+	if (!job->is_8psk && g_ul_dec.batch_gmsk == &g_ul_dec.batch)
+		g_ul_dec.batch_gmsk = &job->list;
+	g_ul_dec.batch_fn = job->fn;
+	g_ul_dec.batch_len++;
+
+	g_ul_dec.inflight++;
+
+	return 0;
+}
+
+/*! Hand the batch of submitted blocks over to the worker threads.
+ *  Called for every TDMA frame, so that no block waits longer than a
+ *  frame period for the next block period to begin. */
+void trx_ul_decoder_flush(void)
+{
+	struct ul_dec_job *job;
+
+	if (g_ul_dec.batch_len == 0)
+		return;
+
+	/* the batch holds the blocks of all TRX, any of them leads to the BTS */
+	job = llist_first_entry(&g_ul_dec.batch, struct ul_dec_job, list);
+	ul_dec_update_stats(job->trx->bts, NULL);
+
+	pthread_mutex_lock(&g_ul_dec.lock);
+	llist_splice_init(&g_ul_dec.batch, g_ul_dec.pending.prev); /* append */
+	if (g_ul_dec.batch_len > 1)
+		pthread_cond_broadcast(&g_ul_dec.cond);
+	else
+		pthread_cond_signal(&g_ul_dec.cond);
+	pthread_mutex_unlock(&g_ul_dec.lock);
+
+	g_ul_dec.batch_gmsk = &g_ul_dec.batch;
+	g_ul_dec.batch_len = 0;
+}
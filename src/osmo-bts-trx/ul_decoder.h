@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <osmocom/core/bits.h>
+
+struct l1sched_ts;
+struct l1sched_meas_set;
+struct trx_ul_burst_ind;
+
+bool trx_ul_decoder_enabled(const struct l1sched_ts *l1ts);
+int trx_ul_decoder_submit_pdtch(struct l1sched_ts *l1ts,
+				const struct trx_ul_burst_ind *bi,
+				const sbit_t *bursts, int n_bursts_bits,
+				const struct l1sched_meas_set *meas_avg);
+void trx_ul_decoder_flush(void);
+bool trx_ul_decoder_thread(unsigned int i, pthread_t *thread);
@@ -59,7 +59,11 @@ void bts_model_trx_close(struct gsm_bts_trx *trx)
 	struct phy_instance *pinst = trx_phy_instance(trx);
 	struct phy_link *plink = pinst->phy_link;
 
-	if (phy_link_state_get(plink) != PHY_LINK_SHUTDOWN) {
+	if (plink->u.virt.num_trx_open > 0)
+		plink->u.virt.num_trx_open--;
+
+	/* the virtual Um instance is shared by all TRX of the PHY link */
+	if (plink->u.virt.num_trx_open == 0 && phy_link_state_get(plink) != PHY_LINK_SHUTDOWN) {
 		virt_um_destroy(plink->u.virt.virt_um);
 		plink->u.virt.virt_um = NULL;
 		phy_link_state_set(plink, PHY_LINK_SHUTDOWN);
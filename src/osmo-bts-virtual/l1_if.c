@@ -29,6 +29,7 @@
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/gsmtap.h>
 #include <osmocom/core/gsmtap_util.h>
+#include <osmocom/core/rate_ctr.h>
 #include <osmocom/gsm/protocol/gsm_08_58.h>
 #include <osmocom/gsm/rsl.h>
 
@@ -44,16 +45,30 @@
 #include <osmo-bts/scheduler.h>
 #include <osmo-bts/handover.h>
 #include "virtual_um.h"
+#include "l1_if.h"
 
-extern int vbts_sched_start(struct gsm_bts *bts);
+osmo_static_assert(sizeof(struct osmo_phsap_prim) <= VIRT_UM_MSGB_HEADROOM, l1sap_fits_headroom);
 
+/* Look up the PHY instance of the TRX with the given ARFCN.  This is done for
+ * every received message, so the result is cached in a table indexed by the
+ * ARFCN.  Entries are validated on use, as the ARFCN of a TRX may change. */
 static struct phy_instance *phy_instance_by_arfcn(struct phy_link *plink, uint16_t arfcn)
 {
+	struct phy_instance **map = plink->u.virt.arfcn_map;
 	struct phy_instance *pinst;
 
+	if (OSMO_LIKELY(map && arfcn < VIRT_ARFCN_MAP_SIZE)) {
+		pinst = map[arfcn];
+		if (pinst && pinst->trx && pinst->trx->arfcn == arfcn)
+			return pinst;
+	}
+
 	llist_for_each_entry(pinst, &plink->instances, list) {
-		if (pinst->trx && pinst->trx->arfcn == arfcn)
+		if (pinst->trx && pinst->trx->arfcn == arfcn) {
+			if (map && arfcn < VIRT_ARFCN_MAP_SIZE)
+				map[arfcn] = pinst;
 			return pinst;
+		}
 	}
 
 	return NULL;
@@ -76,6 +91,11 @@ static void virt_um_rcv_cb(struct virt_um_inst *vui, struct msgb *msg)
 		return;
 	}
 
+	if (OSMO_UNLIKELY(msgb_length(msg) < sizeof(struct gsmtap_hdr))) {
+		DEBUGP(DL1P, "Ignoring incoming msg - too short for GSMTAP\n");
+		goto nomessage;
+	}
+
 	struct gsmtap_hdr *gh = msgb_l1(msg);
 	uint32_t fn = ntohl(gh->frame_number);	/* frame number of the rcv msg */
 	uint16_t arfcn = ntohs(gh->arfcn); 	/* arfcn of the cell we currently camp on */
@@ -87,11 +107,14 @@ static void virt_um_rcv_cb(struct virt_um_inst *vui, struct msgb *msg)
 	uint8_t rsl_chantype;			/* rsl chan type (8.58, 9.3.1) */
 	uint8_t link_id;			/* rsl link id tells if this is an ssociated or dedicated link */
 	uint8_t chan_nr;			/* encoded rsl channel type, timeslot and mf subslot */
-	struct osmo_phsap_prim l1sap;
+	struct osmo_phsap_prim *l1sap;
 
-	memset(&l1sap, 0, sizeof(l1sap));
-	/* get rid of l1 gsmtap hdr */
-	msg->l2h = msgb_pull(msg, sizeof(*gh));
+	/* skip the gsmtap hdr, and build the primitive in place: in the
+	 * headroom which virt_um_fd_cb() left in front of it */
+	msg->l2h = msg->l1h + sizeof(*gh);
+	l1sap = (struct osmo_phsap_prim *) msgb_push(msg, sizeof(*l1sap));
+	memset(l1sap, 0, sizeof(*l1sap));
+	msg->l1h = (uint8_t *) l1sap;
 
 	/* convert gsmtap chan to RSL chan and link id */
 	chantype_gsmtap2rsl(gsmtap_chantype, &rsl_chantype, &link_id);
@@ -99,7 +122,7 @@ static void virt_um_rcv_cb(struct virt_um_inst *vui, struct msgb *msg)
 
 	/* ... or not uplink */
 	if (!(arfcn & GSMTAP_ARFCN_F_UPLINK)) {
-		LOGPFN(DL1P, LOGL_NOTICE, fn, "Ignoring incoming msg - no uplink flag\n");
+		LOGPFN(DL1P, LOGL_DEBUG, fn, "Ignoring incoming msg - no uplink flag\n");
 		goto nomessage;
 	}
 
@@ -114,18 +137,20 @@ static void virt_um_rcv_cb(struct virt_um_inst *vui, struct msgb *msg)
 		/* generate primitive for upper layer
 		 * see 04.08 - 3.3.1.3.1: the IMMEDIATE_ASSIGNMENT coming back from the network has to be
 		 * sent with the same ra reference as in the CHANNEL_REQUEST that was received */
-		osmo_prim_init(&l1sap.oph, SAP_GSM_PH, PRIM_PH_RACH, PRIM_OP_INDICATION, msg);
+		osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_PH_RACH, PRIM_OP_INDICATION, msg);
 
-		l1sap.u.rach_ind.chan_nr = chan_nr;
+		l1sap->u.rach_ind.chan_nr = chan_nr;
 		/* TODO: 11bit RACH */
-		l1sap.u.rach_ind.ra = msgb_pull_u8(msg); /* directly after gh hdr comes ra */
-		l1sap.u.rach_ind.acc_delay = 0; /* probably not used in virt um */
-		l1sap.u.rach_ind.is_11bit = 0;
-		l1sap.u.rach_ind.fn = fn;
+		if (msgb_l2len(msg) < 1)
+			goto nomessage;
+		l1sap->u.rach_ind.ra = msg->l2h[0]; /* directly after gh hdr comes ra */
+		l1sap->u.rach_ind.acc_delay = 0; /* probably not used in virt um */
+		l1sap->u.rach_ind.is_11bit = 0;
+		l1sap->u.rach_ind.fn = fn;
 		/* we don't really know which RACH burst type the virtual MS is using, as this field is not
 		 * part of information present in the GSMTAP header.  So we simply report all of them as 0 */
-		l1sap.u.rach_ind.burst_type = GSM_L1_BURST_TYPE_ACCESS_0;
-		l1sap.u.rach_ind.lqual_cb = 10 * signal_dbm; /* Link quality in centiBel = 10 * dB. */
+		l1sap->u.rach_ind.burst_type = GSM_L1_BURST_TYPE_ACCESS_0;
+		l1sap->u.rach_ind.lqual_cb = 10 * signal_dbm; /* Link quality in centiBel = 10 * dB. */
 		break;
 	case GSMTAP_CHANNEL_TCH_F:
 	case GSMTAP_CHANNEL_TCH_H:
@@ -135,53 +160,62 @@ static void virt_um_rcv_cb(struct virt_um_inst *vui, struct msgb *msg)
 	case GSMTAP_CHANNEL_PACCH:
 	case GSMTAP_CHANNEL_PDCH:
 	case GSMTAP_CHANNEL_PTCCH:
-		osmo_prim_init(&l1sap.oph, SAP_GSM_PH, PRIM_PH_DATA,
+		osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_PH_DATA,
 		               PRIM_OP_INDICATION, msg);
-		l1sap.u.data.chan_nr = chan_nr;
-		l1sap.u.data.link_id = link_id;
-		l1sap.u.data.fn = fn;
-		l1sap.u.data.rssi = 0; /* Radio Signal Strength Indicator. Best -> 0 */
-		l1sap.u.data.ber10k = 0; /* Bit Error Rate in 0.01%. Best -> 0 */
-		l1sap.u.data.ta_offs_256bits = 0; /* Burst time of arrival in quarter bits. Probably used for Timing Advance calc. Best -> 0 */
-		l1sap.u.data.lqual_cb = 10 * signal_dbm; /* Link quality in centiBel = 10 * dB. */
-		l1sap.u.data.pdch_presence_info = PRES_INFO_BOTH;
+		l1sap->u.data.chan_nr = chan_nr;
+		l1sap->u.data.link_id = link_id;
+		l1sap->u.data.fn = fn;
+		l1sap->u.data.rssi = 0; /* Radio Signal Strength Indicator. Best -> 0 */
+		l1sap->u.data.ber10k = 0; /* Bit Error Rate in 0.01%. Best -> 0 */
+		l1sap->u.data.ta_offs_256bits = 0; /* Burst time of arrival in quarter bits. Probably used for Timing Advance calc. Best -> 0 */
+		l1sap->u.data.lqual_cb = 10 * signal_dbm; /* Link quality in centiBel = 10 * dB. */
+		l1sap->u.data.pdch_presence_info = PRES_INFO_BOTH;
 		l1if_process_meas_res(pinst->trx, timeslot, fn, chan_nr, 0, 0, 0, 0);
 		break;
 	case GSMTAP_CHANNEL_VOICE_F:
 	case GSMTAP_CHANNEL_VOICE_H:
 		/* the first byte indicates the type of voice codec (gsmtap_um_voice_type) */
-		msg->l2h = msgb_pull(msg, 1);
-		osmo_prim_init(&l1sap.oph, SAP_GSM_PH, PRIM_TCH, PRIM_OP_INDICATION, msg);
-		l1sap.u.tch.chan_nr = chan_nr;
-		l1sap.u.tch.fn = fn;
-		l1sap.u.tch.rssi = 0; /* Radio Signal Strength Indicator. Best -> 0 */
-		l1sap.u.tch.ber10k = 0; /* Bit Error Rate in 0.01%. Best -> 0 */
-		l1sap.u.tch.ta_offs_256bits = 0; /* Burst time of arrival in quarter bits. Probably used for Timing Advance calc. Best -> 0 */
-		l1sap.u.tch.lqual_cb = 10 * signal_dbm; /* Link quality in centiBel = 10 * dB. */
+		if (msgb_l2len(msg) < 1)
+			goto nomessage;
+		msg->l2h++;
+		osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_TCH, PRIM_OP_INDICATION, msg);
+		l1sap->u.tch.chan_nr = chan_nr;
+		l1sap->u.tch.fn = fn;
+		l1sap->u.tch.rssi = 0; /* Radio Signal Strength Indicator. Best -> 0 */
+		l1sap->u.tch.ber10k = 0; /* Bit Error Rate in 0.01%. Best -> 0 */
+		l1sap->u.tch.ta_offs_256bits = 0; /* Burst time of arrival in quarter bits. Probably used for Timing Advance calc. Best -> 0 */
+		l1sap->u.tch.lqual_cb = 10 * signal_dbm; /* Link quality in centiBel = 10 * dB. */
 		l1if_process_meas_res(pinst->trx, timeslot, fn, chan_nr, 0, 0, 0, 0);
 		break;
 	case GSMTAP_CHANNEL_AGCH:
 	case GSMTAP_CHANNEL_PCH:
 	case GSMTAP_CHANNEL_BCCH:
-		LOGPFN(DL1P, LOGL_NOTICE, fn, "Ignore incoming msg - channel type downlink only!\n");
+		LOGPFN(DL1P, LOGL_DEBUG, fn, "Ignore incoming msg - channel type downlink only!\n");
 		goto nomessage;
 	case GSMTAP_CHANNEL_SDCCH:
 	case GSMTAP_CHANNEL_CCCH:
 	case GSMTAP_CHANNEL_CBCH51:
 	case GSMTAP_CHANNEL_CBCH52:
-		LOGPFN(DL1P, LOGL_NOTICE, fn, "Ignore incoming msg - channel type not supported!\n");
+		LOGPFN(DL1P, LOGL_DEBUG, fn, "Ignore incoming msg - channel type not supported!\n");
 		goto nomessage;
 	default:
-		LOGPFN(DL1P, LOGL_NOTICE, fn, "Ignore incoming msg - channel type unknown\n");
+		LOGPFN(DL1P, LOGL_DEBUG, fn, "Ignore incoming msg - channel type unknown\n");
 		goto nomessage;
 	}
 
 	/* forward primitive, lsap takes ownership of the msgb. */
-	l1sap_up(pinst->trx, &l1sap);
+	l1sap_up(pinst->trx, l1sap);
 	DEBUGPFN(DL1P, fn, "Message forwarded to layer 2.\n");
 	return;
 
 nomessage:
+	/* not logged above DEBUG: on a shared multicast group, there may be a
+	 * lot of these (e.g. for other BTS), better count them */
+	pinst = phy_instance_by_num(plink, 0);
+	if (pinst && pinst->trx) {
+		struct bts_virt_priv *bts_virt = pinst->trx->bts->model_priv;
+		rate_ctr_inc(rate_ctr_group_get_ctr(bts_virt->ctrs, BTSVIRT_CTR_UM_RX_IGNORED));
+	}
 	talloc_free(msg);
 }
 
@@ -206,6 +240,10 @@ int bts_model_phy_link_open(struct phy_link *plink)
 	if (plink->u.virt.virt_um)
 		virt_um_destroy(plink->u.virt.virt_um);
 
+	if (!plink->u.virt.arfcn_map)
+		plink->u.virt.arfcn_map = talloc_zero_array(plink, struct phy_instance *,
+							    VIRT_ARFCN_MAP_SIZE);
+
 	phy_link_state_set(plink, PHY_LINK_CONNECTING);
 
 	plink->u.virt.virt_um = virt_um_init(plink, plink->u.virt.ms_mcast_group, plink->u.virt.ms_mcast_port,
@@ -218,11 +256,15 @@ int bts_model_phy_link_open(struct phy_link *plink)
 	/* set back reference to plink */
 	plink->u.virt.virt_um->priv = plink;
 
-	/* iterate over list of PHY instances and initialize the scheduler */
+	/* iterate over list of PHY instances and initialize the scheduler;
+	 * all of them (one per TRX) share the same virtual Um instance,
+	 * Uplink messages are dispatched by ARFCN */
+	plink->u.virt.num_trx_open = 0;
 	llist_for_each_entry(pinst, &plink->instances, list) {
 		if (pinst->trx == NULL)
 			continue;
 		trx_sched_init(pinst->trx);
+		plink->u.virt.num_trx_open++;
 	}
 
 	/* this will automatically update the MO state of all associated TRX objects */
@@ -1,15 +1,42 @@
 #pragma once
 
+#include <time.h>
+
+#include <osmocom/core/select.h>
+
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/scheduler.h>
 
 #include "virtual_um.h"
 
+/* size of phy_link->u.virt.arfcn_map, covers all GSM ARFCNs */
+#define VIRT_ARFCN_MAP_SIZE	1024
+
+/* bts-virtual specific rate counters */
+enum {
+	BTSVIRT_CTR_SCHED_DL_MISS_FN,
+	BTSVIRT_CTR_UM_TX_MSGS,
+	BTSVIRT_CTR_UM_TX_ERRORS,
+	BTSVIRT_CTR_UM_RX_IGNORED,
+};
+
+/* bts-virtual specific stat items */
+enum {
+	BTSVIRT_STAT_FN_TIMER_ERROR_US,
+};
+
 /* gsm_bts->model_priv, specific to osmo-bts-virtual */
 struct bts_virt_priv {
 	uint32_t last_fn;
-	struct timeval tv_clock;
-	struct osmo_timer_list fn_timer;
+	/* time at which the FN timer last fired */
+	struct timespec tv_clock;
+	/* timerfd of the FN period timer */
+	struct osmo_fd fn_timer_ofd;
+	struct rate_ctr_group *ctrs;		/* size of phy_link->u.virt.arfcn_map, covers all GSM ARFCNs */
+#define VIRT_ARFCN_MAP_SIZE	1024
+
+/* bts-virtual specific rate counters */
+	struct osmo_stat_item_group *stats;	/* bts-virtual specific stat items */
 };
 
 struct vbts_l1h {
@@ -24,3 +51,4 @@ void l1if_reset(struct vbts_l1h *l1h);
 int l1if_mph_time_ind(struct gsm_bts *bts, uint32_t fn);
 
 int vbts_sched_start(struct gsm_bts *bts);
+int vbts_sched_fn(struct gsm_bts *bts, uint32_t fn);
@@ -35,6 +35,9 @@
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/stat_item.h>
 #include <osmocom/vty/telnet_interface.h>
 #include <osmocom/vty/logging.h>
 #include <osmocom/vty/ports.h>
@@ -49,6 +52,47 @@
 #include "virtual_um.h"
 #include "l1_if.h"
 
+static const struct rate_ctr_desc btsvirt_ctr_desc[] = {
+	[BTSVIRT_CTR_SCHED_DL_MISS_FN] = {
+		"trx_clk:sched_dl_miss_fn",
+		"Downlink frames scheduled later than expected due to missed timerfd event (due to high system load)"
+	},
+	[BTSVIRT_CTR_UM_TX_MSGS] = {
+		"virt_um:tx_msgs",
+		"GSMTAP messages queued for transmission on the virtual Um"
+	},
+	[BTSVIRT_CTR_UM_TX_ERRORS] = {
+		"virt_um:tx_errors",
+		"Failures to send a batch of GSMTAP messages on the virtual Um"
+	},
+	[BTSVIRT_CTR_UM_RX_IGNORED] = {
+		"virt_um:rx_ignored",
+		"Received GSMTAP messages ignored (not Uplink, unknown ARFCN or channel type)"
+	},
+};
+static const struct rate_ctr_group_desc btsvirt_ctrg_desc = {
+	"bts-virtual",
+	"osmo-bts-virtual specific counters",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(btsvirt_ctr_desc),
+	btsvirt_ctr_desc
+};
+
+static const struct osmo_stat_item_desc btsvirt_stat_desc[] = {
+	[BTSVIRT_STAT_FN_TIMER_ERROR_US] = {
+		"sched:fn_timer_error_us",
+		"OS scheduling error of the TDMA frame period timer",
+		"us", 16, 0
+	},
+};
+static const struct osmo_stat_item_group_desc btsvirt_statg_desc = {
+	"bts-virtual",
+	"osmo-bts-virtual specific statistics",
+	OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(btsvirt_stat_desc),
+	btsvirt_stat_desc
+};
+
 /* dummy, since no direct dsp support */
 uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx)
 {
@@ -58,6 +102,9 @@ uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx)
 int bts_model_init(struct gsm_bts *bts)
 {
 	struct bts_virt_priv *bts_virt = talloc_zero(bts, struct bts_virt_priv);
+	bts_virt->fn_timer_ofd.fd = -1;
+	bts_virt->ctrs = rate_ctr_group_alloc(bts_virt, &btsvirt_ctrg_desc, 0);
+	bts_virt->stats = osmo_stat_item_group_alloc(bts_virt, &btsvirt_statg_desc, 0);
 	bts->model_priv = bts_virt;
 	bts->variant = BTS_OSMO_VIRTUAL;
 	bts->support.ciphers = CIPHER_A5(1) | CIPHER_A5(2) | CIPHER_A5(3);
@@ -143,6 +190,18 @@ void bts_model_ts_connect(struct gsm_bts_trx_ts *ts, enum gsm_phys_chan_config a
 	LOGP(DLGLOBAL, LOGL_NOTICE, "Unimplemented %s\n", __func__);
 }
 
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{
+	/* deactivated one by one via bts_model_l1sap_down() */
+	return -ENOTSUP;
+}
+
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2)
+{
+	/* GSMTAP carries the L2 blocks, nothing to encode */
+	return -ENOTSUP;
+}
+
 int main(int argc, char **argv)
 {
 	return bts_main(argc, argv);
@@ -26,12 +26,17 @@
 #include <errno.h>
 #include <stdint.h>
 #include <ctype.h>
+#include <inttypes.h>
 
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/bits.h>
 #include <osmocom/core/gsmtap_util.h>
 #include <osmocom/core/gsmtap.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/select.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/timer_compat.h>
 #include <osmocom/gsm/rsl.h>
 
 #include <osmo-bts/gsm_data.h>
@@ -96,17 +101,18 @@ static void _tx_to_virt_um(struct l1sched_ts *l1ts,
 
 	if (outmsg) {
 		struct phy_instance *pinst = trx_phy_instance(trx);
+		struct bts_virt_priv *bts_virt = trx->bts->model_priv;
 		int rc;
 
+		/* this is the hot path: no logging unless something fails,
+		 * the messages are sent in one batch at the end of the frame */
+		rate_ctr_inc(rate_ctr_group_get_ctr(bts_virt->ctrs, BTSVIRT_CTR_UM_TX_MSGS));
 		rc = virt_um_write_msg(pinst->phy_link->u.virt.virt_um, outmsg);
-		if (rc < 0)
+		if (rc < 0) {
+			rate_ctr_inc(rate_ctr_group_get_ctr(bts_virt->ctrs, BTSVIRT_CTR_UM_TX_ERRORS));
 			LOGL1SB(DL1P, LOGL_ERROR, l1ts, br,
 			       "GSMTAP msg could not send to virtual Um: %s\n", strerror(-rc));
-		else if (rc == 0)
-			bts_shutdown(trx->bts, "VirtPHY write socket died\n");
-		else
-			LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br,
-			       "Sending GSMTAP message to virtual Um\n");
+		}
 	} else
 		LOGL1SB(DL1P, LOGL_ERROR, l1ts, br, "GSMTAP msg could not be created!\n");
 
@@ -197,7 +203,7 @@ int tx_data_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 	/* get mac block from queue */
 	msg = _sched_dequeue_prim(l1ts, br);
 	if (!msg) {
-		LOGL1SB(DL1P, LOGL_INFO, l1ts, br, "has not been served !! No prim\n");
+		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "has not been served !! No prim\n");
 		return -ENODEV;
 	}
 
@@ -226,7 +232,7 @@ int tx_pdtch_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 	/* get mac block from queue */
 	msg = _sched_dequeue_prim(l1ts, br);
 	if (!msg) {
-		LOGL1SB(DL1P, LOGL_INFO, l1ts, br, "has not been served !! No prim\n");
+		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "has not been served !! No prim\n");
 		return -ENODEV;
 	}
 
@@ -375,7 +381,7 @@ int tx_tchf_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 
 	/* no message at all */
 	if (!msg_tch && !msg_facch) {
-		LOGL1SB(DL1P, LOGL_INFO, l1ts, br, "has not been served !! No prim\n");
+		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "has not been served !! No prim\n");
 		return -ENODEV;
 	}
 
@@ -403,7 +409,7 @@ int tx_tchh_fn(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br)
 
 	/* no message at all */
 	if (!msg_tch && !msg_facch && !chan_state->dl_ongoing_facch) {
-		LOGL1SB(DL1P, LOGL_INFO, l1ts, br, "has not been served !! No prim\n");
+		LOGL1SB(DL1P, LOGL_DEBUG, l1ts, br, "has not been served !! No prim\n");
 		return -ENODEV;
 	}
 
@@ -461,8 +467,10 @@ void _sched_act_rach_det(struct gsm_bts_trx *trx, uint8_t tn, uint8_t ss, int ac
 
 #define RTS_ADVANCE		5	/* about 20ms */
 
-static int vbts_sched_fn(struct gsm_bts *bts, uint32_t fn)
+/*! process one TDMA frame: RTS to the higher layers and Downlink on all TRX */
+int vbts_sched_fn(struct gsm_bts *bts, uint32_t fn)
 {
+	struct bts_virt_priv *bts_virt = (struct bts_virt_priv *)bts->model_priv;
 	struct gsm_bts_trx *trx;
 
 	/* send time indication */
@@ -474,9 +482,16 @@ static int vbts_sched_fn(struct gsm_bts *bts, uint32_t fn)
 	llist_for_each_entry(trx, &bts->trx_list, list) {
 		struct trx_dl_burst_req br = { .fn = fn };
 
+		br.burst = &br.burst_buf[0];
+
 		/* do for each of the 8 timeslots */
 		for (br.tn = 0; br.tn < ARRAY_SIZE(trx->ts); br.tn++) {
 			struct l1sched_ts *l1ts = trx->ts[br.tn].priv;
+
+			/* no channel combination on this timeslot */
+			if (l1ts == NULL)
+				continue;
+
 			/* Generate RTS indication to higher layers */
 			/* This will basically do 2 things (check l1_if:bts_model_l1sap_down):
 			 * 1) Get pending messages from layer 2 (from the lapdm queue)
@@ -494,63 +509,87 @@ static int vbts_sched_fn(struct gsm_bts *bts, uint32_t fn)
 		}
 	}
 
+	/* send everything generated for this frame, one batch per PHY link */
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		struct virt_um_inst *virt_um = trx_phy_instance(trx)->phy_link->u.virt.virt_um;
+		int rc;
+
+		if (!virt_um || !virt_um->tx_queue_len)
+			continue;
+		rc = virt_um_flush(virt_um);
+		if (rc < 0) {
+			rate_ctr_inc(rate_ctr_group_get_ctr(bts_virt->ctrs, BTSVIRT_CTR_UM_TX_ERRORS));
+			LOGPFN(DL1P, LOGL_ERROR, fn, "GSMTAP msgs could not be sent to virtual Um: %s\n",
+			       strerror(-rc));
+		}
+	}
+
 	return 0;
 }
 
-static void vbts_fn_timer_cb(void *data)
+/*! this is the timerfd-callback firing for every FN to be processed */
+static int vbts_fn_timer_cb(struct osmo_fd *ofd, unsigned int what)
 {
-	struct gsm_bts *bts = data;
+	struct gsm_bts *bts = ofd->data;
 	struct bts_virt_priv *bts_virt = (struct bts_virt_priv *)bts->model_priv;
-	struct timeval tv_now;
-	struct timeval *tv_clock = &bts_virt->tv_clock;
-	int32_t elapsed_us;
-
-	gettimeofday(&tv_now, NULL);
-
-	/* check how much time elapsed till the last timer callback call.
-	 * this value should be about 4.615 ms (a bit greater) as this is the scheduling interval */
-	elapsed_us = (tv_now.tv_sec - tv_clock->tv_sec) * 1000000
-	                + (tv_now.tv_usec - tv_clock->tv_usec);
-
-	/* not so good somehow a lot of time passed between two timer callbacks */
-	if (elapsed_us > 2 *GSM_TDMA_FN_DURATION_uS)
-		LOGP(DL1P, LOGL_NOTICE, "vbts_fn_timer_cb after %d us\n", elapsed_us);
-
-	/* schedule the current frame/s (fn = frame number)
-	 * this loop will be called at least once, but can also be executed
-	 * multiple times if more than one frame duration (4615us) passed till the last callback */
-	while (elapsed_us > GSM_TDMA_FN_DURATION_uS / 2) {
-		const struct timeval tv_frame = {
-			.tv_sec = 0,
-			.tv_usec = GSM_TDMA_FN_DURATION_uS,
-		};
-		timeradd(tv_clock, &tv_frame, tv_clock);
-		/* increment the frame number in the BTS model instance */
-		vbts_sched_fn(bts, GSM_TDMA_FN_INC(bts_virt->last_fn));
-		elapsed_us -= GSM_TDMA_FN_DURATION_uS;
+	struct timespec tv_now, elapsed;
+	uint64_t expire_count;
+	int64_t elapsed_us, error_us;
+	int rc, i;
+
+	if (!(what & OSMO_FD_READ))
+		return 0;
+
+	/* read from timerfd: number of expirations of periodic timer */
+	rc = read(ofd->fd, (void *) &expire_count, sizeof(expire_count));
+	if (rc < 0 && errno == EAGAIN)
+		return 0;
+	OSMO_ASSERT(rc == sizeof(expire_count));
+
+	if (expire_count > 1) {
+		LOGP(DL1P, LOGL_NOTICE, "FN timer expire_count=%"PRIu64": We missed %"PRIu64" timers\n",
+		     expire_count, expire_count - 1);
+		rate_ctr_add(rate_ctr_group_get_ctr(bts_virt->ctrs, BTSVIRT_CTR_SCHED_DL_MISS_FN),
+			     expire_count - 1);
 	}
 
-	/* re-schedule the timer */
-	/* timer is set to frame duration - elapsed time to guarantee that this cb method will be
-	 * periodically executed every 4.615ms */
-	osmo_timer_schedule(&bts_virt->fn_timer, 0, GSM_TDMA_FN_DURATION_uS - elapsed_us);
+	/* compute actual elapsed time and resulting OS scheduling error */
+	clock_gettime(CLOCK_MONOTONIC, &tv_now);
+	timespecsub(&tv_now, &bts_virt->tv_clock, &elapsed);
+	elapsed_us = (int64_t)(elapsed.tv_sec * 1000000) + (elapsed.tv_nsec / 1000);
+	error_us = elapsed_us - GSM_TDMA_FN_DURATION_uS;
+	bts_virt->tv_clock = tv_now;
+
+	osmo_stat_item_set(osmo_stat_item_group_get_item(bts_virt->stats, BTSVIRT_STAT_FN_TIMER_ERROR_US),
+			   error_us);
+
+	/* schedule all expired FN: unlike with osmo_timer_schedule(), the
+	 * timerfd period is not affected by the time spent in here */
+	for (i = 0; i < expire_count; i++)
+		vbts_sched_fn(bts, GSM_TDMA_FN_INC(bts_virt->last_fn));
+
+	return 0;
 }
 
 int vbts_sched_start(struct gsm_bts *bts)
 {
 	struct bts_virt_priv *bts_virt = (struct bts_virt_priv *)bts->model_priv;
+	const struct timespec interval = { .tv_sec = 0, .tv_nsec = GSM_TDMA_FN_DURATION_nS };
+	int rc;
+
 	LOGP(DL1P, LOGL_NOTICE, "starting VBTS scheduler\n");
 
 	if (!bts_virt)
 		return -EINVAL;
 
-	memset(&bts_virt->fn_timer, 0, sizeof(bts_virt->fn_timer));
-	bts_virt->fn_timer.cb = vbts_fn_timer_cb;
-	bts_virt->fn_timer.data = bts;
-
-	gettimeofday(&bts_virt->tv_clock, NULL);
-	/* trigger the first timer after 4615us (a frame duration) */
-	osmo_timer_schedule(&bts_virt->fn_timer, 0, GSM_TDMA_FN_DURATION_uS);
+	rc = osmo_timerfd_setup(&bts_virt->fn_timer_ofd, vbts_fn_timer_cb, bts);
+	if (rc < 0) {
+		LOGP(DL1P, LOGL_ERROR, "Failed to set up the FN timer: %s\n", strerror(-rc));
+		return rc;
+	}
 
-	return 0;
+	clock_gettime(CLOCK_MONOTONIC, &bts_virt->tv_clock);
+	/* trigger the first timer after 4615us (a frame duration), and every
+	 * frame duration from then on */
+	return osmo_timerfd_schedule(&bts_virt->fn_timer_ofd, &interval, &interval);
 }
@@ -19,6 +19,7 @@
  *
  */
 
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
 #include <osmocom/core/select.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/socket.h>
@@ -30,32 +31,78 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <sys/socket.h>
+
+/* (Re)fill the empty slots of the receive batch with fresh msgbs */
+static int virt_um_rx_refill(struct virt_um_inst *vui)
+{
+	unsigned int i;
+
+	for (i = 0; i < VIRT_UM_RX_BATCH; i++) {
+		if (vui->rx_msg[i])
+			continue;
+		/* the headroom allows the receiver to build its primitive in place */
+		vui->rx_msg[i] = msgb_alloc_headroom(VIRT_UM_MSGB_HEADROOM + VIRT_UM_MSGB_SIZE,
+						     VIRT_UM_MSGB_HEADROOM, "Virtual UM Rx");
+		if (!vui->rx_msg[i])
+			return -ENOMEM;
+	}
+
+	return 0;
+}
 
 /**
  * Virtual UM interface file descriptor callback.
  * Should be called by select.c when the fd is ready for reading.
+ * Receives up to VIRT_UM_RX_BATCH datagrams with a single recvmmsg(), each
+ * of them straight into the msgb handed over to the l1 callback.
  */
 static int virt_um_fd_cb(struct osmo_fd *ofd, unsigned int what)
 {
 	struct virt_um_inst *vui = ofd->data;
+	struct mmsghdr mmsg[VIRT_UM_RX_BATCH];
+	struct iovec iov[VIRT_UM_RX_BATCH];
+	struct msgb *msg;
+	unsigned int i;
+	int rc;
+
+	if (!(what & OSMO_FD_READ))
+		return 0;
+
+	if (virt_um_rx_refill(vui) < 0)
+		return -ENOMEM;
+
+	for (i = 0; i < VIRT_UM_RX_BATCH; i++) {
+		iov[i] = (struct iovec) {
+			.iov_base = msgb_data(vui->rx_msg[i]),
+			.iov_len = msgb_tailroom(vui->rx_msg[i]),
+		};
+		mmsg[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+			},
+		};
+	}
 
-	if (what & OSMO_FD_READ) {
-		struct msgb *msg = msgb_alloc(VIRT_UM_MSGB_SIZE, "Virtual UM Rx");
-		int rc;
-
-		/* read message from fd into message buffer */
-		rc = mcast_bidir_sock_rx(vui->mcast_sock, msgb_data(msg), msgb_tailroom(msg));
-		if (rc > 0) {
-			msgb_put(msg, rc);
-			msg->l1h = msgb_data(msg);
-			/* call the l1 callback function for a received msg */
-			vui->recv_cb(vui, msg);
-		} else if (rc == 0) {
-			vui->recv_cb(vui, NULL);
-			osmo_fd_close(ofd);
-		} else
+	/* read messages from fd into message buffers */
+	rc = recvmmsg(ofd->fd, mmsg, VIRT_UM_RX_BATCH, MSG_DONTWAIT, NULL);
+	if (rc < 0) {
+		if (errno != EAGAIN)
 			perror("Read from multicast socket");
+		return 0;
+	}
 
+	for (i = 0; i < (unsigned int) rc; i++) {
+		/* empty datagrams carry no GSMTAP header, keep the msgb */
+		if (mmsg[i].msg_len == 0)
+			continue;
+		msg = vui->rx_msg[i];
+		vui->rx_msg[i] = NULL;
+		msgb_put(msg, mmsg[i].msg_len);
+		msg->l1h = msgb_data(msg);
+		/* call the l1 callback function for a received msg */
+		vui->recv_cb(vui, msg);
 	}
 
 	return 0;
@@ -76,6 +123,7 @@ struct virt_um_inst *virt_um_init(void *ctx, char *tx_mcast_group, uint16_t tx_m
 		return NULL;
 	}
 	vui->recv_cb = recv_cb;
+	vui->tx_batch = VIRT_UM_TX_BATCH;
 
 	/* -1 means default, i.e. no TTL explicitly configured in VTY */
 	if (ttl >= 0) {
@@ -109,22 +157,75 @@ out_close:
 
 void virt_um_destroy(struct virt_um_inst *vui)
 {
+	unsigned int i;
+
+	for (i = 0; i < vui->tx_queue_len; i++)
+		msgb_free(vui->tx_queue[i]);
+	for (i = 0; i < VIRT_UM_RX_BATCH; i++)
+		msgb_free(vui->rx_msg[i]);
 	mcast_bidir_sock_close(vui->mcast_sock);
 	talloc_free(vui);
 }
 
 /**
- * Write msg to to multicast socket and free msg afterwards
+ * Queue msg for transmission by the next virt_um_flush(), which takes
+ * ownership of it.  The queue is flushed right away once it is full.
+ * \returns length of msg on success; negative on error.
  */
 int virt_um_write_msg(struct virt_um_inst *vui, struct msgb *msg)
 {
+	int len = msgb_length(msg);
 	int rc;
 
-	rc = mcast_bidir_sock_tx(vui->mcast_sock, msgb_data(msg),
-	                msgb_length(msg));
-	if (rc < 0)
-		rc = -errno;
-	msgb_free(msg);
+	vui->tx_queue[vui->tx_queue_len++] = msg;
+	if (vui->tx_queue_len >= OSMO_MIN(vui->tx_batch, VIRT_UM_TX_BATCH)) {
+		rc = virt_um_flush(vui);
+		if (rc < 0)
+			return rc;
+	}
+
+	return len;
+}
+
+/**
+ * Send all queued messages to the multicast socket, with as few sendmmsg()
+ * calls as possible, and free them afterwards.  If sending fails, the remaining
+ * messages are dropped.
+ * \returns number of messages sent; negative on error.
+ */
+int virt_um_flush(struct virt_um_inst *vui)
+{
+	struct mmsghdr mmsg[VIRT_UM_TX_BATCH];
+	struct iovec iov[VIRT_UM_TX_BATCH];
+	unsigned int i, sent = 0;
+	int rc = 0;
+
+	for (i = 0; i < vui->tx_queue_len; i++) {
+		iov[i] = (struct iovec) {
+			.iov_base = msgb_data(vui->tx_queue[i]),
+			.iov_len = msgb_length(vui->tx_queue[i]),
+		};
+		mmsg[i] = (struct mmsghdr) {
+			.msg_hdr = {
+				.msg_iov = &iov[i],
+				.msg_iovlen = 1,
+			},
+		};
+	}
+
+	/* the tx socket is connected to the multicast group */
+	while (sent < vui->tx_queue_len) {
+		rc = sendmmsg(vui->mcast_sock->tx_ofd.fd, &mmsg[sent], vui->tx_queue_len - sent, 0);
+		if (rc < 0) {
+			rc = -errno;
+			break;
+		}
+		sent += rc;
+	}
+
+	for (i = 0; i < vui->tx_queue_len; i++)
+		msgb_free(vui->tx_queue[i]);
+	vui->tx_queue_len = 0;
 
-	return rc;
+	return rc < 0 ? rc : sent;
 }
@@ -10,6 +10,9 @@
  *  ranges when defining scopes for private use." */
 
 #define VIRT_UM_MSGB_SIZE	256
+#define VIRT_UM_MSGB_HEADROOM	128	/* room for a primitive in front of the GSMTAP header */
+#define VIRT_UM_RX_BATCH	16	/* max. messages received per recvmmsg() */
+#define VIRT_UM_TX_BATCH	64	/* max. messages queued for one sendmmsg() */
 #define DEFAULT_MS_MCAST_GROUP	"239.193.23.1"
 #define DEFAULT_MS_MCAST_PORT 4729 /* IANA-registered port for GSMTAP */
 #define DEFAULT_BTS_MCAST_GROUP	"239.193.23.2"
@@ -19,6 +22,13 @@ struct virt_um_inst {
 	void *priv;
 	struct mcast_bidir_sock *mcast_sock;
 	void (*recv_cb)(struct virt_um_inst *vui, struct msgb *msg);
+	/* empty msgbs for the next recvmmsg(), NULL once handed over */
+	struct msgb *rx_msg[VIRT_UM_RX_BATCH];
+	/* messages queued by virt_um_write_msg(), sent by virt_um_flush() */
+	struct msgb *tx_queue[VIRT_UM_TX_BATCH];
+	unsigned int tx_queue_len;
+	/* flush as soon as this many messages are queued (1: no batching) */
+	unsigned int tx_batch;
 };
 
 struct virt_um_inst *virt_um_init(
@@ -29,3 +39,4 @@ struct virt_um_inst *virt_um_init(
 void virt_um_destroy(struct virt_um_inst *vui);
 
 int virt_um_write_msg(struct virt_um_inst *vui, struct msgb *msg);
+int virt_um_flush(struct virt_um_inst *vui);
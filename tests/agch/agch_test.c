@@ -55,6 +55,25 @@ static int count_imm_ass_rej_refs(struct gsm48_imm_ass_rej *rej)
 	return count;
 }
 
+static void set_req_ref(struct gsm48_req_ref *ref, uint32_t fn)
+{
+	ref->t1 = (fn / 1326) % 32;
+	ref->t2 = fn % 26;
+	ref->t3_high = (fn % 51) >> 3;
+	ref->t3_low = (fn % 51) & 0x07;
+}
+
+static uint32_t get_req_ref_fn(const struct gsm48_req_ref *ref)
+{
+	struct gsm_time gt = {
+		.t1 = ref->t1,
+		.t2 = ref->t2,
+		.t3 = (ref->t3_high << 3) | ref->t3_low,
+	};
+
+	return gsm_gsmtime2fn(&gt);
+}
+
 static void put_imm_ass_rej(struct msgb *msg, int idx, uint8_t wait_ind)
 {
 	/* GSM CCCH - Immediate Assignment Reject */
@@ -69,12 +88,12 @@ static void put_imm_ass_rej(struct msgb *msg, int idx, uint8_t wait_ind)
 	rej = (struct gsm48_imm_ass_rej *)msg->l3h;
 	memmove(msg->l3h, gsm_a_ccch_data, sizeof(gsm_a_ccch_data));
 
-	rej->req_ref1.t1 = idx;
+	set_req_ref(&rej->req_ref1, idx);
 	rej->wait_ind1 = wait_ind;
 
-	rej->req_ref2.t1 = idx;
-	rej->req_ref3.t1 = idx;
-	rej->req_ref4.t1 = idx;
+	set_req_ref(&rej->req_ref2, idx);
+	set_req_ref(&rej->req_ref3, idx);
+	set_req_ref(&rej->req_ref4, idx);
 }
 
 static void put_imm_ass(struct msgb *msg, int idx)
@@ -91,7 +110,7 @@ static void put_imm_ass(struct msgb *msg, int idx)
 	ima = (struct gsm48_imm_ass *)msg->l3h;
 	memmove(msg->l3h, gsm_a_ccch_data, sizeof(gsm_a_ccch_data));
 
-	ima->req_ref.t1 = idx;
+	set_req_ref(&ima->req_ref, idx);
 }
 
 static void test_agch_queue(void)
@@ -111,10 +130,10 @@ static void test_agch_queue(void)
 	int imm_ass_rej_count = 0;
 	int imm_ass_rej_ref_count = 0;
 
-	g_time.fn = 0;
-	g_time.t1 = 0;
-	g_time.t2 = 0;
-	g_time.t3 = 6;
+	/* the requests are referred to by their FN (count), which must lie in
+	 * the past, but not further than T3126 */
+	gsm_fn2gsmtime(&bts->gsm_time, num_rounds * (num_ima_per_round + num_rej_per_round));
+	gsm_fn2gsmtime(&g_time, 15 * 51 + 6);
 
 	printf("Testing AGCH messages queue handling.\n");
 	bts->agch_queue.max_length = 32;
@@ -189,6 +208,87 @@ static void test_agch_queue(void)
 	       bts->agch_queue.pch_msgs);
 }
 
+static void test_agch_queue_expiry(void)
+{
+	static const uint32_t req_fn[] = { 8000, 9990, 9500 };
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	uint64_t dropped_msgs = bts->agch_queue.dropped_msgs;
+	struct gsm_time g_time;
+	struct msgb *msg;
+	int i, rc;
+
+	printf("Testing AGCH queue expiry.\n");
+	bts->agch_queue.max_length = 32;
+	bts->agch_queue.thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE;
+
+	gsm_fn2gsmtime(&bts->gsm_time, 10000);
+	g_time = bts->gsm_time;
+
+	/* the request at FN 8000 is older than T3126 (5 s without SI3) */
+	for (i = 0; i < ARRAY_SIZE(req_fn); i++) {
+		msg = msgb_alloc(GSM_MACBLOCK_LEN, __func__);
+		put_imm_ass(msg, req_fn[i]);
+		bts_agch_enqueue(bts, msg);
+	}
+	printf("AGCH filled: occupied %d\n", bts->agch_queue.length);
+
+	/* earliest deadline first */
+	while ((rc = bts_ccch_copy_msg(bts, out_buf, &g_time, CCCH_MSGT_AGCH)) > 0) {
+		struct gsm48_imm_ass *ima = (struct gsm48_imm_ass *)out_buf;
+		printf("Sent IMM ASS for the request at FN %u\n", get_req_ref_fn(&ima->req_ref));
+	}
+
+	printf("AGCH drained: occupied %d, dropped %"PRIu64"\n",
+	       bts->agch_queue.length, bts->agch_queue.dropped_msgs - dropped_msgs);
+}
+
+static void test_agch_queue_scattered_rej(void)
+{
+	/* IMM ASS REJ (odd) interleaved with IMM ASS (even) */
+	static const uint32_t req_fn[] = { 9001, 9002, 9003, 9004, 9005, 9006, 9007, 9008 };
+	const struct rate_ctr *rej_sent = rate_ctr_group_get_ctr(bts->ctrs, BTS_CTR_AGCH_REJ_SENT);
+	const struct rate_ctr *rej_refs = rate_ctr_group_get_ctr(bts->ctrs, BTS_CTR_AGCH_REJ_REFS);
+	uint64_t merged_msgs = bts->agch_queue.merged_msgs;
+	uint64_t rej_sent_start = rej_sent->current;
+	uint64_t rej_refs_start = rej_refs->current;
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	struct msgb *msg;
+	int i;
+
+	printf("Testing AGCH queue merging of scattered IMM ASS REJ.\n");
+	bts->agch_queue.max_length = 32;
+	bts->agch_queue.thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE;
+
+	gsm_fn2gsmtime(&bts->gsm_time, 10000);
+	g_time = bts->gsm_time;
+
+	for (i = 0; i < ARRAY_SIZE(req_fn); i++) {
+		msg = msgb_alloc(GSM_MACBLOCK_LEN, __func__);
+		if (req_fn[i] % 2)
+			put_imm_ass_rej(msg, req_fn[i], 10);
+		else
+			put_imm_ass(msg, req_fn[i]);
+		bts_agch_enqueue(bts, msg);
+	}
+	printf("AGCH filled: occupied %d, merged %"PRIu64"\n",
+	       bts->agch_queue.length, bts->agch_queue.merged_msgs - merged_msgs);
+
+	while (bts_ccch_copy_msg(bts, out_buf, &g_time, CCCH_MSGT_AGCH) > 0) {
+		struct gsm48_imm_ass *ima = (struct gsm48_imm_ass *)out_buf;
+
+		if (ima->msg_type == GSM48_MT_RR_IMM_ASS_REJ)
+			printf("Sent IMM ASS REJ with %d refs\n",
+			       count_imm_ass_rej_refs((struct gsm48_imm_ass_rej *)ima));
+		else
+			printf("Sent IMM ASS for the request at FN %u\n", get_req_ref_fn(&ima->req_ref));
+	}
+
+	printf("AGCH drained: occupied %d, imm.ass.rej sent %"PRIu64" (refs %"PRIu64")\n",
+	       bts->agch_queue.length, rej_sent->current - rej_sent_start,
+	       rej_refs->current - rej_refs_start);
+}
+
 static void test_agch_queue_length_computation(void)
 {
 	static const int ccch_configs[] = {
@@ -235,6 +335,8 @@ int main(int argc, char **argv)
 
 	test_agch_queue_length_computation();
 	test_agch_queue();
+	test_agch_queue_expiry();
+	test_agch_queue_scattered_rej();
 	printf("Success\n");
 
 	return 0;
@@ -44,6 +44,13 @@ static void test_amr_parse_mr_conf(void)
 		       mrc.mode[i].threshold,
 		       mrc.mode[i].hysteresis);
 	}
+	for (i = 0; i < mrc.num_modes; i++) {
+		printf("  Mode[%u]: THR_MX_Dn=%d cB, THR_MX_Up=%d cB\n",
+		       i, mrc.thresh_dn_cb[i], mrc.thresh_up_cb[i]);
+		OSMO_ASSERT(mrc.mode_idx[mrc.mode[i].mode] == (int) i);
+	}
+	for (i = 0; i < ARRAY_SIZE(mrc.mode_idx); i++)
+		printf("  Codec %u -> mode index %d\n", i, mrc.mode_idx[i]);
 
 	mrc_enc[1] = 0xff; /* all codec modes active */
 	printf("amr_parse_mr_conf() <- %s\n", osmo_hexdump(&mrc_enc[0], sizeof(mrc_enc)));
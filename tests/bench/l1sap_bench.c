@@ -0,0 +1,483 @@
+/* Benchmark for the L1SAP Uplink and Downlink paths.
+ *
+ * Activates a configurable number of TCH/F (FR) and SDCCH/8 lchans against
+ * a stub PHY and pushes synthetic primitives through l1sap_up(), the way a
+ * BTS model would: TCH.ind (-> ECU -> RTP), PH-DATA.ind on SDCCH (-> LAPDm
+ * -> RSL), TCH-RTS.ind (DL TCH queue -> TCH.req) and PH-RTS.ind on SDCCH
+ * (LAPDm dequeue -> PH-DATA.req).  Reports the time and the number of msgb
+ * allocations per primitive, and the size of the per-frame (hot) part of
+ * struct gsm_lchan. */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/application.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/abis/abis.h>
+#include <osmocom/abis/e1_input.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/lchan.h>
+#include <osmo-bts/l1sap.h>
+
+enum bench_prim {
+	BENCH_TCH_IND,
+	BENCH_PH_DATA_IND,
+	BENCH_TCH_RTS_IND,
+	BENCH_PH_RTS_IND,
+	_NUM_BENCH_PRIM
+};
+
+static const char *bench_prim_names[_NUM_BENCH_PRIM] = {
+	[BENCH_TCH_IND]		= "TCH.ind (TCH/F FR)",
+	[BENCH_PH_DATA_IND]	= "PH-DATA.ind (SDCCH)",
+	[BENCH_TCH_RTS_IND]	= "TCH-RTS.ind (TCH/F FR)",
+	[BENCH_PH_RTS_IND]	= "PH-RTS.ind (SDCCH)",
+};
+
+static struct {
+	unsigned int num_tchf;
+	unsigned int num_sdcch;
+	unsigned int num_rounds;
+	bool rtp;
+} cfg = {
+	.num_tchf = 7,
+	.num_sdcch = 8,
+	.num_rounds = 10000,
+	.rtp = true,
+};
+
+static struct {
+	uint64_t ns;
+	unsigned long long num;
+	unsigned long long msgb_allocs;
+	unsigned long long pool_allocs;
+} stats[_NUM_BENCH_PRIM];
+
+/* Primitives sent down to the stub PHY */
+static unsigned long long num_l1sap_down;
+
+/* msgbs allocated by the osmo-bts code (see the --wrap flags in Makefile.am);
+ * allocations within the libosmocore/libosmogsm libraries are not seen */
+static unsigned long long num_msgb_alloc;
+
+struct msgb *__real_msgb_alloc(uint16_t size, const char *name);
+struct msgb *__real_msgb_alloc_c(const void *ctx, uint16_t size, const char *name);
+
+struct msgb *__wrap_msgb_alloc(uint16_t size, const char *name)
+{
+	num_msgb_alloc++;
+	return __real_msgb_alloc(size, name);
+}
+
+struct msgb *__wrap_msgb_alloc_c(const void *ctx, uint16_t size, const char *name)
+{
+	num_msgb_alloc++;
+	return __real_msgb_alloc_c(ctx, size, name);
+}
+
+static unsigned long long pool_allocs(void)
+{
+	const struct l1sap_msgb_pool *pool;
+	unsigned long long n = 0;
+	unsigned int i;
+
+	for (i = 0; (pool = l1sap_msgb_pool_get(i)) != NULL; i++)
+		n += pool->hits + pool->misses;
+	return n;
+}
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* Hand a primitive to L1SAP and account its cost to stats[prim] */
+static void bench_l1sap_up(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap,
+			   enum bench_prim prim)
+{
+	unsigned long long msgb_allocs = num_msgb_alloc;
+	unsigned long long pool = pool_allocs();
+	struct timespec t0, t1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	l1sap_up(trx, l1sap);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	stats[prim].ns += timespec_ns(&t1) - timespec_ns(&t0);
+	stats[prim].num++;
+	stats[prim].msgb_allocs += num_msgb_alloc - msgb_allocs;
+	stats[prim].pool_allocs += pool_allocs() - pool;
+}
+
+int bts_model_l1sap_down(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
+{
+	struct msgb *msg = l1sap->oph.msg;
+	struct osmo_phsap_prim nl1sap;
+	struct gsm_lchan *lchan;
+	uint8_t chan_nr;
+
+	num_l1sap_down++;
+
+	switch (OSMO_PRIM_HDR(&l1sap->oph)) {
+	case OSMO_PRIM(PRIM_MPH_INFO, PRIM_OP_REQUEST):
+		if (l1sap->u.info.type != PRIM_INFO_ACTIVATE)
+			break;
+		chan_nr = l1sap->u.info.u.act_req.chan_nr;
+		lchan = &trx->ts[L1SAP_CHAN2TS(chan_nr)].lchan[l1sap_chan2ss(chan_nr)];
+
+		lchan_init_lapdm(lchan);
+		lchan_set_state(lchan, LCHAN_S_ACTIVE);
+
+		memset(&nl1sap, 0, sizeof(nl1sap));
+		osmo_prim_init(&nl1sap.oph, SAP_GSM_PH, PRIM_MPH_INFO, PRIM_OP_CONFIRM, NULL);
+		nl1sap.u.info.type = PRIM_INFO_ACTIVATE;
+		nl1sap.u.info.u.act_cnf.chan_nr = chan_nr;
+		return l1sap_up(trx, &nl1sap);
+	default:
+		/* PH-DATA.req, TCH.req: the PHY would transmit them now */
+		break;
+	}
+
+	if (msg)
+		msgb_free(msg);
+	return 0;
+}
+
+/* Give up the RSL messages queued towards the BSC */
+static unsigned int bench_rsl_drain(struct gsm_bts *bts)
+{
+	struct gsm_bts_trx *trx;
+	struct msgb *msg;
+	unsigned int n = 0;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		while ((msg = msgb_dequeue(&trx->rsl_link->tx_list))) {
+			msgb_free(msg);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/* Sink for the RTP packets of all lchans */
+static int bench_rtp_sink(struct sockaddr_in *sin)
+{
+	socklen_t len = sizeof(*sin);
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	OSMO_ASSERT(fd >= 0);
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	OSMO_ASSERT(bind(fd, (struct sockaddr *) sin, sizeof(*sin)) == 0);
+	OSMO_ASSERT(getsockname(fd, (struct sockaddr *) sin, &len) == 0);
+
+	return fd;
+}
+
+static unsigned int bench_rtp_drain(int fd)
+{
+	uint8_t buf[512];
+	unsigned int n = 0;
+
+	while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+		n++;
+
+	return n;
+}
+
+static struct gsm_bts_trx *bench_trx_alloc(struct gsm_bts *bts)
+{
+	struct e1inp_line *line;
+	struct e1inp_ts *sign_ts;
+	struct gsm_bts_trx *trx;
+	unsigned int tn;
+
+	trx = gsm_bts_trx_alloc(bts);
+	OSMO_ASSERT(trx != NULL);
+
+	/* RSL messages are queued on the signalling link, never sent */
+	line = e1inp_line_create(trx->nr, "ipa");
+	OSMO_ASSERT(line != NULL);
+	sign_ts = e1inp_line_ipa_rsl_ts(line, 0);
+	e1inp_ts_config_sign(sign_ts, line);
+	trx->rsl_link = e1inp_sign_link_create(sign_ts, E1INP_SIGN_RSL, NULL, 0, 0);
+	OSMO_ASSERT(trx->rsl_link != NULL);
+	trx->rsl_link->trx = trx;
+
+	trx->ts[0].pchan = GSM_PCHAN_SDCCH8_SACCH8C;
+	for (tn = 1; tn < TRX_NR_TS; tn++)
+		trx->ts[tn].pchan = GSM_PCHAN_TCH_F;
+
+	return trx;
+}
+
+static void bench_lchan_act(struct gsm_lchan *lchan, uint8_t chan_nr, const struct sockaddr_in *sink)
+{
+	struct in_addr ia;
+
+	if (lchan->ts->pchan == GSM_PCHAN_TCH_F) {
+		lchan->type = GSM_LCHAN_TCH_F;
+		lchan->rsl_cmode = RSL_CMOD_SPD_SPEECH;
+		lchan->tch_mode = GSM48_CMODE_SPEECH_V1;
+	} else {
+		lchan->type = GSM_LCHAN_SDCCH;
+		lchan->rsl_cmode = RSL_CMOD_SPD_SIGN;
+		lchan->tch_mode = GSM48_CMODE_SIGN;
+	}
+
+	OSMO_ASSERT(l1sap_chan_act(lchan->ts->trx, chan_nr) == 0);
+	OSMO_ASSERT(lchan->state == LCHAN_S_ACTIVE);
+
+	if (lchan->type != GSM_LCHAN_TCH_F || sink == NULL)
+		return;
+
+	OSMO_ASSERT(lchan_rtp_socket_create(lchan, "127.0.0.1") == 0);
+	ia = sink->sin_addr;
+	OSMO_ASSERT(lchan_rtp_socket_connect(lchan, &ia, ntohs(sink->sin_port)) == 0);
+}
+
+static void bench_tch_ind(struct gsm_lchan *lchan, uint8_t chan_nr, uint32_t fn)
+{
+	/* FR speech frame with a valid signature */
+	static const uint8_t fr[GSM_FR_BYTES] = { 0xd0, 0x11, 0x22, 0x33 };
+	struct osmo_phsap_prim *l1sap;
+	struct msgb *msg;
+
+	msg = l1sap_msgb_alloc(sizeof(fr));
+	l1sap = msgb_l1sap_prim(msg);
+	osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_TCH, PRIM_OP_INDICATION, msg);
+	l1sap->u.tch.chan_nr = chan_nr;
+	l1sap->u.tch.fn = fn;
+	l1sap->u.tch.rssi = -60;
+	l1sap->u.tch.lqual_cb = 100;
+	msg->l2h = msgb_put(msg, sizeof(fr));
+	memcpy(msg->l2h, fr, sizeof(fr));
+
+	bench_l1sap_up(lchan->ts->trx, l1sap, BENCH_TCH_IND);
+}
+
+static void bench_ph_data_ind(struct gsm_lchan *lchan, uint8_t chan_nr, uint32_t fn)
+{
+	/* LAPDm UI frame on SAPI 0, resulting in an RSL UNIT DATA IND */
+	static const uint8_t ui[GSM_MACBLOCK_LEN] = {
+		0x03, 0x03, 0x09, 0x06, 0x2d,
+		0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+		0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b, 0x2b,
+	};
+	struct osmo_phsap_prim *l1sap;
+	struct msgb *msg;
+
+	msg = l1sap_msgb_alloc(sizeof(ui));
+	l1sap = msgb_l1sap_prim(msg);
+	osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_PH_DATA, PRIM_OP_INDICATION, msg);
+	l1sap->u.data.chan_nr = chan_nr;
+	l1sap->u.data.link_id = 0x00;
+	l1sap->u.data.fn = fn;
+	l1sap->u.data.rssi = -60;
+	l1sap->u.data.lqual_cb = 100;
+	l1sap->u.data.pdch_presence_info = PRES_INFO_BOTH;
+	msg->l2h = msgb_put(msg, sizeof(ui));
+	memcpy(msg->l2h, ui, sizeof(ui));
+
+	bench_l1sap_up(lchan->ts->trx, l1sap, BENCH_PH_DATA_IND);
+}
+
+static void bench_tch_rts_ind(struct gsm_lchan *lchan, uint8_t chan_nr, uint32_t fn)
+{
+	static const uint8_t fr[GSM_FR_BYTES] = { 0xd0, 0x44, 0x55, 0x66 };
+	struct osmo_phsap_prim *l1sap;
+	struct msgb *msg;
+
+	/* a DL frame as l1sap_rtp_rx_cb() would have queued it */
+	msg = l1sap_msgb_alloc(sizeof(fr));
+	memcpy(msgb_put(msg, sizeof(fr)), fr, sizeof(fr));
+	msgb_pull(msg, sizeof(struct osmo_phsap_prim));
+	lchan_dl_tch_queue_enqueue(lchan, msg, 1);
+
+	msg = l1sap_msgb_alloc(200);
+	l1sap = msgb_l1sap_prim(msg);
+	osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_TCH_RTS, PRIM_OP_INDICATION, msg);
+	l1sap->u.tch.chan_nr = chan_nr;
+	l1sap->u.tch.fn = fn;
+
+	bench_l1sap_up(lchan->ts->trx, l1sap, BENCH_TCH_RTS_IND);
+}
+
+static void bench_ph_rts_ind(struct gsm_lchan *lchan, uint8_t chan_nr, uint32_t fn)
+{
+	struct osmo_phsap_prim *l1sap;
+	struct msgb *msg;
+
+	msg = l1sap_msgb_alloc(200);
+	l1sap = msgb_l1sap_prim(msg);
+	osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_PH_RTS, PRIM_OP_INDICATION, msg);
+	l1sap->u.data.chan_nr = chan_nr;
+	l1sap->u.data.link_id = 0x00;
+	l1sap->u.data.fn = fn;
+
+	bench_l1sap_up(lchan->ts->trx, l1sap, BENCH_PH_RTS_IND);
+}
+
+static void print_help(const char *argv0)
+{
+	printf("Usage: %s [-f NUM_TCHF] [-s NUM_SDCCH] [-n NUM_ROUNDS] [-R]\n"
+	       "  -f NUM_TCHF     number of TCH/F lchans, 7 per TRX (default %u)\n"
+	       "  -s NUM_SDCCH    number of SDCCH/8 lchans, 8 per TRX (default %u)\n"
+	       "  -n NUM_ROUNDS   number of primitives of each type per lchan (default %u)\n"
+	       "  -R              do not send the Uplink speech frames via RTP\n",
+	       argv0, cfg.num_tchf, cfg.num_sdcch, cfg.num_rounds);
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_lchan *tchf[256], *sdcch[256];
+	uint8_t tchf_nr[256], sdcch_nr[256];
+	unsigned int i, r, num_trx, rtp_pkts = 0, rsl_msgs = 0;
+	struct sockaddr_in sink;
+	struct gsm_bts_trx *trx;
+	struct gsm_bts *bts;
+	int sink_fd = -1;
+	uint32_t fn = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "hf:s:n:R")) != -1) {
+		switch (c) {
+		case 'f':
+			cfg.num_tchf = atoi(optarg);
+			break;
+		case 's':
+			cfg.num_sdcch = atoi(optarg);
+			break;
+		case 'n':
+			cfg.num_rounds = atoi(optarg);
+			break;
+		case 'R':
+			cfg.rtp = false;
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.num_rounds < 1 || cfg.num_tchf > ARRAY_SIZE(tchf) || cfg.num_sdcch > ARRAY_SIZE(sdcch) ||
+	    cfg.num_tchf + cfg.num_sdcch == 0) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	for (i = 0; i < bts_log_info.num_cat; i++)
+		osmo_stderr_target->categories[i].loglevel = LOGL_FATAL;
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	OSMO_ASSERT(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	OSMO_ASSERT(bts != NULL);
+	OSMO_ASSERT(bts_init(bts) == 0);
+	libosmo_abis_init(NULL);
+
+	if (cfg.rtp)
+		sink_fd = bench_rtp_sink(&sink);
+
+	num_trx = OSMO_MAX((cfg.num_tchf + TRX_NR_TS - 2) / (TRX_NR_TS - 1), (cfg.num_sdcch + 7) / 8);
+	for (i = 0; i < num_trx; i++)
+		bench_trx_alloc(bts);
+
+	for (i = 0; i < cfg.num_tchf; i++) {
+		trx = gsm_bts_trx_num(bts, i / (TRX_NR_TS - 1));
+		tchf[i] = &trx->ts[1 + i % (TRX_NR_TS - 1)].lchan[0];
+		tchf_nr[i] = RSL_CHAN_Bm_ACCH | tchf[i]->ts->nr;
+		bench_lchan_act(tchf[i], tchf_nr[i], cfg.rtp ? &sink : NULL);
+	}
+	for (i = 0; i < cfg.num_sdcch; i++) {
+		trx = gsm_bts_trx_num(bts, i / 8);
+		sdcch[i] = &trx->ts[0].lchan[i % 8];
+		sdcch_nr[i] = RSL_CHAN_SDCCH8_ACCH | ((i % 8) << 3);
+		bench_lchan_act(sdcch[i], sdcch_nr[i], NULL);
+	}
+	bench_rsl_drain(bts);
+
+	for (r = 0; r < cfg.num_rounds; r++) {
+		fn = GSM_TDMA_FN_SUM(fn, 4);
+		for (i = 0; i < cfg.num_tchf; i++) {
+			bench_tch_ind(tchf[i], tchf_nr[i], fn);
+			bench_tch_rts_ind(tchf[i], tchf_nr[i], fn);
+		}
+		for (i = 0; i < cfg.num_sdcch; i++) {
+			bench_ph_data_ind(sdcch[i], sdcch_nr[i], fn);
+			bench_ph_rts_ind(sdcch[i], sdcch_nr[i], fn);
+		}
+
+		rsl_msgs += bench_rsl_drain(bts);
+		if (sink_fd >= 0)
+			rtp_pkts += bench_rtp_drain(sink_fd);
+	}
+
+	printf("%u TRX, %u TCH/F, %u SDCCH, %u rounds, RTP %s\n", num_trx,
+	       cfg.num_tchf, cfg.num_sdcch, cfg.num_rounds, cfg.rtp ? "on" : "off");
+	for (i = 0; i < _NUM_BENCH_PRIM; i++) {
+		if (stats[i].num == 0)
+			continue;
+		printf("%-24s %8.1f ns/prim, %5.2f msgb allocs/prim, %5.2f pool allocs/prim\n",
+		       bench_prim_names[i], (double)stats[i].ns / stats[i].num,
+		       (double)stats[i].msgb_allocs / stats[i].num,
+		       (double)stats[i].pool_allocs / stats[i].num);
+	}
+	printf("%llu primitives to the PHY, %u RSL messages, %u RTP packets\n",
+	       num_l1sap_down, rsl_msgs, rtp_pkts);
+	/* 'encr' is the first of the fields not used on every frame */
+	printf("lchan: %zu bytes, hot part %zu bytes (%zu cache lines)\n",
+	       sizeof(struct gsm_lchan), offsetof(struct gsm_lchan, encr),
+	       (offsetof(struct gsm_lchan, encr) + 63) / 64);
+
+	return EXIT_SUCCESS;
+}
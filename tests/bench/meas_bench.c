@@ -0,0 +1,201 @@
+/* Benchmark for the averaging of the UL burst measurements.
+ *
+ * Compares trx_sched_meas_avg(), which keeps running sums over the history
+ * of a logical channel, against a plain ring of samples that is summed up
+ * on every call, for each of the averaging modes. */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/application.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/scheduler.h>
+
+static struct {
+	unsigned int num_iter;
+} cfg = {
+	.num_iter = 1000000,
+};
+
+static const char *mode_names[] = {
+	[SCHED_MEAS_AVG_M_S24N22] = "S24N22",
+	[SCHED_MEAS_AVG_M_S22N22] = "S22N22",
+	[SCHED_MEAS_AVG_M_S4N4] = "S4N4",
+	[SCHED_MEAS_AVG_M_S8N8] = "S8N8",
+	[SCHED_MEAS_AVG_M_S6N4] = "S6N4",
+	[SCHED_MEAS_AVG_M_S6N6] = "S6N6",
+	[SCHED_MEAS_AVG_M_S8N4] = "S8N4",
+	[SCHED_MEAS_AVG_M_S6N2] = "S6N2",
+	[SCHED_MEAS_AVG_M_S4N2] = "S4N2",
+};
+
+static const uint8_t mode_sets[][2] = {
+	[SCHED_MEAS_AVG_M_S24N22] = { 24, 22 },
+	[SCHED_MEAS_AVG_M_S22N22] = { 22, 22 },
+	[SCHED_MEAS_AVG_M_S4N4] = { 4, 4 },
+	[SCHED_MEAS_AVG_M_S8N8] = { 8, 8 },
+	[SCHED_MEAS_AVG_M_S6N4] = { 6, 4 },
+	[SCHED_MEAS_AVG_M_S6N6] = { 6, 6 },
+	[SCHED_MEAS_AVG_M_S8N4] = { 8, 4 },
+	[SCHED_MEAS_AVG_M_S6N2] = { 6, 2 },
+	[SCHED_MEAS_AVG_M_S4N2] = { 4, 2 },
+};
+
+/* Reference implementation: plain ring of samples, summed on every call
+ * (the correctness check against it lives in tests/trx_meas) */
+struct ref_hist {
+	struct l1sched_meas_set buf[24];
+	unsigned int current;
+};
+
+static void ref_push(struct ref_hist *h, const struct trx_ul_burst_ind *bi)
+{
+	h->buf[h->current] = (struct l1sched_meas_set) {
+		.fn = bi->fn,
+		.ci_cb = (bi->flags & TRX_BI_F_CI_CB) ? bi->ci_cb : 0,
+		.toa256 = bi->toa256,
+		.rssi = bi->rssi,
+	};
+
+	h->current = (h->current + 1) % ARRAY_SIZE(h->buf);
+}
+
+static void ref_avg(const struct ref_hist *h, struct l1sched_meas_set *avg,
+		    enum sched_meas_avg_mode mode)
+{
+	const unsigned int hist_size = ARRAY_SIZE(h->buf);
+	const unsigned int shift = mode_sets[mode][0];
+	const unsigned int num = mode_sets[mode][1];
+	float rssi_sum = 0;
+	int toa256_sum = 0;
+	int ci_cb_sum = 0;
+	unsigned int i, pos;
+
+	for (i = 0; i < num; i++) {
+		pos = (h->current + hist_size - shift + i) % hist_size;
+		rssi_sum   += h->buf[pos].rssi;
+		toa256_sum += h->buf[pos].toa256;
+		ci_cb_sum  += h->buf[pos].ci_cb;
+	}
+
+	pos = (h->current + hist_size - shift) % hist_size;
+	*avg = (struct l1sched_meas_set) {
+		.fn     = h->buf[pos].fn,
+		.rssi   = (rssi_sum   / num),
+		.toa256 = (toa256_sum / (int)num),
+		.ci_cb  = (ci_cb_sum  / (int)num),
+	};
+}
+
+static double elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static void bench_run(enum sched_meas_avg_mode mode)
+{
+	struct l1sched_meas_ring hist = { 0 };
+	struct l1sched_chan_state chan_state = { .meas.hist = &hist };
+	struct ref_hist ref = { 0 };
+	struct trx_ul_burst_ind bi = {
+		.flags = TRX_BI_F_CI_CB,
+		.rssi = -60,
+		.toa256 = 128,
+		.ci_cb = 150,
+	};
+	struct l1sched_meas_set avg;
+	struct timespec start, end;
+	double ref_ns, sums_ns;
+	volatile float sink = 0;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < cfg.num_iter; i++) {
+		bi.fn = i;
+		ref_push(&ref, &bi);
+		ref_avg(&ref, &avg, mode);
+		sink += avg.rssi;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ref_ns = elapsed_ns(&start, &end) / cfg.num_iter;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < cfg.num_iter; i++) {
+		bi.fn = i;
+		trx_sched_meas_push(&chan_state, &bi);
+		trx_sched_meas_avg(&chan_state, &avg, mode);
+		sink += avg.rssi;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	sums_ns = elapsed_ns(&start, &end) / cfg.num_iter;
+
+	printf("%-6s: reference %6.1f ns/burst, running sums %6.1f ns/burst\n",
+	       mode_names[mode], ref_ns, sums_ns);
+}
+
+static void print_help(const char *argv0)
+{
+	printf("Usage: %s [-n NUM_BURSTS]\n"
+	       "  -n NUM_BURSTS  number of bursts per measurement (default %u)\n",
+	       argv0, cfg.num_iter);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+	unsigned int mode;
+	int c;
+
+	while ((c = getopt(argc, argv, "hn:")) != -1) {
+		switch (c) {
+		case 'n':
+			cfg.num_iter = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.num_iter < 1) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	osmo_stderr_target->categories[DMEAS].loglevel = LOGL_NOTICE;
+
+	for (mode = 0; mode < ARRAY_SIZE(mode_sets); mode++)
+		bench_run(mode);
+
+	return EXIT_SUCCESS;
+}
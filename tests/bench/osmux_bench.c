@@ -0,0 +1,165 @@
+/* Benchmark for the lookup of the lchan of received Osmux frames.
+ *
+ * Connects a growing number of lchans via Osmux (all towards the same
+ * peer) and measures the time osmux_lchan_find() takes per received
+ * frame, for frames addressed to random connected lchans. */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/application.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/lchan.h>
+#include <osmo-bts/osmux.h>
+
+static struct {
+	unsigned int num_lookups;
+} cfg = {
+	.num_lookups = 1000000,
+};
+
+/* Numbers of connected lchans to measure with (max. one per local CID) */
+static const unsigned int bench_num_lchans[] = { 1, 8, 32, 128, 255 };
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* Connect the first lchan of the next timeslot, adding a TRX if needed */
+static struct gsm_lchan *bench_lchan_connect(struct gsm_bts *bts, unsigned int idx)
+{
+	struct gsm_bts_trx *trx;
+	struct gsm_lchan *lchan;
+
+	if (idx / TRX_NR_TS >= bts->num_trx)
+		OSMO_ASSERT(gsm_bts_trx_alloc(bts) != NULL);
+	trx = gsm_bts_trx_num(bts, idx / TRX_NR_TS);
+	lchan = &trx->ts[idx % TRX_NR_TS].lchan[0];
+
+	OSMO_ASSERT(lchan_osmux_init(lchan, 0) == 0);
+	lchan->abis_ip.connect_ip = 0x7f000001;
+	lchan->abis_ip.connect_port = OSMUX_DEFAULT_PORT;
+	lchan->abis_ip.osmux.remote_cid = idx;
+	OSMO_ASSERT(lchan_osmux_connect(lchan) == 0);
+
+	return lchan;
+}
+
+static void bench_run(struct gsm_bts *bts, struct gsm_lchan **lchans, unsigned int num_lchans)
+{
+	const struct osmux_handle *h;
+	struct gsm_lchan *found;
+	struct timespec t0, t1;
+	unsigned int i;
+	uint8_t *cids;
+
+	/* All lchans share the same peer */
+	h = osmux_xfrm_input_get_deliver_cb_data(lchans[0]->abis_ip.osmux.in);
+
+	/* Frames for random lchans, determined in advance */
+	cids = talloc_array(bts, uint8_t, cfg.num_lookups);
+	OSMO_ASSERT(cids != NULL);
+	for (i = 0; i < cfg.num_lookups; i++)
+		cids[i] = lchans[rand() % num_lchans]->abis_ip.osmux.local_cid;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < cfg.num_lookups; i++) {
+		found = osmux_lchan_find(bts, &h->rem_addr, cids[i]);
+		OSMO_ASSERT(found != NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	printf("%3u lchans: %6.1f ns/lookup\n", num_lchans,
+	       (double)(timespec_ns(&t1) - timespec_ns(&t0)) / cfg.num_lookups);
+
+	talloc_free(cids);
+}
+
+static void print_help(const char *argv0)
+{
+	printf("Usage: %s [-n NUM_LOOKUPS]\n"
+	       "  -n NUM_LOOKUPS  number of lookups per measurement (default %u)\n",
+	       argv0, cfg.num_lookups);
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_lchan *lchans[OSMUX_CID_MAX + 1];
+	unsigned int i, num_lchans = 0;
+	struct gsm_bts *bts;
+	int c;
+
+	while ((c = getopt(argc, argv, "hn:")) != -1) {
+		switch (c) {
+		case 'n':
+			cfg.num_lookups = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.num_lookups < 1) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	for (i = 0; i < bts_log_info.num_cat; i++)
+		osmo_stderr_target->categories[i].loglevel = LOGL_FATAL;
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	OSMO_ASSERT(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	OSMO_ASSERT(bts != NULL);
+	OSMO_ASSERT(bts_init(bts) == 0);
+
+	srand(0x1337);
+	for (i = 0; i < ARRAY_SIZE(bench_num_lchans); i++) {
+		while (num_lchans < bench_num_lchans[i]) {
+			lchans[num_lchans] = bench_lchan_connect(bts, num_lchans);
+			num_lchans++;
+		}
+		bench_run(bts, lchans, num_lchans);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/* Benchmark for the paging queue.
+ *
+ * Queues a large number of distinct TMSI/IMSI identities spread over all
+ * paging groups, queues them a second time (duplicates), and then drives
+ * paging_gen_msg() for as many 51-multiframes as it takes to drain the
+ * queue.  Reports the time per operation and the memory footprint of the
+ * paging state. */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/application.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/paging.h>
+
+static struct {
+	unsigned int num_identities;
+	unsigned int imsi_percent;
+} cfg = {
+	.num_identities = 100000,
+	.imsi_percent = 20,
+};
+
+/* First frames (T3) of the CCCH blocks of a non-combined CCCH */
+static const uint8_t ccch_block_t3[] = { 6, 12, 16, 22, 26, 32, 36, 42, 46 };
+
+#define IDENTITY_LV_LEN 9
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static double elapsed_ns(const struct timespec *t0, const struct timespec *t1, unsigned int n)
+{
+	return (double)(timespec_ns(t1) - timespec_ns(t0)) / n;
+}
+
+/* Generate the identity number idx, as TMSI or as IMSI */
+static void bench_gen_identity(uint8_t *lv, unsigned int idx, bool imsi)
+{
+	if (imsi) {
+		uint8_t tlv[2 + IDENTITY_LV_LEN];
+		char digits[16];
+
+		snprintf(digits, sizeof(digits), "00101%010u", idx);
+		/* gsm48_generate_mid_from_imsi() puts a TLV, strip the tag */
+		gsm48_generate_mid_from_imsi(tlv, digits);
+		memcpy(lv, tlv + 1, tlv[1] + 1);
+	} else {
+		lv[0] = 5;
+		lv[1] = 0xf0 | GSM_MI_TYPE_TMSI;
+		osmo_store32be(0xc0000000 | idx, &lv[2]);
+	}
+}
+
+static void bench_run(struct gsm_bts *bts, uint8_t *identities, unsigned int num_groups)
+{
+	struct paging_state *ps = bts->paging_state;
+	unsigned int i, num_blocks = 0;
+	struct timespec t0, t1;
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time gt;
+	uint32_t fn = 0;
+	int is_empty;
+	int rc;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < cfg.num_identities; i++) {
+		rc = paging_add_identity(ps, i % num_groups, &identities[i * IDENTITY_LV_LEN], 0);
+		OSMO_ASSERT(rc == 0);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	printf("add:        %6.1f ns/identity\n", elapsed_ns(&t0, &t1, cfg.num_identities));
+	printf("footprint:  %zu bytes (%.1f bytes/identity)\n", talloc_total_size(ps),
+	       (double)talloc_total_size(ps) / cfg.num_identities);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < cfg.num_identities; i++) {
+		rc = paging_add_identity(ps, i % num_groups, &identities[i * IDENTITY_LV_LEN], 0);
+		OSMO_ASSERT(rc == -EEXIST);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	printf("duplicate:  %6.1f ns/identity\n", elapsed_ns(&t0, &t1, cfg.num_identities));
+
+	/* With a lifetime of 0, each record is dropped after its first transmission */
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (paging_queue_length(ps) > 0) {
+		for (i = 0; i < ARRAY_SIZE(ccch_block_t3); i++) {
+			gsm_fn2gsmtime(&gt, fn + ccch_block_t3[i]);
+			bts->gsm_time = gt;
+			paging_gen_msg(ps, out_buf, &gt, &is_empty);
+			num_blocks++;
+		}
+		fn = GSM_TDMA_FN_SUM(fn, 51);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	printf("gen:        %6.1f ns/block (%u blocks, %u 51-multiframes)\n",
+	       elapsed_ns(&t0, &t1, num_blocks), num_blocks, num_blocks / (unsigned int)ARRAY_SIZE(ccch_block_t3));
+}
+
+static void print_help(const char *argv0)
+{
+	printf("Usage: %s [-n NUM_IDENTITIES] [-i IMSI_PERCENT]\n"
+	       "  -n NUM_IDENTITIES  number of identities to queue (default %u)\n"
+	       "  -i IMSI_PERCENT    share of IMSIs among the identities (default %u)\n",
+	       argv0, cfg.num_identities, cfg.imsi_percent);
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm48_control_channel_descr chan_desc = {
+		.ccch_conf = RSL_BCCH_CCCH_CONF_1_NC,
+		.bs_ag_blks_res = 0,
+		.bs_pa_mfrms = 7, /* 9 multiframes */
+	};
+	unsigned int i, num_groups;
+	uint8_t *identities;
+	struct gsm_bts *bts;
+	int c;
+
+	while ((c = getopt(argc, argv, "hn:i:")) != -1) {
+		switch (c) {
+		case 'n':
+			cfg.num_identities = atoi(optarg);
+			break;
+		case 'i':
+			cfg.imsi_percent = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.num_identities < 1 || cfg.imsi_percent > 100) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	for (i = 0; i < bts_log_info.num_cat; i++)
+		osmo_stderr_target->categories[i].loglevel = LOGL_FATAL;
+
+	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
+	OSMO_ASSERT(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	OSMO_ASSERT(bts != NULL);
+	OSMO_ASSERT(bts_init(bts) == 0);
+
+	paging_si_update(bts->paging_state, &chan_desc);
+	paging_set_queue_max(bts->paging_state, cfg.num_identities);
+	paging_set_lifetime(bts->paging_state, 0);
+	num_groups = gsm48_number_of_paging_subchannels(&chan_desc);
+
+	/* Identities are generated in advance, spread over all paging groups */
+	identities = talloc_zero_array(tall_bts_ctx, uint8_t, cfg.num_identities * IDENTITY_LV_LEN);
+	OSMO_ASSERT(identities != NULL);
+	srand(0x1337);
+	for (i = 0; i < cfg.num_identities; i++)
+		bench_gen_identity(&identities[i * IDENTITY_LV_LEN], i, rand() % 100 < cfg.imsi_percent);
+
+	printf("%u identities (%u%% IMSI) in %u paging groups\n",
+	       cfg.num_identities, cfg.imsi_percent, num_groups);
+	bench_run(bts, identities, num_groups);
+
+	talloc_free(identities);
+	return EXIT_SUCCESS;
+}
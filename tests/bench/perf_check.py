@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+# Performance regression check for the benchmarks in tests/bench.
+#
+# (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+# All Rights Reserved
+#
+# SPDX-License-Identifier: AGPL-3.0+
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+'''
+Run the benchmarks with fixed parameters and compare their results against
+the baselines stored as <bench>.json in the baseline directory.  All metrics
+are "lower is better"; a metric more than its tolerance above the baseline
+is a regression and makes the check fail.
+
+Timings depend on the machine, so baselines are only meaningful on the host
+that recorded them: record them with --update (make check-perf-update) and
+keep them next to the CI job that runs 'make check-perf'.  Benchmarks
+without a baseline are run and reported, but cannot fail.
+'''
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+# Time metrics: allowed relative increase, overridable with --tolerance
+TIME_TOLERANCE = 0.15
+# Count metrics (allocations, bytes) are deterministic and must not grow
+COUNT_TOLERANCE = 0.0
+
+
+def parse_sched(out):
+    for m in re.finditer(r'^(\S+)\s+avg\s+(\d+) ns', out, re.M):
+        yield '%s avg ns/frame' % m.group(1), float(m.group(2)), 'time'
+    m = re.search(r'\(([\d.]+) us per \d+ us TDMA frame\)', out)
+    if m:
+        yield 'us/frame', float(m.group(1)), 'time'
+
+
+def parse_paging(out):
+    for m in re.finditer(r'^(add|duplicate|gen):\s+([\d.]+) ns/(\w+)', out, re.M):
+        yield '%s ns/%s' % (m.group(1), m.group(3)), float(m.group(2)), 'time'
+    m = re.search(r'^footprint:\s+(\d+) bytes', out, re.M)
+    if m:
+        yield 'footprint bytes', float(m.group(1)), 'count'
+
+
+def parse_osmux(out):
+    for m in re.finditer(r'^\s*(\d+) lchans:\s+([\d.]+) ns/lookup', out, re.M):
+        yield '%s lchans ns/lookup' % m.group(1), float(m.group(2)), 'time'
+
+
+def parse_l1sap(out):
+    for m in re.finditer(r'^(.+?)\s+([\d.]+) ns/prim, +([\d.]+) msgb allocs/prim', out, re.M):
+        yield '%s ns/prim' % m.group(1), float(m.group(2)), 'time'
+        yield '%s msgb allocs/prim' % m.group(1), float(m.group(3)), 'count'
+    m = re.search(r'^lchan: \d+ bytes, hot part (\d+) bytes', out, re.M)
+    if m:
+        yield 'lchan hot part bytes', float(m.group(1)), 'count'
+
+
+def parse_rsl(out):
+    msg = None
+    for line in out.splitlines():
+        m = re.match(r'^(.+?) \(\d+ bytes', line)
+        if m:
+            msg = m.group(1)
+            continue
+        m = re.match(r'^\s+(\w+):\s+([\d.]+) ns/msg', line)
+        if m and msg:
+            yield '%s %s ns/msg' % (msg, m.group(1)), float(m.group(2)), 'time'
+
+
+
+def parse_meas(out):
+    for m in re.finditer(r'^(\w+)\s*: reference\s+([\d.]+) ns/burst, running sums\s+([\d.]+) ns/burst',
+                         out, re.M):
+        yield '%s running sums ns/burst' % m.group(1), float(m.group(3)), 'time'
+
+
+# (name, fixed arguments, parser)
+BENCHMARKS = (
+    ('sched_bench', ['-t', '2', '-n', '20000'], parse_sched),
+    ('paging_bench', ['-n', '10000', '-i', '20'], parse_paging),
+    ('osmux_bench', ['-n', '1000000'], parse_osmux),
+    ('l1sap_bench', ['-f', '7', '-s', '8', '-n', '10000', '-R'], parse_l1sap),
+    ('rsl_bench', ['-n', '1000000'], parse_rsl),
+    ('meas_bench', ['-n', '1000000'], parse_meas),
+)
+
+
+def run_bench(path, args, parser, runs):
+    '''Run a benchmark several times, keep the best value of each metric'''
+    best = {}
+    kinds = {}
+    for _ in range(runs):
+        out = subprocess.run([path] + args, check=True, stdout=subprocess.PIPE,
+                             universal_newlines=True).stdout
+        for name, val, kind in parser(out):
+            best[name] = min(val, best.get(name, val))
+            kinds[name] = kind
+    if not best:
+        raise RuntimeError('%s: no results found in the output' % path)
+    return best, kinds
+
+
+def check(name, args, results, kinds, baseline, tol):
+    if baseline.get('args') != args:
+        print('  baseline was recorded with different arguments %r, run --update'
+              % baseline.get('args'))
+        return False
+
+    ok = True
+    for metric, val in sorted(results.items()):
+        ref = baseline['metrics'].get(metric)
+        if ref is None:
+            print('  %-40s %12.1f (new metric)' % (metric, val))
+            continue
+        limit = tol if kinds[metric] == 'time' else COUNT_TOLERANCE
+        delta = (val - ref) / ref if ref else (1.0 if val > ref else 0.0)
+        verdict = ''
+        if delta > limit:
+            verdict = '  REGRESSION (> %+.0f%%)' % (limit * 100)
+            ok = False
+        elif delta < -limit and limit > 0:
+            verdict = '  (faster, consider --update)'
+        print('  %-40s %12.1f  baseline %12.1f  %+6.1f%%%s'
+              % (metric, val, ref, delta * 100, verdict))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--bench-dir', default='.',
+                        help='directory with the benchmark binaries')
+    parser.add_argument('--baseline-dir', default='baseline',
+                        help='directory with the <bench>.json baselines')
+    parser.add_argument('--update', action='store_true',
+                        help='record the results as the new baselines')
+    parser.add_argument('--runs', type=int, default=3,
+                        help='runs per benchmark, the best result counts (default: 3)')
+    parser.add_argument('--tolerance', type=float, default=TIME_TOLERANCE,
+                        help='allowed relative increase of the time metrics (default: %.2f)'
+                        % TIME_TOLERANCE)
+    parser.add_argument('--only', action='append',
+                        help='only run the named benchmark (repeatable)')
+    opts = parser.parse_args()
+
+    failed = []
+    for name, args, parse in BENCHMARKS:
+        if opts.only and name not in opts.only:
+            continue
+
+        print('%s %s' % (name, ' '.join(args)))
+        results, kinds = run_bench(os.path.join(opts.bench_dir, name), args, parse, opts.runs)
+        path = os.path.join(opts.baseline_dir, name + '.json')
+
+        if opts.update:
+            os.makedirs(opts.baseline_dir, exist_ok=True)
+            with open(path, 'w') as f:
+                json.dump({'args': args, 'metrics': results}, f, indent=2, sort_keys=True)
+                f.write('\n')
+            print('  baseline written to %s' % path)
+            continue
+
+        if not os.path.exists(path):
+            for metric, val in sorted(results.items()):
+                print('  %-40s %12.1f' % (metric, val))
+            print('  no baseline at %s, not checked' % path)
+            continue
+
+        with open(path) as f:
+            baseline = json.load(f)
+        if not check(name, args, results, kinds, baseline, opts.tolerance):
+            failed.append(name)
+
+    if failed:
+        print('Performance regression in: %s' % ', '.join(failed))
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
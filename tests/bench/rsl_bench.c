@@ -0,0 +1,181 @@
+/* Benchmark for the parsing of frequent RSL messages.
+ *
+ * Parses the IEs of a CHANnel ACTIVation and a PAGING CoMmanD, encoded
+ * like osmo-bsc does, with rsl_tlv_parse() (all 256 IEs) and with
+ * rsl_tlv_parse_ies() (only the IEs the message can contain), and
+ * measures the time per message. */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/gsm/tlv.h>
+#include <osmocom/gsm/rsl.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmo-bts/rsl.h>
+
+static struct {
+	unsigned int num_msgs;
+} cfg = {
+	.num_msgs = 1000000,
+};
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* TCH/F AMR with A5/1, as sent by osmo-bsc for an assignment */
+static void put_chan_activ(struct msgb *msg)
+{
+	static const uint8_t chan_mode[] = { 0x00, RSL_CMOD_SPD_SPEECH, RSL_CMOD_CRT_TCH_Bm,
+					     RSL_CMOD_SP_GSM3 };
+	static const uint8_t encr_info[] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+	static const uint8_t mr_config[] = { 0x20, 0x95 };
+	static const uint8_t ms_power_param[] = { 0x00 };
+	static const uint8_t rep_acch_cap[] = { 0x00 };
+	static const uint8_t tsc[] = { 0x00, 0x07 };
+
+	msgb_tv_put(msg, RSL_IE_ACT_TYPE, RSL_ACT_INTRA_NORM_ASS);
+	msgb_tlv_put(msg, RSL_IE_CHAN_MODE, sizeof(chan_mode), chan_mode);
+	msgb_tlv_put(msg, RSL_IE_ENCR_INFO, sizeof(encr_info), encr_info);
+	msgb_tv_put(msg, RSL_IE_BS_POWER, 0x00);
+	msgb_tv_put(msg, RSL_IE_MS_POWER, 0x05);
+	msgb_tv_put(msg, RSL_IE_TIMING_ADVANCE, 0x02);
+	msgb_tlv_put(msg, RSL_IE_MS_POWER_PARAM, sizeof(ms_power_param), ms_power_param);
+	msgb_tlv_put(msg, RSL_IE_MR_CONFIG, sizeof(mr_config), mr_config);
+	msgb_tlv_put(msg, RSL_IE_OSMO_REP_ACCH_CAP, sizeof(rep_acch_cap), rep_acch_cap);
+	msgb_tlv_put(msg, RSL_IE_OSMO_TRAINING_SEQUENCE, sizeof(tsc), tsc);
+}
+
+/* paging by TMSI */
+static void put_paging_cmd(struct msgb *msg)
+{
+	static const uint8_t tmsi[] = { 0xf4, 0x12, 0x34, 0x56, 0x78 };
+
+	msgb_tv_put(msg, RSL_IE_PAGING_GROUP, 3);
+	msgb_tlv_put(msg, RSL_IE_MS_IDENTITY, sizeof(tmsi), tmsi);
+	msgb_tv_put(msg, RSL_IE_CHAN_NEEDED, 0x00);
+}
+
+/* both parsers shall find the same values for the IEs of the set */
+static void check_ies(const struct msgb *msg, struct rsl_ie_set *set)
+{
+	struct tlv_parsed full, sparse;
+	unsigned int i;
+
+	OSMO_ASSERT(rsl_tlv_parse(&full, msgb_data(msg), msgb_length(msg)) >= 0);
+	OSMO_ASSERT(rsl_tlv_parse_ies(&sparse, set, msgb_data(msg), msgb_length(msg)) > 0);
+	for (i = 0; i < set->num; i++) {
+		uint8_t ie = set->ies[i];
+
+		OSMO_ASSERT(full.lv[ie].val == sparse.lv[ie].val);
+		OSMO_ASSERT(full.lv[ie].len == sparse.lv[ie].len);
+	}
+}
+
+static void bench_run(const char *name, const struct msgb *msg, struct rsl_ie_set *set)
+{
+	struct timespec t0, t1, t2;
+	struct tlv_parsed tp;
+	unsigned int i;
+	double full_ns, sparse_ns;
+
+	check_ies(msg, set);
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < cfg.num_msgs; i++) {
+		OSMO_ASSERT(rsl_tlv_parse(&tp, msgb_data(msg), msgb_length(msg)) >= 0);
+		/* keep the compiler from hoisting the parsing out of the loop */
+		__asm__ __volatile__("" : : "g"(&tp) : "memory");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (i = 0; i < cfg.num_msgs; i++) {
+		OSMO_ASSERT(rsl_tlv_parse_ies(&tp, set, msgb_data(msg), msgb_length(msg)) >= 0);
+		__asm__ __volatile__("" : : "g"(&tp) : "memory");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	full_ns = (double)(timespec_ns(&t1) - timespec_ns(&t0)) / cfg.num_msgs;
+	sparse_ns = (double)(timespec_ns(&t2) - timespec_ns(&t1)) / cfg.num_msgs;
+
+	printf("%s (%u bytes, %u IEs in the set):\n", name, msgb_length(msg), set->num);
+	printf("  rsl_tlv_parse:     %7.1f ns/msg\n", full_ns);
+	printf("  rsl_tlv_parse_ies: %7.1f ns/msg (%.1fx)\n", sparse_ns, full_ns / sparse_ns);
+}
+
+static void print_help(const char *argv0)
+{
+	printf("Usage: %s [-n NUM_MSGS]\n"
+	       "  -n NUM_MSGS  number of messages parsed per measurement (default %u)\n",
+	       argv0, cfg.num_msgs);
+}
+
+int main(int argc, char **argv)
+{
+	struct msgb *msg;
+	void *ctx;
+	int c;
+
+	while ((c = getopt(argc, argv, "hn:")) != -1) {
+		switch (c) {
+		case 'n':
+			cfg.num_msgs = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.num_msgs < 1) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ctx = talloc_named_const(NULL, 1, "rsl_bench");
+	msgb_talloc_ctx_init(ctx, 0);
+
+	msg = msgb_alloc(256, "CHAN ACTIV");
+	OSMO_ASSERT(msg != NULL);
+	put_chan_activ(msg);
+	bench_run("CHAN ACTIV", msg, &rsl_ie_set_chan_activ);
+	msgb_free(msg);
+
+	msg = msgb_alloc(256, "PAGING CMD");
+	OSMO_ASSERT(msg != NULL);
+	put_paging_cmd(msg);
+	bench_run("PAGING CMD", msg, &rsl_ie_set_paging_cmd);
+	msgb_free(msg);
+
+	return EXIT_SUCCESS;
+}
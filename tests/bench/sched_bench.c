@@ -0,0 +1,527 @@
+/* Throughput benchmark for the osmo-bts-trx scheduler.
+ *
+ * Drives the scheduler (TDMA frame clock, Downlink RTS/burst generation and
+ * Uplink burst handling) for a configurable channel mix against a stub PHY,
+ * as fast as possible, and reports per-frame processing time percentiles. */
+
+/*
+ * (C) 2023 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/gsm0502.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/amr.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/lchan.h>
+#include <osmo-bts/l1sap.h>
+#include <osmo-bts/phy_link.h>
+#include <osmo-bts/rate_ctr_shard.h>
+#include <osmo-bts/scheduler.h>
+
+#include "l1_if.h"
+#include "trx_if.h"
+
+enum bench_ts_type {
+	BENCH_TS_TCHF,		/* TCH/F with AMR */
+	BENCH_TS_TCHH,		/* 2 x TCH/H with AMR */
+	BENCH_TS_SDCCH8,	/* SDCCH/8 (all 8 sub-channels active) */
+	BENCH_TS_PDCH,		/* PDCH with 8PSK (EGPRS) Uplink bursts */
+};
+
+static const struct value_string bench_ts_type_names[] = {
+	{ BENCH_TS_TCHF,	"tchf" },
+	{ BENCH_TS_TCHH,	"tchh" },
+	{ BENCH_TS_SDCCH8,	"sdcch8" },
+	{ BENCH_TS_PDCH,	"pdch" },
+	{ 0, NULL }
+};
+
+static struct {
+	unsigned int num_trx;
+	unsigned int num_frames;
+	enum bench_ts_type mix[TRX_NR_TS - 1];
+	unsigned int mix_len;
+} cfg = {
+	.num_trx = 1,
+	.num_frames = 51 * 26 * 8,
+	.mix = { BENCH_TS_TCHF, BENCH_TS_TCHH, BENCH_TS_SDCCH8, BENCH_TS_PDCH },
+	.mix_len = 4,
+};
+
+/* What the stub PHY has "transmitted" */
+static struct {
+	unsigned long pdus;
+	unsigned long bytes;
+} phy_tx;
+
+/* Uplink burst soft-bits (noise), large enough for 8PSK */
+static sbit_t ul_noise[EGPRS_BURST_LEN];
+
+/*
+ * Stub PHY: replaces trx_if.c and l1_if.c towards the transceiver
+ */
+
+int trx_if_powered(struct trx_l1h *l1h)
+{
+	return 1;
+}
+
+int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br)
+{
+	if (br == NULL) /* batching breaker */
+		return 0;
+	phy_tx.pdus++;
+	phy_tx.bytes += br->burst_len;
+	return 0;
+}
+
+int trx_if_cmd_handover(struct trx_l1h *l1h, uint8_t tn, uint8_t ss)
+{
+	return 0;
+}
+
+int trx_if_cmd_nohandover(struct trx_l1h *l1h, uint8_t tn, uint8_t ss)
+{
+	return 0;
+}
+
+int l1if_mph_time_ind(struct gsm_bts *bts, uint32_t fn)
+{
+	struct osmo_phsap_prim l1sap;
+
+	memset(&l1sap, 0, sizeof(l1sap));
+	osmo_prim_init(&l1sap.oph, SAP_GSM_PH, PRIM_MPH_INFO,
+		PRIM_OP_INDICATION, NULL);
+	l1sap.u.info.type = PRIM_INFO_TIME;
+	l1sap.u.info.u.time_ind.fn = fn;
+
+	return l1sap_up(bts->c0, &l1sap);
+}
+
+/*
+ * BTS model: a minimal subset of osmo-bts-trx/{main,l1_if}.c
+ */
+
+static struct rate_ctr_desc bench_ctr_desc[BTSTRX_CTR_SLACK_TASK_LATE + 1];
+static const struct rate_ctr_group_desc bench_ctrg_desc = {
+	"bts-trx", "sched_bench counters", OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(bench_ctr_desc), bench_ctr_desc
+};
+
+static struct osmo_stat_item_desc bench_stat_desc[BTSTRX_STAT_FN_BUDGET_LEVEL + 1];
+static const struct osmo_stat_item_group_desc bench_statg_desc = {
+	"bts-trx", "sched_bench statistics", OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(bench_stat_desc), bench_stat_desc
+};
+
+int bts_model_init(struct gsm_bts *bts)
+{
+	struct bts_trx_priv *bts_trx = talloc_zero(bts, struct bts_trx_priv);
+	unsigned int i;
+
+	/* only the count matters here, the names must be valid identifiers */
+	for (i = 0; i < ARRAY_SIZE(bench_ctr_desc); i++)
+		bench_ctr_desc[i].name = talloc_asprintf(bts_trx, "ctr%u", i);
+	for (i = 0; i < ARRAY_SIZE(bench_stat_desc); i++) {
+		bench_stat_desc[i].name = talloc_asprintf(bts_trx, "stat%u", i);
+		bench_stat_desc[i].num_values = 16;
+	}
+
+	bts_trx->clk_s.fn_timer_ofd.fd = -1;
+	fn_budget_init(&bts_trx->fn_budget);
+	bts_trx->ctrs = rate_ctr_group_alloc(bts_trx, &bench_ctrg_desc, 0);
+	OSMO_ASSERT(bts_trx->ctrs != NULL);
+	bts_trx->ctrs_shard = rate_ctr_shard_group_alloc(bts_trx, bts_trx->ctrs);
+	OSMO_ASSERT(bts_trx->ctrs_shard != NULL);
+	bts_trx->stats = osmo_stat_item_group_alloc(bts_trx, &bench_statg_desc, 0);
+	OSMO_ASSERT(bts_trx->stats != NULL);
+
+	bts->model_priv = bts_trx;
+	bts->variant = BTS_OSMO_TRX;
+
+	return 0;
+}
+
+int bts_model_l1sap_down(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
+{
+	struct msgb *msg = l1sap->oph.msg;
+
+	switch (OSMO_PRIM_HDR(&l1sap->oph)) {
+	case OSMO_PRIM(PRIM_PH_DATA, PRIM_OP_REQUEST):
+		if (msg)
+			return trx_sched_ph_data_req(trx, l1sap);
+		break;
+	case OSMO_PRIM(PRIM_TCH, PRIM_OP_REQUEST):
+		if (msg)
+			return trx_sched_tch_req(trx, l1sap);
+		break;
+	default:
+		break;
+	}
+
+	if (msg)
+		msgb_free(msg);
+	return 0;
+}
+
+void bts_model_phy_link_set_defaults(struct phy_link *plink)
+{
+	plink->u.osmotrx.clock_advance = 2;
+	plink->u.osmotrx.rts_advance = 3;
+}
+
+void bts_model_phy_instance_set_defaults(struct phy_instance *pinst)
+{
+	pinst->u.osmotrx.hdl = talloc_zero(pinst, struct trx_l1h);
+	pinst->u.osmotrx.hdl->phy_inst = pinst;
+}
+
+int bts_model_trx_init(struct gsm_bts_trx *trx) { return 0; }
+int bts_model_chg_adm_state(struct gsm_bts *bts, struct gsm_abis_mo *mo,
+			    void *obj, uint8_t adm_state) { return 0; }
+int bts_model_apply_oml(struct gsm_bts *bts, const struct msgb *msg,
+			struct gsm_abis_mo *mo, void *obj) { return 0; }
+int bts_model_trx_deact_rf(struct gsm_bts_trx *trx) { return 0; }
+void bts_model_trx_close(struct gsm_bts_trx *trx) { bts_model_trx_close_cb(trx, 0); }
+int bts_model_check_oml(struct gsm_bts *bts, uint8_t msg_type,
+			struct tlv_parsed *old_attr, struct tlv_parsed *new_attr,
+			void *obj) { return 0; }
+int bts_model_opstart(struct gsm_bts *bts, struct gsm_abis_mo *mo,
+		      void *obj) { return 0; }
+uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx) { return 0; }
+int bts_model_oml_estab(struct gsm_bts *bts) { return 0; }
+int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm) { return 0; }
+int bts_model_lchan_deactivate(struct gsm_lchan *lchan) { return 0; }
+int bts_model_lchan_deactivate_sacch(struct gsm_lchan *lchan) { return 0; }
+int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan) { return 0; }
+void bts_model_abis_close(struct gsm_bts *bts) { }
+int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts) { return 0; }
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask) { return -ENOTSUP; }
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2) { return -ENOTSUP; }
+void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
+			  enum gsm_phys_chan_config as_pchan) { }
+int bts_model_phy_link_open(struct phy_link *plink) { return 0; }
+
+/*
+ * Channel setup
+ */
+
+static void bench_lchan_act(struct gsm_lchan *lchan, enum gsm_chan_t type,
+			    uint8_t rsl_cmode, uint8_t tch_mode)
+{
+	uint8_t chan_nr;
+
+	lchan->type = type;
+	lchan->rsl_cmode = rsl_cmode;
+	lchan->tch_mode = tch_mode;
+	chan_nr = gsm_lchan2chan_nr(lchan);
+
+	trx_sched_set_lchan(lchan, chan_nr, LID_DEDIC, true);
+	if (type != GSM_LCHAN_PDTCH)
+		trx_sched_set_lchan(lchan, chan_nr, LID_SACCH, true);
+
+	if (tch_mode == GSM48_CMODE_SPEECH_AMR) {
+		/* AMR with a single codec mode: 12.2 kbit/s */
+		lchan->tch.amr_mr.num_modes = 1;
+		lchan->tch.amr_mr.mode[0].mode = 7;
+		amr_mr_conf_update(&lchan->tch.amr_mr);
+		trx_sched_set_mode(lchan->ts, chan_nr, rsl_cmode, tch_mode,
+				   1, 7, 0, 0, 0, 0, 0);
+	} else if (type != GSM_LCHAN_PDTCH) {
+		trx_sched_set_mode(lchan->ts, chan_nr, rsl_cmode, tch_mode,
+				   0, 0, 0, 0, 0, 0, 0);
+	}
+
+	lchan_set_state(lchan, LCHAN_S_ACTIVE);
+}
+
+static void bench_ts_setup(struct gsm_bts_trx_ts *ts, enum bench_ts_type type)
+{
+	unsigned int i;
+
+	switch (type) {
+	case BENCH_TS_TCHF:
+		ts->pchan = GSM_PCHAN_TCH_F;
+		trx_sched_set_pchan(ts, ts->pchan);
+		bench_lchan_act(&ts->lchan[0], GSM_LCHAN_TCH_F,
+				RSL_CMOD_SPD_SPEECH, GSM48_CMODE_SPEECH_AMR);
+		break;
+	case BENCH_TS_TCHH:
+		ts->pchan = GSM_PCHAN_TCH_H;
+		trx_sched_set_pchan(ts, ts->pchan);
+		for (i = 0; i < 2; i++)
+			bench_lchan_act(&ts->lchan[i], GSM_LCHAN_TCH_H,
+					RSL_CMOD_SPD_SPEECH, GSM48_CMODE_SPEECH_AMR);
+		break;
+	case BENCH_TS_SDCCH8:
+		ts->pchan = GSM_PCHAN_SDCCH8_SACCH8C;
+		trx_sched_set_pchan(ts, ts->pchan);
+		for (i = 0; i < 8; i++)
+			bench_lchan_act(&ts->lchan[i], GSM_LCHAN_SDCCH,
+					RSL_CMOD_SPD_SIGN, GSM48_CMODE_SIGN);
+		break;
+	case BENCH_TS_PDCH:
+		ts->pchan = GSM_PCHAN_PDCH;
+		trx_sched_set_pchan(ts, ts->pchan);
+		bench_lchan_act(&ts->lchan[0], GSM_LCHAN_PDTCH,
+				RSL_CMOD_SPD_SIGN, GSM48_CMODE_SIGN);
+		break;
+	}
+}
+
+static struct gsm_bts *bench_bts_setup(void *ctx)
+{
+	struct gsm_bts *bts;
+	struct phy_link *plink;
+	unsigned int i, tn;
+
+	g_bts_sm = gsm_bts_sm_alloc(ctx);
+	OSMO_ASSERT(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	OSMO_ASSERT(bts != NULL);
+	OSMO_ASSERT(bts_init(bts) == 0);
+
+	for (i = 1; i < cfg.num_trx; i++)
+		OSMO_ASSERT(gsm_bts_trx_alloc(bts) != NULL);
+
+	plink = phy_link_create(ctx, 0);
+	OSMO_ASSERT(plink != NULL);
+
+	for (i = 0; i < cfg.num_trx; i++) {
+		struct gsm_bts_trx *trx = gsm_bts_trx_num(bts, i);
+		struct phy_instance *pinst = phy_instance_create(plink, i);
+
+		OSMO_ASSERT(pinst != NULL);
+		phy_instance_link_to_trx(pinst, trx);
+		trx_sched_init(trx);
+
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			trx->ts[tn].tsc = trx->ts[tn].vamos.peer->tsc = 7;
+			trx->ts[tn].tsc_set = trx->ts[tn].vamos.peer->tsc_set = 0;
+		}
+
+		/* C0/TS0 always carries BCCH/CCCH */
+		for (tn = (i == 0) ? 1 : 0; tn < ARRAY_SIZE(trx->ts); tn++)
+			bench_ts_setup(&trx->ts[tn], cfg.mix[tn % cfg.mix_len]);
+	}
+
+	bts->c0->ts[0].pchan = GSM_PCHAN_CCCH;
+	trx_sched_set_pchan(&bts->c0->ts[0], GSM_PCHAN_CCCH);
+	trx_sched_set_bcch_ccch(&bts->c0->ts[0].lchan[CCCH_LCHAN], true);
+	bts->c0->ts[0].lchan[CCCH_LCHAN].rel_act_kind = LCHAN_REL_ACT_OML;
+	lchan_set_state(&bts->c0->ts[0].lchan[CCCH_LCHAN], LCHAN_S_ACTIVE);
+
+	return bts;
+}
+
+/*
+ * Benchmark
+ */
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	const uint64_t *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+static void print_percentiles(const char *name, uint64_t *samples, unsigned int num)
+{
+	static const double pct[] = { 50.0, 90.0, 99.0, 99.9 };
+	uint64_t sum = 0;
+	unsigned int i;
+
+	qsort(samples, num, sizeof(*samples), &cmp_u64);
+	for (i = 0; i < num; i++)
+		sum += samples[i];
+
+	printf("%-8s avg %8" PRIu64 " ns", name, sum / num);
+	for (i = 0; i < ARRAY_SIZE(pct); i++)
+		printf(", p%.1f %8" PRIu64, pct[i], samples[(unsigned int)((num - 1) * pct[i] / 100.0)]);
+	printf(", max %8" PRIu64 " ns/frame\n", samples[num - 1]);
+}
+
+/* Feed one Uplink burst for every timeslot of every TRX */
+static void bench_ul_frame(struct gsm_bts *bts, uint32_t fn)
+{
+	struct gsm_bts_trx *trx;
+	unsigned int tn;
+
+	llist_for_each_entry(trx, &bts->trx_list, list) {
+		for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+			const bool is_8psk = trx->ts[tn].pchan == GSM_PCHAN_PDCH;
+			struct trx_ul_burst_ind bi = {
+				.flags = TRX_BI_F_MOD_TYPE | TRX_BI_F_CI_CB,
+				.fn = fn,
+				.tn = tn,
+				.toa256 = 0,
+				.rssi = -60,
+				.ci_cb = 200,
+				.mod = is_8psk ? TRX_MOD_T_8PSK : TRX_MOD_T_GMSK,
+				.burst = &ul_noise[0],
+				.burst_len = is_8psk ? EGPRS_BURST_LEN : GSM_BURST_LEN,
+			};
+
+			trx_sched_route_burst_ind(trx, &bi);
+		}
+	}
+}
+
+static void bench_run(struct gsm_bts *bts)
+{
+	uint64_t *dl_ns, *ul_ns, total_ns = 0;
+	struct timespec t0, t1, t2;
+	unsigned int i;
+	uint32_t fn = 0;
+
+	dl_ns = talloc_array(bts, uint64_t, cfg.num_frames);
+	ul_ns = talloc_array(bts, uint64_t, cfg.num_frames);
+	OSMO_ASSERT(dl_ns != NULL && ul_ns != NULL);
+
+	for (i = 0; i < cfg.num_frames; i++) {
+		fn = GSM_TDMA_FN_INC(fn);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		/* pretend a clock indication for every frame, so that
+		 * the scheduler processes exactly one TDMA frame */
+		trx_sched_clock(bts, fn);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		bench_ul_frame(bts, fn);
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+
+		dl_ns[i] = timespec_ns(&t1) - timespec_ns(&t0);
+		ul_ns[i] = timespec_ns(&t2) - timespec_ns(&t1);
+		total_ns += timespec_ns(&t2) - timespec_ns(&t0);
+	}
+
+	printf("%u TRX x %u TS, %u frames, %lu DL PDUs (%lu bytes)\n",
+	       cfg.num_trx, TRX_NR_TS, cfg.num_frames, phy_tx.pdus, phy_tx.bytes);
+	print_percentiles("Downlink", dl_ns, cfg.num_frames);
+	print_percentiles("Uplink", ul_ns, cfg.num_frames);
+	printf("Real-time factor: %.2fx (%.1f us per %d us TDMA frame)\n",
+	       (double)cfg.num_frames * GSM_TDMA_FN_DURATION_nS / total_ns,
+	       (double)total_ns / cfg.num_frames / 1000.0, GSM_TDMA_FN_DURATION_uS);
+
+	talloc_free(dl_ns);
+	talloc_free(ul_ns);
+}
+
+static void print_help(const char *argv0)
+{
+	printf("Usage: %s [-t NUM_TRX] [-n NUM_FRAMES] [-m MIX]\n"
+	       "  -t NUM_TRX     number of TRX to schedule (default %u)\n"
+	       "  -n NUM_FRAMES  number of TDMA frames to run (default %u)\n"
+	       "  -m MIX         comma separated list of timeslot types, assigned\n"
+	       "                 round-robin to the timeslots of each TRX (except\n"
+	       "                 C0/TS0, which is always BCCH/CCCH); types are:\n"
+	       "                 tchf, tchh, sdcch8, pdch (default tchf,tchh,sdcch8,pdch)\n",
+	       argv0, cfg.num_trx, cfg.num_frames);
+}
+
+static int parse_mix(char *arg)
+{
+	char *tok, *save = NULL;
+
+	cfg.mix_len = 0;
+	for (tok = strtok_r(arg, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		int type = get_string_value(bench_ts_type_names, tok);
+		if (type < 0 || cfg.mix_len >= ARRAY_SIZE(cfg.mix)) {
+			fprintf(stderr, "Invalid timeslot mix '%s'\n", tok);
+			return -1;
+		}
+		cfg.mix[cfg.mix_len++] = type;
+	}
+
+	return cfg.mix_len > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_bts *bts;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, "ht:n:m:")) != -1) {
+		switch (c) {
+		case 't':
+			cfg.num_trx = atoi(optarg);
+			break;
+		case 'n':
+			cfg.num_frames = atoi(optarg);
+			break;
+		case 'm':
+			if (parse_mix(optarg) != 0)
+				return EXIT_FAILURE;
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.num_trx < 1 || cfg.num_trx > 255 || cfg.num_frames < 1) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	for (i = 0; i < bts_log_info.num_cat; i++)
+		osmo_stderr_target->categories[i].loglevel = LOGL_FATAL;
+
+	/* Uplink noise, decoding will mostly fail which is the worst case */
+	srand(0x1337);
+	for (i = 0; i < ARRAY_SIZE(ul_noise); i++)
+		ul_noise[i] = (rand() % 255) - 127;
+
+	bts = bench_bts_setup(tall_bts_ctx);
+	bench_run(bts);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,479 @@
+/* Capacity benchmark for osmo-bts-virtual as a load-generation target.
+ *
+ * Drives the osmo-bts-virtual scheduler for a configurable number of TRX
+ * with all dedicated channels active (speech frames on every TCH block),
+ * as fast as possible, and sends the resulting GSMTAP messages to a real
+ * virtual Um multicast socket.  Reports per-frame processing time
+ * percentiles and the number of concurrent virtual channels one core
+ * sustains in real time. */
+
+/*
+ * (C) 2024 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/amr.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/lchan.h>
+#include <osmo-bts/l1sap.h>
+#include <osmo-bts/phy_link.h>
+#include <osmo-bts/scheduler.h>
+
+#include "l1_if.h"
+#include "virtual_um.h"
+
+enum bench_ts_type {
+	BENCH_TS_TCHF,		/* TCH/F with AMR */
+	BENCH_TS_TCHH,		/* 2 x TCH/H with AMR */
+	BENCH_TS_SDCCH8,	/* SDCCH/8 (all 8 sub-channels active) */
+};
+
+static const struct value_string bench_ts_type_names[] = {
+	{ BENCH_TS_TCHF,	"tchf" },
+	{ BENCH_TS_TCHH,	"tchh" },
+	{ BENCH_TS_SDCCH8,	"sdcch8" },
+	{ 0, NULL }
+};
+
+static struct {
+	unsigned int num_trx;
+	unsigned int num_frames;
+	unsigned int tx_batch;
+	const char *mcast_dev;
+	enum bench_ts_type mix[TRX_NR_TS - 1];
+	unsigned int mix_len;
+} cfg = {
+	.num_trx = 4,
+	.num_frames = 51 * 26 * 4,
+	.tx_batch = VIRT_UM_TX_BATCH,
+	.mcast_dev = NULL,
+	.mix = { BENCH_TS_TCHF, BENCH_TS_TCHH, BENCH_TS_SDCCH8 },
+	.mix_len = 3,
+};
+
+/* AMR 12.2 kbit/s speech frame, the content does not matter here */
+#define BENCH_AMR_FRAME_LEN 32
+
+/*
+ * Stub PHY: replaces the parts of osmo-bts-virtual/l1_if.c used by the scheduler
+ */
+
+int l1if_mph_time_ind(struct gsm_bts *bts, uint32_t fn)
+{
+	struct osmo_phsap_prim l1sap;
+
+	memset(&l1sap, 0, sizeof(l1sap));
+	osmo_prim_init(&l1sap.oph, SAP_GSM_PH, PRIM_MPH_INFO,
+		PRIM_OP_INDICATION, NULL);
+	l1sap.u.info.type = PRIM_INFO_TIME;
+	l1sap.u.info.u.time_ind.fn = fn;
+
+	return l1sap_up(bts->c0, &l1sap);
+}
+
+/*
+ * BTS model: a minimal subset of osmo-bts-virtual/{main,l1_if}.c
+ */
+
+static const struct rate_ctr_desc bench_ctr_desc[] = {
+	[BTSVIRT_CTR_SCHED_DL_MISS_FN]	= { "trx_clk:sched_dl_miss_fn", "" },
+	[BTSVIRT_CTR_UM_TX_MSGS]	= { "virt_um:tx_msgs", "" },
+	[BTSVIRT_CTR_UM_TX_ERRORS]	= { "virt_um:tx_errors", "" },
+	[BTSVIRT_CTR_UM_RX_IGNORED]	= { "virt_um:rx_ignored", "" },
+};
+static const struct rate_ctr_group_desc bench_ctrg_desc = {
+	"bts-virtual", "virt_bench counters", OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(bench_ctr_desc), bench_ctr_desc
+};
+
+static const struct osmo_stat_item_desc bench_stat_desc[] = {
+	[BTSVIRT_STAT_FN_TIMER_ERROR_US] = { "sched:fn_timer_error_us", "", "us", 16, 0 },
+};
+static const struct osmo_stat_item_group_desc bench_statg_desc = {
+	"bts-virtual", "virt_bench statistics", OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(bench_stat_desc), bench_stat_desc
+};
+
+int bts_model_init(struct gsm_bts *bts)
+{
+	struct bts_virt_priv *bts_virt = talloc_zero(bts, struct bts_virt_priv);
+	bts_virt->fn_timer_ofd.fd = -1;
+	bts_virt->ctrs = rate_ctr_group_alloc(bts_virt, &bench_ctrg_desc, 0);
+	bts_virt->stats = osmo_stat_item_group_alloc(bts_virt, &bench_statg_desc, 0);
+
+	bts->model_priv = bts_virt;
+	bts->variant = BTS_OSMO_VIRTUAL;
+
+	return 0;
+}
+
+int bts_model_l1sap_down(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
+{
+	struct msgb *msg = l1sap->oph.msg;
+
+	switch (OSMO_PRIM_HDR(&l1sap->oph)) {
+	case OSMO_PRIM(PRIM_PH_DATA, PRIM_OP_REQUEST):
+		if (msg)
+			return trx_sched_ph_data_req(trx, l1sap);
+		break;
+	case OSMO_PRIM(PRIM_TCH, PRIM_OP_REQUEST):
+		if (!msg) {
+			/* There is no RTP in here: answer each TCH RTS with
+			 * a speech frame, as during an ongoing call */
+			msg = l1sap_msgb_alloc(BENCH_AMR_FRAME_LEN);
+			OSMO_ASSERT(msg != NULL);
+			memcpy(msgb_l1sap_prim(msg), l1sap, sizeof(*l1sap));
+			msg->l2h = msgb_put(msg, BENCH_AMR_FRAME_LEN);
+			memset(msg->l2h, 0x00, BENCH_AMR_FRAME_LEN);
+			l1sap = msgb_l1sap_prim(msg);
+			l1sap->oph.msg = msg;
+		}
+		return trx_sched_tch_req(trx, l1sap);
+	default:
+		break;
+	}
+
+	if (msg)
+		msgb_free(msg);
+	return 0;
+}
+
+void bts_model_phy_link_set_defaults(struct phy_link *plink) { }
+void bts_model_phy_instance_set_defaults(struct phy_instance *pinst) { }
+int bts_model_trx_init(struct gsm_bts_trx *trx) { return 0; }
+int bts_model_chg_adm_state(struct gsm_bts *bts, struct gsm_abis_mo *mo,
+			    void *obj, uint8_t adm_state) { return 0; }
+int bts_model_apply_oml(struct gsm_bts *bts, const struct msgb *msg,
+			struct gsm_abis_mo *mo, void *obj) { return 0; }
+int bts_model_trx_deact_rf(struct gsm_bts_trx *trx) { return 0; }
+void bts_model_trx_close(struct gsm_bts_trx *trx) { bts_model_trx_close_cb(trx, 0); }
+int bts_model_check_oml(struct gsm_bts *bts, uint8_t msg_type,
+			struct tlv_parsed *old_attr, struct tlv_parsed *new_attr,
+			void *obj) { return 0; }
+int bts_model_opstart(struct gsm_bts *bts, struct gsm_abis_mo *mo,
+		      void *obj) { return 0; }
+uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx) { return 0; }
+int bts_model_oml_estab(struct gsm_bts *bts) { return 0; }
+int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm) { return 0; }
+int bts_model_lchan_deactivate(struct gsm_lchan *lchan) { return 0; }
+int bts_model_lchan_deactivate_sacch(struct gsm_lchan *lchan) { return 0; }
+int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan) { return 0; }
+void bts_model_abis_close(struct gsm_bts *bts) { }
+int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts) { return 0; }
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask) { return -ENOTSUP; }
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2) { return -ENOTSUP; }
+void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
+			  enum gsm_phys_chan_config as_pchan) { }
+int bts_model_phy_link_open(struct phy_link *plink) { return 0; }
+
+/* Nobody sends Uplink to the benchmark, but the socket is bidirectional */
+static void bench_virt_um_rx_cb(struct virt_um_inst *vui, struct msgb *msg)
+{
+	if (msg)
+		msgb_free(msg);
+}
+
+/*
+ * Channel setup
+ */
+
+static void bench_lchan_act(struct gsm_lchan *lchan, enum gsm_chan_t type,
+			    uint8_t rsl_cmode, uint8_t tch_mode)
+{
+	uint8_t chan_nr;
+
+	lchan->type = type;
+	lchan->rsl_cmode = rsl_cmode;
+	lchan->tch_mode = tch_mode;
+	chan_nr = gsm_lchan2chan_nr(lchan);
+
+	trx_sched_set_lchan(lchan, chan_nr, LID_DEDIC, true);
+	trx_sched_set_lchan(lchan, chan_nr, LID_SACCH, true);
+
+	if (tch_mode == GSM48_CMODE_SPEECH_AMR) {
+		/* AMR with a single codec mode: 12.2 kbit/s */
+		lchan->tch.amr_mr.num_modes = 1;
+		lchan->tch.amr_mr.mode[0].mode = 7;
+		amr_mr_conf_update(&lchan->tch.amr_mr);
+		trx_sched_set_mode(lchan->ts, chan_nr, rsl_cmode, tch_mode,
+				   1, 7, 0, 0, 0, 0, 0);
+	} else {
+		trx_sched_set_mode(lchan->ts, chan_nr, rsl_cmode, tch_mode,
+				   0, 0, 0, 0, 0, 0, 0);
+	}
+
+	lchan_set_state(lchan, LCHAN_S_ACTIVE);
+}
+
+/* Set up the timeslot, returns the number of activated channels */
+static unsigned int bench_ts_setup(struct gsm_bts_trx_ts *ts, enum bench_ts_type type)
+{
+	unsigned int i;
+
+	switch (type) {
+	case BENCH_TS_TCHF:
+		ts->pchan = GSM_PCHAN_TCH_F;
+		trx_sched_set_pchan(ts, ts->pchan);
+		bench_lchan_act(&ts->lchan[0], GSM_LCHAN_TCH_F,
+				RSL_CMOD_SPD_SPEECH, GSM48_CMODE_SPEECH_AMR);
+		return 1;
+	case BENCH_TS_TCHH:
+		ts->pchan = GSM_PCHAN_TCH_H;
+		trx_sched_set_pchan(ts, ts->pchan);
+		for (i = 0; i < 2; i++)
+			bench_lchan_act(&ts->lchan[i], GSM_LCHAN_TCH_H,
+					RSL_CMOD_SPD_SPEECH, GSM48_CMODE_SPEECH_AMR);
+		return 2;
+	case BENCH_TS_SDCCH8:
+		ts->pchan = GSM_PCHAN_SDCCH8_SACCH8C;
+		trx_sched_set_pchan(ts, ts->pchan);
+		for (i = 0; i < 8; i++)
+			bench_lchan_act(&ts->lchan[i], GSM_LCHAN_SDCCH,
+					RSL_CMOD_SPD_SIGN, GSM48_CMODE_SIGN);
+		return 8;
+	}
+
+	return 0;
+}
+
+static struct gsm_bts *bench_bts_setup(void *ctx, unsigned int *num_chans)
+{
+	struct gsm_bts *bts;
+	struct phy_link *plink;
+	unsigned int i, tn;
+
+	g_bts_sm = gsm_bts_sm_alloc(ctx);
+	OSMO_ASSERT(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	OSMO_ASSERT(bts != NULL);
+	OSMO_ASSERT(bts_init(bts) == 0);
+
+	for (i = 1; i < cfg.num_trx; i++)
+		OSMO_ASSERT(gsm_bts_trx_alloc(bts) != NULL);
+
+	/* All TRX share one PHY link and hence one virtual Um socket */
+	plink = phy_link_create(ctx, 0);
+	OSMO_ASSERT(plink != NULL);
+	plink->u.virt.virt_um = virt_um_init(plink, DEFAULT_MS_MCAST_GROUP, DEFAULT_MS_MCAST_PORT,
+					     DEFAULT_BTS_MCAST_GROUP, DEFAULT_BTS_MCAST_PORT,
+					     0, cfg.mcast_dev, bench_virt_um_rx_cb);
+	OSMO_ASSERT(plink->u.virt.virt_um != NULL);
+	plink->u.virt.virt_um->priv = plink;
+	plink->u.virt.virt_um->tx_batch = cfg.tx_batch;
+
+	*num_chans = 0;
+	for (i = 0; i < cfg.num_trx; i++) {
+		struct gsm_bts_trx *trx = gsm_bts_trx_num(bts, i);
+		struct phy_instance *pinst = phy_instance_create(plink, i);
+
+		OSMO_ASSERT(pinst != NULL);
+		phy_instance_link_to_trx(pinst, trx);
+		trx->arfcn = 100 + 2 * i;
+		trx_sched_init(trx);
+
+		/* C0/TS0 always carries BCCH/CCCH */
+		for (tn = (i == 0) ? 1 : 0; tn < ARRAY_SIZE(trx->ts); tn++)
+			*num_chans += bench_ts_setup(&trx->ts[tn], cfg.mix[tn % cfg.mix_len]);
+	}
+
+	bts->c0->ts[0].pchan = GSM_PCHAN_CCCH;
+	trx_sched_set_pchan(&bts->c0->ts[0], GSM_PCHAN_CCCH);
+	trx_sched_set_bcch_ccch(&bts->c0->ts[0].lchan[CCCH_LCHAN], true);
+	bts->c0->ts[0].lchan[CCCH_LCHAN].rel_act_kind = LCHAN_REL_ACT_OML;
+	lchan_set_state(&bts->c0->ts[0].lchan[CCCH_LCHAN], LCHAN_S_ACTIVE);
+
+	return bts;
+}
+
+/*
+ * Benchmark
+ */
+
+static uint64_t timespec_ns(const struct timespec *ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	const uint64_t *x = a, *y = b;
+	return (*x > *y) - (*x < *y);
+}
+
+static void print_percentiles(const char *name, uint64_t *samples, unsigned int num)
+{
+	static const double pct[] = { 50.0, 90.0, 99.0, 99.9 };
+	uint64_t sum = 0;
+	unsigned int i;
+
+	qsort(samples, num, sizeof(*samples), &cmp_u64);
+	for (i = 0; i < num; i++)
+		sum += samples[i];
+
+	printf("%-8s avg %8" PRIu64 " ns", name, sum / num);
+	for (i = 0; i < ARRAY_SIZE(pct); i++)
+		printf(", p%.1f %8" PRIu64, pct[i], samples[(unsigned int)((num - 1) * pct[i] / 100.0)]);
+	printf(", max %8" PRIu64 " ns/frame\n", samples[num - 1]);
+}
+
+static void bench_run(struct gsm_bts *bts, unsigned int num_chans)
+{
+	struct bts_virt_priv *bts_virt = bts->model_priv;
+	uint64_t *dl_ns, total_ns = 0;
+	struct timespec t0, t1;
+	double rt_factor;
+	unsigned int i;
+	uint32_t fn = 0;
+
+	dl_ns = talloc_array(bts, uint64_t, cfg.num_frames);
+	OSMO_ASSERT(dl_ns != NULL);
+
+	for (i = 0; i < cfg.num_frames; i++) {
+		fn = GSM_TDMA_FN_INC(fn);
+
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		/* what the FN timer does for every TDMA frame */
+		vbts_sched_fn(bts, fn);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+
+		dl_ns[i] = timespec_ns(&t1) - timespec_ns(&t0);
+		total_ns += dl_ns[i];
+	}
+
+	rt_factor = (double)cfg.num_frames * GSM_TDMA_FN_DURATION_nS / total_ns;
+
+	printf("%u TRX x %u TS, %u channels, %u frames, %" PRIu64 " GSMTAP msgs "
+	       "(%" PRIu64 " send errors), batches of up to %u\n",
+	       cfg.num_trx, TRX_NR_TS, num_chans, cfg.num_frames,
+	       rate_ctr_group_get_ctr(bts_virt->ctrs, BTSVIRT_CTR_UM_TX_MSGS)->current,
+	       rate_ctr_group_get_ctr(bts_virt->ctrs, BTSVIRT_CTR_UM_TX_ERRORS)->current,
+	       OSMO_MIN(cfg.tx_batch, VIRT_UM_TX_BATCH));
+	print_percentiles("Downlink", dl_ns, cfg.num_frames);
+	printf("Real-time factor: %.2fx (%.1f us per %d us TDMA frame)\n",
+	       rt_factor, (double)total_ns / cfg.num_frames / 1000.0, GSM_TDMA_FN_DURATION_uS);
+	/* assumes that the cost scales linearly with the number of channels */
+	printf("Capacity: ~%.0f concurrent virtual channels per core\n", num_chans * rt_factor);
+
+	talloc_free(dl_ns);
+}
+
+static void print_help(const char *argv0)
+{
+	printf("Usage: %s [-t NUM_TRX] [-n NUM_FRAMES] [-b BATCH] [-d NETDEV] [-m MIX]\n"
+	       "  -t NUM_TRX     number of TRX to schedule (default %u)\n"
+	       "  -n NUM_FRAMES  number of TDMA frames to run (default %u)\n"
+	       "  -b BATCH       max. GSMTAP messages per sendmmsg(), 1 to send\n"
+	       "                 each message on its own (default %u)\n"
+	       "  -d NETDEV      network device for the multicast (default: routing table)\n"
+	       "  -m MIX         comma separated list of timeslot types, assigned\n"
+	       "                 round-robin to the timeslots of each TRX (except\n"
+	       "                 C0/TS0, which is always BCCH/CCCH); types are:\n"
+	       "                 tchf, tchh, sdcch8 (default tchf,tchh,sdcch8)\n",
+	       argv0, cfg.num_trx, cfg.num_frames, cfg.tx_batch);
+}
+
+static int parse_mix(char *arg)
+{
+	char *tok, *save = NULL;
+
+	cfg.mix_len = 0;
+	for (tok = strtok_r(arg, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		int type = get_string_value(bench_ts_type_names, tok);
+		if (type < 0 || cfg.mix_len >= ARRAY_SIZE(cfg.mix)) {
+			fprintf(stderr, "Invalid timeslot mix '%s'\n", tok);
+			return -1;
+		}
+		cfg.mix[cfg.mix_len++] = type;
+	}
+
+	return cfg.mix_len > 0 ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, num_chans;
+	struct gsm_bts *bts;
+	int c;
+
+	while ((c = getopt(argc, argv, "ht:n:b:d:m:")) != -1) {
+		switch (c) {
+		case 't':
+			cfg.num_trx = atoi(optarg);
+			break;
+		case 'n':
+			cfg.num_frames = atoi(optarg);
+			break;
+		case 'b':
+			cfg.tx_batch = atoi(optarg);
+			break;
+		case 'd':
+			cfg.mcast_dev = optarg;
+			break;
+		case 'm':
+			if (parse_mix(optarg) != 0)
+				return EXIT_FAILURE;
+			break;
+		case 'h':
+		default:
+			print_help(argv[0]);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (cfg.num_trx < 1 || cfg.num_trx > 255 || cfg.num_frames < 1 ||
+	    cfg.tx_batch < 1 || cfg.tx_batch > VIRT_UM_TX_BATCH) {
+		print_help(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	for (i = 0; i < bts_log_info.num_cat; i++)
+		osmo_stderr_target->categories[i].loglevel = LOGL_FATAL;
+
+	bts = bench_bts_setup(tall_bts_ctx, &num_chans);
+	bench_run(bts, num_chans);
+
+	return EXIT_SUCCESS;
+}
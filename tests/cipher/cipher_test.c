@@ -23,10 +23,14 @@
 #include <osmo-bts/paging.h>
 #include <osmo-bts/gsm_data.h>
 
+#include <osmo-bts/a5_kasumi.h>
+
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/application.h>
+#include <osmocom/gsm/a5.h>
 
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
 static struct gsm_bts *bts;
@@ -65,6 +69,38 @@ static void test_cipher_parsing(void)
 	ASSERT_TRUE(bts_supports_cipher(bts, 0x9) == -ENOTSUP);
 }
 
+static void test_a5_kasumi(void)
+{
+	static const uint32_t fns[] = { 0, 1, 42, 1326, 2715647 };
+	ubit_t dl[114], ul[114], dl_ref[114], ul_ref[114];
+	struct a5_kasumi_key k;
+	uint8_t key[16];
+	unsigned int i, j;
+	int algo;
+
+	printf("Testing A5/3 and A5/4 with the pre-expanded key\n");
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = 0x11 * i + 0x2b;
+
+	for (algo = 3; algo <= 4; algo++) {
+		ASSERT_TRUE(a5_kasumi_key_expand(&k, algo, key) == 0);
+		for (j = 0; j < ARRAY_SIZE(fns); j++) {
+			osmo_a5(algo, key, fns[j], dl_ref, ul_ref);
+			a5_kasumi(&k, fns[j], dl, ul);
+			ASSERT_TRUE(memcmp(dl, dl_ref, sizeof(dl)) == 0);
+			ASSERT_TRUE(memcmp(ul, ul_ref, sizeof(ul)) == 0);
+
+			/* one direction only */
+			memset(ul, 0xff, sizeof(ul));
+			a5_kasumi(&k, fns[j], NULL, ul);
+			ASSERT_TRUE(memcmp(ul, ul_ref, sizeof(ul)) == 0);
+		}
+	}
+
+	ASSERT_TRUE(a5_kasumi_key_expand(&k, 1, key) == -ENOTSUP);
+}
+
 int main(int argc, char **argv)
 {
 	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
@@ -80,6 +116,7 @@ int main(int argc, char **argv)
 	}
 
 	test_cipher_parsing();
+	test_a5_kasumi();
 	printf("Success\n");
 
 	return 0;
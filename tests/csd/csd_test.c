@@ -20,10 +20,14 @@
  */
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm44021.h>
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 #include <osmocom/isdn/v110.h>
@@ -79,6 +83,147 @@ static const struct test_case tests[] = {
 	},
 };
 
+/* Reference implementation: RA1'/RA1 and RA2 on unpacked bits via libosmocore,
+ * which csd_v110_rtp_{en,de}code() must be equivalent to. */
+static const uint8_t ref_e1e2e3_map[_LCHAN_CSD_M_NUM][3] = {
+	[LCHAN_CSD_M_T_600]	= { 1, 0, 0 },
+	[LCHAN_CSD_M_T_1200]	= { 0, 1, 0 },
+	[LCHAN_CSD_M_T_2400]	= { 1, 1, 0 },
+	[LCHAN_CSD_M_T_4800]	= { 0, 1, 1 },
+	[LCHAN_CSD_M_T_9600]	= { 0, 1, 1 },
+};
+
+static void ref_rtp_encode(const struct gsm_lchan *lchan, const struct csd_v110_frame_desc *desc,
+			   uint8_t *rtp, const ubit_t *data)
+{
+	ubit_t ra_bits[80 * 4];
+
+	for (unsigned int i = 0; i < desc->num_blocks; i++) {
+		struct osmo_v110_decoded_frame df;
+
+		if (desc->num_bits == 60)
+			osmo_csd_12k_6k_decode_frame(&df, &data[i * 60], 60);
+		else
+			osmo_csd_3k6_decode_frame(&df, &data[i * 36], 36);
+
+		if (lchan->csd_mode == LCHAN_CSD_M_NT) {
+			df.e_bits[0] = 0;
+			df.e_bits[1] = (i >> 1) & 0x01;
+			df.e_bits[2] = (i >> 0) & 0x01;
+		} else {
+			memcpy(&df.e_bits[0], ref_e1e2e3_map[lchan->csd_mode], 3);
+		}
+
+		osmo_v110_encode_frame(&ra_bits[i * 80], 80, &df);
+	}
+
+	if (desc->num_blocks == 4) {
+		for (unsigned int i = 0, j = 0; i < RFC4040_RTP_PLEN; i++, j += 2)
+			rtp[i] = (0xff >> 2) | (ra_bits[j] << 7) | (ra_bits[j + 1] << 6);
+	} else {
+		for (unsigned int i = 0; i < RFC4040_RTP_PLEN; i++)
+			rtp[i] = (0xff >> 1) | (ra_bits[i] << 7);
+	}
+}
+
+static void ref_rtp_decode(const struct csd_v110_frame_desc *desc,
+			   ubit_t *data, const uint8_t *rtp)
+{
+	ubit_t ra_bits[80 * 4];
+
+	if (desc->num_blocks == 4) {
+		for (unsigned int i = 0, j = 0; i < RFC4040_RTP_PLEN; i++) {
+			ra_bits[j++] = (rtp[i] >> 7);
+			ra_bits[j++] = (rtp[i] >> 6) & 0x01;
+		}
+	} else {
+		for (unsigned int i = 0; i < RFC4040_RTP_PLEN; i++)
+			ra_bits[i] = (rtp[i] >> 7);
+	}
+
+	for (unsigned int i = 0; i < desc->num_blocks; i++) {
+		struct osmo_v110_decoded_frame df;
+
+		osmo_v110_decode_frame(&df, &ra_bits[i * 80], 80);
+		if (desc->num_bits == 60)
+			osmo_csd_12k_6k_encode_frame(&data[i * 60], 60, &df);
+		else
+			osmo_csd_3k6_encode_frame(&data[i * 36], 36, &df);
+	}
+}
+
+#define EQUIV_ROUNDS 256
+#define BENCH_ROUNDS 20000
+
+static double elapsed_us(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+/* compare against the reference on random input, print the speedup to stdout */
+static void exec_equiv_test(const struct test_case *tc, const struct csd_v110_frame_desc *desc,
+			    enum lchan_csd_mode csd_mode)
+{
+	const unsigned int bit_num = desc->num_bits * desc->num_blocks;
+	uint8_t rtp[RFC4040_RTP_PLEN], rtp_ref[RFC4040_RTP_PLEN];
+	ubit_t data[BBUF_MAX], data_ref[BBUF_MAX];
+	struct timespec start;
+	double t, t_ref;
+
+	struct gsm_lchan lchan = {
+		.type = tc->lchan_type,
+		.tch_mode = tc->tch_mode,
+		.csd_mode = csd_mode,
+	};
+
+	fprintf(stderr, "[i] Comparing '%s' (%s) against the reference\n", tc->name,
+		csd_mode == LCHAN_CSD_M_NT ? "NT" : "T");
+
+	srand(1234);
+	for (unsigned int r = 0; r < EQUIV_ROUNDS; r++) {
+		for (unsigned int i = 0; i < bit_num; i++)
+			data[i] = rand() & 0x01;
+		csd_v110_rtp_encode(&lchan, &rtp[0], &data[0], bit_num);
+		ref_rtp_encode(&lchan, desc, &rtp_ref[0], &data[0]);
+		if (memcmp(rtp, rtp_ref, sizeof(rtp)) != 0) {
+			fprintf(stderr, "[!] Encoding mismatch in round %u\n", r);
+			break;
+		}
+
+		/* any RTP payload, including broken alignment patterns */
+		for (unsigned int i = 0; i < sizeof(rtp); i++)
+			rtp[i] = rand() & 0xff;
+		csd_v110_rtp_decode(&lchan, &data[0], &rtp[0], sizeof(rtp));
+		ref_rtp_decode(desc, &data_ref[0], &rtp[0]);
+		if (memcmp(data, data_ref, bit_num) != 0) {
+			fprintf(stderr, "[!] Decoding mismatch in round %u\n", r);
+			break;
+		}
+	}
+
+	/* the timing varies from run to run, hence stdout (not compared) */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		csd_v110_rtp_encode(&lchan, &rtp[0], &data[0], bit_num);
+		csd_v110_rtp_decode(&lchan, &data[0], &rtp[0], sizeof(rtp));
+	}
+	t = elapsed_us(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned int r = 0; r < BENCH_ROUNDS; r++) {
+		ref_rtp_encode(&lchan, desc, &rtp[0], &data[0]);
+		ref_rtp_decode(desc, &data[0], &rtp[0]);
+	}
+	t_ref = elapsed_us(&start);
+
+	printf("%s (%s): %.3f us vs. %.3f us per frame (reference), speedup %.2fx\n",
+	       tc->name, csd_mode == LCHAN_CSD_M_NT ? "NT" : "T",
+	       t / BENCH_ROUNDS, t_ref / BENCH_ROUNDS, t > 0 ? t_ref / t : 0.0);
+}
+
 static void exec_test_case(const struct test_case *tc)
 {
 	const struct csd_v110_frame_desc *desc;
@@ -146,6 +291,9 @@ static void exec_test_case(const struct test_case *tc)
 	/* print the encoded RTP frame (16 bytes per row) */
 	for (unsigned int i = 0; i < sizeof(rtp) / 16; i++)
 		fprintf(stderr, "    %s\n", osmo_hexdump(&rtp[i * 16], 16));
+
+	exec_equiv_test(tc, desc, tc->csd_mode);
+	exec_equiv_test(tc, desc, LCHAN_CSD_M_NT);
 }
 
 int main(int argc, char **argv)
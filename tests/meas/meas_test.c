@@ -127,6 +127,69 @@ static void test_meas_compute(const struct meas_testcase *mtc)
 
 }
 
+/* Reference implementation of the TCH period end detection, as it was done
+ * before the lookup table: map the FN of the measurement indication to the
+ * FN of the SACCH message block (3GPP TS 05.02 Clause 7 Table 1 of 9) and
+ * compare it with the last SACCH block of the period (3GPP TS 45.008,
+ * section 8.4.1). */
+static bool ref_is_meas_complete_tch(enum gsm_phys_chan_config pchan,
+				     uint8_t tn, uint8_t ss, uint32_t fn)
+{
+	static const uint8_t tchf_fn104_by_ts[] = { 90, 103, 12, 25, 38, 51, 64, 77 };
+	static const uint8_t tchh0_fn104_by_ts[] = { 90, 90, 12, 12, 38, 38, 64, 64 };
+	static const uint8_t tchh1_fn104_by_ts[] = { 103, 103, 25, 25, 51, 51, 77, 77 };
+	uint8_t fn_mod;
+
+	switch (fn % 104) {
+	case 25: fn_mod = 103; break;
+	case 38: fn_mod = 12; break;
+	case 51: fn_mod = 25; break;
+	case 64: fn_mod = 38; break;
+	case 77: fn_mod = 51; break;
+	case 90: fn_mod = 64; break;
+	case 103: fn_mod = 77; break;
+	case 12: fn_mod = 90; break;
+	default:
+		return false;
+	}
+
+	if (pchan == GSM_PCHAN_TCH_F)
+		return tchf_fn104_by_ts[tn] == fn_mod;
+	if (ss == 0)
+		return tchh0_fn104_by_ts[tn] == fn_mod;
+	return tchh1_fn104_by_ts[tn] == fn_mod;
+}
+
+/* Cross-check the lookup table of is_meas_complete() against the reference */
+static void test_is_meas_complete_table(void)
+{
+	const enum gsm_phys_chan_config pchans[] = { GSM_PCHAN_TCH_F, GSM_PCHAN_TCH_H };
+	struct gsm_lchan *lchan;
+	unsigned int i, tn, ss;
+	uint32_t fn;
+
+	printf("\n\n");
+	printf("===========================================================\n");
+	printf("Testing is_meas_complete() against the reference implementation\n");
+
+	for (i = 0; i < ARRAY_SIZE(pchans); i++) {
+		for (tn = 0; tn < 8; tn++) {
+			for (ss = 0; ss < (pchans[i] == GSM_PCHAN_TCH_H ? 2 : 1); ss++) {
+				lchan = &trx->ts[tn].lchan[ss];
+				lchan->ts->pchan = pchans[i];
+				for (fn = 0; fn < 2 * 104; fn++) {
+					bool exp = ref_is_meas_complete_tch(pchans[i], tn, ss, fn);
+					if (!!is_meas_complete(lchan, fn) != exp) {
+						fprintf(stderr, "%s TS=%u SS=%u fn=%u: mismatch (expected %d)\n",
+							gsm_pchan_name(pchans[i]), tn, ss, fn, exp);
+						OSMO_ASSERT(false);
+					}
+				}
+			}
+		}
+	}
+}
+
 static void test_is_meas_complete_single(struct gsm_lchan *lchan,
 					 uint32_t fn_end, uint8_t intv_len)
 {
@@ -523,6 +586,7 @@ int main(int argc, char **argv)
 	printf("***************************************************\n");
 
 	test_is_meas_complete();
+	test_is_meas_complete_table();
 	test_lchan_meas_process_measurement(false, false);
 	test_lchan_meas_process_measurement(true, false);
 	test_lchan_meas_process_measurement(false, true);
@@ -24,12 +24,16 @@
 #include <osmo-bts/bts_sm.h>
 #include <osmo-bts/msg_utils.h>
 #include <osmo-bts/logging.h>
+#include <osmo-bts/rate_ctr_shard.h>
 
 #include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/gsm/protocol/ipaccess.h>
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
 
 void *ctx = NULL;
 
@@ -137,21 +141,25 @@ static void test_msg_utils_oml(void)
 
 static void test_sacch_get(void)
 {
-	struct gsm_lchan lchan;
+	struct gsm_lchan *lchan;
+	struct gsm_bts *bts;
 	int i, off;
 
 	printf("Testing lchan_sacch_get\n");
-	memset(&lchan, 0, sizeof(lchan));
+	g_bts_sm = gsm_bts_sm_alloc(ctx);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	lchan = &bts->c0->ts[0].lchan[0];
 
-	/* initialize the input. */
+	/* initialize the input, all SI overridden by the lchan */
 	for (i = 1; i < _MAX_SYSINFO_TYPE; ++i) {
-		lchan.si.valid |= (1 << i);
-		memset(GSM_LCHAN_SI(&lchan, i), i, GSM_MACBLOCK_LEN);
+		lchan->si.valid |= (1 << i);
+		lchan->si.overridden |= (1 << i);
+		memset(GSM_LCHAN_SI(lchan, i), i, GSM_MACBLOCK_LEN);
 	}
 
 	/* It will start with '1' */
 	for (i = 1, off = 0; i <= 32; ++i) {
-		uint8_t *data = lchan_sacch_get(&lchan);
+		uint8_t *data = lchan_sacch_get(lchan);
 		off = (off + 1) % _MAX_SYSINFO_TYPE;
 		if (off == 0)
 			off += 1;
@@ -159,6 +167,28 @@ static void test_sacch_get(void)
 		//printf("i=%d (%%=%d) -> data[0]=%d\n", i, off, data[0]);
 		OSMO_ASSERT(data[0] == off);
 	}
+
+	/* SI5 and SI6 from the BTS (SI1 is not sent on the SACCH), SI6 overridden */
+	lchan->si.valid = (1 << SYSINFO_TYPE_6);
+	lchan->si.overridden = (1 << SYSINFO_TYPE_6);
+	bts->si_valid = (1 << SYSINFO_TYPE_1) | (1 << SYSINFO_TYPE_5) | (1 << SYSINFO_TYPE_6);
+	memset(GSM_BTS_SI(bts, SYSINFO_TYPE_5), 0x55, GSM_MACBLOCK_LEN);
+	memset(GSM_BTS_SI(bts, SYSINFO_TYPE_6), 0xb6, GSM_MACBLOCK_LEN);
+	memset(GSM_LCHAN_SI(lchan, SYSINFO_TYPE_6), 0x66, GSM_MACBLOCK_LEN);
+	OSMO_ASSERT(lchan_sacch_si_valid(lchan) == ((1 << SYSINFO_TYPE_5) | (1 << SYSINFO_TYPE_6)));
+
+	for (i = 0; i < 4; i++) {
+		uint8_t *data = lchan_sacch_get(lchan);
+		OSMO_ASSERT(data[0] == 0x55 || data[0] == 0x66);
+		OSMO_ASSERT(data[0] != ((uint8_t *)lchan_sacch_get(lchan))[0]);
+	}
+
+	/* a disabled SI of the BTS is not sent anymore */
+	bts->si_valid &= ~(1 << SYSINFO_TYPE_5);
+	OSMO_ASSERT(((uint8_t *)lchan_sacch_get(lchan))[0] == 0x66);
+	OSMO_ASSERT(((uint8_t *)lchan_sacch_get(lchan))[0] == 0x66);
+
+	talloc_free(bts);
 }
 
 static void test_bts_supports_cm(void)
@@ -211,6 +241,157 @@ static void test_bts_supports_cm(void)
 	talloc_free(bts);
 }
 
+static struct msgb *jb_frame(uint32_t ts)
+{
+	struct msgb *msg = msgb_alloc(16, "jb_frame");
+
+	OSMO_ASSERT(msg != NULL);
+	rtpmsg_ts(msg) = ts;
+	return msg;
+}
+
+static void test_dl_tch_jb(void)
+{
+	struct gsm_lchan lchan;
+	struct msgb *msg;
+	unsigned int i;
+
+	printf("Testing the DL TCH jitter buffer\n");
+	memset(&lchan, 0, sizeof(lchan));
+	INIT_LLIST_HEAD(&lchan.dl_tch_queue);
+
+	lchan_dl_tch_jb_reset(&lchan, 60, false);
+	OSMO_ASSERT(lchan.dl_tch_jb.max_depth == 3);
+	OSMO_ASSERT(lchan_dl_tch_jb_target(&lchan) == 3);
+
+	/* Nothing is played out until 3 frames are buffered */
+	lchan_dl_tch_jb_enqueue(&lchan, jb_frame(160));
+	OSMO_ASSERT(lchan_dl_tch_jb_dequeue(&lchan) == NULL);
+	OSMO_ASSERT(lchan.dl_tch_jb.stats.underrun == 0);
+
+	/* Out of order and duplicate frames */
+	lchan_dl_tch_jb_enqueue(&lchan, jb_frame(480));
+	lchan_dl_tch_jb_enqueue(&lchan, jb_frame(320));
+	lchan_dl_tch_jb_enqueue(&lchan, jb_frame(320));
+	OSMO_ASSERT(lchan.dl_tch_jb.stats.reorder == 1);
+	OSMO_ASSERT(lchan.dl_tch_jb.stats.dup == 1);
+	OSMO_ASSERT(lchan.dl_tch_queue_len == 3);
+
+	/* Played out in timestamp order */
+	for (i = 1; i <= 3; i++) {
+		msg = lchan_dl_tch_jb_dequeue(&lchan);
+		OSMO_ASSERT(msg != NULL);
+		OSMO_ASSERT(rtpmsg_ts(msg) == i * 160);
+		msgb_free(msg);
+	}
+
+	/* The next frame is missing, and shows up after its playout time */
+	OSMO_ASSERT(lchan_dl_tch_jb_dequeue(&lchan) == NULL);
+	OSMO_ASSERT(lchan.dl_tch_jb.stats.underrun == 1);
+	lchan_dl_tch_jb_enqueue(&lchan, jb_frame(640));
+	OSMO_ASSERT(lchan.dl_tch_jb.stats.late == 1);
+	OSMO_ASSERT(lchan.dl_tch_queue_len == 0);
+
+	lchan_dl_tch_jb_enqueue(&lchan, jb_frame(800));
+	msg = lchan_dl_tch_jb_dequeue(&lchan);
+	OSMO_ASSERT(msg != NULL && rtpmsg_ts(msg) == 800);
+	msgb_free(msg);
+
+	/* Burst of frames which does not fit: the oldest one is dropped */
+	for (i = 0; i < 7; i++)
+		lchan_dl_tch_jb_enqueue(&lchan, jb_frame(960 + i * 160));
+	OSMO_ASSERT(lchan.dl_tch_jb.stats.early == 1);
+	OSMO_ASSERT(lchan.dl_tch_queue_len == 6);
+	msg = lchan_dl_tch_jb_dequeue(&lchan);
+	OSMO_ASSERT(msg != NULL && rtpmsg_ts(msg) == 1120);
+	msgb_free(msg);
+
+	/* Adaptive: frames arrive every 20 ms, so there is no jitter */
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
+	lchan_dl_tch_jb_reset(&lchan, 100, true);
+	OSMO_ASSERT(lchan.dl_tch_queue_len == 0);
+	for (i = 0; i < 4; i++) {
+		lchan_dl_tch_jb_enqueue(&lchan, jb_frame(i * 160));
+		osmo_clock_override_add(CLOCK_MONOTONIC, 0, 20 * 1000 * 1000);
+	}
+	OSMO_ASSERT(lchan.dl_tch_jb.jitter16 == 0);
+	OSMO_ASSERT(lchan_dl_tch_jb_target(&lchan) == 1);
+
+	/* Too many frames are buffered for the target depth: one is skipped */
+	msg = lchan_dl_tch_jb_dequeue(&lchan);
+	OSMO_ASSERT(msg != NULL && rtpmsg_ts(msg) == 160);
+	msgb_free(msg);
+	OSMO_ASSERT(lchan.dl_tch_queue_len == 2);
+
+	/* One frame arrives 60 ms late */
+	osmo_clock_override_add(CLOCK_MONOTONIC, 0, 60 * 1000 * 1000);
+	lchan_dl_tch_jb_enqueue(&lchan, jb_frame(640));
+	OSMO_ASSERT(lchan_dl_tch_jb_target(&lchan) > 1);
+	osmo_clock_override_enable(CLOCK_MONOTONIC, false);
+
+	lchan_dl_tch_jb_reset(&lchan, 0, false);
+	OSMO_ASSERT(lchan.dl_tch_queue_len == 0);
+}
+
+static const struct rate_ctr_desc shard_test_ctr_desc[] = {
+	{ "test:a", "Counter A" },
+	{ "test:b", "Counter B" },
+};
+static const struct rate_ctr_group_desc shard_test_ctrg_desc = {
+	"shard-test", "Sharded counter test", OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(shard_test_ctr_desc), shard_test_ctr_desc
+};
+
+static void *shard_test_thread(void *arg)
+{
+	struct rate_ctr_shard_group *sg = arg;
+	unsigned int i;
+
+	OSMO_ASSERT(rate_ctr_shard_thread_register() == 0);
+	OSMO_ASSERT(rate_ctr_shard_slot != 0);
+	for (i = 0; i < 1000; i++)
+		rate_ctr_shard_inc(sg, 1);
+	rate_ctr_shard_add(sg, 0, 5);
+
+	return NULL;
+}
+
+static void test_rate_ctr_shard(void)
+{
+	struct rate_ctr_group *ctrg;
+	struct rate_ctr_shard_group *sg;
+	pthread_t thread;
+
+	printf("Testing sharded rate counters\n");
+	ctrg = rate_ctr_group_alloc(ctx, &shard_test_ctrg_desc, 0);
+	OSMO_ASSERT(ctrg != NULL);
+	sg = rate_ctr_shard_group_alloc(ctx, ctrg);
+	OSMO_ASSERT(sg != NULL);
+	OSMO_ASSERT(((uintptr_t)sg->slots & 63) == 0);
+
+	/* Nothing reaches the group before the flush */
+	rate_ctr_shard_inc(sg, 0);
+	rate_ctr_shard_inc(sg, 0);
+	OSMO_ASSERT(pthread_create(&thread, NULL, shard_test_thread, sg) == 0);
+	OSMO_ASSERT(pthread_join(thread, NULL) == 0);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, 0)->current == 0);
+
+	/* The counts of all threads are added up */
+	rate_ctr_shard_flush(sg);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, 0)->current == 7);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, 1)->current == 1000);
+
+	/* Only what was counted since the last flush is added */
+	rate_ctr_shard_flush(sg);
+	rate_ctr_shard_inc(sg, 1);
+	rate_ctr_shard_flush(sg);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, 0)->current == 7);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, 1)->current == 1001);
+
+	talloc_free(sg);
+	rate_ctr_group_free(ctrg);
+}
+
 int main(int argc, char **argv)
 {
 	ctx = talloc_named_const(NULL, 0, "misc_test");
@@ -221,5 +402,7 @@ int main(int argc, char **argv)
 	test_msg_utils_ipa();
 	test_msg_utils_oml();
 	test_bts_supports_cm();
+	test_dl_tch_jb();
+	test_rate_ctr_shard();
 	return EXIT_SUCCESS;
 }
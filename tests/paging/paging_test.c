@@ -20,6 +20,7 @@
  */
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/application.h>
+#include <osmocom/core/timer.h>
 
 #include <osmo-bts/bts.h>
 #include <osmo-bts/bts_sm.h>
@@ -30,6 +31,8 @@
 #include <osmo-bts/notification.h>
 
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
 
 static struct gsm_bts *bts;
 
@@ -126,6 +129,177 @@ static void test_paging_sleep(void)
 	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 0);
 }
 
+static void test_paging_duplicate(void)
+{
+	static const uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x01, 0x02, 0x03, 0x04 };
+	static const uint8_t tmsi2_lv[] = { 0x05, 0xf4, 0x01, 0x02, 0x03, 0x05 };
+	int rc;
+	printf("Testing that duplicate pagings are detected.\n");
+
+	rc = paging_add_identity(bts->paging_state, 0, static_ilv, 0);
+	ASSERT_TRUE(rc == 0);
+	rc = paging_add_identity(bts->paging_state, 0, tmsi_lv, 0);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 2);
+
+	/* same identities again */
+	rc = paging_add_identity(bts->paging_state, 0, static_ilv, 0);
+	ASSERT_TRUE(rc == -EEXIST);
+	rc = paging_add_identity(bts->paging_state, 0, tmsi_lv, 0);
+	ASSERT_TRUE(rc == -EEXIST);
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 2);
+
+	/* different TMSI, and the same TMSI in another paging group */
+	rc = paging_add_identity(bts->paging_state, 0, tmsi2_lv, 0);
+	ASSERT_TRUE(rc == 0);
+	rc = paging_add_identity(bts->paging_state, 1, tmsi_lv, 0);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 4);
+
+	/* no longer known after flushing the queue */
+	paging_reset(bts->paging_state);
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 0);
+	rc = paging_add_identity(bts->paging_state, 0, tmsi_lv, 0);
+	ASSERT_TRUE(rc == 0);
+
+	paging_reset(bts->paging_state);
+}
+
+static void test_paging_empty_nln(void)
+{
+	uint8_t out_buf[GSM_MACBLOCK_LEN], out_buf_nln[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time = { .t3 = 6 };
+	int pos_nch = bts->asci.pos_nch;
+	int is_empty = -1;
+	printf("Testing that the empty paging message follows the NLN.\n");
+
+	bts->asci.pos_nch = -1;
+	paging_gen_msg(bts->paging_state, out_buf, &g_time, &is_empty);
+	ASSERT_TRUE(is_empty == 1);
+
+	bts->asci.pos_nch = 0;
+	bts->asci.nln = 2;
+	paging_gen_msg(bts->paging_state, out_buf_nln, &g_time, &is_empty);
+	ASSERT_TRUE(is_empty == 1);
+	ASSERT_TRUE(memcmp(out_buf, out_buf_nln, sizeof(out_buf)) != 0);
+
+	bts->asci.pos_nch = -1;
+	paging_gen_msg(bts->paging_state, out_buf_nln, &g_time, &is_empty);
+	ASSERT_TRUE(memcmp(out_buf, out_buf_nln, sizeof(out_buf)) == 0);
+
+	bts->asci.pos_nch = pos_nch;
+}
+
+static void test_paging_etws(void)
+{
+	uint8_t notif[56], out_buf[2][4][GSM_MACBLOCK_LEN];
+	struct gsm_time g_time = { .t3 = 6 };
+	int is_empty = -1;
+	unsigned int i, j;
+	printf("Testing that the ETWS pages are repeated and follow the notification.\n");
+
+	for (i = 0; i < sizeof(notif); i++)
+		notif[i] = i;
+	bts->etws.prim_notif = notif;
+	bts->etws.prim_notif_len = sizeof(notif);
+	bts->etws.page_size = 14;
+	bts->etws.num_pages = 4;
+	bts->etws.next_page = 0;
+	bts->etws.generation++;
+
+	/* the second cycle through the pages comes from the cache */
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < 4; j++) {
+			paging_gen_msg(bts->paging_state, out_buf[i][j], &g_time, &is_empty);
+			ASSERT_TRUE(is_empty == 0);
+		}
+	}
+	ASSERT_TRUE(memcmp(out_buf[0], out_buf[1], sizeof(out_buf[0])) == 0);
+	ASSERT_TRUE(memcmp(out_buf[0][0], out_buf[0][1], GSM_MACBLOCK_LEN) != 0);
+	ASSERT_TRUE(bts->etws.next_page == 0);
+
+	/* a new notification must not be sent from the cache */
+	notif[20] = 0xff;
+	bts->etws.generation++;
+	for (j = 0; j < 4; j++)
+		paging_gen_msg(bts->paging_state, out_buf[1][j], &g_time, &is_empty);
+	ASSERT_TRUE(memcmp(out_buf[0][0], out_buf[1][0], GSM_MACBLOCK_LEN) == 0);
+	ASSERT_TRUE(memcmp(out_buf[0][1], out_buf[1][1], GSM_MACBLOCK_LEN) != 0);
+
+	bts->etws.prim_notif = NULL;
+	bts->etws.prim_notif_len = 0;
+	bts->etws.num_pages = 0;
+	bts->etws.next_page = 0;
+	bts->etws.generation++;
+}
+
+static void test_paging_wheel(void)
+{
+	static const uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x01, 0x02, 0x03, 0x04 };
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time = { .t3 = 6 };
+	unsigned int lifetime;
+	int is_empty = -1;
+	int rc;
+	printf("Testing that sent paging messages expire in the background.\n");
+
+	lifetime = paging_get_lifetime(bts->paging_state);
+	paging_set_lifetime(bts->paging_state, 2);
+
+	/* sent once, then re-queued until it expires */
+	rc = paging_add_identity(bts->paging_state, 0, static_ilv, 0);
+	ASSERT_TRUE(rc == 0);
+	rc = paging_gen_msg(bts->paging_state, out_buf, &g_time, &is_empty);
+	ASSERT_TRUE(is_empty == 0);
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 1);
+
+	/* not sent yet, so it must not expire */
+	rc = paging_add_identity(bts->paging_state, 1, tmsi_lv, 0);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 2);
+
+	osmo_clock_override_add(CLOCK_MONOTONIC, 1, 0);
+	osmo_timers_prepare();
+	osmo_timers_update();
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 2);
+
+	osmo_clock_override_add(CLOCK_MONOTONIC, 2, 0);
+	osmo_timers_prepare();
+	osmo_timers_update();
+	ASSERT_TRUE(paging_queue_length(bts->paging_state) == 1);
+	ASSERT_TRUE(paging_group_queue_empty(bts->paging_state, 0));
+
+	paging_reset(bts->paging_state);
+	paging_set_lifetime(bts->paging_state, lifetime);
+}
+
+static void test_paging_queue_max(void)
+{
+	uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x01, 0x02, 0x03, 0x00 };
+	unsigned int queue_max, i, n;
+	int rc;
+	printf("Testing that the paging queue is limited.\n");
+
+	queue_max = paging_get_queue_max(bts->paging_state);
+	paging_set_queue_max(bts->paging_state, 4);
+
+	/* the records are returned to the pool and re-used */
+	for (n = 0; n < 3; n++) {
+		for (i = 0; i < 4; i++) {
+			tmsi_lv[5] = i;
+			rc = paging_add_identity(bts->paging_state, 0, tmsi_lv, 0);
+			ASSERT_TRUE(rc == 0);
+		}
+		tmsi_lv[5] = i;
+		rc = paging_add_identity(bts->paging_state, 0, tmsi_lv, 0);
+		ASSERT_TRUE(rc == -ENOSPC);
+		ASSERT_TRUE(paging_queue_length(bts->paging_state) == 4);
+		paging_reset(bts->paging_state);
+	}
+
+	paging_set_queue_max(bts->paging_state, queue_max);
+}
+
 /* Set up a dummy trx with a valid setting for bs_ag_blks_res in SI3 */
 static struct gsm_bts_trx *test_is_ccch_for_agch_setup(uint8_t bs_ag_blks_res)
 {
@@ -347,6 +521,7 @@ int main(int argc, char **argv)
 	msgb_talloc_ctx_init(tall_bts_ctx, 0);
 
 	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	osmo_clock_override_enable(CLOCK_MONOTONIC, true);
 
 	g_bts_sm = gsm_bts_sm_alloc(tall_bts_ctx);
 	if (!g_bts_sm) {
@@ -361,6 +536,11 @@ int main(int argc, char **argv)
 
 	test_paging_smoke();
 	test_paging_sleep();
+	test_paging_duplicate();
+	test_paging_empty_nln();
+	test_paging_etws();
+	test_paging_wheel();
+	test_paging_queue_max();
 	test_is_ccch_for_agch();
 	test_paging_rest_octets1();
 	test_paging_rest_octets2();
@@ -1,3 +1,5 @@
+#include <errno.h>
+
 #include <osmo-bts/bts.h>
 #include <osmo-bts/bts_model.h>
 
@@ -60,6 +62,12 @@ __attribute__((weak)) void bts_model_abis_close(struct gsm_bts *bts)
 int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts)
 { return 0; }
 
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask)
+{ return -ENOTSUP; }
+
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2)
+{ return -ENOTSUP; }
+
 void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
 			 enum gsm_phys_chan_config as_pchan)
 { return; }
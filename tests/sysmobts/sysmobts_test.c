@@ -17,6 +17,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <osmocom/codec/codec.h>
+
 #include <osmo-bts/bts.h>
 #include <osmo-bts/l1sap.h>
 #include <osmo-bts/power_control.h>
@@ -28,6 +30,8 @@
 #include <sysmocom/femtobts/gsml1prim.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static int direct_map[][3] = {
 	{ GSM_BAND_850,		GsmL1_FreqBand_850,	128	},
@@ -182,11 +186,69 @@ static void test_sysmobts_cipher(void)
 	 * this happens asynchronously on the other side of the l1sap queue */
 }
 
+/* The original bit by bit implementation of hr_jumble() */
+static void hr_jumble_ref(uint8_t *dst, const uint8_t *src)
+{
+	const int p_unvoiced[] =
+		{ 5, 11,  9,  8,  1,  2,  7,  7,  5,  7,  7,  5,  7,  7,  5,  7,  7,  5 };
+	const int p_voiced[] =
+		{ 5, 11,  9,  8,  1,  2,  8,  9,  5,  4,  9,  5,  4,  9,  5,  4,  9,  5 };
+
+	int base, i, j, l, si, di;
+	const int *p;
+
+	memset(dst, 0x00, GSM_HR_BYTES);
+
+	p = (src[4] & 0x30) ? p_voiced : p_unvoiced;
+
+	base = 0;
+	for (i = 0; i < 18; i++) {
+		l = p[i];
+		for (j = 0; j < l; j++) {
+			si = base + j;
+			di = base + l - j - 1;
+
+			if (src[si >> 3] & (1 << (7 - (si & 7))))
+				dst[di >> 3] |= (1 << (7 - (di & 7)));
+		}
+
+		base += l;
+	}
+}
+
+static void test_sysmobts_hr_jumble(void)
+{
+	uint8_t src[GSM_HR_BYTES], dst[GSM_HR_BYTES], ref[GSM_HR_BYTES], back[GSM_HR_BYTES];
+	unsigned int i, j, num_voiced = 0;
+
+	printf("Testing the HR jumbling\n");
+
+	srand(0x1337);
+	for (i = 0; i < 10000; i++) {
+		for (j = 0; j < GSM_HR_BYTES; j++)
+			src[j] = rand();
+		if (src[4] & 0x30)
+			num_voiced++;
+
+		hr_jumble(dst, src);
+		hr_jumble_ref(ref, src);
+		OSMO_ASSERT(memcmp(dst, ref, GSM_HR_BYTES) == 0);
+
+		/* jumbling twice gives the original payload */
+		hr_jumble(back, dst);
+		OSMO_ASSERT(memcmp(back, src, GSM_HR_BYTES) == 0);
+	}
+
+	OSMO_ASSERT(num_voiced > 0 && num_voiced < i);
+	printf("HR jumbling matches the reference\n");
+}
+
 int main(int argc, char **argv)
 {
 	printf("Testing sysmobts routines\n");
 	test_sysmobts_auto_band();
 	test_sysmobts_cipher();
+	test_sysmobts_hr_jumble();
 
 	return 0;
 }
@@ -25,12 +25,14 @@
 #include <osmocom/core/application.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
 #include <osmo-bts/ta_control.h>
 #include <osmo-bts/bts_trx.h>
 
 void lchan_ms_ta_ctrl_test(int16_t toa256_start, unsigned int steps)
 {
-	struct gsm_bts_trx trx = { };
+	static struct gsm_bts bts = { };
+	struct gsm_bts_trx trx = { .bts = &bts };
 	struct gsm_bts_trx_ts ts = { .trx = &trx };
 	struct gsm_lchan lchan = { .ts = &ts };
 	unsigned int i;
@@ -0,0 +1,172 @@
+/*
+ * (C) 2023 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/application.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/scheduler.h>
+
+static const char *mode_names[] = {
+	[SCHED_MEAS_AVG_M_S24N22] = "S24N22",
+	[SCHED_MEAS_AVG_M_S22N22] = "S22N22",
+	[SCHED_MEAS_AVG_M_S4N4] = "S4N4",
+	[SCHED_MEAS_AVG_M_S8N8] = "S8N8",
+	[SCHED_MEAS_AVG_M_S6N4] = "S6N4",
+	[SCHED_MEAS_AVG_M_S6N6] = "S6N6",
+	[SCHED_MEAS_AVG_M_S8N4] = "S8N4",
+	[SCHED_MEAS_AVG_M_S6N2] = "S6N2",
+	[SCHED_MEAS_AVG_M_S4N2] = "S4N2",
+};
+
+static const uint8_t mode_sets[][2] = {
+	[SCHED_MEAS_AVG_M_S24N22] = { 24, 22 },
+	[SCHED_MEAS_AVG_M_S22N22] = { 22, 22 },
+	[SCHED_MEAS_AVG_M_S4N4] = { 4, 4 },
+	[SCHED_MEAS_AVG_M_S8N8] = { 8, 8 },
+	[SCHED_MEAS_AVG_M_S6N4] = { 6, 4 },
+	[SCHED_MEAS_AVG_M_S6N6] = { 6, 6 },
+	[SCHED_MEAS_AVG_M_S8N4] = { 8, 4 },
+	[SCHED_MEAS_AVG_M_S6N2] = { 6, 2 },
+	[SCHED_MEAS_AVG_M_S4N2] = { 4, 2 },
+};
+
+/* Reference implementation: plain ring of samples, summed on every call */
+struct ref_hist {
+	struct l1sched_meas_set buf[24];
+	unsigned int current;
+};
+
+static void ref_push(struct ref_hist *h, const struct trx_ul_burst_ind *bi)
+{
+	h->buf[h->current] = (struct l1sched_meas_set) {
+		.fn = bi->fn,
+		.ci_cb = (bi->flags & TRX_BI_F_CI_CB) ? bi->ci_cb : 0,
+		.toa256 = bi->toa256,
+		.rssi = bi->rssi,
+	};
+
+	h->current = (h->current + 1) % ARRAY_SIZE(h->buf);
+}
+
+static void ref_avg(const struct ref_hist *h, struct l1sched_meas_set *avg,
+		    enum sched_meas_avg_mode mode)
+{
+	const unsigned int hist_size = ARRAY_SIZE(h->buf);
+	const unsigned int shift = mode_sets[mode][0];
+	const unsigned int num = mode_sets[mode][1];
+	float rssi_sum = 0;
+	int toa256_sum = 0;
+	int ci_cb_sum = 0;
+	unsigned int i, pos;
+
+	for (i = 0; i < num; i++) {
+		pos = (h->current + hist_size - shift + i) % hist_size;
+		rssi_sum   += h->buf[pos].rssi;
+		toa256_sum += h->buf[pos].toa256;
+		ci_cb_sum  += h->buf[pos].ci_cb;
+	}
+
+	pos = (h->current + hist_size - shift) % hist_size;
+	*avg = (struct l1sched_meas_set) {
+		.fn     = h->buf[pos].fn,
+		.rssi   = (rssi_sum   / num),
+		.toa256 = (toa256_sum / (int)num),
+		.ci_cb  = (ci_cb_sum  / (int)num),
+	};
+}
+
+/* Simple deterministic PRNG, so that the output does not depend on libc */
+static uint32_t prng_state = 0x1337;
+
+static uint32_t prng_next(void)
+{
+	prng_state = prng_state * 1103515245 + 12345;
+	return prng_state >> 8;
+}
+
+static void gen_burst_ind(struct trx_ul_burst_ind *bi, uint32_t fn)
+{
+	*bi = (struct trx_ul_burst_ind) {
+		.fn = fn,
+		.flags = (prng_next() & 1) ? TRX_BI_F_CI_CB : 0,
+		.rssi = -(int8_t)(prng_next() % 128),
+		.toa256 = (int16_t)(prng_next() % 8192) - 4096,
+		.ci_cb = (int16_t)(prng_next() % 600) - 100,
+	};
+}
+
+static void test_meas_avg(void)
+{
+	struct l1sched_meas_ring hist = { 0 };
+	struct l1sched_chan_state chan_state = { .meas.hist = &hist };
+	struct ref_hist ref = { 0 };
+	unsigned int mode, fn, mismatch = 0;
+
+	printf("\n%s(): comparing against the reference implementation\n", __func__);
+
+	/* Start right away, so that the partially filled history is covered too */
+	for (fn = 0; fn < 1000; fn++) {
+		struct trx_ul_burst_ind bi;
+
+		gen_burst_ind(&bi, fn);
+		trx_sched_meas_push(&chan_state, &bi);
+		ref_push(&ref, &bi);
+
+		for (mode = 0; mode < ARRAY_SIZE(mode_sets); mode++) {
+			struct l1sched_meas_set avg, ref_avg_set;
+
+			trx_sched_meas_avg(&chan_state, &avg, mode);
+			ref_avg(&ref, &ref_avg_set, mode);
+
+			if (avg.fn != ref_avg_set.fn || avg.rssi != ref_avg_set.rssi ||
+			    avg.toa256 != ref_avg_set.toa256 || avg.ci_cb != ref_avg_set.ci_cb) {
+				printf("Mismatch at fn=%u mode=%s: "
+				       "fn %u vs %u, RSSI %f vs %f, ToA256 %d vs %d, C/I %d vs %d\n",
+				       fn, mode_names[mode],
+				       avg.fn, ref_avg_set.fn, avg.rssi, ref_avg_set.rssi,
+				       avg.toa256, ref_avg_set.toa256, avg.ci_cb, ref_avg_set.ci_cb);
+				mismatch++;
+			}
+		}
+	}
+
+	printf("%u mismatch(es)\n", mismatch);
+}
+
+int main(int argc, char **argv)
+{
+	void *tall_bts_ctx;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	osmo_stderr_target->categories[DMEAS].loglevel = LOGL_NOTICE;
+
+	test_meas_avg();
+
+	printf("Success\n");
+
+	return 0;
+}
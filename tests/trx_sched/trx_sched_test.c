@@ -0,0 +1,317 @@
+/* Tests for the osmo-bts-trx scheduler: Downlink FACCH/TCH multiplexing */
+
+/*
+ * (C) 2023 by sysmocom - s.f.m.c. GmbH <info@sysmocom.de>
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <string.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/application.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/gsm/protocol/gsm_08_58.h>
+#include <osmocom/codec/codec.h>
+
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/bts_sm.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/bts_trx.h>
+#include <osmo-bts/lchan.h>
+#include <osmo-bts/l1sap.h>
+#include <osmo-bts/phy_link.h>
+#include <osmo-bts/rate_ctr_shard.h>
+#include <osmo-bts/scheduler.h>
+
+#include "l1_if.h"
+#include "trx_if.h"
+
+extern void tch_dl_dequeue(struct l1sched_ts *l1ts, struct trx_dl_burst_req *br,
+			   struct msgb **msg_tch, struct msgb **msg_facch);
+
+/*
+ * Stub PHY: replaces trx_if.c and l1_if.c towards the transceiver
+ */
+
+int trx_if_powered(struct trx_l1h *l1h) { return 1; }
+int trx_if_send_burst(struct trx_l1h *l1h, const struct trx_dl_burst_req *br) { return 0; }
+int trx_if_cmd_handover(struct trx_l1h *l1h, uint8_t tn, uint8_t ss) { return 0; }
+int trx_if_cmd_nohandover(struct trx_l1h *l1h, uint8_t tn, uint8_t ss) { return 0; }
+int l1if_mph_time_ind(struct gsm_bts *bts, uint32_t fn) { return 0; }
+
+/*
+ * BTS model: a minimal subset of osmo-bts-trx/{main,l1_if}.c
+ */
+
+static struct rate_ctr_desc test_ctr_desc[BTSTRX_CTR_SLACK_TASK_LATE + 1];
+static const struct rate_ctr_group_desc test_ctrg_desc = {
+	"bts-trx", "trx_sched_test counters", OSMO_STATS_CLASS_GLOBAL,
+	ARRAY_SIZE(test_ctr_desc), test_ctr_desc
+};
+
+int bts_model_init(struct gsm_bts *bts)
+{
+	struct bts_trx_priv *bts_trx = talloc_zero(bts, struct bts_trx_priv);
+	unsigned int i;
+
+	/* only the count matters here, the names must be valid identifiers */
+	for (i = 0; i < ARRAY_SIZE(test_ctr_desc); i++)
+		test_ctr_desc[i].name = talloc_asprintf(bts_trx, "ctr%u", i);
+
+	bts_trx->clk_s.fn_timer_ofd.fd = -1;
+	fn_budget_init(&bts_trx->fn_budget);
+	bts_trx->ctrs = rate_ctr_group_alloc(bts_trx, &test_ctrg_desc, 0);
+	OSMO_ASSERT(bts_trx->ctrs != NULL);
+	bts_trx->ctrs_shard = rate_ctr_shard_group_alloc(bts_trx, bts_trx->ctrs);
+	OSMO_ASSERT(bts_trx->ctrs_shard != NULL);
+
+	bts->model_priv = bts_trx;
+	bts->variant = BTS_OSMO_TRX;
+
+	return 0;
+}
+
+int bts_model_l1sap_down(struct gsm_bts_trx *trx, struct osmo_phsap_prim *l1sap)
+{
+	if (l1sap->oph.msg)
+		msgb_free(l1sap->oph.msg);
+	return 0;
+}
+
+void bts_model_phy_link_set_defaults(struct phy_link *plink) { }
+
+void bts_model_phy_instance_set_defaults(struct phy_instance *pinst)
+{
+	pinst->u.osmotrx.hdl = talloc_zero(pinst, struct trx_l1h);
+	pinst->u.osmotrx.hdl->phy_inst = pinst;
+}
+
+int bts_model_trx_init(struct gsm_bts_trx *trx) { return 0; }
+int bts_model_chg_adm_state(struct gsm_bts *bts, struct gsm_abis_mo *mo,
+			    void *obj, uint8_t adm_state) { return 0; }
+int bts_model_apply_oml(struct gsm_bts *bts, const struct msgb *msg,
+			struct gsm_abis_mo *mo, void *obj) { return 0; }
+int bts_model_trx_deact_rf(struct gsm_bts_trx *trx) { return 0; }
+void bts_model_trx_close(struct gsm_bts_trx *trx) { bts_model_trx_close_cb(trx, 0); }
+int bts_model_check_oml(struct gsm_bts *bts, uint8_t msg_type,
+			struct tlv_parsed *old_attr, struct tlv_parsed *new_attr,
+			void *obj) { return 0; }
+int bts_model_opstart(struct gsm_bts *bts, struct gsm_abis_mo *mo,
+		      void *obj) { return 0; }
+uint32_t trx_get_hlayer1(const struct gsm_bts_trx *trx) { return 0; }
+int bts_model_oml_estab(struct gsm_bts *bts) { return 0; }
+int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm) { return 0; }
+int bts_model_lchan_deactivate(struct gsm_lchan *lchan) { return 0; }
+int bts_model_lchan_deactivate_sacch(struct gsm_lchan *lchan) { return 0; }
+int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan) { return 0; }
+void bts_model_abis_close(struct gsm_bts *bts) { }
+int bts_model_ts_disconnect(struct gsm_bts_trx_ts *ts) { return 0; }
+int bts_model_ts_release_lchans(struct gsm_bts_trx_ts *ts, uint32_t lchan_mask) { return -ENOTSUP; }
+int bts_model_cbch_encode(struct gsm_bts *bts, ubit_t *bursts, const uint8_t *l2) { return -ENOTSUP; }
+void bts_model_ts_connect(struct gsm_bts_trx_ts *ts,
+			  enum gsm_phys_chan_config as_pchan) { }
+int bts_model_phy_link_open(struct phy_link *plink) { return 0; }
+
+/*
+ * Test
+ */
+
+#define TEST_TN 1
+
+static struct gsm_bts *test_bts_setup(void *ctx)
+{
+	struct gsm_bts *bts;
+	struct gsm_bts_trx_ts *ts;
+	struct gsm_lchan *lchan;
+	struct phy_link *plink;
+	struct phy_instance *pinst;
+	uint8_t chan_nr;
+
+	g_bts_sm = gsm_bts_sm_alloc(ctx);
+	OSMO_ASSERT(g_bts_sm != NULL);
+	bts = gsm_bts_alloc(g_bts_sm, 0);
+	OSMO_ASSERT(bts != NULL);
+	OSMO_ASSERT(bts_init(bts) == 0);
+
+	plink = phy_link_create(ctx, 0);
+	OSMO_ASSERT(plink != NULL);
+	/* 13 TDMA frames, a FACCH/F may wait for two more blocks */
+	plink->u.osmotrx.dl_facch_max_delay_ms = 60;
+
+	pinst = phy_instance_create(plink, 0);
+	OSMO_ASSERT(pinst != NULL);
+	phy_instance_link_to_trx(pinst, bts->c0);
+	trx_sched_init(bts->c0);
+
+	/* TCH/F in FR speech mode */
+	ts = &bts->c0->ts[TEST_TN];
+	ts->pchan = GSM_PCHAN_TCH_F;
+	trx_sched_set_pchan(ts, ts->pchan);
+
+	lchan = &ts->lchan[0];
+	lchan->type = GSM_LCHAN_TCH_F;
+	lchan->rsl_cmode = RSL_CMOD_SPD_SPEECH;
+	lchan->tch_mode = GSM48_CMODE_SPEECH_V1;
+	chan_nr = gsm_lchan2chan_nr(lchan);
+	trx_sched_set_lchan(lchan, chan_nr, LID_DEDIC, true);
+	trx_sched_set_mode(ts, chan_nr, lchan->rsl_cmode, lchan->tch_mode,
+			   0, 0, 0, 0, 0, 0, 0);
+	lchan_set_state(lchan, LCHAN_S_ACTIVE);
+
+	return bts;
+}
+
+static void enqueue_facch(struct gsm_bts_trx *trx, uint32_t fn)
+{
+	struct msgb *msg = l1sap_msgb_alloc(GSM_MACBLOCK_LEN);
+	struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
+
+	osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_PH_DATA, PRIM_OP_REQUEST, msg);
+	l1sap->u.data.chan_nr = RSL_CHAN_Bm_ACCHs | TEST_TN;
+	l1sap->u.data.link_id = 0x00;
+	l1sap->u.data.fn = fn;
+	msg->l2h = msgb_put(msg, GSM_MACBLOCK_LEN);
+	memset(msg->l2h, 0x2b, GSM_MACBLOCK_LEN);
+
+	OSMO_ASSERT(trx_sched_ph_data_req(trx, l1sap) == 0);
+}
+
+static void enqueue_tch(struct gsm_bts_trx *trx, uint32_t fn, bool sid)
+{
+	struct msgb *msg = l1sap_msgb_alloc(GSM_FR_BYTES);
+	struct osmo_phsap_prim *l1sap = msgb_l1sap_prim(msg);
+
+	osmo_prim_init(&l1sap->oph, SAP_GSM_PH, PRIM_TCH, PRIM_OP_REQUEST, msg);
+	l1sap->u.tch.chan_nr = RSL_CHAN_Bm_ACCHs | TEST_TN;
+	l1sap->u.tch.fn = fn;
+	msg->l2h = msgb_put(msg, GSM_FR_BYTES);
+	/* an all-zero SID field makes a SID frame */
+	memset(msg->l2h, sid ? 0x00 : 0xff, GSM_FR_BYTES);
+	msg->l2h[0] = 0xd0;
+
+	OSMO_ASSERT(trx_sched_tch_req(trx, l1sap) == 0);
+}
+
+enum test_tch {
+	TCH_NONE,
+	TCH_SPEECH,
+	TCH_SID,
+};
+
+static const char *test_tch_names[] = {
+	[TCH_NONE] = "-",
+	[TCH_SPEECH] = "speech",
+	[TCH_SID] = "SID",
+};
+
+/* queue the given frames for the TCH/F block at fn and print what is sent */
+static void test_block(struct gsm_bts_trx *trx, uint32_t fn, bool facch, enum test_tch tch)
+{
+	struct l1sched_ts *l1ts = trx->ts[TEST_TN].priv;
+	struct trx_dl_burst_req br = {
+		.fn = fn,
+		.tn = TEST_TN,
+		.chan = TRXC_TCHF,
+	};
+	struct msgb *msg_tch = NULL;
+	struct msgb *msg_facch = NULL;
+
+	if (facch)
+		enqueue_facch(trx, fn);
+	if (tch != TCH_NONE)
+		enqueue_tch(trx, fn, tch == TCH_SID);
+
+	tch_dl_dequeue(l1ts, &br, &msg_tch, &msg_facch);
+
+	printf("fn=%u queued: facch=%s tch=%s -> sent: ", fn,
+	       facch ? "yes" : "-", test_tch_names[tch]);
+	if (msg_facch != NULL)
+		printf("FACCH (fn=%u)", msgb_l1sap_prim(msg_facch)->u.data.fn);
+	else if (msg_tch != NULL)
+		printf("TCH");
+	else
+		printf("nothing");
+	printf("%s\n", l1ts->chan_state[TRXC_TCHF].dl_facch_deferred != NULL ?
+	       ", FACCH kept back" : "");
+
+	if (msg_tch != NULL)
+		msgb_free(msg_tch);
+	if (msg_facch != NULL)
+		msgb_free(msg_facch);
+}
+
+static void test_dl_facch_defer(struct gsm_bts *bts)
+{
+	struct bts_trx_priv *priv = (struct bts_trx_priv *) bts->model_priv;
+	unsigned int i;
+
+	printf("\n%s(): FACCH released in a block without speech\n", __func__);
+	test_block(bts->c0, 0, true, TCH_SPEECH);
+	test_block(bts->c0, 4, false, TCH_SPEECH);
+	test_block(bts->c0, 8, false, TCH_NONE);
+
+	printf("\n%s(): FACCH steals speech once the bound is reached\n", __func__);
+	test_block(bts->c0, 26, true, TCH_SPEECH);
+	test_block(bts->c0, 30, false, TCH_SPEECH);
+	test_block(bts->c0, 34, false, TCH_SPEECH);
+	test_block(bts->c0, 39, false, TCH_SPEECH);
+
+	printf("\n%s(): two FACCH in a row, sent in order\n", __func__);
+	test_block(bts->c0, 52, true, TCH_SPEECH);
+	test_block(bts->c0, 56, true, TCH_SPEECH);
+	test_block(bts->c0, 60, false, TCH_SPEECH);
+	test_block(bts->c0, 65, false, TCH_SID);
+
+	printf("\n%s(): FACCH steals a SID frame right away\n", __func__);
+	test_block(bts->c0, 78, true, TCH_SID);
+
+	printf("\n%s(): queueing delay histogram\n", __func__);
+	rate_ctr_shard_flush(priv->ctrs_shard);
+	for (i = BTSTRX_CTR_SCHED_DL_FACCH_DELAY_0MS; i <= BTSTRX_CTR_SCHED_DL_FACCH_DELAY_MORE; i++)
+		printf("dl_facch_delay[%u]: %" PRIu64 "\n", i - BTSTRX_CTR_SCHED_DL_FACCH_DELAY_0MS,
+		       rate_ctr_group_get_ctr(priv->ctrs, i)->current);
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm_bts *bts;
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_talloc_ctx_init(tall_bts_ctx, 0);
+
+	osmo_init_logging2(tall_bts_ctx, &bts_log_info);
+	log_set_print_filename2(osmo_stderr_target, LOG_FILENAME_NONE);
+
+	bts = test_bts_setup(tall_bts_ctx);
+	test_dl_facch_defer(bts);
+
+	printf("\nSuccess\n");
+
+	return 0;
+}
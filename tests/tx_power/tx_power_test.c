@@ -49,7 +49,7 @@ static const struct trx_power_params tpp_1002 = {
 	.ramp = {
 		.max_initial_pout_mdBm = to_mdB(23),
 		.step_size_mdB = to_mdB(2),
-		.step_interval_sec = 1,
+		.step_interval_ms = 1000,
 	},
 };
 
@@ -68,7 +68,7 @@ static const struct trx_power_params tpp_1020 = {
 	.ramp = {
 		.max_initial_pout_mdBm = to_mdB(0),
 		.step_size_mdB = to_mdB(2),
-		.step_interval_sec = 1,
+		.step_interval_ms = 1000,
 	},
 };
 
@@ -87,7 +87,7 @@ static const struct trx_power_params tpp_1100 = {
 	.ramp = {
 		.max_initial_pout_mdBm = to_mdB(0),
 		.step_size_mdB = to_mdB(2),
-		.step_interval_sec = 1,
+		.step_interval_ms = 1000,
 	},
 };
 
@@ -106,7 +106,7 @@ static const struct trx_power_params tpp_2050 = {
 	.ramp = {
 		.max_initial_pout_mdBm = to_mdB(0),
 		.step_size_mdB = to_mdB(2),
-		.step_interval_sec = 1,
+		.step_interval_ms = 1000,
 	},
 };
 
@@ -204,7 +204,7 @@ static int test_power_ramp(struct gsm_bts_trx *trx, int dBm)
 	int rc;
 
 	trx->power_params = tpp_1020;
-	trx->power_params.ramp.step_interval_sec = 0; /* speedup test */
+	trx->power_params.ramp.step_interval_ms = 0; /* speedup test */
 	trx->max_power_red = 0;
 
 	power_ramp_finished = false;
@@ -212,6 +212,8 @@ static int test_power_ramp(struct gsm_bts_trx *trx, int dBm)
 		return rc;
 	while (!power_ramp_finished)
 		osmo_select_main(0);
+	OSMO_ASSERT(trx->power_params.ramp.stats.count == 1);
+	OSMO_ASSERT(trx->power_params.ramp.stats.last_steps > 0);
 	return 0;
 }
 
@@ -226,7 +228,7 @@ static int test_power_ramp_from_minus10(struct gsm_bts_trx *trx, int dBm)
 	trx->power_params.p_total_tgt_mdBm = to_mdB(-10);
 	trx->power_params.p_total_cur_mdBm = to_mdB(-10);
 	trx->power_params.ramp.max_initial_pout_mdBm = to_mdB(0);
-	trx->power_params.ramp.step_interval_sec = 0; /* speedup test */
+	trx->power_params.ramp.step_interval_ms = 0; /* speedup test */
 	trx->max_power_red = 10;
 
 	power_ramp_finished = false;
@@ -237,6 +239,20 @@ static int test_power_ramp_from_minus10(struct gsm_bts_trx *trx, int dBm)
 	return 0;
 }
 
+static void test_power_ramp_target_is(struct gsm_bts_trx *trx)
+{
+	printf("Testing power_ramp_target_is()\n");
+
+	/* the previous test has ramped up to 10 dBm */
+	printf("at 10 dBm: %d, at 8 dBm: %d\n",
+	       power_ramp_target_is(trx, to_mdB(10)),
+	       power_ramp_target_is(trx, to_mdB(8)));
+
+	/* a ramp which did not reach its target shall be restarted */
+	trx->power_params.p_total_cur_mdBm = to_mdB(6);
+	printf("stalled at 6 dBm: %d\n", power_ramp_target_is(trx, to_mdB(10)));
+}
+
 int main(int argc, char **argv)
 {
 	static struct gsm_bts *bts;
@@ -285,5 +301,6 @@ int main(int argc, char **argv)
 	test_power_ramp(trx, 33);
 	/* Test ramp up from -10dBm (locked) to 10dBm */
 	test_power_ramp_from_minus10(trx, 10);
+	test_power_ramp_target_is(trx);
 
 }